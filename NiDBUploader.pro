@@ -18,13 +18,39 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-        anonymize.cpp
+        anonymize.cpp \
+        dicomsender.cpp \
+        dicomreceiver.cpp \
+        metadataclient.cpp \
+        ratelimiter.cpp \
+        uploadbody.cpp \
+        directupload.cpp \
+        mockapiserver.cpp \
+        fakedicom.cpp
 
 HEADERS  += mainwindow.h \
-         anonymize.h
+         anonymize.h \
+         dicomsender.h \
+         dicomreceiver.h \
+         metadataclient.h \
+         ratelimiter.h \
+         uploadbody.h \
+         directupload.h \
+         mockapiserver.h \
+         fakedicom.h
 
 FORMS    += mainwindow.ui
 
+# make benchmark: scan, anonymize and upload synthetic files to the built-in
+# mock api.php (see MainWindow::RunBenchmark), CONFIG+=benchmark runs it after
+# every build
+unix {
+    benchmark.commands = QT_QPA_PLATFORM=offscreen ./$$TARGET --benchmark
+    benchmark.depends = $$TARGET
+    QMAKE_EXTRA_TARGETS += benchmark
+    CONFIG(benchmark): QMAKE_POST_LINK += $$benchmark.commands
+}
+
 #win32 {
 #DEFINES += BUILDTIME=\\\"$$system('echo %time%')\\\"
 #DEFINES += BUILDDATE=\\\"$$system('echo %date%')\\\"
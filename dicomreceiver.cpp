@@ -0,0 +1,139 @@
+#include "dicomreceiver.h"
+#include <QUrl>
+#include <QUrlQuery>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+
+/* ------------------------------------------------- */
+/* --------- DicomReceiver ------------------------- */
+/* ------------------------------------------------- */
+DicomReceiver::DicomReceiver()
+{
+    listening = false;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ~DicomReceiver ------------------------ */
+/* ------------------------------------------------- */
+DicomReceiver::~DicomReceiver()
+{
+    Stop();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Start --------------------------------- */
+/* ------------------------------------------------- */
+/* dicom://AE@host:port?threads=N&window=M          */
+bool DicomReceiver::Start(QString url, QString spoolDir)
+{
+    if (listening)
+        return true;
+
+    QUrl qurl(url.trimmed());
+    if (!qurl.isValid()) {
+        lastError = "Invalid DICOM receiver [" + url + "]";
+        return false;
+    }
+    QUrlQuery query(qurl);
+    int port = qurl.port(104);
+    int threads = query.hasQueryItem("threads") ? query.queryItemValue("threads").toInt() : 4;
+    if (threads < 1) threads = 1;
+    int window = query.hasQueryItem("window") ? query.queryItemValue("window").toInt() : 16;
+    if (window < 1) window = 1;
+    QString aeTitle = qurl.userName();
+    QString host = qurl.host();
+    if (aeTitle.size() > 16) {
+        lastError = "Invalid AE title [" + aeTitle + "], 16 characters at most";
+        return false;
+    }
+
+    if (!QDir().mkpath(spoolDir)) {
+        lastError = "Unable to create spool directory [" + spoolDir + "]";
+        return false;
+    }
+
+    scp.SetPort((uint16_t)port);
+    scp.SetHostname(host.toLatin1().constData());
+    scp.SetAETitle(aeTitle.toLatin1().constData());
+    scp.SetSpoolDirectory(QDir::toNativeSeparators(spoolDir).toLocal8Bit().constData());
+    scp.SetNumberOfThreads(threads);
+    scp.SetMaxOperationsInvoked((uint16_t)window);
+    scp.SetTimeout(60);
+    scp.SetSink(this);
+    if (!scp.Listen()) {
+        lastError = QString("Unable to listen on [%1] port %2").arg(host).arg(port);
+        return false;
+    }
+    spool = QDir(spoolDir).absolutePath();
+
+    listening = true;
+    start();
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Stop ---------------------------------- */
+/* ------------------------------------------------- */
+/* waits for the associations in progress to end     */
+void DicomReceiver::Stop()
+{
+    if (!listening)
+        return;
+
+    scp.Stop();
+    wait();
+    listening = false;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- TakeReceived -------------------------- */
+/* ------------------------------------------------- */
+QStringList DicomReceiver::TakeReceived()
+{
+    QMutexLocker locker(&receivedLock);
+    QStringList list = received;
+    received.clear();
+    return list;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- RemoveSpooled ------------------------- */
+/* ------------------------------------------------- */
+/* only files from the spool directory are removed,  */
+/* never the ones found by a search                  */
+bool DicomReceiver::RemoveSpooled(QString f)
+{
+    if (spool.isEmpty())
+        return false;
+    QFileInfo info(f);
+    if (info.absolutePath() != spool)
+        return false;
+    return QFile::remove(info.absoluteFilePath());
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Stored -------------------------------- */
+/* ------------------------------------------------- */
+void DicomReceiver::Stored(const char *filename)
+{
+    QMutexLocker locker(&receivedLock);
+    received << QString::fromLocal8Bit(filename);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- run ----------------------------------- */
+/* ------------------------------------------------- */
+void DicomReceiver::run()
+{
+    scp.Run();
+}
@@ -0,0 +1,61 @@
+#ifndef DICOMRECEIVER_H
+#define DICOMRECEIVER_H
+
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QMutex>
+#include "gdcmStoreSCP.h"
+
+/* ------------------------------------------------- */
+/* --------- DicomReceiver ------------------------- */
+/* ------------------------------------------------- */
+/* C-STORE SCP, used instead of searching a data     */
+/* directory when the data dir is a dicom:// URL:    */
+/*   dicom://AE@host:port?threads=N&window=M       */
+/* modalities send their instances to this           */
+/* workstation (port, default 104), up to N          */
+/* associations at once. Only the interface of host  */
+/* is listened on (all of them when empty) and only  */
+/* AE is accepted as called AE title (any when       */
+/* empty). Each instance is streamed once to the     */
+/* spool directory and handed to the uploader with   */
+/* TakeReceived(), then removed with RemoveSpooled() */
+/* once uploaded.                                    */
+class DicomReceiver : public QThread, public gdcm::StoreSCP::Sink
+{
+public:
+    DicomReceiver();
+    ~DicomReceiver();
+
+    bool Start(QString url, QString spoolDir);
+    void Stop();
+    bool IsListening() { return listening; }
+    int GetPort() { return scp.GetPort(); }
+
+    /* files received since the last call */
+    QStringList TakeReceived();
+
+    /* remove f if it is a received file, once uploaded */
+    bool RemoveSpooled(QString f);
+
+    QString GetLastError() { return lastError; }
+
+    /* gdcm::StoreSCP::Sink, called from the association threads */
+    void Stored(const char *filename);
+
+protected:
+    void run();
+
+private:
+    gdcm::StoreSCP scp;
+    bool listening;
+    QString spool;
+
+    QMutex receivedLock;
+    QStringList received;
+
+    QString lastError;
+};
+
+#endif // DICOMRECEIVER_H
@@ -0,0 +1,186 @@
+#include "dicomsender.h"
+#include "gdcmServiceClassUser.h"
+#include "gdcmPresentationContextGenerator.h"
+#include <QUrl>
+#include <QUrlQuery>
+
+#ifndef _WIN32
+    #include <signal.h>
+#endif
+
+
+/* ------------------------------------------------- */
+/* --------- DicomSender --------------------------- */
+/* ------------------------------------------------- */
+DicomSender::DicomSender()
+{
+#ifndef _WIN32
+    /* a reused association may have been closed by the server, we want a
+       write error, not to be killed */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    pool = new gdcm::StoreSCUPool;
+    port = 104;
+    window = 16;
+    associations = 4;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ~DicomSender -------------------------- */
+/* ------------------------------------------------- */
+DicomSender::~DicomSender()
+{
+    delete pool;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- IsDicomUrl ---------------------------- */
+/* ------------------------------------------------- */
+bool DicomSender::IsDicomUrl(QString url)
+{
+    return url.trimmed().startsWith("dicom://", Qt::CaseInsensitive);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- IsStored ------------------------------ */
+/* ------------------------------------------------- */
+/* 0x0000 success, 0xBxxx warning (stored anyway)    */
+bool DicomSender::IsStored(quint16 status)
+{
+    return (status == 0x0000) || ((status & 0xF000) == 0xB000);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SetUrl -------------------------------- */
+/* ------------------------------------------------- */
+/* dicom://CALLEDAE@host:port?aet=CALLING           */
+/*   &window=N&assoc=M                               */
+bool DicomSender::SetUrl(QString u)
+{
+    if (u == url)
+        return true;
+
+    QUrl qurl(u.trimmed());
+    if (!qurl.isValid() || qurl.host().isEmpty()) {
+        lastError = "Invalid DICOM destination [" + u + "]";
+        return false;
+    }
+    QUrlQuery query(qurl);
+
+    /* window=0 means an unlimited window (PS 3.7 D.3.3.3), so a value that does
+       not parse must not end up as 0: reject it */
+    int w = 16;
+    if (query.hasQueryItem("window")) {
+        bool ok;
+        w = query.queryItemValue("window").toInt(&ok);
+        if (!ok || w < 0 || w > 65535) {
+            lastError = "Invalid window [" + query.queryItemValue("window") + "], expecting 0 to 65535";
+            return false;
+        }
+    }
+    int a = 4;
+    if (query.hasQueryItem("assoc")) {
+        bool ok;
+        a = query.queryItemValue("assoc").toInt(&ok);
+        if (!ok || a < 1) {
+            lastError = "Invalid number of associations [" + query.queryItemValue("assoc") + "]";
+            return false;
+        }
+    }
+
+    url = u;
+    host = qurl.host();
+    port = qurl.port(104);
+    calledAE = qurl.userName().isEmpty() ? "ANY-SCP" : qurl.userName();
+    callingAE = query.hasQueryItem("aet") ? query.queryItemValue("aet") : "NIDBUPLOADER";
+    window = w;
+    associations = a;
+
+    /* a new destination: the pool drops its associations and what it knows about the previous one */
+    pool->SetHostname(host.toLatin1().constData());
+    pool->SetPort((uint16_t)port);
+    pool->SetAETitle(callingAE.toLatin1().constData());
+    pool->SetCalledAETitle(calledAE.toLatin1().constData());
+    pool->SetTimeout(30);
+    pool->SetMaxOperationsInvoked((uint16_t)window);
+    pool->SetNumberOfAssociations(associations);
+
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Echo ---------------------------------- */
+/* ------------------------------------------------- */
+bool DicomSender::Echo()
+{
+    gdcm::SmartPointer<gdcm::ServiceClassUser> echoscu = new gdcm::ServiceClassUser;
+    echoscu->SetHostname(host.toLatin1().constData());
+    echoscu->SetPort((uint16_t)port);
+    echoscu->SetAETitle(callingAE.toLatin1().constData());
+    echoscu->SetCalledAETitle(calledAE.toLatin1().constData());
+    echoscu->SetTimeout(30);
+    if (!echoscu->InitializeConnection()) {
+        lastError = QString("Unable to connect to %1:%2").arg(host).arg(port);
+        return false;
+    }
+    gdcm::PresentationContextGenerator generator;
+    generator.GenerateFromUID(gdcm::UIDs::VerificationSOPClass);
+    echoscu->SetPresentationContexts(generator.GetPresentationContexts());
+    if (!echoscu->StartAssociation()) {
+        lastError = QString("Association rejected by %1@%2:%3").arg(calledAE).arg(host).arg(port);
+        return false;
+    }
+    bool ret = echoscu->SendEcho();
+    echoscu->StopAssociation();
+    if (!ret) lastError = "C-ECHO failed";
+    return ret;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Send ---------------------------------- */
+/* ------------------------------------------------- */
+/* send a batch of files, return the number of files */
+/* stored by the server and the C-STORE status of    */
+/* each file (0xFFFF if it was not sent). The        */
+/* associations are kept open for the next batch     */
+int DicomSender::Send(QStringList list, QVector<quint16> &statuses)
+{
+    statuses.fill(0xFFFF, list.size());
+    if (list.isEmpty())
+        return 0;
+
+    std::vector<std::string> filenames;
+    for (int i=0; i<list.size(); i++)
+        filenames.push_back(list[i].toLocal8Bit().constData());
+
+    /* the pool only renegotiates for SOP classes/transfer syntaxes it has not seen yet,
+       and reconnects the associations the server dropped while idle */
+    std::vector<uint16_t> status;
+    pool->SendStore(filenames, status);
+
+    int numStored = 0;
+    for (size_t i=0; i<status.size(); i++) {
+        statuses[(int)i] = status[i];
+        if (IsStored(status[i]))
+            numStored++;
+    }
+    if (numStored < list.size())
+        lastError = QString("%1 of %2 files were not stored").arg(list.size() - numStored).arg(list.size());
+
+    return numStored;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Close --------------------------------- */
+/* ------------------------------------------------- */
+void DicomSender::Close()
+{
+    pool->Close();
+}
@@ -0,0 +1,50 @@
+#ifndef DICOMSENDER_H
+#define DICOMSENDER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "gdcmStoreSCUPool.h"
+
+/* ------------------------------------------------- */
+/* --------- DicomSender --------------------------- */
+/* ------------------------------------------------- */
+/* C-STORE upload transport, used instead of api.php */
+/* when the connection server is a dicom:// URL:     */
+/*   dicom://CALLEDAE@host:port?aet=CALLING        */
+/*     &window=N&assoc=M                           */
+/* files are sent over M associations in parallel,   */
+/* C-STOREs are pipelined within the negotiated      */
+/* asynchronous operations window, and the           */
+/* associations are kept open between batches.       */
+class DicomSender
+{
+public:
+    DicomSender();
+    ~DicomSender();
+
+    static bool IsDicomUrl(QString url);
+    static bool IsStored(quint16 status);
+    bool SetUrl(QString url);
+
+    bool Echo();
+    int Send(QStringList list, QVector<quint16> &statuses);
+    void Close();
+
+    QString GetLastError() { return lastError; }
+
+private:
+    gdcm::StoreSCUPool *pool;
+
+    QString url;
+    QString host;
+    int port;
+    QString callingAE;
+    QString calledAE;
+    int window;
+    int associations;
+
+    QString lastError;
+};
+
+#endif // DICOMSENDER_H
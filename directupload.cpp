@@ -0,0 +1,495 @@
+#include "directupload.h"
+#include "uploadbody.h"
+#include "ratelimiter.h"
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <netdb.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <string.h>
+    #include <signal.h>
+    #include <pthread.h>
+    #include <sys/time.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #ifdef Q_OS_LINUX
+        #include <sys/sendfile.h>
+    #endif
+#endif
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+
+
+/* ------------------------------------------------- */
+/* --------- DirectUpload -------------------------- */
+/* ------------------------------------------------- */
+DirectUpload::DirectUpload(QUrl u, UploadBody *b, RateLimiter *l, QObject *parent) : QThread(parent)
+{
+    url = u;
+    body = b;
+    body->setParent(this);
+    limiter = l;
+    if (limiter)
+        limiter->Register(body);
+    sock = -1;
+    sent = 0;
+    lastProgress = 0;
+    ok = false;
+    status = 0;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ~DirectUpload ------------------------- */
+/* ------------------------------------------------- */
+DirectUpload::~DirectUpload()
+{
+    if (limiter)
+        limiter->Unregister(body);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- IsSupported --------------------------- */
+/* ------------------------------------------------- */
+bool DirectUpload::IsSupported(QUrl url)
+{
+#ifdef Q_OS_UNIX
+    return (url.scheme() == "http") && !url.host().isEmpty();
+#else
+    Q_UNUSED(url);
+    return false;
+#endif
+}
+
+
+/* ------------------------------------------------- */
+/* --------- run ----------------------------------- */
+/* ------------------------------------------------- */
+void DirectUpload::run()
+{
+#ifdef Q_OS_UNIX
+    /* a server hanging up must fail the upload, not kill the application */
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, 0);
+
+    ok = Post();
+    if (sock >= 0)
+        ::close(sock);
+    sock = -1;
+
+    sigset_t pending;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGPIPE)) {
+        int sig;
+        sigwait(&pipe, &sig);
+    }
+#else
+    lastError = "Not supported on this platform";
+#endif
+}
+
+
+#ifdef Q_OS_UNIX
+
+/* ------------------------------------------------- */
+/* --------- Post ---------------------------------- */
+/* ------------------------------------------------- */
+bool DirectUpload::Post()
+{
+    if (!Connect())
+        return false;
+
+    QByteArray path = url.path(QUrl::FullyEncoded).toLatin1();
+    if (path.isEmpty())
+        path = "/";
+    if (url.hasQuery())
+        path += "?" + url.query(QUrl::FullyEncoded).toLatin1();
+    QByteArray host = url.host(QUrl::FullyEncoded).toLatin1();
+    if (url.port() > 0)
+        host += ":" + QByteArray::number(url.port());
+
+    QByteArray header = "POST " + path + " HTTP/1.1\r\n";
+    header += "Host: " + host + "\r\n";
+    header += "User-Agent: NiDBUploader\r\n";
+    header += "Content-Type: " + body->GetContentType() + "\r\n";
+    header += "Content-Length: " + QByteArray::number(body->size()) + "\r\n";
+    header += "Connection: close\r\n\r\n";
+
+#ifdef TCP_CORK
+    /* the small parts go out in full segments with the files, not one packet each */
+    int on = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+#endif
+    if (!SendAll(header.constData(), header.size()))
+        return false;
+    sent = 0;
+    for (int i=0; i<body->GetNumberOfChunks(); i++) {
+        if (QFile *file = body->GetChunkFile(i)) {
+            if (!file->open(QIODevice::ReadOnly)) {
+                lastError = "Unable to open [" + file->fileName() + "]";
+                return false;
+            }
+            bool ok = SendFile(i);
+            file->close();
+            if (!ok)
+                return false;
+        }
+        else {
+            QByteArray bytes = body->GetChunkBytes(i);
+            if (!SendAll(bytes.constData(), bytes.size()))
+                return false;
+        }
+    }
+#ifdef TCP_CORK
+    int off = 0;
+    setsockopt(sock, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+#endif
+
+    return ReadResponse();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ConnectTimeout ------------------------ */
+/* ------------------------------------------------- */
+/* connect() gives up after msecs, instead of the    */
+/* minutes the system may wait for an unreachable    */
+/* host. Sets errno on failure                       */
+static bool ConnectTimeout(int sock, const struct sockaddr *addr, socklen_t len, int msecs)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    int r = ::connect(sock, addr, len);
+    if ((r < 0) && (errno == EINPROGRESS)) {
+        struct pollfd p;
+        p.fd = sock;
+        p.events = POLLOUT;
+        do {
+            r = ::poll(&p, 1, msecs);
+        } while ((r < 0) && (errno == EINTR));
+        if (r == 0) {
+            errno = ETIMEDOUT;
+            r = -1;
+        }
+        else if (r > 0) {
+            int err = 0;
+            socklen_t errlen = sizeof(err);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &errlen);
+            errno = err;
+            r = err ? -1 : 0;
+        }
+    }
+    int saved = errno;
+    fcntl(sock, F_SETFL, flags);
+    errno = saved;
+    return (r == 0);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Connect ------------------------------- */
+/* ------------------------------------------------- */
+bool DirectUpload::Connect()
+{
+    QByteArray host = url.host().toLatin1();
+    QByteArray port = QByteArray::number(url.port(80));
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addrs = 0;
+    int err = getaddrinfo(host.constData(), port.constData(), &hints, &addrs);
+    if (err != 0) {
+        lastError = QString("Unable to resolve [%1]: %2").arg(QString(host)).arg(gai_strerror(err));
+        return false;
+    }
+
+    for (struct addrinfo *a = addrs; a; a = a->ai_next) {
+        sock = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (sock < 0)
+            continue;
+        if (ConnectTimeout(sock, a->ai_addr, a->ai_addrlen, 30000))
+            break;
+        lastError = QString("Unable to connect to [%1:%2]: %3").arg(QString(host)).arg(QString(port)).arg(strerror(errno));
+        ::close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(addrs);
+    if (sock < 0)
+        return false;
+
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    /* a server that stops reading or answering must not hold the upload forever */
+    struct timeval timeout;
+    timeout.tv_sec = 300;
+    timeout.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SendAll ------------------------------- */
+/* ------------------------------------------------- */
+bool DirectUpload::SendAll(const char *data, qint64 len)
+{
+    while (len > 0) {
+        qint64 slice = Allow(len);
+        ssize_t n = ::send(sock, data, slice, MSG_NOSIGNAL);
+        if (n < 0) {
+            Refund(slice);
+            if (errno == EINTR)
+                continue;
+            lastError = QString("Unable to send: %1").arg(strerror(errno));
+            return false;
+        }
+        Refund(slice - n);
+        data += n;
+        len -= n;
+        Sent(n);
+    }
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SendFile ------------------------------ */
+/* ------------------------------------------------- */
+/* the file of the chunk, from the start. The file   */
+/* must not have shrunk since the Content-Length was */
+/* computed                                          */
+bool DirectUpload::SendFile(int chunk)
+{
+    int fd = body->GetChunkFile(chunk)->handle();
+    qint64 size = body->GetChunkSize(chunk);
+    /* 64 KB: what is read back is hashed while still */
+    /* in the L2 cache, not fetched again from memory */
+    QByteArray buffer(1 << 16, 0);
+    qint64 offset = 0;
+#ifdef Q_OS_LINUX
+    while (offset < size) {
+        /* at most 4 MB at a time, for the progress bar */
+        off_t off = offset;
+        qint64 slice = Allow(qMin(size - offset, (qint64)(4 << 20)));
+        ssize_t n = ::sendfile(sock, fd, &off, slice);
+        if (n < 0) {
+            Refund(slice);
+            if (errno == EINTR)
+                continue;
+            if ((errno == EINVAL) || (errno == ENOSYS))
+                break; /* not for this file, read it */
+            lastError = QString("Unable to send: %1").arg(strerror(errno));
+            return false;
+        }
+        Refund(slice - n);
+        if (n == 0) {
+            lastError = "File shorter than announced";
+            return false;
+        }
+        if (!Checksum(chunk, offset, n, buffer))
+            return false;
+        offset += n;
+        Sent(n);
+    }
+#endif
+
+    while (offset < size) {
+        ssize_t n = ::pread(fd, buffer.data(), qMin(size - offset, (qint64)buffer.size()), offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            lastError = QString("Unable to read: %1").arg(strerror(errno));
+            return false;
+        }
+        if (n == 0) {
+            lastError = "File shorter than announced";
+            return false;
+        }
+        body->Checksum(chunk, buffer.constData(), n);
+        if (!SendAll(buffer.constData(), n))
+            return false;
+        offset += n;
+    }
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Checksum ------------------------------ */
+/* ------------------------------------------------- */
+/* len bytes of the chunk that sendfile() just sent: */
+/* still in the page cache, no disk access           */
+bool DirectUpload::Checksum(int chunk, qint64 offset, qint64 len, QByteArray &buffer)
+{
+    if (!body->HasManifest())
+        return true;
+    int fd = body->GetChunkFile(chunk)->handle();
+    while (len > 0) {
+        ssize_t n = ::pread(fd, buffer.data(), qMin(len, (qint64)buffer.size()), offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            lastError = QString("Unable to read: %1").arg(strerror(errno));
+            return false;
+        }
+        if (n == 0) {
+            lastError = "File shorter than announced";
+            return false;
+        }
+        body->Checksum(chunk, buffer.constData(), n);
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Allow --------------------------------- */
+/* ------------------------------------------------- */
+/* how much of max may be sent now, taken from the  */
+/* limiter as the uploads through Qt do, waiting for */
+/* its next tick if need be                          */
+qint64 DirectUpload::Allow(qint64 max)
+{
+    if (!limiter)
+        return max;
+    while (true) {
+        qint64 granted = limiter->Take(body, max);
+        if (granted > 0)
+            return granted;
+        msleep(RateLimiter::tick);
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Refund -------------------------------- */
+/* ------------------------------------------------- */
+/* what Allow gave but was not sent                  */
+void DirectUpload::Refund(qint64 unused)
+{
+    if (limiter && (unused > 0))
+        limiter->Refund(body, unused);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Sent ---------------------------------- */
+/* ------------------------------------------------- */
+/* counts body bytes only, the header goes first     */
+void DirectUpload::Sent(qint64 n)
+{
+    sent += n;
+    if ((sent - lastProgress >= (1 << 20)) || (sent == body->size())) {
+        lastProgress = sent;
+        emit Progress(sent, body->size());
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Dechunk ------------------------------- */
+/* ------------------------------------------------- */
+/* Transfer-Encoding: chunked                        */
+static QByteArray Dechunk(QByteArray data)
+{
+    QByteArray out;
+    int pos = 0;
+    while (true) {
+        int eol = data.indexOf("\r\n", pos);
+        if (eol < 0)
+            break;
+        bool ok;
+        int size = data.mid(pos, eol - pos).split(';').first().trimmed().toInt(&ok, 16);
+        if (!ok || (size <= 0))
+            break;
+        out += data.mid(eol + 2, size);
+        pos = eol + 2 + size + 2;
+    }
+    return out;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ReadResponse -------------------------- */
+/* ------------------------------------------------- */
+/* the server closes the connection after answering, */
+/* or says how long the answer is                    */
+bool DirectUpload::ReadResponse()
+{
+    QByteArray data;
+    int headerEnd = -1;
+    qint64 length = -1;
+    bool chunked = false;
+    char buffer[65536];
+    while (true) {
+        ssize_t n = ::recv(sock, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            lastError = QString("Unable to read the answer: %1").arg(strerror(errno));
+            return false;
+        }
+        if (n == 0)
+            break;
+        data.append(buffer, n);
+
+        if (headerEnd < 0) {
+            headerEnd = data.indexOf("\r\n\r\n");
+            if (headerEnd < 0)
+                continue;
+            QList<QByteArray> lines = data.left(headerEnd).split('\n');
+            QList<QByteArray> statusLine = lines[0].simplified().split(' ');
+            if (statusLine.size() > 1)
+                status = statusLine[1].toInt();
+            for (int i=1; i<lines.size(); i++) {
+                int colon = lines[i].indexOf(':');
+                if (colon < 0)
+                    continue;
+                QByteArray name = lines[i].left(colon).trimmed().toLower();
+                QByteArray value = lines[i].mid(colon + 1).trimmed().toLower();
+                if (name == "content-length")
+                    length = value.toLongLong();
+                else if ((name == "transfer-encoding") && value.contains("chunked"))
+                    chunked = true;
+            }
+        }
+        if (chunked && data.endsWith("0\r\n\r\n"))
+            break;
+        if (!chunked && (length >= 0) && (data.size() - headerEnd - 4 >= length))
+            break;
+    }
+    if (headerEnd < 0) {
+        lastError = "No answer from the server";
+        return false;
+    }
+
+    response = data.mid(headerEnd + 4);
+    if (chunked)
+        response = Dechunk(response);
+    else if (length >= 0)
+        response = response.left(length);
+    if ((status < 200) || (status > 299)) {
+        lastError = QString("HTTP %1").arg(status);
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef DIRECTUPLOAD_H
+#define DIRECTUPLOAD_H
+
+#include <QThread>
+#include <QString>
+#include <QByteArray>
+#include <QUrl>
+
+class UploadBody;
+class RateLimiter;
+
+/* ------------------------------------------------- */
+/* --------- DirectUpload -------------------------- */
+/* ------------------------------------------------- */
+/* posts an UploadBody on its own socket, from its   */
+/* own thread, instead of through                    */
+/* QNetworkAccessManager. The boundaries and fields  */
+/* are written from memory and the files are handed  */
+/* to the kernel with sendfile(), so their bytes are */
+/* never copied through user space. Where sendfile() */
+/* is missing or refuses a file, it is read and      */
+/* written 1 MB at a time. With a manifest, what     */
+/* sendfile() sent is read back for the checksum,    */
+/* from the page cache it just went through. Plain   */
+/* http without a proxy only (IsSupported). With a   */
+/* RateLimiter, each slice of the body is taken from */
+/* it like the uploads through Qt, so the schedule   */
+/* limits them all together, and a change of it      */
+/* applies during the upload. Emits Progress while   */
+/* sending, and finished() once the answer is in.    */
+class DirectUpload : public QThread
+{
+    Q_OBJECT
+
+public:
+    /* body: opened, without a RateLimiter of its     */
+    /* own. It is deleted with the DirectUpload.      */
+    /* limiter: not owned, 0 for unlimited            */
+    DirectUpload(QUrl url, UploadBody *body, RateLimiter *limiter = 0, QObject *parent = 0);
+    ~DirectUpload();
+
+    static bool IsSupported(QUrl url);
+
+    /* once finished */
+    bool IsOk() { return ok; }
+    int GetStatus() { return status; }
+    QByteArray GetResponse() { return response; }
+    QString GetLastError() { return lastError; }
+
+signals:
+    void Progress(qint64 sent, qint64 total);
+
+protected:
+    void run();
+
+private:
+    bool Post();
+    bool Connect();
+    bool SendAll(const char *data, qint64 len);
+    bool SendFile(int chunk);
+    bool Checksum(int chunk, qint64 offset, qint64 len, QByteArray &buffer);
+    bool ReadResponse();
+    qint64 Allow(qint64 max);
+    void Refund(qint64 unused);
+    void Sent(qint64 n);
+
+    QUrl url;
+    UploadBody *body;
+    RateLimiter *limiter;
+
+    int sock;
+    qint64 sent;
+    qint64 lastProgress;
+
+    bool ok;
+    int status;
+    QByteArray response;
+    QString lastError;
+};
+
+#endif // DIRECTUPLOAD_H
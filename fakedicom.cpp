@@ -0,0 +1,80 @@
+#include "fakedicom.h"
+#include "gdcmImage.h"
+#include "gdcmImageWriter.h"
+#include "gdcmAttribute.h"
+#include "gdcmUIDGenerator.h"
+#include <QDir>
+#include <vector>
+#include <stdlib.h>
+
+
+/* ------------------------------------------------- */
+/* --------- Generate ------------------------------ */
+/* ------------------------------------------------- */
+/* one study per patient, 10 patients               */
+bool FakeDicom::Generate(QString dir, int count, int sizeKB, QString &lastError)
+{
+    if (!QDir().mkpath(dir)) {
+        lastError = "Unable to create [" + dir + "]";
+        return false;
+    }
+
+    /* square images of roughly sizeKB */
+    unsigned int dim = 16;
+    while (dim * dim * 2 < (unsigned int)sizeKB * 1024)
+        dim += 16;
+    std::vector<unsigned short> buffer(dim * dim);
+
+    gdcm::UIDGenerator uid;
+    std::vector<std::string> studies;
+    for (int p=0; p<10; p++)
+        studies.push_back(uid.Generate());
+
+    for (int i=0; i<count; i++) {
+        /* noise, so that nothing along the way compresses it away */
+        for (size_t j=0; j<buffer.size(); j++)
+            buffer[j] = (unsigned short)(rand() % 4096);
+
+        gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+        image->SetNumberOfDimensions(2);
+        image->SetDimension(0, dim);
+        image->SetDimension(1, dim);
+        image->SetPixelFormat(gdcm::PixelFormat(1, 16, 12, 11, 0));
+        image->SetPhotometricInterpretation(gdcm::PhotometricInterpretation::MONOCHROME2);
+        image->SetTransferSyntax(gdcm::TransferSyntax::ExplicitVRLittleEndian);
+        gdcm::DataElement pixeldata(gdcm::Tag(0x7fe0,0x0010));
+        pixeldata.SetByteValue((char*)&buffer[0], (uint32_t)(buffer.size() * 2));
+        image->SetDataElement(pixeldata);
+
+        int patient = i % 10;
+        gdcm::ImageWriter writer;
+        gdcm::DataSet &ds = writer.GetFile().GetDataSet();
+        gdcm::Attribute<0x0010,0x0010> patientName;
+        patientName.SetValue(QString("Mock^Patient%1").arg(patient).toStdString().c_str());
+        ds.Replace(patientName.GetAsDataElement());
+        gdcm::Attribute<0x0010,0x0020> patientID;
+        patientID.SetValue(QString("MOCK%1").arg(patient, 4, 10, QChar('0')).toStdString().c_str());
+        ds.Replace(patientID.GetAsDataElement());
+        gdcm::Attribute<0x0010,0x0030> patientBirthDate;
+        patientBirthDate.SetValue(QString("19%1").arg(50 + patient).append("0101").toStdString().c_str());
+        ds.Replace(patientBirthDate.GetAsDataElement());
+        gdcm::Attribute<0x0008,0x0060> modality;
+        modality.SetValue("MR");
+        ds.Replace(modality.GetAsDataElement());
+        gdcm::Attribute<0x0020,0x000d> studyUID;
+        studyUID.SetValue(studies[patient].c_str());
+        ds.Replace(studyUID.GetAsDataElement());
+        gdcm::Attribute<0x0020,0x0013> instanceNumber;
+        instanceNumber.SetValue(i / 10 + 1);
+        ds.Replace(instanceNumber.GetAsDataElement());
+
+        QString filename = QString("%1/%2.dcm").arg(dir).arg(i, 6, 10, QChar('0'));
+        writer.SetFileName(filename.toLocal8Bit().constData());
+        writer.SetImage(*image);
+        if (!writer.Write()) {
+            lastError = "Unable to write [" + filename + "]";
+            return false;
+        }
+    }
+    return true;
+}
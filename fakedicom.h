@@ -0,0 +1,19 @@
+#ifndef FAKEDICOM_H
+#define FAKEDICOM_H
+
+#include <QString>
+
+/* ------------------------------------------------- */
+/* --------- FakeDicom ----------------------------- */
+/* ------------------------------------------------- */
+/* synthetic MR series for the benchmark, written    */
+/* with gdcm::ImageWriter: 16 bits MONOCHROME2 noise */
+/* images of about sizeKB each, spread over a few    */
+/* patients with the tags the anonymization replaces */
+class FakeDicom
+{
+public:
+    static bool Generate(QString dir, int count, int sizeKB, QString &lastError);
+};
+
+#endif // FAKEDICOM_H
@@ -0,0 +1,329 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::ServiceClassUser::SendStore over loopback against a stand-in
+ * C-STORE SCP running in a thread, for an increasing Asynchronous Operations
+ * Window. The SCP answers each C-STORE-RQ after a fixed delay (simulated
+ * round trip + storage time), which is what the window hides. The last
+ * lines compare one association per batch of files with a single
+ * association reused for all the batches.
+ *
+ * Usage:
+ *   BenchmarkCStore [nfiles [size_kb [delay_ms [max_window]]]]
+ */
+#include "gdcmServiceClassUser.h"
+#include "gdcmPresentationContextGenerator.h"
+#include "gdcmAAssociateRQPDU.h"
+#include "gdcmAAssociateACPDU.h"
+#include "gdcmAReleaseRQPDU.h"
+#include "gdcmAReleaseRPPDU.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
+#include "gdcmCommandDataSet.h"
+#include "gdcmImageWriter.h"
+#include "gdcmAttribute.h"
+#include "gdcmSystem.h"
+
+#include <socket++/sockinet.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace gdcm::network;
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Queued by SmartPointer: a DataSet is not meant to be copied around
+struct Response : public gdcm::Object
+{
+  double Due;
+  uint8_t PresentationContextID;
+  gdcm::DataSet Command;
+};
+
+static void WriteResponse(std::ostream &os, Response const &r)
+{
+  gdcm::CommandDataSet ds;
+  ds.Insert( r.Command.GetDataElement( gdcm::Tag(0x0,0x0002) ) );
+  ds.Insert( r.Command.GetDataElement( gdcm::Tag(0x0,0x1000) ) );
+  gdcm::Attribute<0x0,0x0100> commandfield = { 0x8001 };
+  ds.Insert( commandfield.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( r.Command );
+  gdcm::Attribute<0x0,0x0120> respondedto = { messageid.GetValue() };
+  ds.Insert( respondedto.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0800> datasettype = { 0x0101 };
+  ds.Insert( datasettype.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0900> status = { 0 };
+  ds.Insert( status.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0000> grouplength = { 0 };
+  grouplength.SetValue( ds.GetLength<gdcm::ImplicitDataElement>() );
+  ds.Insert( grouplength.GetAsDataElement() );
+
+  PresentationDataValue pdv;
+  pdv.SetPresentationContextID( r.PresentationContextID );
+  pdv.SetDataSet( ds );
+  pdv.SetMessageHeader( 3 );
+  PDataTFPDU pdu;
+  pdu.AddPresentationDataValue( pdv );
+  pdu.Write( os );
+}
+
+struct StandInSCP
+{
+  sockinetbuf *Listener;
+  double Delay;
+  volatile bool Stop;
+};
+
+// Accept every Presentation Context with its first Transfer Syntax and
+// whatever Asynchronous Operations Window is proposed
+static void RunAssociation(StandInSCP const &scp, iosockinet &s)
+{
+  uint8_t itemtype = 0;
+  s.read( (char*)&itemtype, 1 );
+  if( !s || itemtype != 0x1 ) return;
+  AAssociateRQPDU rqpdu;
+  rqpdu.Read( s );
+  AAssociateACPDU acpdu;
+  for( unsigned int i = 0; i < rqpdu.GetNumberOfPresentationContext(); ++i )
+    {
+    PresentationContextRQ const &pc = rqpdu.GetPresentationContext(i);
+    PresentationContextAC pcac;
+    pcac.SetPresentationContextID( pc.GetPresentationContextID() );
+    pcac.SetTransferSyntax( pc.GetTransferSyntaxes()[0] );
+    pcac.SetReason( 0 );
+    acpdu.AddPresentationContextAC( pcac );
+    }
+  acpdu.InitFromRQ( rqpdu );
+  if( const AsynchronousOperationsWindowSub *aows =
+    rqpdu.GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    UserInformation ui;
+    ui = acpdu.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( *aows );
+    acpdu.SetUserInformation( ui );
+    }
+  acpdu.Write( s );
+  s.flush();
+
+  std::deque< gdcm::SmartPointer<Response> > queue;
+  std::vector<PresentationDataValue> command;
+  for( ;; )
+    {
+    const double now = GetTime();
+    bool wrote = false;
+    while( !queue.empty() && queue.front()->Due <= now )
+      {
+      WriteResponse( s, *queue.front() );
+      queue.pop_front();
+      wrote = true;
+      }
+    if( wrote ) s.flush();
+    if( s.rdbuf()->in_avail() <= 0 )
+      {
+      const double wait = queue.empty() ? 10. : queue.front()->Due - now;
+      if( !s.rdbuf()->is_readready( (int)wait, (int)((wait - (int)wait) * 1e6) ) )
+        {
+        if( queue.empty() ) break;
+        continue;
+        }
+      }
+    s.read( (char*)&itemtype, 1 );
+    if( !s ) break;
+    if( itemtype == 0x4 )
+      {
+      PDataTFPDU pdu;
+      pdu.Read( s );
+      for( size_t i = 0; i < pdu.GetNumberOfPresentationDataValues(); ++i )
+        {
+        PresentationDataValue const &pdv = pdu.GetPresentationDataValue(i);
+        if( pdv.GetIsCommand() )
+          {
+          command.push_back( pdv );
+          }
+        else if( pdv.GetIsLastFragment() )
+          {
+          gdcm::SmartPointer<Response> r = new Response;
+          r->Due = GetTime() + scp.Delay;
+          r->PresentationContextID = pdv.GetPresentationContextID();
+          r->Command = PresentationDataValue::ConcatenatePDVBlobs( command );
+          command.clear();
+          queue.push_back( r );
+          }
+        }
+      }
+    else if( itemtype == 0x5 )
+      {
+      AReleaseRQPDU release;
+      release.Read( s );
+      AReleaseRPPDU reply;
+      reply.Write( s );
+      s.flush();
+      break;
+      }
+    else
+      {
+      break;
+      }
+    }
+}
+
+static void *RunSCP(void *arg)
+{
+  StandInSCP &scp = *(StandInSCP*)arg;
+  while( !scp.Stop )
+    {
+    if( !scp.Listener->is_readready( 0, 100000 ) ) continue;
+    iosockinet s( scp.Listener->accept() );
+    int nodelay = 1;
+    s->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
+    RunAssociation( scp, s );
+    }
+  return NULL;
+}
+
+// Send the files in batches of batchsize, on a single association or on one
+// association per batch. Return the time, negative on error.
+static double Send(gdcm::ServiceClassUser &scu,
+  gdcm::PresentationContextGenerator &generator,
+  std::vector<std::string> const &filenames, uint16_t window,
+  size_t batchsize, bool reuse)
+{
+  const double t0 = GetTime();
+  bool associated = false;
+  for( size_t b = 0; b < filenames.size(); b += batchsize )
+    {
+    if( !associated )
+      {
+      if( !scu.InitializeConnection() ) return -1;
+      scu.SetPresentationContexts( generator.GetPresentationContexts() );
+      scu.SetMaxOperationsInvoked( window );
+      if( !scu.StartAssociation() ) return -1;
+      associated = true;
+      }
+    const size_t e = std::min( filenames.size(), b + batchsize );
+    std::vector<std::string> batch( filenames.begin() + b, filenames.begin() + e );
+    std::vector<uint16_t> statuses;
+    if( !scu.SendStore( batch, statuses ) ) return -1;
+    if( !reuse )
+      {
+      scu.StopAssociation();
+      associated = false;
+      }
+    }
+  if( associated ) scu.StopAssociation();
+  return GetTime() - t0;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nfiles = argc > 1 ? atoi(argv[1]) : 200;
+  const unsigned int sizekb = argc > 2 ? atoi(argv[2]) : 128;
+  const double delay = (argc > 3 ? atof(argv[3]) : 2.) * 1e-3;
+  const unsigned int maxwindow = argc > 4 ? atoi(argv[4]) : 32;
+  if( !nfiles || !sizekb || !maxwindow ) return 1;
+
+  // 16bits MONOCHROME2 square images of roughly sizekb
+  unsigned int dim = 16;
+  while( dim * dim * 2 < sizekb * 1024 ) dim += 16;
+  std::vector<unsigned short> buffer( dim * dim );
+  srand( 0 );
+  for( size_t i = 0; i < buffer.size(); ++i )
+    buffer[i] = (unsigned short)(rand() % 4096);
+  std::vector<std::string> filenames;
+  for( unsigned int i = 0; i < nfiles; ++i )
+    {
+    gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+    image->SetNumberOfDimensions( 2 );
+    image->SetDimension( 0, dim );
+    image->SetDimension( 1, dim );
+    image->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+    image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+    image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+    gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+    pixeldata.SetByteValue( (char*)&buffer[0], (uint32_t)(buffer.size() * 2) );
+    image->SetDataElement( pixeldata );
+    char filename[64];
+    sprintf( filename, "BenchmarkCStore%04u.dcm", i );
+    gdcm::ImageWriter writer;
+    writer.SetFileName( filename );
+    writer.SetImage( *image );
+    if( !writer.Write() ) return 1;
+    filenames.push_back( filename );
+    }
+  const double mb = (double)nfiles * dim * dim * 2 / (1024 * 1024);
+  gdcm::PresentationContextGenerator generator;
+  if( !generator.GenerateFromFilenames( filenames ) ) return 1;
+
+  sockinetbuf listener( sockbuf::sock_stream );
+  listener.reuseaddr( true );
+  listener.bind( (unsigned long)INADDR_LOOPBACK, 0 );
+  listener.listen();
+  StandInSCP scp;
+  scp.Listener = &listener;
+  scp.Delay = delay;
+  scp.Stop = false;
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return 1;
+
+  gdcm::SmartPointer<gdcm::ServiceClassUser> scup = new gdcm::ServiceClassUser;
+  gdcm::ServiceClassUser &scu = *scup;
+  scu.SetHostname( "127.0.0.1" );
+  scu.SetPort( (uint16_t)listener.localport() );
+  scu.SetTimeout( 10 );
+
+  std::cout << nfiles << " files of " << dim << "x" << dim << " 16bits ("
+    << std::fixed << std::setprecision(1) << mb << " MB), SCP delay "
+    << delay * 1e3 << " ms" << std::endl;
+  std::cout << std::setw(8) << "window" << std::setw(10) << "time (s)"
+    << std::setw(10) << "files/s" << std::setw(10) << "MB/s" << std::endl;
+  int res = 0;
+  for( unsigned int w = 1; w <= maxwindow; w *= 2 )
+    {
+    const double t = Send( scu, generator, filenames, (uint16_t)w, nfiles, true );
+    if( t < 0 ) { res = 1; break; }
+    std::cout << std::setw(8) << w << std::setprecision(3) << std::setw(10) << t
+      << std::setprecision(1) << std::setw(10) << nfiles / t
+      << std::setw(10) << mb / t << std::endl;
+    }
+
+  // Batches of 10 files, window maxwindow
+  const double tnew = Send( scu, generator, filenames, (uint16_t)maxwindow, 10, false );
+  const double treuse = Send( scu, generator, filenames, (uint16_t)maxwindow, 10, true );
+  if( tnew < 0 || treuse < 0 ) res = 1;
+  else
+    std::cout << "batches of 10: one association per batch " << std::setprecision(3)
+      << tnew << " s, reused association " << treuse << " s" << std::endl;
+
+  scp.Stop = true;
+  pthread_join( thread, NULL );
+  for( unsigned int i = 0; i < nfiles; ++i )
+    remove( filenames[i].c_str() );
+  return res;
+}
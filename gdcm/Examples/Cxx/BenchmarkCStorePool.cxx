@@ -0,0 +1,322 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::StoreSCUPool over loopback against a stand-in C-STORE SCP
+ * serving each association in its own thread, for 1 to 8 associations. As in
+ * BenchmarkCStore the SCP answers each C-STORE-RQ after a fixed delay, which
+ * is per association (one storage thread per association). The time
+ * includes the association negotiation.
+ *
+ * Usage:
+ *   BenchmarkCStorePool [nfiles [size_kb [delay_ms [window]]]]
+ */
+#include "gdcmStoreSCUPool.h"
+#include "gdcmAAssociateRQPDU.h"
+#include "gdcmAAssociateACPDU.h"
+#include "gdcmAReleaseRQPDU.h"
+#include "gdcmAReleaseRPPDU.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
+#include "gdcmCommandDataSet.h"
+#include "gdcmImageWriter.h"
+#include "gdcmAttribute.h"
+
+#include <socket++/sockinet.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace gdcm::network;
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// One pending C-STORE-RSP, the queue holds SmartPointers to them
+struct Response : public gdcm::Object
+{
+  double Due;
+  uint8_t PresentationContextID;
+  gdcm::DataSet Command;
+};
+
+static void WriteResponse(std::ostream &os, Response const &r)
+{
+  gdcm::CommandDataSet ds;
+  ds.Insert( r.Command.GetDataElement( gdcm::Tag(0x0,0x0002) ) );
+  ds.Insert( r.Command.GetDataElement( gdcm::Tag(0x0,0x1000) ) );
+  gdcm::Attribute<0x0,0x0100> commandfield = { 0x8001 };
+  ds.Insert( commandfield.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( r.Command );
+  gdcm::Attribute<0x0,0x0120> respondedto = { messageid.GetValue() };
+  ds.Insert( respondedto.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0800> datasettype = { 0x0101 };
+  ds.Insert( datasettype.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0900> status = { 0 };
+  ds.Insert( status.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0000> grouplength = { 0 };
+  grouplength.SetValue( ds.GetLength<gdcm::ImplicitDataElement>() );
+  ds.Insert( grouplength.GetAsDataElement() );
+
+  PresentationDataValue pdv;
+  pdv.SetPresentationContextID( r.PresentationContextID );
+  pdv.SetDataSet( ds );
+  pdv.SetMessageHeader( 3 );
+  PDataTFPDU pdu;
+  pdu.AddPresentationDataValue( pdv );
+  pdu.Write( os );
+}
+
+struct StandInSCP
+{
+  sockinetbuf *Listener;
+  double Delay;
+  volatile bool Stop;
+};
+
+struct Connection
+{
+  StandInSCP *SCP;
+  iosockinet *Socket;
+};
+
+// Accept every Presentation Context with its first Transfer Syntax and
+// whatever Asynchronous Operations Window is proposed
+static void RunAssociation(StandInSCP const &scp, iosockinet &s)
+{
+  uint8_t itemtype = 0;
+  s.read( (char*)&itemtype, 1 );
+  if( !s || itemtype != 0x1 ) return;
+  AAssociateRQPDU rqpdu;
+  rqpdu.Read( s );
+  AAssociateACPDU acpdu;
+  for( unsigned int i = 0; i < rqpdu.GetNumberOfPresentationContext(); ++i )
+    {
+    PresentationContextRQ const &pc = rqpdu.GetPresentationContext(i);
+    PresentationContextAC pcac;
+    pcac.SetPresentationContextID( pc.GetPresentationContextID() );
+    pcac.SetTransferSyntax( pc.GetTransferSyntaxes()[0] );
+    pcac.SetReason( 0 );
+    acpdu.AddPresentationContextAC( pcac );
+    }
+  acpdu.InitFromRQ( rqpdu );
+  if( const AsynchronousOperationsWindowSub *aows =
+    rqpdu.GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    UserInformation ui;
+    ui = acpdu.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( *aows );
+    acpdu.SetUserInformation( ui );
+    }
+  acpdu.Write( s );
+  s.flush();
+
+  std::deque< gdcm::SmartPointer<Response> > queue;
+  std::vector<PresentationDataValue> command;
+  for( ;; )
+    {
+    const double now = GetTime();
+    bool wrote = false;
+    while( !queue.empty() && queue.front()->Due <= now )
+      {
+      WriteResponse( s, *queue.front() );
+      queue.pop_front();
+      wrote = true;
+      }
+    if( wrote ) s.flush();
+    if( s.rdbuf()->in_avail() <= 0 )
+      {
+      const double wait = queue.empty() ? 10. : queue.front()->Due - now;
+      if( !s.rdbuf()->is_readready( (int)wait, (int)((wait - (int)wait) * 1e6) ) )
+        {
+        if( queue.empty() ) break;
+        continue;
+        }
+      }
+    s.read( (char*)&itemtype, 1 );
+    if( !s ) break;
+    if( itemtype == 0x4 )
+      {
+      PDataTFPDU pdu;
+      pdu.Read( s );
+      for( size_t i = 0; i < pdu.GetNumberOfPresentationDataValues(); ++i )
+        {
+        PresentationDataValue const &pdv = pdu.GetPresentationDataValue(i);
+        if( pdv.GetIsCommand() )
+          {
+          command.push_back( pdv );
+          }
+        else if( pdv.GetIsLastFragment() )
+          {
+          gdcm::SmartPointer<Response> r = new Response;
+          r->Due = GetTime() + scp.Delay;
+          r->PresentationContextID = pdv.GetPresentationContextID();
+          r->Command = PresentationDataValue::ConcatenatePDVBlobs( command );
+          command.clear();
+          queue.push_back( r );
+          }
+        }
+      }
+    else if( itemtype == 0x5 )
+      {
+      AReleaseRQPDU release;
+      release.Read( s );
+      AReleaseRPPDU reply;
+      reply.Write( s );
+      s.flush();
+      break;
+      }
+    else
+      {
+      break;
+      }
+    }
+}
+
+static void *RunConnection(void *arg)
+{
+  Connection *c = (Connection*)arg;
+  RunAssociation( *c->SCP, *c->Socket );
+  return NULL;
+}
+
+static void *RunSCP(void *arg)
+{
+  StandInSCP &scp = *(StandInSCP*)arg;
+  std::vector<pthread_t> threads;
+  std::vector<Connection*> connections;
+  while( !scp.Stop )
+    {
+    if( !scp.Listener->is_readready( 0, 100000 ) ) continue;
+    Connection *c = new Connection;
+    c->SCP = &scp;
+    c->Socket = new iosockinet( scp.Listener->accept() );
+    int nodelay = 1;
+    (*c->Socket)->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
+    pthread_t t;
+    if( pthread_create( &t, NULL, RunConnection, c ) ) break;
+    threads.push_back( t );
+    connections.push_back( c );
+    }
+  for( size_t i = 0; i < threads.size(); ++i )
+    {
+    pthread_join( threads[i], NULL );
+    delete connections[i]->Socket;
+    delete connections[i];
+    }
+  return NULL;
+}
+
+// Return the time, negative on error
+static double Send(uint16_t port, std::vector<std::string> const &filenames,
+  unsigned int nassoc, uint16_t window)
+{
+  gdcm::StoreSCUPool pool;
+  pool.SetHostname( "127.0.0.1" );
+  pool.SetPort( port );
+  pool.SetTimeout( 10 );
+  pool.SetNumberOfAssociations( nassoc );
+  pool.SetMaxOperationsInvoked( window );
+  std::vector<uint16_t> statuses;
+  const double t0 = GetTime();
+  if( !pool.SendStore( filenames, statuses ) ) return -1;
+  const double t = GetTime() - t0;
+  pool.Close();
+  return t;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nfiles = argc > 1 ? atoi(argv[1]) : 400;
+  const unsigned int sizekb = argc > 2 ? atoi(argv[2]) : 128;
+  const double delay = (argc > 3 ? atof(argv[3]) : 2.) * 1e-3;
+  const unsigned int window = argc > 4 ? atoi(argv[4]) : 4;
+  if( !nfiles || !sizekb || !window ) return 1;
+
+  // 16bits MONOCHROME2 square images of roughly sizekb
+  unsigned int dim = 16;
+  while( dim * dim * 2 < sizekb * 1024 ) dim += 16;
+  std::vector<unsigned short> buffer( dim * dim );
+  srand( 0 );
+  for( size_t i = 0; i < buffer.size(); ++i )
+    buffer[i] = (unsigned short)(rand() % 4096);
+  std::vector<std::string> filenames;
+  for( unsigned int i = 0; i < nfiles; ++i )
+    {
+    gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+    image->SetNumberOfDimensions( 2 );
+    image->SetDimension( 0, dim );
+    image->SetDimension( 1, dim );
+    image->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+    image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+    image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+    gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+    pixeldata.SetByteValue( (char*)&buffer[0], (uint32_t)(buffer.size() * 2) );
+    image->SetDataElement( pixeldata );
+    char filename[64];
+    sprintf( filename, "BenchmarkCStorePool%04u.dcm", i );
+    gdcm::ImageWriter writer;
+    writer.SetFileName( filename );
+    writer.SetImage( *image );
+    if( !writer.Write() ) return 1;
+    filenames.push_back( filename );
+    }
+  const double mb = (double)nfiles * dim * dim * 2 / (1024 * 1024);
+
+  sockinetbuf listener( sockbuf::sock_stream );
+  listener.reuseaddr( true );
+  listener.bind( (unsigned long)INADDR_LOOPBACK, 0 );
+  listener.listen();
+  StandInSCP scp;
+  scp.Listener = &listener;
+  scp.Delay = delay;
+  scp.Stop = false;
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return 1;
+  const uint16_t port = (uint16_t)listener.localport();
+
+  std::cout << nfiles << " files of " << dim << "x" << dim << " 16bits ("
+    << std::fixed << std::setprecision(1) << mb << " MB), SCP delay "
+    << delay * 1e3 << " ms" << std::endl;
+  std::cout << std::setw(8) << "assoc" << std::setw(16) << "files/s (w=1)"
+    << std::setw(16) << "files/s (w=" << window << ")" << std::setw(10) << "MB/s" << std::endl;
+  int res = 0;
+  for( unsigned int n = 1; n <= 8; ++n )
+    {
+    const double t1 = Send( port, filenames, n, 1 );
+    const double tw = Send( port, filenames, n, (uint16_t)window );
+    if( t1 < 0 || tw < 0 ) { res = 1; break; }
+    std::cout << std::setw(8) << n << std::setprecision(1)
+      << std::setw(16) << nfiles / t1 << std::setw(16) << nfiles / tw
+      << std::setw(10) << mb / tw << std::endl;
+    }
+
+  scp.Stop = true;
+  pthread_join( thread, NULL );
+  for( unsigned int i = 0; i < nfiles; ++i )
+    remove( filenames[i].c_str() );
+  return res;
+}
@@ -0,0 +1,137 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::ImageChangeTransferSyntax on a synthetic multi-frames image
+ * (16bits MONOCHROME2), for each lossless codec, compressing and
+ * decompressing with 1 thread and with N threads (frame parallel mode).
+ * The multi-threaded output is checked against the single threaded one.
+ *
+ * Usage:
+ *   BenchmarkChangeTransferSyntax [nframes [nthreads]]
+ */
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmImage.h"
+#include "gdcmSequenceOfFragments.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static std::string GetPixelData(gdcm::Image const &image)
+{
+  const gdcm::DataElement &de = image.GetDataElement();
+  if( const gdcm::ByteValue *bv = de.GetByteValue() )
+    return std::string( bv->GetPointer(), bv->GetLength() );
+  const gdcm::SequenceOfFragments *sf = de.GetSequenceOfFragments();
+  std::string s;
+  for( unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    s.append( bv->GetPointer(), bv->GetLength() );
+    }
+  return s;
+}
+
+// Transcode a copy of 'input', return the output (0 on error) and the time
+static gdcm::SmartPointer<gdcm::Image> Change(gdcm::Image const &input,
+  gdcm::TransferSyntax::TSType ts, unsigned int nthreads, double &t)
+{
+  gdcm::SmartPointer<gdcm::Image> copy = new gdcm::Image( input );
+  gdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax( ts );
+  change.SetNumberOfThreads( nthreads );
+  change.SetInput( *copy );
+  const double t0 = GetTime();
+  if( !change.Change() ) return 0;
+  t = GetTime() - t0;
+  return new gdcm::Image( change.GetOutput() );
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nframes = argc > 1 ? atoi(argv[1]) : 32;
+  unsigned int nthreads = argc > 2 ? atoi(argv[2]) : 0;
+  if( !nthreads ) nthreads = gdcm::System::GetNumberOfProcessors();
+  if( !nframes ) return 1;
+
+  // Disc of soft tissue on an air background, with some noise
+  gdcm::SmartPointer<gdcm::Image> raw = new gdcm::Image;
+  raw->SetNumberOfDimensions( 3 );
+  raw->SetDimension( 0, 512 );
+  raw->SetDimension( 1, 512 );
+  raw->SetDimension( 2, nframes );
+  raw->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+  raw->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  raw->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  const unsigned long len = raw->GetBufferLength();
+  std::vector<unsigned short> buffer( len / 2 );
+  srand( 0 );
+  for( unsigned int z = 0; z < nframes; ++z )
+    for( unsigned int y = 0; y < 512; ++y )
+      for( unsigned int x = 0; x < 512; ++x )
+        {
+        const double r = hypot( x - 256., y - 256. );
+        unsigned short v = 0;
+        if( r < 200 ) v = (unsigned short)(1000 + (rand() % 16) + (r < 50 ? 400 : 0));
+        buffer[ ((size_t)z * 512 + y) * 512 + x ] = v;
+        }
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( (char*)&buffer[0], (uint32_t)len );
+  raw->SetDataElement( pixeldata );
+
+  const gdcm::TransferSyntax::TSType codecs[] = {
+    gdcm::TransferSyntax::JPEGLosslessProcess14_1,
+    gdcm::TransferSyntax::JPEGLSLossless,
+    gdcm::TransferSyntax::JPEG2000Lossless,
+    gdcm::TransferSyntax::RLELossless,
+  };
+  const char *names[] = { "JPEG Lossless", "JPEG-LS Lossless", "JPEG 2000 Lossless", "RLE Lossless" };
+
+  std::cout << nframes << " frames of 512x512 16bits, " << nthreads
+    << " threads (speed-up vs 1 thread)" << std::endl;
+  std::cout << std::setw(20) << "" << std::setw(12) << "Code (s)" << std::setw(10) << "x"
+    << std::setw(14) << "Decode (s)" << std::setw(10) << "x" << std::endl;
+  int res = 0;
+  for( int c = 0; c < 4; ++c )
+    {
+    double t1, tn, d1, dn;
+    gdcm::SmartPointer<gdcm::Image> ref = Change( *raw, codecs[c], 1, t1 );
+    gdcm::SmartPointer<gdcm::Image> out = Change( *raw, codecs[c], nthreads, tn );
+    if( !ref || !out ) return 1;
+    gdcm::SmartPointer<gdcm::Image> back1 = Change( *ref, gdcm::TransferSyntax::ExplicitVRLittleEndian, 1, d1 );
+    gdcm::SmartPointer<gdcm::Image> backn = Change( *ref, gdcm::TransferSyntax::ExplicitVRLittleEndian, nthreads, dn );
+    if( !back1 || !backn ) return 1;
+    const bool ok = GetPixelData( *ref ) == GetPixelData( *out )
+      && GetPixelData( *back1 ) == GetPixelData( *backn )
+      && GetPixelData( *back1 ) == GetPixelData( *raw );
+    std::cout << std::setw(20) << names[c] << std::fixed << std::setprecision(3)
+      << std::setw(12) << tn << std::setw(10) << std::setprecision(2) << t1 / tn
+      << std::setw(14) << std::setprecision(3) << dn << std::setw(10) << std::setprecision(2) << d1 / dn
+      << (ok ? "" : "  MISMATCH") << std::endl;
+    if( !ok ) res = 1;
+    }
+  return res;
+}
@@ -0,0 +1,179 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * gdcm::DICOMDIRGenerator on a synthetic media set of MR instances (2 studies
+ * per patient, 5 series per study, 100 instances per series), in ms for 1, 2,
+ * 4... up to max_threads threads:
+ * - generate: header scan and directory records,
+ * - write: the DICOMDIR written with gdcm::Writer.
+ * Every run produces the same DICOMDIR, checked against the first one.
+ * Then the time to list the instances back from the DICOMDIR alone
+ * (gdcm::Reader and gdcm::DICOMDIR), which is what an importer pays instead
+ * of the header scan when the media set has one.
+ *
+ * Usage:
+ *   BenchmarkDICOMDIRGenerator [instances [max_threads]]
+ */
+#include "gdcmDICOMDIRGenerator.h"
+#include "gdcmDICOMDIR.h"
+#include "gdcmReader.h"
+#include "gdcmDirectory.h"
+#include "gdcmWriter.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Header only: the generator does not read the pixels
+static bool WriteMR(const char *filename, int instance)
+{
+  const int series = instance / 100;
+  const int study = series / 5;
+  const int patient = study / 2;
+  gdcm::TestingWriter w;
+  std::ostringstream uid, seriesuid, studyuid, pid, number;
+  uid << "1.2.826.0.1.3680043.2.1143.42." << instance;
+  seriesuid << "1.2.826.0.1.3680043.2.1143.43." << series;
+  studyuid << "1.2.826.0.1.3680043.2.1143.44." << study;
+  pid << "PAT" << patient;
+  number << instance % 100 + 1;
+  w.SetImage( gdcm::MediaStorage::MRImageStorage, studyuid.str(), seriesuid.str(), uid.str() );
+  w.AddString( gdcm::Tag(0x0008,0x0008), gdcm::VR::CS, "ORIGINAL\\PRIMARY" );
+  w.AddString( gdcm::Tag(0x0008,0x0020), gdcm::VR::DA, "20110101" );
+  w.AddString( gdcm::Tag(0x0008,0x0030), gdcm::VR::TM, "120000" );
+  w.AddString( gdcm::Tag(0x0008,0x0050), gdcm::VR::SH, "A42" );
+  w.AddString( gdcm::Tag(0x0008,0x1030), gdcm::VR::LO, "BRAIN" );
+  w.AddString( gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, pid.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0010), gdcm::VR::SH, "1" );
+  w.AddString( gdcm::Tag(0x0020,0x0011), gdcm::VR::IS, "1" );
+  w.AddString( gdcm::Tag(0x0020,0x0013), gdcm::VR::IS, number.str() );
+  w.AddString( gdcm::Tag(0x0028,0x0004), gdcm::VR::CS, "MONOCHROME2" );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+static std::string ReadFile(const char *filename)
+{
+  std::ifstream is( filename, std::ios::binary );
+  std::ostringstream os;
+  os << is.rdbuf();
+  return os.str();
+}
+
+int main(int argc, char *argv[])
+{
+  const int ninstances = argc > 1 ? atoi(argv[1]) : 10000;
+  const int maxthreads = argc > 2 ? atoi(argv[2]) : 8;
+  if( ninstances <= 0 || maxthreads <= 0 ) return 1;
+
+  // ISO 9660 names: PAT00000/SER00000/IM000000
+  const char tmpdir[] = "BenchmarkDICOMDIRGenerator";
+  gdcm::System::MakeDirectory( tmpdir );
+  gdcm::Directory::FilenamesType filenames;
+  for( int i = 0; i < ninstances; ++i )
+    {
+    char name[64];
+    sprintf( name, "%s/PAT%05d/SER%05d", tmpdir, i / 1000, i / 100 );
+    if( i % 100 == 0 ) gdcm::System::MakeDirectory( name );
+    sprintf( name + strlen( name ), "/IM%06d", i );
+    if( !WriteMR( name, i ) )
+      {
+      std::cerr << "Could not write " << name << std::endl;
+      return 1;
+      }
+    filenames.push_back( name );
+    }
+
+  std::cout << ninstances << " instances" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(12) << "generate"
+    << std::setw(10) << "write" << std::setw(12) << "files/s" << std::setw(10) << "speedup" << std::endl;
+  int res = 0;
+  double t1 = 0;
+  std::string reference;
+  std::string outfilename = std::string( tmpdir ) + "/DICOMDIR";
+  for( int n = 1; n <= maxthreads && !res; n *= 2 )
+    {
+    gdcm::DICOMDIRGenerator gen;
+    gen.SetFilenames( filenames );
+    gen.SetRootDirectory( tmpdir );
+    gen.SetDescriptor( "BENCHMARK" );
+    gen.SetNumberOfThreads( n );
+    const double t0 = GetTime();
+    if( !gen.Generate() )
+      {
+      std::cerr << "Generate failed with " << n << " threads" << std::endl;
+      res = 1;
+      break;
+      }
+    const double tg = GetTime();
+    gdcm::Writer writer;
+    writer.SetFile( gen.GetFile() );
+    writer.SetFileName( outfilename.c_str() );
+    if( !writer.Write() )
+      {
+      std::cerr << "Could not write " << outfilename << std::endl;
+      res = 1;
+      break;
+      }
+    const double t = GetTime() - t0;
+    // Same records whatever the number of threads (the header UID differs)
+    std::string dicomdir = ReadFile( outfilename.c_str() );
+    dicomdir.erase( 0, gen.GetFile().GetHeader().GetFullLength() );
+    if( n == 1 ) { t1 = t; reference = dicomdir; }
+    else if( dicomdir != reference )
+      {
+      std::cerr << "Different DICOMDIR with " << n << " threads" << std::endl;
+      res = 1;
+      }
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(1)
+      << std::setw(12) << 1000 * (tg - t0) << std::setw(10) << 1000 * (t - (tg - t0))
+      << std::setw(12) << ninstances / t << std::setprecision(2) << std::setw(10) << t1 / t << std::endl;
+    }
+
+  if( !res )
+    {
+    const double t0 = GetTime();
+    gdcm::Reader reader;
+    reader.SetFileName( outfilename.c_str() );
+    gdcm::DICOMDIR dd;
+    if( !reader.Read() || !dd.SetFromFile( reader.GetFile() )
+      || dd.GetFileRecords().size() != (size_t)ninstances )
+      {
+      std::cerr << "Could not list the instances from " << outfilename << std::endl;
+      res = 1;
+      }
+    const double t = GetTime() - t0;
+    std::cout << "read DICOMDIR: " << std::fixed << std::setprecision(1) << 1000 * t << " ms, "
+      << std::setprecision(0) << ninstances / t << " files/s" << std::endl;
+    }
+
+  gdcm::System::DeleteDirectory( tmpdir );
+  return res;
+}
@@ -0,0 +1,93 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Compare gdcm::Directory (serial, one stat per entry) with
+ * gdcm::DirectoryWalker (parallel, d_type) on a directory tree.
+ *
+ * Usage:
+ *   BenchmarkDirectoryWalker /path/to/tree
+ *   BenchmarkDirectoryWalker /tmp/tree 6 4 10
+ * In the second form a tree of depth 6, fanout 4 and 10 files per directory
+ * is created first. Drop the page cache between runs for cold numbers.
+ */
+#include "gdcmDirectory.h"
+#include "gdcmDirectoryWalker.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void CreateTree(std::string const &root, int depth, int fanout, int nfiles)
+{
+  gdcm::System::MakeDirectory( root.c_str() );
+  for( int f = 0; f < nfiles; ++f )
+    {
+    std::ostringstream os;
+    os << root << "/IM" << f << ".dcm";
+    std::ofstream out( os.str().c_str() );
+    }
+  if( depth == 0 ) return;
+  for( int d = 0; d < fanout; ++d )
+    {
+    std::ostringstream os;
+    os << root << "/SE" << d;
+    CreateTree( os.str(), depth - 1, fanout, nfiles );
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << argv[0] << " directory [depth fanout nfiles]" << std::endl;
+    return 1;
+    }
+  const std::string root = argv[1];
+  if( argc == 5 )
+    {
+    CreateTree( root, atoi(argv[2]), atoi(argv[3]), atoi(argv[4]) );
+    }
+
+  double t0 = GetTime();
+  gdcm::Directory d;
+  const unsigned int nref = d.Load( root, true );
+  const double tref = GetTime() - t0;
+  std::cout << "Directory::Load       : " << nref << " files in "
+    << tref << "s" << std::endl;
+
+  const unsigned int nthreads[] = { 1, 2, 4, 8, 16 };
+  for( unsigned int i = 0; i < sizeof(nthreads) / sizeof(*nthreads); ++i )
+    {
+    gdcm::DirectoryWalker w;
+    w.SetNumberOfThreads( nthreads[i] );
+    t0 = GetTime();
+    const unsigned int n = w.Walk( root );
+    const double t = GetTime() - t0;
+    std::cout << "DirectoryWalker (" << nthreads[i] << "t) : " << n << " files in "
+      << t << "s, speedup x" << (t > 0 ? tref / t : 0) << std::endl;
+    if( n != nref ) return 1;
+    }
+
+  return 0;
+}
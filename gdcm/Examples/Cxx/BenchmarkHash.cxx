@@ -0,0 +1,98 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * SHA-1 and SHA-256 throughput, in MB/s, for messages from 4 KiB up to
+ * max_size (default 256 MiB, up to 4 GiB), with every instruction set
+ * supported by the CPU. XXH3 (SSE2 or NEON, whatever the instruction set) is
+ * given as a reference on each line. Messages larger than 1 MiB are streamed from one
+ * reused 1 MiB buffer, as SHA1::ComputeFile does, so that the memory use stays
+ * flat whatever the size.
+ *
+ * Usage:
+ *   BenchmarkHash [max_size_in_MiB]
+ */
+#include "gdcmHashKernels.h"
+#include "gdcmSHA1.h"
+#include "gdcmSHA256.h"
+#include "gdcmXXHash3.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+typedef gdcm::HashKernels HK;
+
+// MB/s to hash 'size' bytes, repeated so that a run lasts 0.2 s at least
+template <typename T, int N>
+static double Run(const std::vector<char> &buffer, uint64_t size)
+{
+  T sha;
+  unsigned char digest[N];
+  uint64_t total = 0;
+  const double t0 = GetTime();
+  double t;
+  do
+    {
+    for( uint64_t done = 0; done < size; )
+      {
+      const size_t len = (size_t)(size - done < buffer.size() ? size - done : buffer.size());
+      sha.Update( &buffer[0], len );
+      done += len;
+      }
+    sha.Final( digest );
+    total += size;
+    t = GetTime() - t0;
+    } while( t < 0.2 );
+  return total / t / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+  const int maxmib = argc > 1 ? atoi(argv[1]) : 256;
+  if( maxmib <= 0 || maxmib > 4096 ) return 1;
+  const uint64_t maxsize = (uint64_t)maxmib << 20;
+
+  std::vector<char> buffer( 1 << 20 );
+  for( size_t i = 0; i < buffer.size(); ++i ) buffer[i] = (char)(rand() & 0xff);
+
+  const HK::InstructionSetType sets[] = { HK::SCALAR, HK::SHANI, HK::ARMV8 };
+  std::cout << std::setw(12) << "size" << std::setw(8) << "isa"
+    << std::setw(12) << "SHA1 MB/s" << std::setw(12) << "SHA256 MB/s"
+    << std::setw(12) << "XXH3 MB/s" << std::endl;
+  for( uint64_t size = 4096; size <= maxsize; size *= 4 )
+    {
+    for( size_t i = 0; i < sizeof(sets) / sizeof(*sets); ++i )
+      {
+      if( !HK::SetInstructionSet( sets[i] ) ) continue;
+      const double sha1 = Run<gdcm::SHA1, 20>( buffer, size );
+      const double sha256 = Run<gdcm::SHA256, 32>( buffer, size );
+      const double xxh3 = Run<gdcm::XXHash3, 8>( buffer, size );
+      std::cout << std::setw(12) << size << std::setw(8)
+        << HK::GetInstructionSetString( sets[i] ) << std::fixed << std::setprecision(0)
+        << std::setw(12) << sha1 << std::setw(12) << sha256
+        << std::setw(12) << xxh3 << std::endl;
+      }
+    }
+  HK::SetInstructionSet( HK::GetBestInstructionSet() );
+  return 0;
+}
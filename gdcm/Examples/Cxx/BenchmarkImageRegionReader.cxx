@@ -0,0 +1,121 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::ImageRegionReader on a synthetic encapsulated multi-frames image
+ * (512x512 16bits MONOCHROME2), reading a single frame at increasing
+ * positions: the time should not depend on the frame number. The first read
+ * of a file without Basic Offset Table also scans the Fragment headers once.
+ *
+ * Usage:
+ *   BenchmarkImageRegionReader [nframes [transfer syntax: jpeg|jpegls|j2k|rle]]
+ */
+#include "gdcmImageRegionReader.h"
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmImageWriter.h"
+#include "gdcmBoxRegion.h"
+#include "gdcmImage.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nframes = argc > 1 ? atoi(argv[1]) : 256;
+  const std::string name = argc > 2 ? argv[2] : "rle";
+  if( !nframes ) return 1;
+  gdcm::TransferSyntax::TSType ts = gdcm::TransferSyntax::RLELossless;
+  if( name == "jpeg" ) ts = gdcm::TransferSyntax::JPEGLosslessProcess14_1;
+  else if( name == "jpegls" ) ts = gdcm::TransferSyntax::JPEGLSLossless;
+  else if( name == "j2k" ) ts = gdcm::TransferSyntax::JPEG2000Lossless;
+
+  // Disc of soft tissue on an air background, with some noise
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 3 );
+  image->SetDimension( 0, 512 );
+  image->SetDimension( 1, 512 );
+  image->SetDimension( 2, nframes );
+  image->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+  image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  std::vector<unsigned short> buffer( image->GetBufferLength() / 2 );
+  srand( 0 );
+  for( unsigned int z = 0; z < nframes; ++z )
+    for( unsigned int y = 0; y < 512; ++y )
+      for( unsigned int x = 0; x < 512; ++x )
+        {
+        const double r = hypot( x - 256., y - 256. );
+        unsigned short v = 0;
+        if( r < 200 ) v = (unsigned short)(1000 + (rand() % 16) + (r < 50 ? 400 : 0));
+        buffer[ ((size_t)z * 512 + y) * 512 + x ] = v;
+        }
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( (char*)&buffer[0], (uint32_t)(buffer.size() * 2) );
+  image->SetDataElement( pixeldata );
+
+  gdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax( ts );
+  change.SetNumberOfThreads( 0 );
+  change.SetInput( *image );
+  if( !change.Change() ) return 1;
+  const char filename[] = "BenchmarkImageRegionReader.dcm";
+  gdcm::ImageWriter writer;
+  writer.SetFileName( filename );
+  writer.SetImage( change.GetOutput() );
+  if( !writer.Write() ) return 1;
+
+  std::cout << nframes << " frames of 512x512 16bits, " << gdcm::TransferSyntax(ts) << std::endl;
+  std::cout << std::setw(8) << "frame" << std::setw(14) << "first (ms)"
+    << std::setw(14) << "next (ms)" << std::endl;
+
+  int res = 0;
+  std::vector<char> out( 512 * 512 * 2 );
+  const unsigned int frames[] = { 0, nframes / 4, nframes / 2, nframes - 1 };
+  for( int i = 0; i < 4; ++i )
+    {
+    const unsigned int z = frames[i];
+    gdcm::ImageRegionReader reader;
+    reader.SetFileName( filename );
+    if( !reader.ReadInformation() ) return 1;
+    gdcm::BoxRegion box;
+    box.SetDomain( 0, 511, 0, 511, z, z );
+    reader.SetRegion( box );
+    double t0 = GetTime();
+    if( !reader.ReadIntoBuffer( &out[0], out.size() ) ) return 1;
+    const double tfirst = GetTime() - t0;
+    t0 = GetTime();
+    if( !reader.ReadIntoBuffer( &out[0], out.size() ) ) return 1;
+    const double tnext = GetTime() - t0;
+    const bool ok = memcmp( &out[0], &buffer[(size_t)z * 512 * 512], out.size() ) == 0;
+    std::cout << std::setw(8) << z << std::fixed << std::setprecision(2)
+      << std::setw(14) << tfirst * 1e3 << std::setw(14) << tnext * 1e3
+      << (ok ? "" : "  MISMATCH") << std::endl;
+    if( !ok ) res = 1;
+    }
+  remove( filename );
+  return res;
+}
@@ -0,0 +1,206 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::JPEG2000Codec Code/Decode on a synthetic multi-frames image
+ * (16bits MONOCHROME2, CT like), lossless and lossy (10:1), for an increasing
+ * number of threads, and check that the output does not depend on the number
+ * of threads. Each run is done in a child process, whose peak resident size
+ * is reported (input image included).
+ *
+ * Usage:
+ *   BenchmarkJPEG2000Codec [nframes [max_threads]]
+ */
+#include "gdcmJPEG2000Codec.h"
+#include "gdcmDataElement.h"
+#include "gdcmSequenceOfFragments.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void Setup(gdcm::JPEG2000Codec &codec, const unsigned int dims[3], bool lossy)
+{
+  codec.SetDimensions( dims );
+  codec.SetNumberOfDimensions( 3 );
+  codec.SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+  codec.SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  if( lossy )
+    {
+    codec.SetReversible( false );
+    codec.SetRate( 0, 10 );
+    }
+}
+
+// FNV-1a
+static uint64_t Hash(const char *p, size_t len, uint64_t h = 14695981039346656037ULL)
+{
+  for( size_t i = 0; i < len; ++i )
+    {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+    }
+  return h;
+}
+
+struct Result
+{
+  double Code;
+  double Decode;
+  uint64_t CodeHash;
+  uint64_t DecodeHash;
+  size_t CodeLength;
+  bool Ok;
+};
+
+static Result Run(const gdcm::DataElement &raw, const unsigned int dims[3],
+  bool lossy, unsigned int nthreads)
+{
+  Result r;
+  memset( &r, 0, sizeof(r) );
+  gdcm::JPEG2000Codec coder;
+  Setup( coder, dims, lossy );
+  coder.SetNumberOfThreads( nthreads );
+  gdcm::DataElement compressed;
+  double t0 = GetTime();
+  if( !coder.Code( raw, compressed ) ) return r;
+  r.Code = GetTime() - t0;
+
+  gdcm::JPEG2000Codec decoder;
+  Setup( decoder, dims, lossy );
+  decoder.SetNumberOfThreads( nthreads );
+  gdcm::DataElement decompressed;
+  t0 = GetTime();
+  if( !decoder.Decode( compressed, decompressed ) ) return r;
+  r.Decode = GetTime() - t0;
+
+  const gdcm::SequenceOfFragments *sf = compressed.GetSequenceOfFragments();
+  r.CodeHash = Hash( "", 0 );
+  for( unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    r.CodeHash = Hash( bv->GetPointer(), bv->GetLength(), r.CodeHash );
+    r.CodeLength += bv->GetLength();
+    }
+  const gdcm::ByteValue *in = raw.GetByteValue();
+  const gdcm::ByteValue *bv = decompressed.GetByteValue();
+  r.Ok = bv && bv->GetLength() == in->GetLength()
+    && decoder.IsLossy() == lossy
+    && (lossy || memcmp( bv->GetPointer(), in->GetPointer(), in->GetLength() ) == 0);
+  if( bv ) r.DecodeHash = Hash( bv->GetPointer(), bv->GetLength() );
+  return r;
+}
+
+// Run in a child process, for its peak resident size (in kB)
+static bool RunChild(const gdcm::DataElement &raw, const unsigned int dims[3],
+  bool lossy, unsigned int nthreads, Result &r, long &peak)
+{
+  int fd[2];
+  if( pipe( fd ) ) return false;
+  std::cout.flush();
+  const pid_t pid = fork();
+  if( pid < 0 ) return false;
+  if( pid == 0 )
+    {
+    close( fd[0] );
+    r = Run( raw, dims, lossy, nthreads );
+    const bool written = write( fd[1], &r, sizeof(r) ) == (ssize_t)sizeof(r);
+    _exit( written ? 0 : 1 );
+    }
+  close( fd[1] );
+  const bool b = read( fd[0], &r, sizeof(r) ) == (ssize_t)sizeof(r);
+  close( fd[0] );
+  int status;
+  struct rusage ru;
+  if( wait4( pid, &status, 0, &ru ) != pid ) return false;
+  peak = ru.ru_maxrss;
+  return b && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nframes = argc > 1 ? atoi(argv[1]) : 16;
+  unsigned int maxthreads = argc > 2 ? atoi(argv[2]) : 0;
+  if( !maxthreads ) maxthreads = gdcm::System::GetNumberOfProcessors();
+  if( !nframes ) return 1;
+
+  // Disc of soft tissue on an air background, with some noise: compress
+  // roughly like a real CT image
+  const unsigned int dims[3] = { 512, 512, nframes };
+  const size_t len = (size_t)dims[0] * dims[1] * dims[2] * 2;
+  std::vector<unsigned short> image( len / 2 );
+  srand( 0 );
+  for( unsigned int z = 0; z < dims[2]; ++z )
+    for( unsigned int y = 0; y < dims[1]; ++y )
+      for( unsigned int x = 0; x < dims[0]; ++x )
+        {
+        const double r = hypot( x - 256., y - 256. );
+        unsigned short v = 0;
+        if( r < 200 ) v = (unsigned short)(1000 + (rand() % 16) + (r < 50 ? 400 : 0));
+        image[ ((size_t)z * dims[1] + y) * dims[0] + x ] = v;
+        }
+  gdcm::DataElement raw;
+  raw.SetByteValue( (char*)&image[0], (uint32_t)len );
+
+  std::cout << nframes << " frames of " << dims[0] << "x" << dims[1]
+    << " 16bits, " << len / (1024 * 1024) << " MB" << std::endl;
+
+  int res = 0;
+  for( int lossy = 0; lossy < 2; ++lossy )
+    {
+    std::cout << (lossy ? "lossy (10:1)" : "lossless") << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "Code (ms)"
+      << std::setw(14) << "Decode (ms)" << std::setw(10) << "speedup"
+      << std::setw(8) << "ratio" << std::setw(12) << "peak (MB)" << std::endl;
+    Result ref;
+    memset( &ref, 0, sizeof(ref) );
+    for( unsigned int t = 1; t <= maxthreads; t *= 2 )
+      {
+      Result r;
+      long peak = 0;
+      if( !RunChild( raw, dims, lossy != 0, t, r, peak ) || !r.Code )
+        {
+        std::cerr << "Code/Decode failed with " << t << " threads" << std::endl;
+        return 1;
+        }
+      if( t == 1 ) ref = r;
+      const bool ok = r.Ok && r.CodeHash == ref.CodeHash
+        && r.DecodeHash == ref.DecodeHash;
+      std::cout << std::setw(8) << t << std::fixed << std::setprecision(1)
+        << std::setw(12) << 1000 * r.Code << std::setw(14) << 1000 * r.Decode
+        << std::setprecision(2) << std::setw(10)
+        << (ref.Code + ref.Decode) / (r.Code + r.Decode)
+        << std::setprecision(1) << std::setw(8) << (double)len / r.CodeLength
+        << std::setw(12) << peak / 1024. << (ok ? "" : "  MISMATCH") << std::endl;
+      if( !ok ) res = 1;
+      if( t == maxthreads ) break;
+      if( 2 * t > maxthreads ) t = maxthreads / 2; // always run maxthreads
+      }
+    }
+  return res;
+}
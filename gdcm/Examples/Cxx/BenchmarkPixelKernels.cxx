@@ -0,0 +1,141 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Throughput (GB/s of input) of the gdcm::PixelKernels for each instruction
+ * set available on this machine, and check the output is bit-exact with the
+ * scalar code.
+ *
+ * Usage:
+ *   BenchmarkPixelKernels [size_in_MB [iterations]]
+ */
+#include "gdcmPixelKernels.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+typedef gdcm::PixelKernels PK;
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static size_t Size;
+static int Iterations;
+static std::vector<unsigned char> In, Out;
+
+// Return GB/s, the first output is kept in 'ref' to compare the implementations
+static double Run(int kernel, std::vector<unsigned char> &ref)
+{
+  std::vector<unsigned char> work;
+  double total = 0;
+  for( int it = 0; it < Iterations; ++it )
+    {
+    work = In; // in-place kernels
+    const double t0 = GetTime();
+    switch(kernel)
+      {
+    case 0:
+      PK::SwapBytes16((uint16_t*)&work[0], Size / 2);
+      break;
+    case 1:
+      PK::SwapBytes32((uint32_t*)&work[0], Size / 4);
+      break;
+    case 2:
+      PK::Unpack12Bits((uint16_t*)&Out[0], &work[0], Size / 3 * 3);
+      break;
+    case 3:
+      PK::Pack12Bits(&Out[0], (const uint16_t*)&work[0], Size / 2);
+      break;
+    case 4:
+      PK::Rescale(&Out[0], PK::FLOAT32, &work[0], PK::INT16, -1024, 1, Size / 2);
+      break;
+    case 5:
+      PK::Rescale(&Out[0], PK::FLOAT64, &work[0], PK::UINT16, 0.5, 2.5, Size / 2);
+      break;
+    case 6:
+      PK::InverseRescale(&Out[0], PK::UINT16, &work[0], PK::FLOAT32, -1024, 1, Size / 4);
+      break;
+      }
+    total += GetTime() - t0;
+    }
+  // in-place kernels: the result is the work buffer
+  const std::vector<unsigned char> &result = kernel < 2 ? work : Out;
+  if( ref.empty() )
+    ref = result;
+  else if( ref != result )
+    return -1;
+  return (double)Size * Iterations / total / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  Size = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+  Iterations = argc > 2 ? atoi(argv[2]) : 10;
+  if( !Size || Iterations <= 0 ) return 1;
+
+  In.resize( Size );
+  Out.resize( 4 * Size ); // Rescale into FLOAT64
+  srand( 0 );
+  for( size_t i = 0; i < Size; ++i )
+    {
+    In[i] = (unsigned char)(rand() & 0xff);
+    }
+  // keep the floats of InverseRescale small
+  for( size_t i = 0; i + 4 <= Size; i += 4 )
+    {
+    const float f = (float)(rand() % 4096);
+    memcpy(&In[i], &f, 4);
+    }
+
+  const char *names[] = { "SwapBytes16", "SwapBytes32", "Unpack12Bits",
+    "Pack12Bits", "Rescale s16->f32", "Rescale u16->f64", "InverseRescale f32->u16" };
+  const PK::InstructionSetType sets[] = { PK::SCALAR, PK::SSE2, PK::AVX2, PK::NEON };
+  const PK::InstructionSetType best = PK::GetInstructionSet();
+
+  int res = 0;
+  std::cout << std::setw(24) << "GB/s";
+  for( int s = 0; s < 4; ++s )
+    if( PK::IsInstructionSetSupported(sets[s]) )
+      std::cout << std::setw(10) << PK::GetInstructionSetString(sets[s]);
+  std::cout << std::endl;
+  for( int k = 0; k < 7; ++k )
+    {
+    std::vector<unsigned char> ref;
+    std::fill( Out.begin(), Out.end(), 0 );
+    std::cout << std::setw(24) << names[k];
+    for( int s = 0; s < 4; ++s )
+      {
+      if( !PK::SetInstructionSet(sets[s]) ) continue;
+      const double gbs = Run(k, ref);
+      if( gbs < 0 )
+        {
+        std::cout << std::setw(10) << "MISMATCH";
+        res = 1;
+        }
+      else
+        std::cout << std::setw(10) << std::fixed << std::setprecision(2) << gbs;
+      }
+    std::cout << std::endl;
+    }
+  PK::SetInstructionSet( best );
+  return res;
+}
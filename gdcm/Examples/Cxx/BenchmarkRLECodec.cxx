@@ -0,0 +1,128 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Time gdcm::RLECodec Code/Decode on a synthetic multi-frames image (16bits
+ * MONOCHROME2, CT like), for an increasing number of threads, and check that
+ * the output does not depend on the number of threads.
+ *
+ * Usage:
+ *   BenchmarkRLECodec [nframes [max_threads]]
+ */
+#include "gdcmRLECodec.h"
+#include "gdcmDataElement.h"
+#include "gdcmSequenceOfFragments.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void Setup(gdcm::RLECodec &codec, const unsigned int dims[3])
+{
+  codec.SetDimensions( dims );
+  codec.SetNumberOfDimensions( 3 );
+  codec.SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+  codec.SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  codec.SetBufferLength( dims[0] * dims[1] * dims[2] * 2 );
+}
+
+static std::string ToString(const gdcm::DataElement &de)
+{
+  const gdcm::SequenceOfFragments *sf = de.GetSequenceOfFragments();
+  std::string s;
+  for( unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    s.append( bv->GetPointer(), bv->GetLength() );
+    }
+  return s;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nframes = argc > 1 ? atoi(argv[1]) : 64;
+  unsigned int maxthreads = argc > 2 ? atoi(argv[2]) : 0;
+  if( !maxthreads ) maxthreads = gdcm::System::GetNumberOfProcessors();
+  if( !nframes ) return 1;
+
+  // Disc of soft tissue on an air background, with some noise: compress
+  // roughly like a real CT image
+  const unsigned int dims[3] = { 512, 512, nframes };
+  const size_t len = (size_t)dims[0] * dims[1] * dims[2] * 2;
+  std::vector<unsigned short> image( len / 2 );
+  srand( 0 );
+  for( unsigned int z = 0; z < dims[2]; ++z )
+    for( unsigned int y = 0; y < dims[1]; ++y )
+      for( unsigned int x = 0; x < dims[0]; ++x )
+        {
+        const double r = hypot( x - 256., y - 256. );
+        unsigned short v = 0;
+        if( r < 200 ) v = (unsigned short)(1000 + (rand() % 16) + (r < 50 ? 400 : 0));
+        image[ ((size_t)z * dims[1] + y) * dims[0] + x ] = v;
+        }
+  gdcm::DataElement raw;
+  raw.SetByteValue( (char*)&image[0], (uint32_t)len );
+
+  std::cout << nframes << " frames of " << dims[0] << "x" << dims[1]
+    << " 16bits, " << len / (1024 * 1024) << " MB" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "Code (MB/s)"
+    << std::setw(16) << "Decode (MB/s)" << std::endl;
+
+  int res = 0;
+  std::string refcode;
+  for( unsigned int t = 1; t <= maxthreads; t *= 2 )
+    {
+    gdcm::RLECodec coder;
+    Setup( coder, dims );
+    coder.SetNumberOfThreads( t );
+    gdcm::DataElement compressed;
+    double t0 = GetTime();
+    if( !coder.Code( raw, compressed ) ) return 1;
+    const double tcode = GetTime() - t0;
+
+    gdcm::RLECodec decoder;
+    Setup( decoder, dims );
+    decoder.SetNumberOfThreads( t );
+    gdcm::DataElement decompressed;
+    t0 = GetTime();
+    if( !decoder.Decode( compressed, decompressed ) ) return 1;
+    const double tdecode = GetTime() - t0;
+
+    const std::string code = ToString( compressed );
+    if( refcode.empty() ) refcode = code;
+    const gdcm::ByteValue *bv = decompressed.GetByteValue();
+    const bool ok = code == refcode && bv && bv->GetLength() == len
+      && memcmp( bv->GetPointer(), &image[0], len ) == 0;
+    std::cout << std::setw(8) << t << std::fixed << std::setprecision(1)
+      << std::setw(14) << len / tcode / 1e6
+      << std::setw(16) << len / tdecode / 1e6
+      << (ok ? "" : "  MISMATCH") << std::endl;
+    if( !ok ) res = 1;
+    if( t == maxthreads ) break;
+    if( 2 * t > maxthreads ) t = maxthreads / 2; // always run maxthreads
+    }
+  return res;
+}
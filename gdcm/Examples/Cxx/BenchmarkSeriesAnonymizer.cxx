@@ -0,0 +1,177 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * gdcm::SeriesAnonymizer (Basic Application Level Confidentiality Profile)
+ * on a synthetic study of MR files, in files per second for 1, 2, 4... up
+ * to max_threads threads. Each run de-identifies a fresh copy of the input.
+ *
+ * Without a certificate the encrypted attributes are a plain copy, so that
+ * the numbers are about the de-identification and not about the cipher.
+ *
+ * Usage:
+ *   BenchmarkSeriesAnonymizer [files [max_threads [certificate.pem]]]
+ */
+#include "gdcmSeriesAnonymizer.h"
+#include "gdcmAnonymizer.h"
+#include "gdcmCryptoFactory.h"
+#include "gdcmCryptographicMessageSyntax.h"
+#include "gdcmGlobal.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h> // rmdir
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+class CopyCryptographicMessageSyntax : public gdcm::CryptographicMessageSyntax
+{
+public:
+  bool ParseCertificateFile( const char * ) { return true; }
+  bool ParseKeyFile( const char * ) { return true; }
+  bool SetPassword(const char *, size_t ) { return true; }
+  void SetCipherType(CipherTypes ) {}
+  CipherTypes GetCipherType() const { return AES256_CIPHER; }
+  bool Encrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+    if( len > outlen ) return false;
+    memcpy( output, array, len );
+    outlen = len;
+    return true;
+    }
+  bool Decrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+    return Encrypt( output, outlen, array, len );
+    }
+};
+
+// 256x256 MR slice, 4 series per study
+static bool WriteMR(const char *filename, int instance)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream uid;
+  uid << "1.2.826.0.1.3680043.2.1143.42." << instance;
+  std::ostringstream seriesuid;
+  seriesuid << "1.2.826.0.1.3680043.2.1143.43." << instance % 4;
+  w.SetImage( gdcm::MediaStorage::MRImageStorage, "1.2.826.0.1.3680043.2.1143.41",
+    seriesuid.str(), uid.str() );
+  w.AddString( gdcm::Tag(0x0008,0x0020), gdcm::VR::DA, "20110101" );
+  w.AddString( gdcm::Tag(0x0008,0x0080), gdcm::VR::LO, "General Hospital" );
+  w.AddString( gdcm::Tag(0x0008,0x0090), gdcm::VR::PN, "Smith^Jane" );
+  w.AddString( gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, "12345" );
+  w.AddString( gdcm::Tag(0x0010,0x0030), gdcm::VR::DA, "19700101" );
+  w.AddString( gdcm::Tag(0x0010,0x0040), gdcm::VR::CS, "M" );
+  w.AddString( gdcm::Tag(0x0018,0x1030), gdcm::VR::LO, "T1 AXIAL" );
+  w.AddString( gdcm::Tag(0x0020,0x0052), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.44" );
+  std::string pixels( 256 * 256 * 2, 0 );
+  for( size_t i = 0; i < pixels.size(); ++i ) pixels[i] = (char)(i * 7 + instance);
+  w.SetPixelData( 256, 256, pixels );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+int main(int argc, char *argv[])
+{
+  const int nfiles = argc > 1 ? atoi(argv[1]) : 256;
+  const int maxthreads = argc > 2 ? atoi(argv[2]) : 8;
+  const char *certificate = argc > 3 ? argv[3] : NULL;
+  if( nfiles <= 0 || maxthreads <= 0 ) return 1;
+
+  gdcm::Global& g = gdcm::Global::GetInstance();
+  if( !g.LoadResourcesFiles() )
+    {
+    std::cerr << "Could not load the resources (Part3.xml)" << std::endl;
+    return 1;
+    }
+
+  CopyCryptographicMessageSyntax copy;
+  gdcm::CryptographicMessageSyntax *cms = &copy;
+  gdcm::CryptographicMessageSyntax *provider = NULL;
+  if( certificate )
+    {
+    gdcm::CryptoFactory *factory = gdcm::CryptoFactory::GetFactoryInstance();
+    provider = factory ? factory->CreateCMSProvider() : NULL;
+    if( !provider || !provider->ParseCertificateFile( certificate ) )
+      {
+      std::cerr << "Could not use the certificate: " << certificate << std::endl;
+      delete provider;
+      return 1;
+      }
+    cms = provider;
+    }
+
+  const char tmpdir[] = "BenchmarkSeriesAnonymizer";
+  gdcm::System::MakeDirectory( tmpdir );
+  std::vector<std::string> filenames;
+  std::vector<std::string> outfilenames;
+  for( int i = 0; i < nfiles; ++i )
+    {
+    std::ostringstream name;
+    name << tmpdir << "/" << i << ".dcm";
+    if( !WriteMR( name.str().c_str(), i ) )
+      {
+      std::cerr << "Could not write " << name.str() << std::endl;
+      delete provider;
+      return 1;
+      }
+    filenames.push_back( name.str() );
+    outfilenames.push_back( name.str() + ".anon" );
+    }
+
+  std::cout << std::setw(8) << "threads" << std::setw(10) << "ms"
+    << std::setw(12) << "files/s" << std::setw(10) << "speedup" << std::endl;
+  int res = 0;
+  double t1 = 0;
+  for( int n = 1; n <= maxthreads && !res; n *= 2 )
+    {
+    gdcm::Anonymizer::ClearInternalUIDs();
+    gdcm::SeriesAnonymizer sa;
+    sa.SetCryptographicMessageSyntax( cms );
+    sa.SetNumberOfThreads( n );
+    const double t0 = GetTime();
+    if( !sa.Anonymize( filenames, outfilenames ) )
+      {
+      std::cerr << "Anonymize failed with " << n << " threads" << std::endl;
+      res = 1;
+      break;
+      }
+    const double t = GetTime() - t0;
+    if( n == 1 ) t1 = t;
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(1)
+      << std::setw(10) << 1000 * t << std::setw(12) << nfiles / t
+      << std::setw(10) << t1 / t << std::endl;
+    }
+
+  for( int i = 0; i < nfiles; ++i )
+    {
+    remove( filenames[i].c_str() );
+    remove( outfilenames[i].c_str() );
+    }
+  rmdir( tmpdir );
+  delete provider;
+  return res;
+}
@@ -0,0 +1,158 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Sorting a synthetic fMRI series (32 slices per volume, 32x32 images),
+ * in ms for 1, 2, 4... up to max_threads threads:
+ * - header: gdcm::Sorter on position then time, reading every attribute
+ *   but the Pixel Data (the default),
+ * - tags: the same, reading only the Image Position (Patient) and the
+ *   Acquisition Time (Sorter::SetTagsToRead),
+ * - ipp: gdcm::IPPSorter keeping the duplicate positions.
+ * All of them must give the same order.
+ *
+ * Usage:
+ *   BenchmarkSorter [slices [max_threads]]
+ */
+#include "gdcmSorter.h"
+#include "gdcmIPPSorter.h"
+#include "gdcmAttribute.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Slice i of volume v, a volume every 2 s
+static bool WriteSlice(const char *filename, int i, int v)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream uid, ipp, time, instance;
+  uid << "1.2.826.0.1.3680043.2.1143.42." << v << "." << i;
+  ipp << "-120\\-120\\" << 3 * i;
+  time << std::setfill('0') << std::setw(2) << 10 + v * 2 / 3600 << std::setw(2) << v * 2 / 60 % 60
+    << std::setw(2) << v * 2 % 60 << "." << std::setw(3) << i * 2000 / 32;
+  instance << v * 32 + i + 1;
+  w.SetImage( gdcm::MediaStorage::MRImageStorage, "1.2.826.0.1.3680043.2.1143.41",
+    "1.2.826.0.1.3680043.2.1143.43", uid.str() );
+  w.AddString( gdcm::Tag(0x0008,0x0032), gdcm::VR::TM, time.str() );
+  w.AddString( gdcm::Tag(0x0018,0x1030), gdcm::VR::LO, "BOLD RESTING STATE" );
+  w.AddString( gdcm::Tag(0x0020,0x0013), gdcm::VR::IS, instance.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0032), gdcm::VR::DS, ipp.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0037), gdcm::VR::DS, "1\\0\\0\\0\\1\\0" );
+  w.AddString( gdcm::Tag(0x0020,0x0052), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.44" );
+  w.SetPixelData( 32, 32, std::string( 32 * 32 * 2, (char)i ) );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+static bool SortPositionTime(gdcm::DataSet const & ds1, gdcm::DataSet const & ds2 )
+{
+  gdcm::Attribute<0x0020,0x0032> ipp1;
+  gdcm::Attribute<0x0020,0x0032> ipp2;
+  ipp1.Set( ds1 );
+  ipp2.Set( ds2 );
+  if( ipp1[2] == ipp2[2] )
+    {
+    gdcm::Attribute<0x0008,0x0032> t1;
+    gdcm::Attribute<0x0008,0x0032> t2;
+    t1.Set( ds1 );
+    t2.Set( ds2 );
+    return t1 < t2;
+    }
+  return ipp1[2] < ipp2[2];
+}
+
+int main(int argc, char *argv[])
+{
+  const int nslices = argc > 1 ? atoi(argv[1]) : 10000;
+  const int maxthreads = argc > 2 ? atoi(argv[2]) : 8;
+  if( nslices <= 0 || maxthreads <= 0 ) return 1;
+
+  // The volumes in reverse order
+  const char tmpdir[] = "BenchmarkSorter";
+  gdcm::System::MakeDirectory( tmpdir );
+  std::vector<std::string> filenames;
+  for( int n = nslices - 1; n >= 0; --n )
+    {
+    char name[64];
+    sprintf( name, "%s/IM%06d", tmpdir, n );
+    if( !WriteSlice( name, n % 32, n / 32 ) )
+      {
+      std::cerr << "Could not write " << name << std::endl;
+      return 1;
+      }
+    filenames.push_back( name );
+    }
+
+  std::set<gdcm::Tag> tags;
+  tags.insert( gdcm::Tag(0x0008,0x0032) );
+  tags.insert( gdcm::Tag(0x0020,0x0032) );
+  std::cout << nslices << " slices" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(10) << "header" << std::setw(10) << "tags"
+    << std::setw(10) << "ipp" << std::setw(12) << "files/s" << std::endl;
+  int res = 0;
+  for( int n = 1; n <= maxthreads && !res; n *= 2 )
+    {
+    double t[3];
+    std::vector<std::string> sorted[3];
+    for( int i = 0; i < 3 && !res; ++i )
+      {
+      const double t0 = GetTime();
+      bool b;
+      if( i < 2 )
+        {
+        gdcm::Sorter s;
+        s.SetSortFunction( SortPositionTime );
+        if( i == 1 ) s.SetTagsToRead( tags );
+        s.SetNumberOfThreads( n );
+        b = s.Sort( filenames );
+        sorted[i] = s.GetFilenames();
+        }
+      else
+        {
+        gdcm::IPPSorter s;
+        s.SetKeepDuplicatePositions( true );
+        s.SetNumberOfThreads( n );
+        b = s.Sort( filenames );
+        sorted[i] = s.GetFilenames();
+        }
+      t[i] = GetTime() - t0;
+      if( !b || sorted[i].size() != filenames.size() || sorted[i] != sorted[0] )
+        {
+        std::cerr << "Sort " << i << " failed with " << n << " threads" << std::endl;
+        res = 1;
+        }
+      }
+    if( res ) break;
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(1)
+      << std::setw(10) << 1000 * t[0] << std::setw(10) << 1000 * t[1] << std::setw(10) << 1000 * t[2]
+      << std::setprecision(0) << std::setw(12) << nslices / t[2] << std::endl;
+    }
+
+  gdcm::System::DeleteDirectory( tmpdir );
+  return res;
+}
@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Sustained ingest rate of gdcm::StoreSCP: a local load generator
+ * (gdcm::StoreSCUPool) sends the same instances over 1 to 8 concurrent
+ * associations, the SCP spools them to disk with as many threads. The time
+ * includes the association negotiation and every instance being on disk.
+ *
+ * Usage:
+ *   BenchmarkStoreSCP [nfiles [size_kb [window]]]
+ */
+#include "gdcmStoreSCP.h"
+#include "gdcmStoreSCUPool.h"
+#include "gdcmImageWriter.h"
+#include "gdcmDirectory.h"
+#include "gdcmSystem.h"
+
+#include <pthread.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void *RunSCP(void *arg)
+{
+  gdcm::StoreSCP *scp = (gdcm::StoreSCP*)arg;
+  scp->Run();
+  return NULL;
+}
+
+static void CleanSpool(const char *spooldir)
+{
+  gdcm::Directory d;
+  d.Load( spooldir );
+  gdcm::Directory::FilenamesType const &spooled = d.GetFilenames();
+  for( size_t i = 0; i < spooled.size(); ++i )
+    gdcm::System::RemoveFile( spooled[i].c_str() );
+}
+
+// Return the time, negative on error
+static double Receive(const char *spooldir, std::vector<std::string> const &filenames,
+  unsigned int n, uint16_t window)
+{
+  gdcm::StoreSCP scp;
+  scp.SetSpoolDirectory( spooldir );
+  scp.SetNumberOfThreads( n );
+  scp.SetMaxOperationsInvoked( window );
+  if( !scp.Listen() ) return -1;
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return -1;
+
+  gdcm::StoreSCUPool pool;
+  pool.SetHostname( "127.0.0.1" );
+  pool.SetPort( scp.GetPort() );
+  pool.SetTimeout( 10 );
+  pool.SetNumberOfAssociations( n );
+  pool.SetMaxOperationsInvoked( window );
+  std::vector<uint16_t> statuses;
+  const double t0 = GetTime();
+  const bool sent = pool.SendStore( filenames, statuses );
+  const double t = GetTime() - t0;
+  pool.Close();
+  scp.Stop();
+  pthread_join( thread, NULL );
+  const bool stored = scp.GetNumberOfStoredInstances() == filenames.size();
+  CleanSpool( spooldir );
+  return sent && stored ? t : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  const unsigned int nfiles = argc > 1 ? atoi(argv[1]) : 400;
+  const unsigned int sizekb = argc > 2 ? atoi(argv[2]) : 512;
+  const unsigned int window = argc > 3 ? atoi(argv[3]) : 4;
+  if( !nfiles || !sizekb || !window ) return 1;
+
+  const char spooldir[] = "BenchmarkStoreSCP.spool";
+  if( !gdcm::System::FileIsDirectory( spooldir ) )
+    gdcm::System::MakeDirectory( spooldir );
+
+  // 16bits MONOCHROME2 square images of roughly sizekb, each one a distinct
+  // instance (ImageWriter generates the SOP Instance UID)
+  unsigned int dim = 16;
+  while( dim * dim * 2 < sizekb * 1024 ) dim += 16;
+  std::vector<unsigned short> buffer( dim * dim );
+  srand( 0 );
+  for( size_t i = 0; i < buffer.size(); ++i )
+    buffer[i] = (unsigned short)(rand() % 4096);
+  std::vector<std::string> filenames;
+  for( unsigned int i = 0; i < nfiles; ++i )
+    {
+    gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+    image->SetNumberOfDimensions( 2 );
+    image->SetDimension( 0, dim );
+    image->SetDimension( 1, dim );
+    image->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+    image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+    image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+    gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+    pixeldata.SetByteValue( (char*)&buffer[0], (uint32_t)(buffer.size() * 2) );
+    image->SetDataElement( pixeldata );
+    char filename[64];
+    sprintf( filename, "BenchmarkStoreSCP%04u.dcm", i );
+    gdcm::ImageWriter writer;
+    writer.SetFileName( filename );
+    writer.SetImage( *image );
+    if( !writer.Write() ) return 1;
+    filenames.push_back( filename );
+    }
+  const double mb = (double)nfiles * dim * dim * 2 / (1024 * 1024);
+
+  std::cout << nfiles << " files of " << dim << "x" << dim << " 16bits ("
+    << std::fixed << std::setprecision(1) << mb << " MB), window "
+    << window << std::endl;
+  std::cout << std::setw(8) << "assoc" << std::setw(14) << "instances/s"
+    << std::setw(10) << "MB/s" << std::endl;
+  int res = 0;
+  for( unsigned int n = 1; n <= 8; ++n )
+    {
+    const double t = Receive( spooldir, filenames, n, (uint16_t)window );
+    if( t < 0 ) { res = 1; break; }
+    std::cout << std::setw(8) << n << std::setprecision(1)
+      << std::setw(14) << nfiles / t << std::setw(10) << mb / t << std::endl;
+    }
+
+  for( unsigned int i = 0; i < nfiles; ++i )
+    remove( filenames[i].c_str() );
+  return res;
+}
@@ -0,0 +1,94 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * gdcm::StringFilter per-call latency, in ns per call, on the attributes a
+ * scanner reads from every file (CS, LO, PN, DA, UI, IS, DS, US):
+ * - pair: ToStringPair(), value and dictionary name,
+ * - string: ToString(), into a std::string,
+ * - buffer: ToString() into a caller buffer, no allocation.
+ *
+ * Usage:
+ *   BenchmarkStringFilter [calls]
+ */
+#include "gdcmStringFilter.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void AddValue(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::VR const &vr,
+  const char *value, uint32_t len)
+{
+  gdcm::DataElement de( t );
+  de.SetVR( vr );
+  de.SetByteValue( value, len );
+  ds.Insert( de );
+}
+
+int main(int argc, char *argv[])
+{
+  const int ncalls = argc > 1 ? atoi(argv[1]) : 1000000;
+  if( ncalls <= 0 ) return 1;
+
+  gdcm::StringFilter sf;
+  gdcm::DataSet &ds = sf.GetFile().GetDataSet();
+  const uint16_t rows = 512;
+  struct { const char *Name; gdcm::Tag T; gdcm::VR::VRType VR; const char *Value; uint32_t Length; } attributes[] = {
+    { "CS", gdcm::Tag(0x0008,0x0060), gdcm::VR::CS, "MR", 2 },
+    { "LO", gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, "12345 ", 6 },
+    { "PN", gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^John", 8 },
+    { "DA", gdcm::Tag(0x0008,0x0020), gdcm::VR::DA, "20110101", 8 },
+    { "UI", gdcm::Tag(0x0020,0x000d), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.41", 30 },
+    { "IS", gdcm::Tag(0x0020,0x0013), gdcm::VR::IS, "42", 2 },
+    { "DS", gdcm::Tag(0x0028,0x0030), gdcm::VR::DS, "0.9375\\0.9375", 14 },
+    { "US", gdcm::Tag(0x0028,0x0010), gdcm::VR::US, (const char*)&rows, 2 },
+  };
+  const int nattributes = sizeof(attributes) / sizeof(attributes[0]);
+  for( int i = 0; i < nattributes; ++i )
+    AddValue( ds, attributes[i].T, attributes[i].VR, attributes[i].Value, attributes[i].Length );
+
+  std::cout << std::setw(4) << "VR" << std::setw(10) << "pair"
+    << std::setw(10) << "string" << std::setw(10) << "buffer" << std::setw(10) << "speedup" << std::endl;
+  size_t sum = 0; // keep the calls
+  for( int i = 0; i < nattributes; ++i )
+    {
+    const gdcm::Tag &t = attributes[i].T;
+    double t0 = GetTime();
+    for( int j = 0; j < ncalls; ++j )
+      sum += sf.ToStringPair( t ).second.size();
+    const double pair = (GetTime() - t0) * 1e9 / ncalls;
+    t0 = GetTime();
+    for( int j = 0; j < ncalls; ++j )
+      sum += sf.ToString( t ).size();
+    const double str = (GetTime() - t0) * 1e9 / ncalls;
+    char buffer[64];
+    t0 = GetTime();
+    for( int j = 0; j < ncalls; ++j )
+      sum += sf.ToString( t, buffer, sizeof(buffer) );
+    const double buf = (GetTime() - t0) * 1e9 / ncalls;
+    std::cout << std::setw(4) << attributes[i].Name << std::fixed << std::setprecision(1)
+      << std::setw(10) << pair << std::setw(10) << str << std::setw(10) << buf
+      << std::setprecision(2) << std::setw(10) << pair / buf << std::endl;
+    }
+  return sum ? 0 : 1;
+}
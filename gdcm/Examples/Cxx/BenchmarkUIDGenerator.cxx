@@ -0,0 +1,122 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * Bulk UID generation, in UIDs per second for 1, 2, 4... up to max_threads
+ * threads:
+ * - shared: one UIDGenerator behind a mutex, what the callers of Generate()
+ *   had to do to share it between threads,
+ * - reentrant: UIDGenerator::GenerateUID on every thread at once.
+ * All the UIDs of a run are checked to be valid and unique.
+ *
+ * Usage:
+ *   BenchmarkUIDGenerator [uids [max_threads]]
+ */
+#include "gdcmUIDGenerator.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static pthread_mutex_t SharedLock = PTHREAD_MUTEX_INITIALIZER;
+static gdcm::UIDGenerator SharedGenerator;
+
+struct Job
+{
+  bool Shared;
+  size_t Count;
+  std::vector<std::string> UIDs;
+};
+
+static void *Generate(void *arg)
+{
+  Job &job = *static_cast<Job*>(arg);
+  job.UIDs.reserve( job.Count );
+  for( size_t i = 0; i < job.Count; ++i )
+    {
+    if( job.Shared )
+      {
+      pthread_mutex_lock( &SharedLock );
+      const char *uid = SharedGenerator.Generate();
+      job.UIDs.push_back( uid ? uid : "" );
+      pthread_mutex_unlock( &SharedLock );
+      }
+    else
+      {
+      job.UIDs.push_back( gdcm::UIDGenerator::GenerateUID() );
+      }
+    }
+  return NULL;
+}
+
+// UIDs per second, negative on error
+static double Run(bool shared, size_t nuids, int nthreads)
+{
+  std::vector<Job> jobs( nthreads );
+  std::vector<pthread_t> threads( nthreads );
+  const double t0 = GetTime();
+  for( int i = 0; i < nthreads; ++i )
+    {
+    jobs[i].Shared = shared;
+    jobs[i].Count = nuids / nthreads;
+    if( pthread_create( &threads[i], NULL, Generate, &jobs[i] ) ) return -1;
+    }
+  for( int i = 0; i < nthreads; ++i )
+    pthread_join( threads[i], NULL );
+  const double t = GetTime() - t0;
+
+  std::vector<std::string> all;
+  for( int i = 0; i < nthreads; ++i )
+    all.insert( all.end(), jobs[i].UIDs.begin(), jobs[i].UIDs.end() );
+  for( size_t i = 0; i < all.size(); ++i )
+    if( !gdcm::UIDGenerator::IsValid( all[i].c_str() ) ) return -1;
+  std::sort( all.begin(), all.end() );
+  if( std::adjacent_find( all.begin(), all.end() ) != all.end() ) return -1;
+  return all.size() / t;
+}
+
+int main(int argc, char *argv[])
+{
+  const int nuids = argc > 1 ? atoi(argv[1]) : 1000000;
+  const int maxthreads = argc > 2 ? atoi(argv[2]) : 8;
+  if( nuids <= 0 || maxthreads <= 0 ) return 1;
+
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "shared/s"
+    << std::setw(14) << "reentrant/s" << std::setw(10) << "speedup" << std::endl;
+  for( int n = 1; n <= maxthreads; n *= 2 )
+    {
+    const double shared = Run( true, nuids, n );
+    const double reentrant = Run( false, nuids, n );
+    if( shared < 0 || reentrant < 0 )
+      {
+      std::cerr << "Invalid or duplicate UID with " << n << " threads" << std::endl;
+      return 1;
+      }
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(0)
+      << std::setw(14) << shared << std::setw(14) << reentrant
+      << std::setprecision(2) << std::setw(10) << reentrant / shared << std::endl;
+    }
+  return 0;
+}
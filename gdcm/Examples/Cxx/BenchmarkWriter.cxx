@@ -0,0 +1,232 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+/*
+ * gdcm::Writer on header heavy objects, where the time goes into the many
+ * small fields and not into a large Pixel Data:
+ * - an RT Structure Set: ROIs of many contours (nested sequences of
+ *   defined length, one DS contour data each),
+ * - a Structured Report: a flat content sequence of many small items of
+ *   undefined length.
+ * Each one is written to a file and to memory, straight to the stream
+ * (Writer::SetBufferSize(0), the former serialization) and through the
+ * default buffer. Both outputs are compared.
+ *
+ * Usage:
+ *   BenchmarkWriter [rois [contours_per_roi [sr_items [repeat]]]]
+ */
+#include "gdcmWriter.h"
+#include "gdcmFile.h"
+#include "gdcmItem.h"
+#include "gdcmSequenceOfItems.h"
+#include "gdcmExplicitDataElement.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+static double GetTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void AddString(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::VR const &vr, std::string value)
+{
+  if( value.size() % 2 ) value += ' ';
+  gdcm::DataElement de( t );
+  de.SetVR( vr );
+  de.SetByteValue( value.c_str(), (uint32_t)value.size() );
+  ds.Insert( de );
+}
+
+static void AddSequence(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::SequenceOfItems *sq, bool defined)
+{
+  gdcm::DataElement de( t );
+  de.SetVR( gdcm::VR::SQ );
+  de.SetValue( *sq );
+  if( defined )
+    {
+    sq->SetLength( 0 );
+    const gdcm::VL l = sq->ComputeLength<gdcm::ExplicitDataElement>();
+    sq->SetLength( l );
+    de.SetVL( l );
+    }
+  else
+    {
+    sq->SetLengthToUndefined();
+    de.SetVLToUndefined();
+    }
+  ds.Insert( de );
+}
+
+static void SetItemLength(gdcm::Item &item, bool defined)
+{
+  if( defined )
+    item.SetVL( item.GetNestedDataSet().GetLength<gdcm::ExplicitDataElement>() );
+  else
+    item.SetVLToUndefined();
+}
+
+static void FillRTStructureSet(gdcm::DataSet &ds, int nrois, int ncontours)
+{
+  AddString( ds, gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.481.3" );
+  AddString( ds, gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.1" );
+  AddString( ds, gdcm::Tag(0x0008,0x0060), gdcm::VR::CS, "RTSTRUCT" );
+  std::string points;
+  char buffer[64];
+  for( int i = 0; i < 100; ++i )
+    {
+    sprintf( buffer, "%s%.2f\\%.2f\\%.2f", i ? "\\" : "", i * 1.5, i * 2.25, -42.5 );
+    points += buffer;
+    }
+  gdcm::SmartPointer<gdcm::SequenceOfItems> rois = new gdcm::SequenceOfItems;
+  for( int r = 0; r < nrois; ++r )
+    {
+    gdcm::Item roi;
+    gdcm::DataSet &rds = roi.GetNestedDataSet();
+    AddString( rds, gdcm::Tag(0x3006,0x002a), gdcm::VR::IS, "255\\0\\0" );
+    gdcm::SmartPointer<gdcm::SequenceOfItems> contours = new gdcm::SequenceOfItems;
+    for( int c = 0; c < ncontours; ++c )
+      {
+      gdcm::Item contour;
+      gdcm::DataSet &cds = contour.GetNestedDataSet();
+      gdcm::SmartPointer<gdcm::SequenceOfItems> images = new gdcm::SequenceOfItems;
+      gdcm::Item image;
+      AddString( image.GetNestedDataSet(), gdcm::Tag(0x0008,0x1150), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.2" );
+      AddString( image.GetNestedDataSet(), gdcm::Tag(0x0008,0x1155), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.2" );
+      SetItemLength( image, true );
+      images->AddItem( image );
+      AddSequence( cds, gdcm::Tag(0x3006,0x0016), images, true );
+      AddString( cds, gdcm::Tag(0x3006,0x0042), gdcm::VR::CS, "CLOSED_PLANAR" );
+      AddString( cds, gdcm::Tag(0x3006,0x0046), gdcm::VR::IS, "100" );
+      AddString( cds, gdcm::Tag(0x3006,0x0050), gdcm::VR::DS, points );
+      SetItemLength( contour, true );
+      contours->AddItem( contour );
+      }
+    AddSequence( rds, gdcm::Tag(0x3006,0x0040), contours, true );
+    AddString( rds, gdcm::Tag(0x3006,0x0084), gdcm::VR::IS, "1" );
+    SetItemLength( roi, true );
+    rois->AddItem( roi );
+    }
+  AddSequence( ds, gdcm::Tag(0x3006,0x0039), rois, true );
+}
+
+static void FillStructuredReport(gdcm::DataSet &ds, int nitems)
+{
+  AddString( ds, gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.88.22" );
+  AddString( ds, gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.3" );
+  AddString( ds, gdcm::Tag(0x0008,0x0060), gdcm::VR::CS, "SR" );
+  gdcm::SmartPointer<gdcm::SequenceOfItems> content = new gdcm::SequenceOfItems;
+  for( int i = 0; i < nitems; ++i )
+    {
+    gdcm::Item item;
+    gdcm::DataSet &ids = item.GetNestedDataSet();
+    AddString( ids, gdcm::Tag(0x0040,0xa010), gdcm::VR::CS, "CONTAINS" );
+    AddString( ids, gdcm::Tag(0x0040,0xa040), gdcm::VR::CS, "NUM" );
+    gdcm::SmartPointer<gdcm::SequenceOfItems> concept = new gdcm::SequenceOfItems;
+    gdcm::Item code;
+    AddString( code.GetNestedDataSet(), gdcm::Tag(0x0008,0x0100), gdcm::VR::SH, "121206" );
+    AddString( code.GetNestedDataSet(), gdcm::Tag(0x0008,0x0102), gdcm::VR::SH, "DCM" );
+    AddString( code.GetNestedDataSet(), gdcm::Tag(0x0008,0x0104), gdcm::VR::LO, "Distance" );
+    SetItemLength( code, false );
+    concept->AddItem( code );
+    AddSequence( ids, gdcm::Tag(0x0040,0xa043), concept, false );
+    AddString( ids, gdcm::Tag(0x0040,0xa30a), gdcm::VR::DS, "12.5" );
+    SetItemLength( item, false );
+    content->AddItem( item );
+    }
+  AddSequence( ds, gdcm::Tag(0x0040,0xa730), content, false );
+}
+
+// Best of repeat, in ms. Negative on error
+static double Write(gdcm::File &file, size_t buffersize, bool tofile, int repeat,
+  std::string &output)
+{
+  double best = -1;
+  for( int i = 0; i < repeat; ++i )
+    {
+    std::ostringstream os;
+    gdcm::Writer w;
+    if( tofile )
+      w.SetFileName( "BenchmarkWriter.dcm" );
+    else
+      w.SetStream( os );
+    w.SetFile( file );
+    w.SetBufferSize( buffersize );
+    const double t0 = GetTime();
+    if( !w.Write() ) return -1;
+    const double t = 1000 * (GetTime() - t0);
+    if( best < 0 || t < best ) best = t;
+    if( !tofile ) output = os.str();
+    }
+  if( tofile )
+    {
+    std::ifstream is( "BenchmarkWriter.dcm", std::ios::binary );
+    std::ostringstream content;
+    content << is.rdbuf();
+    output = content.str();
+    }
+  return best;
+}
+
+static int Run(const char *name, gdcm::File &file, int repeat)
+{
+  file.GetHeader().SetDataSetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  for( int tofile = 1; tofile >= 0; --tofile )
+    {
+    std::string direct, buffered;
+    const double td = Write( file, 0, tofile != 0, repeat, direct );
+    const double tb = Write( file, 1024 * 1024, tofile != 0, repeat, buffered );
+    if( td < 0 || tb < 0 || direct != buffered )
+      {
+      std::cerr << name << ": write failed or outputs differ" << std::endl;
+      return 1;
+      }
+    std::cout << std::setw(8) << name << std::setw(8) << (tofile ? "file" : "memory")
+      << std::fixed << std::setprecision(1)
+      << std::setw(10) << direct.size() / (1024. * 1024.)
+      << std::setw(12) << td << std::setw(12) << tb
+      << std::setw(10) << td / tb << std::endl;
+    }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const int nrois = argc > 1 ? atoi(argv[1]) : 50;
+  const int ncontours = argc > 2 ? atoi(argv[2]) : 200;
+  const int nitems = argc > 3 ? atoi(argv[3]) : 100000;
+  const int repeat = argc > 4 ? atoi(argv[4]) : 5;
+  if( nrois <= 0 || ncontours <= 0 || nitems <= 0 || repeat <= 0 ) return 1;
+
+  gdcm::SmartPointer<gdcm::File> rt = new gdcm::File;
+  FillRTStructureSet( rt->GetDataSet(), nrois, ncontours );
+  gdcm::SmartPointer<gdcm::File> sr = new gdcm::File;
+  FillStructuredReport( sr->GetDataSet(), nitems );
+
+  std::cout << std::setw(8) << "object" << std::setw(8) << "to"
+    << std::setw(10) << "MB" << std::setw(12) << "direct ms"
+    << std::setw(12) << "buffered ms" << std::setw(10) << "speedup" << std::endl;
+  int res = Run( "RT", *rt, repeat );
+  if( !res ) res = Run( "SR", *sr, repeat );
+  remove( "BenchmarkWriter.dcm" );
+  return res;
+}
@@ -12,9 +12,64 @@
 
 =========================================================================*/
 #include "gdcmByteSwap.h"
+#include "gdcmPixelKernels.h"
 
 namespace gdcm
 {
 
+#ifndef GDCM_WORDS_BIGENDIAN
+// On little endian systems the range swaps of 16bits and 32bits words are
+// done with PixelKernels. Same semantic as Swap4/Swap8.
+template <>
+void ByteSwap<uint16_t>::SwapRange(uint16_t *p, unsigned int num)
+{
+  PixelKernels::SwapBytes16(p, num);
+}
+
+template <>
+void ByteSwap<uint16_t>::SwapRangeFromSwapCodeIntoSystem(uint16_t *p,
+  SwapCode const &sc, std::streamoff num)
+{
+  if( num <= 0 ) return;
+  if( sc == SwapCode::BigEndian || sc == SwapCode::BadBigEndian ) // 4321, 2143
+    {
+    PixelKernels::SwapBytes16(p, (size_t)num);
+    }
+}
+
+template <>
+void ByteSwap<uint32_t>::SwapRange(uint32_t *p, unsigned int num)
+{
+  PixelKernels::SwapBytes32(p, num);
+}
+
+template <>
+void ByteSwap<uint32_t>::SwapRangeFromSwapCodeIntoSystem(uint32_t *p,
+  SwapCode const &sc, std::streamoff num)
+{
+  if( num <= 0 ) return;
+  switch( sc )
+    {
+  case SwapCode::Unknown:
+  case SwapCode::LittleEndian:
+    break;
+  case SwapCode::BigEndian:
+    PixelKernels::SwapBytes32(p, (size_t)num);
+    break;
+  case SwapCode::BadLittleEndian: // 3412
+    PixelKernels::SwapWords32(p, (size_t)num);
+    break;
+  case SwapCode::BadBigEndian: // 2143
+    PixelKernels::SwapBytes16((uint16_t*)p, 2 * (size_t)num);
+    break;
+  default:
+    // let Swap8 report the unexpected swap code
+    for( std::streamoff i=0; i<num; i++)
+      {
+      ByteSwap<uint32_t>::SwapFromSwapCodeIntoSystem(p[i], sc);
+      }
+    }
+}
+#endif
 
 } // end namespace gdcm
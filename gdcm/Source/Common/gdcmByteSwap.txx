@@ -98,6 +98,20 @@ void ByteSwap<T>::SwapRangeFromSwapCodeIntoSystem(T *p, SwapCode const &sc,
     }
 }
 
+#ifndef GDCM_WORDS_BIGENDIAN
+// Vectorized implementations (see PixelKernels), defined in gdcmByteSwap.cxx
+template <>
+GDCM_EXPORT void ByteSwap<uint16_t>::SwapRange(uint16_t *p, unsigned int num);
+template <>
+GDCM_EXPORT void ByteSwap<uint16_t>::SwapRangeFromSwapCodeIntoSystem(uint16_t *p,
+  SwapCode const &sc, std::streamoff num);
+template <>
+GDCM_EXPORT void ByteSwap<uint32_t>::SwapRange(uint32_t *p, unsigned int num);
+template <>
+GDCM_EXPORT void ByteSwap<uint32_t>::SwapRangeFromSwapCodeIntoSystem(uint32_t *p,
+  SwapCode const &sc, std::streamoff num);
+#endif
+
 // Private:
 //
 
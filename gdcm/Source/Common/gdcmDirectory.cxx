@@ -97,6 +97,15 @@ unsigned int Directory::Explore(FilenameType const &name, bool recursive)
   for (d = readdir(dir); d; d = readdir(dir))
     {
     fileName = dirName + d->d_name;
+#ifdef DT_UNKNOWN
+    // d_type saves one stat round trip per entry (expensive on network file
+    // system). Symbolic links and DT_UNKNOWN still need a stat call.
+    if( d->d_type == DT_REG )
+      buf.st_mode = S_IFREG;
+    else if( d->d_type == DT_DIR )
+      buf.st_mode = S_IFDIR;
+    else
+#endif
     if( stat(fileName.c_str(), &buf) != 0 )
       {
       const char *str = strerror(errno); (void)str;
@@ -0,0 +1,528 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmDirectoryWalker.h"
+#include "gdcmSystem.h"
+#include "gdcmTrace.h"
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <string.h> // strerror
+#include <stddef.h> // offsetof
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+  #include <windows.h>
+#else
+  #include <dirent.h>
+  #include <sys/types.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+  #include <sys/syscall.h>
+#endif
+
+#if defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+  #include <pthread.h>
+  #define GDCM_DIRECTORYWALKER_THREADS
+#endif
+
+namespace gdcm
+{
+
+namespace
+{
+enum EntryType
+{
+  ENTRY_UNKNOWN = 0,
+  ENTRY_FILE,
+  ENTRY_DIRECTORY,
+  ENTRY_OTHER
+};
+
+struct Entry
+{
+  std::string Name;
+  EntryType Type;
+};
+typedef std::vector<Entry> EntriesType;
+
+#if !defined(_MSC_VER)
+inline EntryType EntryTypeFromMode(mode_t m)
+{
+  if( S_ISREG(m) ) return ENTRY_FILE;
+  if( S_ISDIR(m) ) return ENTRY_DIRECTORY;
+  return ENTRY_OTHER;
+}
+
+#ifdef DT_UNKNOWN
+inline EntryType EntryTypeFromDirent(unsigned char dtype)
+{
+  switch( dtype )
+    {
+  case DT_REG:
+    return ENTRY_FILE;
+  case DT_DIR:
+    return ENTRY_DIRECTORY;
+  case DT_UNKNOWN:
+  case DT_LNK: // stat() follows the link, so does gdcm::Directory
+    return ENTRY_UNKNOWN;
+  default:
+    return ENTRY_OTHER;
+    }
+}
+#endif
+
+// Resolve type of entries for which d_type was not sufficient
+void ResolveUnknownEntries(int dirfd, std::string const &dirname, EntriesType &entries)
+{
+  struct stat buf;
+  for( EntriesType::iterator it = entries.begin(); it != entries.end(); ++it )
+    {
+    if( it->Type != ENTRY_UNKNOWN ) continue;
+#if defined(AT_FDCWD)
+    const int ret = dirfd >= 0 ? fstatat(dirfd, it->Name.c_str(), &buf, 0)
+      : stat((dirname + it->Name).c_str(), &buf);
+#else
+    (void)dirfd;
+    const int ret = stat((dirname + it->Name).c_str(), &buf);
+#endif
+    if( ret != 0 )
+      {
+      const char *str = strerror(errno); (void)str;
+      gdcmErrorMacro( "Last Error was: " << str << " for file: " << dirname << it->Name );
+      it->Type = ENTRY_OTHER;
+      }
+    else
+      {
+      it->Type = EntryTypeFromMode(buf.st_mode);
+      }
+    }
+}
+#endif
+
+#if defined(__linux__) && defined(SYS_getdents64)
+// linux_dirent64 is not exposed by the libc headers
+struct LinuxDirent64
+{
+  uint64_t       d_ino;
+  int64_t        d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[1];
+};
+
+// Read all entries of `dirname` with large getdents64 batches. On network file
+// systems each getdents is a round trip, the default readdir buffer (32k) is
+// too small for directories with thousands of DICOM files.
+bool ReadEntries(std::string const &dirname, EntriesType &entries,
+  std::vector<char> &buffer)
+{
+  const int fd = open(dirname.c_str(), O_RDONLY | O_DIRECTORY
+#ifdef O_CLOEXEC
+    | O_CLOEXEC
+#endif
+    );
+  if( fd < 0 )
+    {
+    const char *str = strerror(errno); (void)str;
+    gdcmErrorMacro( "Error was: " << str << " when opening directory: " << dirname );
+    return false;
+    }
+  static const size_t BufferSize = 256 * 1024;
+  if( buffer.size() < BufferSize ) buffer.resize( BufferSize );
+  for(;;)
+    {
+    const long nread = syscall(SYS_getdents64, fd, &buffer[0], buffer.size());
+    if( nread < 0 )
+      {
+      const char *str = strerror(errno); (void)str;
+      gdcmErrorMacro( "Error was: " << str << " when reading directory: " << dirname );
+      close(fd);
+      return false;
+      }
+    if( nread == 0 ) break;
+    for( long pos = 0; pos < nread; )
+      {
+      const LinuxDirent64 *d = reinterpret_cast<const LinuxDirent64*>(&buffer[pos]);
+      pos += d->d_reclen;
+      const char *name = &buffer[0] + (pos - d->d_reclen) + offsetof(LinuxDirent64, d_name);
+      if( name[0] == '.' ) continue; // ., .. and any hidden file / dir
+      Entry e;
+      e.Name = name;
+      e.Type = EntryTypeFromDirent( d->d_type );
+      entries.push_back( e );
+      }
+    }
+  ResolveUnknownEntries(fd, dirname, entries);
+  close(fd);
+  return true;
+}
+#elif defined(_MSC_VER)
+bool ReadEntries(std::string const &dirname, EntriesType &entries,
+  std::vector<char> &)
+{
+  WIN32_FIND_DATA fileData;
+  const std::string firstfile = dirname+"*";
+  HANDLE hFile = FindFirstFile(firstfile.c_str(), &fileData);
+  if( hFile == INVALID_HANDLE_VALUE ) return false;
+  for(BOOL b = TRUE; b; b = FindNextFile(hFile, &fileData))
+    {
+    if( fileData.cFileName[0] == '.' ) continue;
+    Entry e;
+    e.Name = fileData.cFileName;
+    e.Type = (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? ENTRY_DIRECTORY : ENTRY_FILE;
+    entries.push_back( e );
+    }
+  FindClose(hFile);
+  return true;
+}
+#else
+bool ReadEntries(std::string const &dirname, EntriesType &entries,
+  std::vector<char> &)
+{
+  DIR* dir = opendir(dirname.c_str());
+  if (!dir)
+    {
+    const char *str = strerror(errno); (void)str;
+    gdcmErrorMacro( "Error was: " << str << " when opening directory: " << dirname );
+    return false;
+    }
+  for (dirent *d = readdir(dir); d; d = readdir(dir))
+    {
+    if( d->d_name[0] == '.' ) continue;
+    Entry e;
+    e.Name = d->d_name;
+#ifdef DT_UNKNOWN
+    e.Type = EntryTypeFromDirent( d->d_type );
+#else
+    e.Type = ENTRY_UNKNOWN;
+#endif
+    entries.push_back( e );
+    }
+  ResolveUnknownEntries(-1, dirname, entries);
+  closedir(dir);
+  return true;
+}
+#endif
+
+} // end anonymous namespace
+
+// Per worker state. Each worker pushes and pops at the back of its own queue,
+// thieves take from the front (oldest, hence usually largest, sub trees)
+struct WorkerQueue
+{
+  std::deque<std::string> Dirs;
+  Directory::FilenamesType Filenames;
+  Directory::FilenamesType Directories;
+  unsigned int NumberOfFiles;
+  // scratch space, reused from one directory to the next
+  std::vector<char> Buffer;
+  EntriesType Entries;
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_t Lock;
+#endif
+};
+
+class DirectoryWalkerInternals
+{
+public:
+  DirectoryWalkerInternals(unsigned int nworkers, bool recursive,
+    DirectoryWalker::Consumer *c):Queues(nworkers),Recursive(recursive),
+    TheConsumer(c),Pending(0),Available(0)
+    {
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+    for(size_t i = 0; i < Queues.size(); ++i)
+      pthread_mutex_init(&Queues[i].Lock, NULL);
+    pthread_mutex_init(&StateLock, NULL);
+    pthread_mutex_init(&ConsumerLock, NULL);
+    pthread_cond_init(&StateCond, NULL);
+#endif
+    for(size_t i = 0; i < Queues.size(); ++i)
+      Queues[i].NumberOfFiles = 0;
+    }
+  ~DirectoryWalkerInternals()
+    {
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+    for(size_t i = 0; i < Queues.size(); ++i)
+      pthread_mutex_destroy(&Queues[i].Lock);
+    pthread_mutex_destroy(&StateLock);
+    pthread_mutex_destroy(&ConsumerLock);
+    pthread_cond_destroy(&StateCond);
+#endif
+    }
+
+  void Push(unsigned int id, std::string const &dir);
+  bool Pop(unsigned int id, std::string &dir);
+  bool Steal(unsigned int id, std::string &dir);
+  void Done();
+  bool WaitForWork();
+  void Process(unsigned int id, std::string const &dir);
+  void Run(unsigned int id);
+
+  std::vector<WorkerQueue> Queues;
+  bool Recursive;
+  DirectoryWalker::Consumer *TheConsumer;
+  // number of directories queued or being processed
+  unsigned long Pending;
+  // number of directories queued (hint for the idle workers)
+  unsigned long Available;
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_t StateLock;
+  pthread_cond_t StateCond;
+  pthread_mutex_t ConsumerLock;
+#endif
+};
+
+void DirectoryWalkerInternals::Push(unsigned int id, std::string const &dir)
+{
+  WorkerQueue &q = Queues[id];
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  // Available is counted before the queue lock is released: a thief could
+  // otherwise take the directory and decrement it first. The queue lock is
+  // always taken before StateLock
+  pthread_mutex_lock(&q.Lock);
+  q.Dirs.push_back( dir );
+  pthread_mutex_lock(&StateLock);
+  ++Pending;
+  ++Available;
+  pthread_cond_signal(&StateCond);
+  pthread_mutex_unlock(&StateLock);
+  pthread_mutex_unlock(&q.Lock);
+#else
+  q.Dirs.push_back( dir );
+  ++Pending;
+  ++Available;
+#endif
+}
+
+bool DirectoryWalkerInternals::Pop(unsigned int id, std::string &dir)
+{
+  WorkerQueue &q = Queues[id];
+  bool found = false;
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_lock(&q.Lock);
+#endif
+  if( !q.Dirs.empty() )
+    {
+    dir = q.Dirs.back();
+    q.Dirs.pop_back();
+    found = true;
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+    pthread_mutex_lock(&StateLock);
+    --Available;
+    pthread_mutex_unlock(&StateLock);
+#else
+    --Available;
+#endif
+    }
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_unlock(&q.Lock);
+#endif
+  return found;
+}
+
+bool DirectoryWalkerInternals::Steal(unsigned int id, std::string &dir)
+{
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  const size_t n = Queues.size();
+  for( size_t i = 1; i < n; ++i )
+    {
+    WorkerQueue &victim = Queues[(id + i) % n];
+    bool found = false;
+    pthread_mutex_lock(&victim.Lock);
+    if( !victim.Dirs.empty() )
+      {
+      dir = victim.Dirs.front();
+      victim.Dirs.pop_front();
+      found = true;
+      pthread_mutex_lock(&StateLock);
+      --Available;
+      pthread_mutex_unlock(&StateLock);
+      }
+    pthread_mutex_unlock(&victim.Lock);
+    if( found ) return true;
+    }
+#else
+  (void)id; (void)dir;
+#endif
+  return false;
+}
+
+void DirectoryWalkerInternals::Done()
+{
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_lock(&StateLock);
+  if( --Pending == 0 )
+    pthread_cond_broadcast(&StateCond);
+  pthread_mutex_unlock(&StateLock);
+#else
+  --Pending;
+#endif
+}
+
+// Return false once the whole tree has been processed
+bool DirectoryWalkerInternals::WaitForWork()
+{
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  pthread_mutex_lock(&StateLock);
+  while( Available == 0 && Pending != 0 )
+    pthread_cond_wait(&StateCond, &StateLock);
+  const bool more = Pending != 0;
+  pthread_mutex_unlock(&StateLock);
+  return more;
+#else
+  return Pending != 0;
+#endif
+}
+
+void DirectoryWalkerInternals::Process(unsigned int id, std::string const &name)
+{
+  WorkerQueue &q = Queues[id];
+  q.Directories.push_back( name );
+  std::string dirname = name;
+  if( dirname.empty() || dirname[dirname.size()-1] != '/' )
+    dirname.append("/");
+
+  EntriesType &entries = q.Entries;
+  entries.clear();
+  if( !ReadEntries(dirname, entries, q.Buffer) ) return;
+
+  for( EntriesType::const_iterator it = entries.begin(); it != entries.end(); ++it )
+    {
+    const std::string fullname = dirname + it->Name;
+    switch( it->Type )
+      {
+    case ENTRY_FILE:
+      ++q.NumberOfFiles;
+      if( TheConsumer )
+        {
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+        pthread_mutex_lock(&ConsumerLock);
+        TheConsumer->Consume( fullname );
+        pthread_mutex_unlock(&ConsumerLock);
+#else
+        TheConsumer->Consume( fullname );
+#endif
+        }
+      else
+        {
+        q.Filenames.push_back( fullname );
+        }
+      break;
+    case ENTRY_DIRECTORY:
+      if( Recursive ) Push( id, fullname );
+      break;
+    default:
+      gdcmWarningMacro( "Unexpected type for file: " << fullname );
+      break;
+      }
+    }
+}
+
+void DirectoryWalkerInternals::Run(unsigned int id)
+{
+  std::string dir;
+  for(;;)
+    {
+    if( Pop(id, dir) || Steal(id, dir) )
+      {
+      Process(id, dir);
+      Done();
+      }
+    else if( !WaitForWork() )
+      {
+      break;
+      }
+    }
+}
+
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+struct WorkerArgs
+{
+  DirectoryWalkerInternals *Internals;
+  unsigned int Id;
+};
+
+static void *DirectoryWalkerWorker(void *arg)
+{
+  WorkerArgs *wa = static_cast<WorkerArgs*>(arg);
+  wa->Internals->Run( wa->Id );
+  return NULL;
+}
+#endif
+
+DirectoryWalker::DirectoryWalker():NumberOfThreads(0),TheConsumer(NULL)
+{
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+}
+
+unsigned int DirectoryWalker::Walk(FilenameType const &name, bool recursive)
+{
+  Filenames.clear();
+  Directories.clear();
+  Toplevel = name;
+
+  unsigned int nthreads = NumberOfThreads ? NumberOfThreads : System::GetNumberOfProcessors();
+#ifndef GDCM_DIRECTORYWALKER_THREADS
+  nthreads = 1;
+#endif
+  // No point in spawning threads for a single directory:
+  if( !recursive ) nthreads = 1;
+
+  DirectoryWalkerInternals internals(nthreads, recursive, TheConsumer);
+  internals.Push(0, Toplevel);
+
+#ifdef GDCM_DIRECTORYWALKER_THREADS
+  std::vector<pthread_t> threads(nthreads);
+  std::vector<WorkerArgs> args(nthreads);
+  unsigned int nstarted = 1;
+  for( unsigned int i = 1; i < nthreads; ++i )
+    {
+    args[i].Internals = &internals;
+    args[i].Id = i;
+    if( pthread_create(&threads[i], NULL, DirectoryWalkerWorker, &args[i]) != 0 )
+      {
+      gdcmWarningMacro( "Could not create thread, using " << i << " thread(s)" );
+      break;
+      }
+    ++nstarted;
+    }
+  // calling thread is worker 0
+  internals.Run(0);
+  for( unsigned int i = 1; i < nstarted; ++i )
+    pthread_join(threads[i], NULL);
+#else
+  internals.Run(0);
+#endif
+
+  unsigned int nFiles = 0;
+  for( size_t i = 0; i < internals.Queues.size(); ++i )
+    {
+    WorkerQueue const &q = internals.Queues[i];
+    nFiles += q.NumberOfFiles;
+    Filenames.insert( Filenames.end(), q.Filenames.begin(), q.Filenames.end() );
+    Directories.insert( Directories.end(), q.Directories.begin(), q.Directories.end() );
+    }
+  return nFiles;
+}
+
+} // end namespace gdcm
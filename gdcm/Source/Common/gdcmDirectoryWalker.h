@@ -0,0 +1,103 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMDIRECTORYWALKER_H
+#define GDCMDIRECTORYWALKER_H
+
+#include "gdcmDirectory.h"
+
+namespace gdcm
+{
+class DirectoryWalkerInternals;
+
+/**
+ * \brief Parallel directory tree walker
+ *
+ * DirectoryWalker is the multi-threaded counterpart of gdcm::Directory. Sub
+ * directories are distributed over a set of worker threads, each worker owns
+ * a queue of directories to explore and steals work from the other queues
+ * once its own queue is empty.
+ *
+ * \note The entry type is taken from the directory entry itself (d_type) when
+ * the file system provides it, so that no stat call is needed for regular
+ * files and directories. On linux the entries are read in large batches
+ * directly with getdents64. Symbolic links and file systems which do not
+ * report d_type fall back to a stat call.
+ *
+ * \note Same filtering rules as gdcm::Directory: hidden files and hidden
+ * directories (starting with a '.') are discarded.
+ *
+ * \warning The order of the filenames is not deterministic, since it depends
+ * on the scheduling of the worker threads.
+ *
+ * \see Directory
+ */
+class GDCM_EXPORT DirectoryWalker
+{
+public:
+  typedef Directory::FilenameType FilenameType;
+  typedef Directory::FilenamesType FilenamesType;
+
+  /**
+   * \brief Consumer
+   * Filenames are pushed to the consumer as soon as they are found, instead
+   * of being collected until the end of the walk.
+   * Calls to Consume are serialized, a consumer does not need to be thread
+   * safe.
+   */
+  class GDCM_EXPORT Consumer
+  {
+  public:
+    virtual ~Consumer() {}
+    virtual void Consume(FilenameType const &filename) = 0;
+  };
+
+  DirectoryWalker();
+  ~DirectoryWalker();
+
+  /// Set/Get the number of worker threads. 0 (default) means the number of
+  /// online processors. When threads are not available the walk is done in the
+  /// calling thread.
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
+  /// Set the consumer to be notified of each filename. When a consumer is set
+  /// GetFilenames() will remain empty.
+  void SetConsumer(Consumer *c) { TheConsumer = c; }
+
+  /// Walk the tree beneath directory: name, return the number of files found
+  unsigned int Walk(FilenameType const &name, bool recursive = true);
+
+  /// Get the name of the toplevel directory
+  FilenameType const &GetToplevel() const { return Toplevel; }
+
+  /// Return the file names found (only when no consumer is set)
+  FilenamesType const &GetFilenames() const { return Filenames; }
+
+  /// Return the Directories traversed
+  FilenamesType const &GetDirectories() const { return Directories; }
+
+private:
+  DirectoryWalker(const DirectoryWalker&);  // Not implemented.
+  void operator=(const DirectoryWalker&);  // Not implemented.
+
+  unsigned int NumberOfThreads;
+  Consumer *TheConsumer;
+  FilenameType Toplevel;
+  FilenamesType Filenames;
+  FilenamesType Directories;
+};
+
+} // end namespace gdcm
+
+#endif //GDCMDIRECTORYWALKER_H
@@ -25,17 +25,21 @@ namespace gdcm
 const char* DummyValueGenerator::Generate(const char *input)
 {
   static char digest[2*20+1] = {};
+  if( Generate(input, digest) )
+    return digest;
+  return 0;
+}
+
+bool DummyValueGenerator::Generate(const char *input, char *output)
+{
   bool b = false;
   if( input )
     {
     // Cannot use MD5 as it has been broken multiple time (2005)
-    b = MD5::Compute(input, strlen(input), digest);
-    //b = SHA1::Compute(input, strlen(input), digest);
+    b = MD5::Compute(input, strlen(input), output);
+    //b = SHA1::Compute(input, strlen(input), output);
     }
-
-  if( b )
-    return digest;
-  return 0;
+  return b;
 }
 
 
@@ -34,6 +34,10 @@ public:
    */
   static const char* Generate(const char *input);
 
+  /// Same as above, the dummy value is written in output (at least 41 bytes
+  /// long). Return false on error. Thread safe.
+  static bool Generate(const char *input, char *output);
+
 private:
 };
 
@@ -0,0 +1,296 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmHashKernels.h"
+#include "gdcmHashKernelsTable.h"
+
+#if defined(GDCM_HASHKERNELS_SHANI)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__)
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(GDCM_HASHKERNELS_ARMV8) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+namespace gdcm
+{
+
+namespace
+{
+inline uint32_t Rotl(uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+inline uint32_t Rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t LoadBE(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// FIPS 180-4, 6.1.2
+void ScalarSHA1Blocks(uint32_t state[5], const unsigned char *data, size_t n)
+{
+  uint32_t w[80];
+  for( ; n; --n, data += 64 )
+    {
+    for(int t = 0; t < 16; ++t)
+      w[t] = LoadBE(data + 4 * t);
+    for(int t = 16; t < 80; ++t)
+      w[t] = Rotl(w[t-3] ^ w[t-8] ^ w[t-14] ^ w[t-16], 1);
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for(int t = 0; t < 80; ++t)
+      {
+      uint32_t f, k;
+      if( t < 20 )
+        {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+        }
+      else if( t < 40 )
+        {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+        }
+      else if( t < 60 )
+        {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+        }
+      else
+        {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+        }
+      const uint32_t tmp = Rotl(a, 5) + f + e + k + w[t];
+      e = d;
+      d = c;
+      c = Rotl(b, 30);
+      b = a;
+      a = tmp;
+      }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    }
+}
+
+const uint32_t K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// FIPS 180-4, 6.2.2
+void ScalarSHA256Blocks(uint32_t state[8], const unsigned char *data, size_t n)
+{
+  uint32_t w[64];
+  for( ; n; --n, data += 64 )
+    {
+    for(int t = 0; t < 16; ++t)
+      w[t] = LoadBE(data + 4 * t);
+    for(int t = 16; t < 64; ++t)
+      {
+      const uint32_t s0 = Rotr(w[t-15], 7) ^ Rotr(w[t-15], 18) ^ (w[t-15] >> 3);
+      const uint32_t s1 = Rotr(w[t-2], 17) ^ Rotr(w[t-2], 19) ^ (w[t-2] >> 10);
+      w[t] = w[t-16] + s0 + w[t-7] + s1;
+      }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for(int t = 0; t < 64; ++t)
+      {
+      const uint32_t S1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+      const uint32_t ch = (e & f) ^ (~e & g);
+      const uint32_t t1 = h + S1 + ch + K256[t] + w[t];
+      const uint32_t S0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+      const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+      const uint32_t t2 = S0 + maj;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+      }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+    }
+}
+
+const HashKernelsDetail::Table ScalarTable = { ScalarSHA1Blocks, ScalarSHA256Blocks };
+
+// Constant initialized, see PixelKernels
+const HashKernelsDetail::Table *CurrentTable = &ScalarTable;
+HashKernels::InstructionSetType CurrentInstructionSet = HashKernels::SCALAR;
+
+#ifdef GDCM_HASHKERNELS_SHANI
+// registers are returned as: eax, ebx, ecx, edx
+bool CpuId(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, 0);
+  if( (unsigned int)r[0] < leaf ) return false;
+  __cpuidex(r, (int)leaf, 0);
+  for(int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+  return true;
+#elif defined(__GNUC__)
+  if( __get_cpuid_max(0, 0) < leaf ) return false;
+  __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+  return true;
+#else
+  (void)leaf; (void)regs;
+  return false;
+#endif
+}
+
+// The SHA-NI kernels also use SSSE3 (pshufb) and SSE4.1 (pblendw, pextrd)
+bool CpuHasSHANI()
+{
+  unsigned int regs[4];
+  if( !CpuId(1, regs) ) return false;
+  const unsigned int ssse3 = 1u << 9;
+  const unsigned int sse41 = 1u << 19;
+  if( (regs[2] & (ssse3 | sse41)) != (ssse3 | sse41) ) return false;
+  if( !CpuId(7, regs) ) return false;
+  return (regs[1] & (1u << 29)) != 0;
+}
+#endif
+
+#ifdef GDCM_HASHKERNELS_ARMV8
+// The Cryptography Extensions are optional in ARMv8-A
+bool CpuHasARMv8Crypto()
+{
+#if defined(__APPLE__)
+  return true; // every Apple arm64 CPU has them
+#elif defined(__linux__)
+  const unsigned long hwcap = getauxval(AT_HWCAP);
+  return (hwcap & HWCAP_SHA1) && (hwcap & HWCAP_SHA2);
+#else
+  return false;
+#endif
+}
+#endif
+
+const HashKernelsDetail::Table *GetTable(HashKernels::InstructionSetType is)
+{
+  switch(is)
+    {
+  case HashKernels::SCALAR:
+    return &ScalarTable;
+#ifdef GDCM_HASHKERNELS_SHANI
+  case HashKernels::SHANI:
+    return CpuHasSHANI() ? HashKernelsDetail::GetSHANITable() : 0;
+#endif
+#ifdef GDCM_HASHKERNELS_ARMV8
+  case HashKernels::ARMV8:
+    return CpuHasARMv8Crypto() ? HashKernelsDetail::GetARMv8Table() : 0;
+#endif
+  default:
+    break;
+    }
+  return 0;
+}
+
+// Select the best instruction set once the library is loaded
+struct HashKernelsInitializer
+{
+  HashKernelsInitializer()
+    {
+    HashKernels::SetInstructionSet( HashKernels::GetBestInstructionSet() );
+    }
+};
+HashKernelsInitializer TheInitializer;
+
+} // end anonymous namespace
+
+HashKernels::InstructionSetType HashKernels::GetInstructionSet()
+{
+  return CurrentInstructionSet;
+}
+
+bool HashKernels::SetInstructionSet(InstructionSetType is)
+{
+  const HashKernelsDetail::Table *table = GetTable(is);
+  if( !table ) return false;
+  CurrentTable = table;
+  CurrentInstructionSet = is;
+  return true;
+}
+
+bool HashKernels::IsInstructionSetSupported(InstructionSetType is)
+{
+  return GetTable(is) != 0;
+}
+
+HashKernels::InstructionSetType HashKernels::GetBestInstructionSet()
+{
+  if( IsInstructionSetSupported(SHANI) ) return SHANI;
+  if( IsInstructionSetSupported(ARMV8) ) return ARMV8;
+  return SCALAR;
+}
+
+const char *HashKernels::GetInstructionSetString(InstructionSetType is)
+{
+  switch(is)
+    {
+  case SCALAR:
+    return "SCALAR";
+  case SHANI:
+    return "SHANI";
+  case ARMV8:
+    return "ARMV8";
+    }
+  return 0;
+}
+
+void HashKernels::SHA1Blocks(uint32_t state[5], const unsigned char *data, size_t n)
+{
+  CurrentTable->SHA1Blocks(state, data, n);
+}
+
+void HashKernels::SHA256Blocks(uint32_t state[8], const unsigned char *data, size_t n)
+{
+  CurrentTable->SHA256Blocks(state, data, n);
+}
+
+} // end namespace gdcm
@@ -0,0 +1,67 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMHASHKERNELS_H
+#define GDCMHASHKERNELS_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+
+/**
+ * \brief SHA-1 and SHA-256 compression functions
+ * \details Block functions used by SHA1 and SHA256. Each one has a scalar
+ * implementation and, depending on the build, an x86 SHA extensions (SHA-NI)
+ * and an ARMv8 Cryptography Extensions implementation. The best instruction
+ * set supported by the running CPU is selected at load time, as for
+ * PixelKernels.
+ *
+ * \note This is a low level class, one would generally use SHA1 or SHA256.
+ *
+ * \see SHA1 SHA256 PixelKernels
+ */
+class GDCM_EXPORT HashKernels
+{
+public:
+  typedef enum {
+    SCALAR = 0,
+    SHANI,
+    ARMV8
+  } InstructionSetType;
+
+  /// Return the instruction set currently in use
+  static InstructionSetType GetInstructionSet();
+
+  /// Force an instruction set (benchmark, testing). Return false (and leave
+  /// the current one untouched) if it is not supported by both the build and
+  /// the running CPU.
+  static bool SetInstructionSet(InstructionSetType is);
+
+  /// Is instruction set `is` available at runtime ?
+  static bool IsInstructionSetSupported(InstructionSetType is);
+
+  /// Return the best instruction set for the running CPU
+  static InstructionSetType GetBestInstructionSet();
+
+  static const char *GetInstructionSetString(InstructionSetType is);
+
+  /// Update the SHA-1 state (H0..H4) with n blocks of 64 bytes
+  static void SHA1Blocks(uint32_t state[5], const unsigned char *data, size_t n);
+  /// Update the SHA-256 state (H0..H7) with n blocks of 64 bytes
+  static void SHA256Blocks(uint32_t state[8], const unsigned char *data, size_t n);
+};
+
+} // end namespace gdcm
+
+#endif //GDCMHASHKERNELS_H
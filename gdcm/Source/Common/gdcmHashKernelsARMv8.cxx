@@ -0,0 +1,114 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compiled with -march=armv8-a+crypto, do not include any other gdcm header
+// here.
+#include "gdcmHashKernelsTable.h"
+
+#include <arm_neon.h>
+
+namespace gdcm
+{
+namespace HashKernelsDetail
+{
+
+namespace
+{
+// The words of group g (rounds 4g..4g+3) are kept in M[g % 4], group g is
+// computed from the four previous ones right before it is used.
+inline uint32x4_t LoadBE(const unsigned char *p)
+{
+  return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p)));
+}
+
+void SHA1Blocks(uint32_t state[5], const unsigned char *data, size_t n)
+{
+  static const uint32_t K[4] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+  uint32x4_t abcd = vld1q_u32(state);
+  uint32_t e = state[4];
+  uint32x4_t M[4];
+  for( ; n; --n, data += 64 )
+    {
+    const uint32x4_t abcd_save = abcd;
+    const uint32_t e_save = e;
+    for(int i = 0; i < 4; ++i)
+      M[i] = LoadBE(data + 16 * i);
+    for(int g = 0; g < 20; ++g)
+      {
+      if( g >= 4 )
+        M[g % 4] = vsha1su1q_u32(vsha1su0q_u32(M[g % 4], M[(g + 1) % 4], M[(g + 2) % 4]), M[(g + 3) % 4]);
+      const uint32x4_t wk = vaddq_u32(M[g % 4], vdupq_n_u32(K[g / 5]));
+      const uint32_t next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+      if( g < 5 )
+        abcd = vsha1cq_u32(abcd, e, wk);
+      else if( g < 10 || g >= 15 )
+        abcd = vsha1pq_u32(abcd, e, wk);
+      else
+        abcd = vsha1mq_u32(abcd, e, wk);
+      e = next;
+      }
+    abcd = vaddq_u32(abcd, abcd_save);
+    e += e_save;
+    }
+  vst1q_u32(state, abcd);
+  state[4] = e;
+}
+
+const uint32_t K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+void SHA256Blocks(uint32_t state[8], const unsigned char *data, size_t n)
+{
+  uint32x4_t abcd = vld1q_u32(state);
+  uint32x4_t efgh = vld1q_u32(state + 4);
+  uint32x4_t M[4];
+  for( ; n; --n, data += 64 )
+    {
+    const uint32x4_t abcd_save = abcd;
+    const uint32x4_t efgh_save = efgh;
+    for(int i = 0; i < 4; ++i)
+      M[i] = LoadBE(data + 16 * i);
+    for(int g = 0; g < 16; ++g)
+      {
+      if( g >= 4 )
+        M[g % 4] = vsha256su1q_u32(vsha256su0q_u32(M[g % 4], M[(g + 1) % 4]), M[(g + 2) % 4], M[(g + 3) % 4]);
+      const uint32x4_t wk = vaddq_u32(M[g % 4], vld1q_u32(K256 + 4 * g));
+      const uint32x4_t prev = abcd;
+      abcd = vsha256hq_u32(abcd, efgh, wk);
+      efgh = vsha256h2q_u32(efgh, prev, wk);
+      }
+    abcd = vaddq_u32(abcd, abcd_save);
+    efgh = vaddq_u32(efgh, efgh_save);
+    }
+  vst1q_u32(state, abcd);
+  vst1q_u32(state + 4, efgh);
+}
+
+const Table ARMv8Table = { SHA1Blocks, SHA256Blocks };
+} // end anonymous namespace
+
+const Table *GetARMv8Table()
+{
+  return &ARMv8Table;
+}
+
+} // end namespace HashKernelsDetail
+} // end namespace gdcm
@@ -0,0 +1,144 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compiled with -msse4.1 -msha, do not include any other gdcm header here.
+#include "gdcmHashKernelsTable.h"
+
+#include <immintrin.h>
+
+namespace gdcm
+{
+namespace HashKernelsDetail
+{
+
+namespace
+{
+/*
+ * Intel SHA extensions, see "Intel SHA Extensions" (Gulley et al., 2013).
+ * Message schedule: the four words of group g (rounds 4g..4g+3) are kept in
+ * M[g % 4]; group g+1 is finished while group g goes through the rounds,
+ * each step below being only defined for the groups that still need it.
+ * The macros are expanded with constant g, so that M stays in registers.
+ */
+#define GDCM_SHA1_GROUP(g) \
+  if( (g) == 0 ) \
+    { \
+    e0 = _mm_add_epi32(e0, M[0]); \
+    e1 = abcd; \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0); \
+    } \
+  else if( (g) % 2 ) \
+    { \
+    e1 = _mm_sha1nexte_epu32(e1, M[(g) % 4]); \
+    e0 = abcd; \
+    if( (g) >= 3 && (g) <= 18 ) M[((g) + 1) % 4] = _mm_sha1msg2_epu32(M[((g) + 1) % 4], M[(g) % 4]); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, (g) / 5); \
+    } \
+  else \
+    { \
+    e0 = _mm_sha1nexte_epu32(e0, M[(g) % 4]); \
+    e1 = abcd; \
+    if( (g) >= 3 && (g) <= 18 ) M[((g) + 1) % 4] = _mm_sha1msg2_epu32(M[((g) + 1) % 4], M[(g) % 4]); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, (g) / 5); \
+    } \
+  if( (g) >= 1 && (g) <= 16 ) M[((g) + 3) % 4] = _mm_sha1msg1_epu32(M[((g) + 3) % 4], M[(g) % 4]); \
+  if( (g) >= 2 && (g) <= 17 ) M[((g) + 2) % 4] = _mm_xor_si128(M[((g) + 2) % 4], M[(g) % 4]);
+
+void SHA1Blocks(uint32_t state[5], const unsigned char *data, size_t n)
+{
+  const __m128i mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+  __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+  __m128i e1;
+  __m128i M[4];
+  for( ; n; --n, data += 64 )
+    {
+    const __m128i abcd_save = abcd;
+    const __m128i e0_save = e0;
+    for(int i = 0; i < 4; ++i)
+      M[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+    GDCM_SHA1_GROUP(0)  GDCM_SHA1_GROUP(1)  GDCM_SHA1_GROUP(2)  GDCM_SHA1_GROUP(3)
+    GDCM_SHA1_GROUP(4)  GDCM_SHA1_GROUP(5)  GDCM_SHA1_GROUP(6)  GDCM_SHA1_GROUP(7)
+    GDCM_SHA1_GROUP(8)  GDCM_SHA1_GROUP(9)  GDCM_SHA1_GROUP(10) GDCM_SHA1_GROUP(11)
+    GDCM_SHA1_GROUP(12) GDCM_SHA1_GROUP(13) GDCM_SHA1_GROUP(14) GDCM_SHA1_GROUP(15)
+    GDCM_SHA1_GROUP(16) GDCM_SHA1_GROUP(17) GDCM_SHA1_GROUP(18) GDCM_SHA1_GROUP(19)
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+  _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+  state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+#undef GDCM_SHA1_GROUP
+
+const uint32_t K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// state0 holds ABEF, state1 CDGH, as sha256rnds2 wants them
+#define GDCM_SHA256_GROUP(g) \
+  msg = _mm_add_epi32(M[(g) % 4], _mm_loadu_si128((const __m128i*)(K256 + 4 * (g)))); \
+  state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+  if( (g) >= 3 && (g) <= 14 ) \
+    { \
+    M[((g) + 1) % 4] = _mm_add_epi32(M[((g) + 1) % 4], _mm_alignr_epi8(M[(g) % 4], M[((g) + 3) % 4], 4)); \
+    M[((g) + 1) % 4] = _mm_sha256msg2_epu32(M[((g) + 1) % 4], M[(g) % 4]); \
+    } \
+  state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e)); \
+  if( (g) >= 1 && (g) <= 12 ) M[((g) + 3) % 4] = _mm_sha256msg1_epu32(M[((g) + 3) % 4], M[(g) % 4]);
+
+void SHA256Blocks(uint32_t state[8], const unsigned char *data, size_t n)
+{
+  const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xb1); // CDAB
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1b); // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0); // CDGH
+  __m128i msg;
+  __m128i M[4];
+  for( ; n; --n, data += 64 )
+    {
+    const __m128i state0_save = state0;
+    const __m128i state1_save = state1;
+    for(int i = 0; i < 4; ++i)
+      M[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+    GDCM_SHA256_GROUP(0)  GDCM_SHA256_GROUP(1)  GDCM_SHA256_GROUP(2)  GDCM_SHA256_GROUP(3)
+    GDCM_SHA256_GROUP(4)  GDCM_SHA256_GROUP(5)  GDCM_SHA256_GROUP(6)  GDCM_SHA256_GROUP(7)
+    GDCM_SHA256_GROUP(8)  GDCM_SHA256_GROUP(9)  GDCM_SHA256_GROUP(10) GDCM_SHA256_GROUP(11)
+    GDCM_SHA256_GROUP(12) GDCM_SHA256_GROUP(13) GDCM_SHA256_GROUP(14) GDCM_SHA256_GROUP(15)
+    state0 = _mm_add_epi32(state0, state0_save);
+    state1 = _mm_add_epi32(state1, state1_save);
+    }
+  tmp = _mm_shuffle_epi32(state0, 0x1b); // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xb1); // DCHG
+  _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(tmp, state1, 0xf0)); // DCBA
+  _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+#undef GDCM_SHA256_GROUP
+
+const Table SHANITable = { SHA1Blocks, SHA256Blocks };
+} // end anonymous namespace
+
+const Table *GetSHANITable()
+{
+  return &SHANITable;
+}
+
+} // end namespace HashKernelsDetail
+} // end namespace gdcm
@@ -0,0 +1,41 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMHASHKERNELSTABLE_H
+#define GDCMHASHKERNELSTABLE_H
+
+// Private header, shared in between gdcmHashKernels.cxx and the instruction
+// set specific translation units. Same rule as gdcmPixelKernelsTable.h: no
+// other gdcm header, the SHA-NI/ARMv8 units are compiled with special flags.
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gdcm
+{
+namespace HashKernelsDetail
+{
+
+// Process n 64 bytes blocks, the state is the FIPS 180-4 one (H0, H1...)
+struct Table
+{
+  void (*SHA1Blocks)(uint32_t state[5], const unsigned char *data, size_t n);
+  void (*SHA256Blocks)(uint32_t state[8], const unsigned char *data, size_t n);
+};
+
+const Table *GetSHANITable();
+const Table *GetARMv8Table();
+
+} // end namespace HashKernelsDetail
+} // end namespace gdcm
+
+#endif //GDCMHASHKERNELSTABLE_H
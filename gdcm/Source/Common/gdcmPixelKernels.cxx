@@ -0,0 +1,398 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmPixelKernels.h"
+#include "gdcmPixelKernelsTable.h"
+
+#if defined(GDCM_PIXELKERNELS_SSE2) || defined(GDCM_PIXELKERNELS_AVX2)
+#define GDCM_PIXELKERNELS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace gdcm
+{
+
+namespace
+{
+// The scalar code is the reference implementation, every vector kernel has to
+// produce the exact same output. The expressions are kept identical to the
+// ones found in Unpacker12Bits and Rescaler.
+template <typename TOut, typename TIn>
+void ScalarRescale(TOut *out, const TIn *in, double intercept, double slope,
+  size_t n)
+{
+  for(size_t i = 0; i != n; ++i)
+    {
+    out[i] = (TOut)(slope * in[i] + intercept);
+    }
+}
+
+template <typename TIn>
+struct ScalarInverse
+{
+  template <typename TOut>
+  static void Apply(TOut *out, const TIn *in, double intercept, double slope,
+    size_t n)
+    {
+    for(size_t i = 0; i != n; ++i)
+      {
+      out[i] = (TOut)(((double)in[i] - intercept) / slope);
+      }
+    }
+};
+
+// '+ 0.5' when the input is floating point, see Rescaler
+template <>
+struct ScalarInverse<float>
+{
+  template <typename TOut>
+  static void Apply(TOut *out, const float *in, double intercept, double slope,
+    size_t n)
+    {
+    for(size_t i = 0; i != n; ++i)
+      {
+      out[i] = (TOut)(((double)in[i] - intercept) / slope + 0.5);
+      }
+    }
+};
+
+template <>
+struct ScalarInverse<double>
+{
+  template <typename TOut>
+  static void Apply(TOut *out, const double *in, double intercept, double slope,
+    size_t n)
+    {
+    for(size_t i = 0; i != n; ++i)
+      {
+      out[i] = (TOut)(((double)in[i] - intercept) / slope + 0.5);
+      }
+    }
+};
+
+template <typename TIn>
+bool ScalarRescaleInto(void *out, int outtype, const TIn *in,
+  double intercept, double slope, size_t n)
+{
+  switch(outtype)
+    {
+  case PixelKernels::INT16:
+    ScalarRescale((int16_t*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::UINT16:
+    ScalarRescale((uint16_t*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::INT32:
+    ScalarRescale((int32_t*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::FLOAT32:
+    ScalarRescale((float*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::FLOAT64:
+    ScalarRescale((double*)out, in, intercept, slope, n);
+    break;
+  default:
+    return false;
+    }
+  return true;
+}
+
+template <typename TIn>
+bool ScalarInverseRescaleInto(void *out, int outtype, const TIn *in,
+  double intercept, double slope, size_t n)
+{
+  switch(outtype)
+    {
+  case PixelKernels::INT16:
+    ScalarInverse<TIn>::Apply((int16_t*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::UINT16:
+    ScalarInverse<TIn>::Apply((uint16_t*)out, in, intercept, slope, n);
+    break;
+  case PixelKernels::INT32:
+    ScalarInverse<TIn>::Apply((int32_t*)out, in, intercept, slope, n);
+    break;
+  default:
+    return false;
+    }
+  return true;
+}
+
+size_t GetScalarSize(int type)
+{
+  switch(type)
+    {
+  case PixelKernels::INT16:
+  case PixelKernels::UINT16:
+    return 2;
+  case PixelKernels::INT32:
+  case PixelKernels::FLOAT32:
+    return 4;
+  case PixelKernels::FLOAT64:
+    return 8;
+    }
+  return 0;
+}
+
+// Scalar: no vector kernel at all
+const PixelKernelsDetail::Table ScalarTable = { 0, 0, 0, 0, 0, 0, 0 };
+
+// Constant initialized, so that any call made during static initialization
+// (before the cpu has been inspected) safely ends up in the scalar code.
+const PixelKernelsDetail::Table *CurrentTable = &ScalarTable;
+PixelKernels::InstructionSetType CurrentInstructionSet = PixelKernels::SCALAR;
+
+#ifdef GDCM_PIXELKERNELS_X86
+// registers are returned as: eax, ebx, ecx, edx
+bool CpuId(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, 0);
+  if( (unsigned int)r[0] < leaf ) return false;
+  __cpuidex(r, (int)leaf, 0);
+  for(int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+  return true;
+#elif defined(__GNUC__)
+  if( __get_cpuid_max(0, 0) < leaf ) return false;
+  __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+  return true;
+#else
+  (void)leaf; (void)regs;
+  return false;
+#endif
+}
+
+// Has the OS enabled the saving of the xmm/ymm registers ?
+bool OSSupportsYMM()
+{
+#if defined(_MSC_VER) && (_MSC_FULL_VER >= 160040219)
+  return (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__)
+  unsigned int eax, edx;
+  __asm__ __volatile__( "xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) );
+  return (eax & 0x6) == 0x6;
+#else
+  return false;
+#endif
+}
+
+bool CpuHasSSE2()
+{
+  unsigned int regs[4];
+  if( !CpuId(1, regs) ) return false;
+  return (regs[3] & (1u << 26)) != 0;
+}
+
+bool CpuHasAVX2()
+{
+  unsigned int regs[4];
+  if( !CpuId(1, regs) ) return false;
+  const unsigned int osxsave = 1u << 27;
+  const unsigned int avx = 1u << 28;
+  if( (regs[2] & (osxsave | avx)) != (osxsave | avx) ) return false;
+  if( !OSSupportsYMM() ) return false;
+  if( !CpuId(7, regs) ) return false;
+  return (regs[1] & (1u << 5)) != 0;
+}
+#endif
+
+const PixelKernelsDetail::Table *GetTable(PixelKernels::InstructionSetType is)
+{
+  switch(is)
+    {
+  case PixelKernels::SCALAR:
+    return &ScalarTable;
+#ifdef GDCM_PIXELKERNELS_SSE2
+  case PixelKernels::SSE2:
+    return CpuHasSSE2() ? PixelKernelsDetail::GetSSE2Table() : 0;
+#endif
+#ifdef GDCM_PIXELKERNELS_AVX2
+  case PixelKernels::AVX2:
+    return CpuHasAVX2() ? PixelKernelsDetail::GetAVX2Table() : 0;
+#endif
+#ifdef GDCM_PIXELKERNELS_NEON
+  case PixelKernels::NEON:
+    // Advanced SIMD is mandatory on aarch64
+    return PixelKernelsDetail::GetNEONTable();
+#endif
+  default:
+    break;
+    }
+  return 0;
+}
+
+// Select the best instruction set once the library is loaded
+struct PixelKernelsInitializer
+{
+  PixelKernelsInitializer()
+    {
+    PixelKernels::SetInstructionSet( PixelKernels::GetBestInstructionSet() );
+    }
+};
+PixelKernelsInitializer TheInitializer;
+
+} // end anonymous namespace
+
+PixelKernels::InstructionSetType PixelKernels::GetInstructionSet()
+{
+  return CurrentInstructionSet;
+}
+
+bool PixelKernels::SetInstructionSet(InstructionSetType is)
+{
+  const PixelKernelsDetail::Table *table = GetTable(is);
+  if( !table ) return false;
+  CurrentTable = table;
+  CurrentInstructionSet = is;
+  return true;
+}
+
+bool PixelKernels::IsInstructionSetSupported(InstructionSetType is)
+{
+  return GetTable(is) != 0;
+}
+
+PixelKernels::InstructionSetType PixelKernels::GetBestInstructionSet()
+{
+  if( IsInstructionSetSupported(AVX2) ) return AVX2;
+  if( IsInstructionSetSupported(SSE2) ) return SSE2;
+  if( IsInstructionSetSupported(NEON) ) return NEON;
+  return SCALAR;
+}
+
+const char *PixelKernels::GetInstructionSetString(InstructionSetType is)
+{
+  switch(is)
+    {
+  case SCALAR:
+    return "SCALAR";
+  case SSE2:
+    return "SSE2";
+  case AVX2:
+    return "AVX2";
+  case NEON:
+    return "NEON";
+    }
+  return 0;
+}
+
+void PixelKernels::SwapBytes16(uint16_t *p, size_t n)
+{
+  size_t i = CurrentTable->SwapBytes16 ? CurrentTable->SwapBytes16(p, n) : 0;
+  for( ; i < n; ++i )
+    {
+    p[i] = (uint16_t)((p[i] << 8) | (p[i] >> 8));
+    }
+}
+
+void PixelKernels::SwapBytes32(uint32_t *p, size_t n)
+{
+  size_t i = CurrentTable->SwapBytes32 ? CurrentTable->SwapBytes32(p, n) : 0;
+  for( ; i < n; ++i )
+    {
+    const uint32_t a = p[i];
+    p[i] = (a << 24) | ((a << 8) & 0x00ff0000) | ((a >> 8) & 0x0000ff00) | (a >> 24);
+    }
+}
+
+void PixelKernels::SwapWords32(uint32_t *p, size_t n)
+{
+  size_t i = CurrentTable->SwapWords32 ? CurrentTable->SwapWords32(p, n) : 0;
+  for( ; i < n; ++i )
+    {
+    p[i] = (p[i] << 16) | (p[i] >> 16);
+    }
+}
+
+void PixelKernels::Unpack12Bits(uint16_t *out, const unsigned char *in, size_t n)
+{
+  const size_t done =
+    CurrentTable->Unpack12Bits ? CurrentTable->Unpack12Bits(out, in, n) : 0;
+  uint16_t *q = out + done / 3 * 2;
+  const unsigned char *p = in + done;
+  const unsigned char *end = in + n;
+  unsigned char b0,b1,b2;
+  while( p != end )
+    {
+    b0 = *p++;
+    b1 = *p++;
+    b2 = *p++;
+    *q++ = (uint16_t)(((b1 & 0xf) << 8) + b0);
+    *q++ = (uint16_t)((b1>>4) + (b2<<4));
+    }
+}
+
+void PixelKernels::Pack12Bits(unsigned char *out, const uint16_t *in, size_t n)
+{
+  const size_t done =
+    CurrentTable->Pack12Bits ? CurrentTable->Pack12Bits(out, in, n) : 0;
+  unsigned char *q = out + done / 2 * 3;
+  const uint16_t *p = in + done;
+  const uint16_t *end = in + n;
+  uint16_t b0,b1;
+  while( p != end )
+    {
+    b0 = *p++;
+    b1 = *p++;
+    *q++ = (unsigned char)(b0 & 0xff);
+    *q++ = (unsigned char)((b0 >> 8) + ((b1 & 0xf) << 4));
+    *q++ = (unsigned char)(b1 >> 4);
+    }
+}
+
+bool PixelKernels::Rescale(void *out, ScalarType outtype, const void *in,
+  ScalarType intype, double intercept, double slope, size_t n)
+{
+  if( intype != INT16 && intype != UINT16 ) return false;
+  if( !GetScalarSize(outtype) ) return false;
+  const size_t done = CurrentTable->Rescale ?
+    CurrentTable->Rescale(out, outtype, in, intype, intercept, slope, n) : 0;
+  char *o = (char*)out + done * GetScalarSize(outtype);
+  const char *i = (const char*)in + done * GetScalarSize(intype);
+  if( intype == INT16 )
+    return ScalarRescaleInto(o, outtype, (const int16_t*)i, intercept, slope, n - done);
+  return ScalarRescaleInto(o, outtype, (const uint16_t*)i, intercept, slope, n - done);
+}
+
+bool PixelKernels::InverseRescale(void *out, ScalarType outtype, const void *in,
+  ScalarType intype, double intercept, double slope, size_t n)
+{
+  if( outtype != INT16 && outtype != UINT16 && outtype != INT32 ) return false;
+  if( intype == INT32 || !GetScalarSize(intype) ) return false;
+  const size_t done = CurrentTable->InverseRescale ?
+    CurrentTable->InverseRescale(out, outtype, in, intype, intercept, slope, n) : 0;
+  char *o = (char*)out + done * GetScalarSize(outtype);
+  const char *i = (const char*)in + done * GetScalarSize(intype);
+  const size_t left = n - done;
+  switch(intype)
+    {
+  case INT16:
+    return ScalarInverseRescaleInto(o, outtype, (const int16_t*)i, intercept, slope, left);
+  case UINT16:
+    return ScalarInverseRescaleInto(o, outtype, (const uint16_t*)i, intercept, slope, left);
+  case FLOAT32:
+    return ScalarInverseRescaleInto(o, outtype, (const float*)i, intercept, slope, left);
+  case FLOAT64:
+    return ScalarInverseRescaleInto(o, outtype, (const double*)i, intercept, slope, left);
+  default:
+    break;
+    }
+  return false;
+}
+
+} // end namespace gdcm
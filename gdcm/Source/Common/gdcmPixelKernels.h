@@ -0,0 +1,100 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMPIXELKERNELS_H
+#define GDCMPIXELKERNELS_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+
+/**
+ * \brief Vectorized pixel kernels
+ * \details Inner loops used by ByteSwap, Unpacker12Bits and Rescaler. Each
+ * kernel has a scalar implementation and, depending on the build, SSE2, AVX2
+ * and NEON implementations. The best instruction set supported by the running
+ * CPU is selected at load time.
+ *
+ * \note All implementations are bit-exact with the scalar code: the
+ * rescale kernels use the exact same sequence of double precision operations
+ * (no FMA, no float approximation) as Rescaler.
+ *
+ * \note This is a low level class, one would generally use ByteSwap,
+ * Unpacker12Bits or Rescaler directly.
+ *
+ * \see ByteSwap Unpacker12Bits Rescaler
+ */
+class GDCM_EXPORT PixelKernels
+{
+public:
+  typedef enum {
+    SCALAR = 0,
+    SSE2,
+    AVX2,
+    NEON
+  } InstructionSetType;
+
+  /// Scalar types handled by the Rescale kernels
+  typedef enum {
+    INT16 = 0,
+    UINT16,
+    INT32,
+    FLOAT32,
+    FLOAT64
+  } ScalarType;
+
+  /// Return the instruction set currently in use
+  static InstructionSetType GetInstructionSet();
+
+  /// Force an instruction set (benchmark, testing). Return false (and leave
+  /// the current one untouched) if it is not supported by both the build and
+  /// the running CPU.
+  static bool SetInstructionSet(InstructionSetType is);
+
+  /// Is instruction set `is` available at runtime ?
+  static bool IsInstructionSetSupported(InstructionSetType is);
+
+  /// Return the best instruction set for the running CPU
+  static InstructionSetType GetBestInstructionSet();
+
+  static const char *GetInstructionSetString(InstructionSetType is);
+
+  /// Swap bytes within each 16bits word (SwapCode 2143 / 4321 on 16bits)
+  static void SwapBytes16(uint16_t *p, size_t n);
+  /// Reverse the 4 bytes of each 32bits word (SwapCode 4321)
+  static void SwapBytes32(uint32_t *p, size_t n);
+  /// Swap the two 16bits halves of each 32bits word (SwapCode 3412)
+  static void SwapWords32(uint32_t *p, size_t n);
+
+  /// Unpack 12bits packed data, n is the number of input bytes (multiple of 3)
+  static void Unpack12Bits(uint16_t *out, const unsigned char *in, size_t n);
+  /// Pack 16bits words into 12bits, n is the number of input words (even)
+  static void Pack12Bits(unsigned char *out, const uint16_t *in, size_t n);
+
+  /// out[i] = (TOut)(slope * in[i] + intercept), n is the number of values.
+  /// Return false when the pair of types is not handled (INT16/UINT16 input
+  /// only), in which case nothing is written.
+  static bool Rescale(void *out, ScalarType outtype, const void *in,
+    ScalarType intype, double intercept, double slope, size_t n);
+
+  /// out[i] = (TOut)((in[i] - intercept) / slope) (+ 0.5 for floating point
+  /// input), n is the number of values. Return false when the pair of types is
+  /// not handled (integer output only), in which case nothing is written.
+  static bool InverseRescale(void *out, ScalarType outtype, const void *in,
+    ScalarType intype, double intercept, double slope, size_t n);
+};
+
+} // end namespace gdcm
+
+#endif //GDCMPIXELKERNELS_H
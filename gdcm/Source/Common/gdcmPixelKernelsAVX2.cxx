@@ -0,0 +1,328 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compiled with -mavx2, do not include any other gdcm header here.
+#include "gdcmPixelKernelsTable.h"
+
+#include <immintrin.h>
+#include <string.h> // memcpy
+
+namespace gdcm
+{
+namespace PixelKernelsDetail
+{
+
+namespace
+{
+inline __m256i LoadU(const void *p)
+{
+  return _mm256_loadu_si256((const __m256i*)p);
+}
+
+inline void StoreU(void *p, __m256i v)
+{
+  _mm256_storeu_si256((__m256i*)p, v);
+}
+
+inline __m256i Broadcast(__m128i v)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(v), v, 1);
+}
+
+template <typename T>
+size_t Shuffle(T *p, size_t n, __m256i mask)
+{
+  const size_t step = 32 / sizeof(T);
+  size_t i = 0;
+  for( ; i + step <= n; i += step )
+    {
+    StoreU(p + i, _mm256_shuffle_epi8(LoadU(p + i), mask));
+    }
+  return i;
+}
+
+size_t SwapBytes16(uint16_t *p, size_t n)
+{
+  return Shuffle(p, n, Broadcast(
+      _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14)));
+}
+
+size_t SwapBytes32(uint32_t *p, size_t n)
+{
+  return Shuffle(p, n, Broadcast(
+      _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12)));
+}
+
+size_t SwapWords32(uint32_t *p, size_t n)
+{
+  return Shuffle(p, n, Broadcast(
+      _mm_setr_epi8(2,3,0,1,6,7,4,5,10,11,8,9,14,15,12,13)));
+}
+
+// 24 bytes -> 16 words, 12 bytes per 128bits lane. Each pair of output words
+// is gathered from (b0,b1) and (b1,b2), the even word is masked, the odd one
+// shifted.
+size_t Unpack12Bits(uint16_t *out, const unsigned char *in, size_t n)
+{
+  const __m256i shuffle = Broadcast(
+    _mm_setr_epi8(0,1,1,2,3,4,4,5,6,7,7,8,9,10,10,11));
+  const __m256i even = _mm256_set1_epi32(0x00000fff);
+  const __m256i odd = _mm256_set1_epi32((int)0xffff0000);
+  size_t i = 0;
+  // the second lane reads 4 bytes past the 24 used ones:
+  for( ; i + 28 <= n; i += 24 )
+    {
+    const __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(
+        _mm_loadu_si128((const __m128i*)(in + i))),
+      _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+    const __m256i v = _mm256_shuffle_epi8(x, shuffle);
+    StoreU(out + i / 3 * 2, _mm256_or_si256(_mm256_and_si256(v, even),
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), odd)));
+    }
+  return i;
+}
+
+// 16 words -> 24 bytes. Each 32bits lane (w0,w1) is turned into its 3 output
+// bytes, which are then compacted to 12 bytes per 128bits lane.
+size_t Pack12Bits(unsigned char *out, const uint16_t *in, size_t n)
+{
+  const __m256i ff = _mm256_set1_epi32(0xff);
+  const __m256i compact = Broadcast(
+    _mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1));
+  size_t i = 0;
+  for( ; i + 16 <= n; i += 16 )
+    {
+    const __m256i x = LoadU(in + i);
+    // b0 & 0xff
+    const __m256i q0 = _mm256_and_si256(x, ff);
+    // (b0 >> 8) + ((b1 & 0xf) << 4), truncated to 8 bits
+    const __m256i q1 = _mm256_and_si256(_mm256_add_epi32(
+        _mm256_and_si256(_mm256_srli_epi32(x, 8), ff),
+        _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(x, 16),
+            _mm256_set1_epi32(0xf)), 4)),
+      ff);
+    // b1 >> 4
+    const __m256i q2 = _mm256_and_si256(_mm256_srli_epi32(x, 20), ff);
+    const __m256i v = _mm256_shuffle_epi8(_mm256_or_si256(q0,
+        _mm256_or_si256(_mm256_slli_epi32(q1, 8), _mm256_slli_epi32(q2, 16))),
+      compact);
+    unsigned char *q = out + i / 2 * 3;
+    const __m128i lo = _mm256_castsi256_si128(v);
+    const __m128i hi = _mm256_extracti128_si256(v, 1);
+    int last;
+    _mm_storel_epi64((__m128i*)q, lo);
+    last = _mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+    memcpy(q + 8, &last, 4);
+    _mm_storel_epi64((__m128i*)(q + 12), hi);
+    last = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+    memcpy(q + 20, &last, 4);
+    }
+  return i;
+}
+
+// Rescale: 8 values per iteration, as 2 x 4 doubles. Same sequence of double
+// precision operations as the scalar code (this unit is not compiled with
+// -mfma, so no fused multiply-add).
+struct Pair
+{
+  __m256d d[2];
+};
+
+inline void FromInt32(Pair &p, __m256i v)
+{
+  p.d[0] = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+  p.d[1] = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+}
+
+inline void Load(Pair &p, const int16_t *in)
+{
+  FromInt32(p, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)in)));
+}
+
+inline void Load(Pair &p, const uint16_t *in)
+{
+  FromInt32(p, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)in)));
+}
+
+inline void Load(Pair &p, const float *in)
+{
+  const __m256 v = _mm256_loadu_ps(in);
+  p.d[0] = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+  p.d[1] = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+}
+
+inline void Load(Pair &p, const double *in)
+{
+  p.d[0] = _mm256_loadu_pd(in);
+  p.d[1] = _mm256_loadu_pd(in + 4);
+}
+
+// keep the low 16 bits of each int32 (like a C cast), then pack
+inline __m128i TruncateToInt16(__m128i a)
+{
+  return _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+}
+
+inline void Store(int16_t *out, const Pair &p)
+{
+  _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(
+      TruncateToInt16(_mm256_cvttpd_epi32(p.d[0])),
+      TruncateToInt16(_mm256_cvttpd_epi32(p.d[1]))));
+}
+
+inline void Store(uint16_t *out, const Pair &p)
+{
+  Store((int16_t*)out, p);
+}
+
+inline void Store(int32_t *out, const Pair &p)
+{
+  _mm_storeu_si128((__m128i*)out, _mm256_cvttpd_epi32(p.d[0]));
+  _mm_storeu_si128((__m128i*)(out + 4), _mm256_cvttpd_epi32(p.d[1]));
+}
+
+inline void Store(float *out, const Pair &p)
+{
+  _mm_storeu_ps(out, _mm256_cvtpd_ps(p.d[0]));
+  _mm_storeu_ps(out + 4, _mm256_cvtpd_ps(p.d[1]));
+}
+
+inline void Store(double *out, const Pair &p)
+{
+  _mm256_storeu_pd(out, p.d[0]);
+  _mm256_storeu_pd(out + 4, p.d[1]);
+}
+
+template <typename TOut, typename TIn>
+size_t RescaleLoop(TOut *out, const TIn *in, double intercept, double slope,
+  size_t n)
+{
+  const __m256d vi = _mm256_set1_pd(intercept);
+  const __m256d vs = _mm256_set1_pd(slope);
+  size_t i = 0;
+  Pair p;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(p, in + i);
+    p.d[0] = _mm256_add_pd(_mm256_mul_pd(vs, p.d[0]), vi);
+    p.d[1] = _mm256_add_pd(_mm256_mul_pd(vs, p.d[1]), vi);
+    Store(out + i, p);
+    }
+  return i;
+}
+
+template <typename TOut, typename TIn>
+size_t InverseRescaleLoop(TOut *out, const TIn *in, double intercept,
+  double slope, bool round, size_t n)
+{
+  const __m256d vi = _mm256_set1_pd(intercept);
+  const __m256d vs = _mm256_set1_pd(slope);
+  const __m256d half = _mm256_set1_pd(0.5);
+  size_t i = 0;
+  Pair p;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(p, in + i);
+    p.d[0] = _mm256_div_pd(_mm256_sub_pd(p.d[0], vi), vs);
+    p.d[1] = _mm256_div_pd(_mm256_sub_pd(p.d[1], vi), vs);
+    if( round )
+      {
+      p.d[0] = _mm256_add_pd(p.d[0], half);
+      p.d[1] = _mm256_add_pd(p.d[1], half);
+      }
+    Store(out + i, p);
+    }
+  return i;
+}
+
+template <typename TIn>
+size_t RescaleInto(void *out, int outtype, const TIn *in, double intercept,
+  double slope, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return RescaleLoop((int16_t*)out, in, intercept, slope, n);
+  case UINT16:
+    return RescaleLoop((uint16_t*)out, in, intercept, slope, n);
+  case INT32:
+    return RescaleLoop((int32_t*)out, in, intercept, slope, n);
+  case FLOAT32:
+    return RescaleLoop((float*)out, in, intercept, slope, n);
+  case FLOAT64:
+    return RescaleLoop((double*)out, in, intercept, slope, n);
+    }
+  return 0;
+}
+
+size_t Rescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  if( intype == INT16 )
+    return RescaleInto(out, outtype, (const int16_t*)in, intercept, slope, n);
+  if( intype == UINT16 )
+    return RescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, n);
+  return 0;
+}
+
+template <typename TIn>
+size_t InverseRescaleInto(void *out, int outtype, const TIn *in,
+  double intercept, double slope, bool round, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return InverseRescaleLoop((int16_t*)out, in, intercept, slope, round, n);
+  case UINT16:
+    return InverseRescaleLoop((uint16_t*)out, in, intercept, slope, round, n);
+  case INT32:
+    return InverseRescaleLoop((int32_t*)out, in, intercept, slope, round, n);
+    }
+  return 0;
+}
+
+size_t InverseRescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  switch(intype)
+    {
+  case INT16:
+    return InverseRescaleInto(out, outtype, (const int16_t*)in, intercept, slope, false, n);
+  case UINT16:
+    return InverseRescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, false, n);
+  case FLOAT32:
+    return InverseRescaleInto(out, outtype, (const float*)in, intercept, slope, true, n);
+  case FLOAT64:
+    return InverseRescaleInto(out, outtype, (const double*)in, intercept, slope, true, n);
+    }
+  return 0;
+}
+
+const Table AVX2Table = {
+  SwapBytes16,
+  SwapBytes32,
+  SwapWords32,
+  Unpack12Bits,
+  Pack12Bits,
+  Rescale,
+  InverseRescale
+};
+} // end anonymous namespace
+
+const Table *GetAVX2Table()
+{
+  return &AVX2Table;
+}
+
+} // end namespace PixelKernelsDetail
+} // end namespace gdcm
@@ -0,0 +1,298 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// aarch64 only (the rescale kernels need double precision vectors).
+#include "gdcmPixelKernelsTable.h"
+
+#include <arm_neon.h>
+
+namespace gdcm
+{
+namespace PixelKernelsDetail
+{
+
+namespace
+{
+size_t SwapBytes16(uint16_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    const uint8x16_t v = vreinterpretq_u8_u16(vld1q_u16(p + i));
+    vst1q_u16(p + i, vreinterpretq_u16_u8(vrev16q_u8(v)));
+    }
+  return i;
+}
+
+size_t SwapBytes32(uint32_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    {
+    const uint8x16_t v = vreinterpretq_u8_u32(vld1q_u32(p + i));
+    vst1q_u32(p + i, vreinterpretq_u32_u8(vrev32q_u8(v)));
+    }
+  return i;
+}
+
+size_t SwapWords32(uint32_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    {
+    const uint16x8_t v = vreinterpretq_u16_u32(vld1q_u32(p + i));
+    vst1q_u32(p + i, vreinterpretq_u32_u16(vrev32q_u16(v)));
+    }
+  return i;
+}
+
+// 24 bytes -> 16 words, the de-interleaving load splits b0, b1 and b2
+size_t Unpack12Bits(uint16_t *out, const unsigned char *in, size_t n)
+{
+  const uint8x8_t low4 = vdup_n_u8(0xf);
+  size_t i = 0;
+  for( ; i + 24 <= n; i += 24 )
+    {
+    const uint8x8x3_t b = vld3_u8(in + i);
+    uint16x8x2_t w;
+    // ((b1 & 0xf) << 8) + b0
+    w.val[0] = vaddq_u16(vshll_n_u8(vand_u8(b.val[1], low4), 8),
+      vmovl_u8(b.val[0]));
+    // (b1 >> 4) + (b2 << 4)
+    w.val[1] = vaddq_u16(vmovl_u8(vshr_n_u8(b.val[1], 4)),
+      vshll_n_u8(b.val[2], 4));
+    vst2q_u16(out + i / 3 * 2, w);
+    }
+  return i;
+}
+
+// 16 words -> 24 bytes, the interleaving store merges the 3 output bytes
+size_t Pack12Bits(unsigned char *out, const uint16_t *in, size_t n)
+{
+  const uint16x8_t low4 = vdupq_n_u16(0xf);
+  size_t i = 0;
+  for( ; i + 16 <= n; i += 16 )
+    {
+    const uint16x8x2_t w = vld2q_u16(in + i);
+    uint8x8x3_t b;
+    b.val[0] = vmovn_u16(w.val[0]);
+    b.val[1] = vmovn_u16(vaddq_u16(vshrq_n_u16(w.val[0], 8),
+        vshlq_n_u16(vandq_u16(w.val[1], low4), 4)));
+    b.val[2] = vmovn_u16(vshrq_n_u16(w.val[1], 4));
+    vst3_u8(out + i / 2 * 3, b);
+    }
+  return i;
+}
+
+// Rescale: 8 values per iteration, as 4 x 2 doubles. gdcmPixelKernels.cxx
+// and this unit are compiled with -ffp-contract=off so that neither side turns
+// the mul/add into a fused multiply-add.
+struct Quad
+{
+  float64x2_t d[4];
+};
+
+inline void Load(Quad &q, const int16_t *in)
+{
+  const int16x8_t v = vld1q_s16(in);
+  const int32x4_t lo = vmovl_s16(vget_low_s16(v));
+  const int32x4_t hi = vmovl_s16(vget_high_s16(v));
+  q.d[0] = vcvtq_f64_s64(vmovl_s32(vget_low_s32(lo)));
+  q.d[1] = vcvtq_f64_s64(vmovl_s32(vget_high_s32(lo)));
+  q.d[2] = vcvtq_f64_s64(vmovl_s32(vget_low_s32(hi)));
+  q.d[3] = vcvtq_f64_s64(vmovl_s32(vget_high_s32(hi)));
+}
+
+inline void Load(Quad &q, const uint16_t *in)
+{
+  const uint16x8_t v = vld1q_u16(in);
+  const uint32x4_t lo = vmovl_u16(vget_low_u16(v));
+  const uint32x4_t hi = vmovl_u16(vget_high_u16(v));
+  q.d[0] = vcvtq_f64_u64(vmovl_u32(vget_low_u32(lo)));
+  q.d[1] = vcvtq_f64_u64(vmovl_u32(vget_high_u32(lo)));
+  q.d[2] = vcvtq_f64_u64(vmovl_u32(vget_low_u32(hi)));
+  q.d[3] = vcvtq_f64_u64(vmovl_u32(vget_high_u32(hi)));
+}
+
+inline void Load(Quad &q, const float *in)
+{
+  const float32x4_t a = vld1q_f32(in);
+  const float32x4_t b = vld1q_f32(in + 4);
+  q.d[0] = vcvt_f64_f32(vget_low_f32(a));
+  q.d[1] = vcvt_high_f64_f32(a);
+  q.d[2] = vcvt_f64_f32(vget_low_f32(b));
+  q.d[3] = vcvt_high_f64_f32(b);
+}
+
+inline void Load(Quad &q, const double *in)
+{
+  for(int k = 0; k < 4; ++k) q.d[k] = vld1q_f64(in + 2 * k);
+}
+
+// A C cast to a 32bits (or smaller) integer is a saturating fcvtzs to 32bits
+inline int32x4_t TruncateToInt32(float64x2_t a, float64x2_t b)
+{
+  return vcombine_s32(vqmovn_s64(vcvtq_s64_f64(a)),
+    vqmovn_s64(vcvtq_s64_f64(b)));
+}
+
+inline void Store(int16_t *out, const Quad &q)
+{
+  vst1q_s16(out, vcombine_s16(
+      vmovn_s32(TruncateToInt32(q.d[0], q.d[1])),
+      vmovn_s32(TruncateToInt32(q.d[2], q.d[3]))));
+}
+
+inline void Store(uint16_t *out, const Quad &q)
+{
+  Store((int16_t*)out, q);
+}
+
+inline void Store(int32_t *out, const Quad &q)
+{
+  vst1q_s32(out, TruncateToInt32(q.d[0], q.d[1]));
+  vst1q_s32(out + 4, TruncateToInt32(q.d[2], q.d[3]));
+}
+
+inline void Store(float *out, const Quad &q)
+{
+  vst1q_f32(out, vcombine_f32(vcvt_f32_f64(q.d[0]), vcvt_f32_f64(q.d[1])));
+  vst1q_f32(out + 4, vcombine_f32(vcvt_f32_f64(q.d[2]), vcvt_f32_f64(q.d[3])));
+}
+
+inline void Store(double *out, const Quad &q)
+{
+  for(int k = 0; k < 4; ++k) vst1q_f64(out + 2 * k, q.d[k]);
+}
+
+template <typename TOut, typename TIn>
+size_t RescaleLoop(TOut *out, const TIn *in, double intercept, double slope,
+  size_t n)
+{
+  const float64x2_t vi = vdupq_n_f64(intercept);
+  const float64x2_t vs = vdupq_n_f64(slope);
+  size_t i = 0;
+  Quad q;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(q, in + i);
+    for(int k = 0; k < 4; ++k)
+      q.d[k] = vaddq_f64(vmulq_f64(vs, q.d[k]), vi);
+    Store(out + i, q);
+    }
+  return i;
+}
+
+template <typename TOut, typename TIn>
+size_t InverseRescaleLoop(TOut *out, const TIn *in, double intercept,
+  double slope, bool round, size_t n)
+{
+  const float64x2_t vi = vdupq_n_f64(intercept);
+  const float64x2_t vs = vdupq_n_f64(slope);
+  const float64x2_t half = vdupq_n_f64(0.5);
+  size_t i = 0;
+  Quad q;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(q, in + i);
+    for(int k = 0; k < 4; ++k)
+      {
+      q.d[k] = vdivq_f64(vsubq_f64(q.d[k], vi), vs);
+      if( round ) q.d[k] = vaddq_f64(q.d[k], half);
+      }
+    Store(out + i, q);
+    }
+  return i;
+}
+
+template <typename TIn>
+size_t RescaleInto(void *out, int outtype, const TIn *in, double intercept,
+  double slope, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return RescaleLoop((int16_t*)out, in, intercept, slope, n);
+  case UINT16:
+    return RescaleLoop((uint16_t*)out, in, intercept, slope, n);
+  case INT32:
+    return RescaleLoop((int32_t*)out, in, intercept, slope, n);
+  case FLOAT32:
+    return RescaleLoop((float*)out, in, intercept, slope, n);
+  case FLOAT64:
+    return RescaleLoop((double*)out, in, intercept, slope, n);
+    }
+  return 0;
+}
+
+size_t Rescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  if( intype == INT16 )
+    return RescaleInto(out, outtype, (const int16_t*)in, intercept, slope, n);
+  if( intype == UINT16 )
+    return RescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, n);
+  return 0;
+}
+
+template <typename TIn>
+size_t InverseRescaleInto(void *out, int outtype, const TIn *in,
+  double intercept, double slope, bool round, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return InverseRescaleLoop((int16_t*)out, in, intercept, slope, round, n);
+  case UINT16:
+    return InverseRescaleLoop((uint16_t*)out, in, intercept, slope, round, n);
+  case INT32:
+    return InverseRescaleLoop((int32_t*)out, in, intercept, slope, round, n);
+    }
+  return 0;
+}
+
+size_t InverseRescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  switch(intype)
+    {
+  case INT16:
+    return InverseRescaleInto(out, outtype, (const int16_t*)in, intercept, slope, false, n);
+  case UINT16:
+    return InverseRescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, false, n);
+  case FLOAT32:
+    return InverseRescaleInto(out, outtype, (const float*)in, intercept, slope, true, n);
+  case FLOAT64:
+    return InverseRescaleInto(out, outtype, (const double*)in, intercept, slope, true, n);
+    }
+  return 0;
+}
+
+const Table NEONTable = {
+  SwapBytes16,
+  SwapBytes32,
+  SwapWords32,
+  Unpack12Bits,
+  Pack12Bits,
+  Rescale,
+  InverseRescale
+};
+} // end anonymous namespace
+
+const Table *GetNEONTable()
+{
+  return &NEONTable;
+}
+
+} // end namespace PixelKernelsDetail
+} // end namespace gdcm
@@ -0,0 +1,335 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compiled with -msse2, do not include any other gdcm header here.
+#include "gdcmPixelKernelsTable.h"
+
+#include <emmintrin.h>
+#include <string.h> // memcpy
+
+namespace gdcm
+{
+namespace PixelKernelsDetail
+{
+
+namespace
+{
+size_t SwapBytes16(uint16_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i*)(p + i), v);
+    }
+  return i;
+}
+
+inline __m128i SwapWords(__m128i v)
+{
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+  return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+}
+
+size_t SwapWords32(uint32_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+    _mm_storeu_si128((__m128i*)(p + i), SwapWords(v));
+    }
+  return i;
+}
+
+size_t SwapBytes32(uint32_t *p, size_t n)
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    {
+    __m128i v = SwapWords(_mm_loadu_si128((const __m128i*)(p + i)));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i*)(p + i), v);
+    }
+  return i;
+}
+
+// 12 bytes -> 8 words. Each 64bits lane receives 6 input bytes (read as 8),
+// the four 12bits fields are then moved to their 16bits slot:
+// x & 0xfff, (x>>12) << 16, (x>>24) << 32, (x>>36) << 48
+size_t Unpack12Bits(uint16_t *out, const unsigned char *in, size_t n)
+{
+  const __m128i m0 = _mm_set_epi32(0, 0x00000fff, 0, 0x00000fff);
+  const __m128i m1 = _mm_set_epi32(0, 0x0fff0000, 0, 0x0fff0000);
+  const __m128i m2 = _mm_set_epi32(0x00000fff, 0, 0x00000fff, 0);
+  const __m128i m3 = _mm_set_epi32(0x0fff0000, 0, 0x0fff0000, 0);
+  size_t i = 0;
+  // the second lane reads 2 bytes past the 12 used ones:
+  for( ; i + 16 <= n; i += 12 )
+    {
+    const __m128i x = _mm_unpacklo_epi64(
+      _mm_loadl_epi64((const __m128i*)(in + i)),
+      _mm_loadl_epi64((const __m128i*)(in + i + 6)));
+    __m128i v = _mm_and_si128(x, m0);
+    v = _mm_or_si128(v, _mm_and_si128(_mm_slli_epi64(x, 4), m1));
+    v = _mm_or_si128(v, _mm_and_si128(_mm_slli_epi64(x, 8), m2));
+    v = _mm_or_si128(v, _mm_and_si128(_mm_slli_epi64(x, 12), m3));
+    _mm_storeu_si128((__m128i*)(out + i / 3 * 2), v);
+    }
+  return i;
+}
+
+// 8 words -> 12 bytes. Each 32bits lane (w0,w1) is first turned into its 3
+// output bytes, then the 24bits values are compacted with 64bits shifts.
+size_t Pack12Bits(unsigned char *out, const uint16_t *in, size_t n)
+{
+  const __m128i ff = _mm_set1_epi32(0xff);
+  const __m128i lo48 = _mm_set_epi32(0, 0, 0x0000ffff, (int)0xffffffff);
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    const __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+    // b0 & 0xff
+    const __m128i q0 = _mm_and_si128(x, ff);
+    // (b0 >> 8) + ((b1 & 0xf) << 4), truncated to 8 bits
+    const __m128i q1 = _mm_and_si128(_mm_add_epi32(
+        _mm_and_si128(_mm_srli_epi32(x, 8), ff),
+        _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(x, 16), _mm_set1_epi32(0xf)), 4)),
+      ff);
+    // b1 >> 4
+    const __m128i q2 = _mm_and_si128(_mm_srli_epi32(x, 20), ff);
+    __m128i v = _mm_or_si128(q0, _mm_or_si128(_mm_slli_epi32(q1, 8),
+        _mm_slli_epi32(q2, 16)));
+    // [v0 v1] -> v0 | v1 << 24 in each 64bits lane
+    v = _mm_or_si128(_mm_and_si128(v, _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff)),
+      _mm_srli_epi64(_mm_and_si128(v, _mm_set_epi32(0x00ffffff, 0, 0x00ffffff, 0)), 8));
+    // [a0..a5 0 0 b0..b5 0 0] -> [a0..a5 b0..b5]
+    v = _mm_or_si128(_mm_and_si128(v, lo48),
+      _mm_srli_si128(_mm_andnot_si128(lo48, v), 2));
+    unsigned char *q = out + i / 2 * 3;
+    _mm_storel_epi64((__m128i*)q, v);
+    const int last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(q + 8, &last, 4);
+    }
+  return i;
+}
+
+// Rescale: 8 values per iteration, as 4 x 2 doubles. The arithmetic is done
+// in double precision exactly as in the scalar code (mul then add, sub then
+// div), the conversion truncates like a C cast.
+struct Quad
+{
+  __m128d d[4];
+};
+
+inline void Load(Quad &q, const int16_t *in)
+{
+  const __m128i v = _mm_loadu_si128((const __m128i*)in);
+  const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+  const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+  q.d[0] = _mm_cvtepi32_pd(lo);
+  q.d[1] = _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3,2,3,2)));
+  q.d[2] = _mm_cvtepi32_pd(hi);
+  q.d[3] = _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(3,2,3,2)));
+}
+
+inline void Load(Quad &q, const uint16_t *in)
+{
+  const __m128i v = _mm_loadu_si128((const __m128i*)in);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = _mm_unpacklo_epi16(v, zero);
+  const __m128i hi = _mm_unpackhi_epi16(v, zero);
+  q.d[0] = _mm_cvtepi32_pd(lo);
+  q.d[1] = _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3,2,3,2)));
+  q.d[2] = _mm_cvtepi32_pd(hi);
+  q.d[3] = _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(3,2,3,2)));
+}
+
+inline void Load(Quad &q, const float *in)
+{
+  const __m128 a = _mm_loadu_ps(in);
+  const __m128 b = _mm_loadu_ps(in + 4);
+  q.d[0] = _mm_cvtps_pd(a);
+  q.d[1] = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+  q.d[2] = _mm_cvtps_pd(b);
+  q.d[3] = _mm_cvtps_pd(_mm_movehl_ps(b, b));
+}
+
+inline void Load(Quad &q, const double *in)
+{
+  for(int k = 0; k < 4; ++k) q.d[k] = _mm_loadu_pd(in + 2 * k);
+}
+
+inline __m128i TruncateToInt32(__m128d a, __m128d b)
+{
+  return _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+}
+
+// keep the low 16 bits of each int32 (like a C cast), then pack
+inline __m128i TruncateToInt16(__m128i a, __m128i b)
+{
+  a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+  b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+  return _mm_packs_epi32(a, b);
+}
+
+inline void Store(int16_t *out, const Quad &q)
+{
+  _mm_storeu_si128((__m128i*)out, TruncateToInt16(
+      TruncateToInt32(q.d[0], q.d[1]), TruncateToInt32(q.d[2], q.d[3])));
+}
+
+inline void Store(uint16_t *out, const Quad &q)
+{
+  Store((int16_t*)out, q);
+}
+
+inline void Store(int32_t *out, const Quad &q)
+{
+  _mm_storeu_si128((__m128i*)out, TruncateToInt32(q.d[0], q.d[1]));
+  _mm_storeu_si128((__m128i*)(out + 4), TruncateToInt32(q.d[2], q.d[3]));
+}
+
+inline void Store(float *out, const Quad &q)
+{
+  _mm_storeu_ps(out, _mm_movelh_ps(_mm_cvtpd_ps(q.d[0]), _mm_cvtpd_ps(q.d[1])));
+  _mm_storeu_ps(out + 4, _mm_movelh_ps(_mm_cvtpd_ps(q.d[2]), _mm_cvtpd_ps(q.d[3])));
+}
+
+inline void Store(double *out, const Quad &q)
+{
+  for(int k = 0; k < 4; ++k) _mm_storeu_pd(out + 2 * k, q.d[k]);
+}
+
+template <typename TOut, typename TIn>
+size_t RescaleLoop(TOut *out, const TIn *in, double intercept, double slope,
+  size_t n)
+{
+  const __m128d vi = _mm_set1_pd(intercept);
+  const __m128d vs = _mm_set1_pd(slope);
+  size_t i = 0;
+  Quad q;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(q, in + i);
+    for(int k = 0; k < 4; ++k)
+      q.d[k] = _mm_add_pd(_mm_mul_pd(vs, q.d[k]), vi);
+    Store(out + i, q);
+    }
+  return i;
+}
+
+template <typename TOut, typename TIn>
+size_t InverseRescaleLoop(TOut *out, const TIn *in, double intercept,
+  double slope, bool round, size_t n)
+{
+  const __m128d vi = _mm_set1_pd(intercept);
+  const __m128d vs = _mm_set1_pd(slope);
+  const __m128d half = _mm_set1_pd(0.5);
+  size_t i = 0;
+  Quad q;
+  for( ; i + 8 <= n; i += 8 )
+    {
+    Load(q, in + i);
+    for(int k = 0; k < 4; ++k)
+      {
+      q.d[k] = _mm_div_pd(_mm_sub_pd(q.d[k], vi), vs);
+      if( round ) q.d[k] = _mm_add_pd(q.d[k], half);
+      }
+    Store(out + i, q);
+    }
+  return i;
+}
+
+template <typename TIn>
+size_t RescaleInto(void *out, int outtype, const TIn *in, double intercept,
+  double slope, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return RescaleLoop((int16_t*)out, in, intercept, slope, n);
+  case UINT16:
+    return RescaleLoop((uint16_t*)out, in, intercept, slope, n);
+  case INT32:
+    return RescaleLoop((int32_t*)out, in, intercept, slope, n);
+  case FLOAT32:
+    return RescaleLoop((float*)out, in, intercept, slope, n);
+  case FLOAT64:
+    return RescaleLoop((double*)out, in, intercept, slope, n);
+    }
+  return 0;
+}
+
+size_t Rescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  if( intype == INT16 )
+    return RescaleInto(out, outtype, (const int16_t*)in, intercept, slope, n);
+  if( intype == UINT16 )
+    return RescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, n);
+  return 0;
+}
+
+template <typename TIn>
+size_t InverseRescaleInto(void *out, int outtype, const TIn *in,
+  double intercept, double slope, bool round, size_t n)
+{
+  switch(outtype)
+    {
+  case INT16:
+    return InverseRescaleLoop((int16_t*)out, in, intercept, slope, round, n);
+  case UINT16:
+    return InverseRescaleLoop((uint16_t*)out, in, intercept, slope, round, n);
+  case INT32:
+    return InverseRescaleLoop((int32_t*)out, in, intercept, slope, round, n);
+    }
+  return 0;
+}
+
+size_t InverseRescale(void *out, int outtype, const void *in, int intype,
+  double intercept, double slope, size_t n)
+{
+  switch(intype)
+    {
+  case INT16:
+    return InverseRescaleInto(out, outtype, (const int16_t*)in, intercept, slope, false, n);
+  case UINT16:
+    return InverseRescaleInto(out, outtype, (const uint16_t*)in, intercept, slope, false, n);
+  case FLOAT32:
+    return InverseRescaleInto(out, outtype, (const float*)in, intercept, slope, true, n);
+  case FLOAT64:
+    return InverseRescaleInto(out, outtype, (const double*)in, intercept, slope, true, n);
+    }
+  return 0;
+}
+
+const Table SSE2Table = {
+  SwapBytes16,
+  SwapBytes32,
+  SwapWords32,
+  Unpack12Bits,
+  Pack12Bits,
+  Rescale,
+  InverseRescale
+};
+} // end anonymous namespace
+
+const Table *GetSSE2Table()
+{
+  return &SSE2Table;
+}
+
+} // end namespace PixelKernelsDetail
+} // end namespace gdcm
@@ -0,0 +1,57 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMPIXELKERNELSTABLE_H
+#define GDCMPIXELKERNELSTABLE_H
+
+// Private header, shared in between gdcmPixelKernels.cxx and the instruction
+// set specific translation units. It must not include any other gdcm header:
+// the SSE2/AVX2 translation units are compiled with special flags, and any
+// inline function they would instantiate could end up being used by the rest
+// of the library (on a CPU without support for those instructions).
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gdcm
+{
+namespace PixelKernelsDetail
+{
+
+// Same values as PixelKernels::ScalarType
+enum { INT16 = 0, UINT16, INT32, FLOAT32, FLOAT64 };
+
+// Each kernel processes the largest prefix it can handle with full vectors
+// and returns its length (in elements, in input bytes for Unpack12Bits).
+// The remainder is processed by the scalar code.
+struct Table
+{
+  size_t (*SwapBytes16)(uint16_t *p, size_t n);
+  size_t (*SwapBytes32)(uint32_t *p, size_t n);
+  size_t (*SwapWords32)(uint32_t *p, size_t n);
+  size_t (*Unpack12Bits)(uint16_t *out, const unsigned char *in, size_t n);
+  size_t (*Pack12Bits)(unsigned char *out, const uint16_t *in, size_t n);
+  // Types have already been validated by the caller
+  size_t (*Rescale)(void *out, int outtype, const void *in, int intype,
+    double intercept, double slope, size_t n);
+  size_t (*InverseRescale)(void *out, int outtype, const void *in, int intype,
+    double intercept, double slope, size_t n);
+};
+
+const Table *GetSSE2Table();
+const Table *GetAVX2Table();
+const Table *GetNEONTable();
+
+} // end namespace PixelKernelsDetail
+} // end namespace gdcm
+
+#endif //GDCMPIXELKERNELSTABLE_H
@@ -12,32 +12,39 @@
 
 =========================================================================*/
 #include "gdcmSHA1.h"
-#include "gdcmSystem.h"
+#include "gdcmHashKernels.h"
 
-#ifdef GDCM_USE_SYSTEM_OPENSSL
-#include <openssl/sha.h>
-#endif
+#include <vector>
+#include <string.h> // memcpy
+#include <stdio.h> // fopen
 
-#include <string.h> // memcmp
-#include <stdlib.h> // malloc
-#include <stdio.h> // sprintf
-
-/*
- */
 namespace gdcm
 {
 
 class SHA1Internals
 {
 public:
-#ifdef GDCM_USE_SYSTEM_OPENSSL
-  SHA_CTX ctx;
-#endif
+  uint32_t State[5];
+  unsigned char Block[64];
+  size_t BlockLength;
+  uint64_t Length; // in bytes
+
+  void Init()
+    {
+    State[0] = 0x67452301;
+    State[1] = 0xefcdab89;
+    State[2] = 0x98badcfe;
+    State[3] = 0x10325476;
+    State[4] = 0xc3d2e1f0;
+    BlockLength = 0;
+    Length = 0;
+    }
 };
 
 SHA1::SHA1()
 {
   Internals = new SHA1Internals;
+  Internals->Init();
 }
 
 SHA1::~SHA1()
@@ -45,102 +52,94 @@ SHA1::~SHA1()
   delete Internals;
 }
 
-bool SHA1::Compute(const char *buffer, unsigned long buf_len, char digest[])
+void SHA1::Update(const char *buffer, size_t len)
 {
-#ifdef GDCM_USE_SYSTEM_OPENSSL
-  if( !buffer || !buf_len )
+  SHA1Internals &in = *Internals;
+  const unsigned char *p = (const unsigned char*)buffer;
+  in.Length += len;
+  if( in.BlockLength )
     {
-    return false;
+    const size_t n = len < 64 - in.BlockLength ? len : 64 - in.BlockLength;
+    memcpy(in.Block + in.BlockLength, p, n);
+    in.BlockLength += n;
+    p += n;
+    len -= n;
+    if( in.BlockLength < 64 ) return;
+    HashKernels::SHA1Blocks(in.State, in.Block, 1);
+    in.BlockLength = 0;
     }
+  // whole blocks straight from the input
+  HashKernels::SHA1Blocks(in.State, p, len / 64);
+  p += len / 64 * 64;
+  len %= 64;
+  memcpy(in.Block, p, len);
+  in.BlockLength = len;
+}
 
-  unsigned char output[20];
-
-  SHA_CTX ctx;
-  SHA1_Init(&ctx);
-  SHA1_Update(&ctx, buffer, buf_len);
-  SHA1_Final(output, &ctx);
+void SHA1::Final(unsigned char digest[20])
+{
+  SHA1Internals &in = *Internals;
+  const uint64_t bits = in.Length * 8;
+  // 0x80, zeros up to 56 mod 64, 64 bits big endian length
+  unsigned char pad[72] = { 0x80 };
+  const size_t padlen = (in.BlockLength < 56 ? 56 : 120) - in.BlockLength;
+  for(int i = 0; i < 8; ++i)
+    pad[padlen + i] = (unsigned char)(bits >> (56 - 8 * i));
+  Update((const char*)pad, padlen + 8);
+  for(int i = 0; i < 20; ++i)
+    digest[i] = (unsigned char)(in.State[i / 4] >> (24 - 8 * (i % 4)));
+  in.Init();
+}
 
-  for (int di = 0; di < 20; ++di)
+static void ToString(const unsigned char *digest, int len, char *digest_str)
+{
+  static const char hex[] = "0123456789abcdef";
+  for (int di = 0; di < len; ++di)
     {
-    sprintf(digest+2*di, "%02x", output[di]);
+    digest_str[2*di] = hex[digest[di] >> 4];
+    digest_str[2*di+1] = hex[digest[di] & 0xf];
     }
-  digest[2*20] = '\0';
-
-  return true;
-#else
-  (void)buffer;
-  (void)buf_len;
-  (void)digest;
-  return false;
-#endif
+  digest_str[2*len] = '\0';
 }
 
-#ifdef GDCM_USE_SYSTEM_OPENSSL
-static bool process_file(const char *filename, unsigned char *digest)
+bool SHA1::Compute(const char *buffer, unsigned long buf_len, char digest_str[])
 {
-  if( !filename || !digest ) return false;
-
-  FILE *file = fopen(filename, "rb");
-  if(!file)
+  if( !buffer || !buf_len )
     {
     return false;
     }
 
-  size_t file_size = System::FileSize(filename);
-  void *buffer = malloc(file_size);
-  if(!buffer)
-    {
-    fclose(file);
-    return false;
-    }
-  size_t read = fread(buffer, 1, file_size, file);
-  if( read != file_size ) return false;
-
-  SHA_CTX ctx;
-  int ret = SHA1_Init(&ctx);
-  if( !ret ) return false;
-  ret = SHA1_Update(&ctx, buffer, file_size);
-  if( !ret ) return false;
-  ret = SHA1_Final(digest, &ctx);
-  if( !ret ) return false;
-
-  /*printf("MD5 (\"%s\") = ", test[i]); */
-  /*for (int di = 0; di < 16; ++di)
-  {
-    printf("%02x", digest[di]);
-  }*/
-  //printf("\t%s\n", filename);
-  free(buffer);
-  fclose(file);
+  SHA1 sha;
+  sha.Update(buffer, buf_len);
+  unsigned char digest[20];
+  sha.Final(digest);
+  ToString(digest, 20, digest_str);
   return true;
 }
-#endif
 
 bool SHA1::ComputeFile(const char *filename, char digest_str[20*2+1])
 {
-#ifdef GDCM_USE_SYSTEM_OPENSSL
-  // If not file exist
-  // return false;
-  unsigned char digest[20];
-
-  /* Do the file */
-  if( !process_file(filename, digest) )
+  if( !filename ) return false;
+  FILE *file = fopen(filename, "rb");
+  if( !file )
     {
     return false;
     }
-
-  for (int di = 0; di < 20; ++di)
+  SHA1 sha;
+  std::vector<char> buffer( 1024 * 1024 );
+  size_t read;
+  while( (read = fread(&buffer[0], 1, buffer.size(), file)) > 0 )
     {
-    sprintf(digest_str+2*di, "%02x", digest[di]);
+    sha.Update(&buffer[0], read);
     }
-  digest_str[2*20] = '\0';
+  const bool error = ferror(file) != 0;
+  fclose(file);
+  if( error ) return false;
+
+  unsigned char digest[20];
+  sha.Final(digest);
+  ToString(digest, 20, digest_str);
   return true;
-#else
-  (void)filename;
-  (void)digest_str;
-  return false;
-#endif
 }
 
-
 } // end namespace gdcm
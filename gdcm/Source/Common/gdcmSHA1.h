@@ -23,11 +23,13 @@ class SHA1Internals;
 /**
  * \brief Class for SHA1
  *
- * \warning this class is able to pick from one implementation:
+ * \details Built-in implementation (FIPS 180-4), the compression function
+ * runs on the SHA extensions of the CPU when there are some, see HashKernels.
  *
- * 1. the one from OpenSSL (when GDCM_USE_SYSTEM_OPENSSL is turned ON)
+ * Either use the static functions on a whole buffer or file, or stream the
+ * message: Update as many times as needed, then Final.
  *
- * In all other cases it will return an error
+ * \see SHA256
  */
 class GDCM_EXPORT SHA1
 {
@@ -35,8 +37,14 @@ public :
   SHA1();
   ~SHA1();
 
+  /// Append len bytes to the message
+  void Update(const char *buffer, size_t len);
+  /// Return the digest of the message, the object is then ready for a new one
+  void Final(unsigned char digest[20]);
+
   static bool Compute(const char *buffer, unsigned long buf_len, char digest_str[20*2+1]);
 
+  /// The file is read by chunks, it can be larger than the memory
   static bool ComputeFile(const char *filename, char digest_str[20*2+1]);
 
 private:
@@ -0,0 +1,183 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmSHA256.h"
+#include "gdcmHashKernels.h"
+
+#include <vector>
+#include <string.h> // memcpy
+#include <stdio.h> // fopen
+
+namespace gdcm
+{
+
+class SHA256Internals
+{
+public:
+  uint32_t State[8];
+  unsigned char Block[64];
+  size_t BlockLength;
+  uint64_t Length; // in bytes
+
+  void Init()
+    {
+    State[0] = 0x6a09e667;
+    State[1] = 0xbb67ae85;
+    State[2] = 0x3c6ef372;
+    State[3] = 0xa54ff53a;
+    State[4] = 0x510e527f;
+    State[5] = 0x9b05688c;
+    State[6] = 0x1f83d9ab;
+    State[7] = 0x5be0cd19;
+    BlockLength = 0;
+    Length = 0;
+    }
+};
+
+SHA256::SHA256()
+{
+  Internals = new SHA256Internals;
+  Internals->Init();
+}
+
+SHA256::~SHA256()
+{
+  delete Internals;
+}
+
+void SHA256::Update(const char *buffer, size_t len)
+{
+  SHA256Internals &in = *Internals;
+  const unsigned char *p = (const unsigned char*)buffer;
+  in.Length += len;
+  if( in.BlockLength )
+    {
+    const size_t n = len < 64 - in.BlockLength ? len : 64 - in.BlockLength;
+    memcpy(in.Block + in.BlockLength, p, n);
+    in.BlockLength += n;
+    p += n;
+    len -= n;
+    if( in.BlockLength < 64 ) return;
+    HashKernels::SHA256Blocks(in.State, in.Block, 1);
+    in.BlockLength = 0;
+    }
+  // whole blocks straight from the input
+  HashKernels::SHA256Blocks(in.State, p, len / 64);
+  p += len / 64 * 64;
+  len %= 64;
+  memcpy(in.Block, p, len);
+  in.BlockLength = len;
+}
+
+void SHA256::Final(unsigned char digest[32])
+{
+  SHA256Internals &in = *Internals;
+  const uint64_t bits = in.Length * 8;
+  // 0x80, zeros up to 56 mod 64, 64 bits big endian length
+  unsigned char pad[72] = { 0x80 };
+  const size_t padlen = (in.BlockLength < 56 ? 56 : 120) - in.BlockLength;
+  for(int i = 0; i < 8; ++i)
+    pad[padlen + i] = (unsigned char)(bits >> (56 - 8 * i));
+  Update((const char*)pad, padlen + 8);
+  for(int i = 0; i < 32; ++i)
+    digest[i] = (unsigned char)(in.State[i / 4] >> (24 - 8 * (i % 4)));
+  in.Init();
+}
+
+static void ToString(const unsigned char *digest, int len, char *digest_str)
+{
+  static const char hex[] = "0123456789abcdef";
+  for (int di = 0; di < len; ++di)
+    {
+    digest_str[2*di] = hex[digest[di] >> 4];
+    digest_str[2*di+1] = hex[digest[di] & 0xf];
+    }
+  digest_str[2*len] = '\0';
+}
+
+bool SHA256::Compute(const char *buffer, unsigned long buf_len, char digest_str[])
+{
+  if( !buffer && buf_len )
+    {
+    return false;
+    }
+
+  SHA256 sha;
+  sha.Update(buffer, buf_len);
+  unsigned char digest[32];
+  sha.Final(digest);
+  ToString(digest, 32, digest_str);
+  return true;
+}
+
+bool SHA256::ComputeFile(const char *filename, char digest_str[32*2+1])
+{
+  if( !filename ) return false;
+  FILE *file = fopen(filename, "rb");
+  if( !file )
+    {
+    return false;
+    }
+  SHA256 sha;
+  std::vector<char> buffer( 1024 * 1024 );
+  size_t read;
+  while( (read = fread(&buffer[0], 1, buffer.size(), file)) > 0 )
+    {
+    sha.Update(&buffer[0], read);
+    }
+  const bool error = ferror(file) != 0;
+  fclose(file);
+  if( error ) return false;
+
+  unsigned char digest[32];
+  sha.Final(digest);
+  ToString(digest, 32, digest_str);
+  return true;
+}
+
+// RFC 2104: H(K ^ opad, H(K ^ ipad, text)), K padded (or hashed) to 64 bytes
+bool SHA256::ComputeHMAC(const char *key, size_t key_len,
+  const char *buffer, unsigned long buf_len, char digest_str[32*2+1])
+{
+  if( (!key && key_len) || (!buffer && buf_len) )
+    {
+    return false;
+    }
+
+  SHA256 sha;
+  unsigned char k[64] = {};
+  if( key_len > 64 )
+    {
+    sha.Update(key, key_len);
+    sha.Final(k);
+    }
+  else if( key_len )
+    {
+    memcpy(k, key, key_len);
+    }
+  char pad[64];
+  for(int i = 0; i < 64; ++i) pad[i] = (char)(k[i] ^ 0x36);
+  sha.Update(pad, 64);
+  sha.Update(buffer, buf_len);
+  unsigned char inner[32];
+  sha.Final(inner);
+  for(int i = 0; i < 64; ++i) pad[i] = (char)(k[i] ^ 0x5c);
+  sha.Update(pad, 64);
+  sha.Update((const char*)inner, 32);
+  unsigned char digest[32];
+  sha.Final(digest);
+  ToString(digest, 32, digest_str);
+  return true;
+}
+
+} // end namespace gdcm
@@ -0,0 +1,63 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMSHA256_H
+#define GDCMSHA256_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+//-----------------------------------------------------------------------------
+class SHA256Internals;
+/**
+ * \brief Class for SHA-256 and HMAC-SHA-256
+ *
+ * \details Built-in implementation (FIPS 180-4), the compression function
+ * runs on the SHA extensions of the CPU when there are some, see HashKernels.
+ * Same interface as SHA1, plus HMAC (RFC 2104) for keyed digests, e.g.
+ * pseudonyms which cannot be recomputed from a dictionary of names without
+ * the key.
+ *
+ * \see SHA1
+ */
+class GDCM_EXPORT SHA256
+{
+public :
+  SHA256();
+  ~SHA256();
+
+  /// Append len bytes to the message
+  void Update(const char *buffer, size_t len);
+  /// Return the digest of the message, the object is then ready for a new one
+  void Final(unsigned char digest[32]);
+
+  /// An empty message is valid (buffer can be NULL when buf_len is 0)
+  static bool Compute(const char *buffer, unsigned long buf_len, char digest_str[32*2+1]);
+
+  /// The file is read by chunks, it can be larger than the memory
+  static bool ComputeFile(const char *filename, char digest_str[32*2+1]);
+
+  /// HMAC-SHA-256 of buffer with key
+  static bool ComputeHMAC(const char *key, size_t key_len,
+    const char *buffer, unsigned long buf_len, char digest_str[32*2+1]);
+
+private:
+  SHA256Internals *Internals;
+private:
+  SHA256(const SHA256&);  // Not implemented.
+  void operator=(const SHA256&);  // Not implemented.
+};
+} // end namespace gdcm
+//-----------------------------------------------------------------------------
+#endif //GDCMSHA256_H
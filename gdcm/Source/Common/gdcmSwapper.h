@@ -24,6 +24,8 @@ namespace gdcm
 class SwapperDoOp
 {
 public:
+  /// SwapArray leaves the values as they are on this host
+  static bool IsNoOp() { return true; }
   template <typename T> static T Swap(T val) {return val;}
   template <typename T> static void SwapArray(T *, unsigned int ) {}
 };
@@ -31,6 +33,7 @@ public:
 class SwapperNoOp
 {
 public:
+  static bool IsNoOp() { return false; }
   template <typename T> static T Swap(T val);
   template <typename T>
   static void SwapArray(T *array, unsigned int n)
@@ -46,6 +49,8 @@ public:
 class SwapperNoOp
 {
 public:
+  /// SwapArray leaves the values as they are on this host
+  static bool IsNoOp() { return true; }
   template <typename T> static T Swap(T val) {return val;}
   template <typename T> static void SwapArray(T *, size_t ) {}
 };
@@ -53,6 +58,7 @@ public:
 class SwapperDoOp
 {
 public:
+  static bool IsNoOp() { return false; }
   template <typename T> static T Swap(T val);
   template <typename T>
   static void SwapArray(T *array, size_t n)
@@ -556,42 +556,57 @@ const char *System::GetCurrentResourcesDirectory()
  * \brief Encode the mac address on a fixed length string of 15 characters.
  * we save space this way.
  */
-inline int getlastdigit(unsigned char *data, unsigned long size)
+size_t System::EncodeBytes(char *out, const unsigned char *data, int size)
 {
-  int extended, carry = 0;
-  for(unsigned int i=0;i<size;i++)
+  assert( size >= 0 && size <= 32 );
+  // The big endian number is split in 32 bits limbs and divided by 10^9:
+  // nine digits per pass instead of one per division of every byte. The
+  // digits come out lowest first, they are stored from the end. 256**32 has
+  // 78 digits
+  uint32_t limbs[8];
+  const int nlimbs = (size + 3) / 4;
+  const int pad = 4 * nlimbs - size;
+  memset(limbs, 0, sizeof(limbs));
+  for(int i = 0; i < size; ++i)
     {
-    extended = (carry << 8) + data[i];
-    data[i] = (unsigned char)(extended / 10);
-    carry = extended % 10;
+    const int j = i + pad;
+    limbs[j / 4] = (limbs[j / 4] << 8) | data[i];
     }
-  assert( carry >= 0 && carry < 10 );
-  return carry;
-}
-
-size_t System::EncodeBytes(char *out, const unsigned char *data, int size)
-{
-  bool zero = false;
-  int res;
-  std::string sres;
-  unsigned char buffer[32];
-  unsigned char *addr = buffer;
-  memcpy(addr, data, size);
-  while(!zero)
+  char digits[80];
+  char *first = digits + sizeof(digits);
+  int start = 0;
+  for(;;)
     {
-    res = getlastdigit(addr, size);
-    const char v = (char)('0' + res);
-    sres.insert(sres.begin(), v);
-    zero = true;
-    for(int i = 0; i < size; ++i)
+    uint64_t rem = 0;
+    for(int i = start; i < nlimbs; ++i)
+      {
+      const uint64_t cur = (rem << 32) | limbs[i];
+      limbs[i] = (uint32_t)(cur / 1000000000);
+      rem = cur % 1000000000;
+      }
+    while( start < nlimbs && limbs[start] == 0 ) ++start;
+    uint32_t r = (uint32_t)rem;
+    if( start == nlimbs )
+      {
+      // highest digits, no leading zero
+      do
+        {
+        *--first = (char)('0' + r % 10);
+        r /= 10;
+        } while( r );
+      break;
+      }
+    for(int k = 0; k < 9; ++k)
       {
-      zero = zero && (addr[i] == 0);
+      *--first = (char)('0' + r % 10);
+      r /= 10;
       }
     }
 
-  //return sres;
-  strcpy(out, sres.c_str()); //, sres.size() );
-  return sres.size();
+  const size_t len = digits + sizeof(digits) - first;
+  memcpy(out, first, len);
+  out[len] = 0;
+  return len;
 }
 
 #if defined(_WIN32) && !defined(GDCM_HAVE_GETTIMEOFDAY)
@@ -941,6 +956,21 @@ bool System::GetHostName(char name[255])
   return false;
 }
 
+unsigned int System::GetNumberOfProcessors()
+{
+#if defined(_WIN32)
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo( &sysinfo );
+  const unsigned int n = (unsigned int)sysinfo.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  const long l = sysconf( _SC_NPROCESSORS_ONLN );
+  const unsigned int n = l > 0 ? (unsigned int)l : 1;
+#else
+  const unsigned int n = 1;
+#endif
+  return n ? n : 1;
+}
+
 char *System::StrTokR(char *str, const char *delim, char **nextp)
 {
 #if 1
@@ -72,6 +72,10 @@ public:
   /// This may come handy to specify the Station Name
   static bool GetHostName(char hostname[255]);
 
+  /// Return the number of online processors (at least 1). This is the default
+  /// number of threads used by the multi-threaded helpers.
+  static unsigned int GetNumberOfProcessors();
+
   // In the following the size '22' is explicitly listed. You need to pass in
   // at least 22bytes of array. If the string is an output it will be
   // automatically padded ( array[21] == 0 ) for you.
@@ -0,0 +1,179 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmThreadPool.h"
+#include "gdcmSystem.h"
+#include "gdcmTrace.h"
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#if defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+  #include <pthread.h>
+  #define GDCM_THREADPOOL_THREADS
+#endif
+
+namespace gdcm
+{
+
+#ifdef GDCM_THREADPOOL_THREADS
+class ThreadPoolInternals
+{
+public:
+  // One ParallelFor call. Lives on the stack of the calling thread.
+  struct Batch
+  {
+    ThreadPool::Task *TheTask;
+    size_t Size;
+    size_t Next; // next index to hand out
+    size_t Done; // number of indices executed
+  };
+
+  ThreadPoolInternals():Stop(false)
+    {
+    pthread_mutex_init(&Lock, NULL);
+    pthread_cond_init(&WorkCond, NULL);
+    pthread_cond_init(&DoneCond, NULL);
+    }
+  ~ThreadPoolInternals()
+    {
+    pthread_mutex_destroy(&Lock);
+    pthread_cond_destroy(&WorkCond);
+    pthread_cond_destroy(&DoneCond);
+    }
+
+  // Take the next index of batch b, Lock must be held
+  size_t Take(Batch *b)
+    {
+    const size_t i = b->Next++;
+    if( b->Next == b->Size )
+      {
+      // only batches with indices left are kept in the queue
+      Batches.erase( std::find(Batches.begin(), Batches.end(), b) );
+      }
+    return i;
+    }
+
+  // Lock must be held, released during the execution
+  void Execute(Batch *b, size_t i)
+    {
+    pthread_mutex_unlock(&Lock);
+    b->TheTask->Execute(i);
+    pthread_mutex_lock(&Lock);
+    if( ++b->Done == b->Size )
+      pthread_cond_broadcast(&DoneCond);
+    }
+
+  void Run()
+    {
+    pthread_mutex_lock(&Lock);
+    for(;;)
+      {
+      while( !Stop && Batches.empty() )
+        pthread_cond_wait(&WorkCond, &Lock);
+      if( Batches.empty() ) break; // Stop
+      Batch *b = Batches.front();
+      Execute(b, Take(b));
+      }
+    pthread_mutex_unlock(&Lock);
+    }
+
+  std::deque<Batch*> Batches;
+  std::vector<pthread_t> Threads;
+  bool Stop;
+  pthread_mutex_t Lock;
+  pthread_cond_t WorkCond;
+  pthread_cond_t DoneCond;
+};
+
+static void *ThreadPoolWorker(void *arg)
+{
+  static_cast<ThreadPoolInternals*>(arg)->Run();
+  return NULL;
+}
+#else
+class ThreadPoolInternals
+{
+};
+#endif
+
+ThreadPool::ThreadPool(unsigned int n)
+{
+  Internals = new ThreadPoolInternals;
+#ifdef GDCM_THREADPOOL_THREADS
+  if( n == 0 ) n = System::GetNumberOfProcessors();
+  for( unsigned int i = 1; i < n; ++i )
+    {
+    pthread_t t;
+    if( pthread_create(&t, NULL, ThreadPoolWorker, Internals) != 0 )
+      {
+      gdcmWarningMacro( "Could not create thread, using " << i << " thread(s)" );
+      break;
+      }
+    Internals->Threads.push_back( t );
+    }
+#else
+  (void)n;
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+#ifdef GDCM_THREADPOOL_THREADS
+  pthread_mutex_lock(&Internals->Lock);
+  Internals->Stop = true;
+  pthread_cond_broadcast(&Internals->WorkCond);
+  pthread_mutex_unlock(&Internals->Lock);
+  for( size_t i = 0; i < Internals->Threads.size(); ++i )
+    pthread_join(Internals->Threads[i], NULL);
+#endif
+  delete Internals;
+}
+
+unsigned int ThreadPool::GetNumberOfThreads() const
+{
+#ifdef GDCM_THREADPOOL_THREADS
+  return (unsigned int)Internals->Threads.size() + 1;
+#else
+  return 1;
+#endif
+}
+
+void ThreadPool::ParallelFor(Task &task, size_t n)
+{
+#ifdef GDCM_THREADPOOL_THREADS
+  if( n > 1 && !Internals->Threads.empty() )
+    {
+    ThreadPoolInternals::Batch b;
+    b.TheTask = &task;
+    b.Size = n;
+    b.Next = 0;
+    b.Done = 0;
+    pthread_mutex_lock(&Internals->Lock);
+    Internals->Batches.push_back( &b );
+    pthread_cond_broadcast(&Internals->WorkCond);
+    // the calling thread only works on its own batch
+    while( b.Next < b.Size )
+      Internals->Execute(&b, Internals->Take(&b));
+    while( b.Done < b.Size )
+      pthread_cond_wait(&Internals->DoneCond, &Internals->Lock);
+    pthread_mutex_unlock(&Internals->Lock);
+    return;
+    }
+#endif
+  for( size_t i = 0; i < n; ++i )
+    task.Execute(i);
+}
+
+} // end namespace gdcm
@@ -0,0 +1,70 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMTHREADPOOL_H
+#define GDCMTHREADPOOL_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+class ThreadPoolInternals;
+
+/**
+ * \brief Minimal pool of worker threads
+ * \details The pool owns GetNumberOfThreads() - 1 worker threads, the thread
+ * calling ParallelFor always takes part in the work. ParallelFor can be
+ * called from within a Task (nested loops): the calling thread keeps on
+ * processing its own indices, so that nesting never deadlocks.
+ *
+ * When threads are not available (no pthread) everything runs in the
+ * calling thread.
+ *
+ * \see DirectoryWalker
+ */
+class GDCM_EXPORT ThreadPool
+{
+public:
+  /**
+   * \brief Task
+   * Execute is called once for each index of a ParallelFor, from any thread
+   * of the pool, concurrently.
+   */
+  class GDCM_EXPORT Task
+  {
+  public:
+    virtual ~Task() {}
+    virtual void Execute(size_t index) = 0;
+  };
+
+  /// Create a pool of n threads (calling thread included). 0 means the number
+  /// of online processors.
+  explicit ThreadPool(unsigned int n = 0);
+  ~ThreadPool();
+
+  /// Number of threads taking part in a ParallelFor (calling thread included)
+  unsigned int GetNumberOfThreads() const;
+
+  /// Call task.Execute(i) for i in [0,n) and return once all of them are done
+  void ParallelFor(Task &task, size_t n);
+
+private:
+  ThreadPool(const ThreadPool&);  // Not implemented.
+  void operator=(const ThreadPool&);  // Not implemented.
+
+  ThreadPoolInternals *Internals;
+};
+
+} // end namespace gdcm
+
+#endif //GDCMTHREADPOOL_H
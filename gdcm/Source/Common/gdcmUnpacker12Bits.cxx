@@ -12,6 +12,7 @@
 
 =========================================================================*/
 #include "gdcmUnpacker12Bits.h"
+#include "gdcmPixelKernels.h"
 
 namespace gdcm
 {
@@ -20,39 +21,15 @@ bool Unpacker12Bits::Unpack(char *out, const char *in, size_t n)
 {
   if( n % 3 ) return false; // 3bytes are actually 2 words
   // http://groups.google.com/group/comp.lang.c/msg/572bc9b085c717f3
-  short *q = (short*)out;
-  const unsigned char *p = (unsigned char*)in;
-  const unsigned char *end = p+n;
-  unsigned char b0,b1,b2;
-
-  while (p!=end)
-    {
-    b0 = *p++;
-    b1 = *p++;
-    b2 = *p++;
-    *q++ = (short)(((b1 & 0xf) << 8) + b0);
-    *q++ = (short)((b1>>4) + (b2<<4));
-    }
+  // see PixelKernels::Unpack12Bits for the scalar loop
+  PixelKernels::Unpack12Bits((uint16_t*)out, (const unsigned char*)in, n);
   return true;
 }
 
 bool Unpacker12Bits::Pack(char *out, const char *in, size_t n)
 {
   if( n % 4 ) return false; // we need an even number of 'words' so that 2 words are split in 3 bytes
-  unsigned char *q = (unsigned char*)out;
-  const unsigned short *p = (unsigned short*)in;
-  const unsigned short *end = (unsigned short*)(in+n);
-  unsigned short b0,b1;
-
-  while(p!=end)
-    {
-    b0 = *p++;
-    b1 = *p++;
-
-    *q++ = (unsigned char)(b0 & 0xff);
-    *q++ = (unsigned char)((b0 >> 8) + ((b1 & 0xf) << 4));
-    *q++ = (unsigned char)(b1 >> 4);
-    }
+  PixelKernels::Pack12Bits((unsigned char*)out, (const uint16_t*)in, n / 2);
   return true;
 }
 
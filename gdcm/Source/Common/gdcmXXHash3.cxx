@@ -0,0 +1,478 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmXXHash3.h"
+#ifdef GDCM_XXHASH3_AVX2
+#include "gdcmPixelKernels.h"
+#include "gdcmXXHash3Kernels.h"
+#endif
+
+#include <vector>
+#include <string.h> // memcpy
+#include <stdio.h> // fopen
+
+// SSE2 and NEON are part of the x86_64 and AArch64 baselines, no dispatch.
+// AVX2 (gdcmXXHash3AVX2.cxx) is used when PixelKernels found it on the CPU
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define GDCM_XXHASH3_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  #include <arm_neon.h>
+  #define GDCM_XXHASH3_NEON
+#endif
+
+namespace gdcm
+{
+
+namespace
+{
+// See xxhash_spec.md (XXH3, 64 bits variant), with seed 0
+const uint64_t Prime32_1 = 0x9e3779b1U;
+const uint64_t Prime32_2 = 0x85ebca77U;
+const uint64_t Prime32_3 = 0xc2b2ae3dU;
+const uint64_t Prime64_1 = 0x9e3779b185ebca87ULL;
+const uint64_t Prime64_2 = 0xc2b2ae3d27d4eb4fULL;
+const uint64_t Prime64_3 = 0x165667b19e3779f9ULL;
+const uint64_t Prime64_4 = 0x85ebca77c2b2ae63ULL;
+const uint64_t Prime64_5 = 0x27d4eb2f165667c5ULL;
+
+const size_t StripeLength = 64;
+const size_t SecretSize = 192;
+const size_t StripesPerBlock = (SecretSize - StripeLength) / 8;
+const size_t BufferSize = 256;
+
+const unsigned char Secret[SecretSize] = {
+  0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+  0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+  0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+  0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+  0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+  0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+  0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+  0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+  0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+  0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+  0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+  0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+  0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+  0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+  0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+  0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint64_t Read64(const unsigned char *p)
+{
+  uint64_t v = 0;
+  for(int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+inline uint32_t Read32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t Rotl(uint64_t x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
+
+inline uint64_t Swap64(uint64_t x)
+{
+  x = ((x & 0xff00ff00ff00ff00ULL) >> 8) | ((x & 0x00ff00ff00ff00ffULL) << 8);
+  x = ((x & 0xffff0000ffff0000ULL) >> 16) | ((x & 0x0000ffff0000ffffULL) << 16);
+  return (x >> 32) | (x << 32);
+}
+
+// low 64 bits xor high 64 bits of the 128 bits product
+inline uint64_t Mul128Fold64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 p = (unsigned __int128)a * b;
+  return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+  const uint64_t lolo = (a & 0xffffffff) * (b & 0xffffffff);
+  const uint64_t hilo = (a >> 32) * (b & 0xffffffff);
+  const uint64_t lohi = (a & 0xffffffff) * (b >> 32);
+  const uint64_t hihi = (a >> 32) * (b >> 32);
+  const uint64_t cross = (lolo >> 32) + (hilo & 0xffffffff) + lohi;
+  const uint64_t hi = (hilo >> 32) + (cross >> 32) + hihi;
+  const uint64_t lo = (cross << 32) | (lolo & 0xffffffff);
+  return hi ^ lo;
+#endif
+}
+
+inline uint64_t XXH64Avalanche(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= Prime64_2;
+  h ^= h >> 29;
+  h *= Prime64_3;
+  return h ^ (h >> 32);
+}
+
+inline uint64_t Avalanche(uint64_t h)
+{
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9ULL;
+  return h ^ (h >> 32);
+}
+
+inline uint64_t Mix16(const unsigned char *p, const unsigned char *s)
+{
+  return Mul128Fold64(Read64(p) ^ Read64(s), Read64(p + 8) ^ Read64(s + 8));
+}
+
+// Messages up to 240 bytes
+uint64_t HashShort(const unsigned char *p, size_t len)
+{
+  if( len > 128 )
+    {
+    uint64_t acc = len * Prime64_1;
+    const size_t rounds = len / 16;
+    for( size_t i = 0; i < 8; ++i )
+      acc += Mix16(p + 16 * i, Secret + 16 * i);
+    acc = Avalanche(acc);
+    for( size_t i = 8; i < rounds; ++i )
+      acc += Mix16(p + 16 * i, Secret + 16 * (i - 8) + 3);
+    acc += Mix16(p + len - 16, Secret + 136 - 17);
+    return Avalanche(acc);
+    }
+  if( len > 16 )
+    {
+    uint64_t acc = len * Prime64_1;
+    if( len > 32 )
+      {
+      if( len > 64 )
+        {
+        if( len > 96 )
+          {
+          acc += Mix16(p + 48, Secret + 96);
+          acc += Mix16(p + len - 64, Secret + 112);
+          }
+        acc += Mix16(p + 32, Secret + 64);
+        acc += Mix16(p + len - 48, Secret + 80);
+        }
+      acc += Mix16(p + 16, Secret + 32);
+      acc += Mix16(p + len - 32, Secret + 48);
+      }
+    acc += Mix16(p, Secret);
+    acc += Mix16(p + len - 16, Secret + 16);
+    return Avalanche(acc);
+    }
+  if( len > 8 )
+    {
+    const uint64_t lo = Read64(p) ^ (Read64(Secret + 24) ^ Read64(Secret + 32));
+    const uint64_t hi = Read64(p + len - 8) ^ (Read64(Secret + 40) ^ Read64(Secret + 48));
+    return Avalanche(len + Swap64(lo) + hi + Mul128Fold64(lo, hi));
+    }
+  if( len >= 4 )
+    {
+    const uint64_t in = Read32(p + len - 4) + ((uint64_t)Read32(p) << 32);
+    uint64_t h = in ^ (Read64(Secret + 8) ^ Read64(Secret + 16));
+    h ^= Rotl(h, 49) ^ Rotl(h, 24);
+    h *= 0x9fb21c651e98df25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9fb21c651e98df25ULL;
+    return h ^ (h >> 28);
+    }
+  if( len > 0 )
+    {
+    const uint32_t combined = ((uint32_t)p[0] << 16) | ((uint32_t)p[len >> 1] << 24)
+      | (uint32_t)p[len - 1] | ((uint32_t)len << 8);
+    return XXH64Avalanche(combined ^ (uint64_t)(Read32(Secret) ^ Read32(Secret + 4)));
+    }
+  return XXH64Avalanche(Read64(Secret + 56) ^ Read64(Secret + 64));
+}
+
+#ifdef GDCM_XXHASH3_AVX2
+const bool UseAVX2 = PixelKernels::IsInstructionSetSupported(PixelKernels::AVX2);
+#endif
+
+// n stripes of 64 bytes into the 8 accumulators, the secret moving by 8
+// bytes from one stripe to the next
+inline void Accumulate(uint64_t acc[8], const unsigned char *p, const unsigned char *s, size_t n)
+{
+#ifdef GDCM_XXHASH3_AVX2
+  if( UseAVX2 && n > 1 )
+    {
+    XXHash3Detail::AccumulateAVX2(acc, p, s, n);
+    return;
+    }
+#endif
+#if defined(GDCM_XXHASH3_SSE2)
+  __m128i a[4];
+  for( int i = 0; i < 4; ++i ) a[i] = _mm_loadu_si128((const __m128i*)acc + i);
+  for( ; n; --n, p += StripeLength, s += 8 )
+    {
+    for( int i = 0; i < 4; ++i )
+      {
+      const __m128i data = _mm_loadu_si128((const __m128i*)p + i);
+      const __m128i key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*)s + i));
+      const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+      const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+      }
+    }
+  for( int i = 0; i < 4; ++i ) _mm_storeu_si128((__m128i*)acc + i, a[i]);
+#elif defined(GDCM_XXHASH3_NEON)
+  uint64x2_t a[4];
+  for( int i = 0; i < 4; ++i ) a[i] = vld1q_u64(acc + 2 * i);
+  for( ; n; --n, p += StripeLength, s += 8 )
+    {
+    for( int i = 0; i < 4; ++i )
+      {
+      const uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8(p + 16 * i));
+      const uint64x2_t key = veorq_u64(data, vreinterpretq_u64_u8(vld1q_u8(s + 16 * i)));
+      a[i] = vaddq_u64(a[i], vextq_u64(data, data, 1));
+      a[i] = vmlal_u32(a[i], vmovn_u64(key), vshrn_n_u64(key, 32));
+      }
+    }
+  for( int i = 0; i < 4; ++i ) vst1q_u64(acc + 2 * i, a[i]);
+#else
+  for( ; n; --n, p += StripeLength, s += 8 )
+    {
+    for( int i = 0; i < 8; ++i )
+      {
+      const uint64_t data = Read64(p + 8 * i);
+      const uint64_t key = data ^ Read64(s + 8 * i);
+      acc[i ^ 1] += data;
+      acc[i] += (key & 0xffffffff) * (key >> 32);
+      }
+    }
+#endif
+}
+
+inline void Scramble(uint64_t acc[8], const unsigned char *s)
+{
+#if defined(GDCM_XXHASH3_SSE2)
+  __m128i *a = (__m128i*)acc;
+  const __m128i prime = _mm_set1_epi32((int)Prime32_1);
+  for( int i = 0; i < 4; ++i )
+    {
+    __m128i v = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+    v = _mm_xor_si128(v, _mm_loadu_si128((const __m128i*)s + i));
+    const __m128i lo = _mm_mul_epu32(v, prime);
+    const __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), prime);
+    a[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+#elif defined(GDCM_XXHASH3_NEON)
+  const uint32x2_t prime = vdup_n_u32((uint32_t)Prime32_1);
+  for( int i = 0; i < 4; ++i )
+    {
+    uint64x2_t v = vld1q_u64(acc + 2 * i);
+    v = veorq_u64(v, vshrq_n_u64(v, 47));
+    v = veorq_u64(v, vreinterpretq_u64_u8(vld1q_u8(s + 16 * i)));
+    const uint64x2_t hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(v, 32), prime), 32);
+    vst1q_u64(acc + 2 * i, vmlal_u32(hi, vmovn_u64(v), prime));
+    }
+#else
+  for( int i = 0; i < 8; ++i )
+    {
+    uint64_t v = acc[i];
+    v ^= v >> 47;
+    v ^= Read64(s + 8 * i);
+    acc[i] = v * Prime32_1;
+    }
+#endif
+}
+
+uint64_t MergeAccumulators(const uint64_t acc[8], uint64_t length)
+{
+  uint64_t h = length * Prime64_1;
+  for( int i = 0; i < 4; ++i )
+    h += Mul128Fold64(acc[2 * i] ^ Read64(Secret + 11 + 16 * i),
+      acc[2 * i + 1] ^ Read64(Secret + 11 + 16 * i + 8));
+  return Avalanche(h);
+}
+}
+
+class XXHash3Internals
+{
+public:
+  uint64_t Acc[8];
+  size_t StripesSoFar; // in the current block
+  // the last bytes of the message: more than 240 bytes are needed before
+  // taking the long path, and that path ends on the last 64 bytes
+  unsigned char Buffer[BufferSize];
+  size_t BufferLength;
+  uint64_t Length; // in bytes
+
+  void Init()
+    {
+    Acc[0] = Prime32_3;
+    Acc[1] = Prime64_1;
+    Acc[2] = Prime64_2;
+    Acc[3] = Prime64_3;
+    Acc[4] = Prime64_4;
+    Acc[5] = Prime32_2;
+    Acc[6] = Prime64_5;
+    Acc[7] = Prime32_1;
+    StripesSoFar = 0;
+    BufferLength = 0;
+    Length = 0;
+    }
+
+  // n stripes, scrambling at each end of block
+  void Stripes(uint64_t acc[8], size_t &sofar, const unsigned char *p, size_t n) const
+    {
+    while( n )
+      {
+      const size_t todo = n < StripesPerBlock - sofar ? n : StripesPerBlock - sofar;
+      Accumulate(acc, p, Secret + sofar * 8, todo);
+      p += todo * StripeLength;
+      n -= todo;
+      sofar += todo;
+      if( sofar == StripesPerBlock )
+        {
+        Scramble(acc, Secret + SecretSize - StripeLength);
+        sofar = 0;
+        }
+      }
+    }
+};
+
+XXHash3::XXHash3()
+{
+  Internals = new XXHash3Internals;
+  Internals->Init();
+}
+
+XXHash3::~XXHash3()
+{
+  delete Internals;
+}
+
+void XXHash3::Update(const char *buffer, size_t len)
+{
+  XXHash3Internals &in = *Internals;
+  const unsigned char *p = (const unsigned char*)buffer;
+  in.Length += len;
+  if( in.BufferLength + len <= BufferSize )
+    {
+    memcpy(in.Buffer + in.BufferLength, p, len);
+    in.BufferLength += len;
+    return;
+    }
+  // from here on there is more than a buffer: at least one byte is always
+  // kept, Final needs it
+  if( in.BufferLength )
+    {
+    const size_t n = BufferSize - in.BufferLength;
+    memcpy(in.Buffer + in.BufferLength, p, n);
+    p += n;
+    len -= n;
+    in.Stripes(in.Acc, in.StripesSoFar, in.Buffer, BufferSize / StripeLength);
+    in.BufferLength = 0;
+    }
+  if( len > BufferSize )
+    {
+    const size_t n = (len - 1) / StripeLength;
+    in.Stripes(in.Acc, in.StripesSoFar, p, n);
+    p += n * StripeLength;
+    len -= n * StripeLength;
+    // the last stripe may straddle the consumed bytes and the rest
+    memcpy(in.Buffer + BufferSize - StripeLength, p - StripeLength, StripeLength);
+    }
+  memcpy(in.Buffer, p, len);
+  in.BufferLength = len;
+}
+
+void XXHash3::Final(unsigned char digest[8])
+{
+  XXHash3Internals &in = *Internals;
+  uint64_t h;
+  if( in.Length <= 240 )
+    {
+    h = HashShort(in.Buffer, (size_t)in.Length);
+    }
+  else
+    {
+    uint64_t acc[8];
+    memcpy(acc, in.Acc, sizeof(acc));
+    size_t sofar = in.StripesSoFar;
+    unsigned char last[StripeLength];
+    const unsigned char *lastStripe;
+    if( in.BufferLength >= StripeLength )
+      {
+      const size_t n = (in.BufferLength - 1) / StripeLength;
+      in.Stripes(acc, sofar, in.Buffer, n);
+      lastStripe = in.Buffer + in.BufferLength - StripeLength;
+      }
+    else
+      {
+      const size_t catchup = StripeLength - in.BufferLength;
+      memcpy(last, in.Buffer + BufferSize - catchup, catchup);
+      memcpy(last + catchup, in.Buffer, in.BufferLength);
+      lastStripe = last;
+      }
+    Accumulate(acc, lastStripe, Secret + SecretSize - StripeLength - 7, 1);
+    h = MergeAccumulators(acc, in.Length);
+    }
+  for(int i = 0; i < 8; ++i)
+    digest[i] = (unsigned char)(h >> (56 - 8 * i));
+  in.Init();
+}
+
+static void ToString(const unsigned char *digest, int len, char *digest_str)
+{
+  static const char hex[] = "0123456789abcdef";
+  for (int di = 0; di < len; ++di)
+    {
+    digest_str[2*di] = hex[digest[di] >> 4];
+    digest_str[2*di+1] = hex[digest[di] & 0xf];
+    }
+  digest_str[2*len] = '\0';
+}
+
+bool XXHash3::Compute(const char *buffer, unsigned long buf_len, char digest_str[])
+{
+  if( !buffer && buf_len )
+    {
+    return false;
+    }
+
+  XXHash3 xxh;
+  xxh.Update(buffer, buf_len);
+  unsigned char digest[8];
+  xxh.Final(digest);
+  ToString(digest, 8, digest_str);
+  return true;
+}
+
+bool XXHash3::ComputeFile(const char *filename, char digest_str[8*2+1])
+{
+  if( !filename ) return false;
+  FILE *file = fopen(filename, "rb");
+  if( !file )
+    {
+    return false;
+    }
+  XXHash3 xxh;
+  std::vector<char> buffer( 1024 * 1024 );
+  size_t read;
+  while( (read = fread(&buffer[0], 1, buffer.size(), file)) > 0 )
+    {
+    xxh.Update(&buffer[0], read);
+    }
+  const bool error = ferror(file) != 0;
+  fclose(file);
+  if( error ) return false;
+
+  unsigned char digest[8];
+  xxh.Final(digest);
+  ToString(digest, 8, digest_str);
+  return true;
+}
+
+} // end namespace gdcm
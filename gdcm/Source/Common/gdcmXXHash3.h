@@ -0,0 +1,59 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMXXHASH3_H
+#define GDCMXXHASH3_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+//-----------------------------------------------------------------------------
+class XXHash3Internals;
+/**
+ * \brief Class for XXH3 (xxHash 3, 64 bits, seed 0, default secret)
+ *
+ * \details Non cryptographic checksum, an order of magnitude faster than
+ * SHA256 even on the SHA extensions: meant to detect corruption (transfers,
+ * storage), not tampering. Same interface as SHA1 and SHA256; the digest is
+ * in the canonical (big endian) order, so that the string matches xxhsum -H3
+ * and PHP's hash('xxh3').
+ *
+ * \see SHA1 SHA256
+ */
+class GDCM_EXPORT XXHash3
+{
+public :
+  XXHash3();
+  ~XXHash3();
+
+  /// Append len bytes to the message
+  void Update(const char *buffer, size_t len);
+  /// Return the digest of the message, the object is then ready for a new one
+  void Final(unsigned char digest[8]);
+
+  /// An empty message is valid (buffer can be NULL when buf_len is 0)
+  static bool Compute(const char *buffer, unsigned long buf_len, char digest_str[8*2+1]);
+
+  /// The file is read by chunks, it can be larger than the memory
+  static bool ComputeFile(const char *filename, char digest_str[8*2+1]);
+
+private:
+  XXHash3Internals *Internals;
+private:
+  XXHash3(const XXHash3&);  // Not implemented.
+  void operator=(const XXHash3&);  // Not implemented.
+};
+} // end namespace gdcm
+//-----------------------------------------------------------------------------
+#endif //GDCMXXHASH3_H
@@ -0,0 +1,46 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compiled with -mavx2, do not include any other gdcm header here.
+#include "gdcmXXHash3Kernels.h"
+
+#include <immintrin.h>
+
+namespace gdcm
+{
+namespace XXHash3Detail
+{
+
+// Same as the SSE2 loop of gdcmXXHash3.cxx, 32 bytes at a time
+void AccumulateAVX2(uint64_t acc[8], const unsigned char *p, const unsigned char *s, size_t n)
+{
+  __m256i a0 = _mm256_loadu_si256((const __m256i*)acc);
+  __m256i a1 = _mm256_loadu_si256((const __m256i*)acc + 1);
+  for( ; n; --n, p += 64, s += 8 )
+    {
+    const __m256i data0 = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i data1 = _mm256_loadu_si256((const __m256i*)p + 1);
+    const __m256i key0 = _mm256_xor_si256(data0, _mm256_loadu_si256((const __m256i*)s));
+    const __m256i key1 = _mm256_xor_si256(data1, _mm256_loadu_si256((const __m256i*)s + 1));
+    const __m256i product0 = _mm256_mul_epu32(key0, _mm256_shuffle_epi32(key0, _MM_SHUFFLE(0, 3, 0, 1)));
+    const __m256i product1 = _mm256_mul_epu32(key1, _mm256_shuffle_epi32(key1, _MM_SHUFFLE(0, 3, 0, 1)));
+    a0 = _mm256_add_epi64(a0, _mm256_add_epi64(product0, _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2))));
+    a1 = _mm256_add_epi64(a1, _mm256_add_epi64(product1, _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+  _mm256_storeu_si256((__m256i*)acc, a0);
+  _mm256_storeu_si256((__m256i*)acc + 1, a1);
+  _mm256_zeroupper();
+}
+
+} // end namespace XXHash3Detail
+} // end namespace gdcm
@@ -0,0 +1,35 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMXXHASH3KERNELS_H
+#define GDCMXXHASH3KERNELS_H
+
+// Private header, shared in between gdcmXXHash3.cxx and
+// gdcmXXHash3AVX2.cxx. Same rule as gdcmPixelKernelsTable.h: no other gdcm
+// header, the AVX2 unit is compiled with special flags.
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gdcm
+{
+namespace XXHash3Detail
+{
+
+// n stripes of 64 bytes into the 8 accumulators, the secret moving by 8
+// bytes from one stripe to the next
+void AccumulateAVX2(uint64_t acc[8], const unsigned char *p, const unsigned char *secret, size_t n);
+
+} // end namespace XXHash3Detail
+} // end namespace gdcm
+
+#endif //GDCMXXHASH3KERNELS_H
@@ -188,10 +188,18 @@ public:
   std::ostream const &Write(std::ostream &os) const {
     assert( !(Internal.size() % 2) );
     if( !Internal.empty() ) {
-      //os.write(&Internal[0], Internal.size());
-      std::vector<char> copy = Internal;
-      TSwap::SwapArray((TType*)&copy[0], Internal.size() / sizeof(TType) );
-      os.write(&copy[0], copy.size());
+      if( TSwap::IsNoOp() || sizeof(TType) == 1 )
+        {
+        // Nothing to swap: write the value in place, a copy of
+        // Pixel Data would double the memory used by the writer
+        os.write(&Internal[0], Internal.size());
+        }
+      else
+        {
+        std::vector<char> copy = Internal;
+        TSwap::SwapArray((TType*)&copy[0], Internal.size() / sizeof(TType) );
+        os.write(&copy[0], copy.size());
+        }
       }
     return os;
   }
@@ -0,0 +1,102 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmWriteBuffer.h"
+
+#include <string.h> // memcpy
+
+namespace gdcm
+{
+
+WriteBuffer::WriteBuffer(std::streambuf &dest, size_t buffersize):
+  Dest(dest),Buffer(buffersize < 64 ? 64 : buffersize),NumberOfWrites(0),Failure(false)
+{
+  setp(&Buffer[0], &Buffer[0] + Buffer.size());
+}
+
+WriteBuffer::~WriteBuffer()
+{
+  Flush();
+}
+
+bool WriteBuffer::Put(const char *s, std::streamsize n)
+{
+  if( n <= 0 ) return true;
+  ++NumberOfWrites;
+  if( Dest.sputn(s, n) != n )
+    {
+    Failure = true;
+    return false;
+    }
+  return true;
+}
+
+bool WriteBuffer::Flush()
+{
+  const std::streamsize n = pptr() - pbase();
+  setp(&Buffer[0], &Buffer[0] + Buffer.size());
+  return Put(&Buffer[0], n);
+}
+
+WriteBuffer::int_type WriteBuffer::overflow(int_type c)
+{
+  if( !Flush() ) return traits_type::eof();
+  if( !traits_type::eq_int_type(c, traits_type::eof()) )
+    {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize WriteBuffer::xsputn(const char *s, std::streamsize n)
+{
+  // fast path: a tag, a VR, a length, a short value
+  if( n <= epptr() - pptr() && n < (std::streamsize)Buffer.size() / 4 )
+    {
+    memcpy(pptr(), s, (size_t)n);
+    pbump((int)n);
+    return n;
+    }
+  if( !Flush() ) return 0;
+  if( n >= (std::streamsize)Buffer.size() / 4 )
+    {
+    // large enough for a write of its own, do not copy it
+    return Put(s, n) ? n : 0;
+    }
+  memcpy(pptr(), s, (size_t)n);
+  pbump((int)n);
+  return n;
+}
+
+int WriteBuffer::sync()
+{
+  if( !Flush() ) return -1;
+  return Dest.pubsync();
+}
+
+WriteBuffer::pos_type WriteBuffer::seekoff(off_type off,
+  std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+  if( !Flush() ) return pos_type(off_type(-1));
+  return Dest.pubseekoff(off, dir, which);
+}
+
+WriteBuffer::pos_type WriteBuffer::seekpos(pos_type pos,
+  std::ios_base::openmode which)
+{
+  if( !Flush() ) return pos_type(off_type(-1));
+  return Dest.pubseekpos(pos, which);
+}
+
+} // end namespace gdcm
@@ -0,0 +1,78 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMWRITEBUFFER_H
+#define GDCMWRITEBUFFER_H
+
+#include "gdcmTypes.h"
+
+#include <streambuf>
+#include <vector>
+
+namespace gdcm
+{
+/**
+ * \brief std::streambuf batching small writes for another streambuf
+ *
+ * \details A DataSet is serialized one field at a time: every tag, VR,
+ * length and value is its own write of a few bytes, and each of those
+ * goes through the generic (and slow) std::filebuf / std::stringbuf
+ * xsputn, and a write system call every few KB.
+ * WriteBuffer gathers them in one large buffer and hands it over to the
+ * destination in a single sputn() once full (or on sync()).
+ * A write at least a quarter of the buffer long (Pixel Data, large
+ * values) is not copied: the pending bytes go first, then the caller's
+ * bytes are passed on as they are.
+ * The destination receives exactly the bytes it would have received
+ * directly, in the same order. Seeking flushes, then seeks the
+ * destination.
+ *
+ * \see Writer
+ */
+class GDCM_EXPORT WriteBuffer : public std::streambuf
+{
+public:
+  WriteBuffer(std::streambuf &dest, size_t buffersize = 1024 * 1024);
+  /// Flushes, see sync()
+  ~WriteBuffer();
+
+  /// Number of sputn() calls made on the destination so far
+  size_t GetNumberOfWrites() const { return NumberOfWrites; }
+
+  /// Was any sputn() on the destination short ?
+  bool Failed() const { return Failure; }
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+  int sync();
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which);
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+private:
+  bool Flush();
+  bool Put(const char *s, std::streamsize n);
+
+  std::streambuf &Dest;
+  std::vector<char> Buffer;
+  size_t NumberOfWrites;
+  bool Failure;
+
+  WriteBuffer(const WriteBuffer &); // purposely not implemented
+  void operator=(const WriteBuffer &); // purposely not implemented
+};
+
+} // end namespace gdcm
+
+#endif //GDCMWRITEBUFFER_H
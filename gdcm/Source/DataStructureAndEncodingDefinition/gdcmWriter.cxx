@@ -28,11 +28,152 @@
 #include "gdcmParseException.h"
 
 #include "gdcmDeflateStream.h"
+#include "gdcmWriteBuffer.h"
+
+#include <string.h> // memcpy
 
 namespace gdcm
 {
 
-Writer::Writer():Stream(NULL),Ofstream(NULL),F(new File),CheckFileMetaInformation(true),WriteDataSetOnly(false)
+#ifndef GDCM_WORDS_BIGENDIAN
+// Explicit VR Little Endian on a little endian host, the common case: the
+// tag, VR and length of an element are laid out in memory and passed on in
+// one sputn(), the value follows in a second one (untouched, nothing to
+// swap). This is DataSet::Write<ExplicitDataElement,SwapperNoOp> without an
+// ostream::write (sentry, virtual call) per field. Anything unusual (UN
+// sequences, invalid or impossible VR, fragments, broken items...) is
+// handed over to ExplicitDataElement::Write on os, which shares sb, so the
+// bytes are the same in every case.
+static void PutBytes(std::streambuf &sb, const char *s, std::streamsize n)
+{
+  if( sb.sputn(s, n) != n )
+    {
+    throw Exception( "Short write" );
+    }
+}
+
+static char *PutTag(char *p, uint16_t group, uint16_t element)
+{
+  memcpy(p, &group, 2);
+  memcpy(p + 2, &element, 2);
+  return p + 4;
+}
+
+static char *PutVL(char *p, uint32_t vl)
+{
+  memcpy(p, &vl, 4);
+  return p + 4;
+}
+
+static void WriteExplicitLittleEndian(const DataSet &ds, std::streambuf &sb, std::ostream &os);
+
+static void WriteExplicitLittleEndian(const DataElement &de, std::streambuf &sb, std::ostream &os)
+{
+  const Tag &tag = de.GetTag();
+  const VR &vr = de.GetVR();
+  const VL &vl = de.GetVL();
+  if( tag.GetGroup() == 0xfffe || vr == VR::INVALID || vr.IsDual() || !vr.IsVRFile()
+    || ((vr & VR::VL16) && vl > (uint32_t)VL::GetVL16Max())
+    || (vr == VR::UN && vl.IsUndefined()) )
+    {
+    de.Write<ExplicitDataElement,SwapperNoOp>(os);
+    return;
+    }
+  const ByteValue *bv = 0;
+  const SequenceOfItems *sqi = 0;
+  if( vl )
+    {
+    bv = de.GetByteValue();
+    if( !bv && !de.IsEmpty() )
+      {
+      sqi = dynamic_cast<const SequenceOfItems*>(&de.GetValue());
+      }
+    unsigned int vrsize = 1;
+    if( !(vr & VR::VRASCII) )
+      {
+      vrsize = vr == VR::AT ? 2 : vr.GetSize();
+      }
+    if( (!bv && !sqi) || (bv && bv->GetLength() != vl) || (vr == VR::SQ && !sqi)
+      || (vrsize != 1 && vrsize != 2 && vrsize != 4 && vrsize != 8) )
+      {
+      de.Write<ExplicitDataElement,SwapperNoOp>(os);
+      return;
+      }
+    }
+
+  char header[12];
+  char *p = PutTag(header, tag.GetGroup(), tag.GetElement());
+  const char *vrstring = VR::GetVRString(vr);
+  p[0] = vrstring[0];
+  p[1] = vrstring[1];
+  p += 2;
+  uint32_t length = vl;
+  if( vl.IsOdd() ) ++length;
+  if( vr & VR::VL32 )
+    {
+    p[0] = p[1] = 0;
+    p = PutVL(p + 2, length);
+    }
+  else
+    {
+    const uint16_t length16 = (uint16_t)length;
+    memcpy(p, &length16, 2);
+    p += 2;
+    }
+  PutBytes(sb, header, p - header);
+  if( bv )
+    {
+    if( bv->GetPointer() )
+      {
+      // the padding byte of an odd length is part of the buffer
+      PutBytes(sb, bv->GetPointer(), bv->GetLength() + (bv->GetLength() % 2));
+      }
+    }
+  else if( sqi )
+    {
+    if( !vl.IsUndefined() )
+      {
+      VL dummy = sqi->ComputeLength<ExplicitDataElement>();
+      gdcmAssertAlwaysMacro( dummy == vl );
+      }
+    for( SequenceOfItems::ConstIterator it = sqi->Begin(); it != sqi->End(); ++it )
+      {
+      const Item &item = *it;
+      if( item.GetTag() != Tag(0xfffe,0xe000) )
+        {
+        item.Write<ExplicitDataElement,SwapperNoOp>(os);
+        continue;
+        }
+      const bool undefined = item.GetVL().IsUndefined();
+      p = PutTag(header, 0xfffe, 0xe000);
+      p = PutVL(p, undefined ? 0xFFFFFFFF
+        : (uint32_t)item.GetNestedDataSet().GetLength<ExplicitDataElement>());
+      PutBytes(sb, header, p - header);
+      WriteExplicitLittleEndian(item.GetNestedDataSet(), sb, os);
+      if( undefined )
+        {
+        p = PutVL(PutTag(header, 0xfffe, 0xe00d), 0);
+        PutBytes(sb, header, p - header);
+        }
+      }
+    if( sqi->IsUndefinedLength() )
+      {
+      p = PutVL(PutTag(header, 0xfffe, 0xe0dd), 0);
+      PutBytes(sb, header, p - header);
+      }
+    }
+}
+
+static void WriteExplicitLittleEndian(const DataSet &ds, std::streambuf &sb, std::ostream &os)
+{
+  for( DataSet::ConstIterator it = ds.Begin(); it != ds.End(); ++it )
+    {
+    WriteExplicitLittleEndian(*it, sb, os);
+    }
+}
+#endif
+
+Writer::Writer():Stream(NULL),Ofstream(NULL),F(new File),CheckFileMetaInformation(true),WriteDataSetOnly(false),BufferSize(1024 * 1024)
 {
 }
 
@@ -54,7 +195,38 @@ bool Writer::Write()
     return false;
     }
 
-  std::ostream &os = *Stream;
+  if( BufferSize )
+    {
+    // Serialize through a large buffer in front of Stream, and pass
+    // everything on (flush) before returning: subclasses keep on
+    // writing to Stream afterwards.
+    WriteBuffer buffer( *Stream->rdbuf(), BufferSize );
+    std::ostream bos( &buffer );
+    bool ret = WriteToStream( bos );
+    bos.flush();
+    if( buffer.Failed() )
+      {
+      gdcmErrorMacro( "Could not write to the stream" );
+      Stream->setstate( std::ios::badbit );
+      ret = false;
+      }
+    if( ret && Ofstream )
+      {
+      Ofstream->close();
+      }
+    return ret;
+    }
+
+  const bool ret = WriteToStream( *Stream );
+  if( ret && Ofstream )
+    {
+    Ofstream->close();
+    }
+  return ret;
+}
+
+bool Writer::WriteToStream(std::ostream &os)
+{
   FileMetaInformation &Header = F->GetHeader();
   DataSet &DS = F->GetDataSet();
 
@@ -137,7 +309,16 @@ bool Writer::Write()
       else
         {
         assert( ts.GetNegociatedType() == TransferSyntax::Explicit );
-        DS.Write<ExplicitDataElement,SwapperNoOp>(os);
+#ifndef GDCM_WORDS_BIGENDIAN
+        if( BufferSize && os.rdbuf() )
+          {
+          WriteExplicitLittleEndian(DS, *os.rdbuf(), os);
+          }
+        else
+#endif
+          {
+          DS.Write<ExplicitDataElement,SwapperNoOp>(os);
+          }
         }
       }
     }
@@ -154,10 +335,6 @@ bool Writer::Write()
     }
 
   os.flush();
-  if (Ofstream)
-    {
-    Ofstream->close();
-    }
 
   return true;
 }
@@ -66,6 +66,14 @@ public:
   void SetFile(const File& f) { F = f; }
   File &GetFile() { return *F; }
 
+  /// Size of the buffer gathering the many small writes of the serialization
+  /// before they reach the stream (see WriteBuffer), 1MB by default. Explicit
+  /// VR Little Endian data sets are then also serialized one element header
+  /// at a time instead of one field at a time. 0 writes straight to the
+  /// stream, field by field. The output is the same either way.
+  void SetBufferSize(size_t size) { BufferSize = size; }
+  size_t GetBufferSize() const { return BufferSize; }
+
   /// Undocumented function, do not use (= leave default)
   void SetCheckFileMetaInformation(bool b) { CheckFileMetaInformation = b; }
   void CheckFileMetaInformationOff() { CheckFileMetaInformation = false; }
@@ -73,6 +81,8 @@ public:
 
 protected:
   void SetWriteDataSetOnly(bool b) { WriteDataSetOnly = b; }
+  /// The serialization itself, Write() chooses the stream
+  bool WriteToStream(std::ostream &os);
 
 protected:
   friend class StreamImageWriter;
@@ -89,6 +99,7 @@ private:
   SmartPointer<File> F;
   bool CheckFileMetaInformation;
   bool WriteDataSetOnly;
+  size_t BufferSize;
 };
 
 } // end namespace gdcm
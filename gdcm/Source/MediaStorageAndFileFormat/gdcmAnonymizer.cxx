@@ -28,6 +28,15 @@
 #include "gdcmEvent.h"
 #include "gdcmAnonymizeEvent.h"
 
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#if defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+  #include <pthread.h>
+  #define GDCM_ANONYMIZER_THREADS
+#endif
+
 namespace gdcm
 {
 // PS 3.15 - 2008
@@ -86,6 +95,141 @@ static Tag BasicApplicationLevelConfidentialityProfileAttributes[] = {
 };
 
 
+/*
+ * The dummy 'memory' (original value -> dummy value) is shared by every
+ * Anonymizer of the process: the files of a series keep consistent Study,
+ * Series, Frame of Reference... UIDs whichever Anonymizer (or thread) did
+ * the work. It is split in shards, each with its own lock, so that threads
+ * de-identifying different files seldom wait for each other. A dummy value
+ * is generated under the lock of its shard: a given original value is only
+ * ever given one.
+ *
+ * It also keeps, for each IOD met so far, whether each BALCPA attribute can
+ * be emptied (CanEmptyTag): IOD::GetTypeFromTag walks every module of the
+ * IOD, the answer only depends on the SOP Class.
+ */
+class AnonymizerMemory
+{
+public:
+  typedef std::pair< Tag, std::string > TagValueKey;
+  typedef std::map< TagValueKey, std::string > DummyMapNonUIDTags;
+  typedef std::map< std::string, std::string > DummyMapUIDTags;
+  typedef std::vector<char> ProtectionPlan; // indexed as BALCPA
+
+  static AnonymizerMemory &GetInstance()
+    {
+    static AnonymizerMemory memory;
+    return memory;
+    }
+
+  std::string GetDummyUID(const std::string &uid)
+    {
+    Shard &shard = Shards[ Hash(uid) % NumberOfShards ];
+    Lock(shard.Lock);
+    DummyMapUIDTags::const_iterator it = shard.UIDs.find( uid );
+    if( it == shard.UIDs.end() )
+      {
+      it = shard.UIDs.insert( std::make_pair(uid, UIDGenerator::GenerateUID()) ).first;
+      }
+    const std::string dummy = it->second;
+    Unlock(shard.Lock);
+    return dummy;
+    }
+
+  std::string GetDummyValue(const TagValueKey &tvk)
+    {
+    Shard &shard = Shards[ (Hash(tvk.second) ^ tvk.first.GetElementTag()) % NumberOfShards ];
+    Lock(shard.Lock);
+    DummyMapNonUIDTags::const_iterator it = shard.Values.find( tvk );
+    if( it == shard.Values.end() )
+      {
+      char digest[2*20+1];
+      const bool b = DummyValueGenerator::Generate( tvk.second.c_str(), digest );
+      it = shard.Values.insert( std::make_pair(tvk, std::string(b ? digest : "")) ).first;
+      }
+    const std::string dummy = it->second;
+    Unlock(shard.Lock);
+    return dummy;
+    }
+
+  void Clear()
+    {
+    for( unsigned int i = 0; i < NumberOfShards; ++i )
+      {
+      Lock(Shards[i].Lock);
+      Shards[i].UIDs.clear();
+      Shards[i].Values.clear();
+      Unlock(Shards[i].Lock);
+      }
+    }
+
+  // plan is built by the caller when missing, outside of the lock: the
+  // first one stored is kept, they are all the same anyway
+  const ProtectionPlan *FindPlan(const IOD *iod)
+    {
+    Lock(PlansLock);
+    std::map<const IOD*, ProtectionPlan>::const_iterator it = Plans.find( iod );
+    const ProtectionPlan *plan = it == Plans.end() ? 0 : &it->second;
+    Unlock(PlansLock);
+    return plan;
+    }
+  const ProtectionPlan *StorePlan(const IOD *iod, ProtectionPlan const &plan)
+    {
+    Lock(PlansLock);
+    const ProtectionPlan *stored = &Plans.insert( std::make_pair(iod, plan) ).first->second;
+    Unlock(PlansLock);
+    return stored;
+    }
+
+private:
+  static const unsigned int NumberOfShards = 16;
+#ifdef GDCM_ANONYMIZER_THREADS
+  typedef pthread_mutex_t MutexType;
+  static void Lock(MutexType &m) { pthread_mutex_lock(&m); }
+  static void Unlock(MutexType &m) { pthread_mutex_unlock(&m); }
+#else
+  typedef int MutexType;
+  static void Lock(MutexType &) {}
+  static void Unlock(MutexType &) {}
+#endif
+  struct Shard
+  {
+    MutexType Lock;
+    DummyMapUIDTags UIDs;
+    DummyMapNonUIDTags Values;
+  };
+
+  AnonymizerMemory()
+    {
+#ifdef GDCM_ANONYMIZER_THREADS
+    for( unsigned int i = 0; i < NumberOfShards; ++i )
+      pthread_mutex_init(&Shards[i].Lock, NULL);
+    pthread_mutex_init(&PlansLock, NULL);
+#endif
+    }
+  ~AnonymizerMemory()
+    {
+#ifdef GDCM_ANONYMIZER_THREADS
+    for( unsigned int i = 0; i < NumberOfShards; ++i )
+      pthread_mutex_destroy(&Shards[i].Lock);
+    pthread_mutex_destroy(&PlansLock);
+#endif
+    }
+
+  // FNV-1a
+  static unsigned int Hash(const std::string &s)
+    {
+    unsigned int h = 2166136261u;
+    for( std::string::const_iterator it = s.begin(); it != s.end(); ++it )
+      h = (h ^ (unsigned char)*it) * 16777619u;
+    return h;
+    }
+
+  Shard Shards[NumberOfShards];
+  MutexType PlansLock;
+  std::map<const IOD*, ProtectionPlan> Plans;
+};
+
 Anonymizer::~Anonymizer()
 {
 }
@@ -411,12 +555,9 @@ bool Anonymizer::RemovePrivateTags()
 
 /*
  * Implementation note:
- * In order to implement the dummy 'memory' we use a static std::map
- * this works great but we cannot be thread safe.
- * In order to be thread safe, we would need to externalize this map generation
- * maybe using a gdcm::Scanner do the operation once (Scanner is doing) the merging
- * automatically...
- * this is left as an exercise for the reader :)
+ * The dummy 'memory' is the AnonymizerMemory above, shared and locked: the
+ * files of a series can be de-identified from several threads, each one with
+ * its own Anonymizer (see SeriesAnonymizer).
  */
 bool Anonymizer::BasicApplicationLevelConfidentialityProfile(bool deidentify)
 {
@@ -766,12 +907,11 @@ static const Tag SpecialTypeTags[] = {
 /*   Series Number           */ Tag(0x0020,0x0011)
 };
 
-bool Anonymizer::CanEmptyTag(Tag const &tag, const IOD &iod) const
+static bool CanEmptyTagFromIOD(Tag const &tag, const IOD &iod)
 {
   static const Global &g = Global::GetInstance();
   //static const Dicts &dicts = g.GetDicts();
   static const Defs &defs = g.GetDefs();
-  const DataSet &ds = F->GetDataSet(); (void)ds;
   //Type told = defs.GetTypeFromTag(*F, tag);
   Type t = iod.GetTypeFromTag(defs, tag);
   //assert( t == told );
@@ -822,13 +962,35 @@ generate a DICOMDIR
   return !b;
 }
 
-Anonymizer::DummyMapNonUIDTags Anonymizer::dummyMapNonUIDTags;
-Anonymizer::DummyMapUIDTags Anonymizer::dummyMapUIDTags;
+bool Anonymizer::CanEmptyTag(Tag const &tag, const IOD &iod) const
+{
+  static const unsigned int deidSize = sizeof(Tag);
+  static const unsigned int numDeIds = sizeof(BasicApplicationLevelConfidentialityProfileAttributes) / deidSize;
+  static const Tag *start = BasicApplicationLevelConfidentialityProfileAttributes;
+  static const Tag *end = start + numDeIds;
+
+  const Tag *ptr = std::lower_bound(start, end, tag);
+  if( ptr == end || *ptr != tag )
+    {
+    return CanEmptyTagFromIOD(tag, iod);
+    }
+  AnonymizerMemory &memory = AnonymizerMemory::GetInstance();
+  const AnonymizerMemory::ProtectionPlan *plan = memory.FindPlan( &iod );
+  if( !plan )
+    {
+    AnonymizerMemory::ProtectionPlan newplan( numDeIds );
+    for( unsigned int i = 0; i < numDeIds; ++i )
+      {
+      newplan[i] = CanEmptyTagFromIOD(start[i], iod);
+      }
+    plan = memory.StorePlan( &iod, newplan );
+    }
+  return (*plan)[ ptr - start ] != 0;
+}
 
 void Anonymizer::ClearInternalUIDs()
 {
-  dummyMapNonUIDTags.clear();
-  dummyMapUIDTags.clear();
+  AnonymizerMemory::GetInstance().Clear();
 }
 
 bool Anonymizer::BALCPProtect(DataSet &ds, Tag const & tag, IOD const & iod)
@@ -850,7 +1012,6 @@ bool Anonymizer::BALCPProtect(DataSet &ds, Tag const & tag, IOD const & iod)
     if ( IsVRUI( tag ) )
       {
       std::string UIDToAnonymize = "";
-      gdcm::UIDGenerator uid;
 
       if( !copy.IsEmpty() )
         {
@@ -863,21 +1024,13 @@ bool Anonymizer::BALCPProtect(DataSet &ds, Tag const & tag, IOD const & iod)
       std::string anonymizedUID = "";
       if( !UIDToAnonymize.empty() )
         {
-        if ( dummyMapUIDTags.count( UIDToAnonymize ) == 0 )
-          {
-          anonymizedUID = uid.Generate();
-          dummyMapUIDTags[ UIDToAnonymize ] = anonymizedUID;
-          }
-        else
-          {
-          anonymizedUID = dummyMapUIDTags[ UIDToAnonymize ];
-          }
+        anonymizedUID = AnonymizerMemory::GetInstance().GetDummyUID( UIDToAnonymize );
         }
       else
         {
         // gdcmData/LEADTOOLS_FLOWERS-16-MONO2-JpegLossless.dcm
         // has an empty 0008,0018 attribute, let's try to handle creating new UID
-        anonymizedUID = uid.Generate();
+        anonymizedUID = UIDGenerator::GenerateUID();
         }
 
       copy.SetByteValue( anonymizedUID.c_str(), (uint32_t)anonymizedUID.size() );
@@ -885,22 +1038,10 @@ bool Anonymizer::BALCPProtect(DataSet &ds, Tag const & tag, IOD const & iod)
       }
     else
       {
-      TagValueKey tvk;
+      AnonymizerMemory::TagValueKey tvk;
       tvk.first = tag;
 
-      assert( dummyMapNonUIDTags.count( tvk ) == 0 || dummyMapNonUIDTags.count( tvk ) == 1 );
-      if( dummyMapNonUIDTags.count( tvk ) == 0 )
-        {
-        const char *ret = DummyValueGenerator::Generate( tvk.second.c_str() );
-        if( ret )
-          {
-          dummyMapNonUIDTags[ tvk ] = ret;
-          }
-        else
-          dummyMapNonUIDTags[ tvk ] = "";
-        }
-
-      std::string &v = dummyMapNonUIDTags[ tvk ];
+      const std::string v = AnonymizerMemory::GetInstance().GetDummyValue( tvk );
       copy.SetByteValue( v.c_str(), (uint32_t)v.size() );
       }
       ds.Replace( copy );
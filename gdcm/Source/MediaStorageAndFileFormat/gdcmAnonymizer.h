@@ -122,7 +122,9 @@ public:
   /// PS 3.15 / E.1.1 De-Identifier
   /// An Application may claim conformance to the Basic Application Level Confidentiality Profile as a deidentifier
   /// if it protects all Attributes that might be used by unauthorized entities to identify the patient.
-  /// NOT THREAD SAFE
+  /// Several Anonymizer can run it concurrently (one per thread), they share the
+  /// dummy values and UIDs. The CryptographicMessageSyntax must not be shared
+  /// without a lock, see SeriesAnonymizer.
   bool BasicApplicationLevelConfidentialityProfile(bool deidentify = true);
 
   /// Set/Get CMS key that will be used to encrypt the dataset within BasicApplicationLevelConfidentialityProfile
@@ -135,7 +137,8 @@ public:
   /// Return the list of Tag that will be considered when anonymizing a DICOM file.
   static std::vector<Tag> GetBasicApplicationLevelConfidentialityProfileAttributes();
 
-  /// Clear the internal mapping of real UIDs to generated UIDs
+  /// Clear the internal mapping of real UIDs to generated UIDs (shared by all
+  /// the Anonymizer of the process)
   /// \warning the mapping is definitely lost
   static void ClearInternalUIDs();
 
@@ -155,11 +158,6 @@ private:
   SmartPointer<File> F;
   CryptographicMessageSyntax *CMS;
 
-  typedef std::pair< Tag, std::string > TagValueKey;
-  typedef std::map< TagValueKey, std::string > DummyMapNonUIDTags;
-  typedef std::map< std::string, std::string > DummyMapUIDTags;
-  static DummyMapNonUIDTags dummyMapNonUIDTags;
-  static DummyMapUIDTags dummyMapUIDTags;
 };
 
 /**
@@ -12,6 +12,188 @@
 
 =========================================================================*/
 #include "gdcmDICOMDIR.h"
+#include "gdcmMediaStorage.h"
+#include "gdcmAttribute.h"
+#include "gdcmSequenceOfItems.h"
+#include "gdcmExplicitDataElement.h"
+#include "gdcmImplicitDataElement.h"
+
+#include <map>
 
 namespace gdcm
-{}
+{
+
+// Value of t in ds, without the padding
+static std::string GetString(DataSet const &ds, Tag const &t)
+{
+  if( !ds.FindDataElement( t ) ) return "";
+  const ByteValue *bv = ds.GetDataElement( t ).GetByteValue();
+  if( !bv ) return "";
+  std::string s( bv->GetPointer(), bv->GetLength() );
+  std::string::size_type end = s.find_last_not_of( std::string(" \0", 2) );
+  if( end == std::string::npos ) return "";
+  s.erase( end + 1 );
+  return s.substr( s.find_first_not_of( ' ' ) );
+}
+
+// Referenced File ID (0004,1500): DIR\SUBDIR\FILE -> DIR/SUBDIR/FILE
+static std::string GetFileID(DataSet const &ds)
+{
+  std::string id = GetString( ds, Tag(0x4,0x1500) );
+  std::string path;
+  std::string::size_type b = 0;
+  while( b <= id.size() )
+    {
+    std::string::size_type e = id.find( '\\', b );
+    if( e == std::string::npos ) e = id.size();
+    std::string component = id.substr( b, e - b );
+    std::string::size_type last = component.find_last_not_of( ' ' );
+    if( last != std::string::npos )
+      {
+      if( !path.empty() ) path += '/';
+      path += component.substr( 0, last + 1 );
+      }
+    b = e + 1;
+    }
+  return path;
+}
+
+// Fill in record with the attributes of the directory record rds, return
+// true when rds references a file
+static bool ApplyRecord(DataSet const &rds, DICOMDIR::FileRecord &record)
+{
+  static const Tag patientid(0x10,0x20);
+  static const Tag patientname(0x10,0x10);
+  static const Tag studyuid(0x20,0xd);
+  static const Tag seriesuid(0x20,0xe);
+  static const Tag modality(0x8,0x60);
+  record.RecordType = GetString( rds, Tag(0x4,0x1430) );
+  if( rds.FindDataElement( patientid ) ) record.PatientID = GetString( rds, patientid );
+  if( rds.FindDataElement( patientname ) ) record.PatientName = GetString( rds, patientname );
+  if( rds.FindDataElement( studyuid ) ) record.StudyInstanceUID = GetString( rds, studyuid );
+  if( rds.FindDataElement( seriesuid ) ) record.SeriesInstanceUID = GetString( rds, seriesuid );
+  if( rds.FindDataElement( modality ) ) record.Modality = GetString( rds, modality );
+  record.ReferencedFileID = GetFileID( rds );
+  if( record.ReferencedFileID.empty() ) return false;
+  record.ReferencedSOPClassUID = GetString( rds, Tag(0x4,0x1510) );
+  record.ReferencedSOPInstanceUID = GetString( rds, Tag(0x4,0x1511) );
+  record.ReferencedTransferSyntaxUID = GetString( rds, Tag(0x4,0x1512) );
+  return true;
+}
+
+// Record In-use Flag (0004,1410), retired: 0 marks an inactive record
+static bool IsInactive(DataSet const &rds)
+{
+  if( !rds.FindDataElement( Tag(0x4,0x1410) ) ) return false;
+  Attribute<0x4,0x1410> inuse = {0xffff};
+  inuse.SetFromDataSet( rds );
+  return inuse.GetValue() == 0;
+}
+
+bool DICOMDIR::SetFromFile(File const &file)
+{
+  FileRecords.clear();
+  MediaStorage ms;
+  ms.SetFromFile( file );
+  if( ms != MediaStorage::MediaStorageDirectoryStorage ) return false;
+
+  const DataSet &ds = file.GetDataSet();
+  const Tag directoryrecordsequence(0x4,0x1220);
+  if( !ds.FindDataElement( directoryrecordsequence ) ) return true; // empty File-set
+  SmartPointer<SequenceOfItems> sqi = ds.GetDataElement( directoryrecordsequence ).GetValueAsSQ();
+  if( !sqi ) return false;
+
+  const bool explicitvr = !file.GetHeader().GetDataSetTransferSyntax().IsImplicit();
+  if( !TraverseOffsets( *sqi, ds, explicitvr ) )
+    {
+    FileRecords.clear();
+    TraverseSequence( *sqi );
+    }
+  return true;
+}
+
+// Follow the offsets, depth first. Return false if one of them does not
+// lead to a record, or leads to a record already seen
+bool DICOMDIR::TraverseOffsets(SequenceOfItems const &sqi, DataSet const &ds, bool explicitvr)
+{
+  if( !ds.FindDataElement( Tag(0x4,0x1200) ) ) return false;
+  Attribute<0x4,0x1200> first = {0};
+  first.SetFromDataSet( ds );
+
+  // The offsets are from the start of the file, the items follow each
+  // other from the first record on
+  const SequenceOfItems::SizeType nitems = sqi.GetNumberOfItems();
+  std::map<uint32_t, SequenceOfItems::SizeType> items; // offset -> item
+  uint32_t offset = first.GetValue();
+  for( SequenceOfItems::SizeType i = 1; i <= nitems; ++i )
+    {
+    items[offset] = i;
+    const Item &item = sqi.GetItem( i );
+    offset += explicitvr ? item.GetLength<ExplicitDataElement>() : item.GetLength<ImplicitDataElement>();
+    }
+
+  std::vector<char> seen( nitems + 1, 0 );
+  std::vector< std::pair<uint32_t, FileRecord> > pending; // offset, attributes of the upper records
+  if( nitems ) pending.push_back( std::make_pair( first.GetValue(), FileRecord() ) );
+  while( !pending.empty() )
+    {
+    const uint32_t o = pending.back().first;
+    FileRecord record = pending.back().second;
+    pending.pop_back();
+    std::map<uint32_t, SequenceOfItems::SizeType>::const_iterator it = items.find( o );
+    if( it == items.end() || seen[it->second] ) return false;
+    seen[it->second] = 1;
+    const DataSet &rds = sqi.GetItem( it->second ).GetNestedDataSet();
+
+    Attribute<0x4,0x1400> next = {0};
+    next.SetFromDataSet( rds );
+    if( next.GetValue() ) pending.push_back( std::make_pair( next.GetValue(), record ) );
+    if( IsInactive( rds ) ) continue;
+
+    Attribute<0x4,0x1420> lower = {0};
+    lower.SetFromDataSet( rds );
+    if( ApplyRecord( rds, record ) ) FileRecords.push_back( record );
+    // the lower level before the next record of this one
+    if( lower.GetValue() ) pending.push_back( std::make_pair( lower.GetValue(), record ) );
+    }
+  return true;
+}
+
+// The records in sequence order, each PATIENT, STUDY and SERIES record
+// applying to the following records, up to the next one of its level
+void DICOMDIR::TraverseSequence(SequenceOfItems const &sqi)
+{
+  FileRecord patient;
+  FileRecord study;
+  FileRecord series;
+  for( SequenceOfItems::SizeType i = 1; i <= sqi.GetNumberOfItems(); ++i )
+    {
+    const DataSet &rds = sqi.GetItem( i ).GetNestedDataSet();
+    if( IsInactive( rds ) ) continue;
+    const std::string type = GetString( rds, Tag(0x4,0x1430) );
+    if( type == "PATIENT" )
+      {
+      patient = FileRecord();
+      ApplyRecord( rds, patient );
+      study = series = patient;
+      }
+    else if( type == "STUDY" )
+      {
+      study = patient;
+      ApplyRecord( rds, study );
+      series = study;
+      }
+    else if( type == "SERIES" )
+      {
+      series = study;
+      ApplyRecord( rds, series );
+      }
+    else
+      {
+      FileRecord record = series;
+      if( ApplyRecord( rds, record ) ) FileRecords.push_back( record );
+      }
+    }
+}
+
+} // end namespace gdcm
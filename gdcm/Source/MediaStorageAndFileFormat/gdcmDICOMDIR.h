@@ -16,12 +16,32 @@
 
 #include "gdcmFileSet.h"
 
+#include <string>
+#include <vector>
+
 namespace gdcm
 {
+class DataSet;
+class SequenceOfItems;
+
 /**
  * \brief DICOMDIR class
  *
  * Structured for handling DICOMDIR
+ *
+ * \details SetFromFile lists the files of a File-set from its DICOMDIR,
+ * without opening them: each directory record referencing a file (IMAGE,
+ * PRESENTATION, SR DOCUMENT...) becomes a FileRecord, along with the
+ * patient, study and series attributes of the records above it.
+ *
+ * The hierarchy is followed through the record offsets (0004,1200),
+ * (0004,1400) and (0004,1420). When they do not lead to the records (a
+ * DICOMDIR rewritten by a tool that did not update them), the records are
+ * taken in their order in the sequence, each PATIENT, STUDY and SERIES
+ * record applying to the records following it.
+ *
+ * Nothing guarantees that the referenced files exist nor that they match
+ * their record: they are to be checked when they are eventually read.
  */
 class GDCM_EXPORT DICOMDIR
 {
@@ -29,9 +49,38 @@ public:
   DICOMDIR() {}
   DICOMDIR(const FileSet& fs):_FS(fs) {}
 
+  /// A directory record referencing a file
+  struct FileRecord
+    {
+    std::string RecordType;                  // (0004,1430)
+    /// (0004,1500), the components separated by '/', relative to the
+    /// directory of the DICOMDIR
+    std::string ReferencedFileID;
+    std::string ReferencedSOPClassUID;       // (0004,1510)
+    std::string ReferencedSOPInstanceUID;    // (0004,1511)
+    std::string ReferencedTransferSyntaxUID; // (0004,1512)
+    std::string PatientID;                   // (0010,0020)
+    std::string PatientName;                 // (0010,0010)
+    std::string StudyInstanceUID;            // (0020,000d)
+    std::string SeriesInstanceUID;           // (0020,000e)
+    std::string Modality;                    // (0008,0060)
+    };
+  typedef std::vector<FileRecord> FileRecordsType;
+
+  /// Read the directory records of file, a Media Storage Directory Storage
+  /// (DICOMDIR). Return false if it is not one
+  bool SetFromFile(File const &file);
+
+  /// The records referencing a file, in hierarchy order
+  FileRecordsType const &GetFileRecords() const { return FileRecords; }
+
 private:
+  bool TraverseOffsets(SequenceOfItems const &sqi, DataSet const &ds, bool explicitvr);
+  void TraverseSequence(SequenceOfItems const &sqi);
+
   FileSet _FS;
   //13 sept 2010 mmr-- added the underscore to FS to compile under Sunos gcc
+  FileRecordsType FileRecords;
 };
 
 } // end namespace gdcm
@@ -26,6 +26,7 @@
 #include "gdcmVR.h"
 #include "gdcmCodeString.h"
 
+#include <map>
 
 namespace gdcm
 {
@@ -33,7 +34,7 @@ namespace gdcm
 class DICOMDIRGeneratorInternal
 {
 public:
-  DICOMDIRGeneratorInternal():F(new File) {}
+  DICOMDIRGeneratorInternal():F(new File),NumberOfThreads(0) {}
   SmartPointer<File> F;
   typedef Directory::FilenamesType  FilenamesType;
   FilenamesType fns;
@@ -42,6 +43,51 @@ public:
   Scanner scanner;
   std::vector<uint32_t> OffsetTable;
   std::string FileSetID;
+  unsigned int NumberOfThreads;
+
+  // First scanned file holding each Patient ID, Study, Series and SOP
+  // Instance UID, the values in lexicographic order (as Scanner::GetValues)
+  typedef std::map<const char *, const char *, Scanner::ltstr> FirstFileType;
+  FirstFileType Patients;
+  FirstFileType Studies;
+  FirstFileType Series;
+  FirstFileType Images;
+
+  // The Directory Record Sequence, in order. The values are the Scanner
+  // ones, a value has a single address: pointers are compared, not strings.
+  struct Record
+    {
+    const char *Type;
+    const char *Key; // Patient ID, Study, Series or SOP Instance UID
+    const char *Parent; // Key of the upper level record, NULL for a patient
+    };
+  std::vector<Record> Records;
+
+  void Index()
+    {
+    static const Tag keys[] = { Tag(0x10,0x20), Tag(0x20,0xd), Tag(0x20,0xe), Tag(0x8,0x18) };
+    FirstFileType * const firstfiles[] = { &Patients, &Studies, &Series, &Images };
+    for( int i = 0; i < 4; ++i )
+      {
+      firstfiles[i]->clear();
+      }
+    FilenamesType const &filenames = scanner.GetFilenames();
+    for( FilenamesType::const_iterator file = filenames.begin(); file != filenames.end(); ++file )
+      {
+      const char *filename = file->c_str();
+      if( !scanner.IsKey( filename ) ) continue;
+      Scanner::TagToValue const &ttv = scanner.GetMapping( filename );
+      for( int i = 0; i < 4; ++i )
+        {
+        Scanner::TagToValue::const_iterator it = ttv.find( keys[i] );
+        if( it != ttv.end() )
+          {
+          // the first file is kept
+          firstfiles[i]->insert( FirstFileType::value_type( it->second, filename ) );
+          }
+        }
+      }
+    }
 };
 
 bool DICOMDIRGenerator::ComputeDirectoryRecordsOffset(const SequenceOfItems *sqi, VL start)
@@ -67,289 +113,122 @@ bool DICOMDIRGenerator::ComputeDirectoryRecordsOffset(const SequenceOfItems *sqi
   return true;
 }
 
-static const char *GetLowerLevelDirectoryRecord(const char *input)
+static void SetOffset(Item &item, Tag const &t, uint32_t offset)
 {
-  if( !input ) return NULL;
-
-  if( strcmp( input, "PATIENT " ) == 0 )
-    {
-    return "STUDY ";
-    }
-  else if( strcmp( input, "STUDY ") == 0 )
+  DataSet &ds = item.GetNestedDataSet();
+  if( t == Tag(0x4,0x1400) )
     {
-    return "SERIES";
-    }
-  else if( strcmp( input, "SERIES" ) == 0 )
-    {
-    return "IMAGE ";
-    }
-  else if( strcmp( input, "IMAGE " ) == 0 )
-    {
-    return NULL;
-    }
-  assert( 0 );
-  //std::cerr << "COULD NOT FIND:" << input << std::endl;
-  return NULL;
-}
-
-
-DICOMDIRGenerator::MyPair DICOMDIRGenerator::GetReferenceValueForDirectoryType(size_t itemidx)
-{
-  /*
-   * PS 3.11 - 2008 / D.3.3 Directory Information in DICOMDIR
-   * The Patient ID at the patient level shall be unique for each patient directory record in one File Set.
-  */
-  /*
-   * This function will return the Patient ID when directorytype          == "PATIENT"
-   * This function will return the Study Instance UID when directorytype  == "STUDY"
-   * This function will return the Series Instance UID when directorytype == "SERIES"
-   * This function will return the SOP Instance UID when directorytype    == "IMAGE"
-   */
-  MyPair ret;
-  const SequenceOfItems *sqi = GetDirectoryRecordSequence();
-  const Item &item = sqi->GetItem(itemidx);
-  const DataSet &ds = item.GetNestedDataSet();
-  Attribute<0x4,0x1430> directoryrecordtype;
-  directoryrecordtype.Set( ds );
-
-  const char *input = directoryrecordtype.GetValue();
-  assert( input );
-
-  if( strcmp( input, "PATIENT " ) == 0 )
-    {
-    Attribute<0x10,0x20> patientid;
-    patientid.Set( ds );
-    assert( patientid.GetValue() );
-    ret.first = patientid.GetValue();
-    ret.second = patientid.GetTag();
-    }
-  else if( strcmp( input, "STUDY ") == 0 )
-    {
-    Attribute <0x20,0xd> studyuid;
-    studyuid.Set( ds );
-    assert( studyuid.GetValue() );
-    ret.first = studyuid.GetValue();
-    ret.second = studyuid.GetTag();
-    }
-  else if( strcmp( input, "SERIES" ) == 0 )
-    {
-    Attribute <0x20,0xe> seriesuid;
-    seriesuid.Set( ds );
-    assert( seriesuid.GetValue() );
-    ret.first = seriesuid.GetValue();
-    ret.second = seriesuid.GetTag();
-    }
-  else if( strcmp( input, "IMAGE " ) == 0 )
-    {
-    Attribute <0x04,0x1511> sopuid;
-    sopuid.Set( ds );
-    assert( sopuid.GetValue() );
-    ret.first = sopuid.GetValue();
-    ret.second = Tag(0x8,0x18); // watch out !
-    }
-  else
-    {
-    assert( 0 );
-    }
-  return ret;
-}
-
-static Tag GetParentTag(Tag const &t)
-{
-  Tag ret;
-  if( t == Tag(0x8,0x18) )
-    {
-    ret = Tag(0x20,0xe);
-    }
-  else if( t == Tag(0x20,0xe) )
-    {
-    ret = Tag(0x20,0xd);
-    }
-  else if( t == Tag(0x20,0xd) )
-    {
-    ret = Tag(0x10,0x20);
-    }
-  else if( t == Tag(0x10,0x20) )
-    {
-    ret = Tag(0x0,0x0);
+    Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
+    offsetofthenextdirectoryrecord.SetValue( offset );
+    ds.Replace( offsetofthenextdirectoryrecord.GetAsDataElement() );
     }
   else
     {
-    assert( 0 );
+    Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
+    offsetofreferencedlowerleveldirectoryentity.SetValue( offset );
+    ds.Replace( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
     }
-  return ret;
 }
 
-bool DICOMDIRGenerator::SeriesBelongToStudy(const char *seriesuid, const char *studyuid)
+/*
+ * The records of a type are contiguous (all the patients, then all the
+ * studies...). The next record of a record is the following one of the same
+ * type with the same parent, its lower level record is the first one of the
+ * next type whose parent it is.
+ */
+bool DICOMDIRGenerator::TraverseDirectoryRecords(VL start )
 {
-  assert( seriesuid );
-  assert( studyuid );
-  const Scanner &scanner = GetScanner();
-
-  Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(Tag(0x20,0xe), seriesuid);
-  Tag tstudyuid(0x20,0xd);
-  bool b = false;
-  if( ttv.find( tstudyuid ) != ttv.end() )
-    {
-    const char *v = ttv.find(tstudyuid)->second;
-    if( v && strcmp(v, studyuid ) == 0 )
-      {
-      b = true;
-      }
-    }
-
-  return b;
-}
+  SequenceOfItems *sqi = GetDirectoryRecordSequence();
 
-bool DICOMDIRGenerator::ImageBelongToSeries(const char *sopuid, const char *seriesuid, Tag const &t1, Tag const &t2)
-{
-  assert( seriesuid );
-  assert( sopuid );
-  const Scanner &scanner = GetScanner();
+  ComputeDirectoryRecordsOffset(sqi, start);
 
-  Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(t1, sopuid);
-  bool b = false;
-  if( ttv.find( t2 ) != ttv.end() )
+  typedef std::vector<DICOMDIRGeneratorInternal::Record> RecordsType;
+  RecordsType const &records = Internals->Records;
+  std::vector<uint32_t> const &offsets = Internals->OffsetTable;
+  assert( records.size() == sqi->GetNumberOfItems() );
+  size_t upper = 0; // first record of the previous type
+  for( size_t begin = 0; begin < records.size(); )
     {
-    const char *v = ttv.find(t2)->second;
-    if( v && strcmp(v, seriesuid) == 0 )
+    size_t end = begin;
+    while( end < records.size() && strcmp( records[end].Type, records[begin].Type ) == 0 )
       {
-      b = true;
+      ++end;
       }
-    }
-
-  return b;
-}
-
-bool DICOMDIRGenerator::ImageBelongToSameSeries(const char *sopuid1, const char *sopuid2, Tag const &t)
-{
-  assert( sopuid1 );
-  assert( sopuid2 );
-  const Scanner &scanner = GetScanner();
-
-  Scanner::TagToValue const &ttv1 = scanner.GetMappingFromTagToValue(t, sopuid1);
-  Scanner::TagToValue const &ttv2 = scanner.GetMappingFromTagToValue(t, sopuid2);
-  Tag tseriesuid = GetParentTag( t );
-  if( tseriesuid == Tag(0x0,0x0) )
-    {
-    // Let's pretend that Patient belong to the same 'root' element:
-    return true;
-    }
-  bool b = false;
-  const char *seriesuid1 = NULL;
-  if( ttv1.find( tseriesuid ) != ttv1.end() )
-    {
-    seriesuid1 = ttv1.find(tseriesuid)->second;
-    }
-  const char *seriesuid2 = NULL;
-  if( ttv2.find( tseriesuid ) != ttv2.end() )
-    {
-    seriesuid2 = ttv2.find(tseriesuid)->second;
-    }
-  assert( seriesuid1 );
-  assert( seriesuid2 );
 
-  b = strcmp( seriesuid1, seriesuid2) == 0;
-  return b;
-}
-
-size_t DICOMDIRGenerator::FindLowerLevelDirectoryRecord( size_t item1, const char *directorytype )
-{
-//  return FindNextDirectoryRecord( item1, GetLowerLevelDirectoryRecord( directorytype ) );
-  const char *lowerdirectorytype = GetLowerLevelDirectoryRecord( directorytype );
-  if( !lowerdirectorytype ) return 0;
-
-  const SequenceOfItems *sqi = GetDirectoryRecordSequence();
-  gdcm::SequenceOfItems::SizeType nitems = sqi->GetNumberOfItems();
-  for(gdcm::SequenceOfItems::SizeType i = item1 + 1; i <= nitems; ++i)
-    {
-    const Item &item = sqi->GetItem(i);
-    const DataSet &ds = item.GetNestedDataSet();
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.Set( ds );
-
-    // found a match ?
-    if( strcmp( lowerdirectorytype, directoryrecordtype.GetValue() ) == 0 )
+    std::map<const char *, size_t> last; // last record of each parent
+    std::map<const char *, size_t> first; // first record of each parent
+    for( size_t i = begin; i < end; ++i )
       {
-      // Need to make sure belong to same parent record:
-      MyPair refval1 = GetReferenceValueForDirectoryType(item1);
-      MyPair refval2 = GetReferenceValueForDirectoryType(i);
-      bool b = ImageBelongToSeries(refval2.first.c_str(),
-        refval1.first.c_str(), refval2.second, refval1.second);
-      if( b ) return i;
+      const char *parent = records[i].Parent;
+      std::map<const char *, size_t>::iterator it = last.find( parent );
+      if( it != last.end() )
+        {
+        SetOffset( sqi->GetItem( it->second + 1 ), Tag(0x4,0x1400), offsets[i] );
+        it->second = i;
+        }
+      else
+        {
+        last.insert( std::make_pair( parent, i ) );
+        first.insert( std::make_pair( parent, i ) );
+        }
       }
-    //assert( strncmp( lowerdirectorytype, directoryrecordtype.GetValue(), strlen( lowerdirectorytype ) ) != 0 );
-    }
-
-  // Not found
-  return 0;
-
-}
-
-/*
- * Finding the next Directory Record type is easy, simply starting from the start and iterating
- * to the end guarantee travering everything without omitting anyone.
- *
- * TODO: Need to make sure that Series belong to the same Study...
- */
-size_t DICOMDIRGenerator::FindNextDirectoryRecord( size_t item1, const char *directorytype )
-{
-  if( !directorytype ) return 0;
-  const SequenceOfItems *sqi = GetDirectoryRecordSequence();
-  gdcm::SequenceOfItems::SizeType nitems = sqi->GetNumberOfItems();
-  for(gdcm::SequenceOfItems::SizeType i = item1 + 1; i <= nitems; ++i)
-    {
-    const Item &item = sqi->GetItem(i);
-    const DataSet &ds = item.GetNestedDataSet();
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.Set( ds );
-
-    // found a match ?
-    if( strcmp( directorytype, directoryrecordtype.GetValue() ) == 0 )
+    if( begin )
       {
-      // Need to make sure belong to same parent record:
-      MyPair refval1 = GetReferenceValueForDirectoryType(item1);
-      MyPair refval2 = GetReferenceValueForDirectoryType(i);
-      bool b = ImageBelongToSameSeries(refval1.first.c_str(), refval2.first.c_str(), refval1.second);
-      if( b ) return i;
+      for( size_t i = upper; i < begin; ++i )
+        {
+        std::map<const char *, size_t>::const_iterator it = first.find( records[i].Key );
+        if( it != first.end() )
+          {
+          SetOffset( sqi->GetItem( i + 1 ), Tag(0x4,0x1420), offsets[it->second] );
+          }
+        }
       }
-    //assert( strncmp( directorytype, directoryrecordtype.GetValue(), strlen( directorytype ) ) != 0 );
+    upper = begin;
+    begin = end;
     }
-
-  // Not found
-  return 0;
+  return true;
 }
 
-bool DICOMDIRGenerator::TraverseDirectoryRecords(VL start )
+Item &DICOMDIRGenerator::NewDirectoryRecord(SequenceOfItems &sqi, const char *type, const char *key,
+  Tag const &parent, const char *filename)
 {
-  SequenceOfItems *sqi = GetDirectoryRecordSequence();
-
-  ComputeDirectoryRecordsOffset(sqi, start);
-
-  gdcm::SequenceOfItems::SizeType nitems = sqi->GetNumberOfItems();
-  for(gdcm::SequenceOfItems::SizeType i = 1; i <= nitems; ++i)
+  DICOMDIRGeneratorInternal::Record record;
+  record.Type = type;
+  record.Key = key;
+  record.Parent = NULL;
+  if( parent != Tag(0x0,0x0) )
     {
-    Item &item = sqi->GetItem(i);
-    DataSet &ds = item.GetNestedDataSet();
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.Set( ds );
-    //std::cout << "FOUND DIRECTORY TYPE:" << directoryrecordtype.GetValue() << std::endl;
-    size_t next = FindNextDirectoryRecord( i, directoryrecordtype.GetValue() );
-    if( next )
+    Scanner::TagToValue const &ttv = GetScanner().GetMapping( filename );
+    Scanner::TagToValue::const_iterator it = ttv.find( parent );
+    if( it != ttv.end() )
       {
-      Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
-      offsetofthenextdirectoryrecord.SetValue( Internals->OffsetTable[ next - 1 ] );
-      ds.Replace( offsetofthenextdirectoryrecord.GetAsDataElement() );
-      }
-    size_t lower = FindLowerLevelDirectoryRecord( i, directoryrecordtype.GetValue() );
-    if( lower )
-      {
-      Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
-      offsetofreferencedlowerleveldirectoryentity.SetValue( Internals->OffsetTable[ lower - 1 ] );
-      ds.Replace( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
+      record.Parent = it->second;
       }
     }
-  return true;
+  Internals->Records.push_back( record );
+  // Generate sized the sequence, the record is built in place
+  if( sqi.GetNumberOfItems() < Internals->Records.size() )
+    {
+    sqi.SetNumberOfItems( Internals->Records.size() );
+    }
+  Item &item = sqi.GetItem( Internals->Records.size() );
+  item.SetVLToUndefined();
+  DataSet &ds = item.GetNestedDataSet();
+
+  // (0004,1400) up 0                                        #   4, 1 OffsetOfTheNextDirectoryRecord
+  // (0004,1410) US 65535                                    #   2, 1 RecordInUseFlag
+  // (0004,1420) up 502                                      #   4, 1 OffsetOfReferencedLowerLevelDirectoryEntity
+  // (0004,1430) CS [PATIENT]                                #   8, 1 DirectoryRecordType
+  Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
+  ds.Insert( offsetofthenextdirectoryrecord.GetAsDataElement() );
+  Attribute<0x4,0x1410> recordinuseflag = {0xFFFF};
+  ds.Insert( recordinuseflag.GetAsDataElement() );
+  Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
+  ds.Insert( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
+  Attribute<0x4,0x1430> directoryrecordtype;
+  directoryrecordtype.SetValue( type );
+  ds.Insert( directoryrecordtype.GetAsDataElement() );
+  return item;
 }
 
 template<uint16_t Group, uint16_t Element>
@@ -387,46 +266,29 @@ bool DICOMDIRGenerator::AddPatientDirectoryRecord()
   gdcm::Scanner const & scanner = GetScanner();
 
   Attribute<0x10,0x20> patientid;
-  gdcm::Scanner::ValuesType patientids = scanner.GetValues( patientid.GetTag() );
-  //unsigned int npatients = patientids.size();
 
   const gdcm::DataElement &de = rootds.GetDataElement( Tag(0x4,0x1220) );
   //SequenceOfItems * sqi = (SequenceOfItems*)de.GetSequenceOfItems();
   SmartPointer<SequenceOfItems> sqi = de.GetValueAsSQ();
 
-  gdcm::Scanner::ValuesType::const_iterator it = patientids.begin();
-  for( ; it  != patientids.end(); ++it)
+  DICOMDIRGeneratorInternal::FirstFileType::const_iterator it = Internals->Patients.begin();
+  for( ; it  != Internals->Patients.end(); ++it)
     {
-    Item item;
-    item.SetVLToUndefined();
-    DataSet &ds = item.GetNestedDataSet();
-
-    // (0004,1400) up 0                                        #   4, 1 OffsetOfTheNextDirectoryRecord
-    // (0004,1410) US 65535                                    #   2, 1 RecordInUseFlag
-    // (0004,1420) up 502                                      #   4, 1 OffsetOfReferencedLowerLevelDirectoryEntity
-    // (0004,1430) CS [PATIENT]                                #   8, 1 DirectoryRecordType
-    Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
-    ds.Insert( offsetofthenextdirectoryrecord.GetAsDataElement() );
-    Attribute<0x4,0x1410> recordinuseflag = {0xFFFF};
-    ds.Insert( recordinuseflag.GetAsDataElement() );
-    Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
-    ds.Insert( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.SetValue( "PATIENT" );
-    ds.Insert( directoryrecordtype.GetAsDataElement() );
-    const char *pid = it->c_str();
+    const char *pid = it->first;
     if( ! (pid && *pid) )
       {
-      const char *fn = scanner.GetFilenameFromTagToValue(patientid.GetTag(), pid);
+      const char *fn = it->second;
       gdcmErrorMacro( "Missing Patient ID from file: " << fn );
       (void)fn; //warning removal
       return false;
       }
     gdcmAssertAlwaysMacro( pid && *pid );
+    Item &item = NewDirectoryRecord( *sqi, "PATIENT", pid, Tag(0x0,0x0), it->second );
+    DataSet &ds = item.GetNestedDataSet();
     patientid.SetValue( pid );
     ds.Insert( patientid.GetAsDataElement() );
 
-    gdcm::Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(patientid.GetTag(), pid);
+    gdcm::Scanner::TagToValue const &ttv = scanner.GetMapping(it->second);
     Attribute<0x10,0x10> patientsname;
     if( ttv.find( patientsname.GetTag() ) != ttv.end() )
       {
@@ -438,8 +300,6 @@ bool DICOMDIRGenerator::AddPatientDirectoryRecord()
     //SingleDataElementInserter<0x10,0x20>(ds, scanner);
     //SingleDataElementInserter<0x10,0x30>(ds, scanner);
     //SingleDataElementInserter<0x10,0x40>(ds, scanner);
-
-    sqi->AddItem( item );
     }
 
   return true;
@@ -466,37 +326,25 @@ bool DICOMDIRGenerator::AddStudyDirectoryRecord()
   gdcm::Scanner const & scanner = GetScanner();
 
   Attribute<0x20,0xd> studyinstanceuid;
-  gdcm::Scanner::ValuesType studyinstanceuids = scanner.GetValues( studyinstanceuid.GetTag() );
 
   const gdcm::DataElement &de = rootds.GetDataElement( Tag(0x4,0x1220) );
   //SequenceOfItems * sqi = (SequenceOfItems*)de.GetSequenceOfItems();
   SmartPointer<SequenceOfItems> sqi = de.GetValueAsSQ();
 
-  gdcm::Scanner::ValuesType::const_iterator it = studyinstanceuids.begin();
-  for( ; it  != studyinstanceuids.end(); ++it)
+  DICOMDIRGeneratorInternal::FirstFileType::const_iterator it = Internals->Studies.begin();
+  for( ; it  != Internals->Studies.end(); ++it)
     {
-    Item item;
-    item.SetVLToUndefined();
-    DataSet &ds = item.GetNestedDataSet();
-
-    Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
-    ds.Insert( offsetofthenextdirectoryrecord.GetAsDataElement() );
-    Attribute<0x4,0x1410> recordinuseflag = {0xFFFF};
-    ds.Insert( recordinuseflag.GetAsDataElement() );
-    Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
-    ds.Insert( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.SetValue( "STUDY" );
-    ds.Insert( directoryrecordtype.GetAsDataElement() );
-    const char *studyuid = it->c_str();
+    const char *studyuid = it->first;
     if( ! (studyuid && *studyuid) )
       {
-      const char *fn = scanner.GetFilenameFromTagToValue(studyinstanceuid.GetTag(), studyuid);
+      const char *fn = it->second;
       gdcmErrorMacro( "Missing Study Instance UID from file: " << fn );
       (void)fn;//warning removal
       return false;
       }
     gdcmAssertAlwaysMacro( studyuid && *studyuid );
+    Item &item = NewDirectoryRecord( *sqi, "STUDY", studyuid, Tag(0x10,0x20), it->second );
+    DataSet &ds = item.GetNestedDataSet();
     studyinstanceuid.SetValue( studyuid );
     ds.Insert( studyinstanceuid.GetAsDataElement() );
 
@@ -506,7 +354,7 @@ bool DICOMDIRGenerator::AddStudyDirectoryRecord()
     //SingleDataElementInserter<0x8,0x1030>(ds, scanner);
     //SingleDataElementInserter<0x8,0x50>(ds, scanner);
     //SingleDataElementInserter<0x20,0x10>(ds, scanner);
-    gdcm::Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(studyinstanceuid.GetTag(), studyuid);
+    gdcm::Scanner::TagToValue const &ttv = scanner.GetMapping(it->second);
 
     Attribute<0x8,0x20> studydate;
     if( ttv.find( studydate.GetTag() ) != ttv.end() )
@@ -538,8 +386,6 @@ bool DICOMDIRGenerator::AddStudyDirectoryRecord()
       studyid.SetValue( ttv.find(studyid.GetTag())->second );
       ds.Insert( studyid.GetAsDataElement() );
       }
-
-    sqi->AddItem( item );
     }
 
   return true;
@@ -567,41 +413,29 @@ bool DICOMDIRGenerator::AddSeriesDirectoryRecord()
   gdcm::Scanner const & scanner = GetScanner();
 
   Attribute<0x20,0xe> seriesinstanceuid;
-  gdcm::Scanner::ValuesType seriesinstanceuids = scanner.GetValues( seriesinstanceuid.GetTag() );
 
   const gdcm::DataElement &de = rootds.GetDataElement( Tag(0x4,0x1220) );
   //SequenceOfItems * sqi = (SequenceOfItems*)de.GetSequenceOfItems();
   SmartPointer<SequenceOfItems> sqi = de.GetValueAsSQ();
 
-  gdcm::Scanner::ValuesType::const_iterator it = seriesinstanceuids.begin();
-  for( ; it  != seriesinstanceuids.end(); ++it)
+  DICOMDIRGeneratorInternal::FirstFileType::const_iterator it = Internals->Series.begin();
+  for( ; it  != Internals->Series.end(); ++it)
     {
-    Item item;
-    item.SetVLToUndefined();
-    DataSet &ds = item.GetNestedDataSet();
-
-    Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
-    ds.Insert( offsetofthenextdirectoryrecord.GetAsDataElement() );
-    Attribute<0x4,0x1410> recordinuseflag = {0xFFFF};
-    ds.Insert( recordinuseflag.GetAsDataElement() );
-    Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
-    ds.Insert( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.SetValue( "SERIES" );
-    ds.Insert( directoryrecordtype.GetAsDataElement() );
-    const char *seriesuid = it->c_str();
+    const char *seriesuid = it->first;
     if( ! (seriesuid && *seriesuid) )
       {
-      const char *fn = scanner.GetFilenameFromTagToValue(seriesinstanceuid.GetTag(), seriesuid);
+      const char *fn = it->second;
       gdcmErrorMacro( "Missing Study Instance UID from file: " << fn );
       (void)fn;//warning removal
       return false;
       }
     gdcmAssertAlwaysMacro( seriesuid && *seriesuid );
+    Item &item = NewDirectoryRecord( *sqi, "SERIES", seriesuid, Tag(0x20,0xd), it->second );
+    DataSet &ds = item.GetNestedDataSet();
     seriesinstanceuid.SetValue( seriesuid );
     ds.Insert( seriesinstanceuid.GetAsDataElement() );
 
-    gdcm::Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(seriesinstanceuid.GetTag(), seriesuid);
+    gdcm::Scanner::TagToValue const &ttv = scanner.GetMapping(it->second);
     Attribute<0x8,0x60> modality;
     if( ttv.find( modality.GetTag() ) != ttv.end() )
       {
@@ -614,8 +448,6 @@ bool DICOMDIRGenerator::AddSeriesDirectoryRecord()
       seriesnumber.SetValue( atoi(ttv.find(seriesnumber.GetTag())->second) );
       ds.Insert( seriesnumber.GetAsDataElement() );
       }
-
-    sqi->AddItem( item );
     }
 
   return true;
@@ -645,37 +477,24 @@ bool DICOMDIRGenerator::AddImageDirectoryRecord()
   gdcm::Scanner const & scanner = GetScanner();
 
   const Attribute<0x8,0x18> sopinstanceuid = { "" };
-  gdcm::Scanner::ValuesType sopinstanceuids = scanner.GetValues( sopinstanceuid.GetTag() );
-  //unsigned int ninstance = sopinstanceuids.size();
 
   const gdcm::DataElement &de = rootds.GetDataElement( Tag(0x4,0x1220) );
   //SequenceOfItems * sqi = (SequenceOfItems*)de.GetSequenceOfItems();
   SmartPointer<SequenceOfItems> sqi = de.GetValueAsSQ();
 
-  gdcm::Scanner::ValuesType::const_iterator it = sopinstanceuids.begin();
+  DICOMDIRGeneratorInternal::FirstFileType::const_iterator it = Internals->Images.begin();
   gdcm::Filename rootdir = Internals->rootdir.c_str();
   const char *rd = rootdir.ToWindowsSlashes();
   size_t strlen_rd = strlen( rd );
-  for( ; it  != sopinstanceuids.end(); ++it)
+  for( ; it  != Internals->Images.end(); ++it)
     {
-    Item item;
-    item.SetVLToUndefined();
+    const char *sopuid = it->first;
+    const char *fn_str = it->second;
+    Item &item = NewDirectoryRecord( *sqi, "IMAGE", sopuid, Tag(0x20,0xe), fn_str );
     DataSet &ds = item.GetNestedDataSet();
 
-    Attribute<0x4,0x1400> offsetofthenextdirectoryrecord = {0};
-    ds.Insert( offsetofthenextdirectoryrecord.GetAsDataElement() );
-    Attribute<0x4,0x1410> recordinuseflag = {0xFFFF};
-    ds.Insert( recordinuseflag.GetAsDataElement() );
-    Attribute<0x4,0x1420> offsetofreferencedlowerleveldirectoryentity = {0};
-    ds.Insert( offsetofreferencedlowerleveldirectoryentity.GetAsDataElement() );
-    Attribute<0x4,0x1430> directoryrecordtype;
-    directoryrecordtype.SetValue( "IMAGE" );
-    ds.Insert( directoryrecordtype.GetAsDataElement() );
-
-    const char *sopuid = it->c_str();
-    gdcm::Scanner::TagToValue const &ttv = scanner.GetMappingFromTagToValue(sopinstanceuid.GetTag(), sopuid);
+    gdcm::Scanner::TagToValue const &ttv = scanner.GetMapping(fn_str);
     Attribute<0x0004,0x1500> referencedfileid;
-    const char *fn_str = scanner.GetFilenameFromTagToValue(sopinstanceuid.GetTag(), sopuid);
     referencedfileid.SetNumberOfValues( 1 );
     gdcm::Filename fn = fn_str;
     std::string relative = fn.ToWindowsSlashes();
@@ -732,8 +551,6 @@ bool DICOMDIRGenerator::AddImageDirectoryRecord()
       de2.SetByteValue( v, strlenV );
       }
     ds.Insert( de2 );
-
-    sqi->AddItem( item );
     }
 
   return true;
@@ -873,10 +690,12 @@ bool DICOMDIRGenerator::Generate()
     }
 }
 
+  scanner.SetNumberOfThreads( Internals->NumberOfThreads );
   if( !scanner.Scan( filenames ) )
     {
     return false;
     }
+  Internals->Index();
 
   //scanner.Print( std::cout );
 
@@ -925,6 +744,12 @@ bool DICOMDIRGenerator::Generate()
 
   ds.Insert( de_drs );
 
+  const size_t nrecords = Internals->Patients.size() + Internals->Studies.size()
+    + Internals->Series.size() + Internals->Images.size();
+  Internals->Records.clear();
+  Internals->Records.reserve( nrecords );
+  sqi0->SetNumberOfItems( nrecords );
+
   bool b;
   b = AddPatientDirectoryRecord();
   if( !b ) return false;
@@ -1055,4 +880,14 @@ void DICOMDIRGenerator::SetDescriptor( const char *d )
   Internals->FileSetID = d;
 }
 
+void DICOMDIRGenerator::SetNumberOfThreads(unsigned int n)
+{
+  Internals->NumberOfThreads = n;
+}
+
+unsigned int DICOMDIRGenerator::GetNumberOfThreads() const
+{
+  return Internals->NumberOfThreads;
+}
+
 } // end namespace gdcm
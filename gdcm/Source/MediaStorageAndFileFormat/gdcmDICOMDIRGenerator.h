@@ -21,6 +21,7 @@
 namespace gdcm
 {
 class File;
+class Item;
 class Scanner;
 class SequenceOfItems;
 class VL;
@@ -52,6 +53,13 @@ class DICOMDIRGeneratorInternal;
  * There is a current limitation of not handling Referenced SOP Class UID /
  * Referenced SOP Instance UID simply because the gdcm::Scanner does not allow us
  * See PS 3.11 / Table D.3-2 STD-GEN Additional DICOMDIR Keys
+ *
+ * \note
+ * The headers are read on several threads (see SetNumberOfThreads). The
+ * records are then linked through an index of the first file holding each
+ * Patient ID, Study, Series and SOP Instance UID, so that the generation time
+ * grows as n log n with the number of files. The output does not depend on
+ * the number of threads.
  */
 class GDCM_EXPORT DICOMDIRGenerator
 {
@@ -71,6 +79,11 @@ public:
   /// \warning this need to be a valid VR::CS value
   void SetDescriptor( const char *d );
 
+  /// Number of threads reading the files (calling thread included), 0
+  /// (default) means the number of processors
+  void SetNumberOfThreads(unsigned int n);
+  unsigned int GetNumberOfThreads() const;
+
   /// Main function to generate the DICOMDIR
   bool Generate();
 
@@ -89,14 +102,9 @@ private:
   const char *ComputeFileID(const char *);
   bool TraverseDirectoryRecords(VL start );
   bool ComputeDirectoryRecordsOffset(const SequenceOfItems *sqi, VL start);
-  size_t FindNextDirectoryRecord( size_t item1, const char *directorytype );
   SequenceOfItems *GetDirectoryRecordSequence();
-  size_t FindLowerLevelDirectoryRecord( size_t item1, const char *directorytype );
-  typedef std::pair< std::string, Tag> MyPair;
-  MyPair GetReferenceValueForDirectoryType(size_t item);
-  bool SeriesBelongToStudy(const char *seriesuid, const char *studyuid);
-  bool ImageBelongToSeries(const char *sopuid, const char *seriesuid, Tag const &t1, Tag const &t2);
-  bool ImageBelongToSameSeries(const char *sopuid, const char *seriesuid, Tag const &t);
+  Item &NewDirectoryRecord(SequenceOfItems &sqi, const char *type, const char *key, Tag const &parent,
+    const char *filename);
 
   DICOMDIRGeneratorInternal * Internals;
 };
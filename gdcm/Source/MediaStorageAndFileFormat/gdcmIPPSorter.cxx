@@ -16,8 +16,10 @@
 #include "gdcmElement.h"
 #include "gdcmDirectionCosines.h"
 
-#include <map>
+#include <algorithm>
+#include <sstream>
 #include <math.h>
+#include <stdlib.h>
 
 namespace gdcm
 {
@@ -26,6 +28,7 @@ IPPSorter::IPPSorter()
 {
   ComputeZSpacing = true;
   DropDuplicatePositions = false;
+  KeepDuplicatePositions = false;
   ZSpacing = 0;
   ZTolerance = 1e-6;
   DirCosTolerance = 0.;
@@ -37,10 +40,52 @@ inline double spacing_round(double n, int d) /* pow is defined as pow( double, d
   return floor(n * pow(10., d) + .5) / pow(10., d);
 }
 
+namespace {
+// What a file is sorted on
+struct IPPSortKey
+{
+  double Position;        // along the normal
+  double AcquisitionTime; // seconds since midnight
+  long InstanceNumber;
+  size_t Index;           // in the input, for a stable order
+  bool operator<(IPPSortKey const &k) const
+    {
+    if( Position != k.Position ) return Position < k.Position;
+    if( AcquisitionTime != k.AcquisitionTime ) return AcquisitionTime < k.AcquisitionTime;
+    if( InstanceNumber != k.InstanceNumber ) return InstanceNumber < k.InstanceNumber;
+    return Index < k.Index;
+    }
+};
+
+// TM: HHMMSS.FFFFFF (or the ACR-NEMA HH:MM:SS.FFFFFF), 0 when empty
+double TimeToSeconds(const char *value)
+{
+  if( !value ) return 0;
+  double t = 0;
+  int ndigits = 0;
+  const double scale[3] = { 3600, 60, 1 };
+  int hms[3] = { 0, 0, 0 };
+  const char *p = value;
+  for( ; *p && *p != '.' && ndigits < 6; ++p )
+    {
+    if( *p < '0' || *p > '9' ) continue;
+    hms[ndigits / 2] = 10 * hms[ndigits / 2] + (*p - '0');
+    ++ndigits;
+    }
+  for( int i = 0; i < 3; ++i ) t += scale[i] * hms[i];
+  if( *p == '.' )
+    {
+    double f = 0.1;
+    for( ++p; *p >= '0' && *p <= '9'; ++p, f /= 10 ) t += f * (*p - '0');
+    }
+  return t;
+}
+}
+
 bool IPPSorter::Sort(std::vector<std::string> const & filenames)
 {
-  // BUG: I cannot clear Filenames since input filenames could also be the output of ourself...
-  // Filenames.clear();
+  // Filenames is only replaced at the end: input filenames could also be the
+  // output of ourself
   ZSpacing = 0;
   if( filenames.empty() )
     {
@@ -52,11 +97,19 @@ bool IPPSorter::Sort(std::vector<std::string> const & filenames)
   const Tag tipp(0x0020,0x0032); // Image Position (Patient)
   const Tag tiop(0x0020,0x0037); // Image Orientation (Patient)
   const Tag tframe(0x0020,0x0052); // Frame of Reference UID
+  const Tag tacquisitiontime(0x0008,0x0032); // Acquisition Time
+  const Tag tinstance(0x0020,0x0013); // Instance Number
   // Temporal Position Identifier (0020,0100) 3 Temporal order of a dynamic or functional set of Images.
   //const Tag tpi(0x0020,0x0100);
   scanner.AddTag( tipp );
   scanner.AddTag( tiop );
   scanner.AddTag( tframe );
+  if( KeepDuplicatePositions )
+    {
+    scanner.AddTag( tacquisitiontime );
+    scanner.AddTag( tinstance );
+    }
+  scanner.SetNumberOfThreads( NumberOfThreads );
   bool b = scanner.Scan( filenames );
   if( !b )
     {
@@ -128,15 +181,15 @@ bool IPPSorter::Sort(std::vector<std::string> const & filenames)
   // You only have to do this once for all slices in the volume. Next, for
   // each slice, calculate the distance along the slice normal using the IPP
   // tag ("dist" is initialized to zero before reading the first slice) :
-  //typedef std::multimap<double, const char*> SortedFilenames;
-  typedef std::map<double, const char*> SortedFilenames;
-  SortedFilenames sorted;
+  std::vector<IPPSortKey> keys;
+  keys.reserve( filenames.size() );
 {
-  std::vector<std::string>::const_iterator it1 = filenames.begin();
   DirectionCosines dc2;
-  for(; it1 != filenames.end(); ++it1)
+  Element<VR::DS,VM::VM3> ipp;
+  std::istringstream ss;
+  for( size_t i = 0; i < filenames.size(); ++i )
     {
-    const char *filename = it1->c_str();
+    const char *filename = filenames[i].c_str();
     bool iskey = scanner.IsKey(filename);
     if( iskey )
       {
@@ -164,26 +217,22 @@ bool IPPSorter::Sort(std::vector<std::string> const & filenames)
           //dc2.Print( std::cout << std::endl );
           }
         //gdcmDebugMacro( filename << " has " << ipp << " = " << value );
-        Element<VR::DS,VM::VM3> ipp;
-        std::stringstream ss;
+        ss.clear();
         ss.str( value );
         ipp.Read( ss );
-        double dist = 0;
-        for (int i = 0; i < 3; ++i) dist += normal[i]*ipp[i];
-        // FIXME: This test is weak, since implicitely we are doing a != on floating point value
-        if( sorted.find(dist) != sorted.end() )
+        IPPSortKey key;
+        key.Position = 0;
+        for (int j = 0; j < 3; ++j) key.Position += normal[j]*ipp[j];
+        key.AcquisitionTime = 0;
+        key.InstanceNumber = 0;
+        if( KeepDuplicatePositions )
           {
-            if( this->DropDuplicatePositions )
-            {
-              gdcmWarningMacro( "dropping file " << filename << " since Z position: " << dist << " already found" );
-              continue;
-            }
-            gdcmWarningMacro( "dist: " << dist << " for " << filename <<
-              " already found in " << sorted.find(dist)->second );
-            return false;
+          key.AcquisitionTime = TimeToSeconds( scanner.GetValue(filename, tacquisitiontime) );
+          const char *instance = scanner.GetValue(filename, tinstance);
+          key.InstanceNumber = instance ? atol( instance ) : 0;
           }
-        sorted.insert(
-          SortedFilenames::value_type(dist,filename) );
+        key.Index = i;
+        keys.push_back( key );
         }
       else
         {
@@ -196,30 +245,65 @@ bool IPPSorter::Sort(std::vector<std::string> const & filenames)
       }
     }
 }
-  assert( !sorted.empty() );
-{
-  SortedFilenames::const_iterator it2 = sorted.begin();
-  double prev = it2->first;
-  Filenames.push_back( it2->second );
-  if( sorted.size() > 1 )
+  if( keys.empty() )
+    {
+    gdcmDebugMacro( "No file with an Image Position (Patient)" );
+    return false;
+    }
+  std::sort( keys.begin(), keys.end() );
+
+  // Same position: the first file given (or the first acquired) comes first
+  // FIXME: This test is weak, since implicitely we are doing a != on floating point value
+  if( !KeepDuplicatePositions )
     {
-    bool spacingisgood = true;
-    ++it2;
-    double current = it2->first;
-    double zspacing = current - prev;
-    for( ; it2 != sorted.end(); ++it2)
+    std::vector<IPPSortKey>::iterator last = keys.begin();
+    for( std::vector<IPPSortKey>::const_iterator k = keys.begin() + 1; k != keys.end(); ++k )
       {
-      //std::cout << it2->first << " " << it2->second << std::endl;
-      current = it2->first;
-      Filenames.push_back( it2->second );
-      if( fabs((current - prev) - zspacing) > ZTolerance )
+      if( k->Position == last->Position )
         {
-        gdcmDebugMacro( "ZTolerance test failed. You need to decrease ZTolerance." );
-        spacingisgood = false;
+        if( this->DropDuplicatePositions )
+          {
+          gdcmWarningMacro( "dropping file " << filenames[k->Index] << " since Z position: " << k->Position << " already found" );
+          continue;
+          }
+        gdcmWarningMacro( "dist: " << k->Position << " for " << filenames[k->Index] <<
+          " already found in " << filenames[last->Index] );
+        return false;
         }
-      // update prev for the next for-loop
-      prev = current;
+      *++last = *k;
       }
+    keys.erase( last + 1, keys.end() );
+    }
+
+{
+  std::vector<std::string> sorted;
+  sorted.reserve( keys.size() );
+  std::vector<IPPSortKey>::const_iterator it2 = keys.begin();
+  double prev = it2->Position;
+  bool spacingisgood = true;
+  bool hasspacing = false;
+  double zspacing = 0;
+  for( ; it2 != keys.end(); ++it2)
+    {
+    //std::cout << it2->Position << " " << filenames[it2->Index] << std::endl;
+    sorted.push_back( filenames[it2->Index] );
+    const double current = it2->Position;
+    if( current == prev ) continue; // first file, or one more volume
+    if( !hasspacing )
+      {
+      zspacing = current - prev;
+      hasspacing = true;
+      }
+    else if( fabs((current - prev) - zspacing) > ZTolerance )
+      {
+      gdcmDebugMacro( "ZTolerance test failed. You need to decrease ZTolerance." );
+      spacingisgood = false;
+      }
+    // update prev for the next for-loop
+    prev = current;
+    }
+  if( hasspacing )
+    {
     // is spacing good ?
     if( spacingisgood && ComputeZSpacing )
       {
@@ -233,23 +317,24 @@ bool IPPSorter::Sort(std::vector<std::string> const & filenames)
       std::ostringstream os;
       os << "Filenames and 'z' positions" << std::endl;
       double prev1 = 0.;
-      for(SortedFilenames::const_iterator it1 = sorted.begin(); it1 != sorted.end(); ++it1)
+      for(std::vector<IPPSortKey>::const_iterator it1 = keys.begin(); it1 != keys.end(); ++it1)
         {
-        std::string f = it1->second;
+        std::string f = filenames[it1->Index];
         if( f.length() > 32 )
           {
           f = f.substr(0,10) + " ... " + f.substr(f.length()-17);
           }
-        double d = it1->first - prev1;
-        if( it1 != sorted.begin() && fabs(d - zspacing) > ZTolerance) os << "* ";
+        double d = it1->Position - prev1;
+        if( it1 != keys.begin() && d != 0 && fabs(d - zspacing) > ZTolerance) os << "* ";
         else os << "  ";
-        os << it1->first << "\t" << f << std::endl;
-        prev1 = it1->first;
+        os << it1->Position << "\t" << f << std::endl;
+        prev1 = it1->Position;
         }
       gdcmDebugMacro( os.str() );
       }
     assert( spacingisgood == false ||  (ComputeZSpacing ? (ZSpacing > ZTolerance && ZTolerance > 0) : ZTolerance > 0) );
     }
+  Filenames.swap( sorted );
 }
 
   // return true: means sorting succeed, it does not mean spacing computation succeded !
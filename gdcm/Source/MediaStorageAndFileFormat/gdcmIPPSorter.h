@@ -26,7 +26,7 @@ namespace gdcm
  * Implement a simple Image Position (Patient) sorter, along the Image
  * Orientation (Patient) direction.
  * This algorithm does NOT support duplicate and will FAIL in case of duplicate
- * IPP.
+ * IPP (see SetDropDuplicatePositions and SetKeepDuplicatePositions).
  * \warning See special note for SetZSpacingTolerance when computing the
  * ZSpacing from the IPP of each DICOM files (default tolerance for consistent
  * spacing is: 1e-6mm)
@@ -36,6 +36,11 @@ namespace gdcm
  *
  * http://gdcm.sourceforge.net/wiki/index.php/Imager_Pixel_Spacing
  *
+ * Only the attributes sorted on are read, by a Scanner on
+ * GetNumberOfThreads() threads, and a few numbers are kept per file: series
+ * of hundreds of thousands of images are sorted in O(n log n) time and O(n)
+ * small memory.
+ *
  * \bug There are currently a couple of bugs in this implementation:
  * \li Gantry Tilt is not considered
  */
@@ -84,6 +89,13 @@ public:
   /// DropDuplicatePositions defaults to false.
   void SetDropDuplicatePositions(bool b) { DropDuplicatePositions = b; }
 
+  /// Makes the IPPSorter keep all the images located at the same position
+  /// (a series of several volumes, such as fMRI), ordered by Acquisition
+  /// Time (0008,0032) then Instance Number (0020,0013) at each position.
+  /// The Z-Spacing is then computed in between the distinct positions.
+  /// Takes precedence over SetDropDuplicatePositions, defaults to false.
+  void SetKeepDuplicatePositions(bool b) { KeepDuplicatePositions = b; }
+
   /// Read-only function to provide access to the computed value for the Z-Spacing
   /// The ComputeZSpacing must have been set to true before execution of
   /// sort algorithm. Call this function *after* calling Sort();
@@ -95,6 +107,7 @@ public:
 protected:
   bool ComputeZSpacing;
   bool DropDuplicatePositions;
+  bool KeepDuplicatePositions;
   double ZSpacing;
   double ZTolerance;
   double DirCosTolerance;
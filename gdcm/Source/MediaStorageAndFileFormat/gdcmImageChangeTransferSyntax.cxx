@@ -22,6 +22,10 @@
 #include "gdcmJPEGLSCodec.h"
 #include "gdcmJPEG2000Codec.h"
 #include "gdcmRLECodec.h"
+#include "gdcmThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace gdcm
 {
@@ -321,6 +325,246 @@ bool ImageChangeTransferSyntax::TryJPEG2000Codec(const DataElement &pixelde, Bit
   return false;
 }
 
+bool ImageChangeTransferSyntax::TryCodecs(const DataElement &pixelde, Bitmap const &input, Bitmap &output)
+{
+  bool success = false;
+  if( !success ) success = TryRAWCodec(pixelde, input, output);
+  if( !success ) success = TryJPEGCodec(pixelde, input, output);
+  if( !success ) success = TryJPEGLSCodec(pixelde, input, output);
+  if( !success ) success = TryJPEG2000Codec(pixelde, input, output);
+  if( !success ) success = TryRLECodec(pixelde, input, output);
+  return success;
+}
+
+namespace
+{
+// A single frame of a multi-frames image. It does not share its LUT nor its
+// Pixel Data with the image (SmartPointer reference counting is not thread
+// safe), and keeps the overlay information of the Pixmap.
+class FrameBitmap : public Bitmap
+{
+public:
+  FrameBitmap():Overlays(false) {}
+  void Setup(Bitmap const &image)
+    {
+    Bitmap::operator=( image );
+    Overlays = image.AreOverlaysInPixelData();
+    LUT = new LookupTable;
+    PixelData = DataElement( Tag(0x7fe0,0x0010) );
+    SetNumberOfDimensions( 2 );
+    }
+  bool AreOverlaysInPixelData() const { return Overlays; }
+  bool IsSameImage(Bitmap const &image) const
+    {
+    return PF == image.GetPixelFormat()
+      && PI == image.GetPhotometricInterpretation()
+      && PlanarConfiguration == image.GetPlanarConfiguration();
+    }
+private:
+  bool Overlays;
+};
+
+// Decompress (and compress) frame First + index
+class FrameTask : public ThreadPool::Task
+{
+public:
+  ImageChangeTransferSyntax *Filter;
+  bool (ImageChangeTransferSyntax::*Code)(const DataElement &, Bitmap const &, Bitmap &);
+  const Bitmap *Input;
+  const char *Raw; // decompressed frames, when not decompressing fragments
+  char *Output; // decompress only: output buffer of all the frames
+  unsigned long FrameLength;
+  unsigned int First;
+  bool Decode;
+  bool Encode;
+  std::vector<FrameBitmap> *Frames; // one per frame of the window
+  std::vector<char> Status;
+
+  enum { OK = 0, FAILED, MISMATCH };
+  void Execute(size_t index)
+    {
+    FrameBitmap &frame = (*Frames)[index];
+    const unsigned int f = First + (unsigned int)index;
+    char *buffer = Output ? Output + (size_t)f * FrameLength : 0;
+    SmartPointer<ByteValue> bv;
+    if( Encode )
+      {
+      bv = new ByteValue;
+      bv->SetLength( (uint32_t)FrameLength );
+      buffer = (char*)bv->GetPointer();
+      }
+    if( Decode )
+      {
+      if( !frame.GetBuffer( buffer ) )
+        {
+        Status[index] = FAILED;
+        return;
+        }
+      // The decoder fixed the header of the frame, the image would change
+      if( !frame.IsSameImage( *Input ) )
+        {
+        Status[index] = MISMATCH;
+        return;
+        }
+      }
+    else
+      {
+      memcpy(buffer, Raw + (size_t)f * FrameLength, FrameLength);
+      }
+    if( Encode )
+      {
+      DataElement pixeldata( Tag(0x7fe0,0x0010) );
+      pixeldata.SetValue( *bv );
+      if( !(Filter->*Code)( pixeldata, frame, frame ) )
+        {
+        Status[index] = FAILED;
+        return;
+        }
+      }
+    Status[index] = OK;
+    }
+};
+}
+
+// Transcode a multi-frames image one frame at a time on a ThreadPool.
+// Encapsulated inputs with one fragment per frame are decompressed frame by
+// frame, other inputs are decompressed beforehand. Return false when the
+// image cannot be processed this way, the caller should then use the single
+// threaded code path.
+bool ImageChangeTransferSyntax::ChangeFrames(bool decompress, bool &success)
+{
+  if( NumberOfThreads == 1 || UserCodec ) return false;
+  Bitmap &input = *Input;
+  if( input.GetNumberOfDimensions() != 3 || input.GetDimension(2) < 2 ) return false;
+  const unsigned int nframes = input.GetDimension(2);
+  const unsigned long len = input.GetBufferLength();
+  const unsigned long framelen = len / nframes;
+  if( !framelen ) return false;
+
+  const SequenceOfFragments *sf = input.GetDataElement().GetSequenceOfFragments();
+  const bool decode = decompress && input.GetTransferSyntax().IsEncapsulated()
+    && sf && sf->GetNumberOfFragments() == nframes;
+  const bool encode = TS.IsEncapsulated();
+  if( !decode && !encode ) return false;
+
+  // Decompress everything first when frames cannot be decompressed one by one
+  std::vector<char> decompressed;
+  const char *raw = 0;
+  if( !decode )
+    {
+    if( decompress )
+      {
+      decompressed.resize( len );
+      if( !input.GetBuffer( &decompressed[0] ) )
+        {
+        gdcmErrorMacro( "Error in getting buffer from input image." );
+        success = false;
+        return true;
+        }
+      raw = &decompressed[0];
+      }
+    else
+      {
+      const ByteValue *bv = input.GetDataElement().GetByteValue();
+      if( !bv || bv->GetLength() < len ) return false;
+      raw = bv->GetPointer();
+      }
+    }
+
+  ThreadPool pool( NumberOfThreads );
+  unsigned int window = FrameWindow ? FrameWindow : 2 * pool.GetNumberOfThreads();
+  // When decompressing only, frames are written to their final location, the
+  // window still bounds the frames being decompressed at once
+  SmartPointer<ByteValue> output;
+  if( !encode )
+    {
+    output = new ByteValue;
+    output->SetLength( (uint32_t)len );
+    }
+
+  FrameTask task;
+  task.Filter = this;
+  task.Code = &ImageChangeTransferSyntax::TryCodecs;
+  task.Input = &input;
+  task.Raw = raw;
+  task.Output = encode ? 0 : (char*)output->GetPointer();
+  task.FrameLength = framelen;
+  task.Decode = decode;
+  task.Encode = encode;
+  std::vector<FrameBitmap> frames;
+  task.Frames = &frames;
+
+  SmartPointer<SequenceOfFragments> sq = new SequenceOfFragments;
+  PhotometricInterpretation pi = input.GetPhotometricInterpretation();
+  unsigned int pc = input.GetPlanarConfiguration();
+  for( unsigned int first = 0; first < nframes; first += window )
+    {
+    const unsigned int n = std::min( window, nframes - first );
+    // Setup the frames here, Register/UnRegister are not thread safe
+    frames.resize( n );
+    for( unsigned int i = 0; i < n; ++i )
+      {
+      FrameBitmap &frame = frames[i];
+      frame.Setup( input );
+      if( decode )
+        {
+        SmartPointer<SequenceOfFragments> fsq = new SequenceOfFragments;
+        fsq->AddFragment( sf->GetFragment( first + i ) );
+        frame.GetDataElement().SetValue( *fsq );
+        }
+      }
+    task.First = first;
+    task.Status.assign( n, (char)FrameTask::OK );
+    pool.ParallelFor( task, n );
+
+    for( unsigned int i = 0; i < n; ++i )
+      {
+      if( task.Status[i] == FrameTask::MISMATCH )
+        {
+        // Let the single threaded code path update the image
+        return false;
+        }
+      if( task.Status[i] == FrameTask::FAILED )
+        {
+        success = false;
+        return true;
+        }
+      }
+    if( encode )
+      {
+      for( unsigned int i = 0; i < n; ++i )
+        {
+        const SequenceOfFragments *fsq = frames[i].GetDataElement().GetSequenceOfFragments();
+        if( !fsq || fsq->GetNumberOfFragments() != 1 )
+          {
+          gdcmErrorMacro( "Frame " << first + i << " was not compressed into a single fragment" );
+          success = false;
+          return true;
+          }
+        sq->AddFragment( fsq->GetFragment(0) );
+        }
+      pi = frames[0].GetPhotometricInterpretation();
+      pc = frames[0].GetPlanarConfiguration();
+      }
+    frames.clear();
+    }
+
+  if( encode )
+    {
+    Output->SetPlanarConfiguration( pc );
+    Output->SetPhotometricInterpretation( pi );
+    Output->GetDataElement().SetValue( *sq );
+    success = true;
+    }
+  else
+    {
+    DataElement pixeldata( Tag(0x7fe0,0x0010) );
+    pixeldata.SetValue( *output );
+    success = TryCodecs(pixeldata, *Input, *Output);
+    }
+  return true;
+}
+
 bool ImageChangeTransferSyntax::Change()
 {
   if( TS == TransferSyntax::TS_END )
@@ -358,25 +602,24 @@ bool ImageChangeTransferSyntax::Change()
     && Input->GetTransferSyntax() != TransferSyntax::ExplicitVRBigEndian)
     || Force )
     {
-    // In memory decompression:
-    gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
-    gdcm::ByteValue *bv0 = new gdcm::ByteValue();
-    uint32_t len0 = (uint32_t)Input->GetBufferLength();
-    bv0->SetLength( len0 );
-    bool b = Input->GetBuffer( (char*)bv0->GetPointer() );
-    if( !b )
+    bool success = false;
+    if( !ChangeFrames( true, success ) )
       {
-      gdcmErrorMacro( "Error in getting buffer from input image." );
-      return false;
-      }
-    pixeldata.SetValue( *bv0 );
+      // In memory decompression:
+      gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+      gdcm::ByteValue *bv0 = new gdcm::ByteValue();
+      uint32_t len0 = (uint32_t)Input->GetBufferLength();
+      bv0->SetLength( len0 );
+      bool b = Input->GetBuffer( (char*)bv0->GetPointer() );
+      if( !b )
+        {
+        gdcmErrorMacro( "Error in getting buffer from input image." );
+        return false;
+        }
+      pixeldata.SetValue( *bv0 );
 
-    bool success = false;
-    if( !success ) success = TryRAWCodec(pixeldata, *Input, *Output);
-    if( !success ) success = TryJPEGCodec(pixeldata, *Input, *Output);
-    if( !success ) success = TryJPEGLSCodec(pixeldata, *Input, *Output);
-    if( !success ) success = TryJPEG2000Codec(pixeldata, *Input, *Output);
-    if( !success ) success = TryRLECodec(pixeldata, *Input, *Output);
+      success = TryCodecs(pixeldata, *Input, *Output);
+      }
     Output->SetTransferSyntax( TS );
     if( !success )
       {
@@ -429,11 +672,14 @@ bool ImageChangeTransferSyntax::Change()
 
   // too bad we actually have to do some work...
   bool success = false;
-  if( !success ) success = TryRAWCodec(Input->GetDataElement(), *Input, *Output);
-  if( !success ) success = TryJPEGCodec(Input->GetDataElement(), *Input, *Output);
-  if( !success ) success = TryJPEG2000Codec(Input->GetDataElement(), *Input, *Output);
-  if( !success ) success = TryJPEGLSCodec(Input->GetDataElement(), *Input, *Output);
-  if( !success ) success = TryRLECodec(Input->GetDataElement(), *Input, *Output);
+  if( !ChangeFrames( false, success ) )
+    {
+    if( !success ) success = TryRAWCodec(Input->GetDataElement(), *Input, *Output);
+    if( !success ) success = TryJPEGCodec(Input->GetDataElement(), *Input, *Output);
+    if( !success ) success = TryJPEG2000Codec(Input->GetDataElement(), *Input, *Output);
+    if( !success ) success = TryJPEGLSCodec(Input->GetDataElement(), *Input, *Output);
+    if( !success ) success = TryRLECodec(Input->GetDataElement(), *Input, *Output);
+    }
   Output->SetTransferSyntax( TS );
   if( !success )
     {
@@ -34,12 +34,16 @@ class ImageCodec;
  * UserCodec->CanCode( TransferSyntax ) ). Otherwise the behavior is to use a
  * default codec.
  *
+ * Multi-frames images can be transcoded frame by frame on several threads (see
+ * SetNumberOfThreads): fragments are decompressed and compressed
+ * concurrently, and the Sequence of Fragments is re-assembled in order.
+ *
  * \sa JPEGCodec JPEGLSCodec JPEG2000Codec
  */
 class GDCM_EXPORT ImageChangeTransferSyntax : public ImageToImageFilter
 {
 public:
-  ImageChangeTransferSyntax():TS(TransferSyntax::TS_END),Force(false),CompressIconImage(false),UserCodec(0) {}
+  ImageChangeTransferSyntax():TS(TransferSyntax::TS_END),Force(false),CompressIconImage(false),UserCodec(0),NumberOfThreads(1),FrameWindow(0) {}
   ~ImageChangeTransferSyntax() {}
 
   /// Set target Transfer Syntax
@@ -67,6 +71,18 @@ public:
   /// that UserCodec->CanCode( TransferSyntax )
   void SetUserCodec(ImageCodec *ic) { UserCodec = ic; }
 
+  /// Number of threads used to transcode multi-frames images one frame at a
+  /// time. 1 (default) keeps everything in the calling thread, 0 means the
+  /// number of online processors. Not used together with a UserCodec.
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
+  /// Maximum number of frames being transcoded (or only decompressed) at
+  /// once, this bounds the memory used by the codecs. 0 (default) means twice
+  /// the number of threads.
+  void SetFrameWindow(unsigned int n) { FrameWindow = n; }
+  unsigned int GetFrameWindow() const { return FrameWindow; }
+
 protected:
   bool TryJPEGCodec(const DataElement &pixelde, Bitmap const &input, Bitmap &output);
   bool TryJPEG2000Codec(const DataElement &pixelde, Bitmap const &input, Bitmap &output);
@@ -75,11 +91,16 @@ protected:
   bool TryRLECodec(const DataElement &pixelde, Bitmap const &input, Bitmap &output);
 
 private:
+  bool TryCodecs(const DataElement &pixelde, Bitmap const &input, Bitmap &output);
+  bool ChangeFrames(bool decompress, bool &success);
+
   TransferSyntax TS;
   bool Force;
   bool CompressIconImage;
 
   ImageCodec *UserCodec;
+  unsigned int NumberOfThreads;
+  unsigned int FrameWindow;
 };
 
 /**
@@ -20,6 +20,11 @@
 #include "gdcmJPEG2000Codec.h"
 #include "gdcmJPEGCodec.h"
 #include "gdcmJPEGLSCodec.h"
+#include "gdcmBasicOffsetTable.h"
+#include "gdcmSequenceOfFragments.h"
+#include "gdcmByteSwap.h"
+
+#include <string.h> // memcpy
 
 namespace gdcm
 {
@@ -32,6 +37,9 @@ public:
     TheRegion = NULL;
     Modified = false;
     FileOffset = -1;
+    IndexState = 0;
+    NumberOfFrames = 0;
+    FirstFragment = 0;
     }
   ~ImageRegionReaderInternals()
     {
@@ -55,13 +63,139 @@ public:
   void SetFileOffset( std::streampos f )
     {
     FileOffset = f;
+    IndexState = 0;
+    Offsets.clear();
+    Fragments.clear();
     }
+
+  // position in the file and length of a Fragment value
+  typedef std::pair<std::streamoff, uint32_t> FragmentPosition;
+  typedef std::vector<FragmentPosition> FragmentPositions;
+
+  bool BuildIndex(std::istream &is, unsigned int nframes);
+  bool GetFrame(std::istream &is, unsigned int frame, FragmentPositions &frags);
 private:
+  static bool ScanFragments(std::istream &is, std::streamoff begin,
+    std::streamoff end, FragmentPositions &frags);
+
   Region *TheRegion;
   bool Modified;
   std::streamoff FileOffset;
+
+  // Index of the encapsulated Pixel Data, built on first use:
+  // 0: not built yet, 1: usable, -1: could not be built
+  int IndexState;
+  unsigned int NumberOfFrames;
+  std::streamoff FirstFragment; // first item after the Basic Offset Table
+  std::vector<uint32_t> Offsets; // Basic Offset Table, when usable
+  FragmentPositions Fragments; // all Fragments, when there is no usable table
 };
 
+// Read the item headers from 'begin' up to 'end' (or up to the Sequence
+// Delimitation Item when end is -1), the Fragment values are skipped
+bool ImageRegionReaderInternals::ScanFragments(std::istream &is,
+  std::streamoff begin, std::streamoff end, FragmentPositions &frags)
+{
+  const Tag itemStart(0xfffe, 0xe000);
+  const Tag seqDelItem(0xfffe,0xe0dd);
+  frags.clear();
+  is.clear();
+  is.seekg( begin, std::ios::beg );
+  try
+    {
+    while( end < 0 || (std::streamoff)is.tellg() < end )
+      {
+      Fragment frag;
+      frag.ReadPreValue<SwapperNoOp>(is);
+      if( frag.GetTag() == seqDelItem ) break;
+      if( frag.GetTag() != itemStart || frag.GetVL().IsUndefined() ) return false;
+      const uint32_t len = frag.GetVL();
+      frags.push_back( FragmentPosition( is.tellg(), len ) );
+      is.seekg( len, std::ios::cur );
+      }
+    }
+  catch(Exception &ex)
+    {
+    gdcmDebugMacro( "Could not index Fragments: " << ex.what() );
+    (void)ex;
+    is.clear();
+    return false;
+    }
+  return !frags.empty() && (end < 0 || (std::streamoff)is.tellg() == end);
+}
+
+bool ImageRegionReaderInternals::BuildIndex(std::istream &is, unsigned int nframes)
+{
+  if( IndexState ) return IndexState > 0 && NumberOfFrames == nframes;
+  IndexState = -1;
+  NumberOfFrames = nframes;
+  if( !nframes ) return false;
+
+  is.clear();
+  is.seekg( FileOffset, std::ios::beg );
+  BasicOffsetTable bot;
+  try
+    {
+    bot.Read<SwapperNoOp>( is );
+    }
+  catch(...)
+    {
+    is.clear();
+    return false;
+    }
+  if( !is ) return false;
+  FirstFragment = is.tellg();
+
+  // The table is only used when it has one entry per frame, starting at 0
+  const ByteValue *bv = bot.GetByteValue();
+  if( bv && bv->GetLength() == nframes * 4 )
+    {
+    Offsets.resize( nframes );
+    memcpy( &Offsets[0], bv->GetPointer(), nframes * 4 );
+    ByteSwap<uint32_t>::SwapRangeFromSwapCodeIntoSystem( &Offsets[0],
+      SwapCode::LittleEndian, nframes );
+    for( unsigned int i = 0; i < nframes; ++i )
+      {
+      if( i ? Offsets[i] <= Offsets[i-1] : Offsets[i] != 0 )
+        {
+        gdcmDebugMacro( "Invalid Basic Offset Table, ignoring it" );
+        Offsets.clear();
+        break;
+        }
+      }
+    }
+  if( Offsets.empty() )
+    {
+    // Empty Basic Offset Table: one pass over the Fragment headers. Only one
+    // Fragment per frame (or a single frame) can be mapped to frames.
+    if( !ScanFragments( is, FirstFragment, -1, Fragments ) ) return false;
+    if( Fragments.size() != nframes && nframes != 1 ) return false;
+    }
+  IndexState = 1;
+  return true;
+}
+
+bool ImageRegionReaderInternals::GetFrame(std::istream &is, unsigned int frame,
+  FragmentPositions &frags)
+{
+  assert( IndexState > 0 && frame < NumberOfFrames );
+  if( !Offsets.empty() )
+    {
+    const std::streamoff end = frame + 1 < NumberOfFrames
+      ? FirstFragment + Offsets[frame + 1] : -1;
+    return ScanFragments( is, FirstFragment + Offsets[frame], end, frags );
+    }
+  if( NumberOfFrames == 1 )
+    {
+    frags = Fragments;
+    }
+  else
+    {
+    frags.assign( 1, Fragments[frame] );
+    }
+  return true;
+}
+
 ImageRegionReader::ImageRegionReader()
 {
   Internals = new ImageRegionReaderInternals;
@@ -241,6 +375,88 @@ bool ImageRegionReader::ReadRAWIntoBuffer(char *buffer, size_t buflen)
   return true;
 }
 
+// Decode the frames zmin..zmax one at a time, seeking straight to their
+// Fragments. 'codec' is setup for the whole image.
+bool ImageRegionReader::ReadFramesIntoBuffer(ImageCodec &codec, char *buffer)
+{
+  std::istream* theStream = GetStreamPtr();
+  const unsigned int dims[3] = { codec.GetDimensions()[0],
+    codec.GetDimensions()[1], codec.GetDimensions()[2] };
+  const unsigned int numberOfDimensions = codec.GetNumberOfDimensions();
+  if( !Internals->BuildIndex( *theStream, dims[2] ) ) return false;
+
+  const BoxRegion &boundingbox = this->Internals->GetRegion()->ComputeBoundingBox();
+  unsigned int xmin = boundingbox.GetXMin();
+  unsigned int xmax = boundingbox.GetXMax();
+  unsigned int ymin = boundingbox.GetYMin();
+  unsigned int ymax = boundingbox.GetYMax();
+  unsigned int zmin = boundingbox.GetZMin();
+  unsigned int zmax = boundingbox.GetZMax();
+  if( xmax >= dims[0] || ymax >= dims[1] || zmax >= dims[2] ) return false;
+
+  const size_t bytesPerPixel = codec.GetPixelFormat().GetPixelSize();
+  const size_t rowsize = xmax - xmin + 1;
+  const size_t colsize = ymax - ymin + 1;
+  const size_t framelen = (size_t)dims[0] * dims[1] * bytesPerPixel;
+
+  // Each frame is decoded as a 2D image
+  const unsigned int framedims[3] = { dims[0], dims[1], 1 };
+  codec.SetDimensions( framedims );
+  codec.SetNumberOfDimensions( 2 );
+
+  bool success = true;
+  ImageRegionReaderInternals::FragmentPositions frags;
+  std::vector<char> data;
+  for( unsigned int z = zmin; success && z <= zmax; ++z )
+    {
+    success = Internals->GetFrame( *theStream, z, frags );
+    if( !success ) break;
+    // A frame may span several Fragments
+    size_t len = 0;
+    for( size_t i = 0; i < frags.size(); ++i )
+      len += frags[i].second;
+    data.resize( len );
+    len = 0;
+    for( size_t i = 0; i < frags.size(); ++i )
+      {
+      theStream->seekg( frags[i].first, std::ios::beg );
+      theStream->read( &data[len], frags[i].second );
+      len += frags[i].second;
+      }
+    if( !*theStream || data.empty() )
+      {
+      theStream->clear();
+      success = false;
+      break;
+      }
+    Fragment frag;
+    frag.SetByteValue( &data[0], (uint32_t)data.size() );
+    SmartPointer<SequenceOfFragments> sq = new SequenceOfFragments;
+    sq->AddFragment( frag );
+    DataElement in( Tag(0x7fe0,0x0010) );
+    in.SetValue( *sq );
+    DataElement out;
+    success = codec.Decode( in, out );
+    const ByteValue *bv = out.GetByteValue();
+    if( !success || !bv || bv->GetLength() < framelen )
+      {
+      gdcmDebugMacro( "Could not decode frame #" << z );
+      success = false;
+      break;
+      }
+    const char *frame = bv->GetPointer();
+    for( unsigned int y = ymin; y <= ymax; ++y )
+      {
+      memcpy( &buffer[((z-zmin)*rowsize*colsize + (y-ymin)*rowsize)*bytesPerPixel],
+        frame + (y*dims[0] + xmin)*bytesPerPixel, rowsize*bytesPerPixel );
+      }
+    }
+
+  codec.SetDimensions( dims );
+  codec.SetNumberOfDimensions( numberOfDimensions );
+  return success;
+}
+
 bool ImageRegionReader::ReadRLEIntoBuffer(char *buffer, size_t buflen)
 {
   (void)buflen;
@@ -266,6 +482,8 @@ bool ImageRegionReader::ReadRLEIntoBuffer(char *buffer, size_t buflen)
   theCodec.SetNumberOfDimensions( 2 );
   if( d[2] > 1 )
     theCodec.SetNumberOfDimensions( 3 );
+  // length of one decoded frame
+  theCodec.SetBufferLength( d[0] * d[1] * theCodec.GetPixelFormat().GetPixelSize() );
 
   std::istream* theStream = GetStreamPtr();
   const BoxRegion &boundingbox = this->Internals->GetRegion()->ComputeBoundingBox();
@@ -279,6 +497,8 @@ bool ImageRegionReader::ReadRLEIntoBuffer(char *buffer, size_t buflen)
   assert( xmax >= xmin );
   assert( ymax >= ymin );
 
+  if( ReadFramesIntoBuffer( theCodec, buffer ) ) return true;
+  theStream->seekg( Internals->GetFileOffset() );
   theCodec.DecodeExtent(
     buffer,
     xmin, xmax,
@@ -328,6 +548,8 @@ bool ImageRegionReader::ReadJPEG2000IntoBuffer(char *buffer, size_t buflen)
   assert( xmax >= xmin );
   assert( ymax >= ymin );
 
+  if( ReadFramesIntoBuffer( theCodec, buffer ) ) return true;
+  theStream->seekg( Internals->GetFileOffset() );
   theCodec.DecodeExtent(
     buffer,
     xmin, xmax,
@@ -378,6 +600,8 @@ bool ImageRegionReader::ReadJPEGIntoBuffer(char *buffer, size_t buflen)
   assert( xmax >= xmin );
   assert( ymax >= ymin );
 
+  if( ReadFramesIntoBuffer( theCodec, buffer ) ) return true;
+  theStream->seekg( Internals->GetFileOffset() );
   theCodec.DecodeExtent(
     buffer,
     xmin, xmax,
@@ -427,6 +651,8 @@ bool ImageRegionReader::ReadJPEGLSIntoBuffer(char *buffer, size_t buflen)
   assert( xmax >= xmin );
   assert( ymax >= ymin );
 
+  if( ReadFramesIntoBuffer( theCodec, buffer ) ) return true;
+  theStream->seekg( Internals->GetFileOffset() );
   theCodec.DecodeExtent(
     buffer,
     xmin, xmax,
@@ -22,8 +22,13 @@ namespace gdcm
 {
 
 class ImageRegionReaderInternals;
+class ImageCodec;
 /**
  * \brief ImageRegionReader
+ * For encapsulated Pixel Data, the position of each frame is looked up in the
+ * Basic Offset Table (or found by scanning the Fragment headers once, when the
+ * table is empty), so that only the frames intersecting the Region are read
+ * and decompressed: reading frame N does not depend on N.
  * \see ImageReader
  */
 class GDCM_EXPORT ImageRegionReader : public ImageReader
@@ -59,6 +64,7 @@ private:
   bool ReadJPEG2000IntoBuffer(char *buffer, size_t buflen);
   bool ReadJPEGIntoBuffer(char *buffer, size_t buflen);
   bool ReadJPEGLSIntoBuffer(char *buffer, size_t buflen);
+  bool ReadFramesIntoBuffer(ImageCodec &codec, char *buffer);
   ImageRegionReaderInternals *Internals;
 };
 
@@ -17,6 +17,8 @@
 #include "gdcmDataElement.h"
 #include "gdcmSequenceOfFragments.h"
 #include "gdcmSwapper.h"
+#include "gdcmSystem.h"
+#include "gdcmThreadPool.h"
 
 #include <cstring>
 #include <numeric>
@@ -271,6 +273,7 @@ void JPEG2000Codec::SetReversible(bool res)
 JPEG2000Codec::JPEG2000Codec()
 {
   Internals = new JPEG2000Internals;
+  NumberOfThreads = 0;
 }
 
 JPEG2000Codec::~JPEG2000Codec()
@@ -332,20 +335,26 @@ bool JPEG2000Codec::Decode(DataElement const &in, DataElement &out)
       sf = &*sf_bug;
       }
     if( !sf ) return false;
-    std::stringstream is;
-    unsigned long totalLen = sf->ComputeByteLength();
-    char *buffer = new char[totalLen];
-    sf->GetBuffer(buffer, totalLen);
-    is.write(buffer, totalLen);
-    delete[] buffer;
-    std::stringstream os;
-    bool r = DecodeByStreams(is, os);
-    if(!r) return false;
+    // A single frame may be split over several fragments, which are then
+    // put back together. Otherwise the codestream is decoded where it is
+    const unsigned long totalLen = sf->ComputeByteLength();
+    if( !totalLen ) return false;
+    std::vector<char> buffer;
+    const char *frame;
+    const ByteValue *bv = sf->GetFragment(0).GetByteValue();
+    if( sf->GetNumberOfFragments() == 1 && bv )
+      {
+      frame = bv->GetPointer();
+      }
+    else
+      {
+      buffer.resize( totalLen );
+      sf->GetBuffer(&buffer[0], totalLen);
+      frame = &buffer[0];
+      }
+    const size_t length = totalLen;
     out = in;
-    std::string str = os.str();
-    out.SetByteValue( &str[0], (uint32_t)str.size() );
-    //memcpy(buffer, os.str().c_str(), len);
-    return r;
+    return DecodeFrames(&frame, &length, 1, out);
     }
   else if ( NumberOfDimensions == 3 )
     {
@@ -358,39 +367,60 @@ bool JPEG2000Codec::Decode(DataElement const &in, DataElement &out)
     //#ifdef SUPPORT_MULTIFRAMESJ2K_ONLY
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if( !sf ) return false;
-    std::stringstream os;
     if( sf->GetNumberOfFragments() != Dimensions[2] )
       {
       gdcmErrorMacro( "Not handled" );
       return false;
       }
-    for(unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i)
+    // The codestreams are decoded where they are, no copy
+    const unsigned int nframes = sf->GetNumberOfFragments();
+    std::vector<const char*> frames( nframes );
+    std::vector<size_t> lengths( nframes );
+    for(unsigned int i = 0; i < nframes; ++i)
       {
-      std::stringstream is;
       const Fragment &frag = sf->GetFragment(i);
       if( frag.IsEmpty() ) return false;
       const ByteValue *bv = frag.GetByteValue();
       assert( bv );
-      size_t bv_len = bv->GetLength();
-      char *mybuffer = new char[bv_len];
-      bv->GetBuffer(mybuffer, bv->GetLength());
-      is.write(mybuffer, bv->GetLength());
-      delete[] mybuffer;
-      bool r = DecodeByStreams(is, os);
-      if(!r) return false;
-      assert( r == true );
+      frames[i] = bv->GetPointer();
+      lengths[i] = bv->GetLength();
       }
-    std::string str = os.str();
-    assert( str.size() );
-    out.SetByteValue( &str[0], (uint32_t)str.size() );
-
-    return true;
+    out = in;
+    return DecodeFrames(&frames[0], &lengths[0], nframes, out);
     }
   // else
   return false;
 }
 
-std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffer, size_t buf_size)
+namespace
+{
+// What a codestream says about its samples, known once it is decoded
+struct JPEG2000FrameInfo
+{
+  bool Reversible;
+  int Signed;
+  int Precision;
+};
+
+template <typename T>
+void CopyComponent(const opj_image_comp_t &comp, int wr, int hr,
+  int numcomps, T *out)
+{
+  for (int y = 0; y < hr; ++y)
+    {
+    const int *in = comp.data + y * comp.w;
+    for (int x = 0; x < wr; ++x)
+      {
+      *out = (T)in[x];
+      out += numcomps;
+      }
+    }
+}
+
+// Decode one codestream into raw (rawlen bytes). Does not touch the codec,
+// so that the frames can be decoded concurrently: see ApplyFrameInfo
+bool DecodeJ2KFrame(const char *buffer, size_t buf_size, char *raw,
+  size_t rawlen, const PixelFormat &pf, JPEG2000FrameInfo &info)
 {
   opj_dparameters_t parameters;  /* decompression parameters */
 #if OPENJPEG_MAJOR_VERSION == 1
@@ -403,7 +433,8 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
 #endif // OPENJPEG_MAJOR_VERSION == 1
   opj_image_t *image = NULL;
 
-  unsigned char *src = (unsigned char*)dummy_buffer;
+  // the codestream is only read
+  unsigned char *src = (unsigned char*)const_cast<char*>(buffer);
   uint32_t file_length = (uint32_t)buf_size; // 32bits truncation should be ok since DICOM cannot have larger than 2Gb image
 
   // WARNING: OpenJPEG is very picky when there is a trailing 00 at the end of the JPC
@@ -416,8 +447,11 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     {
     file_length--;
     }
-  // what if 0xd9 is never found ?
-  assert( file_length > 0 && src[file_length-1] == 0xd9 );
+  if( file_length == 0 )
+    {
+    gdcmErrorMacro( "No end of codestream marker" );
+    return false;
+    }
 
 #if OPENJPEG_MAJOR_VERSION == 1
   /* configure the event callbacks (not required) */
@@ -439,7 +473,7 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
 #endif
 
   const char jp2magic[] = "\x00\x00\x00\x0C\x6A\x50\x20\x20\x0D\x0A\x87\x0A";
-  if( memcmp( src, jp2magic, sizeof(jp2magic) ) == 0 )
+  if( file_length >= sizeof(jp2magic) && memcmp( src, jp2magic, sizeof(jp2magic) ) == 0 )
     {
     /* JPEG-2000 compressed image data ... sigh */
     // gdcmData/ELSCINT1_JP2vsJ2K.dcm
@@ -468,7 +502,7 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     break;
   default:
     gdcmErrorMacro( "Impossible happen" );
-    return std::make_pair<char*,size_t>(0,0);
+    return false;
     }
 
   int reversible;
@@ -488,7 +522,7 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     opj_destroy_decompress(dinfo);
     opj_cio_close(cio);
     gdcmErrorMacro( "opj_decode failed" );
-    return std::make_pair<char*,size_t>(0,0);
+    return false;
   }
 #elif OPENJPEG_MAJOR_VERSION == 2
   myfile mysrc;
@@ -524,12 +558,9 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     cio);
   assert( bResult );
 
-#if OPENJPEG_MAJOR_VERSION == 1
-#else
   // needs to be before call to opj_decode...
   reversible = opj_get_reversible(dinfo, &parameters );
   assert( reversible == 0 || reversible == 1 );
-#endif
 
   image = opj_decode(dinfo, cio);
   //assert( image );
@@ -540,30 +571,10 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     opj_destroy_codec(dinfo);
     opj_stream_destroy(cio);
     gdcmErrorMacro( "opj_decode failed" );
-    return std::make_pair<char*,size_t>(0,0);
+    return false;
     }
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
-#if 0
-  if( image->color_space )
-    {
-    if( image->color_space == CLRSPC_GRAY )
-      {
-      assert( this->GetPhotometricInterpretation() == PhotometricInterpretation::MONOCHROME2
-        || this->GetPhotometricInterpretation() == PhotometricInterpretation::MONOCHROME1
-        || this->GetPhotometricInterpretation() == PhotometricInterpretation::PALETTE_COLOR );
-      }
-    else if( image->color_space == CLRSPC_SRGB )
-      {
-      assert( this->GetPhotometricInterpretation() == PhotometricInterpretation::RGB );
-      }
-    else
-      {
-      assert(0);
-      }
-    }
-#endif
-
 #if OPENJPEG_MAJOR_VERSION == 1
   opj_j2k_t* j2k = NULL;
   opj_jp2_t* jp2 = NULL;
@@ -582,22 +593,14 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
     break;
   default:
     gdcmErrorMacro( "Impossible happen" );
-    return std::make_pair<char*,size_t>(0,0);
+    return false;
     }
 #endif // OPENJPEG_MAJOR_VERSION == 1
-  LossyFlag = !reversible;
+  info.Reversible = reversible != 0;
+  info.Signed = pf.GetPixelRepresentation();
+  info.Precision = pf.GetBitsStored();
 
-#if 0
-#ifndef GDCM_USE_SYSTEM_OPENJPEG
-  if( j2k )
-    j2k_dump_cp(stdout, image, j2k->cp);
-  if( jp2 )
-    j2k_dump_cp(stdout, image, jp2->j2k->cp);
-#endif
-#endif
-
-  assert( image->numcomps == this->GetPixelFormat().GetSamplesPerPixel() );
-  assert( image->numcomps == this->GetPhotometricInterpretation().GetSamplesPerPixel() );
+  assert( image->numcomps == pf.GetSamplesPerPixel() );
 
 #if OPENJPEG_MAJOR_VERSION == 1
   /* close the byte stream */
@@ -608,78 +611,49 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
   // Copy buffer
-  unsigned long len = Dimensions[0]*Dimensions[1] * (PF.GetBitsAllocated() / 8) * image->numcomps;
-  char *raw = new char[len];
-  //assert( len == fsrc->len );
-  for (unsigned int compno = 0; compno < (unsigned int)image->numcomps; compno++)
+  bool success = true;
+  for (unsigned int compno = 0; compno < (unsigned int)image->numcomps && success; compno++)
     {
     opj_image_comp_t *comp = &image->comps[compno];
 
-    int w = image->comps[compno].w;
-    int wr = int_ceildivpow2(image->comps[compno].w, image->comps[compno].factor);
-
-    //int h = image.comps[compno].h;
-    int hr = int_ceildivpow2(image->comps[compno].h, image->comps[compno].factor);
-    //assert(  wr * hr * 1 * image->numcomps * (comp->prec/8) == len );
+    int wr = int_ceildivpow2(comp->w, comp->factor);
+    int hr = int_ceildivpow2(comp->h, comp->factor);
 
     // ELSCINT1_JP2vsJ2K.dcm
     // -> prec = 12, bpp = 0, sgnd = 0
-    //assert( wr == Dimensions[0] );
-    //assert( hr == Dimensions[1] );
 #if OPENJPEG_MAJOR_VERSION == 1
-    if( comp->bpp == PF.GetBitsAllocated() )
+    if( comp->bpp == pf.GetBitsAllocated() )
       {
-      gdcmWarningMacro( "BPP = " << comp->bpp << " vs BitsAllocated = " << PF.GetBitsAllocated() );
+      gdcmWarningMacro( "BPP = " << comp->bpp << " vs BitsAllocated = " << pf.GetBitsAllocated() );
       }
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
-    if( comp->sgnd != PF.GetPixelRepresentation() )
-      {
-      PF.SetPixelRepresentation( (uint16_t)comp->sgnd );
-      }
+    info.Signed = comp->sgnd;
 #ifndef GDCM_SUPPORT_BROKEN_IMPLEMENTATION
-    assert( comp->prec == PF.GetBitsStored()); // D_CLUNIE_RG3_JPLY.dcm
-    assert( comp->prec - 1 == PF.GetHighBit());
+    assert( comp->prec == pf.GetBitsStored()); // D_CLUNIE_RG3_JPLY.dcm
+    assert( comp->prec - 1 == pf.GetHighBit());
 #endif
-    //assert( comp->prec >= PF.GetBitsStored());
-    if( comp->prec != PF.GetBitsStored() )
-      {
-      PF.SetBitsStored( (unsigned short)comp->prec );
-      PF.SetHighBit( (unsigned short)(comp->prec - 1) ); // ??
-      }
-    assert( PF.IsValid() );
+    info.Precision = comp->prec;
     assert( comp->prec <= 32 );
 
-    if (comp->prec <= 8)
+    const size_t samplesize = comp->prec <= 8 ? 1 : comp->prec <= 16 ? 2 : 4;
+    if( (size_t)wr * hr * image->numcomps * samplesize > rawlen )
       {
-      uint8_t *data8 = (uint8_t*)raw + compno;
-      for (int i = 0; i < wr * hr; i++)
-        {
-        int v = image->comps[compno].data[i / wr * w + i % wr];
-        *data8 = (uint8_t)v;
-        data8 += image->numcomps;
-        }
+      gdcmErrorMacro( "Decoded image is larger than expected: " << wr << "x" << hr );
+      success = false;
+      }
+    else if (comp->prec <= 8)
+      {
+      CopyComponent(*comp, wr, hr, image->numcomps, (uint8_t*)raw + compno);
       }
     else if (comp->prec <= 16)
       {
       // ELSCINT1_JP2vsJ2K.dcm is a 12bits image
-      uint16_t *data16 = (uint16_t*)raw + compno;
-      for (int i = 0; i < wr * hr; i++)
-        {
-        int v = image->comps[compno].data[i / wr * w + i % wr];
-        *data16 = (uint16_t)v;
-        data16 += image->numcomps;
-        }
+      CopyComponent(*comp, wr, hr, image->numcomps, (uint16_t*)raw + compno);
       }
     else
       {
-      uint32_t *data32 = (uint32_t*)raw + compno;
-      for (int i = 0; i < wr * hr; i++)
-        {
-        int v = image->comps[compno].data[i / wr * w + i % wr];
-        *data32 = (uint32_t)v;
-        data32 += image->numcomps;
-        }
+      CopyComponent(*comp, wr, hr, image->numcomps, (uint32_t*)raw + compno);
       }
     }
 
@@ -699,9 +673,102 @@ std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffe
   /* free image data structure */
   opj_image_destroy(image);
 
+  return success;
+}
+
+// The codestream tells the actual Pixel Representation and Bits Stored
+void ApplyFrameInfo(const JPEG2000FrameInfo &info, PixelFormat &pf)
+{
+  if( info.Signed != pf.GetPixelRepresentation() )
+    {
+    pf.SetPixelRepresentation( (uint16_t)info.Signed );
+    }
+  if( info.Precision != pf.GetBitsStored() )
+    {
+    pf.SetBitsStored( (unsigned short)info.Precision );
+    pf.SetHighBit( (unsigned short)(info.Precision - 1) ); // ??
+    }
+  assert( pf.IsValid() );
+}
+
+unsigned int ComputeNumberOfThreads(unsigned int requested, size_t nframes)
+{
+  unsigned int n = requested ? requested : System::GetNumberOfProcessors();
+  if( nframes < n ) n = (unsigned int)nframes;
+  return n ? n : 1;
+}
+
+// Decode one frame straight into its place in the output value
+class JPEG2000DecodeTask : public ThreadPool::Task
+{
+public:
+  const char * const *Frames;
+  const size_t *Lengths;
+  char *Output;
+  size_t FrameLength;
+  PixelFormat PF;
+  std::vector<JPEG2000FrameInfo> Infos;
+  std::vector<char> Status;
+  void Execute(size_t index)
+    {
+    Status[index] = DecodeJ2KFrame(Frames[index], Lengths[index],
+      Output + index * FrameLength, FrameLength, PF, Infos[index]);
+    }
+};
+}
+
+std::pair<char *, size_t> JPEG2000Codec::DecodeByStreamsCommon(char *dummy_buffer, size_t buf_size)
+{
+  const size_t len = (size_t)Dimensions[0] * Dimensions[1]
+    * (PF.GetBitsAllocated() / 8) * PF.GetSamplesPerPixel();
+  char *raw = new char[len];
+  JPEG2000FrameInfo info;
+  if( !DecodeJ2KFrame(dummy_buffer, buf_size, raw, len, PF, info) )
+    {
+    delete[] raw;
+    return std::make_pair<char*,size_t>(0,0);
+    }
+  LossyFlag = !info.Reversible;
+  ApplyFrameInfo(info, PF);
   return std::make_pair(raw,len);
 }
 
+bool JPEG2000Codec::DecodeFrames(const char * const *frames,
+  const size_t *lengths, unsigned int nframes, DataElement &out)
+{
+  JPEG2000DecodeTask decode;
+  decode.FrameLength = (size_t)Dimensions[0] * Dimensions[1]
+    * (PF.GetBitsAllocated() / 8) * PF.GetSamplesPerPixel();
+  const size_t len = decode.FrameLength * nframes;
+  if( !len || len >= 0xfffffffe )
+    {
+    gdcmErrorMacro( "Invalid image size: " << len );
+    return false;
+    }
+  // Padded to an even length, the way SetByteValue does it
+  SmartPointer<ByteValue> bv = new ByteValue;
+  bv->SetLength( (uint32_t)(len + len % 2) );
+
+  decode.Frames = frames;
+  decode.Lengths = lengths;
+  decode.Output = const_cast<char*>(bv->GetPointer());
+  decode.PF = PF;
+  decode.Infos.resize( nframes );
+  decode.Status.resize( nframes );
+  ThreadPool pool( ComputeNumberOfThreads(NumberOfThreads, nframes) );
+  pool.ParallelFor( decode, nframes );
+
+  LossyFlag = false;
+  for(unsigned int i = 0; i < nframes; ++i)
+    {
+    if( !decode.Status[i] ) return false;
+    LossyFlag = LossyFlag || !decode.Infos[i].Reversible;
+    ApplyFrameInfo(decode.Infos[i], PF);
+    }
+  out.SetValue( *bv );
+  return true;
+}
+
 bool JPEG2000Codec::DecodeByStreams(std::istream &is, std::ostream &os)
 {
   // FIXME: Do some stupid work:
@@ -858,101 +925,65 @@ opj_image_t* rawtoimage(char *inputbuffer, opj_cparameters_t *parameters,
   return image;
 }
 
-  // Compress into JPEG
-bool JPEG2000Codec::Code(DataElement const &in, DataElement &out)
+namespace
 {
-  out = in;
-  if( NeedOverlayCleanup )
-    {
-    gdcmErrorMacro( "TODO" );
-    return false;
-    }
-
-  //
-  // Create a Sequence Of Fragments:
-  SmartPointer<SequenceOfFragments> sq = new SequenceOfFragments;
-
-  const unsigned int *dims = this->GetDimensions();
-
-  const ByteValue *bv = in.GetByteValue();
-  const char *input = bv->GetPointer();
-  unsigned long len = bv->GetLength();
-  unsigned long image_len = len / dims[2];
-  size_t inputlength = image_len;
-
-  for(unsigned int dim = 0; dim < dims[2]; ++dim)
-    {
-    std::ostringstream os;
-    std::ostream *fp = &os;
-    const char *inputdata = input + dim * image_len; //bv->GetPointer();
-    //size_t inputlength = bv->GetLength();
-    int image_width = dims[0];
-    int image_height = dims[1];
-    int numZ = 0; //dims[2];
-    const PixelFormat &pf = this->GetPixelFormat();
-    int sample_pixel = pf.GetSamplesPerPixel();
-    int bitsallocated = pf.GetBitsAllocated();
+// Encode one frame into frag. parameters is the setup of the codec, it is
+// copied: the frames can be encoded concurrently
+bool EncodeJ2KFrame(const char *inputdata, size_t inputlength,
+  int image_width, int image_height, const PixelFormat &pf, int pc,
+  const opj_cparameters_t &coder_param, Fragment &frag)
+{
+  int sample_pixel = pf.GetSamplesPerPixel();
+  int bitsallocated = pf.GetBitsAllocated();
 #ifndef GDCM_SUPPORT_BROKEN_IMPLEMENTATION
-    int bitsstored = pf.GetBitsStored();
+  int bitsstored = pf.GetBitsStored();
 #else
-    // Usual D_CLUNIE_RG3_JPLY.dcm kludge:
-    int bitsstored = pf.GetBitsAllocated();
+  // Usual D_CLUNIE_RG3_JPLY.dcm kludge:
+  int bitsstored = pf.GetBitsAllocated();
 #endif
-    int sign = pf.GetPixelRepresentation();
-    int quality = 100;
-
-    //// input_buffer is ONE image
-    //// fragment_size is the size of this image (fragment)
-    (void)numZ;
-    bool bSuccess;
-    //bool delete_comment = true;
-    opj_cparameters_t parameters;  /* compression parameters */
+  int sign = pf.GetPixelRepresentation();
+  int quality = 100;
+
+  //// input_buffer is ONE image
+  //// fragment_size is the size of this image (fragment)
+  bool bSuccess;
+  opj_cparameters_t parameters;  /* compression parameters */
 #if OPENJPEG_MAJOR_VERSION == 1
-    opj_event_mgr_t event_mgr;    /* event manager */
+  opj_event_mgr_t event_mgr;    /* event manager */
 #endif // OPENJPEG_MAJOR_VERSION == 1
-    opj_image_t *image = NULL;
-    //quality = 100;
+  opj_image_t *image = NULL;
 
 #if OPENJPEG_MAJOR_VERSION == 1
-    /*
-    configure the event callbacks (not required)
-    setting of each callback is optionnal
-    */
-    memset(&event_mgr, 0, sizeof(opj_event_mgr_t));
-    event_mgr.error_handler = error_callback;
-    event_mgr.warning_handler = warning_callback;
-    event_mgr.info_handler = info_callback;
+  /*
+  configure the event callbacks (not required)
+  setting of each callback is optionnal
+  */
+  memset(&event_mgr, 0, sizeof(opj_event_mgr_t));
+  event_mgr.error_handler = error_callback;
+  event_mgr.warning_handler = warning_callback;
+  event_mgr.info_handler = info_callback;
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
-    /* set encoding parameters to default values */
-    //memset(&parameters, 0, sizeof(parameters));
-    //opj_set_default_encoder_parameters(&parameters);
-
-    memcpy(&parameters, &(Internals->coder_param), sizeof(parameters));
+  memcpy(&parameters, &coder_param, sizeof(parameters));
 
-    if ((parameters.cp_disto_alloc || parameters.cp_fixed_alloc || parameters.cp_fixed_quality)
-      && (!(parameters.cp_disto_alloc ^ parameters.cp_fixed_alloc ^ parameters.cp_fixed_quality)))
-      {
-      gdcmErrorMacro( "Error: options -r -q and -f cannot be used together." );
-      return false;
-      }        /* mod fixed_quality */
-
-    /* if no rate entered, lossless by default */
-    if (parameters.tcp_numlayers == 0)
-      {
-      parameters.tcp_rates[0] = 0;
-      parameters.tcp_numlayers = 1;
-      parameters.cp_disto_alloc = 1;
-      }
-
-    if(parameters.cp_comment == NULL) {
-      const char comment[] = "Created by GDCM/OpenJPEG version 2.0";
-      parameters.cp_comment = (char*)malloc(strlen(comment) + 1);
-      strcpy(parameters.cp_comment, comment);
-      /* no need to delete parameters.cp_comment on exit */
-      //delete_comment = false;
+  /* if no rate entered, lossless by default */
+  if (parameters.tcp_numlayers == 0)
+    {
+    parameters.tcp_rates[0] = 0;
+    parameters.tcp_numlayers = 1;
+    parameters.cp_disto_alloc = 1;
     }
 
+  // Only what is allocated here is freed, the rest belongs to coder_param
+  // which is shared by all the frames
+  char *comment_copy = NULL;
+  if(parameters.cp_comment == NULL) {
+    const char comment[] = "Created by GDCM/OpenJPEG version 2.0";
+    comment_copy = (char*)malloc(strlen(comment) + 1);
+    strcpy(comment_copy, comment);
+    parameters.cp_comment = comment_copy;
+  }
+
   // Compute the proper number of resolutions to use.
   // This is mostly done for images smaller than 64 pixels
   // along any dimension.
@@ -976,138 +1007,187 @@ bool JPEG2000Codec::Code(DataElement const &in, DataElement &out)
 
   parameters.numresolution = numberOfResolutions;
 
+  /* decode the source image */
+  /* ----------------------- */
 
-    /* decode the source image */
-    /* ----------------------- */
-
-    image = rawtoimage((char*)inputdata, &parameters,
-      static_cast<int>( inputlength ),
-      image_width, image_height,
-      sample_pixel, bitsallocated, bitsstored, sign, quality, this->GetPlanarConfiguration() );
-    if (!image) {
-      return false;
-    }
+  image = rawtoimage((char*)inputdata, &parameters,
+    static_cast<int>( inputlength ),
+    image_width, image_height,
+    sample_pixel, bitsallocated, bitsstored, sign, quality, pc );
+  if (!image) {
+    free(comment_copy);
+    return false;
+  }
 
-    /* encode the destination image */
-    /* ---------------------------- */
-    parameters.cod_format = J2K_CFMT; /* J2K format output */
-    size_t codestream_length;
+  /* encode the destination image */
+  /* ---------------------------- */
+  parameters.cod_format = J2K_CFMT; /* J2K format output */
+  size_t codestream_length;
 #if OPENJPEG_MAJOR_VERSION == 1
-    opj_cio_t *cio = NULL;
+  opj_cio_t *cio = NULL;
 
-    /* get a J2K compressor handle */
-    opj_cinfo_t* cinfo = opj_create_compress(CODEC_J2K);
+  /* get a J2K compressor handle */
+  opj_cinfo_t* cinfo = opj_create_compress(CODEC_J2K);
 
-    /* catch events using our callbacks and give a local context */
-    opj_set_event_mgr((opj_common_ptr)cinfo, &event_mgr, stderr);
+  /* catch events using our callbacks and give a local context */
+  opj_set_event_mgr((opj_common_ptr)cinfo, &event_mgr, stderr);
 
-    /* setup the encoder parameters using the current image and using user parameters */
-    opj_setup_encoder(cinfo, &parameters, image);
+  /* setup the encoder parameters using the current image and using user parameters */
+  opj_setup_encoder(cinfo, &parameters, image);
 
-    /* open a byte stream for writing */
-    /* allocate memory for all tiles */
-    cio = opj_cio_open((opj_common_ptr)cinfo, NULL, 0);
+  /* open a byte stream for writing */
+  /* allocate memory for all tiles */
+  cio = opj_cio_open((opj_common_ptr)cinfo, NULL, 0);
 
-    /* encode the image */
-    bSuccess = opj_encode(cinfo, cio, image, parameters.index);
-    if (!bSuccess) {
-      opj_cio_close(cio);
-      fprintf(stderr, "failed to encode image\n");
-      return false;
-    }
-    codestream_length = cio_tell(cio);
+  /* encode the image */
+  bSuccess = opj_encode(cinfo, cio, image, parameters.index);
+  codestream_length = cio_tell(cio);
 #elif OPENJPEG_MAJOR_VERSION == 2
-    opj_codec_t* cinfo = 00;
-    opj_stream_t *cio = 00;
+  opj_codec_t* cinfo = 00;
+  opj_stream_t *cio = 00;
 
-    /* get a J2K compressor handle */
-    cinfo = opj_create_compress(CODEC_J2K);
+  /* get a J2K compressor handle */
+  cinfo = opj_create_compress(CODEC_J2K);
 
-    /* setup the encoder parameters using the current image and using user parameters */
-    opj_setup_encoder(cinfo, &parameters, image);
+  /* setup the encoder parameters using the current image and using user parameters */
+  opj_setup_encoder(cinfo, &parameters, image);
 
-    myfile mysrc;
-    myfile *fsrc = &mysrc;
-    char *buffer_j2k = new char[image_len]; // overallocated
-    fsrc->mem = fsrc->cur = buffer_j2k;
-    fsrc->len = 0;
-
-    /* open a byte stream for writing */
-    /* allocate memory for all tiles */
-    cio = opj_stream_create_memory_stream(fsrc,J2K_STREAM_CHUNK_SIZE,false);
-    if (! cio)
-      {
-      return false;
-      }
-    /* encode the image */
-    /*if (*indexfilename)          // If need to extract codestream information
-      bSuccess = opj_encode_with_info(cinfo, cio, image, &cstr_info);
-      else*/
-    bSuccess = opj_start_compress(cinfo,image,cio);
-    bSuccess = bSuccess && opj_encode(cinfo, cio);
-    bSuccess = bSuccess && opj_end_compress(cinfo, cio);
-
-    if (!bSuccess)
-      {
-      opj_stream_destroy(cio);
-      return false;
-      }
-    codestream_length = mysrc.len;
+  myfile mysrc;
+  myfile *fsrc = &mysrc;
+  char *buffer_j2k = new char[inputlength]; // overallocated
+  fsrc->mem = fsrc->cur = buffer_j2k;
+  fsrc->len = 0;
+
+  /* open a byte stream for writing */
+  /* allocate memory for all tiles */
+  cio = opj_stream_create_memory_stream(fsrc,J2K_STREAM_CHUNK_SIZE,false);
+  bSuccess = cio != 00;
+  /* encode the image */
+  bSuccess = bSuccess && opj_start_compress(cinfo,image,cio);
+  bSuccess = bSuccess && opj_encode(cinfo, cio);
+  bSuccess = bSuccess && opj_end_compress(cinfo, cio);
+  codestream_length = mysrc.len;
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
-    /* write the buffer to disk */
-    //f = fopen(parameters.outfile, "wb");
-    //if (!f) {
-    //  fprintf(stderr, "failed to open %s for writing\n", parameters.outfile);
-    //  return 1;
-    //}
-    //fwrite(cio->buffer, 1, codestream_length, f);
-    //#define MDEBUG
+  //#define MDEBUG
 #ifdef MDEBUG
-    static int c = 0;
-    std::ostringstream os;
-    os << "/tmp/debug";
-    os << c;
-    c++;
-    os << ".j2k";
-    std::ofstream debug(os.str().c_str(), std::ios::binary);
-    debug.write((char*)(cio->buffer), codestream_length);
-    debug.close();
+  static int c = 0;
+  std::ostringstream os;
+  os << "/tmp/debug";
+  os << c;
+  c++;
+  os << ".j2k";
+  std::ofstream debug(os.str().c_str(), std::ios::binary);
+  debug.write((char*)(cio->buffer), codestream_length);
+  debug.close();
 #endif
 
+  // The codestream goes straight into the fragment
+  if( bSuccess )
+    {
 #if OPENJPEG_MAJOR_VERSION == 1
-    fp->write((char*)(cio->buffer), codestream_length);
+    frag.SetByteValue( (char*)(cio->buffer), (uint32_t)codestream_length );
+#elif OPENJPEG_MAJOR_VERSION == 2
+    frag.SetByteValue( mysrc.mem, (uint32_t)codestream_length );
+#endif // OPENJPEG_MAJOR_VERSION == 1
+    }
+  else
+    {
+    gdcmErrorMacro( "failed to encode image" );
+    }
 
-    /* close and free the byte stream */
-    opj_cio_close(cio);
+#if OPENJPEG_MAJOR_VERSION == 1
+  /* close and free the byte stream */
+  opj_cio_close(cio);
 
-    /* free remaining compression structures */
-    opj_destroy_compress(cinfo);
+  /* free remaining compression structures */
+  opj_destroy_compress(cinfo);
 #elif OPENJPEG_MAJOR_VERSION == 2
-    fp->write((char*)(mysrc.mem), codestream_length);
-    delete [] buffer_j2k;
+  delete [] buffer_j2k;
 
-    /* close and free the byte stream */
-    opj_stream_destroy(cio);
+  /* close and free the byte stream */
+  if( cio ) opj_stream_destroy(cio);
 
-    /* free remaining compression structures */
-    opj_destroy_codec(cinfo);
+  /* free remaining compression structures */
+  opj_destroy_codec(cinfo);
 #endif // OPENJPEG_MAJOR_VERSION == 1
 
-    /* free user parameters structure */
-    //if(delete_comment) {
-    if(parameters.cp_comment) free(parameters.cp_comment);
-    //}
-    if(parameters.cp_matrice) free(parameters.cp_matrice);
+  /* free user parameters structure */
+  free(comment_copy);
+
+  /* free image data */
+  opj_image_destroy(image);
+
+  return bSuccess;
+}
+
+class JPEG2000EncodeTask : public ThreadPool::Task
+{
+public:
+  const char *Input;
+  size_t FrameLength;
+  int Width;
+  int Height;
+  PixelFormat PF;
+  int PlanarConfiguration;
+  const opj_cparameters_t *Parameters;
+  std::vector<Fragment> Fragments;
+  std::vector<char> Status;
+  void Execute(size_t index)
+    {
+    Status[index] = EncodeJ2KFrame(Input + index * FrameLength, FrameLength,
+      Width, Height, PF, PlanarConfiguration, *Parameters, Fragments[index]);
+    }
+};
+}
+
+  // Compress into JPEG
+bool JPEG2000Codec::Code(DataElement const &in, DataElement &out)
+{
+  out = in;
+  if( NeedOverlayCleanup )
+    {
+    gdcmErrorMacro( "TODO" );
+    return false;
+    }
+
+  const opj_cparameters_t &parameters = Internals->coder_param;
+  if ((parameters.cp_disto_alloc || parameters.cp_fixed_alloc || parameters.cp_fixed_quality)
+    && (!(parameters.cp_disto_alloc ^ parameters.cp_fixed_alloc ^ parameters.cp_fixed_quality)))
+    {
+    gdcmErrorMacro( "Error: options -r -q and -f cannot be used together." );
+    return false;
+    }        /* mod fixed_quality */
 
-    /* free image data */
-    opj_image_destroy(image);
+  //
+  // Create a Sequence Of Fragments:
+  SmartPointer<SequenceOfFragments> sq = new SequenceOfFragments;
+
+  const unsigned int *dims = this->GetDimensions();
 
-    std::string str = os.str();
-    assert( str.size() );
-    Fragment frag;
-    frag.SetByteValue( &str[0], (uint32_t)str.size() );
-    sq->AddFragment( frag );
+  const ByteValue *bv = in.GetByteValue();
+  if( !bv || !dims[2] ) return false;
+  unsigned long len = bv->GetLength();
+
+  // One codestream per frame, each frame on its own thread
+  JPEG2000EncodeTask encode;
+  encode.Input = bv->GetPointer();
+  encode.FrameLength = len / dims[2];
+  encode.Width = dims[0];
+  encode.Height = dims[1];
+  encode.PF = this->GetPixelFormat();
+  encode.PlanarConfiguration = this->GetPlanarConfiguration();
+  encode.Parameters = &parameters;
+  encode.Fragments.resize( dims[2] );
+  encode.Status.resize( dims[2] );
+  ThreadPool pool( ComputeNumberOfThreads(NumberOfThreads, dims[2]) );
+  pool.ParallelFor( encode, dims[2] );
+
+  for(unsigned int dim = 0; dim < dims[2]; ++dim)
+    {
+    if( !encode.Status[dim] ) return false;
+    assert( !encode.Fragments[dim].IsEmpty() );
+    sq->AddFragment( encode.Fragments[dim] );
     }
 
   //unsigned int nfrags = sq->GetNumberOfFragments();
@@ -26,6 +26,10 @@ class JPEG2000Internals;
  * the class will produce JPC (JPEG 2000 codestream), since some private implementor
  * are using full jp2 file the decoder tolerate jp2 input
  * this is an implementation of an ImageCodec
+ *
+ * \note Each frame is a codestream of its own (one fragment per frame): Decode
+ * and Code process the frames in parallel, see SetNumberOfThreads, and Decode
+ * writes the samples of every frame straight into the output value.
  */
 class GDCM_EXPORT JPEG2000Codec : public ImageCodec
 {
@@ -58,6 +62,12 @@ public:
 
   void SetReversible(bool res);
 
+  /// Set/Get the number of threads used by Decode/Code. 0 (default) means
+  /// the number of online processors, a single frame is always done in the
+  /// calling thread.
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
 protected:
   bool DecodeExtent(
     char *buffer,
@@ -71,7 +81,10 @@ protected:
 private:
   std::pair<char *, size_t> DecodeByStreamsCommon(char *dummy_buffer, size_t buf_size);
   bool GetHeaderInfo(const char * dummy_buffer, size_t len, TransferSyntax &ts);
+  bool DecodeFrames(const char * const *frames, const size_t *lengths,
+    unsigned int nframes, DataElement &out);
   JPEG2000Internals *Internals;
+  unsigned int NumberOfThreads;
 };
 
 } // end namespace gdcm
@@ -19,6 +19,8 @@
 #include "gdcmSequenceOfFragments.h"
 #include "gdcmSmartPointer.h"
 #include "gdcmSwapper.h"
+#include "gdcmSystem.h"
+#include "gdcmThreadPool.h"
 
 #include <vector>
 #include <algorithm> // req C++11
@@ -83,6 +85,7 @@ RLECodec::RLECodec()
   Internals = new RLEInternals;
   Length = 0;
   BufferLength = 0;
+  NumberOfThreads = 0;
 }
 
 RLECodec::~RLECodec()
@@ -299,15 +302,224 @@ bool DoInvertPlanarConfiguration(T *output, const T *input, uint32_t inputlength
 }
 
 
+namespace
+{
+// Images smaller than this are always processed in the calling thread, it is
+// not worth starting threads for them.
+const size_t RLEParallelThreshold = 1024 * 1024;
+
+unsigned int ComputeNumberOfThreads(unsigned int requested, size_t ntasks,
+  size_t datalen)
+{
+  unsigned int n = requested ? requested : System::GetNumberOfProcessors();
+  if( datalen < RLEParallelThreshold ) n = 1;
+  if( ntasks < n ) n = (unsigned int)ntasks;
+  return n ? n : 1;
+}
+
+// Reorder one frame the way RLE wants it: planes (PlanarConfiguration = 1)
+// then most significant bytes first. Return the prepared frame, which is
+// either ptr_img itself or one of the work buffers.
+const char *PrepareFrameForRLE(const char *ptr_img, unsigned long image_len,
+  const PixelFormat &pf, unsigned int planarconf, char *buffer, char *bufferrgb)
+{
+  if( planarconf == 0 && pf.GetSamplesPerPixel() == 3 )
+    {
+    if( pf.GetBitsAllocated() == 8 )
+      {
+      DoInvertPlanarConfiguration<char>(bufferrgb, ptr_img, (uint32_t)(image_len / sizeof(char)));
+      }
+    else /* ( pf.GetBitsAllocated() == 16 ) */
+      {
+      assert( pf.GetBitsAllocated() == 16 );
+      // should not happen right ?
+      DoInvertPlanarConfiguration<short>((short*)bufferrgb, (short*)ptr_img, (uint32_t)(image_len / sizeof(short)));
+      }
+    ptr_img = bufferrgb;
+    }
+  if( pf.GetBitsAllocated() == 32 )
+    {
+    assert( !(image_len % 4) );
+    //assert( image_len % 3 == 0 );
+    unsigned int div = pf.GetSamplesPerPixel();
+    for(unsigned int j = 0; j < div; ++j)
+      {
+      unsigned long iimage_len = image_len / div;
+      char *ibuffer = buffer + j * iimage_len;
+      const char *iptr_img = ptr_img + j * iimage_len;
+      assert( iimage_len % 4 == 0 );
+      for(unsigned long i = 0; i < iimage_len/4; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i] = iptr_img[4*i+0];
+#else
+        ibuffer[i] = iptr_img[4*i+3];
+#endif
+        }
+      for(unsigned long i = 0; i < iimage_len/4; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i+iimage_len/4] = iptr_img[4*i+1];
+#else
+        ibuffer[i+iimage_len/4] = iptr_img[4*i+2];
+#endif
+        }
+      for(unsigned long i = 0; i < iimage_len/4; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i+2*iimage_len/4] = iptr_img[4*i+2];
+#else
+        ibuffer[i+2*iimage_len/4] = iptr_img[4*i+1];
+#endif
+        }
+      for(unsigned long i = 0; i < iimage_len/4; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i+3*iimage_len/4] = iptr_img[4*i+3];
+#else
+        ibuffer[i+3*iimage_len/4] = iptr_img[4*i+0];
+#endif
+        }
+      }
+    ptr_img = buffer;
+    }
+  else if( pf.GetBitsAllocated() == 16 )
+    {
+    assert( !(image_len % 2) );
+    //assert( image_len % 3 == 0 );
+    unsigned int div = pf.GetSamplesPerPixel();
+    for(unsigned int j = 0; j < div; ++j)
+      {
+      unsigned long iimage_len = image_len / div;
+      char *ibuffer = buffer + j * iimage_len;
+      const char *iptr_img = ptr_img + j * iimage_len;
+      assert( iimage_len % 2 == 0 );
+      for(unsigned long i = 0; i < iimage_len/2; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i] = iptr_img[2*i];
+#else
+        ibuffer[i] = iptr_img[2*i+1];
+#endif
+        }
+      for(unsigned long i = 0; i < iimage_len/2; ++i)
+        {
+#ifdef GDCM_WORDS_BIGENDIAN
+        ibuffer[i+iimage_len/2] = iptr_img[2*i+1];
+#else
+        ibuffer[i+iimage_len/2] = iptr_img[2*i];
+#endif
+        }
+      }
+    ptr_img = buffer;
+    }
+  return ptr_img;
+}
+
+// Compress the RLE Segments of the frames. A task is either a whole frame
+// (reordered in a work buffer of the task), or a single segment of a frame
+// when there are less frames than threads (frames are then reordered
+// beforehand, see RLEPrepareTask).
+class RLEEncodeTask : public ThreadPool::Task
+{
+public:
+  const char *Frames;
+  unsigned long ImageLength;
+  unsigned int NumSegments;
+  unsigned int Columns;
+  unsigned int Rows;
+  PixelFormat PF;
+  unsigned int PlanarConfiguration;
+  bool NeedPrepare;
+  bool NeedRGB;
+  bool PerFrame;
+  std::vector<std::string> *Segments;
+  bool Error;
+
+  // Reorder frame 'dim' into 'buffer'
+  void PrepareFrame(size_t dim, char *buffer) const
+    {
+    const char *ptr_img = Frames + dim * ImageLength;
+    std::vector<char> bufferrgb;
+    if( NeedRGB ) bufferrgb.resize( ImageLength );
+    const char *ptr = PrepareFrameForRLE(ptr_img, ImageLength, PF,
+      PlanarConfiguration, buffer, NeedRGB ? &bufferrgb[0] : 0);
+    if( ptr != buffer )
+      {
+      memcpy(buffer, ptr, ImageLength);
+      }
+    }
+
+  void EncodeSegment(const char *ptr_img, size_t dim, unsigned int seg)
+    {
+    // Within each frame, create the RLE Segments:
+    // lets' try a simple scheme where each Segments is given an equal portion
+    // of the input image.
+    assert( ImageLength % NumSegments == 0 );
+    const size_t input_seg_length = ImageLength / NumSegments;
+    size_t partition = input_seg_length;
+    const char *ptr = ptr_img + seg * input_seg_length;
+    assert( ptr < ptr_img + ImageLength );
+    assert( partition % Rows == 0 );
+    // At most we are encoding a single row at a time, so we would be very
+    // unlucky if the row *after* compression would not fit in 256*256 bytes...
+    const unsigned int n = 256*256;
+    std::vector<char> outbuf( n );
+    std::string &data = (*Segments)[dim * NumSegments + seg];
+    data.reserve( partition / 2 );
+    // Do not cross row boundary:
+    for(unsigned int y = 0; y < Rows; ++y)
+      {
+      ptrdiff_t llength = rle_encode(&outbuf[0], n, ptr + y*Columns, partition / Rows /*image_len*/);
+      if( llength < 0 )
+        {
+        Error = true;
+        return;
+        }
+      assert( llength );
+      data.append(&outbuf[0], llength);
+      }
+    }
+
+  void Execute(size_t index)
+    {
+    if( PerFrame )
+      {
+      const char *ptr_img = Frames + index * ImageLength;
+      std::vector<char> buffer;
+      if( NeedPrepare )
+        {
+        buffer.resize( ImageLength );
+        PrepareFrame( index, &buffer[0] );
+        ptr_img = &buffer[0];
+        }
+      for(unsigned int seg = 0; seg < NumSegments; ++seg )
+        EncodeSegment( ptr_img, index, seg );
+      }
+    else
+      {
+      const size_t dim = index / NumSegments;
+      EncodeSegment( Frames + dim * ImageLength, dim, (unsigned int)(index % NumSegments) );
+      }
+    }
+};
+
+// Reorder all the frames beforehand, for RLEEncodeTask working on segments
+class RLEPrepareTask : public ThreadPool::Task
+{
+public:
+  const RLEEncodeTask *Encode;
+  char *Prepared;
+  void Execute(size_t dim)
+    {
+    Encode->PrepareFrame( dim, Prepared + dim * Encode->ImageLength );
+    }
+};
+}
+
 bool RLECodec::Code(DataElement const &in, DataElement &out)
 {
   const unsigned int *dims = this->GetDimensions();
-  const unsigned int n = 256*256;
-  char *outbuf;
-  // At most we are encoding a single row at a time, so we would be very unlucky
-  // if the row *after* compression would not fit in 256*256 bytes...
-  char small_buffer[n];
-  outbuf = small_buffer;
 
   // Create a Sequence Of Fragments:
   SmartPointer<SequenceOfFragments> sq = new SequenceOfFragments;
@@ -323,23 +535,10 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
   unsigned long bvl = bv->GetLength();
   unsigned long image_len = bvl / dims[2];
 
-  // If 16bits, need to do the padded composite...
-  char *buffer = 0;
-  // if rgb (3 comp) need to the planar configuration
-  char *bufferrgb = 0;
-  if( GetPixelFormat().GetBitsAllocated() > 8 )
-    {
-    //RequestPaddedCompositePixelCode = true;
-    buffer = new char [ image_len ];
-    }
-
-  if ( GetPhotometricInterpretation() == PhotometricInterpretation::RGB
+  const bool isrgb = GetPhotometricInterpretation() == PhotometricInterpretation::RGB
     || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_FULL
     || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_RCT
-    || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_FULL_422 )
-    {
-    bufferrgb = new char [ image_len ];
-    }
+    || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_FULL_422;
 
   unsigned int MaxNumSegments = 1;
   if( GetPixelFormat().GetBitsAllocated() == 8 )
@@ -356,15 +555,10 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
     }
   else
     {
-    delete[] buffer;
-    delete[] bufferrgb;
     return false;
     }
 
-  if( GetPhotometricInterpretation() == PhotometricInterpretation::RGB
-    || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_FULL
-    || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_RCT
-    || GetPhotometricInterpretation() == PhotometricInterpretation::YBR_FULL_422 )
+  if( isrgb )
     {
     MaxNumSegments *= 3;
     }
@@ -376,6 +570,49 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
     assert( MaxNumSegments % 3 == 0 );
     }
 
+  const size_t nsegments = (size_t)dims[2] * MaxNumSegments;
+  ThreadPool pool( ComputeNumberOfThreads(NumberOfThreads, nsegments, bvl) );
+
+  RLEEncodeTask encode;
+  encode.Frames = input;
+  encode.ImageLength = image_len;
+  encode.NumSegments = MaxNumSegments;
+  encode.Columns = dims[0];
+  encode.Rows = dims[1];
+  encode.PF = GetPixelFormat();
+  encode.PlanarConfiguration = GetPlanarConfiguration();
+  // If 16bits, need to do the padded composite...
+  // if rgb (3 comp) need to the planar configuration
+  encode.NeedRGB = GetPlanarConfiguration() == 0 && GetPixelFormat().GetSamplesPerPixel() == 3;
+  encode.NeedPrepare = GetPixelFormat().GetBitsAllocated() > 8 || encode.NeedRGB;
+  encode.PerFrame = dims[2] >= pool.GetNumberOfThreads();
+  std::vector<std::string> segments( nsegments );
+  encode.Segments = &segments;
+  encode.Error = false;
+  std::vector<char> prepared;
+  if( encode.PerFrame )
+    {
+    pool.ParallelFor( encode, dims[2] );
+    }
+  else
+    {
+    if( encode.NeedPrepare )
+      {
+      prepared.resize( (size_t)image_len * dims[2] );
+      RLEPrepareTask prepare;
+      prepare.Encode = &encode;
+      prepare.Prepared = &prepared[0];
+      pool.ParallelFor( prepare, dims[2] );
+      encode.Frames = &prepared[0];
+      }
+    pool.ParallelFor( encode, nsegments );
+    }
+  if( encode.Error )
+    {
+    gdcmErrorMacro( "RLE compressor error" );
+    return false;
+    }
+
   RLEHeader header = { static_cast<uint32_t> ( MaxNumSegments ), { 64 } };
   // there cannot be any space in between the end of the RLE header and the start
   // of the first RLE segment
@@ -383,142 +620,25 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
   // Create a RLE Frame for each frame:
   for(unsigned int dim = 0; dim < dims[2]; ++dim)
     {
-    // Within each frame, create the RLE Segments:
-    // lets' try a simple scheme where each Segments is given an equal portion
-    // of the input image.
-    const char *ptr_img = input + dim * image_len;
-    if( GetPlanarConfiguration() == 0 && GetPixelFormat().GetSamplesPerPixel() == 3 )
-      {
-      if( GetPixelFormat().GetBitsAllocated() == 8 )
-        {
-        DoInvertPlanarConfiguration<char>(bufferrgb, ptr_img, (uint32_t)(image_len / sizeof(char)));
-        }
-      else /* ( GetPixelFormat().GetBitsAllocated() == 16 ) */
-        {
-        assert( GetPixelFormat().GetBitsAllocated() == 16 );
-        // should not happen right ?
-        DoInvertPlanarConfiguration<short>((short*)bufferrgb, (short*)ptr_img, (uint32_t)(image_len / sizeof(short)));
-        }
-      ptr_img = bufferrgb;
-      }
-    if( GetPixelFormat().GetBitsAllocated() == 32 )
-      {
-      assert( !(image_len % 4) );
-      //assert( image_len % 3 == 0 );
-      unsigned int div = GetPixelFormat().GetSamplesPerPixel();
-      for(unsigned int j = 0; j < div; ++j)
-        {
-        unsigned long iimage_len = image_len / div;
-        char *ibuffer = buffer + j * iimage_len;
-        const char *iptr_img = ptr_img + j * iimage_len;
-        assert( iimage_len % 4 == 0 );
-        for(unsigned long i = 0; i < iimage_len/4; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i] = iptr_img[4*i+0];
-#else
-          ibuffer[i] = iptr_img[4*i+3];
-#endif
-          }
-        for(unsigned long i = 0; i < iimage_len/4; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i+iimage_len/4] = iptr_img[4*i+1];
-#else
-          ibuffer[i+iimage_len/4] = iptr_img[4*i+2];
-#endif
-          }
-        for(unsigned long i = 0; i < iimage_len/4; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i+2*iimage_len/4] = iptr_img[4*i+2];
-#else
-          ibuffer[i+2*iimage_len/4] = iptr_img[4*i+1];
-#endif
-          }
-        for(unsigned long i = 0; i < iimage_len/4; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i+3*iimage_len/4] = iptr_img[4*i+3];
-#else
-          ibuffer[i+3*iimage_len/4] = iptr_img[4*i+0];
-#endif
-          }
-        }
-      ptr_img = buffer;
-      }
-    else if( GetPixelFormat().GetBitsAllocated() == 16 )
-      {
-      assert( !(image_len % 2) );
-      //assert( image_len % 3 == 0 );
-      unsigned int div = GetPixelFormat().GetSamplesPerPixel();
-      for(unsigned int j = 0; j < div; ++j)
-        {
-        unsigned long iimage_len = image_len / div;
-        char *ibuffer = buffer + j * iimage_len;
-        const char *iptr_img = ptr_img + j * iimage_len;
-        assert( iimage_len % 2 == 0 );
-        for(unsigned long i = 0; i < iimage_len/2; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i] = iptr_img[2*i];
-#else
-          ibuffer[i] = iptr_img[2*i+1];
-#endif
-          }
-        for(unsigned long i = 0; i < iimage_len/2; ++i)
-          {
-#ifdef GDCM_WORDS_BIGENDIAN
-          ibuffer[i+iimage_len/2] = iptr_img[2*i+1];
-#else
-          ibuffer[i+iimage_len/2] = iptr_img[2*i];
-#endif
-          }
-        }
-      ptr_img = buffer;
-      }
-    assert( image_len % MaxNumSegments == 0 );
-    const size_t input_seg_length = image_len / MaxNumSegments;
-    std::string datastr;
+    size_t framelen = sizeof(header);
     for(unsigned int seg = 0; seg < MaxNumSegments; ++seg )
       {
-      size_t partition = input_seg_length;
-      const char *ptr = ptr_img + seg * input_seg_length;
-      assert( ptr < ptr_img + image_len );
-      if( seg == MaxNumSegments - 1 )
-        {
-        partition += image_len % MaxNumSegments;
-        assert( (MaxNumSegments-1) * input_seg_length + partition == (size_t)image_len );
-        }
-      assert( partition == input_seg_length );
-
-      std::stringstream data;
-      assert( partition % dims[1] == 0 );
-      size_t length = 0;
-      // Do not cross row boundary:
-      for(unsigned int y = 0; y < dims[1]; ++y)
-        {
-        ptrdiff_t llength = rle_encode(outbuf, n, ptr + y*dims[0], partition / dims[1] /*image_len*/);
-        if( llength < 0 )
-          {
-          std::cerr << "RLE compressor error" << std::endl;
-          return false;
-          }
-        assert( llength );
-        data.write((char*)outbuf, llength);
-        length += llength;
-        }
+      const size_t length = segments[dim * MaxNumSegments + seg].size();
       // update header
       header.Offset[1+seg] = (uint32_t)(header.Offset[seg] + length);
-
-      assert( data.str().size() == length );
-      datastr += data.str();
+      framelen += length;
       }
     header.Offset[MaxNumSegments] = 0;
-    std::stringstream os;
+    std::string str;
+    str.reserve( framelen );
     //header.Print( std::cout );
-    os.write((char*)&header,sizeof(header));
-    std::string str = os.str() + datastr;
+    str.append( (char*)&header, sizeof(header) );
+    for(unsigned int seg = 0; seg < MaxNumSegments; ++seg )
+      {
+      std::string &data = segments[dim * MaxNumSegments + seg];
+      str += data;
+      std::string().swap( data ); // release memory early
+      }
     assert( str.size() );
     Fragment frag;
     //frag.SetTag( itemStart );
@@ -529,16 +649,6 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
 
   out.SetValue( *sq );
 
-  if( buffer /*GetPixelFormat().GetBitsAllocated() > 8*/ )
-    {
-    //RequestPaddedCompositePixelCode = true;
-    delete[] buffer;
-    }
-  if ( bufferrgb /*GetPhotometricInterpretation() == PhotometricInterpretation::RGB*/ )
-    {
-    delete[] bufferrgb;
-    }
-
   return true;
 }
 
@@ -555,47 +665,387 @@ bool RLECodec::Code(DataElement const &in, DataElement &out)
 // Endif
 // Endloop
 
-size_t RLECodec::DecodeFragment(Fragment const & frag, char *buffer, unsigned long llen)
+/* return number of input bytes read. The output is always filled completely,
+ * when the input runs out (truncated stream) the missing bytes are set to 0
+ * and 'truncated' is set */
+size_t rle_decode(char *output, size_t outputlength, const char *input, size_t inputlength, bool &truncated)
 {
+  char *pout = output;
+  char * const outend = output + outputlength;
+  const char *pin = input;
+  const char * const inend = input + inputlength;
+  truncated = false;
+  while( pout != outend )
+    {
+    if( pin == inend )
+      {
+      truncated = true;
+      break;
+      }
+    const signed char byte = (signed char)*pin++;
+    const size_t room = outend - pout;
+    if( byte >= 0 /*&& byte <= 127*/ ) /* 2nd is always true */
+      {
+      size_t count = byte + 1;
+      const size_t avail = inend - pin;
+      if( count > avail )
+        {
+        // ALOKA_SSD-8-MONO2-RLE-SQ.dcm
+        truncated = true;
+        count = avail;
+        }
+      memcpy(pout, pin, std::min(count, room));
+      pout += std::min(count, room);
+      pin += count;
+      }
+    else if( byte <= -1 && byte >= -127 )
+      {
+      if( pin == inend )
+        {
+        truncated = true;
+        break;
+        }
+      const size_t count = std::min((size_t)(-byte + 1), room);
+      memset(pout, *pin++, count);
+      pout += count;
+      }
+    else /* byte == -128 */
+      {
+      assert( byte == -128 );
+      }
+    }
+  if( pout != outend )
+    {
+    memset(pout, 0, outend - pout);
+    }
+  return pin - input;
+}
 
-  std::stringstream is;
-  const ByteValue &bv = dynamic_cast<const ByteValue&>(frag.GetValue());
-  size_t bv_len = bv.GetLength();
-  char *mybuffer = new char[bv_len];
-  bv.GetBuffer(mybuffer, bv.GetLength());
-  is.write(mybuffer, bv.GetLength());
-  delete[] mybuffer;
-  std::stringstream os;
-  SetLength( llen );
-#if !defined(NDEBUG)
-  const unsigned int * const dimensions = this->GetDimensions();
-  const PixelFormat & pf = this->GetPixelFormat();
-  assert( llen == dimensions[0] * dimensions[1] * pf.GetPixelSize() );
+namespace
+{
+struct RLEFrameInfo
+{
+  const char *Data;
+  size_t Length;
+  RLEHeader Header;
+  size_t SegmentLength;
+  std::vector<size_t> ReadBytes; // per segment
+  std::vector<char> Truncated; // per segment
+};
+
+// Stage 1 of Decode: decompress one segment of one frame
+class RLEDecodeTask : public ThreadPool::Task
+{
+public:
+  std::vector<RLEFrameInfo> *Frames;
+  std::vector< std::pair<unsigned int,unsigned int> > Segments; // (frame,segment)
+  char *Output; // one slot of FrameStride bytes per frame
+  size_t FrameStride;
+  void Execute(size_t index)
+    {
+    const unsigned int f = Segments[index].first;
+    const unsigned int s = Segments[index].second;
+    RLEFrameInfo &frame = (*Frames)[f];
+    const size_t offset = frame.Header.Offset[s];
+    bool truncated;
+    frame.ReadBytes[s] = rle_decode(Output + f * FrameStride + s * frame.SegmentLength,
+      frame.SegmentLength, frame.Data + offset, frame.Length - offset, truncated);
+    frame.Truncated[s] = truncated;
+    }
+};
+
+// Stage 2 of Decode: apply the Padded Composite Pixel Code, Planar
+// Configuration... on each frame
+class RLEPostProcessTask : public ThreadPool::Task
+{
+public:
+  RLECodec *Codec;
+  std::vector<RLEFrameInfo> *Frames;
+  const char *Raw;
+  char *Output;
+  unsigned long FrameLength;
+  bool Success;
+  bool (RLECodec::*PostProcess)(const char *, size_t, char *, unsigned long);
+  void Execute(size_t f)
+    {
+    const RLEFrameInfo &frame = (*Frames)[f];
+    if( !(Codec->*PostProcess)(Raw + f * FrameLength,
+        frame.SegmentLength * frame.Header.NumSegments,
+        Output + f * FrameLength, FrameLength) )
+      {
+      Success = false;
+      }
+    }
+};
+}
+
+void RLECodec::PrepareDecode()
+{
+  // Special case:
+  assert( GetPixelFormat().GetBitsAllocated() == 32 ||
+          GetPixelFormat().GetBitsAllocated() == 16 ||
+          GetPixelFormat().GetBitsAllocated() == 8 );
+  if( GetPixelFormat().GetBitsAllocated() > 8 )
+    {
+    RequestPaddedCompositePixelCode = true;
+    }
+
+  assert( GetPixelFormat().GetSamplesPerPixel() == 3 || GetPixelFormat().GetSamplesPerPixel() == 1 );
+  // A footnote:
+  // RLE *by definition* with more than one component will have applied the
+  // Planar Configuration because it simply does not make sense to do it
+  // otherwise. So implicitely RLE is indeed PlanarConfiguration == 1. However
+  // when the image says: "hey I am PlanarConfiguration = 0 AND RLE", then
+  // apply the PlanarConfiguration internally so that people don't get lost
+  // Because GDCM internally set PlanarConfiguration == 0 by default, even if
+  // the Attribute is not sent, it will still default to 0 and we will be
+  // consistent with ourselves...
+  if( GetPixelFormat().GetSamplesPerPixel() == 3 && GetPlanarConfiguration() == 0 )
+    {
+    RequestPlanarConfiguration = true;
+    }
+}
+
+// Can ImageCodec::DecodeByStreams be replaced with PostProcessFrame in memory
+// operations ? This covers everything but byte swapping, overlay cleanup and
+// the photometric interpretations ImageCodec complains about.
+bool RLECodec::CanPostProcessInMemory() const
+{
+  if( NeedByteSwap ) return false;
+  switch(PI)
+    {
+  case PhotometricInterpretation::MONOCHROME1:
+  case PhotometricInterpretation::MONOCHROME2:
+  case PhotometricInterpretation::RGB:
+  case PhotometricInterpretation::ARGB:
+  case PhotometricInterpretation::YBR_FULL:
+  case PhotometricInterpretation::PALETTE_COLOR:
+  case PhotometricInterpretation::YBR_ICT:
+  case PhotometricInterpretation::YBR_RCT:
+    break;
+  default:
+    return false;
+    }
+  if ( PF.GetBitsAllocated() != PF.GetBitsStored()
+    && PF.GetBitsAllocated() != 8 && NeedOverlayCleanup )
+    {
+    return false;
+    }
+  return true;
+}
+
+// Same as ImageCodec::DecodeByStreams, on a single frame in memory
+bool RLECodec::PostProcessFrame(const char *raw, size_t rawlen, char *out,
+  unsigned long llen)
+{
+  std::string fallback;
+  std::vector<char> pcpc; // Padded Composite Pixel Code
+  std::vector<char> pl; // PlanarConf
+  const char *cur = raw;
+  size_t size = rawlen;
+  if( !CanPostProcessInMemory() )
+    {
+    std::stringstream is;
+    is.write(raw, rawlen);
+    std::stringstream os;
+    if( !ImageCodec::DecodeByStreams(is, os) ) return false;
+    fallback = os.str();
+    cur = fallback.c_str();
+    size = fallback.size();
+    }
+  else
+    {
+    if( RequestPaddedCompositePixelCode )
+      {
+      // D_CLUNIE_CT2_RLE.dcm
+      if( GetPixelFormat().GetBitsAllocated() == 16 )
+        {
+        const size_t half = size / 2;
+        pcpc.resize( 2 * half + 1 );
+        for(size_t i = 0; i < half; ++i)
+          {
+#ifdef GDCM_WORDS_BIGENDIAN
+          pcpc[2*i] = cur[i];
+          pcpc[2*i+1] = cur[i+half];
+#else
+          pcpc[2*i] = cur[i+half];
+          pcpc[2*i+1] = cur[i];
+#endif
+          }
+        size = 2 * half;
+        }
+      else if( GetPixelFormat().GetBitsAllocated() == 32 )
+        {
+        const size_t quarter = size / 4;
+        pcpc.resize( 4 * quarter + 1 );
+        for(size_t i = 0; i < quarter; ++i)
+          {
+#ifdef GDCM_WORDS_BIGENDIAN
+          pcpc[4*i+0] = cur[i];
+          pcpc[4*i+1] = cur[i+1*quarter];
+          pcpc[4*i+2] = cur[i+2*quarter];
+          pcpc[4*i+3] = cur[i+3*quarter];
+#else
+          pcpc[4*i+0] = cur[i+3*quarter];
+          pcpc[4*i+1] = cur[i+2*quarter];
+          pcpc[4*i+2] = cur[i+1*quarter];
+          pcpc[4*i+3] = cur[i];
 #endif
-  bool r = DecodeByStreams(is, os);
-  assert( r == true );
-  (void)r; //warning removal
-  std::streampos p = is.tellg();
-  // http://groups.google.com/group/microsoft.public.vc.stl/browse_thread/thread/96740930d0e4e6b8
-  if( !!is )
-    {
-    // Indeed the length of the RLE stream has been padded with a \0
-    // which is discarded
-    std::streamoff check = bv.GetLength() - p;
-    // check == 2 for gdcmDataExtra/gdcmSampleData/US_DataSet/GE_US/2929J686-breaker
-    assert( check == 0 || check == 1 || check == 2 );
-    if( check ) gdcmWarningMacro( "tiny offset detected in between RLE segments" );
+          }
+        size = 4 * quarter;
+        }
+      else
+        {
+        return false;
+        }
+      cur = &pcpc[0];
+      }
+    if( RequestPlanarConfiguration )
+      {
+      const size_t third = size / 3;
+      pl.resize( size + 1 );
+      const char *r = cur;
+      const char *g = cur + third;
+      const char *b = cur + third + third;
+      char *p = &pl[0];
+      for (size_t j = 0; j < third; ++j)
+        {
+        *(p++) = *(r++);
+        *(p++) = *(g++);
+        *(p++) = *(b++);
+        }
+      memcpy(p, cur + 3 * third, size - 3 * third);
+      cur = &pl[0];
+      }
+    }
+  const size_t check = std::min(size, (size_t)llen);
+  memcpy(out, cur, check);
+  if( check < llen )
+    {
+    memset(out + check, 0, llen - check);
+    }
+  return true;
+}
+
+bool RLECodec::DecodeFrames(const char * const *data, const size_t *lengths,
+  unsigned int nframes, char *buffer, unsigned long llen, bool checkpadding)
+{
+  PrepareDecode();
+  assert( llen );
+
+  // Read all the RLE headers first:
+  std::vector<RLEFrameInfo> frames( nframes );
+  RLEDecodeTask decode;
+  for(unsigned int f = 0; f < nframes; ++f)
+    {
+    RLEFrameInfo &frame = frames[f];
+    frame.Data = data[f];
+    frame.Length = lengths[f];
+    if( frame.Length < sizeof(RLEHeader) )
+      {
+      gdcmErrorMacro( "RLE frame is too short: " << frame.Length );
+      return false;
+      }
+    assert( sizeof(uint32_t)*16 == 64 );
+    assert( sizeof(RLEHeader) == 64 );
+    memcpy(&frame.Header, frame.Data, sizeof(RLEHeader));
+    SwapperNoOp::SwapArray((uint32_t*)&frame.Header,16);
+    const uint32_t numSegments = frame.Header.NumSegments;
+    if( numSegments < 1 || numSegments > 15 )
+      {
+      gdcmErrorMacro( "Invalid number of RLE segments: " << numSegments );
+      return false;
+      }
+    assert( frame.Header.Offset[0] == 64 );
+    frame.SegmentLength = llen / numSegments;
+    frame.ReadBytes.resize( numSegments );
+    frame.Truncated.resize( numSegments );
+    for(unsigned int s = 0; s < numSegments; ++s)
+      {
+      // ACUSON-24-YBR_FULL-RLE.dcm / D_CLUNIE_CT1_RLE.dcm have a \0 padding
+      // in between segments: always start at the offset of the header
+      if( frame.Header.Offset[s] < sizeof(RLEHeader)
+        || frame.Header.Offset[s] > frame.Length )
+        {
+        gdcmErrorMacro( "Invalid RLE segment offset: " << frame.Header.Offset[s] );
+        return false;
+        }
+      decode.Segments.push_back( std::make_pair(f, s) );
+      }
+    }
+
+  // No post processing at all (8bits monochrome): decode in place
+  const bool inmemory = CanPostProcessInMemory();
+  const bool direct = inmemory
+    && !RequestPaddedCompositePixelCode && !RequestPlanarConfiguration;
+  std::vector<char> raw;
+  if( !direct )
+    {
+    raw.resize( (size_t)nframes * llen );
+    }
+
+  ThreadPool pool( ComputeNumberOfThreads(NumberOfThreads,
+      decode.Segments.size(), (size_t)nframes * llen) );
+  decode.Frames = &frames;
+  decode.Output = direct ? buffer : &raw[0];
+  decode.FrameStride = llen;
+  pool.ParallelFor( decode, decode.Segments.size() );
+
+  bool success = true;
+  if( direct )
+    {
+    // Trailing bytes when llen is not a multiple of the number of segments
+    for(unsigned int f = 0; f < nframes; ++f)
+      {
+      const size_t rawlen = frames[f].SegmentLength * frames[f].Header.NumSegments;
+      memset(buffer + (size_t)f * llen + rawlen, 0, llen - rawlen);
+      }
     }
   else
     {
-    // ALOKA_SSD-8-MONO2-RLE-SQ.dcm
-    gdcmWarningMacro( "Bad RLE stream" );
+    RLEPostProcessTask post;
+    post.Codec = this;
+    post.Frames = &frames;
+    post.Raw = &raw[0];
+    post.Output = buffer;
+    post.FrameLength = llen;
+    post.Success = true;
+    post.PostProcess = &RLECodec::PostProcessFrame;
+    if( inmemory )
+      {
+      pool.ParallelFor( post, nframes );
+      }
+    else
+      {
+      // ImageCodec::DecodeByStreams is not meant to be run concurrently
+      for(unsigned int f = 0; f < nframes; ++f) post.Execute( f );
+      }
+    success = post.Success;
+    }
+
+  for(unsigned int f = 0; f < nframes; ++f)
+    {
+    const RLEFrameInfo &frame = frames[f];
+    const unsigned int last = frame.Header.NumSegments - 1;
+    bool truncated = false;
+    for(unsigned int s = 0; s <= last; ++s)
+      truncated = truncated || frame.Truncated[s];
+    if( truncated )
+      {
+      // ALOKA_SSD-8-MONO2-RLE-SQ.dcm
+      gdcmWarningMacro( "Bad RLE stream" );
+      }
+    else if( checkpadding )
+      {
+      // Indeed the length of the RLE stream has been padded with a \0
+      // which is discarded
+      const size_t end = frame.Header.Offset[last] + frame.ReadBytes[last];
+      // check == 2 for gdcmDataExtra/gdcmSampleData/US_DataSet/GE_US/2929J686-breaker
+      if( end < frame.Length )
+        gdcmWarningMacro( "tiny offset detected in between RLE segments" );
+      }
     }
-  std::string::size_type check = os.str().size();
-  // If the following assert fail expect big troubles:
-  memcpy(buffer, os.str().c_str(), check);
-//  pos += check;
-  return check;
+  return success;
 }
 
 bool RLECodec::Decode(DataElement const &in, DataElement &out)
@@ -606,17 +1056,16 @@ bool RLECodec::Decode(DataElement const &in, DataElement &out)
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if( !sf ) return false;
     unsigned long len = GetBufferLength();
-    std::stringstream is;
-    sf->WriteBuffer( is );
     SetLength( len );
-    std::stringstream os;
-    bool r = DecodeByStreams(is, os);
-    assert( r ); (void)r; //warning removal
-    std::string str = os.str();
-    std::string::size_type check = str.size();
-    assert( check == len );
-    VL::Type checkCast = (VL::Type)check;
-    out.SetByteValue( &str[0], checkCast );
+    // The RLE frame may be split over several fragments:
+    std::vector<char> is( sf->ComputeByteLength() );
+    if( is.empty() || !sf->GetBuffer(&is[0], (unsigned long)is.size()) ) return false;
+    const char *data = &is[0];
+    const size_t length = is.size();
+    std::vector<char> os( len );
+    if( !DecodeFrames(&data, &length, 1, &os[0], len, false) ) return false;
+    VL::Type checkCast = (VL::Type)len;
+    out.SetByteValue( &os[0], checkCast );
     return true;
     }
   else if ( NumberOfDimensions == 3 )
@@ -625,22 +1074,31 @@ bool RLECodec::Decode(DataElement const &in, DataElement &out)
     const SequenceOfFragments *sf = in.GetSequenceOfFragments();
     if( !sf ) return false;
     unsigned long len = GetBufferLength();
-    char *buffer = new char[len];
-    unsigned long pos = 0;
+    const unsigned int nfrags = (unsigned int)sf->GetNumberOfFragments();
+    if( !nfrags ) return false;
     // Each RLE Frame store a 2D frame. len is the 3d length
-    unsigned long llen = len / sf->GetNumberOfFragments();
+    unsigned long llen = len / nfrags;
+    SetLength( llen );
     // assert( GetNumberOfDimensions() == 2
     //      || GetDimension(2) == sf->GetNumberOfFragments() );
-    for(unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i)
+    std::vector<const char*> data( nfrags );
+    std::vector<size_t> lengths( nfrags );
+    for(unsigned int i = 0; i < nfrags; ++i)
       {
       const Fragment &frag = sf->GetFragment(i);
-      const size_t check = DecodeFragment(frag, buffer + pos, llen); (void)check;
-      assert( check == llen );
-      pos += llen;
+      const ByteValue *bv = frag.GetByteValue();
+      if( !bv ) return false;
+      data[i] = bv->GetPointer();
+      lengths[i] = bv->GetLength();
       }
-    assert( pos == len );
-    out.SetByteValue( buffer, (uint32_t)len );
-    delete[] buffer;
+#if !defined(NDEBUG)
+    const unsigned int * const dimensions = this->GetDimensions();
+    const PixelFormat & pf = this->GetPixelFormat();
+    assert( llen == dimensions[0] * dimensions[1] * pf.GetPixelSize() );
+#endif
+    std::vector<char> buffer( len );
+    if( !DecodeFrames(&data[0], &lengths[0], nfrags, &buffer[0], llen, true) ) return false;
+    out.SetByteValue( &buffer[0], (uint32_t)len );
     return true;
     }
   return false;
@@ -752,29 +1210,7 @@ bool RLECodec::DecodeByStreams(std::istream &is, std::ostream &os)
 
   unsigned long length = Length;
   assert( length );
-  // Special case:
-  assert( GetPixelFormat().GetBitsAllocated() == 32 ||
-          GetPixelFormat().GetBitsAllocated() == 16 ||
-          GetPixelFormat().GetBitsAllocated() == 8 );
-  if( GetPixelFormat().GetBitsAllocated() > 8 )
-    {
-    RequestPaddedCompositePixelCode = true;
-    }
-
-  assert( GetPixelFormat().GetSamplesPerPixel() == 3 || GetPixelFormat().GetSamplesPerPixel() == 1 );
-  // A footnote:
-  // RLE *by definition* with more than one component will have applied the
-  // Planar Configuration because it simply does not make sense to do it
-  // otherwise. So implicitely RLE is indeed PlanarConfiguration == 1. However
-  // when the image says: "hey I am PlanarConfiguration = 0 AND RLE", then
-  // apply the PlanarConfiguration internally so that people don't get lost
-  // Because GDCM internally set PlanarConfiguration == 0 by default, even if
-  // the Attribute is not sent, it will still default to 0 and we will be
-  // consistent with ourselves...
-  if( GetPixelFormat().GetSamplesPerPixel() == 3 && GetPlanarConfiguration() == 0 )
-    {
-    RequestPlanarConfiguration = true;
-    }
+  PrepareDecode();
   length /= numSegments;
   for(unsigned long i = 0; i<numSegments; ++i)
     {
@@ -32,6 +32,9 @@ class RLEInternals;
  * separately. Each frame shall be encoded in one and only one Fragment (see PS
  * 3.5.8.2).
  *
+ * \note Decode and Code work on memory buffers. The RLE segments of all the
+ * frames are decoded (resp. encoded) in parallel, see SetNumberOfThreads.
+ * DecodeByStreams is still used by ImageRegionReader.
  */
 class GDCM_EXPORT RLECodec : public ImageCodec
 {
@@ -45,6 +48,12 @@ public:
   unsigned long GetBufferLength() const { return BufferLength; }
   void SetBufferLength(unsigned long l) { BufferLength = l; }
 
+  /// Set/Get the number of threads used by Decode/Code. 0 (default) means
+  /// the number of online processors, small images are always done in the
+  /// calling thread.
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
   bool Code(DataElement const &in, DataElement &out);
   bool GetHeaderInfo(std::istream &is, TransferSyntax &ts);
   virtual ImageCodec * Clone() const;
@@ -70,7 +79,13 @@ private:
   RLEInternals *Internals;
   unsigned long Length;
   unsigned long BufferLength;
-  size_t DecodeFragment(Fragment const & frag, char *buffer, unsigned long llen);
+  unsigned int NumberOfThreads;
+  void PrepareDecode();
+  bool DecodeFrames(const char * const *frames, const size_t *lengths,
+    unsigned int nframes, char *buffer, unsigned long llen, bool checkpadding);
+  bool PostProcessFrame(const char *raw, size_t rawlen, char *out,
+    unsigned long llen);
+  bool CanPostProcessInMemory() const;
 };
 
 } // end namespace gdcm
@@ -12,6 +12,7 @@
 
 =========================================================================*/
 #include "gdcmRescaler.h"
+#include "gdcmPixelKernels.h"
 #include <limits>
 #include <stdlib.h> // abort
 #include <string.h> // memcpy
@@ -109,6 +110,54 @@ struct FImpl<TOut, double>
     }
 };
 
+// Mapping to the types handled by the vectorized kernels (see PixelKernels)
+template <typename T>
+struct KernelScalarType
+{
+  static bool Get(PixelKernels::ScalarType &) { return false; }
+};
+template <> struct KernelScalarType<int16_t>
+{
+  static bool Get(PixelKernels::ScalarType &st) { st = PixelKernels::INT16; return true; }
+};
+template <> struct KernelScalarType<uint16_t>
+{
+  static bool Get(PixelKernels::ScalarType &st) { st = PixelKernels::UINT16; return true; }
+};
+template <> struct KernelScalarType<float>
+{
+  static bool Get(PixelKernels::ScalarType &st) { st = PixelKernels::FLOAT32; return true; }
+};
+template <> struct KernelScalarType<double>
+{
+  static bool Get(PixelKernels::ScalarType &st) { st = PixelKernels::FLOAT64; return true; }
+};
+
+static bool GetKernelScalarType(PixelFormat::ScalarType pf, PixelKernels::ScalarType &st)
+{
+  switch(pf)
+    {
+  case PixelFormat::INT16:
+    st = PixelKernels::INT16;
+    break;
+  case PixelFormat::UINT16:
+    st = PixelKernels::UINT16;
+    break;
+  case PixelFormat::INT32:
+    st = PixelKernels::INT32;
+    break;
+  case PixelFormat::FLOAT32:
+    st = PixelKernels::FLOAT32;
+    break;
+  case PixelFormat::FLOAT64:
+    st = PixelKernels::FLOAT64;
+    break;
+  default:
+    return false;
+    }
+  return true;
+}
+
 PixelFormat::ScalarType ComputeBestFit(const PixelFormat &pf, double intercept, double slope)
 {
   PixelFormat::ScalarType st = PixelFormat::UNKNOWN;
@@ -210,6 +259,13 @@ void Rescaler::RescaleFunctionIntoBestFit(char *out, const TIn *in, size_t n)
     {
     output = TargetScalarType;
     }
+  // fast path: vectorized kernels, when the pair of types is handled
+  PixelKernels::ScalarType kin, kout;
+  if( KernelScalarType<TIn>::Get(kin) && GetKernelScalarType(output, kout)
+    && PixelKernels::Rescale(out, kout, in, kin, intercept, slope, n / sizeof(TIn)) )
+    {
+    return;
+    }
   switch(output)
     {
   case PixelFormat::SINGLEBIT:
@@ -252,6 +308,13 @@ void Rescaler::InverseRescaleFunctionIntoBestFit(char *out, const TIn *in, size_
   double slope = Slope;
   //PixelFormat::ScalarType output = ComputeInterceptSlopePixelType();
   PixelFormat output = ComputePixelTypeFromMinMax();
+  // fast path: vectorized kernels, when the pair of types is handled
+  PixelKernels::ScalarType kin, kout;
+  if( KernelScalarType<TIn>::Get(kin) && GetKernelScalarType(output, kout)
+    && PixelKernels::InverseRescale(out, kout, in, kin, intercept, slope, n / sizeof(TIn)) )
+    {
+    return;
+    }
   switch(output)
     {
   case PixelFormat::SINGLEBIT:
@@ -20,12 +20,53 @@
 #include "gdcmStringFilter.h"
 #include "gdcmProgressEvent.h"
 #include "gdcmFileNameEvent.h"
+#include "gdcmThreadPool.h"
 
 #include <algorithm> // std::find
 
 namespace gdcm
 {
 
+// Reads a batch of files, Scanner::Scan stores their values
+class ScannerReadTask : public ThreadPool::Task
+{
+public:
+  const Scanner *TheScanner;
+  const std::string *Filenames;
+  Tag Last;
+  std::vector<Scanner::FileValuesType> Values;
+  std::vector<char> Read;
+
+  void Execute(size_t index)
+    {
+    Reader reader;
+    const char *filename = Filenames[index].c_str();
+    assert( filename );
+    reader.SetFileName( filename );
+    bool read = false;
+    try
+      {
+      // Start reading all tags, including the 'last' one:
+      read = reader.ReadUpToTag(Last, TheScanner->SkipTags);
+      }
+    catch(std::exception & ex)
+      {
+      (void)ex;
+      gdcmWarningMacro( "Failed to read:" << filename << " with ex:" << ex.what() );
+      }
+    catch(...)
+      {
+      gdcmWarningMacro( "Failed to read:" << filename  << " with unknown error" );
+      }
+    if( read )
+      {
+      StringFilter sf;
+      sf.SetFile( reader.GetFile() );
+      TheScanner->ReadValues(sf, Values[index]);
+      Read[index] = 1;
+      }
+    }
+};
 
 Scanner::~Scanner()
 {
@@ -124,45 +165,37 @@ bool Scanner::Scan( Directory::FilenamesType const & filenames )
       if( last < privatelast ) last = privatelast;
       }
 
-    StringFilter sf;
-    Directory::FilenamesType::const_iterator it = Filenames.begin();
+    ThreadPool pool( NumberOfThreads );
+    ScannerReadTask task;
+    task.TheScanner = this;
+    task.Last = last;
+    // Batches keep the memory bounded and the progress events flowing
+    const size_t batchsize = 64 * pool.GetNumberOfThreads();
     const double progresstick = 1. / (double)Filenames.size();
     Progress = 0;
-    for(; it != Filenames.end(); ++it)
+    for( size_t first = 0; first < Filenames.size(); first += batchsize )
       {
-      Reader reader;
-      const char *filename = it->c_str();
-      assert( filename );
-      reader.SetFileName( filename );
-      bool read = false;
-      try
-        {
-        // Start reading all tags, including the 'last' one:
-        read = reader.ReadUpToTag(last, SkipTags);
-        }
-      catch(std::exception & ex)
-        {
-        (void)ex;
-        gdcmWarningMacro( "Failed to read:" << filename << " with ex:" << ex.what() );
-        }
-      catch(...)
-        {
-        gdcmWarningMacro( "Failed to read:" << filename  << " with unknown error" );
-        }
-      if( read )
+      const size_t n = std::min( batchsize, Filenames.size() - first );
+      task.Filenames = &Filenames[first];
+      task.Values.assign( n, FileValuesType() );
+      task.Read.assign( n, 0 );
+      pool.ParallelFor( task, n );
+      for( size_t i = 0; i < n; ++i )
         {
-        // Keep the mapping:
-        sf.SetFile( reader.GetFile() );
-        Scanner::ProcessPublicTag(sf, filename);
-        //Scanner::ProcessPrivateTag(sf, filename);
+        const char *filename = Filenames[first + i].c_str();
+        if( task.Read[i] )
+          {
+          // Keep the mapping:
+          StoreValues( filename, task.Values[i] );
+          }
+        Progress += progresstick;
+        ProgressEvent pe;
+        pe.SetProgress( Progress );
+        this->InvokeEvent( pe );
+        // For outside application tell which file is being processed:
+        FileNameEvent fe( filename );
+        this->InvokeEvent( fe );
         }
-      Progress += progresstick;
-      ProgressEvent pe;
-      pe.SetProgress( Progress );
-      this->InvokeEvent( pe );
-      // For outside application tell which file is being processed:
-      FileNameEvent fe( filename );
-      this->InvokeEvent( fe );
       }
     }
 
@@ -356,7 +389,13 @@ Directory::FilenamesType Scanner::GetOrderedValues(Tag const &t) const
 void Scanner::ProcessPublicTag(StringFilter &sf, const char *filename)
 {
   assert( filename );
-  TagToValue &mapping = Mappings[filename];
+  FileValuesType values;
+  ReadValues( sf, values );
+  StoreValues( filename, values );
+}
+
+void Scanner::ReadValues(StringFilter &sf, FileValuesType &values) const
+{
   const File& file = sf.GetFile();
 
   const FileMetaInformation & header = file.GetHeader();
@@ -368,51 +407,32 @@ void Scanner::ProcessPublicTag(StringFilter &sf, const char *filename)
       {
       if( header.FindDataElement( *tag ) )
         {
-        //std::string s;
-        DataElement const & de = header.GetDataElement( *tag );
-        //const ByteValue *bv = de.GetByteValue();
-        ////assert( VR::IsASCII( vr ) );
-        //if( bv ) // Hum, should I store an empty string or what ?
-        //  {
-        //  s = std::string( bv->GetPointer(), bv->GetLength() );
-        //  s.resize( std::min( s.size(), strlen( s.c_str() ) ) );
-        //  }
-        std::string s = sf.ToString(de.GetTag());
-
-        // Store the potentially new value:
-        Values.insert( s );
-        assert( Values.find( s ) != Values.end() );
-        const char *value = Values.find( s )->c_str();
-        assert( value );
-        mapping.insert(
-          TagToValue::value_type(*tag, value));
+        values.push_back( FileValuesType::value_type( *tag, sf.ToString( *tag ) ) );
         }
       }
     else
       {
       if( ds.FindDataElement( *tag ) )
         {
-        //std::string s;
-        DataElement const & de = ds.GetDataElement( *tag );
-        //const ByteValue *bv = de.GetByteValue();
-        ////assert( VR::IsASCII( vr ) );
-        //if( bv ) // Hum, should I store an empty string or what ?
-        //  {
-        //  s = std::string( bv->GetPointer(), bv->GetLength() );
-        //  s.resize( std::min( s.size(), strlen( s.c_str() ) ) );
-        //  }
-        std::string s = sf.ToString(de.GetTag());
-
-        // Store the potentially new value:
-        Values.insert( s );
-        assert( Values.find( s ) != Values.end() );
-        const char *value = Values.find( s )->c_str();
-        assert( value );
-        mapping.insert(
-          TagToValue::value_type(*tag, value));
+        values.push_back( FileValuesType::value_type( *tag, sf.ToString( *tag ) ) );
         }
       }
     } // end for
 }
 
+void Scanner::StoreValues(const char *filename, FileValuesType const &values)
+{
+  assert( filename );
+  TagToValue &mapping = Mappings[filename];
+  FileValuesType::const_iterator it = values.begin();
+  for( ; it != values.end(); ++it )
+    {
+    // Store the potentially new value:
+    const char *value = Values.insert( it->second ).first->c_str();
+    assert( value );
+    mapping.insert(
+      TagToValue::value_type(it->first, value));
+    }
+}
+
 } // end namespace gdcm
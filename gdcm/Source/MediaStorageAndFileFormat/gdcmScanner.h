@@ -23,6 +23,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <string.h> // strcmp
 
@@ -47,6 +48,10 @@ class StringFilter;
  * std::string. Then the address of the cstring underlying the std::string is
  * used in the std::map.
  *
+ * The files can be read on several threads (see SetNumberOfThreads), the
+ * values are still collected, and the events invoked, from the calling thread
+ * in the order of the files.
+ *
  * This class implement the Subject/Observer pattern trigger the following events:
  * \li ProgressEvent
  * \li StartEvent
@@ -55,8 +60,9 @@ class StringFilter;
 class GDCM_EXPORT Scanner : public Subject
 {
   friend std::ostream& operator<<(std::ostream &_os, const Scanner &s);
+  friend class ScannerReadTask;
 public:
-  Scanner():Values(),Filenames(),Mappings() {}
+  Scanner():Values(),Filenames(),Mappings(),NumberOfThreads(1) {}
   ~Scanner();
 
   /// struct to map a filename to a value
@@ -81,6 +87,11 @@ public:
   void AddSkipTag( Tag const & t );
   void ClearSkipTags();
 
+  /// Number of threads reading the files (calling thread included), 1 by
+  /// default, 0 means the number of processors
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
   /// Start the scan !
   bool Scan( Directory::FilenamesType const & filenames );
 
@@ -157,6 +168,11 @@ public:
 protected:
   void ProcessPublicTag(StringFilter &sf, const char *filename);
 private:
+  // Values of the tags found in one file
+  typedef std::vector< std::pair<Tag, std::string> > FileValuesType;
+  void ReadValues(StringFilter &sf, FileValuesType &values) const;
+  void StoreValues(const char *filename, FileValuesType const &values);
+
   // struct to store all uniq tags in ascending order:
   typedef std::set< Tag > TagsType;
   typedef std::set< PrivateTag > PrivateTagsType;
@@ -170,6 +186,7 @@ private:
   MappingType Mappings;
 
   double Progress;
+  unsigned int NumberOfThreads;
 };
 //-----------------------------------------------------------------------------
 inline std::ostream& operator<<(std::ostream &os, const Scanner &s)
@@ -0,0 +1,181 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmSeriesAnonymizer.h"
+#include "gdcmAnonymizer.h"
+#include "gdcmCryptographicMessageSyntax.h"
+#include "gdcmReader.h"
+#include "gdcmWriter.h"
+#include "gdcmMediaStorage.h"
+#include "gdcmDefs.h"
+#include "gdcmGlobal.h"
+#include "gdcmSystem.h"
+#include "gdcmThreadPool.h"
+#include "gdcmTrace.h"
+
+#include <algorithm>
+#include <string.h> // strcmp
+
+#if defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+  #include <pthread.h>
+  #define GDCM_SERIESANONYMIZER_THREADS
+#endif
+
+namespace gdcm
+{
+
+namespace {
+// The CMS providers keep state (OpenSSL structures, buffers): one call at a
+// time
+class LockedCryptographicMessageSyntax : public CryptographicMessageSyntax
+{
+public:
+  LockedCryptographicMessageSyntax(CryptographicMessageSyntax &cms):CMS(cms)
+    {
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_init(&Lock, NULL);
+#endif
+    }
+  ~LockedCryptographicMessageSyntax()
+    {
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_destroy(&Lock);
+#endif
+    }
+
+  bool ParseCertificateFile( const char *filename ) { return CMS.ParseCertificateFile( filename ); }
+  bool ParseKeyFile( const char *filename ) { return CMS.ParseKeyFile( filename ); }
+  bool SetPassword(const char * pass, size_t passLen) { return CMS.SetPassword( pass, passLen ); }
+  void SetCipherType(CipherTypes type) { CMS.SetCipherType( type ); }
+  CipherTypes GetCipherType() const { return CMS.GetCipherType(); }
+
+  bool Encrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_lock(&Lock);
+#endif
+    const bool b = CMS.Encrypt( output, outlen, array, len );
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_unlock(&Lock);
+#endif
+    return b;
+    }
+  bool Decrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_lock(&Lock);
+#endif
+    const bool b = CMS.Decrypt( output, outlen, array, len );
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+    pthread_mutex_unlock(&Lock);
+#endif
+    return b;
+    }
+
+private:
+  CryptographicMessageSyntax &CMS;
+#ifdef GDCM_SERIESANONYMIZER_THREADS
+  mutable pthread_mutex_t Lock;
+#endif
+};
+
+class AnonymizeTask : public ThreadPool::Task
+{
+public:
+  CryptographicMessageSyntax *CMS;
+  std::vector<std::string> const *Filenames;
+  std::vector<std::string> const *Outfilenames;
+  std::vector<char> *Status;
+
+  // Same steps as gdcmanon --deidentify
+  void Execute(size_t index)
+    {
+    const char *filename = (*Filenames)[index].c_str();
+    const char *outfilename = (*Outfilenames)[index].c_str();
+    Reader reader;
+    reader.SetFileName( filename );
+    if( !reader.Read() )
+      {
+      gdcmWarningMacro( "Could not read: " << filename );
+      return;
+      }
+    File &file = reader.GetFile();
+    MediaStorage ms;
+    ms.SetFromFile( file );
+    if( !Defs::GetIODNameFromMediaStorage( ms ) )
+      {
+      gdcmWarningMacro( "Media Storage not supported: " << ms << " in " << filename );
+      return;
+      }
+
+    Anonymizer anon;
+    anon.SetCryptographicMessageSyntax( CMS );
+    anon.SetFile( file );
+    if( !anon.BasicApplicationLevelConfidentialityProfile( true ) )
+      {
+      gdcmWarningMacro( "Could not de-identify: " << filename );
+      return;
+      }
+    // The SOP Instance UID changed, the header is recreated from the data set
+    file.GetHeader().Clear();
+
+    Writer writer;
+    writer.SetFileName( outfilename );
+    writer.SetFile( file );
+    if( !writer.Write() )
+      {
+      gdcmWarningMacro( "Could not write: " << outfilename );
+      if( strcmp( filename, outfilename ) != 0 )
+        {
+        System::RemoveFile( outfilename );
+        }
+      return;
+      }
+    (*Status)[index] = 1;
+    }
+};
+}
+
+bool SeriesAnonymizer::Anonymize(std::vector<std::string> const &filenames,
+  std::vector<std::string> const &outfilenames)
+{
+  Status.assign( filenames.size(), 0 );
+  if( !CMS )
+    {
+    gdcmErrorMacro( "Need a certificate" );
+    return false;
+    }
+  if( filenames.size() != outfilenames.size() )
+    {
+    gdcmErrorMacro( "As many output files as input files are needed" );
+    return false;
+    }
+  if( Global::GetInstance().GetDefs().IsEmpty() )
+    {
+    gdcmErrorMacro( "The IODs are needed, see Global::LoadResourcesFiles" );
+    return false;
+    }
+
+  LockedCryptographicMessageSyntax cms( *CMS );
+  AnonymizeTask task;
+  task.CMS = &cms;
+  task.Filenames = &filenames;
+  task.Outfilenames = &outfilenames;
+  task.Status = &Status;
+  ThreadPool pool( NumberOfThreads );
+  pool.ParallelFor( task, filenames.size() );
+
+  return std::find( Status.begin(), Status.end(), 0 ) == Status.end();
+}
+
+} // end namespace gdcm
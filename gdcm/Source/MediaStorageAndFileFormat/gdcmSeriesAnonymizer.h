@@ -0,0 +1,82 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMSERIESANONYMIZER_H
+#define GDCMSERIESANONYMIZER_H
+
+#include "gdcmTypes.h"
+
+#include <vector>
+#include <string>
+
+namespace gdcm
+{
+class CryptographicMessageSyntax;
+
+/**
+ * \brief De-identify a set of files (a series, a study...) with the Basic
+ * Application Level Confidentiality Profile, on several threads
+ *
+ * \details Each file is read, de-identified by its own Anonymizer
+ * (BasicApplicationLevelConfidentialityProfile) and written, the files being
+ * spread over a ThreadPool. The dummy UIDs and values are shared by all the
+ * Anonymizer of the process, so that the Study, Series, Frame of Reference...
+ * UIDs of the output remain consistent across the files, whichever thread
+ * processed them, and across successive calls (see
+ * Anonymizer::ClearInternalUIDs).
+ *
+ * The CryptographicMessageSyntax encrypting the original attributes is
+ * shared by the threads: its Encrypt is called under a lock (the providers
+ * keep state), the rest of the work runs concurrently.
+ *
+ * \see Anonymizer
+ */
+class GDCM_EXPORT SeriesAnonymizer
+{
+public:
+  SeriesAnonymizer():CMS(NULL),NumberOfThreads(0) {}
+
+  /// Certificate used to encrypt the original attributes, required
+  void SetCryptographicMessageSyntax(CryptographicMessageSyntax *cms) { CMS = cms; }
+
+  /// Number of threads (calling thread included), 0 (default) means the
+  /// number of processors
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
+  /// De-identify filenames[i] into outfilenames[i] (which can be the same
+  /// file). Return true when every file was de-identified, see IsAnonymized
+  /// otherwise. An output file that could not be written is removed, unless it
+  /// is the input.
+  /// The resources (Part3.xml) must have been loaded, see
+  /// Global::LoadResourcesFiles
+  bool Anonymize(std::vector<std::string> const &filenames,
+    std::vector<std::string> const &outfilenames);
+  /// De-identify the files in place
+  bool Anonymize(std::vector<std::string> const &filenames)
+    {
+    return Anonymize(filenames, filenames);
+    }
+
+  /// Outcome of file i of the last Anonymize call
+  bool IsAnonymized(size_t i) const { return i < Status.size() && Status[i] != 0; }
+
+private:
+  CryptographicMessageSyntax *CMS;
+  unsigned int NumberOfThreads;
+  std::vector<char> Status;
+};
+
+} // end namespace gdcm
+
+#endif //GDCMSERIESANONYMIZER_H
@@ -16,6 +16,7 @@
 #include "gdcmSerieHelper.h"
 #include "gdcmFile.h"
 #include "gdcmReader.h"
+#include "gdcmThreadPool.h"
 
 #include <map>
 #include <algorithm>
@@ -26,6 +27,7 @@ namespace gdcm
 Sorter::Sorter()
 {
   SortFunc = NULL;
+  NumberOfThreads = 0;
 }
 
 
@@ -61,9 +63,43 @@ public:
     SortFunc = sf;
     }
 };
+
+// Read file i into Files[i], each one with its own Reader
+class SorterReadTask : public ThreadPool::Task
+{
+public:
+  const std::string *Filenames;
+  const std::set<Tag> *Tags;
+  std::vector< SmartPointer<FileWithName> > Files;
+
+  void Execute(size_t index)
+    {
+    Reader reader;
+    reader.SetFileName( Filenames[index].c_str() );
+    bool read;
+    if( Tags->empty() )
+      {
+      // everything, the Pixel Data excluded
+      std::set<Tag> skip;
+      skip.insert( Tag(0x7fe0,0x0010) );
+      read = reader.ReadUpToTag( Tag(0x7fe0,0x0010), skip );
+      }
+    else
+      {
+      read = reader.ReadSelectedTags( *Tags );
+      }
+    if( read )
+      {
+      SmartPointer<FileWithName> f = new FileWithName( reader.GetFile() );
+      f->GetHeader().Clear(); // the sort function only gets the DataSet
+      f->filename = Filenames[index];
+      Files[index] = f;
+      }
+    }
+};
 }
 
-bool Sorter::StableSort(std::vector<std::string> const & filenames)
+bool Sorter::ReadAndSort(std::vector<std::string> const & filenames, bool stable)
 {
   // BUG: I cannot clear Filenames since input filenames could also be the output of ourself...
   // Filenames.clear();
@@ -73,33 +109,34 @@ bool Sorter::StableSort(std::vector<std::string> const & filenames)
     return true;
     }
 
-  std::vector< SmartPointer<FileWithName> > filelist;
-  filelist.resize( filenames.size() );
-
-  std::vector< SmartPointer<FileWithName> >::iterator it2 = filelist.begin();
-  for( Directory::FilenamesType::const_iterator it = filenames.begin();
-    it != filenames.end() && it2 != filelist.end(); ++it, ++it2)
+  SorterReadTask task;
+  task.Filenames = &filenames[0];
+  task.Tags = &TagsToRead;
+  task.Files.resize( filenames.size() );
+  ThreadPool pool( NumberOfThreads );
+  pool.ParallelFor( task, filenames.size() );
+  for( size_t i = 0; i < filenames.size(); ++i )
     {
-    gdcm::Reader reader;
-    reader.SetFileName( it->c_str() );
-    SmartPointer<FileWithName> &f = *it2;
-    if( reader.Read() )
+    if( !task.Files[i] )
       {
-      f = new FileWithName( reader.GetFile() );
-      f->filename = *it;
-      }
-    else
-      {
-      gdcmErrorMacro( "File could not be read: " << it->c_str() );
+      gdcmErrorMacro( "File could not be read: " << filenames[i].c_str() );
+      if( !stable ) Filenames.clear();
       return false;
       }
     }
+
+  std::vector< SmartPointer<FileWithName> > &filelist = task.Files;
   SortFunctor sf;
   sf = Sorter::SortFunc;
-  std::stable_sort( filelist.begin(), filelist.end(), sf);
+  if( stable )
+    std::stable_sort( filelist.begin(), filelist.end(), sf);
+  else
+    std::sort( filelist.begin(), filelist.end(), sf);
 
   Filenames.clear(); // cleanup any previous call
-  for(it2 = filelist.begin(); it2 != filelist.end(); ++it2 )
+  Filenames.reserve( filelist.size() );
+  std::vector< SmartPointer<FileWithName> >::const_iterator it2 = filelist.begin();
+  for( ; it2 != filelist.end(); ++it2 )
     {
     SmartPointer<FileWithName> const & f = *it2;
     Filenames.push_back( f->filename );
@@ -108,46 +145,14 @@ bool Sorter::StableSort(std::vector<std::string> const & filenames)
   return true;
 }
 
-bool Sorter::Sort(std::vector<std::string> const & filenames)
+bool Sorter::StableSort(std::vector<std::string> const & filenames)
 {
-  (void)filenames;
-  Filenames.clear();
-
-  if( filenames.empty() || !SortFunc ) return true;
-
-  std::vector< SmartPointer<FileWithName> > filelist;
-  filelist.resize( filenames.size() );
-
-  std::vector< SmartPointer<FileWithName> >::iterator it2 = filelist.begin();
-  for( Directory::FilenamesType::const_iterator it = filenames.begin();
-    it != filenames.end() && it2 != filelist.end(); ++it, ++it2)
-    {
-    gdcm::Reader reader;
-    reader.SetFileName( it->c_str() );
-    SmartPointer<FileWithName> &f = *it2;
-    if( reader.Read() )
-      {
-      f = new FileWithName( reader.GetFile() );
-      f->filename = *it;
-      }
-    else
-      {
-      gdcmErrorMacro( "File could not be read: " << it->c_str() );
-      return false;
-      }
-    }
-  //std::sort( filelist.begin(), filelist.end(), Sorter::SortFunc);
-  SortFunctor sf;
-  sf = Sorter::SortFunc;
-  std::sort( filelist.begin(), filelist.end(), sf);
-
-  for(it2 = filelist.begin(); it2 != filelist.end(); ++it2 )
-    {
-    SmartPointer<FileWithName> const & f = *it2;
-    Filenames.push_back( f->filename );
-    }
+  return ReadAndSort( filenames, true );
+}
 
-  return true;
+bool Sorter::Sort(std::vector<std::string> const & filenames)
+{
+  return ReadAndSort( filenames, false );
 }
 
 bool Sorter::AddSelect( Tag const &tag, const char *value )
@@ -20,6 +20,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 
 namespace gdcm
 {
@@ -33,6 +34,12 @@ class DataSet;
  * \warning implementation details. For now there is no cache mechanism. Which means
  * that everytime you call Sort, all files specified as input paramater are *read*
  *
+ * The files are read on several threads (see SetNumberOfThreads), the sort
+ * function is only called from the calling thread. Only the attributes the
+ * sort function needs are kept in memory when they are given with
+ * SetTagsToRead, which is what makes sorting series of thousands of images
+ * affordable; otherwise everything but the Pixel Data is read.
+ *
  * \see Scanner
  */
 class GDCM_EXPORT Sorter
@@ -61,11 +68,26 @@ public:
 
   virtual bool StableSort(std::vector<std::string> const & filenames);
 
+  /// Attributes the sort function compares, the only ones read. Empty
+  /// (default) means all of them but the Pixel Data
+  void SetTagsToRead(std::set<Tag> const &tags) { TagsToRead = tags; }
+  std::set<Tag> const &GetTagsToRead() const { return TagsToRead; }
+
+  /// Number of threads reading the files (calling thread included), 0
+  /// (default) means the number of processors
+  void SetNumberOfThreads(unsigned int n) { NumberOfThreads = n; }
+  unsigned int GetNumberOfThreads() const { return NumberOfThreads; }
+
 protected:
   std::vector<std::string> Filenames;
   typedef std::map<Tag,std::string> SelectionMap;
   std::map<Tag,std::string> Selection;
   SortFunction SortFunc;
+  std::set<Tag> TagsToRead;
+  unsigned int NumberOfThreads;
+
+private:
+  bool ReadAndSort(std::vector<std::string> const & filenames, bool stable);
 };
 //-----------------------------------------------------------------------------
 inline std::ostream& operator<<(std::ostream &os, const Sorter &s)
@@ -26,6 +26,10 @@ namespace gdcm
 //-----------------------------------------------------------------------------
 StringFilter::StringFilter():F(new File)
 {
+  for(unsigned int i = 0; i < sizeof(Cache) / sizeof(Cache[0]); ++i)
+    {
+    Cache[i].Entry = NULL;
+    }
 }
 //-----------------------------------------------------------------------------
 StringFilter::~StringFilter()
@@ -40,9 +44,30 @@ void StringFilter::SetDicts(const Dicts &dicts)
 
 std::string StringFilter::ToString(const Tag& t) const
 {
+  // Most values fit, and the dictionary name is not needed
+  char buffer[256];
+  const size_t n = ToString(t, buffer, sizeof(buffer));
+  if( n < sizeof(buffer) )
+    {
+    return std::string(buffer, n);
+    }
   return ToStringPair(t).second;
 }
 
+size_t StringFilter::ToString(const Tag& t, char *buffer, size_t len) const
+{
+  if( t.GetGroup() == 0x2 )
+    {
+    const FileMetaInformation &header = GetFile().GetHeader();
+    return ToString(t, header, buffer, len);
+    }
+  else
+    {
+    const DataSet &ds = GetFile().GetDataSet();
+    return ToString(t, ds, buffer, len);
+    }
+}
+
 /*
 std::string StringFilter::ToMIME64(const Tag& t) const
 {
@@ -310,18 +335,110 @@ bool StringFilter::ExecuteQuery(std::string const & query_const,
   return true;
 }
 
-std::pair<std::string, std::string> StringFilter::ToStringPair(const Tag& t, DataSet const &ds) const
+namespace {
+// Appends to a caller buffer, counting what did not fit
+class BufferWriter
+{
+public:
+  BufferWriter(char *buffer, size_t len):Buffer(buffer),Length(len),Size(0) {}
+  void Append(const char *s, size_t n)
+    {
+    if( Size + 1 < Length )
+      {
+      const size_t room = Length - 1 - Size;
+      memcpy( Buffer + Size, s, n < room ? n : room );
+      }
+    Size += n;
+    }
+  size_t Close()
+    {
+    if( Length )
+      {
+      Buffer[ Size < Length ? Size : Length - 1 ] = 0;
+      }
+    return Size;
+    }
+private:
+  char *Buffer;
+  size_t Length;
+  size_t Size;
+};
+
+// Same output as std::ostream << value, for the integer VR
+template <typename T>
+void AppendIntegers(BufferWriter &w, const ByteValue &bv)
+{
+  const size_t n = bv.GetLength() / sizeof(T);
+  const char *p = bv.GetPointer();
+  for( size_t i = 0; i < n; ++i )
+    {
+    T v;
+    memcpy( &v, p + i * sizeof(T), sizeof(T) );
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *d = end;
+    const int64_t sv = v;
+    const bool negative = sv < 0;
+    uint64_t u = negative ? (uint64_t)0 - (uint64_t)sv : (uint64_t)sv;
+    do
+      {
+      *--d = (char)('0' + u % 10);
+      u /= 10;
+      } while( u );
+    if( negative ) *--d = '-';
+    if( i ) w.Append( "\\", 1 );
+    w.Append( d, (size_t)(end - d) );
+    }
+}
+
+bool IsIntegerVR(VR const &vr)
+{
+  return vr == VR::US || vr == VR::SS || vr == VR::UL || vr == VR::SL;
+}
+
+void AppendIntegers(BufferWriter &w, VR const &vr, const ByteValue &bv)
+{
+  switch(vr)
+    {
+  case VR::US:
+    AppendIntegers<uint16_t>(w, bv);
+    break;
+  case VR::SS:
+    AppendIntegers<int16_t>(w, bv);
+    break;
+  case VR::UL:
+    AppendIntegers<uint32_t>(w, bv);
+    break;
+  case VR::SL:
+    AppendIntegers<int32_t>(w, bv);
+    break;
+  default:
+    assert(0);
+    }
+}
+
+inline unsigned int CacheIndex(const Tag &t)
+{
+  return (t.GetElementTag() * 2654435761u) >> 26;
+}
+}
+
+const DictEntry &StringFilter::GetDictEntry(const Tag& t, DataSet const &ds) const
 {
-  std::pair<std::string, std::string> ret;
   const Global &g = GlobalInstance;
   const Dicts &dicts = g.GetDicts();
-  if( ds.IsEmpty() || !ds.FindDataElement(t) )
+  // The entries of the public dictionary do not move, the group lengths and
+  // the private tags may be returned in a shared DictEntry
+  if( t.IsPublic() && !t.IsGroupLength() )
     {
-    gdcmDebugMacro( "DataSet is empty or does not contains tag:" );
-    return ret;
+    CachedDictEntry &c = Cache[ CacheIndex(t) ];
+    if( !c.Entry || c.T != t )
+      {
+      c.T = t;
+      c.Entry = &dicts.GetDictEntry(t);
+      }
+    return *c.Entry;
     }
-  const DataElement &de = ds.GetDataElement( t );
-  //assert( de.GetTag().IsPublic() );
   std::string strowner;
   const char *owner = 0;
   if( t.IsPrivate() && !t.IsPrivateCreator() )
@@ -329,16 +446,18 @@ std::pair<std::string, std::string> StringFilter::ToStringPair(const Tag& t, Dat
     strowner = ds.GetPrivateCreator(t);
     owner = strowner.c_str();
     }
+  return dicts.GetDictEntry(t, owner);
+}
 
-  const DictEntry &entry = dicts.GetDictEntry(de.GetTag(), owner);
-
+VR StringFilter::GetVR(const DataElement &de, const DictEntry &entry, DataSet const &ds) const
+{
   const VR &vr_read = de.GetVR();
   const VR &vr_dict = entry.GetVR();
 
   if( vr_dict == VR::INVALID )
     {
     // FIXME This is a public element we do not support...
-    return ret;
+    return VR::INVALID;
     }
 
   VR vr;
@@ -357,12 +476,73 @@ std::pair<std::string, std::string> StringFilter::ToStringPair(const Tag& t, Dat
     }
   if( vr.IsDual() ) // This mean vr was read from a dict entry:
     {
-    vr = DataSetHelper::ComputeVR(*F,ds, t);
+    vr = DataSetHelper::ComputeVR(*F,ds, de.GetTag());
     }
 
   if( vr == VR::UN )
     {
     // this element is not known...
+    return VR::INVALID;
+    }
+  return vr;
+}
+
+size_t StringFilter::ToString(const Tag& t, DataSet const &ds, char *buffer, size_t len) const
+{
+  BufferWriter w(buffer, len);
+  // One lookup: GetDataElement returns a (ffff,ffff) element when t is not
+  // found
+  const DataElement &de = ds.GetDataElement( t );
+  if( de.GetTag() != t || t == Tag(0xffff,0xffff) )
+    {
+    return w.Close();
+    }
+  const VR vr = GetVR(de, GetDictEntry(t, ds), ds);
+  if( vr == VR::INVALID )
+    {
+    return w.Close();
+    }
+  const ByteValue *bv = de.GetByteValue();
+  if( VR::IsASCII( vr ) )
+    {
+    if( de.GetVL() && bv )
+      {
+      // Let's remove any trailing \0 :
+      const char *p = bv->GetPointer();
+      const size_t n = bv->GetLength();
+      const char *end = (const char*)memchr( p, 0, n );
+      w.Append( p, end ? (size_t)(end - p) : n );
+      }
+    }
+  else if( IsIntegerVR( vr ) )
+    {
+    if( bv )
+      {
+      AppendIntegers(w, vr, *bv);
+      }
+    }
+  else
+    {
+    const std::string s = ToStringPair(t, ds).second;
+    w.Append( s.c_str(), s.size() );
+    }
+  return w.Close();
+}
+
+std::pair<std::string, std::string> StringFilter::ToStringPair(const Tag& t, DataSet const &ds) const
+{
+  std::pair<std::string, std::string> ret;
+  if( ds.IsEmpty() || !ds.FindDataElement(t) )
+    {
+    gdcmDebugMacro( "DataSet is empty or does not contains tag:" );
+    return ret;
+    }
+  const DataElement &de = ds.GetDataElement( t );
+  //assert( de.GetTag().IsPublic() );
+  const DictEntry &entry = GetDictEntry(t, ds);
+  VR vr = GetVR(de, entry, ds);
+  if( vr == VR::INVALID )
+    {
     return ret;
     }
 
@@ -41,6 +41,15 @@ public:
   /// Convert to string the ByteValue contained in a DataElement
   std::string ToString(const Tag& t) const;
 
+  /// Convert to string the ByteValue contained in a DataElement, without
+  /// allocation: same value as ToString written to buffer, NUL terminated and
+  /// truncated to len - 1 characters. Return the length of the complete value
+  /// (as snprintf: buffer was too small when the return value is >= len), 0
+  /// when t is not found or cannot be converted.
+  /// The ASCII VR (CS, LO, PN, DA, UI, IS, DS...) and the integer VR (US, SS,
+  /// UL, SL) are converted in place, the other ones go through ToString.
+  size_t ToString(const Tag& t, char *buffer, size_t len) const;
+
   //std::string ToMime64(const Tag& t) const;
 
   /// Convert to string the ByteValue contained in a DataElement
@@ -72,7 +81,19 @@ protected:
   bool ExecuteQuery(std::string const &query, DataSet const &ds, std::string & value) const;
 
 private:
+  const DictEntry &GetDictEntry(const Tag& t, DataSet const &ds) const;
+  VR GetVR(const DataElement &de, const DictEntry &entry, DataSet const &ds) const;
+  size_t ToString(const Tag& t, DataSet const &ds, char *buffer, size_t len) const;
+
   SmartPointer<File> F;
+  // The public dictionary entries of the last tags converted, indexed by a
+  // hash of the tag: the scanners ask for the same few tags on every file
+  struct CachedDictEntry
+    {
+    Tag T;
+    const DictEntry *Entry;
+    };
+  mutable CachedDictEntry Cache[64];
 };
 
 } // end namespace gdcm
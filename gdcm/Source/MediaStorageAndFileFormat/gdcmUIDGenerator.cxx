@@ -33,9 +33,116 @@
 #include <rpc.h>
 #endif
 
+// Per thread pools of random bytes, see GenerateUUID
+#if defined(HAVE_UUID_GENERATE) && defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define GDCM_UIDGENERATOR_POOLS
+#endif
+
 namespace gdcm
 {
 
+#ifdef GDCM_UIDGENERATOR_POOLS
+namespace {
+/*
+ * uuid_generate opens /dev/urandom in an unprotected static, calls rand()
+ * (a lock in most libc) and does one read() per UUID. Instead each thread
+ * keeps its own buffer of random bytes, one read() fills it for 256 version
+ * 4 UUIDs. No state is shared between the threads once the device is open.
+ */
+struct EntropyPool
+{
+  unsigned char Bytes[4096];
+  size_t Used;
+  unsigned int Generation;
+};
+
+pthread_once_t PoolsOnce = PTHREAD_ONCE_INIT;
+pthread_key_t PoolKey;
+int RandomFd = -1;
+pthread_mutex_t FallbackLock = PTHREAD_MUTEX_INITIALIZER;
+// A forked child starts with a copy of the parent's pools: it must not hand
+// out the same UUIDs
+volatile unsigned int ForkGeneration = 0;
+
+void DeletePool(void *pool)
+{
+  delete static_cast<EntropyPool*>(pool);
+}
+
+void ForkChild()
+{
+  ++ForkGeneration;
+}
+
+void InitPools()
+{
+  if( pthread_key_create(&PoolKey, DeletePool) != 0 ) return;
+  RandomFd = open("/dev/urandom", O_RDONLY);
+  if( RandomFd >= 0 )
+    {
+    fcntl(RandomFd, F_SETFD, FD_CLOEXEC);
+    pthread_atfork(NULL, NULL, ForkChild);
+    }
+}
+
+bool FillPool(EntropyPool &pool)
+{
+  size_t n = 0;
+  while( n < sizeof(pool.Bytes) )
+    {
+    const ssize_t r = read(RandomFd, pool.Bytes + n, sizeof(pool.Bytes) - n);
+    if( r <= 0 ) return false;
+    n += r;
+    }
+  pool.Used = 0;
+  pool.Generation = ForkGeneration;
+  return true;
+}
+
+bool PoolUUID(unsigned char *uuid_data)
+{
+  pthread_once(&PoolsOnce, InitPools);
+  if( RandomFd < 0 )
+    {
+    // No device, the time based UUID of uuid_generate, which keeps static
+    // state
+    pthread_mutex_lock(&FallbackLock);
+    uuid_t g;
+    uuid_generate(g);
+    pthread_mutex_unlock(&FallbackLock);
+    memcpy(uuid_data, g, sizeof(uuid_t));
+    return true;
+    }
+  EntropyPool *pool = static_cast<EntropyPool*>(pthread_getspecific(PoolKey));
+  if( !pool )
+    {
+    pool = new EntropyPool;
+    pool->Used = sizeof(pool->Bytes);
+    if( pthread_setspecific(PoolKey, pool) != 0 )
+      {
+      delete pool;
+      return false;
+      }
+    }
+  if( pool->Used + 16 > sizeof(pool->Bytes) || pool->Generation != ForkGeneration )
+    {
+    if( !FillPool(*pool) ) return false;
+    }
+  memcpy(uuid_data, pool->Bytes + pool->Used, 16);
+  // Do not keep handed out bytes around
+  memset(pool->Bytes + pool->Used, 0, 16);
+  pool->Used += 16;
+  // RFC 4122 version 4 (random), as uuid_generate_random
+  uuid_data[6] = (unsigned char)((uuid_data[6] & 0x0F) | 0x40);
+  uuid_data[8] = (unsigned char)((uuid_data[8] & 0x3F) | 0x80);
+  return true;
+}
+}
+#endif
+
 /*
  * This is just plain bad luck. GDCM UID root is 26 byte long
  * And all implementation of the DCE UUID (Theodore Y. Ts'o)
@@ -98,25 +205,32 @@ Since implementation is only playing with the first 8bits of the upper
 */
 const char* UIDGenerator::Generate()
 {
-  Unique = GetRoot();
+  Unique = GenerateUID();
+  if( Unique.empty() ) return NULL;
+  return Unique.c_str();
+}
+
+std::string UIDGenerator::GenerateUID()
+{
+  std::string uid = GetRoot();
   // We choose here a value of 26 so that we can still have 37 bytes free to
   // set the suffix part which is sufficient to store a 2^(128-8+1)-1 number
-  if( Unique.empty() || Unique.size() > 62 ) // 62 is simply the highest possible limit
+  if( uid.empty() || uid.size() > 62 ) // 62 is simply the highest possible limit
     {
     // I cannot go any further...
-    return NULL;
+    return std::string();
     }
   unsigned char uuid[16];
   bool r = UIDGenerator::GenerateUUID(uuid);
   // This should only happen in some obscure cases. Since the creation of UUID failed
   // I should try to go any further and make sure the user's computer crash and burn
   // right away
-  if( !r ) return 0;
+  if( !r ) return std::string();
   char randbytesbuf[64];
   size_t len = System::EncodeBytes(randbytesbuf, uuid, sizeof(uuid));
   assert( len < 64 ); // programmer error
-  Unique += "."; // This dot is compulsary to separate root from suffix
-  if( Unique.size() + len > 64 )
+  uid += "."; // This dot is compulsary to separate root from suffix
+  if( uid.size() + len > 64 )
     {
     int idx = 0;
     bool found = false;
@@ -126,14 +240,14 @@ const char* UIDGenerator::Generate()
       // too bad ! randbytesbuf is too long, let's try to truncate the high bits a little
       x = uuid[idx];
       unsigned int i = 0;
-      while( ( Unique.size() + len > 64 ) && i < 8 )
+      while( ( uid.size() + len > 64 ) && i < 8 )
         {
         x[7-i] = 0;
         uuid[idx] = (unsigned char)x.to_ulong();
         len = System::EncodeBytes(randbytesbuf, uuid, sizeof(uuid));
         ++i;
         }
-      if( ( Unique.size() + len > 64 ) && i == 8 )
+      if( ( uid.size() + len > 64 ) && i == 8 )
         {
         // too bad only reducing the 8 bits from uuid[idx] was not enought,
         // let's set to zero the following bits...
@@ -150,22 +264,24 @@ const char* UIDGenerator::Generate()
       // Technically this could only happen when root has a length >= 64 ... is it
       // even remotely possible ?
       gdcmWarningMacro( "Root is too long for current implementation" );
-      return NULL;
+      return std::string();
       }
     }
   // can now safely use randbytesbuf as is, no need to truncate any more:
-  Unique += randbytesbuf;
+  uid += randbytesbuf;
 
-  assert( IsValid( Unique.c_str() ) );
+  assert( IsValid( uid.c_str() ) );
 
-  return Unique.c_str();
+  return uid;
 }
 
 
 /* return true on success */
 bool UIDGenerator::GenerateUUID(unsigned char *uuid_data)
 {
-#if defined(HAVE_UUID_GENERATE)
+#if defined(GDCM_UIDGENERATOR_POOLS)
+  return PoolUUID(uuid_data);
+#elif defined(HAVE_UUID_GENERATE)
   uuid_t g;
   uuid_generate(g);
   memcpy(uuid_data, g, sizeof(uuid_t));
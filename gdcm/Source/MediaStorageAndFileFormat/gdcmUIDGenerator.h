@@ -16,6 +16,8 @@
 
 #include "gdcmTypes.h"
 
+#include <string>
+
 namespace gdcm
 {
 
@@ -53,6 +55,7 @@ public:
   /// function will return a string), but will truncate the high bits of the 128bits UUID until the
   /// generated string fits on 64 bits. The authors disclaims any
   /// responsabitlity for garanteeing uniqueness of UIDs when the root is longer than 26 bytes.
+  /// SetRoot is not thread safe: call it before any thread generates a UID.
   static void SetRoot(const char * root);
   static const char *GetRoot();
 
@@ -64,6 +67,13 @@ public:
   /// since uid1 == uid2
   const char* Generate();
 
+  /// Reentrant version of Generate(): the UID is returned by value and
+  /// several threads can call it at once, without any lock. Each thread
+  /// draws its UUIDs from its own pool of random bytes, refilled from the
+  /// system entropy source a few hundred UUIDs at a time.
+  /// Return an empty string on error.
+  static std::string GenerateUID();
+
   /// Find out if the string is a valid UID or not
   /// \todo: Move that in DataStructureAndEncoding (see FileMetaInformation::CheckFileMetaInformation)
   static bool IsValid(const char *uid);
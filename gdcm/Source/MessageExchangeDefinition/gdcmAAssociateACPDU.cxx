@@ -188,6 +188,13 @@ void AAssociateACPDU::AddPresentationContextAC( PresentationContextAC const &pca
   assert( PDULength + 4 + 1 + 1 == Size() );
 }
 
+void AAssociateACPDU::SetUserInformation( UserInformation const & ui )
+{
+  UserInfo = ui;
+  PDULength = (uint32_t)(Size() - 6);
+  assert( (PDULength + 4 + 1 + 1) == Size() );
+}
+
 void AAssociateACPDU::Print(std::ostream &os) const
 {
   os << "ProtocolVersion: " << std::hex << ProtocolVersion << std::dec << std::endl;
@@ -52,6 +52,7 @@ public:
     return PresContextAC.size();
   }
   const UserInformation &GetUserInformation() const { return UserInfo; }
+  void SetUserInformation( UserInformation const & ui );
 
   SizeType Size() const;
 
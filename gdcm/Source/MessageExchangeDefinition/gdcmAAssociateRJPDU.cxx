@@ -24,10 +24,11 @@ const uint8_t AAssociateRJPDU::Reserved8 = 0x00;
 
 AAssociateRJPDU::AAssociateRJPDU()
 {
-  ItemLength = 0;
-  Result = 0;
-  Source = 0;
-  Reason = 0; // diag ?
+  ItemLength = 4;
+  // rejected-permanent, service-user, no-reason-given
+  Result = 1;
+  Source = 1;
+  Reason = 1; // diag ?
 }
 
 std::istream &AAssociateRJPDU::Read(std::istream &is)
@@ -60,6 +61,18 @@ std::istream &AAssociateRJPDU::Read(std::istream &is)
 
 const std::ostream &AAssociateRJPDU::Write(std::ostream &os) const
 {
+  os.write( (char*)&ItemType, sizeof(ItemType) );
+  os.write( (char*)&Reserved2, sizeof(Reserved2) );
+  uint32_t copy = ItemLength;
+  SwapperDoOp::SwapArray(&copy,1);
+  os.write( (char*)&copy, sizeof(ItemLength) );
+  os.write( (char*)&Reserved8, sizeof(Reserved8) );
+  os.write( (char*)&Result, sizeof(Result) );
+  os.write( (char*)&Source, sizeof(Source) );
+  os.write( (char*)&Reason, sizeof(Reason) );
+
+  assert( ItemLength + 6 == Size() );
+
   return os;
 }
 
@@ -81,11 +94,11 @@ static const char *PrintSourceAsString( uint8_t source )
 {
   switch( source )
     {
-  case 0x0:
-    return "DICOM UL service-user";
   case 0x1:
-    return "DICOM UL service-provider (ACSE related function)";
+    return "DICOM UL service-user";
   case 0x2:
+    return "DICOM UL service-provider (ACSE related function)";
+  case 0x3:
     return "DICOM UL service-provider (Presentation related function)";
     }
   assert( 0 );
@@ -37,6 +37,16 @@ public:
   void Print(std::ostream &os) const;
   size_t Size() const;
   bool IsLastFragment() const { return true; }
+
+  /// Table 9-21: 1 rejected-permanent, 2 rejected-transient
+  void SetResult( uint8_t result ) { Result = result; }
+  uint8_t GetResult() const { return Result; }
+  /// 1 service-user, 2 service-provider (ACSE), 3 service-provider (Presentation)
+  void SetSource( uint8_t source ) { Source = source; }
+  uint8_t GetSource() const { return Source; }
+  /// Meaning depends on Source, e.g. 7 called-AE-title-not-recognized for 1
+  void SetReason( uint8_t reason ) { Reason = reason; }
+  uint8_t GetReason() const { return Reason; }
 private:
   static const uint8_t ItemType; // PDUType ?
   static const uint8_t Reserved2;
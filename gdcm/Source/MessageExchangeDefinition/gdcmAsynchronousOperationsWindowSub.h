@@ -39,6 +39,13 @@ public:
   size_t Size() const;
   void Print(std::ostream &os) const;
 
+  /// Maximum number of outstanding operations the association-requestor may
+  /// invoke (resp. perform) asynchronously. 0 means unlimited.
+  void SetMaximumNumberOperationsInvoked(uint16_t n) { MaximumNumberOperationsInvoked = n; }
+  uint16_t GetMaximumNumberOperationsInvoked() const { return MaximumNumberOperationsInvoked; }
+  void SetMaximumNumberOperationsPerformed(uint16_t n) { MaximumNumberOperationsPerformed = n; }
+  uint16_t GetMaximumNumberOperationsPerformed() const { return MaximumNumberOperationsPerformed; }
+
 private:
   static const uint8_t ItemType;
   static const uint8_t Reserved2;
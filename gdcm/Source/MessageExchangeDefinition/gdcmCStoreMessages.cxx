@@ -44,15 +44,13 @@ public:
 
 namespace network{
 
-std::vector<PresentationDataValue> CStoreRQ::ConstructPDV(
+PresentationDataValue CStoreRQ::ConstructCommandPDV(
 const ULConnection &inConnection, File const & file )
 {
 const DataSet* inDataSet = &file.GetDataSet();
 
-  std::vector<PresentationDataValue> thePDVs;
   PresentationContextRQ pc( UIDs::VerificationSOPClass );
   uint8_t prescontid;
-{
   assert( inDataSet );
   PresentationDataValue thePDV;
 #if 0
@@ -107,9 +105,12 @@ const DataSet* inDataSet = &file.GetDataSet();
   std::string tsuid = fmits.GetString();
 
   prescontid = inConnection.GetPresentationContextIDFromPresentationContext(pc);
-  // prescontid cannot possibly be unknown since we are only looking in our own
-  // AAssociateRQPDU
-  assert( prescontid != 0 );
+  // prescontid is unknown when the SOP Class / Transfer Syntax of the file was
+  // not part of our AAssociateRQPDU
+  if( prescontid == 0 )
+    {
+    throw Exception("No Presentation Context proposed for this file.");
+    }
   const PresentationContextRQ * rqpc = inConnection.GetPresentationContextRQByID(prescontid);
   assert( rqpc );
 
@@ -122,7 +123,7 @@ const DataSet* inDataSet = &file.GetDataSet();
   // ADV: technically we could use an explicit VR encoded dataset and send it over
   // an implicit TS accecpted Transfer syntax. However thing do not interchange well
   // so we really need a filter to check whether conversion is ok or not.
-  if( acpc == 0 )
+  if( acpc == 0 || acpc->GetReason() != 0 )
     {
     // Technically we should fallback to something else. Anyway lets' give up
     // and hope the user will convert the encapsulated stream to something else...
@@ -184,11 +185,9 @@ const DataSet* inDataSet = &file.GetDataSet();
   Attribute<0x0,0x100> at = { 1 };
   ds.Insert( at.GetAsDataElement() );
   }
-static uint32_t messageid = 1;
   {
   Attribute<0x0,0x110> at = { 0 };
-  at.SetValue( (unsigned short)messageid++ );
-  assert( messageid < std::numeric_limits<uint32_t>::max());
+  at.SetValue( inConnection.GetNextMessageID() );
   ds.Insert( at.GetAsDataElement() );
   }
   {
@@ -209,10 +208,16 @@ static uint32_t messageid = 1;
 
   thePDV.SetDataSet(ds);
 
-  //!!!Mathieu, I assume you'll want to fix this
-  thePDVs.push_back(thePDV);
+  return thePDV;
 }
 
+std::vector<PresentationDataValue> CStoreRQ::ConstructPDV(
+const ULConnection &inConnection, File const & file )
+{
+  std::vector<PresentationDataValue> thePDVs;
+  thePDVs.push_back( ConstructCommandPDV( inConnection, file ) );
+  const uint8_t prescontid = thePDVs[0].GetPresentationContextID();
+
   // now let's chunk'ate the dataset:
 {
   std::stringstream ss;
@@ -261,6 +266,14 @@ static uint32_t messageid = 1;
 
 }
 
+bool CStoreRQ::WriteDataSet(std::ostream &os, File const & file)
+{
+  DataSetWriter writer;
+  writer.SetStream( os );
+  writer.SetFile( file );
+  return writer.Write();
+}
+
 //private hack
 std::vector<PresentationDataValue> CStoreRQ::ConstructPDV(
 const ULConnection &inConnection, const BaseRootQuery* inRootQuery)
@@ -33,6 +33,11 @@ class CStoreRQ : public BaseCompositeMessage {
     public:
       std::vector<PresentationDataValue> ConstructPDV(const ULConnection &inConnection,
         const File& file);
+      /// Only the command part of ConstructPDV (a single PDV, last fragment)
+      PresentationDataValue ConstructCommandPDV(const ULConnection &inConnection,
+        const File& file);
+      /// Encode the data set of file (not its File Meta Information) on os
+      static bool WriteDataSet(std::ostream &os, const File& file);
     };
 
 /**
@@ -0,0 +1,212 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmPDataTFStreamBuf.h"
+
+#include <socket++/sockstream.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+namespace gdcm
+{
+namespace network
+{
+
+PDataTFStreamBuf::PDataTFStreamBuf(std::ostream &os, uint8_t pcid, size_t maxpdv):
+  OS(os),PresentationContextID(pcid),Buffer(maxpdv),NumberOfPDUs(0),Failed(false)
+{
+  assert( maxpdv > 0 );
+  setp( &Buffer[0], &Buffer[0] + Buffer.size() );
+}
+
+PDataTFStreamBuf::~PDataTFStreamBuf()
+{
+}
+
+PDataTFStreamBuf::int_type PDataTFStreamBuf::overflow(int_type c)
+{
+  if( traits_type::eq_int_type( c, traits_type::eof() ) )
+    {
+    // The buffer might hold the last fragment, it is only sent by Finish
+    return traits_type::not_eof( c );
+    }
+  if( pptr() == epptr() && !FlushPDV() )
+    {
+    return traits_type::eof();
+    }
+  *pptr() = traits_type::to_char_type( c );
+  pbump( 1 );
+  return c;
+}
+
+std::streamsize PDataTFStreamBuf::xsputn(const char *s, std::streamsize n)
+{
+  const size_t maxpdv = Buffer.size();
+  std::streamsize written = 0;
+  while( written < n )
+    {
+    const size_t remaining = (size_t)(n - written);
+    if( pptr() == pbase() && remaining > maxpdv )
+      {
+      // Nothing buffered and more than a PDV to go: no need to copy
+      if( !SendPDV( s + written, maxpdv, false ) ) break;
+      written += maxpdv;
+      }
+    else if( pptr() == epptr() )
+      {
+      if( !FlushPDV() ) break;
+      }
+    else
+      {
+      const size_t len = std::min( remaining, (size_t)(epptr() - pptr()) );
+      memcpy( pptr(), s + written, len );
+      pbump( (int)len );
+      written += len;
+      }
+    }
+  return written;
+}
+
+bool PDataTFStreamBuf::CopyFrom(std::istream &is, size_t len)
+{
+  while( len > 0 )
+    {
+    if( pptr() == epptr() && !FlushPDV() )
+      {
+      return false;
+      }
+    const size_t n = std::min( len, (size_t)(epptr() - pptr()) );
+    is.read( pptr(), n );
+    if( (size_t)is.gcount() != n )
+      {
+      gdcmDebugMacro( "Short read: " << is.gcount() << " instead of " << n );
+      return false;
+      }
+    pbump( (int)n );
+    len -= n;
+    }
+  return true;
+}
+
+bool PDataTFStreamBuf::Finish()
+{
+  if( !SendPDV( pbase(), pptr() - pbase(), true ) )
+    {
+    return false;
+    }
+  setp( pbase(), epptr() );
+  OS.flush();
+  return !Failed && OS.good();
+}
+
+bool PDataTFStreamBuf::FlushPDV()
+{
+  if( !SendPDV( pbase(), pptr() - pbase(), false ) )
+    {
+    return false;
+    }
+  setp( pbase(), epptr() );
+  return true;
+}
+
+bool PDataTFStreamBuf::SendPDV(const char *data, size_t len, bool last)
+{
+  if( Failed ) return false;
+
+  // PS 3.8 - Table 9-22 and 9.3.5.1: PDU header followed by the PDV item
+  // header, all lengths are big endian
+  const uint32_t pdulen = (uint32_t)(len + 6);
+  const uint32_t pdvlen = (uint32_t)(len + 2);
+  unsigned char header[12];
+  header[0] = 0x04;
+  header[1] = 0x00;
+  header[2] = (unsigned char)(pdulen >> 24);
+  header[3] = (unsigned char)(pdulen >> 16);
+  header[4] = (unsigned char)(pdulen >> 8);
+  header[5] = (unsigned char)(pdulen);
+  header[6] = (unsigned char)(pdvlen >> 24);
+  header[7] = (unsigned char)(pdvlen >> 16);
+  header[8] = (unsigned char)(pdvlen >> 8);
+  header[9] = (unsigned char)(pdvlen);
+  header[10] = PresentationContextID;
+  header[11] = last ? 0x02 : 0x00; // data set, last fragment or not
+  ++NumberOfPDUs;
+
+#if !defined(_WIN32)
+  sockbuf *sb = dynamic_cast<sockbuf*>( OS.rdbuf() );
+  if( sb )
+    {
+    // Whatever is still in the socket buffer (the command) goes first
+    OS.flush();
+    // sendtimeout() can only be queried by setting it
+    const int stmo = sb->sendtimeout();
+    sb->sendtimeout( stmo );
+    if( stmo != -1 && sb->is_writeready( stmo ) == 0 )
+      {
+      gdcmDebugMacro( "Timeout sending P-DATA-TF" );
+      Failed = true;
+      return false;
+      }
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = len;
+    struct iovec *cur = iov;
+    int count = len ? 2 : 1;
+    while( count > 0 )
+      {
+      const ssize_t n = ::writev( sb->sd(), cur, count );
+      if( n < 0 )
+        {
+        if( errno == EINTR ) continue;
+        gdcmDebugMacro( "writev failed: " << strerror(errno) );
+        Failed = true;
+        return false;
+        }
+      size_t done = (size_t)n;
+      while( count > 0 && done >= cur->iov_len )
+        {
+        done -= cur->iov_len;
+        ++cur;
+        --count;
+        }
+      if( count > 0 )
+        {
+        cur->iov_base = (char*)cur->iov_base + done;
+        cur->iov_len -= done;
+        }
+      }
+    return true;
+    }
+#endif
+
+  OS.write( (char*)header, sizeof(header) );
+  OS.write( data, len );
+  if( !OS )
+    {
+    Failed = true;
+    return false;
+    }
+  return true;
+}
+
+} // end namespace network
+} // end namespace gdcm
@@ -0,0 +1,80 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMPDATATFSTREAMBUF_H
+#define GDCMPDATATFSTREAMBUF_H
+
+#include "gdcmTypes.h"
+
+#include <streambuf>
+#include <istream>
+#include <vector>
+
+namespace gdcm
+{
+
+namespace network
+{
+
+/**
+ * \brief PDataTFStreamBuf
+ * Write a data set (not a command) as a sequence of P-DATA-TF PDUs, each one
+ * holding a single Presentation Data Value of at most maxpdv bytes, while
+ * the data set is being encoded. Only one PDV worth of data is ever buffered:
+ * large writes are sent straight from the caller's buffer.
+ *
+ * When the underlying ostream is a socket++ sockbuf, the PDU header and the
+ * PDV payload are sent with a single gathering write.
+ *
+ * Call Finish() once the whole data set was written: the last fragment is
+ * only sent then (with the 'last fragment' bit set).
+ */
+class GDCM_EXPORT PDataTFStreamBuf : public std::streambuf
+{
+public:
+  /// maxpdv is the maximum PDV payload: max PDU length - 6
+  PDataTFStreamBuf(std::ostream &os, uint8_t pcid, size_t maxpdv);
+  ~PDataTFStreamBuf();
+
+  /// Read len bytes from is directly into the PDV buffer
+  bool CopyFrom(std::istream &is, size_t len);
+
+  /// Send the last fragment. Return false if any PDU could not be sent.
+  bool Finish();
+
+  /// Number of P-DATA-TF PDU sent so far
+  size_t GetNumberOfPDUs() const { return NumberOfPDUs; }
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+
+private:
+  bool SendPDV(const char *data, size_t len, bool last);
+  bool FlushPDV();
+
+  std::ostream &OS;
+  uint8_t PresentationContextID;
+  std::vector<char> Buffer;
+  size_t NumberOfPDUs;
+  bool Failed;
+
+  PDataTFStreamBuf(const PDataTFStreamBuf&); // Not implemented.
+  void operator=(const PDataTFStreamBuf&); // Not implemented.
+};
+
+} // end namespace network
+
+} // end namespace gdcm
+
+#endif //GDCMPDATATFSTREAMBUF_H
@@ -140,9 +140,6 @@ bool PresentationContextGenerator::AddPresentationContext( const char *as, const
   SizeType n = PresContext.size();
   PresentationContext pc;
   pc.SetAbstractSyntax( as );
-  SizeType idn = 2*n + 1;
-  assert( idn <= std::numeric_limits<uint8_t>::max() );
-  pc.SetPresentationContextID( (uint8_t)idn );
   pc.AddTransferSyntax( ts );
 
   PresentationContextArrayType::const_iterator it =
@@ -153,6 +150,14 @@ bool PresentationContextGenerator::AddPresentationContext( const char *as, const
   // (fixed in 3.6.0)
   if( it == PresContext.end() )
     {
+    // Presentation Context ID are odd numbers between 1 and 255
+    SizeType idn = 2*n + 1;
+    if( idn > std::numeric_limits<uint8_t>::max() )
+      {
+      gdcmErrorMacro( "Too many Presentation Contexts, " << as << " / " << ts << " not added" );
+      return false;
+      }
+    pc.SetPresentationContextID( (uint8_t)idn );
     PresContext.push_back( pc );
     }
 
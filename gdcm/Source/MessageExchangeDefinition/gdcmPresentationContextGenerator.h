@@ -80,6 +80,7 @@ public:
   /// Not implemented for now. GDCM internally uses Implicit Little Endian
   void SetDefaultTransferSyntax( const TransferSyntax &ts );
 protected:
+  /// Return false when the 128 Presentation Context ID are taken already
   bool AddPresentationContext( const char *as, const char *ts );
   const char *GetDefaultTransferSyntax() const;
 
@@ -23,10 +23,19 @@
 #include "gdcmPDUFactory.h"
 #include "gdcmAttribute.h"
 #include "gdcmULWritingCallback.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmPDataTFStreamBuf.h"
+#include "gdcmCStoreMessages.h"
+#include "gdcmProgressEvent.h"
+#include "gdcmSwapper.h"
 
 #include "gdcmPrinter.h" // FIXME
 #include "gdcmReader.h" // FIXME
 
+#include <map>
+#include <set>
+#include <fstream>
+
 namespace gdcm
 {
 static const char GDCM_AETITLE[] = "GDCMSCU";
@@ -45,6 +54,7 @@ public:
   std::string aetitle;
   std::string calledaetitle;
   double timeout;
+  uint16_t maxoperationsinvoked;
 
   ServiceClassUserInternals():mConnection(NULL),mSecondaryConnection(NULL){}
   ~ServiceClassUserInternals(){
@@ -62,6 +72,7 @@ ServiceClassUser::ServiceClassUser()
   Internals->aetitle = GDCM_AETITLE;
   Internals->calledaetitle = "ANY-SCP";
   Internals->timeout = 10;
+  Internals->maxoperationsinvoked = 1;
 }
 
 ServiceClassUser::~ServiceClassUser()
@@ -89,7 +100,8 @@ bool ServiceClassUser::IsPresentationContextAccepted(const PresentationContext&
     itor != acceptedContexts.end() && !found;
     itor++)
     {
-    if (contextID == itor->GetPresentationContextID())
+    // the AC lists the refused contexts as well (non zero result)
+    if (contextID == itor->GetPresentationContextID() && itor->GetReason() == 0)
       found = true;
     }
 
@@ -142,6 +154,9 @@ bool ServiceClassUser::StartAssociation()
     return false;
     }
 
+  // the connection is overwritten with the negotiated value
+  Internals->mConnection->SetMaxOperationsInvoked( Internals->maxoperationsinvoked );
+
   ULEvent theEvent(eAASSOCIATERequestLocalUser, NULL);
   network::EStateID theState = RunEventLoop(theEvent, Internals->mConnection, NULL, false);
   if(theState != eSta6TransferReady)
@@ -170,6 +185,12 @@ bool ServiceClassUser::StopAssociation()
   return theState == eSta1Idle;
 }
 
+bool ServiceClassUser::IsAssociated() const
+{
+  return Internals->mConnection
+    && Internals->mConnection->GetState() == eSta6TransferReady;
+}
+
 void ServiceClassUser::SetTimeout(double t)
 {
   Internals->timeout = t;
@@ -180,6 +201,20 @@ double ServiceClassUser::GetTimeout() const
   return Internals->timeout;
 }
 
+void ServiceClassUser::SetMaxOperationsInvoked(uint16_t n)
+{
+  Internals->maxoperationsinvoked = n;
+}
+
+uint16_t ServiceClassUser::GetMaxOperationsInvoked() const
+{
+  if( IsAssociated() )
+    {
+    return Internals->mConnection->GetMaxOperationsInvoked();
+    }
+  return Internals->maxoperationsinvoked;
+}
+
 void ServiceClassUser::SetCalledAETitle(const char *aetitle)
 {
   if( aetitle )
@@ -314,6 +349,255 @@ bool ServiceClassUser::SendStore(File const &file)
   return ret;
 }
 
+namespace
+{
+// StoreSource reading each file from disk
+class FilenamesStoreSource : public ServiceClassUser::StoreSource
+{
+public:
+  FilenamesStoreSource(std::vector<std::string> const & filenames):Filenames(filenames) {}
+  size_t GetNumberOfFiles() const { return Filenames.size(); }
+  const char *GetFileName(size_t index) { return Filenames[index].c_str(); }
+  SmartPointer<File> GetFile(size_t index)
+    {
+    Reader reader;
+    reader.SetFileName( Filenames[index].c_str() );
+    if( !reader.Read() )
+      {
+      gdcmErrorMacro( "Could not read: " << Filenames[index] );
+      return NULL;
+      }
+    return &reader.GetFile();
+    }
+private:
+  std::vector<std::string> const & Filenames;
+};
+
+// Open filename on is, positioned on the first element of its data set, and
+// return the length of the data set. file is the header of filename, read at
+// least up to (0008,0018). Return 0 when the data set cannot be copied as is
+// from the file: no File Meta Information, deflated, or the data set does not
+// start where expected.
+size_t OpenDataSet(const char *filename, File const &file, std::ifstream &is)
+{
+  const FileMetaInformation &header = file.GetHeader();
+  const DataSet &ds = file.GetDataSet();
+  const TransferSyntax &ts = header.GetDataSetTransferSyntax();
+  if( header.IsEmpty() || ds.IsEmpty()
+    || ts == TransferSyntax::DeflatedExplicitVRLittleEndian )
+    {
+    return 0;
+    }
+  is.open( filename, std::ios::binary );
+  if( !is ) return 0;
+  is.seekg( 0, std::ios::end );
+  const std::streamoff filelen = is.tellg();
+  std::streamoff offset = header.GetLength<ExplicitDataElement>();
+  if( !header.GetPreamble().IsEmpty() ) offset += 128 + 4;
+  if( offset + 4 > filelen ) return 0;
+  is.seekg( offset, std::ios::beg );
+  char raw[4];
+  is.read( raw, 4 );
+  uint16_t group, element;
+  memcpy( &group, raw, 2 );
+  memcpy( &element, raw + 2, 2 );
+  if( ts.GetSwapCode() == SwapCode::BigEndian )
+    {
+    SwapperDoOp::SwapArray( &group, 1 );
+    SwapperDoOp::SwapArray( &element, 1 );
+    }
+  else
+    {
+    SwapperNoOp::SwapArray( &group, 1 );
+    SwapperNoOp::SwapArray( &element, 1 );
+    }
+  if( !is || Tag( group, element ) != ds.Begin()->GetTag() )
+    {
+    gdcmDebugMacro( "Data set of " << filename << " not found at " << offset );
+    return 0;
+    }
+  is.seekg( offset, std::ios::beg );
+  return (size_t)(filelen - offset);
+}
+}
+
+uint16_t ServiceClassUser::WriteStoreRQ(network::ULConnection const &connection,
+  StoreSource &source, size_t index, std::ostream &os)
+{
+  // The data set is either copied from disk (datasetlen != 0) or encoded
+  // from file, in both cases straight into P-DATA-TF PDUs
+  SmartPointer<File> file;
+  std::ifstream is;
+  size_t datasetlen = 0;
+  PresentationDataValue command;
+  try
+    {
+    const char *filename = source.GetFileName( index );
+    if( filename )
+      {
+      Reader reader;
+      reader.SetFileName( filename );
+      std::set<Tag> skiptags;
+      if( reader.ReadUpToTag( Tag(0x0008,0x0018), skiptags ) )
+        {
+        file = &reader.GetFile();
+        datasetlen = OpenDataSet( filename, *file, is );
+        }
+      }
+    if( !datasetlen )
+      {
+      file = source.GetFile( index );
+      if( !file ) return 0;
+      }
+    CStoreRQ storerq;
+    command = storerq.ConstructCommandPDV( connection, *file );
+    }
+  catch ( std::exception &ex )
+    {
+    (void)ex;  //to avoid unreferenced variable warning on release
+    gdcmErrorMacro( "Could not C-STORE file #" << index << ": " << ex.what() );
+    return 0;
+    }
+  const DataSet cmd = PresentationDataValue::ConcatenatePDVBlobs(
+    std::vector<PresentationDataValue>( 1, command ) );
+  Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( cmd );
+  PDataTFPDU commandpdu;
+  commandpdu.AddPresentationDataValue( command );
+  commandpdu.Write( os );
+
+  PDataTFStreamBuf pdvbuf( os, command.GetPresentationContextID(),
+    connection.GetMaxPDUSize() - 6 );
+  bool sent;
+  if( datasetlen )
+    {
+    sent = pdvbuf.CopyFrom( is, datasetlen );
+    }
+  else
+    {
+    std::ostream dsos( &pdvbuf );
+    sent = CStoreRQ::WriteDataSet( dsos, *file ) && dsos.good();
+    }
+  sent = sent && pdvbuf.Finish();
+  if( !sent ) os.setstate( std::ios::badbit );
+  return messageid.GetValue();
+}
+
+bool ServiceClassUser::SendStore(std::vector<std::string> const & filenames,
+  std::vector<uint16_t> &statuses)
+{
+  FilenamesStoreSource source( filenames );
+  return SendStore( source, statuses );
+}
+
+bool ServiceClassUser::SendStore(StoreSource &source, std::vector<uint16_t> &statuses)
+{
+  ULConnection* mConnection = Internals->mConnection;
+  const size_t nfiles = source.GetNumberOfFiles();
+  statuses.assign( nfiles, 0xFFFF );
+  if( !IsAssociated() )
+    {
+    gdcmErrorMacro( "No association" );
+    return false;
+    }
+  size_t window = mConnection->GetMaxOperationsInvoked();
+  if( !window ) window = nfiles; // unlimited
+
+  std::iostream &io = *mConnection->GetProtocol();
+  // Message ID of each outstanding C-STORE-RQ, to its file index
+  std::map<uint16_t, size_t> outstanding;
+  bool ret = true;
+  size_t next = 0;
+  while( next < nfiles || !outstanding.empty() )
+    {
+    // Fill the window
+    while( next < nfiles && outstanding.size() < window )
+      {
+      const size_t index = next++;
+      const uint16_t messageid = WriteStoreRQ( *mConnection, source, index, io );
+      if( !io )
+        {
+        // The C-STORE-RQ was only partially sent, nothing else can go through
+        // this association
+        gdcmErrorMacro( "Could not send the data set of file #" << index );
+        mConnection->StopProtocol();
+        mConnection->SetState( eSta1Idle );
+        return false;
+        }
+      if( !messageid )
+        {
+        ret = false;
+        continue;
+        }
+      outstanding[ messageid ] = index;
+      }
+    if( outstanding.empty() ) break;
+
+    // Wait for any of the C-STORE-RSP
+    std::vector<BasePDU*> theRSPPDU;
+    bool interrupted = false;
+    do
+      {
+      uint8_t itemtype = 0x0;
+      io.read( (char*)&itemtype, 1 );
+      if( !io || itemtype != 0x4 )
+        {
+        interrupted = true;
+        break;
+        }
+      BasePDU *thePDU = PDUFactory::ConstructPDU( itemtype );
+      thePDU->Read( io );
+      theRSPPDU.push_back( thePDU );
+      } while( !theRSPPDU.back()->IsLastFragment() );
+    DataSet theRSP;
+    if( !interrupted )
+      theRSP = PresentationDataValue::ConcatenatePDVBlobs(
+        PDUFactory::GetPDVs( theRSPPDU ) );
+    for( size_t i = 0; i < theRSPPDU.size(); ++i )
+      {
+      delete theRSPPDU[i];
+      }
+    if( interrupted )
+      {
+      // A-ABORT, A-RELEASE-RQ or connection closed: the association is gone
+      gdcmErrorMacro( "Association interrupted with " << outstanding.size()
+        << " outstanding C-STORE" );
+      mConnection->StopProtocol();
+      mConnection->SetState( eSta1Idle );
+      return false;
+      }
+
+    Attribute<0x0,0x0120> respondedto;
+    respondedto.SetFromDataSet( theRSP );
+    std::map<uint16_t, size_t>::iterator it = outstanding.find( respondedto.GetValue() );
+    if( it == outstanding.end() || !theRSP.FindDataElement( Tag(0x0,0x0900) ) )
+      {
+      gdcmWarningMacro( "Unexpected response to Message ID: " << respondedto.GetValue() );
+      continue;
+      }
+    Attribute<0x0,0x0900> at;
+    at.SetFromDataSet( theRSP );
+    // PS 3.4 - 2011
+    // Table W.4-1 C-STORE RESPONSE STATUS VALUES
+    // Warnings (0xB000, 0xB006, 0xB007) mean the instance was stored
+    const uint16_t theVal = at.GetValue();
+    statuses[ it->second ] = theVal;
+    if( theVal != 0x0 && (theVal & 0xF000) != 0xB000 )
+      {
+      gdcmErrorMacro( "C-Store of file #" << it->second
+        << " failed with status: " << std::hex << theVal << std::dec );
+      ret = false;
+      }
+    outstanding.erase( it );
+
+    ProgressEvent pe;
+    pe.SetProgress( (double)(next - outstanding.size()) / (double)nfiles );
+    this->InvokeEvent( pe );
+    }
+
+  return ret;
+}
+
 bool ServiceClassUser::SendFind(const BaseRootQuery* query, std::vector<DataSet> &retDataSets)
 {
   ULConnection* mConnection = Internals->mConnection;
@@ -63,6 +63,14 @@ public:
   void SetTimeout(double t);
   double GetTimeout() const;
 
+  /// Set the Asynchronous Operations Window proposed at association time:
+  /// the maximum number of outstanding C-STORE-RQ (0 means unlimited). The
+  /// default is 1: no sub-item is sent and operations are synchronous.
+  void SetMaxOperationsInvoked(uint16_t n);
+  /// Return the window negotiated by StartAssociation (the proposed one
+  /// before the association is established)
+  uint16_t GetMaxOperationsInvoked() const;
+
   /// Will try to connect
   /// This will setup the actual timeout used during the whole connection time. Need to call
   /// SetTimeout first
@@ -80,6 +88,10 @@ public:
   /// Stop the running association
   bool StopAssociation();
 
+  /// Return true while the association is established (false once stopped,
+  /// aborted or dropped by the remote host)
+  bool IsAssociated() const;
+
   /// C-ECHO
   bool SendEcho();
 
@@ -90,6 +102,36 @@ public:
   bool SendStore(File const &file);
   /// Execute a C-STORE on a DataSet, the transfer syntax used will be Implicit
   bool SendStore(DataSet const &ds);
+  /// Execute a C-STORE for each file on disk, without waiting for the
+  /// C-STORE-RSP before sending the next C-STORE-RQ, as long as the number of
+  /// outstanding operations stays within the negotiated window. The status of
+  /// each C-STORE-RSP is returned in statuses (0xFFFF when the file could not
+  /// be sent or no response was received). Return false if any file was not
+  /// stored.
+  bool SendStore(std::vector<std::string> const & filenames,
+    std::vector<uint16_t> &statuses);
+
+  /**
+   * \brief StoreSource
+   * Provide the files of a pipelined SendStore. For each index, in order,
+   * right before the C-STORE-RQ is sent, GetFileName is called first: when it
+   * returns the name of a file on disk, its data set is streamed from the file
+   * in P-DATA-TF sized chunks and is never loaded as a whole. Otherwise (or
+   * when the file cannot be streamed as is, e.g. deflated) GetFile is called
+   * and the File is encoded on the fly.
+   */
+  class GDCM_EXPORT StoreSource
+  {
+  public:
+    virtual ~StoreSource() {}
+    virtual size_t GetNumberOfFiles() const = 0;
+    /// Return NULL when the file is not on disk (default)
+    virtual const char *GetFileName(size_t index) { (void)index; return NULL; }
+    /// Return NULL when the file cannot be sent
+    virtual SmartPointer<File> GetFile(size_t index) = 0;
+  };
+  /// Same as above, the files are provided by source
+  bool SendStore(StoreSource &source, std::vector<uint16_t> &statuses);
 
   /// C-FIND a query, return result are in retDatasets
   bool SendFind(const BaseRootQuery* query, std::vector<DataSet> &retDatasets);
@@ -105,6 +147,13 @@ public:
   static SmartPointer<ServiceClassUser> New() { return new ServiceClassUser; }
 
 private:
+  // Write the C-STORE-RQ of file index of source (command, then data set) on
+  // os, for the association established on connection. Return its Message
+  // ID, 0 when the file could not be read (nothing written). os is left in a
+  // failed state when the request could only be partially written.
+  static uint16_t WriteStoreRQ(network::ULConnection const &connection,
+    StoreSource &source, size_t index, std::ostream &os);
+
   network::EStateID RunEventLoop(network::ULEvent& inEvent,
     network::ULConnection* inWhichConnection,
     network::ULConnectionCallback* inCallback, const bool& startWaiting);
@@ -0,0 +1,637 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmStoreSCP.h"
+#include "gdcmAAssociateRQPDU.h"
+#include "gdcmAAssociateACPDU.h"
+#include "gdcmAAssociateRJPDU.h"
+#include "gdcmAReleaseRQPDU.h"
+#include "gdcmAReleaseRPPDU.h"
+#include "gdcmAAbortPDU.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
+#include "gdcmCommandDataSet.h"
+#include "gdcmFileMetaInformation.h"
+#include "gdcmAttribute.h"
+#include "gdcmThreadPool.h"
+#include "gdcmSystem.h"
+#include "gdcmTrace.h"
+
+#include <socket++/sockinet.h>
+#ifndef _WIN32
+#include <netinet/tcp.h> // TCP_NODELAY
+#endif
+
+#include <map>
+#include <sstream>
+#include <stdio.h>
+
+#if defined(GDCM_HAVE_PTHREAD_H) && !defined(_MSC_VER)
+  #include <pthread.h>
+  #define GDCM_STORESCP_THREADS
+#endif
+
+namespace gdcm
+{
+
+using namespace network;
+
+class StoreSCPInternals
+{
+public:
+  StoreSCPInternals():Port(0),NumberOfThreads(4),MaxOperationsInvoked(16),
+    Timeout(30),TheSink(NULL),Listener(NULL),Stopped(false),
+    NumberOfStoredInstances(0),NumberOfAssociations(0)
+    {
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_init(&Lock, NULL);
+    pthread_mutex_init(&ListenerLock, NULL);
+#endif
+    }
+  ~StoreSCPInternals()
+    {
+    delete Listener;
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_destroy(&Lock);
+    pthread_mutex_destroy(&ListenerLock);
+#endif
+    }
+  void Acquire()
+    {
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_lock(&Lock);
+#endif
+    }
+  void Release()
+    {
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_unlock(&Lock);
+#endif
+    }
+  // Held while waiting on Listener: never together with Lock
+  void AcquireListener()
+    {
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_lock(&ListenerLock);
+#endif
+    }
+  void ReleaseListener()
+    {
+#ifdef GDCM_STORESCP_THREADS
+    pthread_mutex_unlock(&ListenerLock);
+#endif
+    }
+  // Distinct for each association, names its temporary files
+  size_t NextAssociationID()
+    {
+    Acquire();
+    const size_t id = NumberOfAssociations++;
+    Release();
+    return id;
+    }
+
+  uint16_t Port;
+  std::string Hostname;
+  std::string AETitle;
+  std::string SpoolDirectory;
+  unsigned int NumberOfThreads;
+  uint16_t MaxOperationsInvoked;
+  double Timeout;
+  StoreSCP::Sink *TheSink;
+
+  sockinetbuf *Listener;
+  // Protected by Lock:
+  bool Stopped;
+  size_t NumberOfStoredInstances;
+  size_t NumberOfAssociations;
+#ifdef GDCM_STORESCP_THREADS
+  pthread_mutex_t Lock;
+  pthread_mutex_t ListenerLock;
+#endif
+};
+
+namespace
+{
+// c_str() to strip the padding
+std::string GetString(DataSet const &ds, Tag const &t)
+{
+  if( !ds.FindDataElement( t ) ) return std::string();
+  const ByteValue *bv = ds.GetDataElement( t ).GetByteValue();
+  if( !bv ) return std::string();
+  return std::string( bv->GetPointer(), bv->GetLength() ).c_str();
+}
+
+// C-ECHO-RSP or C-STORE-RSP to command
+void WriteResponse(std::ostream &os, uint8_t pcid, DataSet const &command,
+  uint16_t commandfield, uint16_t status)
+{
+  CommandDataSet ds;
+  ds.Insert( command.GetDataElement( Tag(0x0,0x0002) ) );
+  if( command.FindDataElement( Tag(0x0,0x1000) ) )
+    {
+    ds.Insert( command.GetDataElement( Tag(0x0,0x1000) ) );
+    }
+  Attribute<0x0,0x0100> field = { commandfield };
+  ds.Insert( field.GetAsDataElement() );
+  Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( command );
+  Attribute<0x0,0x0120> respondedto = { messageid.GetValue() };
+  ds.Insert( respondedto.GetAsDataElement() );
+  Attribute<0x0,0x0800> datasettype = { 0x0101 }; // no data set
+  ds.Insert( datasettype.GetAsDataElement() );
+  Attribute<0x0,0x0900> at = { status };
+  ds.Insert( at.GetAsDataElement() );
+  Attribute<0x0,0x0000> grouplength = { 0 };
+  grouplength.SetValue( ds.GetLength<ImplicitDataElement>() );
+  ds.Insert( grouplength.GetAsDataElement() );
+
+  PresentationDataValue pdv;
+  pdv.SetPresentationContextID( pcid );
+  pdv.SetDataSet( ds );
+  pdv.SetMessageHeader( 3 ); // command, last fragment
+  PDataTFPDU pdu;
+  pdu.AddPresentationDataValue( pdv );
+  pdu.Write( os );
+  os.flush();
+}
+
+// Preamble and File Meta Information of the instance of a C-STORE-RQ
+bool WriteHeader(std::string &out, DataSet const &command, const char *tsuid)
+{
+  const TransferSyntax ts = TransferSyntax::GetTSType( tsuid );
+  if( ts == TransferSyntax::TS_END ) return false;
+  DataSet ds;
+  DataElement sopclass = command.GetDataElement( Tag(0x0,0x0002) );
+  sopclass.SetTag( Tag(0x0008,0x0016) );
+  ds.Insert( sopclass );
+  DataElement sopinstance = command.GetDataElement( Tag(0x0,0x1000) );
+  sopinstance.SetTag( Tag(0x0008,0x0018) );
+  ds.Insert( sopinstance );
+  try
+    {
+    FileMetaInformation header;
+    header.SetDataSetTransferSyntax( ts );
+    header.FillFromDataSet( ds );
+    std::ostringstream os;
+    header.Write( os );
+    out = os.str();
+    }
+  catch( std::exception &ex )
+    {
+    (void)ex;  //to avoid unreferenced variable warning on release
+    gdcmWarningMacro( "Could not create File Meta Information: " << ex.what() );
+    return false;
+    }
+  return true;
+}
+
+// Name of the instance in the spool directory, empty if the UID is empty
+std::string SpoolName(std::string const &uid)
+{
+  std::string name = uid;
+  for( std::string::iterator it = name.begin(); it != name.end(); ++it )
+    {
+    if( !(( *it >= '0' && *it <= '9' ) || *it == '.') ) *it = '_';
+    }
+  return name;
+}
+
+// Blank padded AE Title, as in the A-ASSOCIATE-RQ
+std::string TrimAETitle(std::string const &ae)
+{
+  const std::string::size_type b = ae.find_first_not_of( ' ' );
+  if( b == std::string::npos ) return std::string();
+  return ae.substr( b, ae.find_last_not_of( ' ' ) - b + 1 );
+}
+
+// State of one association, fed one PDU at a time
+class Association
+{
+public:
+  Association(StoreSCPInternals &in, size_t id):Internals(in),Id(id),
+    Associated(false),Storing(false),Spooled(NULL),Written(false) {}
+  // An instance in flight when the association ends is dropped
+  ~Association() { Discard(); }
+
+  // The PDU of type itemtype is read from is (positioned right after the item
+  // type), the replies are written on os. Return false once the association
+  // is over.
+  bool Process(uint8_t itemtype, std::istream &is, std::ostream &os);
+
+private:
+  bool Associate(std::istream &is, std::ostream &os);
+  bool Command(uint8_t pcid, std::ostream &os);
+  void Store(uint8_t pcid, std::ostream &os);
+  bool Open(std::string const &header);
+  void Discard();
+
+  StoreSCPInternals &Internals;
+  const size_t Id;
+  bool Associated;
+  std::map<uint8_t, std::string> TransferSyntaxes;
+  std::vector<PresentationDataValue> Fragments;
+  DataSet CommandDataSet;
+  bool Storing;
+  // Temporary file the instance is streamed to, Written false on the first
+  // failed write
+  FILE *Spooled;
+  std::string SpooledName;
+  std::string FinalName;
+  bool Written;
+};
+
+bool Association::Process(uint8_t itemtype, std::istream &is, std::ostream &os)
+{
+  if( !Associated )
+    {
+    if( itemtype != 0x1 ) return false;
+    return Associate( is, os );
+    }
+  if( itemtype == 0x5 )
+    {
+    AReleaseRQPDU release;
+    release.Read( is );
+    AReleaseRPPDU reply;
+    reply.Write( os );
+    os.flush();
+    return false;
+    }
+  if( itemtype != 0x4 )
+    {
+    // A-ABORT or unexpected PDU: an instance in flight is dropped
+    return false;
+    }
+  PDataTFPDU pdu;
+  pdu.Read( is );
+  if( !is ) return false;
+  for( size_t i = 0; i < pdu.GetNumberOfPresentationDataValues(); ++i )
+    {
+    PresentationDataValue const &pdv = pdu.GetPresentationDataValue(i);
+    const uint8_t pcid = pdv.GetPresentationContextID();
+    if( !pdv.GetIsCommand() )
+      {
+      if( !Storing ) continue;
+      const std::string &blob = pdv.GetBlob();
+      if( Written && !blob.empty() )
+        Written = fwrite( blob.c_str(), 1, blob.size(), Spooled ) == blob.size();
+      if( pdv.GetIsLastFragment() ) Store( pcid, os );
+      continue;
+      }
+    Fragments.push_back( pdv );
+    if( !pdv.GetIsLastFragment() ) continue;
+    CommandDataSet = PresentationDataValue::ConcatenatePDVBlobs( Fragments );
+    Fragments.clear();
+    if( !Command( pcid, os ) ) return false;
+    }
+  return true;
+}
+
+bool Association::Associate(std::istream &is, std::ostream &os)
+{
+  AAssociateRQPDU rqpdu;
+  rqpdu.Read( is );
+  if( !is ) return false;
+
+  if( !Internals.AETitle.empty()
+    && TrimAETitle( rqpdu.GetCalledAETitle() ) != Internals.AETitle )
+    {
+    gdcmWarningMacro( "Called AE Title not recognized: "
+      << TrimAETitle( rqpdu.GetCalledAETitle() ) );
+    AAssociateRJPDU rjpdu;
+    rjpdu.SetResult( 1 ); // rejected-permanent
+    rjpdu.SetSource( 1 ); // service-user
+    rjpdu.SetReason( 7 ); // called-AE-title-not-recognized
+    rjpdu.Write( os );
+    os.flush();
+    return false;
+    }
+
+  // Accept everything, with the first Transfer Syntax proposed
+  AAssociateACPDU acpdu;
+  for( unsigned int i = 0; i < rqpdu.GetNumberOfPresentationContext(); ++i )
+    {
+    PresentationContextRQ const &pc = rqpdu.GetPresentationContext(i);
+    PresentationContextAC pcac;
+    pcac.SetPresentationContextID( pc.GetPresentationContextID() );
+    pcac.SetTransferSyntax( pc.GetTransferSyntaxes()[0] );
+    pcac.SetReason( 0 );
+    acpdu.AddPresentationContextAC( pcac );
+    TransferSyntaxes[ pc.GetPresentationContextID() ] =
+      pc.GetTransferSyntaxes()[0].GetName();
+    }
+  acpdu.InitFromRQ( rqpdu );
+  if( const AsynchronousOperationsWindowSub *rqaows =
+    rqpdu.GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    const uint16_t proposed = rqaows->GetMaximumNumberOperationsInvoked();
+    const uint16_t maxops = Internals.MaxOperationsInvoked;
+    AsynchronousOperationsWindowSub aows;
+    aows.SetMaximumNumberOperationsInvoked( proposed
+      ? std::min( proposed, maxops ) : maxops );
+    aows.SetMaximumNumberOperationsPerformed( 1 );
+    UserInformation ui;
+    ui = acpdu.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( aows );
+    acpdu.SetUserInformation( ui );
+    }
+  acpdu.Write( os );
+  os.flush();
+  Associated = true;
+  return true;
+}
+
+// CommandDataSet is complete
+bool Association::Command(uint8_t pcid, std::ostream &os)
+{
+  Attribute<0x0,0x0100> commandfield;
+  commandfield.SetFromDataSet( CommandDataSet );
+  if( commandfield.GetValue() == 0x0030 ) // C-ECHO-RQ
+    {
+    WriteResponse( os, pcid, CommandDataSet, 0x8030, 0x0 );
+    }
+  else if( commandfield.GetValue() == 0x0001 ) // C-STORE-RQ
+    {
+    std::string header;
+    Storing = WriteHeader( header, CommandDataSet,
+      TransferSyntaxes[pcid].c_str() );
+    if( !Storing )
+      {
+      // the data set is skipped, refuse the instance right away
+      WriteResponse( os, pcid, CommandDataSet, 0x8001, 0xA900 );
+      }
+    else if( !Open( header ) )
+      {
+      Storing = false;
+      WriteResponse( os, pcid, CommandDataSet, 0x8001, 0xA700 ); // out of resources
+      }
+    }
+  else
+    {
+    gdcmWarningMacro( "Unsupported command: " << commandfield.GetValue() );
+    AAbortPDU abort;
+    abort.Write( os );
+    os.flush();
+    return false;
+    }
+  return true;
+}
+
+// Start streaming the instance of CommandDataSet, header first
+bool Association::Open(std::string const &header)
+{
+  Discard();
+  const std::string uid = GetString( CommandDataSet, Tag(0x0,0x1000) );
+  const std::string name = SpoolName( uid );
+  if( name.empty() ) return false;
+  const std::string &dir = Internals.SpoolDirectory;
+  FinalName = dir + "/" + name + ".dcm";
+  std::ostringstream tmp;
+  tmp << dir << "/" << name << "." << Id << ".part";
+  SpooledName = tmp.str();
+  Spooled = fopen( SpooledName.c_str(), "wb" );
+  if( !Spooled )
+    {
+    gdcmWarningMacro( "Could not create: " << SpooledName );
+    return false;
+    }
+  Written = fwrite( header.c_str(), 1, header.size(), Spooled ) == header.size();
+  return true;
+}
+
+// Close and remove the temporary file, if any
+void Association::Discard()
+{
+  if( !Spooled ) return;
+  fclose( Spooled );
+  Spooled = NULL;
+  System::RemoveFile( SpooledName.c_str() );
+}
+
+// The last fragment of the data set was received
+void Association::Store(uint8_t pcid, std::ostream &os)
+{
+  Storing = false;
+  StoreSCPInternals &in = Internals;
+  const bool closed = fclose( Spooled ) == 0;
+  Spooled = NULL;
+  bool stored = closed && Written;
+  if( stored )
+    {
+    // the same instance sent twice replaces the previous file
+    if( System::FileExists( FinalName.c_str() ) )
+      {
+      System::RemoveFile( FinalName.c_str() );
+      }
+    stored = rename( SpooledName.c_str(), FinalName.c_str() ) == 0;
+    }
+  if( !stored )
+    {
+    gdcmWarningMacro( "Could not spool: " << FinalName );
+    System::RemoveFile( SpooledName.c_str() );
+    WriteResponse( os, pcid, CommandDataSet, 0x8001, 0xA700 ); // out of resources
+    return;
+    }
+  in.Acquire();
+  in.NumberOfStoredInstances++;
+  in.Release();
+  if( in.TheSink ) in.TheSink->Stored( FinalName.c_str() );
+  WriteResponse( os, pcid, CommandDataSet, 0x8001, 0x0 );
+}
+
+// One association per thread
+void ServeAssociation(StoreSCPInternals &in, iosockinet &s, size_t id)
+{
+  Association association( in, id );
+  for( ;; )
+    {
+    uint8_t itemtype = 0;
+    s.read( (char*)&itemtype, 1 );
+    if( !s || !association.Process( itemtype, s, s ) ) break;
+    }
+}
+
+// Each thread accepts and serves associations until Stop
+class ServeTask : public ThreadPool::Task
+{
+public:
+  ServeTask(StoreSCPInternals &in):Internals(in) {}
+  void Execute(size_t)
+    {
+    StoreSCPInternals &in = Internals;
+    for( ;; )
+      {
+      in.Acquire();
+      const bool stopped = in.Stopped;
+      in.Release();
+      if( stopped ) return;
+      // only one thread waits on the listening socket at a time
+      in.AcquireListener();
+      sockbuf::sockdesc desc( -1 );
+      bool ready = false;
+      try
+        {
+        ready = in.Listener->is_readready( 0, 200000 ) != 0;
+        if( ready ) desc = in.Listener->accept();
+        }
+      catch( ... )
+        {
+        ready = false;
+        }
+      in.ReleaseListener();
+      if( !ready ) continue;
+
+      try
+        {
+        iosockinet s( desc );
+        s->recvtimeout( (int)in.Timeout );
+        s->sendtimeout( (int)in.Timeout );
+        int nodelay = 1;
+        s->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
+        ServeAssociation( in, s, in.NextAssociationID() );
+        }
+      catch( ... )
+        {
+        gdcmDebugMacro( "Association aborted" );
+        }
+      }
+    }
+private:
+  StoreSCPInternals &Internals;
+};
+}
+
+StoreSCP::StoreSCP()
+{
+  Internals = new StoreSCPInternals;
+}
+
+StoreSCP::~StoreSCP()
+{
+  delete Internals;
+}
+
+void StoreSCP::SetPort( uint16_t port )
+{
+  Internals->Port = port;
+}
+
+uint16_t StoreSCP::GetPort() const
+{
+  return Internals->Port;
+}
+
+void StoreSCP::SetHostname( const char *hostname )
+{
+  Internals->Hostname = hostname ? hostname : "";
+}
+
+void StoreSCP::SetAETitle( const char *aetitle )
+{
+  Internals->AETitle = TrimAETitle( aetitle ? aetitle : "" );
+}
+
+void StoreSCP::SetSpoolDirectory( const char *dir )
+{
+  Internals->SpoolDirectory = dir ? dir : "";
+}
+
+void StoreSCP::SetNumberOfThreads( unsigned int n )
+{
+  Internals->NumberOfThreads = n ? n : 1;
+}
+
+unsigned int StoreSCP::GetNumberOfThreads() const
+{
+  return Internals->NumberOfThreads;
+}
+
+void StoreSCP::SetMaxOperationsInvoked( uint16_t n )
+{
+  Internals->MaxOperationsInvoked = n ? n : 1;
+}
+
+void StoreSCP::SetTimeout( double t )
+{
+  Internals->Timeout = t;
+}
+
+void StoreSCP::SetSink( Sink *sink )
+{
+  Internals->TheSink = sink;
+}
+
+bool StoreSCP::Listen()
+{
+  StoreSCPInternals &in = *Internals;
+  if( !System::FileIsDirectory( in.SpoolDirectory.c_str() ) )
+    {
+    gdcmErrorMacro( "No spool directory: " << in.SpoolDirectory );
+    return false;
+    }
+  delete in.Listener;
+  in.Listener = NULL;
+  in.Acquire();
+  in.Stopped = false;
+  in.NumberOfStoredInstances = 0;
+  in.Release();
+
+  in.Listener = new sockinetbuf( sockbuf::sock_stream );
+  try
+    {
+    in.Listener->reuseaddr( true );
+    if( in.Hostname.empty() )
+      in.Listener->bind( (unsigned long)INADDR_ANY, in.Port );
+    else
+      in.Listener->bind( in.Hostname.c_str(), in.Port );
+    in.Listener->listen();
+    }
+  catch( ... )
+    {
+    gdcmErrorMacro( "Could not listen on " << in.Hostname << ":" << in.Port );
+    delete in.Listener;
+    in.Listener = NULL;
+    return false;
+    }
+  in.Port = (uint16_t)in.Listener->localport();
+  return true;
+}
+
+bool StoreSCP::Run()
+{
+  if( !Internals->Listener )
+    {
+    gdcmErrorMacro( "Listen was not called" );
+    return false;
+    }
+  ThreadPool pool( Internals->NumberOfThreads );
+  ServeTask task( *Internals );
+  pool.ParallelFor( task, Internals->NumberOfThreads );
+  return true;
+}
+
+void StoreSCP::Stop()
+{
+  Internals->Acquire();
+  Internals->Stopped = true;
+  Internals->Release();
+}
+
+size_t StoreSCP::GetNumberOfStoredInstances() const
+{
+  Internals->Acquire();
+  const size_t n = Internals->NumberOfStoredInstances;
+  Internals->Release();
+  return n;
+}
+
+} // end namespace gdcm
@@ -0,0 +1,106 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMSTORESCP_H
+#define GDCMSTORESCP_H
+
+#include "gdcmTypes.h"
+
+namespace gdcm
+{
+class StoreSCPInternals;
+
+/**
+ * \brief C-STORE SCP receiving instances into a spool directory
+ * \details Every SOP Class is accepted, with the first Transfer Syntax
+ * proposed for it, as well as C-ECHO. Up to GetNumberOfThreads()
+ * associations are served concurrently, each one in its own thread.
+ *
+ * An instance is streamed to the spool directory as its P-DATA-TF fragments
+ * arrive (File Meta Information first), under a temporary name, and renamed
+ * to <SOP Instance UID>.dcm after the last one, so that a complete file is
+ * never seen half written and an instance is never held in memory whole. The
+ * C-STORE-RSP is only sent once the file is on disk.
+ *
+ * \see StoreSCUPool
+ */
+class GDCM_EXPORT StoreSCP
+{
+public:
+  /**
+   * \brief Sink
+   * Stored is called for each instance written to the spool directory, from
+   * the thread of its association: it has to be thread safe.
+   */
+  class GDCM_EXPORT Sink
+  {
+  public:
+    virtual ~Sink() {}
+    virtual void Stored(const char *filename) = 0;
+  };
+
+  StoreSCP();
+  ~StoreSCP();
+
+  /// Port to listen on, 0 (default) lets the system choose one, see GetPort
+  void SetPort( uint16_t port );
+  uint16_t GetPort() const;
+
+  /// Interface to listen on, a host name or an address. Empty (default)
+  /// listens on all of them.
+  void SetHostname( const char *hostname );
+
+  /// Called AE Title the SCU has to use, any other one is rejected with
+  /// called-AE-title-not-recognized. Empty (default) accepts any.
+  void SetAETitle( const char *aetitle );
+
+  /// Directory the instances are written to (must exist)
+  void SetSpoolDirectory( const char *dir );
+
+  /// Maximum number of associations served at once (default 4)
+  void SetNumberOfThreads( unsigned int n );
+  unsigned int GetNumberOfThreads() const;
+
+  /// Largest Asynchronous Operations Window accepted (default 16). The
+  /// window is only granted when proposed by the SCU.
+  void SetMaxOperationsInvoked( uint16_t n );
+
+  /// Association idle timeout in seconds (default 30)
+  void SetTimeout( double t );
+
+  /// Notified of each stored instance (not owned)
+  void SetSink( Sink *sink );
+
+  /// Bind and listen, GetPort is valid from then on
+  bool Listen();
+
+  /// Serve associations until Stop is called. Call Listen first.
+  bool Run();
+
+  /// Make Run return once the current associations are over. Can be called
+  /// from any thread.
+  void Stop();
+
+  /// Number of instances stored since Listen
+  size_t GetNumberOfStoredInstances() const;
+
+private:
+  StoreSCP(const StoreSCP&);  // Not implemented.
+  void operator=(const StoreSCP&);  // Not implemented.
+
+  StoreSCPInternals *Internals;
+};
+
+} // end namespace gdcm
+
+#endif //GDCMSTORESCP_H
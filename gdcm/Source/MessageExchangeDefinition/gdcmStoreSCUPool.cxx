@@ -0,0 +1,577 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmStoreSCUPool.h"
+#include "gdcmServiceClassUser.h"
+#include "gdcmPresentationContext.h"
+#include "gdcmThreadPool.h"
+#include "gdcmReader.h"
+#include "gdcmImageReader.h"
+#include "gdcmImageWriter.h"
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmSystem.h"
+#include "gdcmTrace.h"
+
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+
+namespace gdcm
+{
+
+namespace
+{
+// SOP Class UID, Transfer Syntax UID
+typedef std::pair<std::string, std::string> Combination;
+
+// What SendStore needs to know about each file
+struct StoreFileInfo
+{
+  StoreFileInfo():Size(0),Valid(false) {}
+  Combination SOPClassTS;
+  size_t Size;
+  bool Valid;
+};
+
+// Read each file up to the SOP Class UID, as PresentationContextGenerator
+// does
+class ScanTask : public ThreadPool::Task
+{
+public:
+  ScanTask(std::vector<std::string> const & filenames,
+    std::vector<StoreFileInfo> &infos):Filenames(filenames),Infos(infos) {}
+  void Execute(size_t index)
+    {
+    const Tag sopclass(0x8,0x16);
+    const char *fn = Filenames[index].c_str();
+    Reader reader;
+    reader.SetFileName( fn );
+    std::set<Tag> skiptags;
+    if( !reader.ReadUpToTag( sopclass, skiptags ) ) return;
+    DataSet const & ds = reader.GetFile().GetDataSet();
+    if( !ds.FindDataElement( sopclass ) ) return;
+    const ByteValue *bv = ds.GetDataElement( sopclass ).GetByteValue();
+    if( !bv ) return;
+    StoreFileInfo &info = Infos[index];
+    // c_str() to strip the padding
+    info.SOPClassTS.first = std::string( bv->GetPointer(), bv->GetLength() ).c_str();
+    info.SOPClassTS.second =
+      reader.GetFile().GetHeader().GetDataSetTransferSyntax().GetString();
+    info.Size = System::FileSize( fn );
+    info.Valid = true;
+    }
+private:
+  std::vector<std::string> const & Filenames;
+  std::vector<StoreFileInfo> &Infos;
+};
+
+// Files sent over one association, transcoded when needed
+class PoolStoreSource : public ServiceClassUser::StoreSource
+{
+public:
+  PoolStoreSource(std::vector<std::string> const & filenames,
+    std::vector<size_t> const & indices,
+    std::vector<TransferSyntax::TSType> const & targets):
+    Filenames(filenames),Indices(indices),Targets(targets),NumberOfTranscodedFiles(0) {}
+  size_t GetNumberOfFiles() const { return Indices.size(); }
+  const char *GetFileName(size_t i)
+    {
+    const size_t index = Indices[i];
+    // a transcoded file only exists in memory
+    if( Targets[index] != TransferSyntax::TS_END ) return NULL;
+    return Filenames[index].c_str();
+    }
+  SmartPointer<File> GetFile(size_t i)
+    {
+    const size_t index = Indices[i];
+    const char *fn = Filenames[index].c_str();
+    if( Targets[index] == TransferSyntax::TS_END )
+      {
+      Reader reader;
+      reader.SetFileName( fn );
+      if( !reader.Read() )
+        {
+        gdcmErrorMacro( "Could not read: " << fn );
+        return NULL;
+        }
+      return &reader.GetFile();
+      }
+
+    ImageReader reader;
+    reader.SetFileName( fn );
+    if( !reader.Read() )
+      {
+      gdcmErrorMacro( "Could not read image: " << fn );
+      return NULL;
+      }
+    ImageChangeTransferSyntax change;
+    change.SetTransferSyntax( Targets[index] );
+    change.SetInput( reader.GetImage() );
+    if( !change.Change() )
+      {
+      gdcmErrorMacro( "Could not transcode: " << fn );
+      return NULL;
+      }
+    // ImageWriter updates the header and the Image Pixel module, go through
+    // memory to get the resulting File
+    std::stringstream ss;
+    ImageWriter writer;
+    writer.SetStream( ss );
+    writer.SetFile( reader.GetFile() );
+    writer.SetImage( change.GetOutput() );
+    Reader transcoded;
+    transcoded.SetStream( ss );
+    if( !writer.Write() || !transcoded.Read() )
+      {
+      gdcmErrorMacro( "Could not transcode: " << fn );
+      return NULL;
+      }
+    ++NumberOfTranscodedFiles;
+    return &transcoded.GetFile();
+    }
+
+  std::vector<std::string> const & Filenames;
+  std::vector<size_t> const & Indices;
+  std::vector<TransferSyntax::TSType> const & Targets;
+  size_t NumberOfTranscodedFiles;
+};
+
+// The combinations of 'first' are proposed first, then the ones of 'rest'
+std::vector<PresentationContext> MakePresentationContexts(
+  std::set<Combination> const & first, std::set<Combination> const & rest )
+{
+  std::vector<PresentationContext> pcs;
+  const std::set<Combination> * const sets[] = { &first, &rest };
+  for( int s = 0; s < 2; ++s )
+    {
+    std::set<Combination>::const_iterator it = sets[s]->begin();
+    for( ; it != sets[s]->end(); ++it )
+      {
+      if( s == 1 && first.count( *it ) ) continue;
+      // Presentation Context ID are odd numbers between 1 and 255
+      if( pcs.size() == 128 )
+        {
+        if( s == 0 )
+          gdcmWarningMacro( "Too many Presentation Contexts, only 128 proposed" );
+        return pcs;
+        }
+      PresentationContext pc;
+      pc.SetAbstractSyntax( it->first.c_str() );
+      pc.AddTransferSyntax( it->second.c_str() );
+      pc.SetPresentationContextID( (uint8_t)(2 * pcs.size() + 1) );
+      pcs.push_back( pc );
+      }
+    }
+  return pcs;
+}
+}
+
+class StoreSCUPoolInternals
+{
+public:
+  StoreSCUPoolInternals():Hostname("localhost"),Port(104),Timeout(10),
+    MaxOperationsInvoked(1),NumberOfAssociations(1),
+    Fallback(TransferSyntax::ExplicitVRLittleEndian),Pool(NULL),
+    NumberOfNegotiations(0),NumberOfTranscodedFiles(0) {}
+  ~StoreSCUPoolInternals() { delete Pool; }
+
+  SmartPointer<ServiceClassUser> NewSCU() const
+    {
+    SmartPointer<ServiceClassUser> scu = new ServiceClassUser;
+    scu->SetHostname( Hostname.c_str() );
+    scu->SetPort( Port );
+    scu->SetAETitle( AETitle.c_str() );
+    scu->SetCalledAETitle( CalledAETitle.c_str() );
+    scu->SetTimeout( Timeout );
+    scu->SetMaxOperationsInvoked( MaxOperationsInvoked );
+    return scu;
+    }
+
+  static bool Associate(ServiceClassUser &scu,
+    std::vector<PresentationContext> const & pcs)
+    {
+    if( pcs.empty() || !scu.InitializeConnection() ) return false;
+    scu.SetPresentationContexts( pcs );
+    return scu.StartAssociation();
+    }
+
+  void Close()
+    {
+    for( size_t i = 0; i < SCUs.size(); ++i )
+      {
+      if( SCUs[i]->IsAssociated() )
+        SCUs[i]->StopAssociation();
+      }
+    }
+
+  // New destination: nothing can be reused
+  void Reset()
+    {
+    Close();
+    SCUs.clear();
+    Accepted.clear();
+    Refused.clear();
+    Proposed.clear();
+    }
+
+  std::string Hostname;
+  uint16_t Port;
+  std::string AETitle;
+  std::string CalledAETitle;
+  double Timeout;
+  uint16_t MaxOperationsInvoked;
+  unsigned int NumberOfAssociations;
+  TransferSyntax Fallback;
+
+  std::vector< SmartPointer<ServiceClassUser> > SCUs;
+  ThreadPool *Pool;
+
+  // Negotiation cache
+  std::set<Combination> Accepted;
+  std::set<Combination> Refused;
+  // Proposed by the sending associations
+  std::set<Combination> Proposed;
+
+  unsigned int NumberOfNegotiations;
+  size_t NumberOfTranscodedFiles;
+};
+
+namespace
+{
+// Send the files of each association, concurrently
+class SendTask : public ThreadPool::Task
+{
+public:
+  struct Work
+  {
+    Work():Negotiations(0),Transcoded(0) {}
+    std::vector<size_t> Indices;
+    std::vector<uint16_t> Statuses;
+    unsigned int Negotiations;
+    size_t Transcoded;
+  };
+
+  SendTask(StoreSCUPoolInternals &internals,
+    std::vector<std::string> const & filenames,
+    std::vector<TransferSyntax::TSType> const & targets,
+    std::vector<PresentationContext> const & pcs,
+    std::vector<Work> &works):
+    Internals(internals),Filenames(filenames),Targets(targets),
+    PresentationContexts(pcs),Works(works) {}
+
+  void Execute(size_t a)
+    {
+    ServiceClassUser &scu = *Internals.SCUs[a];
+    Work &work = Works[a];
+    work.Statuses.assign( work.Indices.size(), 0xFFFF );
+    const bool reused = scu.IsAssociated();
+    if( !reused )
+      {
+      ++work.Negotiations;
+      if( !StoreSCUPoolInternals::Associate( scu, PresentationContexts ) )
+        {
+        gdcmErrorMacro( "Could not associate" );
+        return;
+        }
+      }
+    PoolStoreSource source( Filenames, work.Indices, Targets );
+    scu.SendStore( source, work.Statuses );
+    work.Transcoded += source.NumberOfTranscodedFiles;
+    if( !reused || scu.IsAssociated() ) return;
+
+    // The SCP may have dropped the association while it was idle: resend
+    // what did not get a response on a new one, once
+    std::vector<size_t> resend, positions;
+    for( size_t i = 0; i < work.Statuses.size(); ++i )
+      {
+      if( work.Statuses[i] == 0xFFFF )
+        {
+        resend.push_back( work.Indices[i] );
+        positions.push_back( i );
+        }
+      }
+    if( resend.empty() ) return;
+    ++work.Negotiations;
+    if( !StoreSCUPoolInternals::Associate( scu, PresentationContexts ) )
+      return;
+    std::vector<uint16_t> statuses;
+    PoolStoreSource again( Filenames, resend, Targets );
+    scu.SendStore( again, statuses );
+    work.Transcoded += again.NumberOfTranscodedFiles;
+    for( size_t i = 0; i < positions.size(); ++i )
+      work.Statuses[ positions[i] ] = statuses[i];
+    }
+
+private:
+  StoreSCUPoolInternals &Internals;
+  std::vector<std::string> const & Filenames;
+  std::vector<TransferSyntax::TSType> const & Targets;
+  std::vector<PresentationContext> const & PresentationContexts;
+  std::vector<Work> &Works;
+};
+
+struct LargerFile
+{
+  LargerFile(std::vector<StoreFileInfo> const & infos):Infos(infos) {}
+  bool operator()(size_t i, size_t j) const
+    {
+    return Infos[i].Size > Infos[j].Size;
+    }
+  std::vector<StoreFileInfo> const & Infos;
+};
+}
+
+StoreSCUPool::StoreSCUPool()
+{
+  Internals = new StoreSCUPoolInternals;
+}
+
+StoreSCUPool::~StoreSCUPool()
+{
+  Internals->Close();
+  delete Internals;
+}
+
+void StoreSCUPool::SetHostname( const char *hostname )
+{
+  if( !hostname ) return;
+  Internals->Reset();
+  Internals->Hostname = hostname;
+}
+
+void StoreSCUPool::SetPort( uint16_t port )
+{
+  Internals->Reset();
+  Internals->Port = port;
+}
+
+void StoreSCUPool::SetAETitle( const char *aetitle )
+{
+  if( !aetitle ) return;
+  Internals->Reset();
+  Internals->AETitle = aetitle;
+}
+
+void StoreSCUPool::SetCalledAETitle( const char *aetitle )
+{
+  if( !aetitle ) return;
+  Internals->Reset();
+  Internals->CalledAETitle = aetitle;
+}
+
+void StoreSCUPool::SetTimeout( double t )
+{
+  Internals->Close();
+  Internals->SCUs.clear();
+  Internals->Timeout = t;
+}
+
+void StoreSCUPool::SetMaxOperationsInvoked( uint16_t n )
+{
+  Internals->Close();
+  Internals->SCUs.clear();
+  Internals->MaxOperationsInvoked = n;
+}
+
+void StoreSCUPool::SetNumberOfAssociations( unsigned int n )
+{
+  if( !n ) n = 1;
+  if( n < Internals->SCUs.size() )
+    {
+    for( size_t i = n; i < Internals->SCUs.size(); ++i )
+      {
+      if( Internals->SCUs[i]->IsAssociated() )
+        Internals->SCUs[i]->StopAssociation();
+      }
+    Internals->SCUs.resize( n );
+    }
+  Internals->NumberOfAssociations = n;
+  delete Internals->Pool;
+  Internals->Pool = NULL;
+}
+
+unsigned int StoreSCUPool::GetNumberOfAssociations() const
+{
+  return Internals->NumberOfAssociations;
+}
+
+void StoreSCUPool::SetFallbackTransferSyntax( TransferSyntax const &ts )
+{
+  Internals->Fallback = ts;
+}
+
+unsigned int StoreSCUPool::GetNumberOfNegotiations() const
+{
+  return Internals->NumberOfNegotiations;
+}
+
+size_t StoreSCUPool::GetNumberOfTranscodedFiles() const
+{
+  return Internals->NumberOfTranscodedFiles;
+}
+
+void StoreSCUPool::Close()
+{
+  Internals->Close();
+}
+
+bool StoreSCUPool::SendStore( std::vector<std::string> const & filenames,
+  std::vector<uint16_t> &statuses )
+{
+  StoreSCUPoolInternals &in = *Internals;
+  const size_t nfiles = filenames.size();
+  statuses.assign( nfiles, 0xFFFF );
+  in.NumberOfNegotiations = 0;
+  in.NumberOfTranscodedFiles = 0;
+  if( !nfiles ) return true;
+
+  if( !in.Pool )
+    in.Pool = new ThreadPool( in.NumberOfAssociations );
+  while( in.SCUs.size() < in.NumberOfAssociations )
+    in.SCUs.push_back( in.NewSCU() );
+
+  std::vector<StoreFileInfo> infos( nfiles );
+  ScanTask scan( filenames, infos );
+  in.Pool->ParallelFor( scan, nfiles );
+
+  // Combinations this call needs, as is or transcoded to the fallback
+  const std::string fallback = in.Fallback.GetString();
+  std::set<Combination> needed;
+  bool unknown = false;
+  for( size_t i = 0; i < nfiles; ++i )
+    {
+    if( !infos[i].Valid )
+      {
+      gdcmErrorMacro( "Could not read SOP Class of: " << filenames[i] );
+      continue;
+      }
+    const Combination &c = infos[i].SOPClassTS;
+    const Combination f( c.first, fallback );
+    if( !in.Refused.count( c ) ) needed.insert( c );
+    if( in.Accepted.count( c ) ) continue;
+    if( !in.Refused.count( f ) ) needed.insert( f );
+    if( !in.Refused.count( c )
+      || (!in.Accepted.count( f ) && !in.Refused.count( f )) ) unknown = true;
+    }
+
+  if( unknown )
+    {
+    // Renegotiate: the open associations do not know about them. The
+    // combinations of this call come first, the cache only fills the
+    // remaining Presentation Context ID
+    in.Close();
+    const std::vector<PresentationContext> pcs =
+      MakePresentationContexts( needed, in.Accepted );
+    ServiceClassUser &scu = *in.SCUs[0];
+    ++in.NumberOfNegotiations;
+    if( !StoreSCUPoolInternals::Associate( scu, pcs ) )
+      {
+      gdcmErrorMacro( "Could not associate" );
+      return false;
+      }
+    in.Proposed.clear();
+    for( size_t i = 0; i < pcs.size(); ++i )
+      {
+      const Combination c( pcs[i].GetAbstractSyntax(), pcs[i].GetTransferSyntax(0) );
+      if( scu.IsPresentationContextAccepted( pcs[i] ) )
+        {
+        in.Accepted.insert( c );
+        in.Refused.erase( c );
+        in.Proposed.insert( c );
+        }
+      else
+        {
+        in.Refused.insert( c );
+        in.Accepted.erase( c );
+        }
+      }
+    }
+
+  // Proposed by the sending associations, the ones of this call first
+  std::set<Combination> wanted;
+  std::set_intersection( needed.begin(), needed.end(),
+    in.Accepted.begin(), in.Accepted.end(),
+    std::inserter( wanted, wanted.begin() ) );
+  const std::vector<PresentationContext> accepted =
+    MakePresentationContexts( wanted, in.Accepted );
+  std::set<Combination> proposed;
+  for( size_t i = 0; i < accepted.size(); ++i )
+    proposed.insert( Combination( accepted[i].GetAbstractSyntax(),
+        accepted[i].GetTransferSyntax(0) ) );
+  // The open associations can only be reused when they know all of them
+  if( std::includes( in.Proposed.begin(), in.Proposed.end(),
+      wanted.begin(), wanted.end() ) )
+    {
+    std::set<Combination> known;
+    std::set_intersection( in.Proposed.begin(), in.Proposed.end(),
+      proposed.begin(), proposed.end(), std::inserter( known, known.begin() ) );
+    in.Proposed.swap( known );
+    }
+  else
+    {
+    in.Close();
+    in.Proposed = proposed;
+    }
+
+  // Send as is, transcode to the fallback, or give up
+  std::vector<TransferSyntax::TSType> targets( nfiles, TransferSyntax::TS_END );
+  std::vector<size_t> sendable;
+  for( size_t i = 0; i < nfiles; ++i )
+    {
+    if( !infos[i].Valid ) continue;
+    const Combination &c = infos[i].SOPClassTS;
+    if( !proposed.count( c ) )
+      {
+      if( !proposed.count( Combination( c.first, fallback ) ) )
+        {
+        gdcmErrorMacro( "SOP Class " << c.first << " refused by the SCP"
+          " (or more than 128 Presentation Contexts): " << filenames[i] );
+        continue;
+        }
+      targets[i] = in.Fallback;
+      }
+    sendable.push_back( i );
+    }
+
+  // Largest files first, each to the least loaded association
+  std::sort( sendable.begin(), sendable.end(), LargerFile( infos ) );
+  const size_t nassoc = std::min( sendable.size(), (size_t)in.NumberOfAssociations );
+  std::vector<SendTask::Work> works( nassoc );
+  std::vector<size_t> loads( nassoc, 0 );
+  for( size_t i = 0; i < sendable.size(); ++i )
+    {
+    const size_t a = std::min_element( loads.begin(), loads.end() ) - loads.begin();
+    works[a].Indices.push_back( sendable[i] );
+    loads[a] += infos[ sendable[i] ].Size + 1;
+    }
+
+  SendTask send( in, filenames, targets, accepted, works );
+  in.Pool->ParallelFor( send, nassoc );
+
+  bool ret = sendable.size() == nfiles;
+  for( size_t a = 0; a < nassoc; ++a )
+    {
+    in.NumberOfNegotiations += works[a].Negotiations;
+    in.NumberOfTranscodedFiles += works[a].Transcoded;
+    for( size_t i = 0; i < works[a].Indices.size(); ++i )
+      {
+      const uint16_t status = works[a].Statuses[i];
+      statuses[ works[a].Indices[i] ] = status;
+      if( status != 0x0 && (status & 0xF000) != 0xB000 ) ret = false;
+      }
+    }
+  return ret;
+}
+
+} // end namespace gdcm
@@ -0,0 +1,91 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMSTORESCUPOOL_H
+#define GDCMSTORESCUPOOL_H
+
+#include "gdcmTransferSyntax.h"
+
+#include <vector>
+#include <string>
+
+namespace gdcm
+{
+class StoreSCUPoolInternals;
+
+/**
+ * \brief C-STORE over several associations to the same SCP
+ * \details The pool keeps up to GetNumberOfAssociations() associations open
+ * between calls to SendStore. Files are distributed across the associations
+ * by size and sent concurrently, each association being pipelined within its
+ * own Asynchronous Operations Window (see
+ * ServiceClassUser::SetMaxOperationsInvoked).
+ *
+ * The SOP Class / Transfer Syntax combinations accepted or refused by the SCP
+ * are cached: a new negotiation only happens when a file brings an unknown
+ * combination, and the next associations only propose the accepted ones.
+ * A file is transcoded (to the fallback transfer syntax) only when its own
+ * transfer syntax was refused for its SOP Class.
+ *
+ * \see ServiceClassUser
+ */
+class GDCM_EXPORT StoreSCUPool
+{
+public:
+  StoreSCUPool();
+  ~StoreSCUPool();
+
+  /// Called host name and port, calling and called AE title, see
+  /// ServiceClassUser
+  void SetHostname( const char *hostname );
+  void SetPort( uint16_t port );
+  void SetAETitle( const char *aetitle );
+  void SetCalledAETitle( const char *aetitle );
+  void SetTimeout( double t );
+
+  /// Asynchronous Operations Window proposed for each association (default 1)
+  void SetMaxOperationsInvoked( uint16_t n );
+
+  /// Maximum number of associations opened at once (default 1)
+  void SetNumberOfAssociations( unsigned int n );
+  unsigned int GetNumberOfAssociations() const;
+
+  /// Transfer Syntax proposed for every SOP Class, and used to transcode the
+  /// files whose own transfer syntax was refused. Default is Explicit VR
+  /// Little Endian.
+  void SetFallbackTransferSyntax( TransferSyntax const &ts );
+
+  /// C-STORE each file, the status of each C-STORE-RSP is returned in
+  /// statuses (0xFFFF when the file could not be sent). Return false if any
+  /// file was not stored. The associations are left open for the next call.
+  bool SendStore( std::vector<std::string> const & filenames,
+    std::vector<uint16_t> &statuses );
+
+  /// Number of associations (re)negotiated by the last SendStore
+  unsigned int GetNumberOfNegotiations() const;
+  /// Number of files transcoded by the last SendStore
+  size_t GetNumberOfTranscodedFiles() const;
+
+  /// Release all associations
+  void Close();
+
+private:
+  StoreSCUPool(const StoreSCUPool&);  // Not implemented.
+  void operator=(const StoreSCUPool&);  // Not implemented.
+
+  StoreSCUPoolInternals *Internals;
+};
+
+} // end namespace gdcm
+
+#endif //GDCMSTORESCUPOOL_H
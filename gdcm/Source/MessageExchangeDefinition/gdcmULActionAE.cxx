@@ -30,8 +30,10 @@ each class have its own file for the sake of brevity of the number of files.
 #include "gdcmAAssociateRQPDU.h"
 #include "gdcmAAssociateACPDU.h"
 #include "gdcmAAssociateRJPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
 
 #include <socket++/echo.h>//for setting up the local socket
+#include <algorithm> // std::min
 
 namespace gdcm
 {
@@ -79,6 +81,19 @@ EStateID ULActionAE2::PerformAction(Subject *, ULEvent& , ULConnection& inConnec
     thePDU.AddPresentationContext(*itor);
     }
 
+  // only propose an Asynchronous Operations Window when asked to, some
+  // implementations reject sub-items they do not know
+  if( inConnection.GetMaxOperationsInvoked() != 1 )
+    {
+    AsynchronousOperationsWindowSub aows;
+    aows.SetMaximumNumberOperationsInvoked( inConnection.GetMaxOperationsInvoked() );
+    aows.SetMaximumNumberOperationsPerformed( 1 );
+    UserInformation ui;
+    ui = thePDU.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( aows );
+    thePDU.SetUserInformation( ui );
+    }
+
   thePDU.Write(*inConnection.GetProtocol());
   inConnection.GetProtocol()->flush();
 
@@ -103,6 +118,20 @@ EStateID ULActionAE3::PerformAction(Subject *, ULEvent& inEvent, ULConnection& i
   uint32_t maxpdu = acpdu->GetUserInformation().GetMaximumLengthSub().GetMaximumLength();
   inConnection.SetMaxPDUSize(maxpdu);
 
+  // PS 3.7, D.3.3.3.1: without the sub-item in the AC the operations are
+  // synchronous, otherwise the server may lower (never raise) our proposal
+  const uint16_t proposed = inConnection.GetMaxOperationsInvoked();
+  uint16_t window = 1;
+  if( const AsynchronousOperationsWindowSub *aows =
+    acpdu->GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    const uint16_t accepted = aows->GetMaximumNumberOperationsInvoked();
+    if( !accepted ) window = proposed;
+    else if( !proposed ) window = accepted;
+    else window = std::min( proposed, accepted );
+    }
+  inConnection.SetMaxOperationsInvoked( window );
+
   // once again duplicate AAssociateACPDU vs ULConnection
   for( unsigned int index = 0; index < acpdu->GetNumberOfPresentationContextAC(); index++ ){
     PresentationContextAC const &pc = acpdu->GetPresentationContextAC(index);
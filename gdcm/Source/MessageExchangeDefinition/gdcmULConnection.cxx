@@ -19,6 +19,9 @@
 
 #include <algorithm> // std::find
 #include <socket++/echo.h>
+#ifndef _WIN32
+#include <netinet/tcp.h> // TCP_NODELAY
+#endif
 
 namespace gdcm
 {
@@ -30,6 +33,9 @@ ULConnection::ULConnection(const ULConnectionInfo& inConnectInfo)
   mSocket = NULL;
   mEcho = NULL;
   mInfo = inConnectInfo;
+  mMaxPDUSize = 0;
+  mMaxOperationsInvoked = 1;
+  mMessageID = 0;
 
   TransferSyntaxSub ts1;
   ts1.SetNameFromUID( UIDs::ImplicitVRLittleEndianDefaultTransferSyntaxforDICOM );
@@ -96,6 +102,23 @@ uint32_t ULConnection::GetMaxPDUSize() const
   return mMaxPDUSize;
 }
 
+void ULConnection::SetMaxOperationsInvoked(uint16_t inMaxOperations)
+{
+  mMaxOperationsInvoked = inMaxOperations;
+}
+
+uint16_t ULConnection::GetMaxOperationsInvoked() const
+{
+  return mMaxOperationsInvoked;
+}
+
+uint16_t ULConnection::GetNextMessageID() const
+{
+  // skip 0 when wrapping around
+  if( ++mMessageID == 0 ) ++mMessageID;
+  return mMessageID;
+}
+
 std::vector<PresentationContextRQ> const &
 ULConnection::GetPresentationContexts() const
 {
@@ -164,6 +187,10 @@ bool ULConnection::InitializeConnection()
     //make sure to convert timeouts to platform appropriate values.
     (*p)->recvtimeout((int)GetTimer().GetTimeout());
     (*p)->sendtimeout((int)GetTimer().GetTimeout());
+    //a PDU is written in several pieces, do not let Nagle hold back the last
+    //one until the peer (delayed) ACK: this stalls every synchronous C-STORE
+    int nodelay = 1;
+    (*p)->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
     if (mEcho != NULL)
       {
       delete mEcho;
@@ -222,6 +249,8 @@ bool ULConnection::InitializeIncomingConnection()
     if (sin.is_readready(60, 0))
       {
       mSocket = new iosockinet(sin.accept());
+      int nodelay = 1;
+      (*mSocket)->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
       }
     else
       {
@@ -323,7 +352,6 @@ uint8_t ULConnection::GetPresentationContextIDFromPresentationContext(Presentati
     ret = it->GetPresentationContextID();
     }
 
-  assert( ret );
   return ret;
 }
 
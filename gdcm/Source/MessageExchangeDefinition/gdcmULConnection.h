@@ -71,6 +71,11 @@ class ULConnection
       std::vector<PresentationContextRQ> mPresentationContexts;
       //this is our list of presentation contexts of what we can send
       uint32_t mMaxPDUSize;
+      //number of outstanding operations we propose to invoke, then the value
+      //agreed upon with the server (1 means synchronous operations)
+      uint16_t mMaxOperationsInvoked;
+      //Message ID of the last request sent on this association
+      mutable uint16_t mMessageID;
 
       std::vector<PresentationContextAC> mAcceptedPresentationContexts;//these come back from the server
       //and tell us what can be sent over this connection
@@ -104,6 +109,18 @@ class ULConnection
       void SetMaxPDUSize(uint32_t inSize);
       uint32_t GetMaxPDUSize() const;
 
+      /// Asynchronous Operations Window (PS 3.7, D.3.3.3): before the
+      /// association this is the number of outstanding operations proposed
+      /// to the server, after it this is the negotiated value. Default is 1
+      /// (synchronous operations, no negotiation). 0 means unlimited.
+      void SetMaxOperationsInvoked(uint16_t inMaxOperations);
+      uint16_t GetMaxOperationsInvoked() const;
+
+      /// Message ID for the next request sent on this association. Message
+      /// IDs only have to be unique among the outstanding operations of an
+      /// association (PS 3.7, 9.1.1.1), so each connection has its own counter.
+      uint16_t GetNextMessageID() const;
+
       const PresentationContextAC *GetPresentationContextACByID(uint8_t id) const;
       const PresentationContextRQ *GetPresentationContextRQByID(uint8_t id) const;
 
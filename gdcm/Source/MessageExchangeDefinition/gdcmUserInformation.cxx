@@ -295,9 +295,10 @@ UserInformation &UserInformation::operator=(const UserInformation& ui)
   ItemLength = ui.ItemLength;
   MLS = ui.MLS;
   ICUID = ui.ICUID;
+  delete AOWS;
+  AOWS = NULL;
   if( ui.AOWS )
     {
-    delete AOWS;
     AOWS = new AsynchronousOperationsWindowSub;
     *AOWS = *ui.AOWS;
     }
@@ -324,5 +325,13 @@ void UserInformation::AddSOPClassExtendedNegociationSub( SOPClassExtendedNegocia
   assert( (size_t)ItemLength + 4 == Size() );
 }
 
+void UserInformation::SetAsynchronousOperationsWindowSub( AsynchronousOperationsWindowSub const & aows )
+{
+  if( !AOWS ) AOWS = new AsynchronousOperationsWindowSub;
+  *AOWS = aows;
+  ItemLength = (uint16_t)(Size() - 4);
+  assert( (size_t)ItemLength + 4 == Size() );
+}
+
 } // end namespace network
 } // end namespace gdcm
@@ -57,6 +57,11 @@ public:
   void AddRoleSelectionSub( RoleSelectionSub const & r );
   void AddSOPClassExtendedNegociationSub( SOPClassExtendedNegociationSub const & s );
 
+  /// Asynchronous Operations Window negotiation, NULL when not present
+  /// (the default: operations are performed synchronously)
+  void SetAsynchronousOperationsWindowSub( AsynchronousOperationsWindowSub const & aows );
+  const AsynchronousOperationsWindowSub *GetAsynchronousOperationsWindowSub() const { return AOWS; }
+
 private:
   static const uint8_t ItemType;
   static const uint8_t Reserved2;
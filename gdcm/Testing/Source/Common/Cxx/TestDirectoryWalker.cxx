@@ -0,0 +1,131 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmDirectoryWalker.h"
+#include "gdcmDirectory.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace
+{
+class CountingConsumer : public gdcm::DirectoryWalker::Consumer
+{
+public:
+  gdcm::Directory::FilenamesType Filenames;
+  void Consume(gdcm::Directory::FilenameType const &filename)
+    {
+    Filenames.push_back( filename );
+    }
+};
+
+// depth x fanout tree, with 3 files per directory + one hidden file
+bool CreateTree(std::string const &root, int depth, int fanout)
+{
+  if( !gdcm::System::MakeDirectory( root.c_str() ) ) return false;
+  for( int f = 0; f < 3; ++f )
+    {
+    std::ostringstream os;
+    os << root << "/file" << f << ".dcm";
+    std::ofstream out( os.str().c_str() );
+    out << "dummy";
+    }
+  std::ofstream hidden( (root + "/.hidden").c_str() );
+  hidden << "hidden";
+  if( depth == 0 ) return true;
+  for( int d = 0; d < fanout; ++d )
+    {
+    std::ostringstream os;
+    os << root << "/dir" << d;
+    if( !CreateTree( os.str(), depth - 1, fanout ) ) return false;
+    }
+  return true;
+}
+}
+
+int TestDirectoryWalker(int , char *[])
+{
+  const char *subdir = "TestDirectoryWalker";
+  std::string root = gdcm::Testing::GetTempDirectory( subdir );
+  root += "/tree";
+  gdcm::System::DeleteDirectory( root.c_str() );
+  if( !CreateTree( root, 3, 3 ) )
+    {
+    std::cerr << "Could not create tree in: " << root << std::endl;
+    return 1;
+    }
+  // 1 + 3 + 9 + 27 directories
+  const unsigned int ndirs = 40;
+
+  gdcm::Directory d;
+  const unsigned int nref = d.Load( root, true );
+  if( nref != 3 * ndirs )
+    {
+    std::cerr << "Directory found: " << nref << std::endl;
+    return 1;
+    }
+  gdcm::Directory::FilenamesType ref = d.GetFilenames();
+  std::sort( ref.begin(), ref.end() );
+
+  int res = 0;
+  const unsigned int nthreads[] = { 1, 2, 8 };
+  for( unsigned int i = 0; i < sizeof(nthreads) / sizeof(*nthreads); ++i )
+    {
+    gdcm::DirectoryWalker w;
+    w.SetNumberOfThreads( nthreads[i] );
+    const unsigned int n = w.Walk( root );
+    gdcm::Directory::FilenamesType files = w.GetFilenames();
+    std::sort( files.begin(), files.end() );
+    if( n != nref || files != ref )
+      {
+      std::cerr << "Mismatch with " << nthreads[i] << " threads: " << n << std::endl;
+      ++res;
+      }
+    if( w.GetDirectories().size() != ndirs )
+      {
+      std::cerr << "Wrong number of directories: " << w.GetDirectories().size() << std::endl;
+      ++res;
+      }
+    }
+
+  // streaming mode
+  CountingConsumer c;
+  gdcm::DirectoryWalker w;
+  w.SetNumberOfThreads( 4 );
+  w.SetConsumer( &c );
+  if( w.Walk( root ) != nref || !w.GetFilenames().empty() )
+    {
+    std::cerr << "Consumer mode should not collect filenames" << std::endl;
+    ++res;
+    }
+  std::sort( c.Filenames.begin(), c.Filenames.end() );
+  if( c.Filenames != ref )
+    {
+    std::cerr << "Consumer did not receive all filenames" << std::endl;
+    ++res;
+    }
+
+  // non recursive
+  gdcm::DirectoryWalker flat;
+  if( flat.Walk( root, false ) != 3 )
+    {
+    std::cerr << "Non recursive walk failed" << std::endl;
+    ++res;
+    }
+
+  gdcm::System::DeleteDirectory( root.c_str() );
+  return res;
+}
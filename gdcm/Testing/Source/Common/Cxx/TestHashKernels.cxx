@@ -0,0 +1,223 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmHashKernels.h"
+#include "gdcmSHA1.h"
+#include "gdcmSHA256.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+typedef gdcm::HashKernels HK;
+
+const HK::InstructionSetType InstructionSets[] = { HK::SCALAR, HK::SHANI, HK::ARMV8 };
+const size_t NInstructionSets = sizeof(InstructionSets) / sizeof(*InstructionSets);
+
+// FIPS 180-4 examples
+struct Vector
+{
+  const char *Message;
+  size_t Repeat;
+  const char *SHA1;
+  const char *SHA256;
+};
+const Vector Vectors[] = {
+  { "", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+  { "abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d",
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+  { "a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+const size_t NVectors = sizeof(Vectors) / sizeof(*Vectors);
+
+// RFC 4231, test cases 1, 2, 4 and 6 (key larger than a block)
+struct HMACVector
+{
+  std::string Key;
+  std::string Data;
+  const char *Digest;
+};
+
+std::string Hex(const unsigned char *d, size_t n)
+{
+  static const char hex[] = "0123456789abcdef";
+  std::string s;
+  for( size_t i = 0; i < n; ++i )
+    {
+    s += hex[d[i] >> 4];
+    s += hex[d[i] & 0xf];
+    }
+  return s;
+}
+
+bool TestVectors()
+{
+  for( size_t i = 0; i < NVectors; ++i )
+    {
+    const Vector &v = Vectors[i];
+    std::string msg;
+    for( size_t r = 0; r < v.Repeat; ++r ) msg += v.Message;
+    char sha1[2*20+1];
+    char sha256[2*32+1];
+    // SHA1::Compute refuses an empty buffer
+    const bool b1 = msg.empty() || gdcm::SHA1::Compute( msg.c_str(), (unsigned long)msg.size(), sha1 );
+    const bool b256 = gdcm::SHA256::Compute( msg.c_str(), (unsigned long)msg.size(), sha256 );
+    if( !b1 || !b256 || (!msg.empty() && strcmp( sha1, v.SHA1 ) != 0)
+      || strcmp( sha256, v.SHA256 ) != 0 )
+      {
+      std::cerr << "Wrong digest for vector " << i << " with "
+        << HK::GetInstructionSetString( HK::GetInstructionSet() ) << std::endl;
+      return false;
+      }
+
+    // same message, streamed with odd sizes
+    gdcm::SHA1 s1;
+    gdcm::SHA256 s256;
+    size_t pos = 0;
+    for( size_t step = 1; pos < msg.size(); step = step * 3 + 1 )
+      {
+      const size_t len = std::min( step % 1000, msg.size() - pos );
+      s1.Update( msg.c_str() + pos, len );
+      s256.Update( msg.c_str() + pos, len );
+      pos += len;
+      }
+    unsigned char d1[20], d256[32];
+    s1.Final( d1 );
+    s256.Final( d256 );
+    if( Hex( d1, 20 ) != v.SHA1 || Hex( d256, 32 ) != v.SHA256 )
+      {
+      std::cerr << "Wrong streamed digest for vector " << i << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+bool TestHMAC()
+{
+  HMACVector vectors[4];
+  vectors[0].Key = std::string( 20, '\x0b' );
+  vectors[0].Data = "Hi There";
+  vectors[0].Digest = "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7";
+  vectors[1].Key = "Jefe";
+  vectors[1].Data = "what do ya want for nothing?";
+  vectors[1].Digest = "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843";
+  for( int i = 1; i <= 25; ++i ) vectors[2].Key += (char)i;
+  vectors[2].Data = std::string( 50, '\xcd' );
+  vectors[2].Digest = "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b";
+  vectors[3].Key = std::string( 131, '\xaa' );
+  vectors[3].Data = "Test Using Larger Than Block-Size Key - Hash Key First";
+  vectors[3].Digest = "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54";
+  for( int i = 0; i < 4; ++i )
+    {
+    char digest[2*32+1];
+    const HMACVector &v = vectors[i];
+    if( !gdcm::SHA256::ComputeHMAC( v.Key.c_str(), v.Key.size(),
+        v.Data.c_str(), (unsigned long)v.Data.size(), digest )
+      || strcmp( digest, v.Digest ) != 0 )
+      {
+      std::cerr << "Wrong HMAC for test case " << i << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+// The block functions of instruction set 'is' against the scalar ones
+bool TestBlocks(HK::InstructionSetType is)
+{
+  std::vector<unsigned char> data( 64 * 65 );
+  for( size_t i = 0; i < data.size(); ++i ) data[i] = (unsigned char)(rand() & 0xff);
+  for( size_t n = 0; n <= 65; n += 1 + n / 4 )
+    {
+    uint32_t ref1[5], ref256[8], out1[5], out256[8];
+    for( int i = 0; i < 8; ++i ) ref256[i] = out256[i] = (uint32_t)rand();
+    for( int i = 0; i < 5; ++i ) ref1[i] = out1[i] = ref256[i];
+    HK::SetInstructionSet( HK::SCALAR );
+    HK::SHA1Blocks( ref1, &data[0], n );
+    HK::SHA256Blocks( ref256, &data[0], n );
+    HK::SetInstructionSet( is );
+    HK::SHA1Blocks( out1, &data[0], n );
+    HK::SHA256Blocks( out256, &data[0], n );
+    if( memcmp( ref1, out1, sizeof(ref1) ) != 0 || memcmp( ref256, out256, sizeof(ref256) ) != 0 )
+      {
+      std::cerr << "Block mismatch with " << HK::GetInstructionSetString( is )
+        << " for n=" << n << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+}
+
+int TestHashKernels(int, char *[])
+{
+  const HK::InstructionSetType best = HK::GetBestInstructionSet();
+  if( HK::GetInstructionSet() != best )
+    {
+    std::cerr << "Not using the best instruction set" << std::endl;
+    return 1;
+    }
+  std::cout << "Best: " << HK::GetInstructionSetString( best ) << std::endl;
+
+  int res = 0;
+  for( size_t i = 0; i < NInstructionSets; ++i )
+    {
+    const HK::InstructionSetType is = InstructionSets[i];
+    if( !HK::IsInstructionSetSupported( is ) )
+      {
+      if( HK::SetInstructionSet( is ) )
+        {
+        std::cerr << "Could set " << HK::GetInstructionSetString( is ) << std::endl;
+        ++res;
+        }
+      continue;
+      }
+    if( !TestBlocks( is ) ) ++res;
+    HK::SetInstructionSet( is );
+    if( !TestVectors() || !TestHMAC() ) ++res;
+    }
+  HK::SetInstructionSet( best );
+
+  // Final leaves the object ready for a new message
+  gdcm::SHA256 sha;
+  unsigned char d[32];
+  sha.Update( "xyz", 3 );
+  sha.Final( d );
+  sha.Update( "abc", 3 );
+  sha.Final( d );
+  if( Hex( d, 32 ) != Vectors[1].SHA256 )
+    {
+    std::cerr << "Final did not reset" << std::endl;
+    ++res;
+    }
+
+  char digest[2*20+1];
+  if( gdcm::SHA1::Compute( NULL, 0, digest ) || gdcm::SHA256::Compute( NULL, 1, digest ) )
+    {
+    std::cerr << "Invalid buffer accepted" << std::endl;
+    ++res;
+    }
+  return res;
+}
@@ -0,0 +1,221 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmPixelKernels.h"
+#include "gdcmByteSwap.h"
+
+#include <iostream>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+typedef gdcm::PixelKernels PK;
+
+// lengths around the vector widths, plus a couple of large ones
+const size_t Lengths[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 23, 24, 25,
+  31, 32, 33, 47, 48, 49, 63, 64, 65, 127, 1001, 4099 };
+const size_t NLengths = sizeof(Lengths) / sizeof(*Lengths);
+
+const PK::InstructionSetType InstructionSets[] = { PK::SSE2, PK::AVX2, PK::NEON };
+const size_t NInstructionSets = sizeof(InstructionSets) / sizeof(*InstructionSets);
+
+std::vector<unsigned char> Random(size_t n)
+{
+  std::vector<unsigned char> v(n + 1); // never empty
+  for( size_t i = 0; i < v.size(); ++i ) v[i] = (unsigned char)(rand() & 0xff);
+  return v;
+}
+
+// Run 'f' with scalar and with instruction set 'is' on copies of 'in'
+template <typename F>
+bool Compare(PK::InstructionSetType is, F f, const std::vector<unsigned char> &in,
+  size_t outlen, const char *name, size_t n)
+{
+  std::vector<unsigned char> in1 = in, in2 = in;
+  std::vector<unsigned char> out1(outlen + 1, 0xcd), out2(outlen + 1, 0xcd);
+  PK::SetInstructionSet( PK::SCALAR );
+  f( &out1[0], &in1[0], n );
+  PK::SetInstructionSet( is );
+  f( &out2[0], &in2[0], n );
+  if( in1 != in2 || out1 != out2 )
+    {
+    std::cerr << name << " mismatch with " << PK::GetInstructionSetString(is)
+      << " for n=" << n << std::endl;
+    return false;
+    }
+  return true;
+}
+
+struct SwapBytes16 { void operator()(unsigned char *, unsigned char *p, size_t n) const
+  { PK::SwapBytes16((uint16_t*)p, n); } };
+struct SwapBytes32 { void operator()(unsigned char *, unsigned char *p, size_t n) const
+  { PK::SwapBytes32((uint32_t*)p, n); } };
+struct SwapWords32 { void operator()(unsigned char *, unsigned char *p, size_t n) const
+  { PK::SwapWords32((uint32_t*)p, n); } };
+struct Unpack { void operator()(unsigned char *o, unsigned char *p, size_t n) const
+  { PK::Unpack12Bits((uint16_t*)o, p, n); } };
+struct Pack { void operator()(unsigned char *o, unsigned char *p, size_t n) const
+  { PK::Pack12Bits(o, (const uint16_t*)p, n); } };
+
+struct Rescale
+{
+  PK::ScalarType Out, In;
+  double Intercept, Slope;
+  bool Inverse;
+  void operator()(unsigned char *o, unsigned char *p, size_t n) const
+    {
+    if( Inverse )
+      PK::InverseRescale(o, Out, p, In, Intercept, Slope, n);
+    else
+      PK::Rescale(o, Out, p, In, Intercept, Slope, n);
+    }
+};
+
+size_t SizeOf(PK::ScalarType t)
+{
+  switch(t)
+    {
+  case PK::INT16: case PK::UINT16: return 2;
+  case PK::INT32: case PK::FLOAT32: return 4;
+  case PK::FLOAT64: return 8;
+    }
+  return 0;
+}
+
+// Input pixel values in [0,4095] so that every result is representable
+std::vector<unsigned char> RandomPixels(PK::ScalarType t, size_t n)
+{
+  std::vector<unsigned char> v(n * SizeOf(t) + 1);
+  for( size_t i = 0; i < n; ++i )
+    {
+    const int r = rand() % 4096;
+    switch(t)
+      {
+    case PK::INT16: { int16_t x = (int16_t)r; memcpy(&v[2*i], &x, 2); } break;
+    case PK::UINT16: { uint16_t x = (uint16_t)r; memcpy(&v[2*i], &x, 2); } break;
+    case PK::INT32: { int32_t x = r; memcpy(&v[4*i], &x, 4); } break;
+    case PK::FLOAT32: { float x = (float)r + (float)(rand() % 100) / 100.f; memcpy(&v[4*i], &x, 4); } break;
+    case PK::FLOAT64: { double x = r + (rand() % 1000) / 1000.; memcpy(&v[8*i], &x, 8); } break;
+      }
+    }
+  return v;
+}
+
+int TestKnownValues()
+{
+  int res = 0;
+  // 12bits unpacking, same values as in TestUnpacker12Bits
+  const unsigned char packed[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab };
+  const uint16_t unpacked[] = { 0x301, 0x452, 0x967, 0xab8 };
+  uint16_t out[4];
+  PK::Unpack12Bits(out, packed, 6);
+  if( memcmp(out, unpacked, sizeof(out)) != 0 ) ++res;
+  unsigned char repacked[6];
+  PK::Pack12Bits(repacked, unpacked, 4);
+  if( memcmp(repacked, packed, sizeof(packed)) != 0 ) ++res;
+
+  // SwapCode semantic of the ByteSwap specializations
+  uint32_t w[] = { 0x01020304, 0x05060708 };
+  gdcm::ByteSwap<uint32_t>::SwapRangeFromSwapCodeIntoSystem(w, gdcm::SwapCode::BadLittleEndian, 2);
+  if( w[0] != 0x03040102 || w[1] != 0x07080506 ) ++res;
+  gdcm::ByteSwap<uint32_t>::SwapRangeFromSwapCodeIntoSystem(w, gdcm::SwapCode::BadBigEndian, 2);
+  if( w[0] != 0x04030201 || w[1] != 0x08070605 ) ++res;
+  // 16bits words are swapped for 4321 and 2143 only, like Swap4
+  const gdcm::SwapCode::SwapCodeType codes[] = { gdcm::SwapCode::LittleEndian,
+    gdcm::SwapCode::BigEndian, gdcm::SwapCode::BadLittleEndian,
+    gdcm::SwapCode::BadBigEndian };
+  const uint16_t swapped[] = { 0x0102, 0x0201, 0x0102, 0x0201 };
+  for( int c = 0; c < 4; ++c )
+    {
+    uint16_t s[19];
+    for( int i = 0; i < 19; ++i ) s[i] = 0x0102;
+    gdcm::ByteSwap<uint16_t>::SwapRangeFromSwapCodeIntoSystem(s, codes[c], 19);
+    for( int i = 0; i < 19; ++i )
+      {
+      uint16_t ref = 0x0102;
+      gdcm::ByteSwap<uint16_t>::SwapFromSwapCodeIntoSystem(ref, codes[c]);
+      if( s[i] != swapped[c] || ref != swapped[c] ) { ++res; break; }
+      }
+    }
+  if( res ) std::cerr << "Known values failed" << std::endl;
+  return res;
+}
+}
+
+int TestPixelKernels(int, char *[])
+{
+  srand( 1234 );
+  const PK::InstructionSetType best = PK::GetInstructionSet();
+  std::cout << "Best instruction set: " << PK::GetInstructionSetString(best) << std::endl;
+  if( !PK::IsInstructionSetSupported( PK::SCALAR ) ) return 1;
+
+  int res = 0;
+  for( size_t k = 0; k < NInstructionSets; ++k )
+    {
+    PK::SetInstructionSet( PK::SCALAR );
+    res += TestKnownValues();
+    const PK::InstructionSetType is = InstructionSets[k];
+    if( !PK::IsInstructionSetSupported(is) )
+      {
+      if( PK::SetInstructionSet(is) ) ++res;
+      continue;
+      }
+    PK::SetInstructionSet( is );
+    res += TestKnownValues();
+    std::cout << "Testing: " << PK::GetInstructionSetString(is) << std::endl;
+    for( size_t l = 0; l < NLengths; ++l )
+      {
+      const size_t n = Lengths[l];
+      std::vector<unsigned char> in = Random(4 * n);
+      if( !Compare(is, SwapBytes16(), in, 0, "SwapBytes16", n) ) ++res;
+      if( !Compare(is, SwapBytes32(), in, 0, "SwapBytes32", n) ) ++res;
+      if( !Compare(is, SwapWords32(), in, 0, "SwapWords32", n) ) ++res;
+      // whole 12bits triplets only:
+      const size_t nbytes = n / 3 * 3;
+      if( !Compare(is, Unpack(), in, nbytes / 3 * 4, "Unpack12Bits", nbytes) ) ++res;
+      // any 16bits value, not only 12bits ones:
+      const size_t nwords = n / 2 * 2;
+      if( !Compare(is, Pack(), in, nwords / 2 * 3, "Pack12Bits", nwords) ) ++res;
+
+      const PK::ScalarType types[] = { PK::INT16, PK::UINT16, PK::INT32, PK::FLOAT32, PK::FLOAT64 };
+      const double params[][2] = { { 0, 1 }, { 1024, 1 }, { 0.5, 0.25 }, { 3.7, 2.5 } };
+      for( int ti = 0; ti < 5; ++ti )
+        for( int to = 0; to < 5; ++to )
+          for( int p = 0; p < 4; ++p )
+            {
+            Rescale r;
+            r.In = types[ti];
+            r.Out = types[to];
+            r.Intercept = params[p][0];
+            r.Slope = params[p][1];
+            std::vector<unsigned char> pixels = RandomPixels(r.In, n);
+            std::vector<unsigned char> dummy(SizeOf(r.Out) * n);
+            r.Inverse = false;
+            const bool fwd = PK::Rescale(&dummy[0] , r.Out, &pixels[0], r.In, 0, 1, 0);
+            if( fwd != (r.In == PK::INT16 || r.In == PK::UINT16) ) ++res;
+            if( fwd && !Compare(is, r, pixels, SizeOf(r.Out) * n, "Rescale", n) ) ++res;
+            // negate the intercept so that the result is positive:
+            r.Inverse = true;
+            r.Intercept = -r.Intercept;
+            const bool inv = PK::InverseRescale(&dummy[0], r.Out, &pixels[0], r.In, 0, 1, 0);
+            if( inv != (r.In != PK::INT32 && SizeOf(r.Out) <= 4 && r.Out != PK::FLOAT32) ) ++res;
+            if( inv && !Compare(is, r, pixels, SizeOf(r.Out) * n, "InverseRescale", n) ) ++res;
+            }
+      }
+    }
+  PK::SetInstructionSet( best );
+  return res;
+}
@@ -0,0 +1,111 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmXXHash3.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <string.h>
+
+namespace
+{
+// length of the message, one per code path: empty, 1-3, 4-8, 9-16, 17-128,
+// 129-240 bytes, then more than 240 bytes, ending on stripe and block
+// boundaries or not
+struct Vector
+{
+  size_t Length;
+  const char *Digest;
+};
+const Vector Vectors[] = {
+  { 0, "2d06800538d394c2" },
+  { 3, "c3489259e968ad9e" },
+  { 5, "559935c0f3f7327f" },
+  { 12, "305c5bae3681d0e0" },
+  { 100, "6dbb812cf19d012e" },
+  { 200, "7c64f3b17285e96a" },
+  { 241, "541b19226f0052e8" },
+  { 1000, "d1db6a0afea2cc82" },
+  { 16385, "3997ecc693121292" },
+  { 100000, "b25cea78018497ff" },
+};
+const size_t NVectors = sizeof(Vectors) / sizeof(*Vectors);
+
+std::string Message(size_t len)
+{
+  std::string s( len, 0 );
+  for( size_t i = 0; i < len; ++i ) s[i] = (char)(i * 7 + i / 256);
+  return s;
+}
+
+std::string Hex(const unsigned char *d, size_t n)
+{
+  static const char hex[] = "0123456789abcdef";
+  std::string s;
+  for( size_t i = 0; i < n; ++i )
+    {
+    s += hex[d[i] >> 4];
+    s += hex[d[i] & 0xf];
+    }
+  return s;
+}
+}
+
+int TestXXHash3(int, char *[])
+{
+  int res = 0;
+  char digest[2*8+1];
+  if( !gdcm::XXHash3::Compute( "abc", 3, digest ) || strcmp( digest, "78af5f94892f3950" ) != 0 )
+    {
+    std::cerr << "Wrong digest for abc" << std::endl;
+    ++res;
+    }
+
+  const size_t steps[] = { 1, 3, 63, 64, 65, 255, 256, 257, 4096 };
+  for( size_t i = 0; i < NVectors; ++i )
+    {
+    const Vector &v = Vectors[i];
+    const std::string msg = Message( v.Length );
+    if( !gdcm::XXHash3::Compute( msg.c_str(), (unsigned long)msg.size(), digest )
+      || strcmp( digest, v.Digest ) != 0 )
+      {
+      std::cerr << "Wrong digest for length " << v.Length << std::endl;
+      ++res;
+      }
+
+    // streamed, the internal buffer being filled in every possible way
+    gdcm::XXHash3 xxh;
+    for( size_t s = 0; s < sizeof(steps) / sizeof(*steps); ++s )
+      {
+      for( size_t pos = 0; pos < msg.size(); pos += steps[s] )
+        xxh.Update( msg.c_str() + pos, std::min( steps[s], msg.size() - pos ) );
+      unsigned char d[8];
+      xxh.Final( d );
+      if( Hex( d, 8 ) != v.Digest )
+        {
+        std::cerr << "Wrong streamed digest for length " << v.Length
+          << " by " << steps[s] << std::endl;
+        ++res;
+        }
+      }
+    }
+
+  if( gdcm::XXHash3::Compute( NULL, 1, digest ) )
+    {
+    std::cerr << "Invalid buffer accepted" << std::endl;
+    ++res;
+    }
+  return res;
+}
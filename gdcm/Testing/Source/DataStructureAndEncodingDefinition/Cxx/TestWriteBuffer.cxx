@@ -0,0 +1,232 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmWriteBuffer.h"
+#include "gdcmWriter.h"
+#include "gdcmFile.h"
+#include "gdcmItem.h"
+#include "gdcmSequenceOfItems.h"
+#include "gdcmExplicitDataElement.h"
+
+#include <sstream>
+#include <string.h>
+
+namespace
+{
+void AddValue(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::VR const &vr,
+  const char *value, uint32_t length)
+{
+  gdcm::DataElement de( t );
+  de.SetVR( vr );
+  de.SetByteValue( value, length );
+  ds.Insert( de );
+}
+
+void AddString(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::VR const &vr, const char *value)
+{
+  AddValue( ds, t, vr, value, (uint32_t)strlen(value) );
+}
+
+void AddSequence(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::SequenceOfItems *sq, bool defined)
+{
+  gdcm::DataElement de( t );
+  de.SetVR( gdcm::VR::SQ );
+  de.SetValue( *sq );
+  if( defined )
+    {
+    sq->SetLength( 0 );
+    const gdcm::VL l = sq->ComputeLength<gdcm::ExplicitDataElement>();
+    sq->SetLength( l );
+    de.SetVL( l );
+    }
+  else
+    {
+    sq->SetLengthToUndefined();
+    de.SetVLToUndefined();
+    }
+  ds.Insert( de );
+}
+
+// A bit of everything the serialization has to care about
+void FillDataSet(gdcm::DataSet &ds, bool defined)
+{
+  AddString( ds, gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.481.3" );
+  AddString( ds, gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.3.4.5.6.7" ); // odd
+  AddString( ds, gdcm::Tag(0x0008,0x0020), gdcm::VR::DA, "20110101" );
+  AddValue( ds, gdcm::Tag(0x0008,0x0050), gdcm::VR::SH, 0, 0 ); // empty
+  AddString( ds, gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^John" );
+  const uint16_t us[3] = { 1, 512, 65535 };
+  AddValue( ds, gdcm::Tag(0x0028,0x0010), gdcm::VR::US, (const char*)us, 2 );
+  const uint32_t ul[2] = { 1, 0xdeadbeef };
+  AddValue( ds, gdcm::Tag(0x0028,0x0034), gdcm::VR::UL, (const char*)ul, 8 );
+  const double fd[2] = { 1.5, -42.25 };
+  AddValue( ds, gdcm::Tag(0x0018,0x9089), gdcm::VR::FD, (const char*)fd, 16 );
+  const uint16_t at[2] = { 0x0010, 0x0020 };
+  AddValue( ds, gdcm::Tag(0x0020,0x5000), gdcm::VR::AT, (const char*)at, 4 );
+  AddString( ds, gdcm::Tag(0x0029,0x0010), gdcm::VR::LO, "PRIVATE CREATOR" );
+  AddValue( ds, gdcm::Tag(0x0029,0x1010), gdcm::VR::INVALID, "\x01\x02\x03\x04", 4 );
+  AddValue( ds, gdcm::Tag(0x0029,0x1011), gdcm::VR::UN, "\x01\x02\x03", 3 );
+
+  gdcm::SmartPointer<gdcm::SequenceOfItems> rois = new gdcm::SequenceOfItems;
+  for( int r = 0; r < 3; ++r )
+    {
+    gdcm::Item roi;
+    gdcm::DataSet &rds = roi.GetNestedDataSet();
+    AddString( rds, gdcm::Tag(0x3006,0x002a), gdcm::VR::IS, "255\\0\\0 " );
+    gdcm::SmartPointer<gdcm::SequenceOfItems> contours = new gdcm::SequenceOfItems;
+    for( int c = 0; c < 4; ++c )
+      {
+      gdcm::Item contour;
+      gdcm::DataSet &cds = contour.GetNestedDataSet();
+      AddString( cds, gdcm::Tag(0x3006,0x0042), gdcm::VR::CS, "CLOSED_PLANAR " );
+      AddString( cds, gdcm::Tag(0x3006,0x0050), gdcm::VR::DS, "1.5\\2.25\\-42.5" );
+      // mixed item lengths in the same sequence
+      if( defined && c % 2 )
+        contour.SetVL( cds.GetLength<gdcm::ExplicitDataElement>() );
+      else
+        contour.SetVLToUndefined();
+      contours->AddItem( contour );
+      }
+    AddSequence( rds, gdcm::Tag(0x3006,0x0040), contours, defined );
+    gdcm::SmartPointer<gdcm::SequenceOfItems> empty = new gdcm::SequenceOfItems;
+    AddSequence( rds, gdcm::Tag(0x3006,0x0045), empty, defined );
+    if( defined )
+      roi.SetVL( rds.GetLength<gdcm::ExplicitDataElement>() );
+    else
+      roi.SetVLToUndefined();
+    rois->AddItem( roi );
+    }
+  AddSequence( ds, gdcm::Tag(0x3006,0x0039), rois, defined );
+
+  std::string pixels( 3 * 1024 * 1024, 0 );
+  for( size_t i = 0; i < pixels.size(); ++i ) pixels[i] = (char)(i * 7);
+  AddValue( ds, gdcm::Tag(0x7fe0,0x0010), gdcm::VR::OW, pixels.c_str(), (uint32_t)pixels.size() );
+}
+
+// Takes limit bytes, then refuses everything, like a full disk
+class FailingBuf : public std::streambuf
+{
+public:
+  FailingBuf(size_t limit):Limit(limit),Size(0) {}
+protected:
+  std::streamsize xsputn(const char *, std::streamsize n)
+    {
+    if( Size + n > Limit ) return 0;
+    Size += n;
+    return n;
+    }
+  int_type overflow(int_type c)
+    {
+    if( traits_type::eq_int_type( c, traits_type::eof() ) ) return 0;
+    return xsputn( 0, 1 ) == 1 ? c : traits_type::eof();
+    }
+private:
+  size_t Limit;
+  size_t Size;
+};
+
+std::string WriteFile(gdcm::File &file, size_t buffersize)
+{
+  std::ostringstream os;
+  gdcm::Writer w;
+  w.SetStream( os );
+  w.SetFile( file );
+  w.SetBufferSize( buffersize );
+  if( !w.Write() ) return std::string();
+  return os.str();
+}
+}
+
+int TestWriteBuffer(int , char *[])
+{
+  // The buffer alone
+  std::ostringstream os;
+  {
+  gdcm::WriteBuffer buffer( *os.rdbuf(), 256 );
+  std::ostream bos( &buffer );
+  for( int i = 0; i < 100; ++i ) bos.write( "abcd", 4 );
+  if( buffer.GetNumberOfWrites() != 1 || os.str().size() != 256 )
+    {
+    std::cerr << "small writes not gathered: " << buffer.GetNumberOfWrites() << std::endl;
+    return 1;
+    }
+  const std::string large( 1000, 'x' );
+  bos.write( large.c_str(), large.size() );
+  bos.put( 'y' );
+  bos.flush();
+  }
+  std::string expected;
+  for( int i = 0; i < 100; ++i ) expected += "abcd";
+  expected += std::string( 1000, 'x' ) + "y";
+  if( os.str() != expected )
+    {
+    std::cerr << "WriteBuffer changed the bytes" << std::endl;
+    return 1;
+    }
+
+  // Writer: the same file with or without the buffer, for every
+  // transfer syntax path
+  const gdcm::TransferSyntax::TSType ts[] = {
+    gdcm::TransferSyntax::ExplicitVRLittleEndian,
+    gdcm::TransferSyntax::ImplicitVRLittleEndian,
+    gdcm::TransferSyntax::ExplicitVRBigEndian
+  };
+  for( int defined = 0; defined < 2; ++defined )
+    {
+    for( unsigned int i = 0; i < sizeof(ts) / sizeof(*ts); ++i )
+      {
+      gdcm::SmartPointer<gdcm::File> file = new gdcm::File;
+      FillDataSet( file->GetDataSet(), defined != 0 );
+      file->GetHeader().SetDataSetTransferSyntax( ts[i] );
+      const std::string direct = WriteFile( *file, 0 );
+      const std::string buffered = WriteFile( *file, 1024 * 1024 );
+      const std::string small = WriteFile( *file, 100 );
+      if( direct.empty() || direct != buffered || direct != small )
+        {
+        std::cerr << "Output differs for " << gdcm::TransferSyntax::GetTSString( ts[i] )
+          << " defined=" << defined << ": " << direct.size() << " / "
+          << buffered.size() << " / " << small.size() << std::endl;
+        return 1;
+        }
+      }
+    }
+
+  // Writer: a stream that fails, half way or only when the buffer
+  // is passed on at the very end (a small file, all in the buffer)
+  for( int small = 0; small < 2; ++small )
+    {
+    gdcm::SmartPointer<gdcm::File> file = new gdcm::File;
+    if( small )
+      {
+      gdcm::DataSet &ds = file->GetDataSet();
+      AddString( ds, gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.7" );
+      AddString( ds, gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.3.4.5.6" );
+      AddString( ds, gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^John" );
+      }
+    else
+      FillDataSet( file->GetDataSet(), true );
+    file->GetHeader().SetDataSetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+    FailingBuf sb( small ? 0 : 1024 * 1024 );
+    std::ostream fos( &sb );
+    gdcm::Writer w;
+    w.SetStream( fos );
+    w.SetFile( *file );
+    if( w.Write() || fos.good() )
+      {
+      std::cerr << "write failure not reported, small=" << small << std::endl;
+      return 1;
+      }
+    }
+
+  return 0;
+}
@@ -13,6 +13,216 @@
 =========================================================================*/
 #include "gdcmDICOMDIR.h"
 #include "gdcmFileSet.h"
+#include "gdcmDICOMDIRGenerator.h"
+#include "gdcmDirectory.h"
+#include "gdcmReader.h"
+#include "gdcmWriter.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSequenceOfItems.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <map>
+#include <sstream>
+#include <string.h>
+
+namespace
+{
+// Media Storage SOP Class UID, group 0002 goes in the header
+void SetMediaStorage(gdcm::File &file, const char *uid)
+{
+  gdcm::DataElement de( gdcm::Tag(0x0002,0x0002) );
+  de.SetVR( gdcm::VR::UI );
+  de.SetByteValue( uid, (uint32_t)strlen(uid) );
+  file.GetHeader().Insert( de );
+}
+
+std::string SeriesUID(int series)
+{
+  std::ostringstream uid;
+  uid << "1.2.826.0.1.3680043.2.1143.43." << series;
+  return uid.str();
+}
+
+// 2 patients, 1 study each, series 0 and 1 in the first one (MR), 2 in the
+// second one (CT)
+bool WriteImage(const char *filename, int series, int instance)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream uid;
+  uid << "1.2.826.0.1.3680043.2.1143.42." << series << "." << instance;
+  const int patient = series < 2 ? 1 : 2;
+  std::ostringstream studyuid;
+  studyuid << "1.2.826.0.1.3680043.2.1143.44." << patient;
+  w.SetImage( patient == 1 ? gdcm::MediaStorage::MRImageStorage : gdcm::MediaStorage::CTImageStorage,
+    studyuid.str(), SeriesUID( series ), uid.str() );
+  if( patient == 2 ) w.AddString( gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^Jane" );
+  w.AddString( gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, patient == 1 ? "PAT1" : "PAT2" );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+// The records of a generated DICOMDIR, which are linked through their offsets
+int TestGenerated()
+{
+  const char subdir[] = "TestDICOMDIR";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  std::string imagedir = tmpdir + "/IMAGES";
+  if( !gdcm::System::FileIsDirectory( imagedir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( imagedir.c_str() );
+    }
+
+  gdcm::Directory::FilenamesType filenames;
+  std::map<std::string, int> series; // Referenced File ID -> series
+  for( int s = 2; s >= 0; --s )
+    {
+    for( int i = 0; i < 3; ++i )
+      {
+      std::ostringstream name;
+      name << "IM" << s << i;
+      std::string filename = imagedir + "/" + name.str();
+      if( !WriteImage( filename.c_str(), s, i ) )
+        {
+        std::cerr << "Could not write " << filename << std::endl;
+        return 1;
+        }
+      filenames.push_back( filename );
+      series[ "IMAGES/" + name.str() ] = s;
+      }
+    }
+
+  gdcm::DICOMDIRGenerator gen;
+  gen.SetFilenames( filenames );
+  gen.SetRootDirectory( tmpdir );
+  gen.SetDescriptor( "TESTDICOMDIR" );
+  std::string outfilename = tmpdir + "/DICOMDIR";
+  gdcm::Writer writer;
+  writer.SetFileName( outfilename.c_str() );
+  if( !gen.Generate() || !(writer.SetFile( gen.GetFile() ), writer.Write()) )
+    {
+    std::cerr << "Could not generate " << outfilename << std::endl;
+    return 1;
+    }
+
+  gdcm::Reader reader;
+  reader.SetFileName( outfilename.c_str() );
+  gdcm::DICOMDIR dd;
+  if( !reader.Read() || !dd.SetFromFile( reader.GetFile() ) )
+    {
+    std::cerr << "Could not read " << outfilename << std::endl;
+    return 1;
+    }
+  gdcm::DICOMDIR::FileRecordsType const &records = dd.GetFileRecords();
+  if( records.size() != filenames.size() )
+    {
+    std::cerr << records.size() << " file records instead of " << filenames.size() << std::endl;
+    return 1;
+    }
+  for( size_t i = 0; i < records.size(); ++i )
+    {
+    gdcm::DICOMDIR::FileRecord const &r = records[i];
+    std::map<std::string, int>::iterator it = series.find( r.ReferencedFileID );
+    if( it == series.end() )
+      {
+      std::cerr << "Unexpected Referenced File ID: " << r.ReferencedFileID << std::endl;
+      return 1;
+      }
+    const int s = it->second;
+    series.erase( it );
+    if( r.RecordType != "IMAGE"
+      || r.SeriesInstanceUID != SeriesUID( s )
+      || r.Modality != (s < 2 ? "MR" : "CT")
+      || r.PatientID != (s < 2 ? "PAT1" : "PAT2")
+      || r.PatientName != (s < 2 ? "Doe^John" : "Doe^Jane")
+      || r.StudyInstanceUID.empty()
+      || r.ReferencedSOPInstanceUID.empty()
+      || r.ReferencedTransferSyntaxUID != "1.2.840.10008.1.2.1" )
+      {
+      std::cerr << "Wrong record for " << r.ReferencedFileID << ": " << r.RecordType << " "
+        << r.PatientID << " " << r.Modality << " " << r.SeriesInstanceUID << std::endl;
+      return 1;
+      }
+    }
+
+  for( size_t i = 0; i < filenames.size(); ++i )
+    gdcm::System::RemoveFile( filenames[i].c_str() );
+  gdcm::System::RemoveFile( outfilename.c_str() );
+  return 0;
+}
+
+void AddRecord(gdcm::SequenceOfItems &sqi, const char *type, const gdcm::Tag &t, const char *value,
+  const char *fileid = NULL)
+{
+  gdcm::Item item;
+  item.SetVLToUndefined();
+  gdcm::DataSet &ds = item.GetNestedDataSet();
+  gdcm::TestingWriter::AddString( ds, gdcm::Tag(0x0004,0x1430), gdcm::VR::CS, type );
+  gdcm::TestingWriter::AddString( ds, t, t == gdcm::Tag(0x0008,0x0060) ? gdcm::VR::CS : gdcm::VR::LO, value );
+  if( fileid ) gdcm::TestingWriter::AddString( ds, gdcm::Tag(0x0004,0x1500), gdcm::VR::CS, fileid );
+  sqi.AddItem( item );
+}
+
+// Without offsets, the records are taken in sequence order
+int TestSequenceOrder()
+{
+  gdcm::SmartPointer<gdcm::SequenceOfItems> sqi = new gdcm::SequenceOfItems;
+  sqi->SetLengthToUndefined();
+  AddRecord( *sqi, "PATIENT", gdcm::Tag(0x0010,0x0020), "PAT1" );
+  AddRecord( *sqi, "STUDY", gdcm::Tag(0x0020,0x000d), "1.1" );
+  AddRecord( *sqi, "SERIES", gdcm::Tag(0x0008,0x0060), "MR" );
+  AddRecord( *sqi, "IMAGE", gdcm::Tag(0x0020,0x0013), "1", "DIR1\\IM1" );
+  AddRecord( *sqi, "IMAGE", gdcm::Tag(0x0020,0x0013), "2", "DIR1\\IM2" );
+  AddRecord( *sqi, "PATIENT", gdcm::Tag(0x0010,0x0020), "PAT2" );
+  AddRecord( *sqi, "STUDY", gdcm::Tag(0x0020,0x000d), "2.1" );
+  AddRecord( *sqi, "SERIES", gdcm::Tag(0x0008,0x0060), "CT" );
+  AddRecord( *sqi, "IMAGE", gdcm::Tag(0x0020,0x0013), "1", "DIR2\\IM1" );
+  // inactive
+  AddRecord( *sqi, "IMAGE", gdcm::Tag(0x0020,0x0013), "2", "DIR2\\IM2" );
+  const uint16_t inactive = 0;
+  gdcm::DataElement inuse( gdcm::Tag(0x0004,0x1410) );
+  inuse.SetVR( gdcm::VR::US );
+  inuse.SetByteValue( (const char*)&inactive, 2 );
+  sqi->GetItem( sqi->GetNumberOfItems() ).GetNestedDataSet().Insert( inuse );
+
+  gdcm::File file;
+  SetMediaStorage( file, "1.2.840.10008.1.3.10" );
+  file.GetHeader().SetDataSetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  gdcm::DataElement de( gdcm::Tag(0x0004,0x1220) );
+  de.SetVR( gdcm::VR::SQ );
+  de.SetValue( *sqi );
+  de.SetVLToUndefined();
+  file.GetDataSet().Insert( de );
+
+  gdcm::DICOMDIR dd;
+  if( !dd.SetFromFile( file ) )
+    {
+    std::cerr << "Not read as a DICOMDIR" << std::endl;
+    return 1;
+    }
+  gdcm::DICOMDIR::FileRecordsType const &records = dd.GetFileRecords();
+  if( records.size() != 3
+    || records[0].ReferencedFileID != "DIR1/IM1" || records[0].PatientID != "PAT1"
+    || records[0].StudyInstanceUID != "1.1" || records[0].Modality != "MR"
+    || records[1].ReferencedFileID != "DIR1/IM2" || records[1].PatientID != "PAT1"
+    || records[2].ReferencedFileID != "DIR2/IM1" || records[2].PatientID != "PAT2"
+    || records[2].StudyInstanceUID != "2.1" || records[2].Modality != "CT" )
+    {
+    std::cerr << "Wrong records in sequence order" << std::endl;
+    return 1;
+    }
+
+  // Not a DICOMDIR
+  gdcm::File image;
+  SetMediaStorage( image, "1.2.840.10008.5.1.4.1.1.4" );
+  if( dd.SetFromFile( image ) || !dd.GetFileRecords().empty() )
+    {
+    std::cerr << "An MR Image read as a DICOMDIR" << std::endl;
+    return 1;
+    }
+  return 0;
+}
+}
 
 int TestDICOMDIR(int argc, char *argv[])
 {
@@ -28,5 +238,8 @@ int TestDICOMDIR(int argc, char *argv[])
 
   gdcm::DICOMDIR dd2(fs);
 
-  return 0;
+  int res = 0;
+  res += TestGenerated();
+  res += TestSequenceOrder();
+  return res;
 }
@@ -0,0 +1,214 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmDICOMDIRGenerator.h"
+#include "gdcmDirectory.h"
+#include "gdcmReader.h"
+#include "gdcmWriter.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmAttribute.h"
+#include "gdcmSequenceOfItems.h"
+#include "gdcmExplicitDataElement.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+const char StudyRoot[] = "1.2.826.0.1.3680043.2.1143.44.";
+const char SeriesRoot[] = "1.2.826.0.1.3680043.2.1143.43.";
+const char SOPRoot[] = "1.2.826.0.1.3680043.2.1143.42.";
+
+// The values are prefixes of one another (1, 10, 11...), the files with the
+// longest ones come first: the records must be linked on exact values
+int StudyOfSeries(int series) { return series == 1 || series == 10 ? 1 : 11; }
+std::string PatientOfStudy(int study) { return study == 1 ? "P1" : "P11"; }
+
+bool WriteMR(const char *filename, int series, int instance)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream uid, seriesuid, studyuid;
+  uid << SOPRoot << series << "." << instance;
+  seriesuid << SeriesRoot << series;
+  studyuid << StudyRoot << StudyOfSeries( series );
+  w.SetImage( gdcm::MediaStorage::MRImageStorage, studyuid.str(), seriesuid.str(), uid.str() );
+  w.AddString( gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, PatientOfStudy( StudyOfSeries( series ) ) );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+std::string GetValue(const gdcm::DataSet &ds, const gdcm::Tag &t)
+{
+  const gdcm::ByteValue *bv = ds.GetDataElement( t ).GetByteValue();
+  std::string s = bv ? std::string( bv->GetPointer(), bv->GetLength() ) : "";
+  while( !s.empty() && (s[s.size()-1] == ' ' || s[s.size()-1] == '\0') )
+    s.erase( s.size() - 1 );
+  return s;
+}
+
+bool Generate(gdcm::Directory::FilenamesType const &filenames, std::string const &root,
+  unsigned int nthreads, std::string const &outfilename, std::string &records)
+{
+  gdcm::DICOMDIRGenerator gen;
+  gen.SetFilenames( filenames );
+  gen.SetRootDirectory( root );
+  gen.SetDescriptor( "MYDESCRIPTOR" );
+  gen.SetNumberOfThreads( nthreads );
+  if( !gen.Generate() )
+    {
+    return false;
+    }
+  gdcm::Writer writer;
+  writer.SetFile( gen.GetFile() );
+  writer.SetFileName( outfilename.c_str() );
+  if( !writer.Write() )
+    {
+    return false;
+    }
+  // Everything but the File Meta Information (new UID)
+  std::ifstream is( outfilename.c_str(), std::ios::binary );
+  std::ostringstream os;
+  os << is.rdbuf();
+  records = os.str().substr( gen.GetFile().GetHeader().GetFullLength() );
+  return true;
+}
+}
+
+int TestDICOMDIRGenerator3(int , char *[])
+{
+  const char subdir[] = "TestDICOMDIRGenerator3";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  const int series[] = { 11, 10, 2, 1 };
+  const int instances[] = { 10, 2, 1 };
+  gdcm::Directory::FilenamesType filenames;
+  for( int s = 0; s < 4; ++s )
+    {
+    for( int i = 0; i < 3; ++i )
+      {
+      std::ostringstream name;
+      name << tmpdir << "/IM" << series[s] << "_" << instances[i];
+      if( !WriteMR( name.str().c_str(), series[s], instances[i] ) )
+        {
+        std::cerr << "Could not write " << name.str() << std::endl;
+        return 1;
+        }
+      filenames.push_back( name.str() );
+      }
+    }
+
+  std::string outfilename = tmpdir + "/DICOMDIR";
+  std::string records1;
+  std::string records4;
+  if( !Generate( filenames, tmpdir, 1, outfilename, records1 )
+    || !Generate( filenames, tmpdir, 4, outfilename, records4 ) )
+    {
+    std::cerr << "Generate failed" << std::endl;
+    return 1;
+    }
+  if( records1 != records4 )
+    {
+    std::cerr << "The DICOMDIR depends on the number of threads" << std::endl;
+    return 1;
+    }
+
+  gdcm::Reader reader;
+  reader.SetFileName( outfilename.c_str() );
+  if( !reader.Read() )
+    {
+    std::cerr << "Could not read " << outfilename << std::endl;
+    return 1;
+    }
+  const gdcm::DataSet &ds = reader.GetFile().GetDataSet();
+  gdcm::Attribute<0x4,0x1200> first;
+  first.Set( ds );
+  gdcm::SmartPointer<gdcm::SequenceOfItems> sqi = ds.GetDataElement( gdcm::Tag(0x4,0x1220) ).GetValueAsSQ();
+  if( !sqi || sqi->GetNumberOfItems() != 2 + 2 + 4 + 12 )
+    {
+    std::cerr << "Wrong number of directory records" << std::endl;
+    return 1;
+    }
+  std::map<uint32_t, size_t> records; // offset -> item
+  uint32_t offset = first.GetValue();
+  for( size_t i = 1; i <= sqi->GetNumberOfItems(); ++i )
+    {
+    records[offset] = i;
+    offset += sqi->GetItem( i ).GetLength<gdcm::ExplicitDataElement>();
+    }
+
+  // Walk the hierarchy: every record must be found once, under its parent
+  const gdcm::Tag keys[] = { gdcm::Tag(0x10,0x20), gdcm::Tag(0x20,0xd), gdcm::Tag(0x20,0xe), gdcm::Tag(0x4,0x1511) };
+  std::vector<uint32_t> level( 1, first.GetValue() );
+  std::vector<std::string> parents( 1, "" );
+  size_t nrecords = 0;
+  for( int l = 0; l < 4; ++l )
+    {
+    std::vector<uint32_t> lower;
+    std::vector<std::string> lowerparents;
+    for( size_t r = 0; r < level.size(); ++r )
+      {
+      for( uint32_t o = level[r]; o; )
+        {
+        if( records.find( o ) == records.end() )
+          {
+          std::cerr << "No record at offset " << o << std::endl;
+          return 1;
+          }
+        const gdcm::DataSet &rds = sqi->GetItem( records[o] ).GetNestedDataSet();
+        const std::string key = GetValue( rds, keys[l] );
+        std::ostringstream expected;
+        if( l == 1 ) expected << PatientOfStudy( atoi( key.c_str() + strlen(StudyRoot) ) );
+        if( l == 2 ) expected << StudyRoot << StudyOfSeries( atoi( key.c_str() + strlen(SeriesRoot) ) );
+        if( l == 3 ) expected << SeriesRoot << atoi( key.c_str() + strlen(SOPRoot) );
+        if( expected.str() != parents[r] )
+          {
+          std::cerr << key << " under " << parents[r] << " instead of " << expected.str() << std::endl;
+          return 1;
+          }
+        ++nrecords;
+        gdcm::Attribute<0x4,0x1400> next;
+        next.Set( rds );
+        gdcm::Attribute<0x4,0x1420> down;
+        down.Set( rds );
+        if( l < 3 )
+          {
+          lower.push_back( down.GetValue() );
+          lowerparents.push_back( key );
+          }
+        o = next.GetValue();
+        }
+      }
+    level = lower;
+    parents = lowerparents;
+    }
+  if( nrecords != sqi->GetNumberOfItems() )
+    {
+    std::cerr << "Reached " << nrecords << " records" << std::endl;
+    return 1;
+    }
+
+  for( size_t i = 0; i < filenames.size(); ++i )
+    gdcm::System::RemoveFile( filenames[i].c_str() );
+  gdcm::System::RemoveFile( outfilename.c_str() );
+  return 0;
+}
@@ -0,0 +1,137 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmIPPSorter.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSystem.h"
+#include "gdcmTesting.h"
+
+#include <sstream>
+
+namespace
+{
+const int NSlices = 6;
+const int NVolumes = 3;
+
+// Oblique slices 2.5mm apart, volume v acquired at 12:00:0v, its instance
+// numbers counting down so that they disagree with the acquisition time
+bool WriteSlice(const char *filename, int slice, int volume)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream ipp, time, instance;
+  ipp << "-10.5\\" << 2.5 * slice * 0.6 << "\\" << 2.5 * slice * 0.8;
+  time << "12000" << volume << ".5";
+  instance << 100 - volume * NSlices - slice;
+  w.AddString( gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.4" );
+  w.AddString( gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.42" );
+  w.AddString( gdcm::Tag(0x0008,0x0032), gdcm::VR::TM, time.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0013), gdcm::VR::IS, instance.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0032), gdcm::VR::DS, ipp.str() );
+  w.AddString( gdcm::Tag(0x0020,0x0037), gdcm::VR::DS, "1\\0\\0\\0\\0.8\\-0.6" );
+  w.AddString( gdcm::Tag(0x0020,0x0052), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.44" );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+std::string Name(std::string const &dir, int slice, int volume)
+{
+  std::ostringstream name;
+  name << dir << "/" << volume << "_" << slice << ".dcm";
+  return name.str();
+}
+}
+
+// Several volumes at the same positions (fMRI)
+int TestIPPSorter4(int , char *[])
+{
+  const char subdir[] = "TestIPPSorter4";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  // The last volume first, its slices shuffled
+  std::vector<std::string> filenames;
+  for( int v = NVolumes - 1; v >= 0; --v )
+    {
+    for( int i = 0; i < NSlices; ++i )
+      {
+      const int slice = (i * 5) % NSlices;
+      std::string name = Name( tmpdir, slice, v );
+      if( !WriteSlice( name.c_str(), slice, v ) )
+        {
+        std::cerr << "Could not write " << name << std::endl;
+        return 1;
+        }
+      filenames.push_back( name );
+      }
+    }
+
+  gdcm::IPPSorter s;
+  s.SetNumberOfThreads( 4 );
+  s.SetComputeZSpacing( true );
+  s.SetZSpacingTolerance( 1e-3 );
+  if( s.Sort( filenames ) )
+    {
+    std::cerr << "Sorted duplicate positions" << std::endl;
+    return 1;
+    }
+
+  // The first file given at each position: the last volume
+  s.SetDropDuplicatePositions( true );
+  for( int pass = 0; pass < 2; ++pass ) // the result does not pile up
+    {
+    if( !s.Sort( filenames ) || s.GetFilenames().size() != (size_t)NSlices )
+      {
+      std::cerr << "Drop duplicate positions failed" << std::endl;
+      return 1;
+      }
+    }
+  for( int i = 0; i < NSlices; ++i )
+    {
+    if( s.GetFilenames()[i] != Name( tmpdir, i, NVolumes - 1 ) )
+      {
+      std::cerr << "Dropped the wrong file: " << s.GetFilenames()[i] << std::endl;
+      return 1;
+      }
+    }
+
+  // All of them, by position then acquisition time
+  s.SetKeepDuplicatePositions( true );
+  if( !s.Sort( filenames ) || s.GetFilenames().size() != filenames.size() )
+    {
+    std::cerr << "Keep duplicate positions failed" << std::endl;
+    return 1;
+    }
+  for( int i = 0; i < NSlices; ++i )
+    {
+    for( int v = 0; v < NVolumes; ++v )
+      {
+      if( s.GetFilenames()[i * NVolumes + v] != Name( tmpdir, i, v ) )
+        {
+        std::cerr << "Wrong order at " << i * NVolumes + v << ": " << s.GetFilenames()[i * NVolumes + v] << std::endl;
+        return 1;
+        }
+      }
+    }
+  if( s.GetZSpacing() != 2.5 )
+    {
+    std::cerr << "Z-Spacing: " << s.GetZSpacing() << std::endl;
+    return 1;
+    }
+
+  for( size_t i = 0; i < filenames.size(); ++i )
+    gdcm::System::RemoveFile( filenames[i].c_str() );
+  return 0;
+}
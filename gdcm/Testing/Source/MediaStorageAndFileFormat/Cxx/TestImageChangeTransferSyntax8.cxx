@@ -0,0 +1,161 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmImage.h"
+#include "gdcmSequenceOfFragments.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include <stdlib.h>
+
+// Frame parallel transcoding must give the same result as the single threaded
+// code path
+namespace
+{
+gdcm::SmartPointer<gdcm::Image> MakeImage(gdcm::PixelFormat const &pf,
+  gdcm::PhotometricInterpretation::PIType pi)
+{
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 3 );
+  image->SetDimension( 0, 64 );
+  image->SetDimension( 1, 48 );
+  image->SetDimension( 2, 7 );
+  image->SetPixelFormat( pf );
+  image->SetPhotometricInterpretation( pi );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  std::vector<char> buffer( image->GetBufferLength() );
+  // smooth ramp plus a bit of noise, within BitsStored
+  const unsigned int mask = (1u << pf.GetBitsStored()) - 1;
+  if( pf.GetBitsAllocated() == 16 )
+    {
+    unsigned short *p = (unsigned short*)&buffer[0];
+    for( size_t i = 0; i < buffer.size() / 2; ++i )
+      p[i] = (unsigned short)(((unsigned int)(i / 7) + rand() % 3) & mask);
+    }
+  else
+    {
+    for( size_t i = 0; i < buffer.size(); ++i )
+      buffer[i] = (char)(((unsigned int)(i / 7) + rand() % 3) & mask);
+    }
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( &buffer[0], (uint32_t)buffer.size() );
+  image->SetDataElement( pixeldata );
+  return image;
+}
+
+gdcm::SmartPointer<gdcm::Image> Change(gdcm::Image &input,
+  gdcm::TransferSyntax::TSType ts, unsigned int nthreads, unsigned int window)
+{
+  gdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax( ts );
+  change.SetNumberOfThreads( nthreads );
+  change.SetFrameWindow( window );
+  change.SetInput( input );
+  if( !change.Change() ) return 0;
+  return new gdcm::Image( change.GetOutput() );
+}
+
+std::string GetPixelData(gdcm::Image const &image)
+{
+  const gdcm::DataElement &de = image.GetDataElement();
+  if( const gdcm::ByteValue *bv = de.GetByteValue() )
+    return std::string( bv->GetPointer(), bv->GetLength() );
+  const gdcm::SequenceOfFragments *sf = de.GetSequenceOfFragments();
+  if( !sf ) return std::string();
+  std::string s;
+  for( unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    s.append( bv->GetPointer(), bv->GetLength() );
+    s += '|';
+    }
+  return s;
+}
+
+bool IsSame(gdcm::Image const &a, gdcm::Image const &b)
+{
+  return a.GetPhotometricInterpretation() == b.GetPhotometricInterpretation()
+    && a.GetPlanarConfiguration() == b.GetPlanarConfiguration()
+    && a.GetTransferSyntax() == b.GetTransferSyntax()
+    && GetPixelData(a) == GetPixelData(b);
+}
+
+// Compare 1 thread with 4 threads and a frame window of 3 (not a divisor of
+// the number of frames)
+int TestChange(gdcm::Image const &input, gdcm::TransferSyntax::TSType ts)
+{
+  gdcm::SmartPointer<gdcm::Image> in1 = new gdcm::Image( input );
+  gdcm::SmartPointer<gdcm::Image> in2 = new gdcm::Image( input );
+  gdcm::SmartPointer<gdcm::Image> ref = Change( *in1, ts, 1, 0 );
+  gdcm::SmartPointer<gdcm::Image> out = Change( *in2, ts, 4, 3 );
+  if( !ref || !out )
+    {
+    std::cerr << "Could not change the Transfer Syntax to " << gdcm::TransferSyntax(ts) << std::endl;
+    return 1;
+    }
+  if( !IsSame( *ref, *out ) )
+    {
+    std::cerr << "Multi-threaded output differs for " << gdcm::TransferSyntax(ts)
+      << " from " << input.GetTransferSyntax() << std::endl;
+    return 1;
+    }
+  return 0;
+}
+}
+
+int TestImageChangeTransferSyntax8(int, char *[])
+{
+  srand( 0 );
+  const gdcm::TransferSyntax::TSType compressed[] = {
+    gdcm::TransferSyntax::JPEGLosslessProcess14_1,
+    gdcm::TransferSyntax::JPEGLSLossless,
+    gdcm::TransferSyntax::JPEG2000Lossless,
+    gdcm::TransferSyntax::RLELossless,
+  };
+  const size_t ncompressed = sizeof(compressed) / sizeof(*compressed);
+
+  gdcm::SmartPointer<gdcm::Image> images[] = {
+    MakeImage( gdcm::PixelFormat(1, 16, 12, 11, 0), gdcm::PhotometricInterpretation::MONOCHROME2 ),
+    MakeImage( gdcm::PixelFormat(3, 8, 8, 7, 0), gdcm::PhotometricInterpretation::RGB ),
+  };
+
+  int res = 0;
+  for( int i = 0; i < 2; ++i )
+    {
+    const gdcm::Image &raw = *images[i];
+    for( size_t c = 0; c < ncompressed; ++c )
+      {
+      // raw -> compressed
+      res += TestChange( raw, compressed[c] );
+
+      gdcm::SmartPointer<gdcm::Image> copy = new gdcm::Image( raw );
+      gdcm::SmartPointer<gdcm::Image> input = Change( *copy, compressed[c], 1, 0 );
+      if( !input ) { ++res; continue; }
+      // compressed -> raw, lossless: we should be back to the input
+      gdcm::SmartPointer<gdcm::Image> in = new gdcm::Image( *input );
+      gdcm::SmartPointer<gdcm::Image> back = Change( *in, gdcm::TransferSyntax::ExplicitVRLittleEndian, 4, 0 );
+      if( !back || GetPixelData( *back ) != GetPixelData( raw ) )
+        {
+        std::cerr << "Round trip failed for " << gdcm::TransferSyntax(compressed[c]) << std::endl;
+        ++res;
+        }
+      res += TestChange( *input, gdcm::TransferSyntax::ExplicitVRLittleEndian );
+      // compressed -> compressed, through the frame window
+      res += TestChange( *input, compressed[(c + 1) % ncompressed] );
+      }
+    }
+  return res;
+}
@@ -0,0 +1,195 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmImageRegionReader.h"
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmImageWriter.h"
+#include "gdcmSequenceOfFragments.h"
+#include "gdcmBoxRegion.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Sub-regions of encapsulated multi-frames images, with and without a Basic
+// Offset Table, must match the same region of the raw image
+namespace
+{
+const unsigned int Dims[3] = { 64, 48, 9 };
+
+gdcm::SmartPointer<gdcm::Image> MakeImage(std::vector<char> &buffer)
+{
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 3 );
+  image->SetDimensions( Dims );
+  image->SetPixelFormat( gdcm::PixelFormat(1, 16, 12, 11, 0) );
+  image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  buffer.resize( image->GetBufferLength() );
+  // every frame is different
+  unsigned short *p = (unsigned short*)&buffer[0];
+  for( size_t i = 0; i < buffer.size() / 2; ++i )
+    p[i] = (unsigned short)(((unsigned int)(i / 5) + rand() % 3) & 0xfff);
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( &buffer[0], (uint32_t)buffer.size() );
+  image->SetDataElement( pixeldata );
+  return image;
+}
+
+// Fill in the Basic Offset Table of an encapsulated image
+void SetBasicOffsetTable(gdcm::Image &image)
+{
+  gdcm::DataElement de = image.GetDataElement();
+  gdcm::SequenceOfFragments *sf = de.GetSequenceOfFragments();
+  std::vector<uint32_t> offsets;
+  uint32_t offset = 0;
+  for( unsigned int i = 0; i < sf->GetNumberOfFragments(); ++i )
+    {
+    offsets.push_back( offset );
+    offset += 8 + (uint32_t)sf->GetFragment(i).GetVL();
+    }
+  // stored as little endian, only done on little endian hosts
+  sf->GetTable().SetByteValue( (char*)&offsets[0], (uint32_t)(offsets.size() * 4) );
+  image.SetDataElement( de );
+}
+
+int TestRegion(const char *filename, const std::vector<char> &raw,
+  const gdcm::BoxRegion &box)
+{
+  gdcm::ImageRegionReader reader;
+  reader.SetFileName( filename );
+  if( !reader.ReadInformation() )
+    {
+    std::cerr << "Cannot ReadInformation: " << filename << std::endl;
+    return 1;
+    }
+  reader.SetRegion( box );
+  std::vector<char> buffer( reader.ComputeBufferLength() );
+  if( buffer.empty() || !reader.ReadIntoBuffer( &buffer[0], buffer.size() ) )
+    {
+    std::cerr << "Could not ReadIntoBuffer: " << filename << std::endl;
+    return 1;
+    }
+  // Read it a second time, the frame index is reused
+  std::vector<char> buffer2( buffer.size() );
+  if( !reader.ReadIntoBuffer( &buffer2[0], buffer2.size() ) || buffer != buffer2 )
+    {
+    std::cerr << "Second ReadIntoBuffer differs: " << filename << std::endl;
+    return 1;
+    }
+
+  const size_t rowsize = box.GetXMax() - box.GetXMin() + 1;
+  const size_t colsize = box.GetYMax() - box.GetYMin() + 1;
+  for( unsigned int z = box.GetZMin(); z <= box.GetZMax(); ++z )
+    for( unsigned int y = box.GetYMin(); y <= box.GetYMax(); ++y )
+      {
+      const char *ref = &raw[ (((size_t)z * Dims[1] + y) * Dims[0] + box.GetXMin()) * 2 ];
+      const char *out = &buffer[ ((z - box.GetZMin()) * colsize + (y - box.GetYMin())) * rowsize * 2 ];
+      if( memcmp( ref, out, rowsize * 2 ) != 0 )
+        {
+        std::cerr << "Region differs at z=" << z << " y=" << y << ": " << filename << std::endl;
+        return 1;
+        }
+      }
+  return 0;
+}
+}
+
+int TestImageRegionReader5(int, char *[])
+{
+  srand( 0 );
+  const char subdir[] = "TestImageRegionReader5";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  std::vector<char> raw;
+  gdcm::SmartPointer<gdcm::Image> image = MakeImage( raw );
+
+  static const struct
+    {
+    gdcm::TransferSyntax::TSType TS;
+    const char *Name;
+    } compressed[] = {
+    { gdcm::TransferSyntax::JPEGLosslessProcess14_1, "jpeg" },
+#ifdef GDCM_USE_JPEGLS
+    { gdcm::TransferSyntax::JPEGLSLossless, "jpegls" },
+#endif
+    { gdcm::TransferSyntax::JPEG2000Lossless, "j2k" },
+    { gdcm::TransferSyntax::RLELossless, "rle" },
+  };
+  const size_t ncompressed = sizeof(compressed) / sizeof(*compressed);
+  const uint16_t one = 1;
+  const bool littleendian = *(const char*)&one == 1;
+
+  gdcm::BoxRegion boxes[4];
+  boxes[0].SetDomain( 0, Dims[0] - 1, 0, Dims[1] - 1, 4, 4 ); // middle frame
+  boxes[1].SetDomain( 3, 40, 5, 20, Dims[2] - 1, Dims[2] - 1 ); // last frame
+  boxes[2].SetDomain( 10, 11, 0, Dims[1] - 1, 2, 6 ); // frame range
+  boxes[3].SetDomain( 0, Dims[0] - 1, 0, Dims[1] - 1, 0, Dims[2] - 1 );
+
+  int res = 0;
+  for( size_t c = 0; c < ncompressed; ++c )
+    {
+    gdcm::SmartPointer<gdcm::Image> copy = new gdcm::Image( *image );
+    gdcm::ImageChangeTransferSyntax change;
+    change.SetTransferSyntax( compressed[c].TS );
+    change.SetInput( *copy );
+    if( !change.Change() )
+      {
+      std::cerr << "Could not compress to " << gdcm::TransferSyntax(compressed[c].TS) << std::endl;
+      ++res;
+      continue;
+      }
+    gdcm::SmartPointer<gdcm::Image> out = new gdcm::Image( change.GetOutput() );
+    const gdcm::SequenceOfFragments *sf = out->GetDataElement().GetSequenceOfFragments();
+    if( !sf || sf->GetNumberOfFragments() != Dims[2] )
+      {
+      std::cerr << "Expected one Fragment per frame" << std::endl;
+      ++res;
+      continue;
+      }
+
+    // without, then with a Basic Offset Table
+    for( int bot = 0; bot < 2; ++bot )
+      {
+      if( bot )
+        {
+        if( !littleendian ) break;
+        SetBasicOffsetTable( *out );
+        }
+      std::string filename = tmpdir + "/";
+      filename += compressed[c].Name;
+      filename += bot ? "_bot.dcm" : ".dcm";
+      gdcm::ImageWriter writer;
+      writer.SetFileName( filename.c_str() );
+      writer.SetImage( *out );
+      if( !writer.Write() )
+        {
+        std::cerr << "Could not write: " << filename << std::endl;
+        ++res;
+        continue;
+        }
+      for( int b = 0; b < 4; ++b )
+        res += TestRegion( filename.c_str(), raw, boxes[b] );
+      }
+    }
+  return res;
+}
@@ -0,0 +1,232 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmJPEG2000Codec.h"
+#include "gdcmDataElement.h"
+#include "gdcmSequenceOfFragments.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+// DecodeByStreams is the frame by frame code path (ImageRegionReader)
+class StreamJPEG2000Codec : public gdcm::JPEG2000Codec
+{
+public:
+  using gdcm::JPEG2000Codec::DecodeByStreams;
+};
+
+struct Config
+{
+  unsigned short BitsAllocated;
+  unsigned short BitsStored;
+  unsigned short PixelRepresentation;
+  unsigned short SamplesPerPixel;
+  gdcm::PhotometricInterpretation::PIType PI;
+  bool Lossy;
+};
+
+// A smooth ramp with some noise, within BitsStored
+std::vector<char> MakeImage(const Config &c, size_t nsamples)
+{
+  const size_t samplesize = c.BitsAllocated / 8;
+  std::vector<char> v( nsamples * samplesize );
+  const unsigned int mask = (1u << (c.BitsStored - 1) << 1) - 1;
+  for( size_t i = 0; i < nsamples; ++i )
+    {
+    const unsigned int value = ((unsigned int)(i / 7) + (unsigned int)(rand() % 16)) & mask;
+    if( samplesize == 1 )
+      v[i] = (char)value;
+    else
+      {
+      uint16_t s = (uint16_t)value;
+      memcpy( &v[i * 2], &s, 2 );
+      }
+    }
+  return v;
+}
+
+void Setup(gdcm::JPEG2000Codec &codec, const Config &c, const unsigned int dims[3])
+{
+  gdcm::PixelFormat pf( c.SamplesPerPixel, c.BitsAllocated, c.BitsStored,
+    (unsigned short)(c.BitsStored - 1), c.PixelRepresentation );
+  codec.SetDimensions( dims );
+  codec.SetNumberOfDimensions( dims[2] > 1 ? 3 : 2 );
+  codec.SetPixelFormat( pf );
+  codec.SetPhotometricInterpretation( c.PI );
+  codec.SetPlanarConfiguration( 0 );
+  codec.SetNeedOverlayCleanup( false );
+  if( c.Lossy )
+    {
+    codec.SetReversible( false );
+    codec.SetRate( 0, 10 );
+    }
+}
+
+std::string ToString(const gdcm::SequenceOfFragments &sf)
+{
+  std::string s;
+  for( unsigned int i = 0; i < sf.GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf.GetFragment(i).GetByteValue();
+    s.append( bv->GetPointer(), bv->GetLength() );
+    s += '|'; // keep fragment boundaries
+    }
+  return s;
+}
+
+int TestConfig(const Config &c, unsigned int nframes)
+{
+  const unsigned int dims[3] = { 96, 64, nframes };
+  const size_t nsamples = (size_t)dims[0] * dims[1] * dims[2] * c.SamplesPerPixel;
+  std::vector<char> image = MakeImage( c, nsamples );
+  const size_t len = image.size();
+  gdcm::DataElement raw;
+  raw.SetByteValue( &image[0], (uint32_t)len );
+
+  // Compress with 1 and 4 threads, the output must be the same
+  gdcm::DataElement compressed[2];
+  for( int t = 0; t < 2; ++t )
+    {
+    gdcm::JPEG2000Codec codec;
+    Setup( codec, c, dims );
+    codec.SetNumberOfThreads( t == 0 ? 1 : 4 );
+    if( !codec.Code( raw, compressed[t] ) )
+      {
+      std::cerr << "Could not compress" << std::endl;
+      return 1;
+      }
+    }
+  const gdcm::SequenceOfFragments *sf = compressed[0].GetSequenceOfFragments();
+  if( !sf || sf->GetNumberOfFragments() != nframes
+    || ToString( *sf ) != ToString( *compressed[1].GetSequenceOfFragments() ) )
+    {
+    std::cerr << "Compressed streams differ" << std::endl;
+    return 1;
+    }
+
+  // Reference: frame by frame, using DecodeByStreams
+  std::string ref;
+  {
+  StreamJPEG2000Codec codec;
+  Setup( codec, c, dims );
+  for( unsigned int i = 0; i < nframes; ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    std::stringstream is;
+    is.write( bv->GetPointer(), bv->GetLength() );
+    std::stringstream os;
+    if( !codec.DecodeByStreams( is, os ) )
+      {
+      std::cerr << "Could not decode by streams" << std::endl;
+      return 1;
+      }
+    ref += os.str();
+    }
+  }
+  if( !c.Lossy && ref != std::string( &image[0], len ) )
+    {
+    std::cerr << "Round trip failed" << std::endl;
+    return 1;
+    }
+
+  // Decompress with 1 and 4 threads
+  for( int t = 0; t < 2; ++t )
+    {
+    gdcm::JPEG2000Codec codec;
+    Setup( codec, c, dims );
+    codec.SetNumberOfThreads( t == 0 ? 1 : 4 );
+    gdcm::DataElement decompressed;
+    if( !codec.Decode( compressed[t], decompressed ) )
+      {
+      std::cerr << "Could not decompress" << std::endl;
+      return 1;
+      }
+    const gdcm::ByteValue *bv = decompressed.GetByteValue();
+    if( !bv || bv->GetLength() < len || bv->GetLength() > len + 1
+      || memcmp( bv->GetPointer(), ref.c_str(), len ) != 0 )
+      {
+      std::cerr << "Decode differs from DecodeByStreams" << std::endl;
+      return 1;
+      }
+    if( codec.IsLossy() != c.Lossy )
+      {
+      std::cerr << "Wrong lossy flag" << std::endl;
+      return 1;
+      }
+    }
+
+  // A single frame split over several fragments
+  if( nframes == 1 )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(0).GetByteValue();
+    const uint32_t half = (bv->GetLength() / 2) & ~1u;
+    gdcm::SmartPointer<gdcm::SequenceOfFragments> split = new gdcm::SequenceOfFragments;
+    gdcm::Fragment frag;
+    frag.SetByteValue( bv->GetPointer(), half );
+    split->AddFragment( frag );
+    frag.SetByteValue( bv->GetPointer() + half, bv->GetLength() - half );
+    split->AddFragment( frag );
+    gdcm::DataElement in;
+    in.SetValue( *split );
+
+    gdcm::JPEG2000Codec codec;
+    Setup( codec, c, dims );
+    gdcm::DataElement decompressed;
+    if( !codec.Decode( in, decompressed )
+      || memcmp( decompressed.GetByteValue()->GetPointer(), ref.c_str(), len ) != 0 )
+      {
+      std::cerr << "Could not decompress several fragments" << std::endl;
+      return 1;
+      }
+    }
+  return 0;
+}
+}
+
+int TestJPEG2000Codec(int, char *[])
+{
+  srand( 1234 );
+  typedef gdcm::PhotometricInterpretation PI;
+  const Config configs[] = {
+    {  8,  8, 0, 1, PI::MONOCHROME2, false },
+    { 16, 12, 0, 1, PI::MONOCHROME2, false },
+    { 16, 16, 1, 1, PI::MONOCHROME2, false },
+    {  8,  8, 0, 3, PI::RGB, false },
+    { 16, 12, 0, 1, PI::MONOCHROME2, true },
+  };
+  const size_t nconfigs = sizeof(configs) / sizeof(*configs);
+
+  int res = 0;
+  for( size_t i = 0; i < nconfigs; ++i )
+    {
+    // single frame (2D) and multi-frames (3D)
+    if( TestConfig( configs[i], 1 ) )
+      {
+      std::cerr << "Failed config #" << i << " (2D)" << std::endl;
+      ++res;
+      }
+    if( TestConfig( configs[i], 5 ) )
+      {
+      std::cerr << "Failed config #" << i << " (3D)" << std::endl;
+      ++res;
+      }
+    }
+  return res;
+}
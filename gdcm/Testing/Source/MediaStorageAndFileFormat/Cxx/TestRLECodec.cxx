@@ -11,11 +11,193 @@
      PURPOSE.  See the above copyright notice for more information.
 
 =========================================================================*/
-#include "gdcmTypes.h"
+#include "gdcmRLECodec.h"
+#include "gdcmDataElement.h"
+#include "gdcmSequenceOfFragments.h"
 
-int TestRLECodec(int, char *[])
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+// DecodeByStreams is the frame by frame code path (ImageRegionReader)
+class StreamRLECodec : public gdcm::RLECodec
+{
+public:
+  using gdcm::RLECodec::DecodeByStreams;
+};
+
+struct Config
+{
+  unsigned short BitsAllocated;
+  unsigned short BitsStored;
+  unsigned short SamplesPerPixel;
+  gdcm::PhotometricInterpretation::PIType PI;
+  unsigned int PlanarConfiguration;
+  bool OverlayCleanup;
+};
+
+// Runs of random length, so that both literal and replicate runs are used
+std::vector<char> MakeImage(size_t len)
+{
+  std::vector<char> v( len );
+  size_t i = 0;
+  while( i < len )
+    {
+    const size_t run = std::min( (size_t)(rand() % 300 + 1), len - i );
+    const bool replicate = rand() % 2 != 0;
+    const char c = (char)(rand() & 0xff);
+    for( size_t j = 0; j < run; ++j, ++i )
+      v[i] = replicate ? c : (char)(rand() & 0xff);
+    }
+  return v;
+}
+
+void Setup(gdcm::RLECodec &codec, const Config &c, const unsigned int dims[3])
+{
+  gdcm::PixelFormat pf( c.SamplesPerPixel, c.BitsAllocated, c.BitsStored,
+    (unsigned short)(c.BitsStored - 1), 0 );
+  codec.SetDimensions( dims );
+  codec.SetNumberOfDimensions( dims[2] > 1 ? 3 : 2 );
+  codec.SetPixelFormat( pf );
+  codec.SetPhotometricInterpretation( c.PI );
+  codec.SetPlanarConfiguration( c.PlanarConfiguration );
+  codec.SetNeedOverlayCleanup( c.OverlayCleanup );
+}
+
+std::string ToString(const gdcm::SequenceOfFragments &sf)
+{
+  std::string s;
+  for( unsigned int i = 0; i < sf.GetNumberOfFragments(); ++i )
+    {
+    const gdcm::ByteValue *bv = sf.GetFragment(i).GetByteValue();
+    s.append( bv->GetPointer(), bv->GetLength() );
+    s += '|'; // keep fragment boundaries
+    }
+  return s;
+}
+
+int TestConfig(const Config &c, unsigned int nframes)
 {
-  // Compress a black images: should give a good result
-  // Compress a checkboard (black/white alternate). Should give a mediocre result
+  const unsigned int dims[3] = { 512, 256, nframes };
+  const size_t len = (size_t)dims[0] * dims[1] * dims[2]
+    * c.SamplesPerPixel * c.BitsAllocated / 8;
+  std::vector<char> image = MakeImage( len );
+  gdcm::DataElement raw;
+  raw.SetByteValue( &image[0], (uint32_t)len );
+
+  // Compress with 1 and 4 threads, the output must be the same
+  gdcm::DataElement compressed[2];
+  for( int t = 0; t < 2; ++t )
+    {
+    gdcm::RLECodec codec;
+    Setup( codec, c, dims );
+    codec.SetNumberOfThreads( t == 0 ? 1 : 4 );
+    if( !codec.Code( raw, compressed[t] ) )
+      {
+      std::cerr << "Could not compress" << std::endl;
+      return 1;
+      }
+    }
+  const gdcm::SequenceOfFragments *sf = compressed[0].GetSequenceOfFragments();
+  if( !sf || sf->GetNumberOfFragments() != nframes
+    || ToString( *sf ) != ToString( *compressed[1].GetSequenceOfFragments() ) )
+    {
+    std::cerr << "Compressed streams differ" << std::endl;
+    return 1;
+    }
+
+  // Reference: frame by frame, using DecodeByStreams
+  std::string ref;
+  {
+  StreamRLECodec codec;
+  Setup( codec, c, dims );
+  codec.SetLength( (unsigned long)(len / nframes) );
+  for( unsigned int i = 0; i < nframes; ++i )
+    {
+    const gdcm::ByteValue *bv = sf->GetFragment(i).GetByteValue();
+    std::stringstream is;
+    is.write( bv->GetPointer(), bv->GetLength() );
+    std::stringstream os;
+    if( !codec.DecodeByStreams( is, os ) )
+      {
+      std::cerr << "Could not decode by streams" << std::endl;
+      return 1;
+      }
+    ref += os.str();
+    }
+  }
+  // The Padded Composite Pixel Code of 16bits RGB is not symmetric, the
+  // result of the decoder is only compared to DecodeByStreams
+  const bool lossless = !c.OverlayCleanup
+    && !( c.BitsAllocated > 8 && c.SamplesPerPixel == 3 );
+  if( lossless && ref != std::string( &image[0], len ) )
+    {
+    std::cerr << "Round trip failed" << std::endl;
+    return 1;
+    }
+
+  // Decompress with 1 and 4 threads
+  for( int t = 0; t < 2; ++t )
+    {
+    gdcm::RLECodec codec;
+    Setup( codec, c, dims );
+    codec.SetBufferLength( (unsigned long)len );
+    codec.SetNumberOfThreads( t == 0 ? 1 : 4 );
+    gdcm::DataElement decompressed;
+    if( !codec.Decode( compressed[t], decompressed ) )
+      {
+      std::cerr << "Could not decompress" << std::endl;
+      return 1;
+      }
+    const gdcm::ByteValue *bv = decompressed.GetByteValue();
+    if( !bv || bv->GetLength() != len
+      || memcmp( bv->GetPointer(), ref.c_str(), len ) != 0 )
+      {
+      std::cerr << "Decode differs from DecodeByStreams" << std::endl;
+      return 1;
+      }
+    }
   return 0;
 }
+}
+
+int TestRLECodec(int, char *[])
+{
+  srand( 1234 );
+  typedef gdcm::PhotometricInterpretation PI;
+  const Config configs[] = {
+    {  8,  8, 1, PI::MONOCHROME2, 0, false },
+    { 16, 16, 1, PI::MONOCHROME2, 0, false },
+    { 16, 12, 1, PI::MONOCHROME1, 0, true }, // overlay cleanup
+    { 32, 32, 1, PI::MONOCHROME2, 0, false },
+    {  8,  8, 3, PI::RGB, 0, false },
+    {  8,  8, 3, PI::RGB, 1, false },
+    {  8,  8, 3, PI::YBR_FULL, 0, false },
+    { 16, 16, 3, PI::RGB, 1, false },
+  };
+  const size_t nconfigs = sizeof(configs) / sizeof(*configs);
+
+  int res = 0;
+  for( size_t i = 0; i < nconfigs; ++i )
+    {
+    // single frame (2D) and multi-frames (3D)
+    if( TestConfig( configs[i], 1 ) )
+      {
+      std::cerr << "Failed config #" << i << " (2D)" << std::endl;
+      ++res;
+      }
+    if( TestConfig( configs[i], 9 ) )
+      {
+      std::cerr << "Failed config #" << i << " (3D)" << std::endl;
+      ++res;
+      }
+    }
+  return res;
+}
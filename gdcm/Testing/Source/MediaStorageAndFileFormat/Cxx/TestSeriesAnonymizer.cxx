@@ -0,0 +1,200 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmSeriesAnonymizer.h"
+#include "gdcmAnonymizer.h"
+#include "gdcmCryptographicMessageSyntax.h"
+#include "gdcmReader.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmStringFilter.h"
+#include "gdcmSystem.h"
+#include "gdcmGlobal.h"
+#include "gdcmTesting.h"
+
+#include <set>
+#include <sstream>
+#include <string.h>
+
+namespace
+{
+// No crypto library needed: the "encrypted" content is a copy
+class CopyCryptographicMessageSyntax : public gdcm::CryptographicMessageSyntax
+{
+public:
+  bool ParseCertificateFile( const char * ) { return true; }
+  bool ParseKeyFile( const char * ) { return true; }
+  bool SetPassword(const char *, size_t ) { return true; }
+  void SetCipherType(CipherTypes ) {}
+  CipherTypes GetCipherType() const { return AES256_CIPHER; }
+  bool Encrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+    if( len > outlen ) return false;
+    memcpy( output, array, len );
+    outlen = len;
+    return true;
+    }
+  bool Decrypt(char *output, size_t &outlen, const char *array, size_t len) const
+    {
+    return Encrypt( output, outlen, array, len );
+    }
+};
+
+bool WriteMR(const char *filename, int series, int instance)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream uid;
+  uid << "1.2.826.0.1.3680043.2.1143.42." << series << "." << instance;
+  std::ostringstream seriesuid;
+  seriesuid << "1.2.826.0.1.3680043.2.1143.43." << series;
+  std::ostringstream foruid;
+  foruid << "1.2.826.0.1.3680043.2.1143.44." << series;
+  w.SetImage( gdcm::MediaStorage::MRImageStorage, "1.2.826.0.1.3680043.2.1143.41",
+    seriesuid.str(), uid.str() );
+  w.AddString( gdcm::Tag(0x0008,0x0080), gdcm::VR::LO, "General Hospital" );
+  w.AddString( gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, "12345" );
+  w.AddString( gdcm::Tag(0x0010,0x0030), gdcm::VR::DA, "19700101" );
+  w.AddString( gdcm::Tag(0x0020,0x0052), gdcm::VR::UI, foruid.str() );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+std::string GetValue(gdcm::StringFilter &sf, const gdcm::Tag &t)
+{
+  std::string s = sf.ToString( t );
+  while( !s.empty() && (s[s.size()-1] == ' ' || s[s.size()-1] == '\0') )
+    s.erase( s.size() - 1 );
+  return s;
+}
+}
+
+int TestSeriesAnonymizer(int , char *[])
+{
+  gdcm::Global& g = gdcm::Global::GetInstance();
+  if( !g.LoadResourcesFiles() )
+    {
+    std::cerr << "Could not load the resources" << std::endl;
+    return 1;
+    }
+
+  const char subdir[] = "TestSeriesAnonymizer";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  const int nseries = 2;
+  const int ninstances = 16;
+  std::vector<std::string> filenames;
+  std::vector<std::string> outfilenames;
+  for( int s = 0; s < nseries; ++s )
+    {
+    for( int i = 0; i < ninstances; ++i )
+      {
+      std::ostringstream name;
+      name << tmpdir << "/" << s << "_" << i << ".dcm";
+      if( !WriteMR( name.str().c_str(), s, i ) )
+        {
+        std::cerr << "Could not write " << name.str() << std::endl;
+        return 1;
+        }
+      filenames.push_back( name.str() );
+      outfilenames.push_back( name.str() + ".anon" );
+      }
+    }
+
+  gdcm::Anonymizer::ClearInternalUIDs();
+  CopyCryptographicMessageSyntax cms;
+  gdcm::SeriesAnonymizer sa;
+  sa.SetCryptographicMessageSyntax( &cms );
+  sa.SetNumberOfThreads( 4 );
+  if( !sa.Anonymize( filenames, outfilenames ) )
+    {
+    std::cerr << "Anonymize failed" << std::endl;
+    return 1;
+    }
+
+  // The same input once more, alone: the dummy UIDs are remembered
+  std::vector<std::string> again( 1, filenames[0] );
+  std::vector<std::string> againout( 1, filenames[0] + ".again" );
+  sa.SetNumberOfThreads( 1 );
+  if( !sa.Anonymize( again, againout ) )
+    {
+    std::cerr << "Anonymize failed (again)" << std::endl;
+    return 1;
+    }
+  outfilenames.push_back( againout[0] );
+
+  std::set<std::string> studies;
+  std::set<std::string> sopinstances;
+  std::vector< std::set<std::string> > seriesuids( nseries );
+  std::vector< std::set<std::string> > foruids( nseries );
+  for( size_t i = 0; i < outfilenames.size(); ++i )
+    {
+    const int s = i < filenames.size() ? (int)(i / ninstances) : 0;
+    gdcm::Reader reader;
+    reader.SetFileName( outfilenames[i].c_str() );
+    if( !reader.Read() )
+      {
+      std::cerr << "Could not read " << outfilenames[i] << std::endl;
+      return 1;
+      }
+    const gdcm::DataSet &ds = reader.GetFile().GetDataSet();
+    gdcm::StringFilter sf;
+    sf.SetFile( reader.GetFile() );
+    if( !ds.FindDataElement( gdcm::Tag(0x0400,0x0500) )
+      || GetValue( sf, gdcm::Tag(0x0012,0x0062) ) != "YES"
+      || GetValue( sf, gdcm::Tag(0x0010,0x0010) ) == "Doe^John"
+      || GetValue( sf, gdcm::Tag(0x0010,0x0020) ) == "12345"
+      || GetValue( sf, gdcm::Tag(0x0008,0x0080) ) == "General Hospital" )
+      {
+      std::cerr << "Not de-identified: " << outfilenames[i] << std::endl;
+      return 1;
+      }
+    studies.insert( GetValue( sf, gdcm::Tag(0x0020,0x000d) ) );
+    seriesuids[s].insert( GetValue( sf, gdcm::Tag(0x0020,0x000e) ) );
+    foruids[s].insert( GetValue( sf, gdcm::Tag(0x0020,0x0052) ) );
+    if( i < filenames.size() )
+      sopinstances.insert( GetValue( sf, gdcm::Tag(0x0008,0x0018) ) );
+    }
+
+  // One dummy Study UID, one Series and Frame of Reference UID per series,
+  // one SOP Instance UID per file
+  if( studies.size() != 1 || *studies.begin() == "1.2.826.0.1.3680043.2.1143.41" )
+    {
+    std::cerr << "Study Instance UID: " << studies.size() << std::endl;
+    return 1;
+    }
+  std::set<std::string> allseries;
+  for( int s = 0; s < nseries; ++s )
+    {
+    if( seriesuids[s].size() != 1 || foruids[s].size() != 1 )
+      {
+      std::cerr << "Series " << s << ": " << seriesuids[s].size()
+        << " Series Instance UID, " << foruids[s].size() << " Frame of Reference UID" << std::endl;
+      return 1;
+      }
+    allseries.insert( *seriesuids[s].begin() );
+    }
+  if( allseries.size() != (size_t)nseries || sopinstances.size() != filenames.size() )
+    {
+    std::cerr << "UIDs mixed up" << std::endl;
+    return 1;
+    }
+
+  for( size_t i = 0; i < filenames.size(); ++i )
+    gdcm::System::RemoveFile( filenames[i].c_str() );
+  for( size_t i = 0; i < outfilenames.size(); ++i )
+    gdcm::System::RemoveFile( outfilenames[i].c_str() );
+  return 0;
+}
@@ -12,8 +12,122 @@
 
 =========================================================================*/
 #include "gdcmSorter.h"
+#include "gdcmAttribute.h"
+#include "gdcmTestingWriter.h"
+#include "gdcmSystem.h"
 #include "gdcmTesting.h"
 
+#include <sstream>
+
+namespace
+{
+bool WriteSlice(const char *filename, int z, int t)
+{
+  gdcm::TestingWriter w;
+  std::ostringstream ipp, time;
+  ipp << "0\\0\\" << z;
+  time << "1200" << (t < 10 ? "0" : "") << t;
+  w.AddString( gdcm::Tag(0x0008,0x0016), gdcm::VR::UI, "1.2.840.10008.5.1.4.1.1.4" );
+  w.AddString( gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.826.0.1.3680043.2.1143.42" );
+  w.AddString( gdcm::Tag(0x0008,0x0032), gdcm::VR::TM, time.str() );
+  w.AddString( gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^John" );
+  w.AddString( gdcm::Tag(0x0020,0x0032), gdcm::VR::DS, ipp.str() );
+  w.SetFileName( filename );
+  return w.Write();
+}
+
+bool OnlyTagsToRead = true;
+
+// Position, then time, as in Examples/Cxx/SortImage.cxx
+bool SortPositionTime(gdcm::DataSet const & ds1, gdcm::DataSet const & ds2 )
+{
+  if( ds1.FindDataElement( gdcm::Tag(0x0010,0x0010) ) ) OnlyTagsToRead = false;
+  gdcm::Attribute<0x0020,0x0032> ipp1;
+  gdcm::Attribute<0x0020,0x0032> ipp2;
+  ipp1.Set( ds1 );
+  ipp2.Set( ds2 );
+  if( ipp1 == ipp2 )
+    {
+    gdcm::Attribute<0x0008,0x0032> t1;
+    gdcm::Attribute<0x0008,0x0032> t2;
+    t1.Set( ds1 );
+    t2.Set( ds2 );
+    return t1 < t2;
+    }
+  return ipp1[2] < ipp2[2];
+}
+
+// 3 times 8 slices, given in reverse order, read on 4 threads
+int TestTagsToRead()
+{
+  const char subdir[] = "TestSorter";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+  gdcm::Directory::FilenamesType filenames;
+  for( int i = 23; i >= 0; --i )
+    {
+    std::ostringstream name;
+    name << tmpdir << "/" << i << ".dcm";
+    if( !WriteSlice( name.str().c_str(), i / 3, i % 3 ) )
+      {
+      std::cerr << "Could not write " << name.str() << std::endl;
+      return 1;
+      }
+    filenames.push_back( name.str() );
+    }
+
+  gdcm::Sorter s;
+  std::set<gdcm::Tag> tags;
+  tags.insert( gdcm::Tag(0x0008,0x0032) );
+  tags.insert( gdcm::Tag(0x0020,0x0032) );
+  s.SetTagsToRead( tags );
+  s.SetNumberOfThreads( 4 );
+  s.SetSortFunction( SortPositionTime );
+  if( !s.Sort( filenames ) || !s.StableSort( s.GetFilenames() ) || !OnlyTagsToRead )
+    {
+    std::cerr << "Sort failed, or read more than the tags to read" << std::endl;
+    return 1;
+    }
+  gdcm::Directory::FilenamesType const &sorted = s.GetFilenames();
+  if( sorted.size() != filenames.size() )
+    {
+    std::cerr << sorted.size() << " sorted files instead of " << filenames.size() << std::endl;
+    return 1;
+    }
+  for( size_t i = 0; i < sorted.size(); ++i )
+    {
+    if( sorted[i] != filenames[ filenames.size() - 1 - i ] )
+      {
+      std::cerr << "Wrong order at " << i << ": " << sorted[i] << std::endl;
+      return 1;
+      }
+    }
+
+  // Everything but the Pixel Data by default, one missing file fails
+  s.SetTagsToRead( std::set<gdcm::Tag>() );
+  filenames.push_back( tmpdir + "/missing.dcm" );
+  if( s.Sort( filenames ) || !s.GetFilenames().empty() )
+    {
+    std::cerr << "Sorted a missing file" << std::endl;
+    return 1;
+    }
+  filenames.pop_back();
+  OnlyTagsToRead = true;
+  if( !s.Sort( filenames ) || OnlyTagsToRead )
+    {
+    std::cerr << "Sort failed, or did not read the whole header" << std::endl;
+    return 1;
+    }
+
+  for( size_t i = 0; i < filenames.size(); ++i )
+    gdcm::System::RemoveFile( filenames[i].c_str() );
+  return 0;
+}
+}
+
 int TestSorter(int argc, char *argv[])
 {
   // Black box:
@@ -25,6 +139,11 @@ int TestSorter(int argc, char *argv[])
     return 1;
     }
 
+  if( TestTagsToRead() )
+    {
+    return 1;
+    }
+
   // White box:
   const char *directory = gdcm::Testing::GetDataRoot();
   if( argc == 2 )
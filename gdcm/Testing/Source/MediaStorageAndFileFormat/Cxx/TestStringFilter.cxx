@@ -17,6 +17,104 @@
 #include "gdcmTesting.h"
 #include "gdcmTrace.h"
 
+#include <string.h>
+
+// The allocation-free ToString gives the same value as ToStringPair, even
+// when truncated
+static int TestToStringBuffer(gdcm::StringFilter const &sf, const gdcm::Tag &t)
+{
+  const std::string ref = sf.ToStringPair( t ).second;
+  char buffer[512];
+  const size_t n = sf.ToString( t, buffer, sizeof(buffer) );
+  if( n != ref.size()
+    || ( n < sizeof(buffer) && ref != buffer )
+    || sf.ToString( t ) != ref )
+    {
+    std::cerr << "ToString mismatch for " << t << ": " << ref << std::endl;
+    return 1;
+    }
+  char small[5];
+  if( sf.ToString( t, small, sizeof(small) ) != n
+    || strncmp( small, ref.c_str(), sizeof(small) - 1 ) != 0
+    || strlen( small ) != std::min( n, sizeof(small) - 1 ) )
+    {
+    std::cerr << "Truncated ToString mismatch for " << t << ": " << ref << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+static void AddValue(gdcm::DataSet &ds, const gdcm::Tag &t, gdcm::VR const &vr,
+  const char *value, uint32_t len)
+{
+  gdcm::DataElement de( t );
+  de.SetVR( vr );
+  de.SetByteValue( value, len );
+  ds.Insert( de );
+}
+
+static int TestStringFilterValues()
+{
+  gdcm::StringFilter sf;
+  gdcm::DataSet &ds = sf.GetFile().GetDataSet();
+  AddValue( ds, gdcm::Tag(0x0008,0x0018), gdcm::VR::UI, "1.2.3.4\0", 8 );
+  AddValue( ds, gdcm::Tag(0x0008,0x0060), gdcm::VR::CS, "MR", 2 );
+  AddValue( ds, gdcm::Tag(0x0010,0x0010), gdcm::VR::PN, "Doe^John", 8 );
+  AddValue( ds, gdcm::Tag(0x0010,0x0020), gdcm::VR::LO, "12345 ", 6 );
+  AddValue( ds, gdcm::Tag(0x0010,0x0030), gdcm::VR::DA, "19700101", 8 );
+  AddValue( ds, gdcm::Tag(0x0020,0x0013), gdcm::VR::IS, "-42 ", 4 );
+  AddValue( ds, gdcm::Tag(0x0028,0x0030), gdcm::VR::DS, "0.5\\0.125 ", 10 );
+  AddValue( ds, gdcm::Tag(0x0008,0x0080), gdcm::VR::LO, "", 0 );
+  const uint16_t us[2] = { 65535, 0 };
+  AddValue( ds, gdcm::Tag(0x0028,0x0010), gdcm::VR::US, (const char*)us, 2 );
+  AddValue( ds, gdcm::Tag(0x0028,0x1101), gdcm::VR::US, (const char*)us, 4 );
+  const int16_t ss[2] = { -32768, 7 };
+  AddValue( ds, gdcm::Tag(0x0028,0x0106), gdcm::VR::SS, (const char*)ss, 4 );
+  const int32_t sl[2] = { -2147483647 - 1, 2147483647 };
+  AddValue( ds, gdcm::Tag(0x0018,0x6020), gdcm::VR::SL, (const char*)sl, 8 );
+  const uint32_t ul = 4294967295u;
+  AddValue( ds, gdcm::Tag(0x0028,0x0008), gdcm::VR::UL, (const char*)&ul, 4 );
+  const double fd = 0.125;
+  AddValue( ds, gdcm::Tag(0x0018,0x9087), gdcm::VR::FD, (const char*)&fd, 8 );
+
+  int ret = 0;
+  const char * const values[] = { "1.2.3.4", "MR", "Doe^John", "12345 ",
+    "19700101", "-42 ", "0.5\\0.125 ", "", "65535", "65535\\0",
+    "-32768\\7", "-2147483648\\2147483647", "4294967295", "0.125" };
+  gdcm::DataSet::ConstIterator it = ds.Begin();
+  // Twice: the second time the dictionary entries come from the cache
+  for( int pass = 0; pass < 2; ++pass )
+    {
+    for( ; it != ds.End(); ++it )
+      {
+      ret += TestToStringBuffer( sf, it->GetTag() );
+      }
+    it = ds.Begin();
+    }
+  const gdcm::Tag tags[] = { gdcm::Tag(0x0008,0x0018), gdcm::Tag(0x0008,0x0060),
+    gdcm::Tag(0x0010,0x0010), gdcm::Tag(0x0010,0x0020), gdcm::Tag(0x0010,0x0030),
+    gdcm::Tag(0x0020,0x0013), gdcm::Tag(0x0028,0x0030), gdcm::Tag(0x0008,0x0080),
+    gdcm::Tag(0x0028,0x0010), gdcm::Tag(0x0028,0x1101), gdcm::Tag(0x0028,0x0106),
+    gdcm::Tag(0x0018,0x6020), gdcm::Tag(0x0028,0x0008), gdcm::Tag(0x0018,0x9087) };
+  for( size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); ++i )
+    {
+    if( sf.ToString( tags[i] ) != values[i] )
+      {
+      std::cerr << tags[i] << ": " << sf.ToString( tags[i] ) << " != " << values[i] << std::endl;
+      ++ret;
+      }
+    }
+
+  // Not found
+  char buffer[16] = "x";
+  if( sf.ToString( gdcm::Tag(0x0010,0x0040), buffer, sizeof(buffer) ) != 0 || *buffer )
+    {
+    std::cerr << "Missing tag not empty" << std::endl;
+    ++ret;
+    }
+  return ret;
+}
+
 int TestStringFilt(const char *filename)
 {
   gdcm::StringFilter sf;
@@ -35,6 +133,7 @@ int TestStringFilt(const char *filename)
     {
     const gdcm::DataElement &ref = *it;
     std::pair<std::string, std::string> s = sf.ToStringPair( ref.GetTag() );
+    ret += TestToStringBuffer( sf, ref.GetTag() );
     if( !s.second.empty() || ref.GetVL() == 0 )
       {
       std::cout << s.first << " -> " << s.second << std::endl;
@@ -72,7 +171,7 @@ int TestStringFilter(int argc, char *argv[])
   // First of get rid of warning/debug message
   gdcm::Trace::DebugOff();
   gdcm::Trace::WarningOff();
-  int r = 0, i = 0;
+  int r = TestStringFilterValues(), i = 0;
   const char *filename;
   const char * const *filenames = gdcm::Testing::GetFileNames();
   while( (filename = filenames[i]) )
@@ -0,0 +1,122 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmUIDGenerator.h"
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string.h>
+
+namespace
+{
+const unsigned int nuids = 20000; // several refills of each pool
+
+void* func(void* arg)
+{
+  std::vector<std::string> *uids = reinterpret_cast< std::vector<std::string>* >(arg);
+  for(unsigned int i = 0; i < nuids; i++)
+    {
+    uids->push_back( gdcm::UIDGenerator::GenerateUID() );
+    }
+  return NULL;
+}
+
+// The same pool must not serve the parent and a forked child
+bool TestFork()
+{
+  const std::string parentuid = gdcm::UIDGenerator::GenerateUID();
+  int fds[2];
+  if( pipe(fds) != 0 ) return false;
+  const pid_t pid = fork();
+  if( pid < 0 ) return false;
+  if( pid == 0 )
+    {
+    const std::string uid = gdcm::UIDGenerator::GenerateUID();
+    ssize_t w = write( fds[1], uid.c_str(), uid.size() + 1 );
+    _exit( w > 0 ? 0 : 1 );
+    }
+  close( fds[1] );
+  const std::string uid = gdcm::UIDGenerator::GenerateUID();
+  char childuid[128] = {};
+  size_t n = 0;
+  ssize_t r;
+  while( n < sizeof(childuid) - 1
+    && (r = read( fds[0], childuid + n, sizeof(childuid) - 1 - n )) > 0 )
+    n += r;
+  close( fds[0] );
+  int status;
+  waitpid( pid, &status, 0 );
+  if( !n || uid == childuid || parentuid == childuid
+    || !gdcm::UIDGenerator::IsValid( childuid ) )
+    {
+    std::cerr << "fork: " << uid << " / " << childuid << std::endl;
+    return false;
+    }
+  return true;
+}
+}
+
+int TestUIDGenerator4(int , char *[])
+{
+  const unsigned int nthreads = 8;
+  pthread_t th[nthreads];
+  std::vector<std::string> uids[nthreads];
+  unsigned int i;
+  for (i = 0; i < nthreads; i++)
+    {
+    const int ret = pthread_create (&th[i], NULL, func, (void*)(uids+i));
+    if( ret ) return 1;
+    }
+  for (i = 0; i < nthreads; i++)
+    pthread_join (th[i], NULL);
+
+  std::set<std::string> global;
+  for (i = 0; i < nthreads; i++)
+    {
+    for( std::vector<std::string>::const_iterator it = uids[i].begin(); it != uids[i].end(); ++it )
+      {
+      if( !gdcm::UIDGenerator::IsValid( it->c_str() ) )
+        {
+        std::cerr << "Invalid: " << *it << std::endl;
+        return 1;
+        }
+      global.insert( *it );
+      }
+    }
+  if( global.size() != nuids * nthreads )
+    {
+    std::cerr << "Duplicates: " << nuids * nthreads - global.size() << std::endl;
+    return 1;
+    }
+
+  // Generate() goes through GenerateUID, into its member buffer
+  gdcm::UIDGenerator g;
+  const char *s = g.Generate();
+  if( !s || !gdcm::UIDGenerator::IsValid( s ) || global.count( s ) )
+    {
+    return 1;
+    }
+
+  if( !TestFork() )
+    {
+    return 1;
+    }
+
+  return 0;
+}
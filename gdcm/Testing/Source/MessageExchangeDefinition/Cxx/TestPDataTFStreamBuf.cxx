@@ -0,0 +1,132 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmPDataTFStreamBuf.h"
+#include "gdcmPDataTFPDU.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+
+/*
+ * Check the P-DATA-TF PDUs produced by PDataTFStreamBuf: at most maxpdv
+ * bytes per PDV, 'last fragment' bit only on the last one (which is never
+ * empty), and the data read back equals the data written.
+ */
+namespace
+{
+using namespace gdcm::network;
+
+const uint8_t pcid = 3;
+const size_t maxpdv = 100;
+
+int CheckPDUs(std::string const &stream, std::string const &data, size_t npdus)
+{
+  std::istringstream is( stream );
+  std::string payload;
+  size_t n = 0;
+  bool last = false;
+  uint8_t itemtype = 0;
+  while( is.read( (char*)&itemtype, 1 ) )
+    {
+    if( itemtype != 0x4 || last )
+      {
+      std::cerr << "Unexpected PDU #" << n << std::endl;
+      return 1;
+      }
+    PDataTFPDU pdu;
+    pdu.Read( is );
+    if( pdu.GetNumberOfPresentationDataValues() != 1 )
+      {
+      std::cerr << "PDU #" << n << " has "
+        << pdu.GetNumberOfPresentationDataValues() << " PDV" << std::endl;
+      return 1;
+      }
+    PresentationDataValue const &pdv = pdu.GetPresentationDataValue(0);
+    const std::string &blob = pdv.GetBlob();
+    if( pdv.GetPresentationContextID() != pcid || pdv.GetIsCommand()
+      || blob.size() > maxpdv || blob.empty() )
+      {
+      std::cerr << "Bad PDV #" << n << " of length " << blob.size() << std::endl;
+      return 1;
+      }
+    last = pdv.GetIsLastFragment();
+    payload += blob;
+    ++n;
+    }
+  if( !last || n != npdus || payload != data )
+    {
+    std::cerr << "Got " << n << " PDU instead of " << npdus << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+std::string MakeData(size_t len)
+{
+  std::string data( len, 0 );
+  for( size_t i = 0; i < len; ++i ) data[i] = (char)(i * 7);
+  return data;
+}
+}
+
+int TestPDataTFStreamBuf(int , char *[])
+{
+  int res = 0;
+
+  // Small writes, buffered
+  {
+  const std::string data = MakeData( 1234 );
+  std::stringstream ss;
+  PDataTFStreamBuf buf( ss, pcid, maxpdv );
+  std::ostream os( &buf );
+  for( size_t i = 0; i < data.size(); i += 10 )
+    os.write( data.c_str() + i, std::min( (size_t)10, data.size() - i ) );
+  if( !os || !buf.Finish() ) ++res;
+  res += CheckPDUs( ss.str(), data, 13 );
+  if( buf.GetNumberOfPDUs() != 13 ) ++res;
+  }
+
+  // Large writes sent from the caller's buffer, a multiple of maxpdv: no
+  // empty last fragment
+  {
+  const std::string data = MakeData( 10 * maxpdv );
+  std::stringstream ss;
+  PDataTFStreamBuf buf( ss, pcid, maxpdv );
+  std::ostream os( &buf );
+  os.put( data[0] );
+  os.write( data.c_str() + 1, 5 * maxpdv - 1 );
+  os.write( data.c_str() + 5 * maxpdv, 5 * maxpdv );
+  if( !os || !buf.Finish() ) ++res;
+  res += CheckPDUs( ss.str(), data, 10 );
+  }
+
+  // Copy from a stream straight into the PDV buffer
+  {
+  const std::string data = MakeData( 250 );
+  std::istringstream is( "xx" + data );
+  is.seekg( 2 );
+  std::stringstream ss;
+  PDataTFStreamBuf buf( ss, pcid, maxpdv );
+  if( !buf.CopyFrom( is, data.size() ) || !buf.Finish() ) ++res;
+  res += CheckPDUs( ss.str(), data, 3 );
+  // Short read
+  std::istringstream empty;
+  PDataTFStreamBuf buf2( ss, pcid, maxpdv );
+  if( buf2.CopyFrom( empty, 10 ) ) ++res;
+  }
+
+  return res;
+}
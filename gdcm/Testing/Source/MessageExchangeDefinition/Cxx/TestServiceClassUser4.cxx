@@ -0,0 +1,384 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmServiceClassUser.h"
+#include "gdcmPresentationContextGenerator.h"
+#include "gdcmAAssociateRQPDU.h"
+#include "gdcmAAssociateACPDU.h"
+#include "gdcmAReleaseRQPDU.h"
+#include "gdcmAReleaseRPPDU.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
+#include "gdcmImageWriter.h"
+#include "gdcmUIDGenerator.h"
+#include "gdcmAttribute.h"
+#include "gdcmCommandDataSet.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <socket++/sockinet.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <set>
+
+#include <stdio.h>
+
+/*
+ * Pipelined C-STORE against a stand-in C-STORE SCP running in a thread over
+ * loopback. The SCP holds its responses until the window is full (or the SCU
+ * stops sending) and returns them in reverse order, so that the SCU has to
+ * match them by Message ID.
+ */
+namespace
+{
+using namespace gdcm::network;
+
+struct StandInSCP
+{
+  sockinetbuf *Listener;
+  int NumberOfAssociations;
+  uint16_t Window; // largest window accepted
+  std::set<std::string> Rejected; // SOP Instance UID to reply 0xA700 to
+  // per association:
+  std::vector<int> Proposed; // -1 when no Asynchronous Operations Window
+  std::vector<size_t> MaxOutstanding;
+  std::vector<size_t> Received;
+  size_t Corrupted; // data set not matching its command
+};
+
+// Held by SmartPointer, not copied
+struct Request : public gdcm::Object
+{
+  uint8_t PresentationContextID;
+  gdcm::DataSet Command;
+};
+
+std::string GetString(gdcm::DataSet const &ds, gdcm::Tag const &t)
+{
+  const gdcm::ByteValue *bv = ds.GetDataElement( t ).GetByteValue();
+  if( !bv ) return std::string();
+  std::string s( bv->GetPointer(), bv->GetLength() );
+  return s.c_str(); // remove padding
+}
+
+void WriteResponse(std::ostream &os, Request const &rq, uint16_t status)
+{
+  gdcm::CommandDataSet ds;
+  ds.Insert( rq.Command.GetDataElement( gdcm::Tag(0x0,0x0002) ) );
+  ds.Insert( rq.Command.GetDataElement( gdcm::Tag(0x0,0x1000) ) );
+  gdcm::Attribute<0x0,0x0100> commandfield = { 0x8001 };
+  ds.Insert( commandfield.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( rq.Command );
+  gdcm::Attribute<0x0,0x0120> respondedto = { messageid.GetValue() };
+  ds.Insert( respondedto.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0800> datasettype = { 0x0101 };
+  ds.Insert( datasettype.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0900> at = { status };
+  ds.Insert( at.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0000> grouplength = { 0 };
+  grouplength.SetValue( ds.GetLength<gdcm::ImplicitDataElement>() );
+  ds.Insert( grouplength.GetAsDataElement() );
+
+  PresentationDataValue pdv;
+  pdv.SetPresentationContextID( rq.PresentationContextID );
+  pdv.SetDataSet( ds );
+  pdv.SetMessageHeader( 3 ); // command, last fragment
+  PDataTFPDU pdu;
+  pdu.AddPresentationDataValue( pdv );
+  pdu.Write( os );
+}
+
+void RunAssociation(StandInSCP &scp, iosockinet &s)
+{
+  uint8_t itemtype = 0;
+  s.read( (char*)&itemtype, 1 );
+  if( !s || itemtype != 0x1 ) return;
+  AAssociateRQPDU rqpdu;
+  rqpdu.Read( s );
+
+  AAssociateACPDU acpdu;
+  for( unsigned int i = 0; i < rqpdu.GetNumberOfPresentationContext(); ++i )
+    {
+    PresentationContextRQ const &pc = rqpdu.GetPresentationContext(i);
+    PresentationContextAC pcac;
+    pcac.SetPresentationContextID( pc.GetPresentationContextID() );
+    pcac.SetTransferSyntax( pc.GetTransferSyntaxes()[0] );
+    pcac.SetReason( 0 );
+    acpdu.AddPresentationContextAC( pcac );
+    }
+  acpdu.InitFromRQ( rqpdu );
+  size_t window = 1;
+  int proposed = -1;
+  if( const AsynchronousOperationsWindowSub *rqaows =
+    rqpdu.GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    proposed = rqaows->GetMaximumNumberOperationsInvoked();
+    window = proposed ? std::min<size_t>( proposed, scp.Window ) : scp.Window;
+    AsynchronousOperationsWindowSub aows;
+    aows.SetMaximumNumberOperationsInvoked( (uint16_t)window );
+    aows.SetMaximumNumberOperationsPerformed( 1 );
+    UserInformation ui;
+    ui = acpdu.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( aows );
+    acpdu.SetUserInformation( ui );
+    }
+  acpdu.Write( s );
+  s.flush();
+  scp.Proposed.push_back( proposed );
+  scp.MaxOutstanding.push_back( 0 );
+  scp.Received.push_back( 0 );
+
+  std::vector< gdcm::SmartPointer<Request> > pending;
+  std::vector<PresentationDataValue> command;
+  std::string data;
+  for( ;; )
+    {
+    if( !pending.empty() && ( pending.size() >= window
+        || ( s.rdbuf()->in_avail() <= 0 && !s.rdbuf()->is_readready( 0, 200000 ) ) ) )
+      {
+      for( size_t i = pending.size(); i > 0; --i )
+        {
+        const Request &rq = *pending[i - 1];
+        const std::string uid = GetString( rq.Command, gdcm::Tag(0x0,0x1000) );
+        WriteResponse( s, rq, scp.Rejected.count( uid ) ? 0xA700 : 0x0 );
+        }
+      s.flush();
+      pending.clear();
+      }
+    s.read( (char*)&itemtype, 1 );
+    if( !s ) break;
+    if( itemtype == 0x4 )
+      {
+      PDataTFPDU pdu;
+      pdu.Read( s );
+      for( size_t i = 0; i < pdu.GetNumberOfPresentationDataValues(); ++i )
+        {
+        PresentationDataValue const &pdv = pdu.GetPresentationDataValue(i);
+        if( pdv.GetIsCommand() )
+          {
+          command.push_back( pdv );
+          }
+        else
+          {
+          data += pdv.GetBlob();
+          }
+        if( !pdv.GetIsCommand() && pdv.GetIsLastFragment() )
+          {
+          gdcm::SmartPointer<Request> rq = new Request;
+          rq->PresentationContextID = pdv.GetPresentationContextID();
+          rq->Command = PresentationDataValue::ConcatenatePDVBlobs( command );
+          command.clear();
+          // The data set (Explicit VR Little Endian) must be the one of the
+          // SOP Instance of the command
+          gdcm::DataSet ds;
+          std::istringstream is( data );
+          ds.Read<gdcm::ExplicitDataElement,gdcm::SwapperNoOp>( is );
+          data.clear();
+          if( GetString( ds, gdcm::Tag(0x0008,0x0018) )
+            != GetString( rq->Command, gdcm::Tag(0x0,0x1000) )
+            || !ds.FindDataElement( gdcm::Tag(0x7fe0,0x0010) ) )
+            {
+            scp.Corrupted++;
+            }
+          pending.push_back( rq );
+          scp.Received.back()++;
+          scp.MaxOutstanding.back() = std::max( scp.MaxOutstanding.back(), pending.size() );
+          }
+        }
+      }
+    else if( itemtype == 0x5 )
+      {
+      AReleaseRQPDU release;
+      release.Read( s );
+      AReleaseRPPDU reply;
+      reply.Write( s );
+      s.flush();
+      break;
+      }
+    else
+      {
+      break; // A-ABORT
+      }
+    }
+}
+
+void *RunSCP(void *arg)
+{
+  StandInSCP &scp = *(StandInSCP*)arg;
+  for( int i = 0; i < scp.NumberOfAssociations; ++i )
+    {
+    if( !scp.Listener->is_readready( 10, 0 ) ) break;
+    iosockinet s( scp.Listener->accept() );
+    s->recvtimeout( 10 ); // never hang the test
+    int nodelay = 1;
+    s->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
+    RunAssociation( scp, s );
+    }
+  return NULL;
+}
+
+std::string WriteFile(const char *filename, unsigned int size, gdcm::UIDGenerator &uid)
+{
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 2 );
+  image->SetDimension( 0, size );
+  image->SetDimension( 1, size );
+  image->SetPixelFormat( gdcm::PixelFormat::UINT8 );
+  image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  std::vector<char> buffer( size * size, (char)size );
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( &buffer[0], (uint32_t)buffer.size() );
+  image->SetDataElement( pixeldata );
+
+  gdcm::ImageWriter writer;
+  writer.SetFileName( filename );
+  writer.SetImage( *image );
+  const std::string sopinstanceuid = uid.Generate();
+  gdcm::Attribute<0x0008,0x0018> at;
+  at.SetValue( sopinstanceuid.c_str() );
+  writer.GetFile().GetDataSet().Replace( at.GetAsDataElement() );
+  if( !writer.Write() ) return std::string();
+  return sopinstanceuid;
+}
+
+int CheckStatuses(std::vector<uint16_t> const &statuses,
+  std::vector<uint16_t> const &expected)
+{
+  if( statuses != expected )
+    {
+    std::cerr << "Unexpected C-STORE-RSP status:";
+    for( size_t i = 0; i < statuses.size(); ++i )
+      std::cerr << " " << std::hex << statuses[i] << std::dec;
+    std::cerr << std::endl;
+    return 1;
+    }
+  return 0;
+}
+}
+
+int TestServiceClassUser4(int, char *[])
+{
+  const char subdir[] = "TestServiceClassUser4";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  // 11 files, every 5th one is rejected by the SCP
+  StandInSCP scp;
+  scp.Corrupted = 0;
+  gdcm::UIDGenerator uid;
+  gdcm::Directory::FilenamesType filenames;
+  std::vector<uint16_t> expected;
+  for( unsigned int i = 0; i < 11; ++i )
+    {
+    char name[64];
+    sprintf( name, "/%02u.dcm", i );
+    const std::string filename = tmpdir + name;
+    // the last one spans several P-DATA-TF PDU
+    const std::string sopinstanceuid =
+      WriteFile( filename.c_str(), i == 10 ? 300 : 16 + 8 * i, uid );
+    if( sopinstanceuid.empty() )
+      {
+      std::cerr << "Could not write: " << filename << std::endl;
+      return 1;
+      }
+    filenames.push_back( filename );
+    expected.push_back( i % 5 == 4 ? 0xA700 : 0x0 );
+    if( i % 5 == 4 ) scp.Rejected.insert( sopinstanceuid );
+    }
+  gdcm::PresentationContextGenerator generator;
+  if( !generator.GenerateFromFilenames( filenames ) ) return 1;
+
+  sockinetbuf listener( sockbuf::sock_stream );
+  listener.reuseaddr( true );
+  listener.bind( (unsigned long)INADDR_LOOPBACK, 0 );
+  listener.listen();
+  scp.Listener = &listener;
+  scp.NumberOfAssociations = 2;
+  scp.Window = 4;
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return 1;
+
+  int res = 0;
+  gdcm::SmartPointer<gdcm::ServiceClassUser> scup = new gdcm::ServiceClassUser;
+  gdcm::ServiceClassUser &scu = *scup;
+  scu.SetHostname( "127.0.0.1" );
+  scu.SetPort( (uint16_t)listener.localport() );
+  scu.SetTimeout( 10 );
+  std::vector<uint16_t> statuses;
+
+  // Default: synchronous C-STORE, no Asynchronous Operations Window proposed
+  if( !scu.InitializeConnection() ) return 1;
+  scu.SetPresentationContexts( generator.GetPresentationContexts() );
+  if( !scu.StartAssociation() ) return 1;
+  if( scu.GetMaxOperationsInvoked() != 1 ) ++res;
+  if( scu.SendStore( filenames, statuses ) ) ++res;
+  res += CheckStatuses( statuses, expected );
+  if( !scu.StopAssociation() ) ++res;
+
+  // Propose 8, the SCP lowers it to 4. Two batches on the same association,
+  // the second one with a missing file.
+  if( !scu.InitializeConnection() ) return 1;
+  scu.SetPresentationContexts( generator.GetPresentationContexts() );
+  scu.SetMaxOperationsInvoked( 8 );
+  if( !scu.StartAssociation() ) return 1;
+  if( scu.GetMaxOperationsInvoked() != 4 )
+    {
+    std::cerr << "Negotiated window: " << scu.GetMaxOperationsInvoked() << std::endl;
+    ++res;
+    }
+  if( scu.SendStore( filenames, statuses ) ) ++res;
+  res += CheckStatuses( statuses, expected );
+  std::vector<std::string> batch( filenames.begin(), filenames.begin() + 3 );
+  batch.insert( batch.begin() + 1, tmpdir + "/missing.dcm" );
+  std::vector<uint16_t> batchexpected( expected.begin(), expected.begin() + 3 );
+  batchexpected.insert( batchexpected.begin() + 1, 0xFFFF );
+  if( scu.SendStore( batch, statuses ) ) ++res;
+  res += CheckStatuses( statuses, batchexpected );
+  if( !scu.StopAssociation() ) ++res;
+
+  pthread_join( thread, NULL );
+  if( scp.Proposed.size() != 2 || scp.Proposed[0] != -1 || scp.Proposed[1] != 8 )
+    {
+    std::cerr << "Wrong Asynchronous Operations Window proposed" << std::endl;
+    return 1;
+    }
+  if( scp.Received[0] != 11 || scp.Received[1] != 14 )
+    {
+    std::cerr << "Received: " << scp.Received[0] << " " << scp.Received[1] << std::endl;
+    ++res;
+    }
+  if( scp.Corrupted )
+    {
+    std::cerr << "Corrupted data sets: " << scp.Corrupted << std::endl;
+    ++res;
+    }
+  // Only the second association has C-STORE-RQ in flight
+  if( scp.MaxOutstanding[0] != 1 || scp.MaxOutstanding[1] != 4 )
+    {
+    std::cerr << "Outstanding C-STORE-RQ: " << scp.MaxOutstanding[0]
+      << " " << scp.MaxOutstanding[1] << std::endl;
+    ++res;
+    }
+  return res;
+}
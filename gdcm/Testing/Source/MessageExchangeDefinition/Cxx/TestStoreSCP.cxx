@@ -0,0 +1,241 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmStoreSCP.h"
+#include "gdcmStoreSCUPool.h"
+#include "gdcmServiceClassUser.h"
+#include "gdcmPresentationContextGenerator.h"
+#include "gdcmImageWriter.h"
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmReader.h"
+#include "gdcmAttribute.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+#include "gdcmDirectory.h"
+
+#include <pthread.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <set>
+
+#include <stdio.h>
+
+/*
+ * gdcm::StoreSCP serving three associations at once over loopback, fed by
+ * gdcm::StoreSCUPool: every instance must end up in the spool directory,
+ * identical to the file sent, and be notified once.
+ */
+namespace
+{
+struct Sink : public gdcm::StoreSCP::Sink
+{
+  Sink() { pthread_mutex_init( &Lock, NULL ); }
+  ~Sink() { pthread_mutex_destroy( &Lock ); }
+  void Stored(const char *filename)
+    {
+    pthread_mutex_lock( &Lock );
+    Filenames.push_back( filename );
+    pthread_mutex_unlock( &Lock );
+    }
+  pthread_mutex_t Lock;
+  std::vector<std::string> Filenames;
+};
+
+void *RunSCP(void *arg)
+{
+  gdcm::StoreSCP *scp = (gdcm::StoreSCP*)arg;
+  scp->Run();
+  return NULL;
+}
+
+bool WriteFile(const char *filename, unsigned int size, gdcm::TransferSyntax::TSType ts)
+{
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 2 );
+  image->SetDimension( 0, size );
+  image->SetDimension( 1, size );
+  image->SetPixelFormat( gdcm::PixelFormat::UINT8 );
+  image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  std::vector<char> buffer( size * size );
+  for( size_t i = 0; i < buffer.size(); ++i ) buffer[i] = (char)(i % 251);
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( &buffer[0], (uint32_t)buffer.size() );
+  image->SetDataElement( pixeldata );
+
+  gdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax( ts );
+  change.SetInput( *image );
+  if( !change.Change() ) return false;
+  gdcm::ImageWriter writer;
+  writer.SetFileName( filename );
+  writer.SetImage( change.GetOutput() );
+  return writer.Write();
+}
+
+// Data set as encoded (all files here are Explicit VR Little Endian based)
+std::string GetDataSet(gdcm::File const &file)
+{
+  std::ostringstream os;
+  file.GetDataSet().Write<gdcm::ExplicitDataElement,gdcm::SwapperNoOp>( os );
+  return os.str();
+}
+
+std::string GetSOPInstanceUID(gdcm::File const &file)
+{
+  gdcm::Attribute<0x0008,0x0018> at;
+  at.SetFromDataSet( file.GetDataSet() );
+  return at.GetValue().c_str();
+}
+}
+
+int TestStoreSCP(int, char *[])
+{
+  const char subdir[] = "TestStoreSCP";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  const std::string spooldir = tmpdir + "/spool";
+  if( !gdcm::System::FileIsDirectory( spooldir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( spooldir.c_str() );
+    }
+  // left by a previous run
+  gdcm::Directory previous;
+  previous.Load( spooldir.c_str() );
+  for( size_t i = 0; i < previous.GetFilenames().size(); ++i )
+    {
+    gdcm::System::RemoveFile( previous.GetFilenames()[i].c_str() );
+    }
+
+  // 12 files, every 3rd one RLE compressed, the last one spans several
+  // P-DATA-TF PDU
+  std::vector<std::string> filenames;
+  for( unsigned int i = 0; i < 12; ++i )
+    {
+    char name[64];
+    sprintf( name, "/%02u.dcm", i );
+    const std::string filename = tmpdir + name;
+    if( !WriteFile( filename.c_str(), i == 11 ? 400 : 16 + 8 * i, i % 3 == 2
+        ? gdcm::TransferSyntax::RLELossless : gdcm::TransferSyntax::ExplicitVRLittleEndian ) )
+      {
+      std::cerr << "Could not write: " << filename << std::endl;
+      return 1;
+      }
+    filenames.push_back( filename );
+    }
+
+  Sink sink;
+  gdcm::StoreSCP scp;
+  scp.SetSpoolDirectory( spooldir.c_str() );
+  scp.SetHostname( "127.0.0.1" );
+  scp.SetAETitle( "SPOOL" );
+  scp.SetNumberOfThreads( 3 );
+  scp.SetTimeout( 10 );
+  scp.SetSink( &sink );
+  if( !scp.Listen() ) return 1;
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return 1;
+
+  int res = 0;
+  // C-ECHO
+  gdcm::SmartPointer<gdcm::ServiceClassUser> scup = new gdcm::ServiceClassUser;
+  gdcm::ServiceClassUser &scu = *scup;
+  scu.SetHostname( "127.0.0.1" );
+  scu.SetPort( scp.GetPort() );
+  scu.SetTimeout( 10 );
+  gdcm::PresentationContextGenerator generator;
+  generator.GenerateFromUID( gdcm::UIDs::VerificationSOPClass );
+  // Another called AE Title is rejected
+  scu.SetCalledAETitle( "OTHER" );
+  if( !scu.InitializeConnection() ) return 1;
+  scu.SetPresentationContexts( generator.GetPresentationContexts() );
+  if( scu.StartAssociation() )
+    {
+    std::cerr << "Called AE Title not checked" << std::endl;
+    ++res;
+    }
+  scu.SetCalledAETitle( "SPOOL" );
+  if( !scu.InitializeConnection() ) return 1;
+  scu.SetPresentationContexts( generator.GetPresentationContexts() );
+  if( !scu.StartAssociation() || !scu.SendEcho() || !scu.StopAssociation() )
+    {
+    std::cerr << "C-ECHO failed" << std::endl;
+    ++res;
+    }
+
+  // C-STORE over three associations served concurrently
+  gdcm::StoreSCUPool pool;
+  pool.SetHostname( "127.0.0.1" );
+  pool.SetPort( scp.GetPort() );
+  pool.SetCalledAETitle( "SPOOL" );
+  pool.SetTimeout( 10 );
+  pool.SetNumberOfAssociations( 3 );
+  pool.SetMaxOperationsInvoked( 4 );
+  std::vector<uint16_t> statuses;
+  if( !pool.SendStore( filenames, statuses )
+    || statuses != std::vector<uint16_t>( filenames.size(), 0x0 ) )
+    {
+    std::cerr << "SendStore failed" << std::endl;
+    ++res;
+    }
+  // the SCP accepts RLE Lossless as proposed
+  if( pool.GetNumberOfTranscodedFiles() != 0 ) ++res;
+  pool.Close();
+
+  scp.Stop();
+  pthread_join( thread, NULL );
+
+  if( scp.GetNumberOfStoredInstances() != filenames.size()
+    || sink.Filenames.size() != filenames.size() )
+    {
+    std::cerr << "Stored: " << scp.GetNumberOfStoredInstances()
+      << " notified: " << sink.Filenames.size() << std::endl;
+    ++res;
+    }
+  const std::set<std::string> notified( sink.Filenames.begin(), sink.Filenames.end() );
+  for( size_t i = 0; i < filenames.size(); ++i )
+    {
+    gdcm::Reader sent;
+    sent.SetFileName( filenames[i].c_str() );
+    if( !sent.Read() ) return 1;
+    const std::string spooled =
+      spooldir + "/" + GetSOPInstanceUID( sent.GetFile() ) + ".dcm";
+    gdcm::Reader received;
+    received.SetFileName( spooled.c_str() );
+    if( !notified.count( spooled ) || !received.Read() )
+      {
+      std::cerr << "Not spooled: " << filenames[i] << std::endl;
+      ++res;
+      continue;
+      }
+    if( GetDataSet( received.GetFile() ) != GetDataSet( sent.GetFile() )
+      || received.GetFile().GetHeader().GetDataSetTransferSyntax()
+      != sent.GetFile().GetHeader().GetDataSetTransferSyntax() )
+      {
+      std::cerr << "Spooled file differs: " << spooled << std::endl;
+      ++res;
+      }
+    }
+  // no temporary file left behind
+  gdcm::Directory spool;
+  spool.Load( spooldir.c_str() );
+  if( spool.GetFilenames().size() != filenames.size() )
+    {
+    std::cerr << "Spool directory: " << spool.GetFilenames().size() << std::endl;
+    ++res;
+    }
+
+  return res;
+}
@@ -0,0 +1,432 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmStoreSCUPool.h"
+#include "gdcmAAssociateRQPDU.h"
+#include "gdcmAAssociateACPDU.h"
+#include "gdcmAReleaseRQPDU.h"
+#include "gdcmAReleaseRPPDU.h"
+#include "gdcmPDataTFPDU.h"
+#include "gdcmAsynchronousOperationsWindowSub.h"
+#include "gdcmImageWriter.h"
+#include "gdcmWriter.h"
+#include "gdcmUIDGenerator.h"
+#include "gdcmMediaStorage.h"
+#include "gdcmImageChangeTransferSyntax.h"
+#include "gdcmAttribute.h"
+#include "gdcmCommandDataSet.h"
+#include "gdcmTesting.h"
+#include "gdcmSystem.h"
+
+#include <socket++/sockinet.h>
+#include <pthread.h>
+#include <netinet/tcp.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+
+#include <stdio.h>
+
+/*
+ * gdcm::StoreSCUPool against a stand-in C-STORE SCP running one thread per
+ * association over loopback. The SCP refuses RLE Lossless, so that RLE files
+ * have to be transcoded to the fallback transfer syntax.
+ */
+namespace
+{
+using namespace gdcm::network;
+
+struct StandInSCP
+{
+  sockinetbuf *Listener;
+  volatile bool Stop;
+  pthread_mutex_t Lock;
+  // per association, under Lock:
+  std::vector<size_t> NumberOfProposedContexts;
+  std::vector<size_t> Received;
+  size_t ReceivedRLE; // data sets received on a refused context
+};
+
+struct Connection
+{
+  StandInSCP *SCP;
+  iosockinet *Socket;
+  size_t Index;
+};
+
+void WriteResponse(std::ostream &os, uint8_t pcid, gdcm::DataSet const &command)
+{
+  gdcm::CommandDataSet ds;
+  ds.Insert( command.GetDataElement( gdcm::Tag(0x0,0x0002) ) );
+  ds.Insert( command.GetDataElement( gdcm::Tag(0x0,0x1000) ) );
+  gdcm::Attribute<0x0,0x0100> commandfield = { 0x8001 };
+  ds.Insert( commandfield.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0110> messageid;
+  messageid.SetFromDataSet( command );
+  gdcm::Attribute<0x0,0x0120> respondedto = { messageid.GetValue() };
+  ds.Insert( respondedto.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0800> datasettype = { 0x0101 };
+  ds.Insert( datasettype.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0900> status = { 0 };
+  ds.Insert( status.GetAsDataElement() );
+  gdcm::Attribute<0x0,0x0000> grouplength = { 0 };
+  grouplength.SetValue( ds.GetLength<gdcm::ImplicitDataElement>() );
+  ds.Insert( grouplength.GetAsDataElement() );
+
+  PresentationDataValue pdv;
+  pdv.SetPresentationContextID( pcid );
+  pdv.SetDataSet( ds );
+  pdv.SetMessageHeader( 3 ); // command, last fragment
+  PDataTFPDU pdu;
+  pdu.AddPresentationDataValue( pdv );
+  pdu.Write( os );
+}
+
+void *RunAssociation(void *arg)
+{
+  Connection *c = (Connection*)arg;
+  StandInSCP &scp = *c->SCP;
+  iosockinet &s = *c->Socket;
+  uint8_t itemtype = 0;
+  s.read( (char*)&itemtype, 1 );
+  if( !s || itemtype != 0x1 ) return NULL;
+  AAssociateRQPDU rqpdu;
+  rqpdu.Read( s );
+
+  const std::string rle = gdcm::TransferSyntax::GetTSString( gdcm::TransferSyntax::RLELossless );
+  std::map<uint8_t, bool> refused;
+  AAssociateACPDU acpdu;
+  for( unsigned int i = 0; i < rqpdu.GetNumberOfPresentationContext(); ++i )
+    {
+    PresentationContextRQ const &pc = rqpdu.GetPresentationContext(i);
+    PresentationContextAC pcac;
+    pcac.SetPresentationContextID( pc.GetPresentationContextID() );
+    pcac.SetTransferSyntax( pc.GetTransferSyntaxes()[0] );
+    const bool isrle = rle == pc.GetTransferSyntaxes()[0].GetName();
+    pcac.SetReason( isrle ? 4 : 0 ); // transfer-syntaxes-not-supported
+    refused[ pc.GetPresentationContextID() ] = isrle;
+    acpdu.AddPresentationContextAC( pcac );
+    }
+  acpdu.InitFromRQ( rqpdu );
+  if( const AsynchronousOperationsWindowSub *aows =
+    rqpdu.GetUserInformation().GetAsynchronousOperationsWindowSub() )
+    {
+    UserInformation ui;
+    ui = acpdu.GetUserInformation();
+    ui.SetAsynchronousOperationsWindowSub( *aows );
+    acpdu.SetUserInformation( ui );
+    }
+  acpdu.Write( s );
+  s.flush();
+  pthread_mutex_lock( &scp.Lock );
+  scp.NumberOfProposedContexts[ c->Index ] = rqpdu.GetNumberOfPresentationContext();
+  pthread_mutex_unlock( &scp.Lock );
+
+  std::vector<PresentationDataValue> command;
+  for( ;; )
+    {
+    s.read( (char*)&itemtype, 1 );
+    if( !s ) break;
+    if( itemtype == 0x4 )
+      {
+      PDataTFPDU pdu;
+      pdu.Read( s );
+      for( size_t i = 0; i < pdu.GetNumberOfPresentationDataValues(); ++i )
+        {
+        PresentationDataValue const &pdv = pdu.GetPresentationDataValue(i);
+        if( pdv.GetIsCommand() )
+          {
+          command.push_back( pdv );
+          }
+        else if( pdv.GetIsLastFragment() )
+          {
+          const uint8_t pcid = pdv.GetPresentationContextID();
+          WriteResponse( s, pcid, PresentationDataValue::ConcatenatePDVBlobs( command ) );
+          s.flush();
+          command.clear();
+          pthread_mutex_lock( &scp.Lock );
+          scp.Received[ c->Index ]++;
+          if( refused[ pcid ] ) scp.ReceivedRLE++;
+          pthread_mutex_unlock( &scp.Lock );
+          }
+        }
+      }
+    else if( itemtype == 0x5 )
+      {
+      AReleaseRQPDU release;
+      release.Read( s );
+      AReleaseRPPDU reply;
+      reply.Write( s );
+      s.flush();
+      break;
+      }
+    else
+      {
+      break; // A-ABORT
+      }
+    }
+  return NULL;
+}
+
+void *RunSCP(void *arg)
+{
+  StandInSCP &scp = *(StandInSCP*)arg;
+  std::vector<pthread_t> threads;
+  std::vector<Connection*> connections;
+  while( !scp.Stop )
+    {
+    if( !scp.Listener->is_readready( 0, 100000 ) ) continue;
+    Connection *c = new Connection;
+    c->SCP = &scp;
+    c->Socket = new iosockinet( scp.Listener->accept() );
+    (*c->Socket)->recvtimeout( 10 ); // never hang the test
+    int nodelay = 1;
+    (*c->Socket)->setopt( TCP_NODELAY, &nodelay, sizeof(nodelay), IPPROTO_TCP );
+    pthread_mutex_lock( &scp.Lock );
+    c->Index = scp.Received.size();
+    scp.Received.push_back( 0 );
+    scp.NumberOfProposedContexts.push_back( 0 );
+    pthread_mutex_unlock( &scp.Lock );
+    pthread_t t;
+    if( pthread_create( &t, NULL, RunAssociation, c ) ) break;
+    threads.push_back( t );
+    connections.push_back( c );
+    }
+  for( size_t i = 0; i < threads.size(); ++i )
+    {
+    pthread_join( threads[i], NULL );
+    delete connections[i]->Socket;
+    delete connections[i];
+    }
+  return NULL;
+}
+
+bool WriteFile(const char *filename, unsigned int size, gdcm::TransferSyntax::TSType ts)
+{
+  gdcm::SmartPointer<gdcm::Image> image = new gdcm::Image;
+  image->SetNumberOfDimensions( 2 );
+  image->SetDimension( 0, size );
+  image->SetDimension( 1, size );
+  image->SetPixelFormat( gdcm::PixelFormat::UINT8 );
+  image->SetPhotometricInterpretation( gdcm::PhotometricInterpretation::MONOCHROME2 );
+  image->SetTransferSyntax( gdcm::TransferSyntax::ExplicitVRLittleEndian );
+  std::vector<char> buffer( size * size, (char)size );
+  gdcm::DataElement pixeldata( gdcm::Tag(0x7fe0,0x0010) );
+  pixeldata.SetByteValue( &buffer[0], (uint32_t)buffer.size() );
+  image->SetDataElement( pixeldata );
+
+  gdcm::ImageChangeTransferSyntax change;
+  change.SetTransferSyntax( ts );
+  change.SetInput( *image );
+  if( !change.Change() ) return false;
+  gdcm::ImageWriter writer;
+  writer.SetFileName( filename );
+  writer.SetImage( change.GetOutput() );
+  return writer.Write();
+}
+
+// A data set with nothing but its SOP Class / Instance UID
+bool WriteSOPClass(const char *filename, const char *sopclass,
+  gdcm::TransferSyntax::TSType ts)
+{
+  gdcm::Writer writer;
+  writer.SetFileName( filename );
+  gdcm::DataSet &ds = writer.GetFile().GetDataSet();
+  gdcm::UIDGenerator uid;
+  gdcm::DataElement sopclassuid( gdcm::Tag(0x8,0x16), 0, gdcm::VR::UI );
+  std::string value = sopclass;
+  if( value.size() % 2 ) value.push_back( 0 );
+  sopclassuid.SetByteValue( value.c_str(), (uint32_t)value.size() );
+  ds.Insert( sopclassuid );
+  gdcm::DataElement sopinstanceuid( gdcm::Tag(0x8,0x18), 0, gdcm::VR::UI );
+  value = uid.Generate();
+  if( value.size() % 2 ) value.push_back( 0 );
+  sopinstanceuid.SetByteValue( value.c_str(), (uint32_t)value.size() );
+  ds.Insert( sopinstanceuid );
+  writer.GetFile().GetHeader().SetDataSetTransferSyntax( ts );
+  return writer.Write();
+}
+
+// Two files per SOP Class, Implicit and Explicit VR Little Endian
+std::vector<std::string> WriteSOPClasses(std::string const &tmpdir,
+  std::vector<std::string> const &sopclasses)
+{
+  std::vector<std::string> filenames;
+  const gdcm::TransferSyntax::TSType ts[] = {
+    gdcm::TransferSyntax::ImplicitVRLittleEndian,
+    gdcm::TransferSyntax::ExplicitVRLittleEndian };
+  for( size_t i = 0; i < sopclasses.size(); ++i )
+    {
+    for( int t = 0; t < 2; ++t )
+      {
+      const std::string filename =
+        tmpdir + "/" + sopclasses[i] + (t ? "_explicit.dcm" : "_implicit.dcm");
+      if( !WriteSOPClass( filename.c_str(), sopclasses[i].c_str(), ts[t] ) )
+        {
+        std::cerr << "Could not write: " << filename << std::endl;
+        return std::vector<std::string>();
+        }
+      filenames.push_back( filename );
+      }
+    }
+  return filenames;
+}
+}
+
+int TestStoreSCUPool(int, char *[])
+{
+  const char subdir[] = "TestStoreSCUPool";
+  std::string tmpdir = gdcm::Testing::GetTempDirectory( subdir );
+  if( !gdcm::System::FileIsDirectory( tmpdir.c_str() ) )
+    {
+    gdcm::System::MakeDirectory( tmpdir.c_str() );
+    }
+
+  // 12 files, every 3rd one RLE compressed
+  std::vector<std::string> filenames;
+  for( unsigned int i = 0; i < 12; ++i )
+    {
+    char name[64];
+    sprintf( name, "/%02u.dcm", i );
+    const std::string filename = tmpdir + name;
+    if( !WriteFile( filename.c_str(), 16 + 8 * i, i % 3 == 2
+        ? gdcm::TransferSyntax::RLELossless : gdcm::TransferSyntax::ExplicitVRLittleEndian ) )
+      {
+      std::cerr << "Could not write: " << filename << std::endl;
+      return 1;
+      }
+    filenames.push_back( filename );
+    }
+
+  sockinetbuf listener( sockbuf::sock_stream );
+  listener.reuseaddr( true );
+  listener.bind( (unsigned long)INADDR_LOOPBACK, 0 );
+  listener.listen();
+  StandInSCP scp;
+  scp.Listener = &listener;
+  scp.Stop = false;
+  scp.ReceivedRLE = 0;
+  pthread_mutex_init( &scp.Lock, NULL );
+  pthread_t thread;
+  if( pthread_create( &thread, NULL, RunSCP, &scp ) ) return 1;
+
+  int res = 0;
+  gdcm::StoreSCUPool pool;
+  pool.SetHostname( "127.0.0.1" );
+  pool.SetPort( (uint16_t)listener.localport() );
+  pool.SetNumberOfAssociations( 3 );
+  pool.SetMaxOperationsInvoked( 4 );
+  std::vector<uint16_t> statuses;
+  const std::vector<uint16_t> expected( filenames.size(), 0x0 );
+
+  // First call: one negotiation to learn what the SCP accepts, then the two
+  // other associations only propose the accepted contexts
+  if( !pool.SendStore( filenames, statuses ) || statuses != expected )
+    {
+    std::cerr << "First SendStore failed" << std::endl;
+    ++res;
+    }
+  if( pool.GetNumberOfNegotiations() != 3 || pool.GetNumberOfTranscodedFiles() != 4 )
+    {
+    std::cerr << "Negotiations: " << pool.GetNumberOfNegotiations()
+      << " transcoded: " << pool.GetNumberOfTranscodedFiles() << std::endl;
+    ++res;
+    }
+
+  // Second call: the open associations and the cache are reused
+  if( !pool.SendStore( filenames, statuses ) || statuses != expected )
+    {
+    std::cerr << "Second SendStore failed" << std::endl;
+    ++res;
+    }
+  if( pool.GetNumberOfNegotiations() != 0 || pool.GetNumberOfTranscodedFiles() != 4 )
+    {
+    std::cerr << "Negotiations: " << pool.GetNumberOfNegotiations()
+      << " transcoded: " << pool.GetNumberOfTranscodedFiles() << std::endl;
+    ++res;
+    }
+
+  // More than 128 combinations over two calls, the ones of the second call
+  // sorting last: they are proposed first, whatever the cache already holds
+  std::set<std::string> storage;
+  for( int ms = 0; ms < gdcm::MediaStorage::MS_END; ++ms )
+    {
+    if( ms == gdcm::MediaStorage::MediaStorageDirectoryStorage ) continue;
+    if( const char *uid = gdcm::MediaStorage::GetMSString( (gdcm::MediaStorage::MSType)ms ) )
+      storage.insert( uid );
+    }
+  if( storage.size() < 70 ) return 1;
+  std::set<std::string>::const_iterator it = storage.begin();
+  std::vector<std::string> calls[2];
+  for( size_t i = 0; i < 60; ++i ) calls[0].push_back( *it++ );
+  it = storage.end();
+  for( size_t i = 0; i < 10; ++i ) calls[1].push_back( *--it );
+  for( int c = 0; c < 2; ++c )
+    {
+    const std::vector<std::string> sopclasses = WriteSOPClasses( tmpdir, calls[c] );
+    if( sopclasses.empty() ) return 1;
+    if( !pool.SendStore( sopclasses, statuses )
+      || statuses != std::vector<uint16_t>( sopclasses.size(), 0x0 ) )
+      {
+      std::cerr << "SendStore of " << sopclasses.size() << " SOP Classes failed"
+        << std::endl;
+      ++res;
+      }
+    }
+  pool.Close();
+
+  scp.Stop = true;
+  pthread_join( thread, NULL );
+  pthread_mutex_destroy( &scp.Lock );
+
+  // The first three associations served the first two calls
+  if( scp.Received.size() < 3 )
+    {
+    std::cerr << "Associations: " << scp.Received.size() << std::endl;
+    return 1;
+    }
+  size_t total = 0;
+  for( size_t a = 0; a < 3; ++a )
+    {
+    // every association gets a share of the files
+    if( scp.Received[a] == 0 ) ++res;
+    total += scp.Received[a];
+    }
+  if( total != 24 || scp.ReceivedRLE != 0 )
+    {
+    std::cerr << "Received: " << total << " on refused context: "
+      << scp.ReceivedRLE << std::endl;
+    ++res;
+    }
+  // Explicit + RLE, then only Explicit once RLE is known to be refused
+  if( scp.NumberOfProposedContexts[0] != 2 || scp.NumberOfProposedContexts[1] != 1
+    || scp.NumberOfProposedContexts[2] != 1 )
+    {
+    std::cerr << "Proposed contexts: " << scp.NumberOfProposedContexts[0] << " "
+      << scp.NumberOfProposedContexts[1] << " " << scp.NumberOfProposedContexts[2]
+      << std::endl;
+    ++res;
+    }
+  for( size_t a = 3; a < scp.Received.size(); ++a )
+    total += scp.Received[a];
+  if( total != 24 + 140 )
+    {
+    std::cerr << "Received in total: " << total << std::endl;
+    ++res;
+    }
+
+  return res;
+}
@@ -0,0 +1,70 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "gdcmTestingWriter.h"
+
+namespace gdcm
+{
+
+TestingWriter::TestingWriter()
+{
+  GetFile().GetHeader().SetDataSetTransferSyntax( TransferSyntax::ExplicitVRLittleEndian );
+}
+
+void TestingWriter::AddString(DataSet &ds, const Tag &t, const VR &vr, std::string const &value)
+{
+  std::string padded = value;
+  if( padded.size() % 2 ) padded += vr == VR::UI ? '\0' : ' ';
+  DataElement de( t );
+  de.SetVR( vr );
+  de.SetByteValue( padded.c_str(), (uint32_t)padded.size() );
+  ds.Replace( de );
+}
+
+void TestingWriter::AddString(const Tag &t, const VR &vr, std::string const &value)
+{
+  AddString( GetFile().GetDataSet(), t, vr, value );
+}
+
+void TestingWriter::SetImage(MediaStorage const &ms, std::string const &study,
+  std::string const &series, std::string const &instance)
+{
+  AddString( Tag(0x0008,0x0016), VR::UI, ms.GetString() );
+  AddString( Tag(0x0008,0x0018), VR::UI, instance );
+  AddString( Tag(0x0008,0x0060), VR::CS, ms.GetModality() );
+  AddString( Tag(0x0010,0x0010), VR::PN, "Doe^John" );
+  AddString( Tag(0x0020,0x000d), VR::UI, study );
+  AddString( Tag(0x0020,0x000e), VR::UI, series );
+}
+
+void TestingWriter::SetPixelData(uint16_t rows, uint16_t columns, std::string const &pixels)
+{
+  DataSet &ds = GetFile().GetDataSet();
+  AddString( Tag(0x0028,0x0004), VR::CS, "MONOCHROME2" );
+  const uint16_t us[5] = { 1, rows, columns, 16, 12 };
+  const Tag ustags[5] = { Tag(0x0028,0x0002), Tag(0x0028,0x0010),
+    Tag(0x0028,0x0011), Tag(0x0028,0x0100), Tag(0x0028,0x0101) };
+  for( int i = 0; i < 5; ++i )
+    {
+    DataElement de( ustags[i] );
+    de.SetVR( VR::US );
+    de.SetByteValue( (const char*)(us + i), 2 );
+    ds.Replace( de );
+    }
+  DataElement pixeldata( Tag(0x7fe0,0x0010) );
+  pixeldata.SetVR( VR::OW );
+  pixeldata.SetByteValue( pixels.c_str(), (uint32_t)pixels.size() );
+  ds.Replace( pixeldata );
+}
+
+} // end namespace gdcm
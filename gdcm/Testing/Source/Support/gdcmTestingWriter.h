@@ -0,0 +1,57 @@
+/*=========================================================================
+
+  Program: GDCM (Grassroots DICOM). A DICOM library
+
+  Copyright (c) 2006-2011 Mathieu Malaterre
+  All rights reserved.
+  See Copyright.txt or http://gdcm.sourceforge.net/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#ifndef GDCMTESTINGWRITER_H
+#define GDCMTESTINGWRITER_H
+
+#include "gdcmWriter.h"
+#include "gdcmMediaStorage.h"
+
+#include <string>
+
+namespace gdcm
+{
+/**
+ * \brief Writer of the small synthetic instances tests and benchmarks need
+ * \details The attributes are given as strings and the data set is written
+ * Explicit VR Little Endian. The values are not validated: this is not meant
+ * for real data. Built in the gdcmTestingSupport static library, for the
+ * tests and the benchmarks only: neither part of gdcmDSED nor installed.
+ *
+ * \see Testing
+ */
+class TestingWriter : public Writer
+{
+public:
+  TestingWriter();
+
+  /// Insert (or replace) t in ds, value padded to an even length (with \0
+  /// for UI, a space otherwise)
+  static void AddString(DataSet &ds, const Tag &t, const VR &vr, std::string const &value);
+
+  /// Same, in the data set of the file
+  void AddString(const Tag &t, const VR &vr, std::string const &value);
+
+  /// What identifies an image of patient Doe^John: SOP Class (ms) and
+  /// Instance UID, Modality (that of ms), Study and Series Instance UID
+  void SetImage(MediaStorage const &ms, std::string const &study,
+    std::string const &series, std::string const &instance);
+
+  /// Image Pixel module of a rows x columns MONOCHROME2 image, 16 bits
+  /// allocated, 12 stored: pixels holds its 2 * rows * columns bytes
+  void SetPixelData(uint16_t rows, uint16_t columns, std::string const &pixels);
+};
+
+} // end namespace gdcm
+
+#endif //GDCMTESTINGWRITER_H
@@ -5,6 +5,12 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     MainWindow w;
+
+    /* --benchmark [files [size_kb [latency_ms [bandwidth_kBps [error_pct [file_error_pct]]]]]] */
+    QStringList args = a.arguments();
+    if ((args.size() > 1) && (args[1] == "--benchmark"))
+        return w.RunBenchmark(args.mid(2));
+
     w.show();
 
     return a.exec();
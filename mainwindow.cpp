@@ -31,12 +31,24 @@ MainWindow::MainWindow(QWidget *parent) :
     numFilesSentSuccess = 0;
     numFilesSentFail = 0;
     numFilesSentTotal = 0;
-    numBytesLastSend = 0;
-    numFilesLastSend = 0;
+    numBytesResent = 0;
 
     networkManager = new QNetworkAccessManager(this);
     isUploading = false;
 
+    uploadLimiter = new RateLimiter(this);
+    directUpload = true;
+    metadata = new MetadataClient(this);
+    connecting = false;
+    anonMsecs = 0;
+    uploadMsecs = 0;
+    uploadCpuMsecs = 0;
+    connect(metadata, SIGNAL(Loaded(QString,QString,QString)), this, SLOT(onMetadataLoaded(QString,QString,QString)));
+    connect(metadata, SIGNAL(Finished()), this, SLOT(onMetadataFinished()));
+
+    receiveTimer = new QTimer(this);
+    connect(receiveTimer, SIGNAL(timeout()), this, SLOT(onReceiveTimer()));
+
     PopulateModality();
     PopulateConnectionList();
     SetBuildDate();
@@ -58,6 +70,7 @@ MainWindow::MainWindow(QWidget *parent) :
 /* ------------------------------------------------- */
 MainWindow::~MainWindow()
 {
+    dicomReceiver.Stop();
     delete ui;
     logfile.close();
     idfile.close();
@@ -162,6 +175,17 @@ void MainWindow::on_btnTestConn_clicked()
     WriteLog("Done caling SetProxy() in on_btnTestConn_clicked()...");
 
     if (GetConnectionParms(connServer, connUsername, connPassword)) {
+        /* a DICOM destination is tested with a C-ECHO */
+        if (DicomSender::IsDicomUrl(connServer)) {
+            QApplication::setOverrideCursor(Qt::WaitCursor);
+            if (dicomSender.SetUrl(connServer) && dicomSender.Echo())
+                ui->lblConnMessage->setText("C-ECHO successful");
+            else
+                ui->lblConnMessage->setText(dicomSender.GetLastError());
+            QApplication::restoreOverrideCursor();
+            return;
+        }
+
         /* set the hourglass cursor */
         QApplication::setOverrideCursor(Qt::WaitCursor);
 
@@ -232,24 +256,24 @@ void MainWindow::onGetReply()
 /* ------------------------------------------------- */
 /* --------- onGetReplyUpload ---------------------- */
 /* ------------------------------------------------- */
+/* records the result of each file of lastSentList,  */
+/* AnonymizeAndUpload sends the failed ones again    */
 void MainWindow::onGetReplyUpload()
 {
     WriteLog("Entering onGetReplyUpload()");
-    isUploading = false;
 
-    WriteLog(QString("(Z) numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
-
-    //qDebug() << "numNetConn (A): " << numNetConn;
     QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
 
     QString response;
+    bool httpOk = false;
+    QHash<QString, QByteArray> checksums;
     if (reply) {
+        UploadBody *body = reply->findChild<UploadBody*>();
+        if (body)
+            checksums = body->GetChecksums();
         if (reply->error() == QNetworkReply::NoError) {
-            const int available = reply->bytesAvailable();
-            if (available > 0) {
-                const QByteArray buffer(reply->readAll());
-                response = QString::fromUtf8(buffer);
-            }
+            httpOk = true;
+            response = QString::fromUtf8(reply->readAll());
         } else {
             response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
         }
@@ -257,75 +281,232 @@ void MainWindow::onGetReplyUpload()
         reply->deleteLater();
     }
 
-    if (response.trimmed().isEmpty()) {
-        response = tr("Unable to retrieve POST response");
-    }
+    UploadDone(httpOk, response, checksums);
+    WriteLog("Leaving onGetReplyUpload()");
+}
 
-    WriteLog("OnGetReplyUpload(" + response + ")");
-    //ui->txtLog->append(response);
 
-    WriteLog(QString("(Z1) numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
+/* ------------------------------------------------- */
+/* --------- onDirectUploadFinished ---------------- */
+/* ------------------------------------------------- */
+void MainWindow::onDirectUploadFinished()
+{
+    WriteLog("Entering onDirectUploadFinished()");
 
-    /* set the last sent statistics */
-    numFilesSentSuccess += numFilesLastSend;
-    numBytesSentSuccess += numBytesLastSend;
-    numFilesLastSend = 0;
-    numBytesLastSend = 0;
-    ui->lblUploadFilesSentSuccess->setText(QString("%1").arg(numFilesSentSuccess));
-    //emit complete(response);
-    numNetConn--;
-    WriteLog(QString("numNetConn (B): %1").arg(numNetConn));
+    DirectUpload* upload = qobject_cast<DirectUpload*>(sender());
 
-    QBrush colorGreen(Qt::green);
-    for (int i=0;i<lastUploadList.count();i++) {
-        int ii = lastUploadList[i];
-        ui->tableFiles->item(ii,1)->setForeground(colorGreen);
-        ui->tableFiles->item(ii,1)->setText("Upload success");
-    }
+    QString response;
+    bool httpOk = false;
+    QHash<QString, QByteArray> checksums;
+    if (upload) {
+        UploadBody *body = upload->findChild<UploadBody*>();
+        if (body)
+            checksums = body->GetChecksums();
+        if (upload->IsOk()) {
+            httpOk = true;
+            response = QString::fromUtf8(upload->GetResponse());
+        } else {
+            response = tr("Error: %1 status: %2").arg(upload->GetLastError()).arg(upload->GetStatus());
+        }
 
-    WriteLog(QString("(Z2) numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
+        upload->deleteLater();
+    }
 
-    WriteLog("Leaving onGetReplyUpload()");
+    UploadDone(httpOk, response, checksums);
+    WriteLog("Leaving onDirectUploadFinished()");
 }
 
 
 /* ------------------------------------------------- */
-/* --------- onNetworkError ------------------------ */
+/* --------- UploadDone ---------------------------- */
 /* ------------------------------------------------- */
-void MainWindow::onNetworkError(QNetworkReply::NetworkError networkError)
+/* the answer to the upload of lastSentList, from    */
+/* either transport, and the checksums of the files  */
+/* as they were sent                                 */
+void MainWindow::UploadDone(bool httpOk, QString response, QHash<QString, QByteArray> checksums)
 {
-    WriteLog("Entering onNetworkError()");
-
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    WriteLog("Error [" + reply->errorString() + "]");
-
-    /* if this function is called, the last queued network request should be finished */
     isUploading = false;
     numNetConn--;
 
-    WriteLog(QString("(E) numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
+    if (response.trimmed().isEmpty()) {
+        response = tr("Unable to retrieve POST response");
+    }
+
+    WriteLog("UploadDone(" + response + ")");
 
-    /* update the upload stats and reset the counts for the last upload */
-    numBytesSentFail += numBytesLastSend;
-    numFilesSentFail += numFilesLastSend;
-    numFilesLastSend = 0;
-    numBytesLastSend = 0;
-    //qDebug() << err.errorString();
+    /* a failed request failed for all its files, they are all sent again */
+    QHash<QString, QString> results;
+    QSet<QString> retry;
+    if (httpOk)
+        ParseUploadResponse(response, lastSentList, checksums, results, retry);
+    else
+        for (int i=0; i<lastSentList.size(); i++) {
+            results[lastSentList[i]] = response;
+            retry << lastSentList[i];
+        }
 
+    QBrush colorGreen(Qt::green);
     QBrush colorRed(Qt::red);
-    for (int i=0;i<lastUploadList.count();i++) {
-        int ii = lastUploadList[i];
-        ui->tableFiles->item(ii,1)->setForeground(colorRed);
-        ui->tableFiles->item(ii,1)->setText("Upload fail");
+    QList<int> failedRows;
+    for (int i=0; i<lastSentList.size(); i++) {
+        QString f = lastSentList[i];
+        bool ok = results[f].isEmpty();
+        uploadResults[f] = ok;
+        if (retry.contains(f))
+            uploadRetry << f;
+        else
+            uploadRetry.remove(f);
+        if (ok) {
+            numFilesSentSuccess++;
+            numBytesSentSuccess += QFileInfo(f).size();
+        }
+        else {
+            WriteLog(QString("Upload of [%1] failed [%2]").arg(f).arg(results[f]));
+        }
+        if (!uploadRows.contains(f))
+            continue;
+        int ii = uploadRows[f];
+        if (!ok) {
+            failedRows << ii;
+        }
+        else if (!failedRows.contains(ii)) {
+            ui->tableFiles->item(ii,1)->setForeground(colorGreen);
+            ui->tableFiles->item(ii,1)->setText("Upload success");
+        }
     }
+    /* a .par/.rec row fails with either file */
+    for (int i=0; i<failedRows.size(); i++) {
+        ui->tableFiles->item(failedRows[i],1)->setForeground(colorRed);
+        ui->tableFiles->item(failedRows[i],1)->setText("Upload fail");
+    }
+    ui->lblUploadFilesSentSuccess->setText(QString("%1").arg(numFilesSentSuccess));
 
-    WriteLog(QString("(F) numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
+    WriteLog(QString("numFilesSentTotal: [%1] numFilesSentSuccess: [%2] numFilesSentFail: [%3]").arg(numFilesSentTotal).arg(numFilesSentSuccess).arg(numFilesSentFail));
+}
 
-    ui->lblUploadFilesSentFail->setText(QString("%1").arg(numFilesSentFail));
 
-    WriteLog("Leaving onNetworkError()");
+/* ------------------------------------------------- */
+/* --------- ParseUploadResponse ------------------- */
+/* ------------------------------------------------- */
+/* the answer holds one line per file:               */
+/*   filename|OK                                     */
+/*   filename|OK|checksum                            */
+/*   filename|ERROR|message                          */
+/* with the filename exactly as sent in the form. No */
+/* match on the name without its path: two files of  */
+/* the same name from two directories would share a  */
+/* line. results gets the error of each file of      */
+/* list, empty when stored, and retry the files the  */
+/* server says it did not store, to send again. An   */
+/* answer without a line for any file of list (the   */
+/* api.php that does not list them) stands for the   */
+/* whole list: the 2xx status says they are stored.  */
+/* In an answer that lists some, a file without a    */
+/* line failed, but is not sent again: the server    */
+/* may have stored it all the same.                  */
+/* A file stored with another checksum (XXH3 of what */
+/* the server wrote, as in the manifest) than the    */
+/* one sent failed too. Once the answer gives the    */
+/* checksum of any file, the server checks them: a   */
+/* file acknowledged without one then failed too.    */
+/* An api.php that gives none is trusted.           */
+void MainWindow::ParseUploadResponse(QString response, QStringList list, QHash<QString, QByteArray> checksums, QHash<QString, QString> &results, QSet<QString> &retry)
+{
+    QHash<QString, QString> lines;
+    QHash<QString, QString> stored;
+    QStringList responseLines = response.split("\n");
+    for (int i=0; i<responseLines.size(); i++) {
+        QStringList parts = responseLines[i].trimmed().split("|");
+        if (parts.size() < 2)
+            continue;
+        QString name = parts[0].trimmed();
+        QString status = parts[1].trimmed().toUpper();
+        QString error;
+        if ((status != "OK") && (status != "SUCCESS"))
+            error = (parts.size() > 2) ? parts.mid(2).join("|") : status;
+        else if (parts.size() > 2)
+            stored[name] = parts.last().trimmed().toLower();
+        lines[name] = error;
+    }
+
+    bool listed = false;
+    for (int i=0; i<list.size(); i++)
+        listed = listed || lines.contains(list[i]);
+    if (!listed) {
+        for (int i=0; i<list.size(); i++)
+            results[list[i]] = "";
+        return;
+    }
+
+    for (int i=0; i<list.size(); i++) {
+        QString f = list[i];
+        if (!lines.contains(f)) {
+            results[f] = "Not acknowledged by the server";
+            continue;
+        }
+        results[f] = lines[f];
+        if (!results[f].isEmpty()) {
+            retry << f;
+            continue;
+        }
+        if (!checksums.contains(f))
+            continue;
+        if (!stored.contains(f)) {
+            if (stored.isEmpty())
+                continue;
+            results[f] = QString("No checksum in the answer, sent [%1]").arg(QString(checksums[f]));
+            retry << f;
+        }
+        else if (stored[f] != checksums[f]) {
+            results[f] = QString("Checksum mismatch, sent [%1] stored [%2]").arg(QString(checksums[f])).arg(stored[f]);
+            retry << f;
+        }
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- FailedUploads ------------------------- */
+/* ------------------------------------------------- */
+/* the files of list the server did not store        */
+QStringList MainWindow::FailedUploads(QStringList list)
+{
+    QStringList failed;
+    for (int i=0; i<list.size(); i++)
+        if (!uploadResults.value(list[i], false))
+            failed << list[i];
+    return failed;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- RetryUploads -------------------------- */
+/* ------------------------------------------------- */
+/* the files of list the server said it did not      */
+/* store, the only ones worth sending again          */
+QStringList MainWindow::RetryUploads(QStringList list)
+{
+    QStringList retry;
+    for (int i=0; i<list.size(); i++)
+        if (uploadRetry.contains(list[i]))
+            retry << list[i];
+    return retry;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onNetworkError ------------------------ */
+/* ------------------------------------------------- */
+/* onGetReplyUpload follows, and handles the files   */
+void MainWindow::onNetworkError(QNetworkReply::NetworkError networkError)
+{
+    Q_UNUSED(networkError);
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (reply)
+        WriteLog("Error [" + reply->errorString() + "]");
 }
 
+
 /* ------------------------------------------------- */
 /* --------- on_btnSelectDataDir_clicked ----------- */
 /* ------------------------------------------------- */
@@ -341,6 +522,12 @@ void MainWindow::on_btnSelectDataDir_clicked()
 /* ------------------------------------------------- */
 void MainWindow::on_btnSearch_clicked()
 {
+    /* a dicom:// data dir receives the files from DICOM nodes (C-STORE) instead of searching a directory */
+    if (DicomSender::IsDicomUrl(ui->txtDataDir->text())) {
+        ToggleReceiver();
+        return;
+    }
+
     /* disable the upload button */
     ui->btnUploadAll->setEnabled(false);
 
@@ -358,44 +545,212 @@ void MainWindow::on_btnSearch_clicked()
 /* ------------------------------------------------- */
 void MainWindow::scanDirIter(QDir dir)
 {
-    QVariant modality = ui->cmbModality->currentData();
-    QString fullfile;
-    QDirIterator iterator(dir.absolutePath(), QDirIterator::Subdirectories);
-    QString fileModality;
-    QString fileType;
-    QString filePatientID;
+    QDir root(dir.absolutePath());
+    QDirIterator iterator(root.path(), QDirIterator::Subdirectories);
 
     elapsedFileSearchTime.start();
     startFileSearchTime = QDateTime::currentDateTime();
     ui->lblFileStartTime->setText(startFileSearchTime.toString(Qt::TextDate));
 
-    /* iterate through all files in the parent directory */
+    /* a DICOMDIR in the searched directory is read before the walk, so */
+    /* none of the files it lists are opened. One in a subdirectory is  */
+    /* read when the walk reaches it, and only covers the files found   */
+    /* after it                                                         */
+    QSet<QString> dicomdirs;
+    QHash<QString, gdcm::DICOMDIR::FileRecord> listed;
+    QFileInfoList top = root.entryInfoList(QStringList("DICOMDIR"), QDir::Files);
+    for (int i=0; i<top.size(); i++) {
+        if (ReadDicomDir(top[i].filePath(), listed))
+            dicomdirs.insert(top[i].filePath());
+    }
+
+    /* rows are added as the walk goes, a batch at a time */
+    const int batchSize = 100;
+    QList<QFileInfo> batch;
     while (iterator.hasNext()) {
         iterator.next();
-        if (!iterator.fileInfo().isDir()) {
-            fullfile = iterator.filePath();
-            /* check the file type */
+        if (iterator.fileInfo().isDir() || dicomdirs.contains(iterator.filePath()))
+            continue;
+        /* the DICOMDIR itself is not uploaded */
+        if ((iterator.fileName().compare("DICOMDIR", Qt::CaseInsensitive) == 0) && ReadDicomDir(iterator.filePath(), listed)) {
+            dicomdirs.insert(iterator.filePath());
+            continue;
+        }
+        batch << iterator.fileInfo();
+        if (batch.size() >= batchSize) {
+            AddScannedFiles(batch, listed);
+            batch.clear();
+        }
+    }
+    AddScannedFiles(batch, listed);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddScannedFiles ----------------------- */
+/* ------------------------------------------------- */
+/* add the files of the selected modality, the type  */
+/* of the ones a DICOMDIR lists comes from its       */
+/* records instead of the file                       */
+void MainWindow::AddScannedFiles(QList<QFileInfo> const &found, QHash<QString, gdcm::DICOMDIR::FileRecord> const &listed)
+{
+    QVariant modality = ui->cmbModality->currentData();
+    QString fullfile;
+    QString fileModality;
+    QString fileType;
+    QString filePatientID;
+
+    for (int i=0; i<found.size(); i++) {
+        fullfile = found[i].filePath();
+
+        /* check the file type */
+        QHash<QString, gdcm::DICOMDIR::FileRecord>::const_iterator record = listed.constFind(QDir::cleanPath(fullfile).toLower());
+        bool fromDicomDir = (record != listed.constEnd());
+        if (fromDicomDir) {
+            fileType = "DICOM";
+            fileModality = QString::fromStdString(record->Modality);
+            filePatientID = QString::fromStdString(record->PatientID);
+        }
+        else {
             GetFileType(fullfile, fileType, fileModality, filePatientID);
-            if (fileType == "DICOM") {
-                if (modality == "DICOM") {
-                    AddFoundFile(&iterator,fullfile,fileType,fileModality, filePatientID);
-                }
-                else {
-                    if (modality == fileModality) {
-                        AddFoundFile(&iterator,fullfile,fileType,modality.toString(), filePatientID);
-                    }
-                }
-            }
-            if ((fileType == "PARREC") && (modality == "PARREC")) {
-                AddFoundFile(&iterator,fullfile,fileType,fileModality, filePatientID);
-            }
-            if ((fileType == "EEG") && (modality == "EEG")) {
-                AddFoundFile(&iterator,fullfile,fileType,fileModality, filePatientID);
+        }
+
+        int row = ui->tableFiles->rowCount();
+        if (fileType == "DICOM") {
+            if (modality == "DICOM") {
+                AddFoundFile(found[i],fullfile,fileType,fileModality, filePatientID);
             }
-            if ((fileType == "NIFTI") && (modality == "NIFTI")) {
-                AddFoundFile(&iterator,fullfile,fileType,fileModality, filePatientID);
+            else {
+                if (modality == fileModality) {
+                    AddFoundFile(found[i],fullfile,fileType,modality.toString(), filePatientID);
+                }
             }
         }
+        if ((fileType == "PARREC") && (modality == "PARREC")) {
+            AddFoundFile(found[i],fullfile,fileType,fileModality, filePatientID);
+        }
+        if ((fileType == "EEG") && (modality == "EEG")) {
+            AddFoundFile(found[i],fullfile,fileType,fileModality, filePatientID);
+        }
+        if ((fileType == "NIFTI") && (modality == "NIFTI")) {
+            AddFoundFile(found[i],fullfile,fileType,fileModality, filePatientID);
+        }
+
+        /* not opened yet, AnonymizeAndUpload checks it */
+        if (fromDicomDir && (ui->tableFiles->rowCount() > row)) {
+            ui->tableFiles->item(row,1)->setText("In DICOMDIR");
+            dicomdirFiles.insert(fullfile);
+        }
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ReadDicomDir -------------------------- */
+/* ------------------------------------------------- */
+/* add the files a DICOMDIR lists to records, by     */
+/* lowercase path (ISO 9660 names are uppercase in   */
+/* the DICOMDIR, not always on the mounted disc)     */
+bool MainWindow::ReadDicomDir(QString f, QHash<QString, gdcm::DICOMDIR::FileRecord> &records)
+{
+    gdcm::Reader r;
+    r.SetFileName(f.toStdString().c_str());
+    gdcm::DICOMDIR dicomdir;
+    if (!r.Read() || !dicomdir.SetFromFile(r.GetFile())) {
+        WriteLog(QString("[%1] is not a readable DICOMDIR, searching its files").arg(f));
+        return false;
+    }
+
+    QString root = QFileInfo(f).absolutePath() + "/";
+    gdcm::DICOMDIR::FileRecordsType const &fileRecords = dicomdir.GetFileRecords();
+    for (size_t i=0; i<fileRecords.size(); i++) {
+        QString path = root + QString::fromStdString(fileRecords[i].ReferencedFileID);
+        records.insert(QDir::cleanPath(path).toLower(), fileRecords[i]);
+    }
+    WriteLog(QString("Read %1 file records from DICOMDIR [%2]").arg(fileRecords.size()).arg(f));
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ToggleReceiver ------------------------ */
+/* ------------------------------------------------- */
+/* start or stop receiving on the dicom:// data dir  */
+void MainWindow::ToggleReceiver()
+{
+    if (dicomReceiver.IsListening()) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        dicomReceiver.Stop();
+        QApplication::restoreOverrideCursor();
+        receiveTimer->stop();
+        /* the files received since the last timer tick */
+        AddReceivedFiles();
+        ui->btnSearch->setText("Search");
+        ui->lblStatus->setText("Stopped receiving");
+        WriteLog("Stopped DICOM receiver");
+        return;
+    }
+
+    /* the received files stay in the spool directory, they are copied to a temp dir before being anonymized */
+    QString spoolDir = ui->txtTmpDir->text();
+    if (spoolDir == "")
+        spoolDir = QDir::tempPath();
+    spoolDir += "/received";
+    if (!dicomReceiver.Start(ui->txtDataDir->text(), spoolDir)) {
+        ShowMessageBox(dicomReceiver.GetLastError());
+        return;
+    }
+    WriteLog(QString("Started DICOM receiver on port %1, spooling to [%2]").arg(dicomReceiver.GetPort()).arg(spoolDir));
+
+    elapsedFileSearchTime.start();
+    startFileSearchTime = QDateTime::currentDateTime();
+    ui->lblFileStartTime->setText(startFileSearchTime.toString(Qt::TextDate));
+
+    receiveTimer->start(1000);
+    ui->btnSearch->setText("Stop receiving");
+    ui->btnUploadAll->setEnabled(true);
+    ui->lblStatus->setText(QString("Receiving on port %1").arg(dicomReceiver.GetPort()));
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onReceiveTimer ------------------------ */
+/* ------------------------------------------------- */
+void MainWindow::onReceiveTimer()
+{
+    AddReceivedFiles();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddReceivedFiles ---------------------- */
+/* ------------------------------------------------- */
+/* add the received files to the file list, as if    */
+/* they were found by a search                       */
+void MainWindow::AddReceivedFiles()
+{
+    QVariant modality = ui->cmbModality->currentData();
+    QString fileModality;
+    QString fileType;
+    QString filePatientID;
+
+    QStringList received = dicomReceiver.TakeReceived();
+    for (int i=0; i<received.size(); i++) {
+        QString f = received[i];
+        GetFileType(f, fileType, fileModality, filePatientID);
+        if (fileType != "DICOM") {
+            WriteLog(QString("Received file [%1] is not readable DICOM").arg(f));
+            continue;
+        }
+        if (modality == "DICOM") {
+            AddFoundFile(QFileInfo(f),f,fileType,fileModality,filePatientID);
+        }
+        else if (modality == fileModality) {
+            AddFoundFile(QFileInfo(f),f,fileType,modality.toString(),filePatientID);
+        }
+        else {
+            WriteLog(QString("Received file [%1] has modality [%2], skipped").arg(f).arg(fileModality));
+        }
     }
 }
 
@@ -412,18 +767,16 @@ void MainWindow::GetFileType(QString f, QString &fileType, QString &fileModality
     if (r.Read()) {
         //qDebug("%s is a DICOM file",f.toStdString().c_str());
         fileType = QString("DICOM");
-        gdcm::StringFilter sf;
-        sf = gdcm::StringFilter();
-        sf.SetFile(r.GetFile());
-        std::string s;
+        tagFilter.SetFile(r.GetFile());
+        char s[256];
 
         /* get modality */
-        s = sf.ToString(gdcm::Tag(0x0008,0x0060));
-        fileModality = QString(s.c_str());
+        tagFilter.ToString(gdcm::Tag(0x0008,0x0060), s, sizeof(s));
+        fileModality = QString(s);
 
         /* get patientID */
-        s = sf.ToString(gdcm::Tag(0x0010,0x0020));
-        filePatientID = QString(s.c_str());
+        tagFilter.ToString(gdcm::Tag(0x0010,0x0020), s, sizeof(s));
+        filePatientID = QString(s);
     }
     else {
         /* check if EEG, and Polhemus */
@@ -483,12 +836,11 @@ QString MainWindow::GetDicomModality(QString f)
     if (!r.CanRead()) {
         return "NONDICOM";
     }
-    gdcm::StringFilter sf;
-    sf = gdcm::StringFilter();
-    sf.SetFile(r.GetFile());
-    std::string s = sf.ToString(gdcm::Tag(0x0008,0x0060));
+    tagFilter.SetFile(r.GetFile());
+    char s[256];
+    tagFilter.ToString(gdcm::Tag(0x0008,0x0060), s, sizeof(s));
 
-    QString qs = s.c_str();
+    QString qs = s;
 
     return qs;
 }
@@ -497,18 +849,17 @@ QString MainWindow::GetDicomModality(QString f)
 /* ------------------------------------------------- */
 /* --------- AddFoundFile -------------------------- */
 /* ------------------------------------------------- */
-bool MainWindow::AddFoundFile(QDirIterator *it, QString f, QString fType, QString modality, QString filePatientID)
+bool MainWindow::AddFoundFile(QFileInfo info, QString f, QString fType, QString modality, QString filePatientID)
 {
     qint64 size = 0;
     QString sSize, cDate;
-    QFileInfo info;
 
     /* add this file to the main list */
     files << f;
 
     /* check if its a .par/.rec so the real size can calculated */
     if (fType == "PARREC") {
-        QString recfile = it->filePath();
+        QString recfile = info.filePath();
         //QString parfile = it->filePath();
 
         //WriteLog(QString(".par file path: [%1]").arg(parfile));
@@ -524,7 +875,6 @@ bool MainWindow::AddFoundFile(QDirIterator *it, QString f, QString fType, QStrin
 
         //WriteLog(QString("Old filesize: [%1], New filesize [%2]").arg(s2, s1));
     }
-    info = it->fileInfo();
     size += info.size();
     cDate = info.created().toString();
     sSize = humanReadableSize(size);
@@ -597,8 +947,20 @@ void MainWindow::on_btnUploadAll_clicked()
         return;
     }
 
+    /* a dicom:// connection sends the files to a DICOM node (C-STORE), there is no NiDB instance/project/site or transaction */
+    if (!GetConnectionParms(connServer, connUsername, connPassword))
+        return;
+    bool isDicomDest = DicomSender::IsDicomUrl(connServer);
+    if (isDicomDest && !dicomSender.SetUrl(connServer)) {
+        ShowMessageBox(dicomSender.GetLastError());
+        return;
+    }
+
     /* check the fields before attempting to upload */
-    if (ui->cmbInstanceID->currentData() == "") {
+    if (isDicomDest) {
+        /* nothing to check */
+    }
+    else if (ui->cmbInstanceID->currentData() == "") {
         ShowMessageBox("Instance ID is blank");
         ui->cmbInstanceID->setFocus();
         return;
@@ -614,11 +976,16 @@ void MainWindow::on_btnUploadAll_clicked()
         return;
     }
     /* check if there is a temp dir specified (if needed) */
-    if ((ui->chkRemovePatientBirthDate->isChecked() || ui->chkReplacePatientBirthDate->isChecked() || ui->chkReplacePatientID->isChecked() || ui->chkReplacePatientName->isChecked()) && (ui->txtTmpDir->text() == "")) {
+    if ((ui->chkRemovePatientBirthDate->isChecked() || ui->chkReplacePatientBirthDate->isChecked() || ui->chkReplacePatientID->isChecked() || ui->chkReplacePatientName->isChecked() || ui->chkDeidentify->isChecked()) && (ui->txtTmpDir->text() == "")) {
         ShowMessageBox("Temp dir is blank");
         ui->txtTmpDir->setFocus();
         return;
     }
+    if (ui->chkDeidentify->isChecked() && (ui->txtCertificate->text() == "")) {
+        ShowMessageBox("Certificate is blank");
+        ui->txtCertificate->setFocus();
+        return;
+    }
 
     ui->lblStatus->setText("Starting upload transaction");
     elapsedUploadTime.start();
@@ -642,21 +1009,51 @@ void MainWindow::on_btnUploadAll_clicked()
         isNIFTI = true;
     }
 
+    if (isDicomDest && !isDICOM) {
+        QApplication::restoreOverrideCursor();
+        ShowMessageBox("Only DICOM files can be sent to a DICOM destination");
+        return;
+    }
+
     QVector<int> fileList;
 
     /* start a transaction */
-    StartTransaction();
+    if (isDicomDest) {
+        transactionNumber = 1;
+    }
+    else {
+        StartTransaction();
 
-    /* wait for a valid transaction number */
-    while (transactionNumber <= 0) {
-        QTest::qWait(100);
+        /* wait for a valid transaction number */
+        while (transactionNumber <= 0) {
+            QTest::qWait(100);
+        }
     }
 
     /* this will anonymize and then upload all of the files in the list */
     int rowCount = ui->tableFiles->rowCount();
     int currentUploadSize = 0;
     ui->progTotal->setRange(0,rowCount);
-    for (int i=0; i<rowCount; i++){
+    int i = 0;
+    while (true) {
+
+        /* while receiving, keep on uploading the files as they arrive, until the receiver is stopped */
+        if (i >= rowCount) {
+            if (!dicomReceiver.IsListening())
+                break;
+            if (fileList.size() > 0) {
+                AnonymizeAndUpload(fileList, isDICOM, isPARREC);
+                fileList.clear();
+                currentUploadSize = 0;
+            }
+            ui->lblStatus->setText("Waiting for received files");
+            while ((ui->tableFiles->rowCount() == rowCount) && dicomReceiver.IsListening()) {
+                QTest::qWait(500);
+            }
+            rowCount = ui->tableFiles->rowCount();
+            ui->progTotal->setRange(0,rowCount);
+            continue;
+        }
 
         /* add this item to the list */
         fileList.append(i);
@@ -689,13 +1086,20 @@ void MainWindow::on_btnUploadAll_clicked()
 
         ui->progTotal->setValue(i+1);
         qApp->processEvents();
+        i++;
     }
     /* anonymize and upload the remaining files */
     AnonymizeAndUpload(fileList, isDICOM, isPARREC);
 
     /* end the transaction */
-    EndTransaction();
-    ui->lblStatus->setText("Ending upload transaction");
+    if (isDicomDest) {
+        dicomSender.Close();
+        ui->lblStatus->setText("Finished sending to DICOM destination");
+    }
+    else {
+        EndTransaction();
+        ui->lblStatus->setText("Ending upload transaction");
+    }
 
     QApplication::restoreOverrideCursor();
     WriteLog("Leaving on_btnUploadAll_clicked()");
@@ -725,8 +1129,14 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
     //ui->txtLog->append(QString("Anonymizing %1 files...").arg(list.size()));
     WriteLog(QString("in AnonymizeAndUpload: got list of size %1").arg(list.size()));
 
+    /* with the confidentiality profile, the copies are de-identified together after the loop */
+    bool deidentify = isDICOM && ui->chkDeidentify->isChecked();
+    QStringList deidentifyList;
+
     /* loop through the list of table row numbers, and try to anonymize (if DICOM) and then upload the file */
     ui->progAnon->setRange(0,list.size());
+    QTime stageTime;
+    stageTime.start();
     for (int i=0; i< list.size(); i++) {
         int ii = list[i];
         QString f = ui->tableFiles->item(ii,0)->text();
@@ -740,12 +1150,28 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
         ui->lblStatus->setText("Anonymizing");
 
         if (isDICOM) {
+            /* the search took the files listed in a DICOMDIR on trust */
+            if (dicomdirFiles.contains(f)) {
+                gdcm::Reader check;
+                check.SetFileName(f.toStdString().c_str());
+                if (!check.CanRead()) {
+                    WriteLog(QString("[%1] is listed in a DICOMDIR but is not readable DICOM, skipping it").arg(f));
+                    ui->tableFiles->setItem(ii,1,new QTableWidgetItem("Not readable DICOM"));
+                    numAnonErrors++;
+                    ui->lblNumAnonErrors->setText(QString("%1").arg(numAnonErrors));
+                    ui->progAnon->setValue(i+1);
+                    continue;
+                }
+                dicomdirFiles.remove(f);
+            }
+
             /* copy file to temp dir */
             newFilePath = tmpDir + "/" + GenerateRandomString(15) + ".dcm";
             QFile::copy(f,newFilePath);
             //qDebug("Copying [%s] to [%s]", f.toStdString().c_str(), newFilePath.toStdString().c_str());
             /* add this filepath to the list of files to be uploaded */
             uploadList << newFilePath;
+            uploadRows[newFilePath] = ii;
         }
         else if (isPARREC) {
             /* copy file to temp dir */
@@ -765,29 +1191,32 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
             /* add these filepaths to the list of files to be uploaded */
             uploadList << newPathPar;
             uploadList << newPathRec;
+            uploadRows[newPathPar] = ii;
+            uploadRows[newPathRec] = ii;
         }
         else {
             newFilePath = f;
             /* add this filepath to the list of files to be uploaded */
             uploadList << newFilePath;
+            uploadRows[newFilePath] = ii;
         }
 
         ui->tableFiles->setCurrentCell(ii,0);
         //qDebug("Inside AnonymizeAndUpload loop [%d]",ii);
 
-        if (isDICOM) {
+        if (deidentify) {
+            deidentifyList << newFilePath;
+        }
+        else if (isDICOM) {
             gdcm::Reader r;
             gdcm::File file;
-            gdcm::StringFilter sf;
+            gdcm::StringFilter &sf = tagFilter;
             gdcm::DataSet ds;
             r.SetFileName(newFilePath.toStdString().c_str());
             r.Read();
-            sf = gdcm::StringFilter();
-            sf.SetFile(r.GetFile());
             file = r.GetFile();
             ds = file.GetDataSet();
 
-            sf = gdcm::StringFilter();
             sf.SetFile(r.GetFile());
             std::vector<gdcm::Tag> empty_tags;
             std::vector<gdcm::Tag> remove_tags;
@@ -800,8 +1229,7 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
                 tagVal = tagVal.trimmed();
                 tagVal = tagVal.toLower();
 
-                QByteArray hash = QCryptographicHash::hash(tagVal.toUtf8(), QCryptographicHash::Sha1);
-                QString newTagVal = hash.toHex().toUpper();
+                QString newTagVal = Pseudonym(tagVal);
                 WriteLog(QString("Replacing DICOM PatientName [%1] with [%2]").arg(tagVal.toStdString().c_str()).arg(newTagVal.toStdString().c_str()));
 
                 gdcm::Tag tag;
@@ -817,8 +1245,7 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
                 tagVal = tagVal.trimmed();
                 tagVal = tagVal.toLower();
 
-                QByteArray hash = QCryptographicHash::hash(tagVal.toUtf8(), QCryptographicHash::Sha1);
-                QString newTagVal = hash.toHex().toUpper();
+                QString newTagVal = Pseudonym(tagVal);
 
                 WriteLog(QString("Replacing DICOM PatientID [%1] with [%2]").arg(tagVal.toStdString().c_str()).arg(newTagVal.toStdString().c_str()));
                 //qDebug("Replacing %s with %s",tagVal.toStdString().c_str(),newTagVal.toStdString().c_str());
@@ -953,8 +1380,29 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
         qApp->processEvents();
     }
 
+    if (deidentify) {
+        ui->lblStatus->setText(QString("De-identifying %1 files").arg(deidentifyList.size()));
+        qApp->processEvents();
+        QStringList failed;
+        if (!DeidentifyFileList(deidentifyList, failed)) {
+            /* without the profile, none of the batch may leave */
+            WriteLog("Not uploading the batch, the files could not be de-identified");
+            uploadList.clear();
+            uploadRows.clear();
+        }
+        /* a file still holding patient data is not uploaded */
+        for (int i=0; i<failed.size(); i++) {
+            uploadList.removeAll(failed[i]);
+            uploadRows.remove(failed[i]);
+        }
+    }
+
+    anonMsecs += stageTime.restart();
+    qint64 cpuStart = CpuMsecs();
+
     /* go through the list of files to be uploaded, and upload them as one big batch */
-    totalUploaded += UploadFileList(uploadList);
+    if (!uploadList.isEmpty())
+        totalUploaded += UploadFileList(uploadList);
 
     /* wait for everything to finish before deleting the directory */
     //while (numNetConn > 0) {
@@ -962,6 +1410,44 @@ void MainWindow::AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARR
         QTest::qWait(1000);
     }
 
+    /* send the files the server said it did not store again, and only those, after 1, 2, 4, 8, 16 s */
+    if (!DicomSender::IsDicomUrl(connServer)) {
+        QStringList failed = RetryUploads(uploadList);
+        for (int attempt=0; (attempt < 5) && !failed.isEmpty(); attempt++) {
+            int backoff = 1000 << attempt;
+            WriteLog(QString("Retrying %1 of %2 files in %3 ms").arg(failed.size()).arg(uploadList.size()).arg(backoff));
+            ui->lblStatus->setText(QString("Retrying %1 files").arg(failed.size()));
+            QTest::qWait(backoff);
+
+            for (int i=0; i<failed.size(); i++)
+                numBytesResent += QFileInfo(failed[i]).size();
+            UploadFileList(failed, true);
+            while (isUploading) {
+                QTest::qWait(100);
+            }
+            failed = RetryUploads(failed);
+        }
+        /* what is still not stored failed, sent again or not */
+        failed = FailedUploads(uploadList);
+        for (int i=0; i<failed.size(); i++) {
+            numFilesSentFail++;
+            numBytesSentFail += QFileInfo(failed[i]).size();
+        }
+        ui->lblUploadFilesSentFail->setText(QString("%1").arg(numFilesSentFail));
+    }
+
+    /* the received files are not needed anymore once uploaded, the failed ones stay in the spool directory */
+    for (int i=0; i<list.size(); i++) {
+        int ii = list[i];
+        if (ui->tableFiles->item(ii,1) && (ui->tableFiles->item(ii,1)->text() == "Upload success"))
+            dicomReceiver.RemoveSpooled(ui->tableFiles->item(ii,0)->text());
+    }
+    uploadRows.clear();
+    uploadResults.clear();
+    uploadRetry.clear();
+    uploadMsecs += stageTime.elapsed();
+    uploadCpuMsecs += CpuMsecs() - cpuStart;
+
     /* delete the temp directory */
     if (tmpDir != "") {
         QDir dir(tmpDir);
@@ -1080,7 +1566,9 @@ bool MainWindow::GetConnectionParms(QString &s, QString &u, QString &p)
 /* ------------------------------------------------- */
 /* --------- UploadFileList ------------------------ */
 /* ------------------------------------------------- */
-int MainWindow::UploadFileList(QStringList list)
+/* resend: the files were sent before, they are not  */
+/* counted again                                     */
+int MainWindow::UploadFileList(QStringList list, bool resend)
 {
     WriteLog("Entering UploadFileList()");
     //ui->txtLog->append(QString("Uploading %1 files...").arg(list.size()));
@@ -1089,82 +1577,66 @@ int MainWindow::UploadFileList(QStringList list)
     if (!GetConnectionParms(connServer, connUsername, connPassword)) {
         return 0;
     }
+    if (DicomSender::IsDicomUrl(connServer)) {
+        return UploadFileListDicom(list);
+    }
 
-    numFilesSentTotal += list.count();
-    /* set the last sent statistics */
-    numFilesLastSend = list.count();
-    numBytesLastSend = list.count();
+    if (!resend)
+        numFilesSentTotal += list.count();
 
     QUrl url(connServer + "/api.php");
     QNetworkRequest request(url);
 
-    QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+    /* plain http without a proxy goes straight from the files to the socket (sendfile), everything */
+    /* else is streamed through networkManager. Both are throttled by uploadLimiter                 */
+    bool direct = directUpload && DirectUpload::IsSupported(url) && (GetProxy().type() == QNetworkProxy::NoProxy);
+    UploadBody *body = new UploadBody(direct ? 0 : uploadLimiter);
 
-    QHttpPart loginPart;
     /* username */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
-    loginPart.setBody(connUsername.toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("u", connUsername.toLatin1());
     /* password */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
-    loginPart.setBody(connPassword.toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("p", connPassword.toLatin1());
     /* action */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
-    if (modality == "PARREC") { loginPart.setBody("UploadNonDICOM"); }
-    else if (modality == "EEG") { loginPart.setBody("UploadNonDICOM"); }
-    else { loginPart.setBody("UploadDICOM"); }
-    multiPart->append(loginPart);
+    if (modality == "PARREC") { body->AddField("action", "UploadNonDICOM"); }
+    else if (modality == "EEG") { body->AddField("action", "UploadNonDICOM"); }
+    else { body->AddField("action", "UploadDICOM"); }
     /* instanceid */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"instanceid\""));
-    loginPart.setBody(ui->cmbInstanceID->currentData().toString().toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("instanceid", ui->cmbInstanceID->currentData().toString().toLatin1());
     /* projectid */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"projectid\""));
-    loginPart.setBody(ui->cmbProjectID->currentData().toString().toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("projectid", ui->cmbProjectID->currentData().toString().toLatin1());
     /* siteid */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"siteid\""));
-    loginPart.setBody(ui->cmbSiteID->currentData().toString().toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("siteid", ui->cmbSiteID->currentData().toString().toLatin1());
     /* equipment */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"equipmentid\""));
-    loginPart.setBody(ui->cmbEquipmentID->currentData().toString().toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("equipmentid", ui->cmbEquipmentID->currentData().toString().toLatin1());
     /* transaction number */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"transactionid\""));
-    loginPart.setBody(QString::number(transactionNumber).toLatin1());
-    multiPart->append(loginPart);
+    body->AddField("transactionid", QString::number(transactionNumber).toLatin1());
     WriteLog("TransactionID: " + QString::number(transactionNumber).toLatin1());
     /* matchIDOnly */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"matchidonly\""));
     if (ui->chkMatchIDOnly->isChecked())
-        loginPart.setBody("1");
+        body->AddField("matchidonly", "1");
     else
-        loginPart.setBody("0");
-    multiPart->append(loginPart);
+        body->AddField("matchidonly", "0");
     /* dataformat */
-    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"dataformat\""));
-    if (modality == "DICOM") { loginPart.setBody("dicom"); }
-    else if (modality == "PARREC") { loginPart.setBody("parrec"); }
-    else if (modality == "EEG") { loginPart.setBody("eeg"); }
-    else if (modality == "NIFTI") { loginPart.setBody("nifti"); }
-    else { loginPart.setBody(""); }
-    multiPart->append(loginPart);
+    if (modality == "DICOM") { body->AddField("dataformat", "dicom"); }
+    else if (modality == "PARREC") { body->AddField("dataformat", "parrec"); }
+    else if (modality == "EEG") { body->AddField("dataformat", "eeg"); }
+    else if (modality == "NIFTI") { body->AddField("dataformat", "nifti"); }
+    else { body->AddField("dataformat", ""); }
 
     /* loop through the list of files */
     ui->progUpload->setRange(0,100);
     for (int i=0;i<list.size();i++) {
         //qDebug("UploadFileList [%d] [%s]", i, list[i].toStdString().c_str());
-        QFile *file = new QFile(list[i]);
-        QHttpPart filePart;
-        filePart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"files[]\"; filename=\""+ file->fileName() + "\""));
-
-        file->open(QIODevice::ReadOnly);
-        filePart.setBodyDevice(file);
-        file->setParent(multiPart); // we cannot delete the file now, so delete it with the multiPart
-        multiPart->append(filePart);
+        /* not acknowledged by the server, so it counts as failed */
+        if (!body->AddFile("files[]", list[i]))
+            WriteLog("Unable to open [" + list[i] + "] for upload");
     }
+    /* checksums of the files, computed as they are sent */
+    body->AddManifest("manifest");
+    body->open(QIODevice::ReadOnly);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, body->GetContentType());
+    request.setHeader(QNetworkRequest::ContentLengthHeader, body->size());
+    request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
 
     while (isUploading) {
         //qDebug("Waiting for current transfers to stop. numNetConn: [%d]", numNetConn);
@@ -1178,14 +1650,23 @@ int MainWindow::UploadFileList(QStringList list)
         QTest::qWait(1000);
     }
 
-    //networkManager = new QNetworkAccessManager(this);
-    QNetworkReply* reply = networkManager->post(request, multiPart);
-    multiPart->setParent(reply); // delete the multiPart with the reply
+    if (direct) {
+        DirectUpload *upload = new DirectUpload(url, body, uploadLimiter); // deletes the body
+        connect(upload, SIGNAL(finished()), this, SLOT(onDirectUploadFinished()));
+        connect(upload, SIGNAL(Progress(qint64, qint64)), SLOT(progressChanged(qint64, qint64)));
+        upload->start();
+    }
+    else {
+        //networkManager = new QNetworkAccessManager(this);
+        QNetworkReply* reply = networkManager->post(request, body);
+        body->setParent(reply); // delete the body with the reply
+        connect(reply, SIGNAL(finished()), this, SLOT(onGetReplyUpload()));
+        connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(onNetworkError(QNetworkReply::NetworkError)));
+        connect(reply, SIGNAL(uploadProgress(qint64, qint64)), SLOT(progressChanged(qint64, qint64)));
+    }
+    lastSentList = list;
     numNetConn++;
     isUploading = true;
-    connect(reply, SIGNAL(finished()), this, SLOT(onGetReplyUpload()));
-    connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(onNetworkError(QNetworkReply::NetworkError)));
-    connect(reply, SIGNAL(uploadProgress(qint64, qint64)), SLOT(progressChanged(qint64, qint64)));
 
     WriteLog(QString("Finished queueing %1 files for upload...").arg(list.size()));
     //ui->txtLog->append(QString("Finished queueing %1 files for upload...").arg(list.size()));
@@ -1199,6 +1680,56 @@ int MainWindow::UploadFileList(QStringList list)
 }
 
 
+/* ------------------------------------------------- */
+/* --------- UploadFileListDicom ------------------- */
+/* ------------------------------------------------- */
+/* send the files with C-STORE. This is synchronous, */
+/* and the association stays open for the next list  */
+int MainWindow::UploadFileListDicom(QStringList list)
+{
+    WriteLog("Entering UploadFileListDicom()");
+
+    numFilesSentTotal += list.count();
+    ui->lblStatus->setText(QString("Sending %1 files to DICOM destination").arg(list.size()));
+    qApp->processEvents();
+
+    QVector<quint16> statuses;
+    int numStored = dicomSender.Send(list, statuses);
+    if (numStored < list.size())
+        WriteLog("UploadFileListDicom: " + dicomSender.GetLastError());
+
+    QBrush colorGreen(Qt::green);
+    QBrush colorRed(Qt::red);
+    for (int i=0; i<list.size(); i++) {
+        qint64 size = QFileInfo(list[i]).size();
+        bool stored = DicomSender::IsStored(statuses[i]);
+        if (stored) {
+            numFilesSentSuccess++;
+            numBytesSentSuccess += size;
+        }
+        else {
+            numFilesSentFail++;
+            numBytesSentFail += size;
+            WriteLog(QString("C-STORE of [%1] failed, status 0x%2").arg(list[i]).arg(statuses[i], 4, 16, QChar('0')));
+        }
+        /* one file per table row for DICOM */
+        if (i < lastUploadList.count()) {
+            int ii = lastUploadList[i];
+            ui->tableFiles->item(ii,1)->setForeground(stored ? colorGreen : colorRed);
+            ui->tableFiles->item(ii,1)->setText(stored ? "Upload success" : "Upload fail");
+        }
+    }
+    ui->lblUploadFilesSentSuccess->setText(QString("%1").arg(numFilesSentSuccess));
+    ui->lblUploadFilesSentFail->setText(QString("%1").arg(numFilesSentFail));
+
+    /* update the elapsed time */
+    ui->lblUploadElapsed->setText(QString("%1").arg(timeConversion(elapsedUploadTime.elapsed())));
+
+    WriteLog("Leaving UploadFileListDicom()");
+    return numStored;
+}
+
+
 /* ------------------------------------------------- */
 /* --------- progressChanged ----------------------- */
 /* ------------------------------------------------- */
@@ -1248,14 +1779,99 @@ QString MainWindow::GenerateRandomString(int len)
 
 
 /* ------------------------------------------------- */
-/* --------- SetTempDir ---------------------------- */
+/* --------- Pseudonym ----------------------------- */
 /* ------------------------------------------------- */
-void MainWindow::SetTempDir()
+/* SHA1 of the value, as before, or HMAC-SHA256 when */
+/* a pseudonym key is set, so that the pseudonyms    */
+/* cannot be recomputed from a list of names. 40 or  */
+/* 64 uppercase hex digits, both fit in LO and PN    */
+QString MainWindow::Pseudonym(QString value)
 {
-    if (ui->chkRemovePatientBirthDate->isChecked() || ui->chkReplacePatientBirthDate->isChecked() || ui->chkReplacePatientID->isChecked() || ui->chkReplacePatientName->isChecked()) {
-        ui->txtTmpDir->setEnabled(true);
-        //#ifdef W_OS_WIN32
-            ui->txtTmpDir->setText("C:/temp");
+    QByteArray val = value.toUtf8();
+    QByteArray key = ui->txtPseudonymKey->text().toUtf8();
+    char digest[2*32+1];
+    bool ok;
+    if (key.isEmpty())
+        ok = gdcm::SHA1::Compute(val.constData(), val.size(), digest);
+    else
+        ok = gdcm::SHA256::ComputeHMAC(key.constData(), key.size(), val.constData(), val.size(), digest);
+
+    /* SHA1::Compute refuses an empty value */
+    if (!ok)
+        return QString(QCryptographicHash::hash(val, QCryptographicHash::Sha1).toHex().toUpper());
+
+    return QString(digest).toUpper();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- DeidentifyFileList -------------------- */
+/* ------------------------------------------------- */
+/* Basic Application Level Confidentiality Profile,  */
+/* in place, all the files of the batch at once so   */
+/* the replaced UIDs stay consistent across them.    */
+/* The files are spread over the processors. failed  */
+/* gets the files not de-identified. Returns false,  */
+/* with all of list failed, when the profile cannot  */
+/* run (no Part3.xml or certificate)                 */
+bool MainWindow::DeidentifyFileList(QStringList list, QStringList &failed)
+{
+    WriteLog(QString("De-identifying %1 files").arg(list.size()));
+
+    /* the profile is driven by the IODs of Part3.xml */
+    gdcm::Global &g = gdcm::Global::GetInstance();
+    if (g.GetDefs().IsEmpty() && !g.LoadResourcesFiles()) {
+        WriteLog("Unable to load the GDCM resources (Part3.xml), set GDCM_RESOURCES_PATH");
+        for (int i=0; i<list.size(); i++)
+            ui->tableFiles->setItem(uploadRows[list[i]],1,new QTableWidgetItem("Error anonymizing"));
+        failed = list;
+        return false;
+    }
+
+    gdcm::CryptoFactory *factory = gdcm::CryptoFactory::GetFactoryInstance();
+    gdcm::CryptographicMessageSyntax *cms = factory ? factory->CreateCMSProvider() : NULL;
+    if (!cms || !cms->ParseCertificateFile(ui->txtCertificate->text().toStdString().c_str())) {
+        WriteLog("Unable to use the certificate [" + ui->txtCertificate->text() + "]");
+        for (int i=0; i<list.size(); i++)
+            ui->tableFiles->setItem(uploadRows[list[i]],1,new QTableWidgetItem("Error anonymizing"));
+        delete cms;
+        failed = list;
+        return false;
+    }
+
+    std::vector<std::string> filenames;
+    for (int i=0; i<list.size(); i++)
+        filenames.push_back(list[i].toStdString());
+
+    gdcm::SeriesAnonymizer sa;
+    sa.SetCryptographicMessageSyntax(cms);
+    sa.Anonymize(filenames);
+    for (int i=0; i<list.size(); i++) {
+        if (sa.IsAnonymized(i)) {
+            ui->tableFiles->setItem(uploadRows[list[i]],1,new QTableWidgetItem("Anonymized"));
+        }
+        else {
+            WriteLog("Unable to de-identify [" + list[i] + "]");
+            ui->tableFiles->setItem(uploadRows[list[i]],1,new QTableWidgetItem("Error anonymizing"));
+            failed << list[i];
+        }
+    }
+    delete cms;
+
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SetTempDir ---------------------------- */
+/* ------------------------------------------------- */
+void MainWindow::SetTempDir()
+{
+    ui->txtCertificate->setEnabled(ui->chkDeidentify->isChecked());
+    if (ui->chkRemovePatientBirthDate->isChecked() || ui->chkReplacePatientBirthDate->isChecked() || ui->chkReplacePatientID->isChecked() || ui->chkReplacePatientName->isChecked() || ui->chkDeidentify->isChecked()) {
+        ui->txtTmpDir->setEnabled(true);
+        //#ifdef W_OS_WIN32
+            ui->txtTmpDir->setText("C:/temp");
         //#endif
         //#ifdef W_OS_LINUX
         //    ui->txtTmpDir->setText("/tmp");
@@ -1271,15 +1887,31 @@ void MainWindow::on_chkReplacePatientName_clicked() { SetTempDir(); }
 void MainWindow::on_chkReplacePatientID_clicked() { SetTempDir(); }
 void MainWindow::on_chkReplacePatientBirthDate_clicked() { SetTempDir(); }
 void MainWindow::on_chkRemovePatientBirthDate_clicked() { SetTempDir(); }
+void MainWindow::on_chkDeidentify_clicked() { SetTempDir(); }
 
 
 /* ------------------------------------------------- */
 /* --------- on_lstConn_clicked -------------------- */
 /* ------------------------------------------------- */
+/* opens the session: connects to the server and     */
+/* loads the lists not depending on the instance,    */
+/* all at once                                       */
 void MainWindow::on_lstConn_clicked(const QModelIndex &index)
 {
     index;
     ui->lblConnMessage->setText("");
+
+    if (!GetConnectionParms(connServer, connUsername, connPassword) || DicomSender::IsDicomUrl(connServer))
+        return;
+    metadata->SetServer(connServer, connUsername, connPassword, GetProxy());
+    connectTime.start();
+    connecting = true;
+    metadata->Prepare();
+    metadata->Get("getInstanceList");
+    metadata->Get("getEquipmentList");
+    /* all cached */
+    if (!metadata->IsBusy())
+        onMetadataFinished();
 }
 
 
@@ -1293,341 +1925,98 @@ void MainWindow::on_btnRemoveConn_clicked()
 
 
 /* ------------------------------------------------- */
-/* --------- on_btnLoadInstanceIDs_clicked --------- */
+/* --------- LoadMetadata -------------------------- */
 /* ------------------------------------------------- */
-void MainWindow::on_btnLoadInstanceIDs_clicked()
+/* one api.php lookup for the selected connection,   */
+/* refresh skips the cached answer                   */
+void MainWindow::LoadMetadata(QString action, bool refresh)
 {
-    networkManager->setProxy(GetProxy());
-    /* get list of instances through the API */
-
     if (ui->lstConn->count() < 1) {
         ShowMessageBox("No connections available");
     }
     else if (ui->lstConn->selectedItems().length() < 1) {
         ShowMessageBox("No connection selected");
     }
-    else {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        if (GetConnectionParms(connServer, connUsername, connPassword)) {
-            QUrl url(connServer + "/api.php");
-            QNetworkRequest request(url);
-            QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-            QHttpPart loginPart;
-            /* username */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
-            loginPart.setBody(connUsername.toLatin1()); multiPart->append(loginPart);
-            /* password */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
-            loginPart.setBody(connPassword.toLatin1()); multiPart->append(loginPart);
-            /* action */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
-            loginPart.setBody("getInstanceList"); multiPart->append(loginPart);
-
-            //networkManager = new QNetworkAccessManager(this);
-            QNetworkReply* reply = networkManager->post(request, multiPart);
-            multiPart->setParent(reply); // delete the multiPart with the reply
-            connect(reply, SIGNAL(finished()), this, SLOT(onGetReplyInstanceList()));
-            QApplication::restoreOverrideCursor();
-        }
+    else if (GetConnectionParms(connServer, connUsername, connPassword)) {
+        metadata->SetServer(connServer, connUsername, connPassword, GetProxy());
+        QString instance;
+        if ((action == "getProjectList") || (action == "getSiteList"))
+            instance = ui->cmbInstanceID->currentData().toString();
+        metadata->Get(action, instance, refresh);
     }
 }
 
 
 /* ------------------------------------------------- */
-/* --------- on_btnLoadProjectIDs_clicked ---------- */
+/* --------- on_btnLoad*IDs_clicked ---------------- */
 /* ------------------------------------------------- */
-void MainWindow::on_btnLoadProjectIDs_clicked()
-{
-    networkManager->setProxy(GetProxy());
-    /* get list of instances through the API */
-    if (ui->lstConn->count() < 1) {
-        ShowMessageBox("No connections available");
-    }
-    else if (ui->lstConn->selectedItems().length() < 1) {
-        ShowMessageBox("No connection selected");
-    }
-    else {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        if (GetConnectionParms(connServer, connUsername, connPassword)) {
-            QUrl url(connServer + "/api.php");
-            QNetworkRequest request(url);
-            QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-            QHttpPart loginPart;
-            /* username */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
-            loginPart.setBody(connUsername.toLatin1()); multiPart->append(loginPart);
-            /* password */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
-            loginPart.setBody(connPassword.toLatin1()); multiPart->append(loginPart);
-            /* action */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
-            loginPart.setBody("getProjectList"); multiPart->append(loginPart);
-            /* instance */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"instance\""));
-            loginPart.setBody(ui->cmbInstanceID->currentData().toString().toLatin1()); multiPart->append(loginPart);
-
-            //networkManager = new QNetworkAccessManager(this);
-            QNetworkReply* reply = networkManager->post(request, multiPart);
-            multiPart->setParent(reply); // delete the multiPart with the reply
-            connect(reply, SIGNAL(finished()), this, SLOT(onGetReplyProjectList()));
-            QApplication::restoreOverrideCursor();
-        }
-    }
-}
-
-
-/* ------------------------------------------------- */
-/* --------- on_btnLoadSiteIDs_clicked ------------- */
-/* ------------------------------------------------- */
-void MainWindow::on_btnLoadSiteIDs_clicked()
-{
-    networkManager->setProxy(GetProxy());
-    /* get list of instances through the API */
-
-    if (ui->lstConn->count() < 1) {
-        ShowMessageBox("No connections available");
-    }
-    else if (ui->lstConn->selectedItems().length() < 1) {
-        ShowMessageBox("No connection selected");
-    }
-    else {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        if (GetConnectionParms(connServer, connUsername, connPassword)) {
-            QUrl url(connServer + "/api.php");
-            QNetworkRequest request(url);
-            QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-            QHttpPart loginPart;
-            /* username */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
-            loginPart.setBody(connUsername.toLatin1()); multiPart->append(loginPart);
-            /* password */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
-            loginPart.setBody(connPassword.toLatin1()); multiPart->append(loginPart);
-            /* action */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
-            loginPart.setBody("getSiteList"); multiPart->append(loginPart);
-            /* instance */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"instance\""));
-            loginPart.setBody(ui->cmbInstanceID->currentData().toString().toLatin1()); multiPart->append(loginPart);
-
-            //networkManager = new QNetworkAccessManager(this);
-            QNetworkReply* reply = networkManager->post(request, multiPart);
-            multiPart->setParent(reply); // delete the multiPart with the reply
-            connect(reply, SIGNAL(finished()), this, SLOT(onGetReplySiteList()));
-            QApplication::restoreOverrideCursor();
-        }
-    }
-}
+/* an explicit reload, never from the cache          */
+void MainWindow::on_btnLoadInstanceIDs_clicked() { LoadMetadata("getInstanceList", true); }
+void MainWindow::on_btnLoadProjectIDs_clicked() { LoadMetadata("getProjectList", true); }
+void MainWindow::on_btnLoadSiteIDs_clicked() { LoadMetadata("getSiteList", true); }
+void MainWindow::on_btnLoadEquipmentIDs_clicked() { LoadMetadata("getEquipmentList", true); }
 
 
 /* ------------------------------------------------- */
-/* --------- on_btnLoadEquipmentIDs_clicked -------- */
+/* --------- onMetadataLoaded ---------------------- */
 /* ------------------------------------------------- */
-void MainWindow::on_btnLoadEquipmentIDs_clicked()
+void MainWindow::onMetadataLoaded(QString action, QString instance, QString response)
 {
-    networkManager->setProxy(GetProxy());
-    /* get list of instances through the API */
-
-    if (ui->lstConn->count() < 1) {
-        ShowMessageBox("No connections available");
-    }
-    else if (ui->lstConn->selectedItems().length() < 1) {
-        ShowMessageBox("No connection selected");
-    }
-    else {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-        if (GetConnectionParms(connServer, connUsername, connPassword)) {
-            QUrl url(connServer + "/api.php");
-            QNetworkRequest request(url);
-            QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-            QHttpPart loginPart;
-            /* username */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
-            loginPart.setBody(connUsername.toLatin1()); multiPart->append(loginPart);
-            /* password */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
-            loginPart.setBody(connPassword.toLatin1()); multiPart->append(loginPart);
-            /* action */
-            loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
-            loginPart.setBody("getEquipmentList"); multiPart->append(loginPart);
-
-            //networkManager = new QNetworkAccessManager(this);
-            QNetworkReply* reply = networkManager->post(request, multiPart);
-            multiPart->setParent(reply); // delete the multiPart with the reply
-            connect(reply, SIGNAL(finished()), this, SLOT(onGetReplyEquipmentList()));
-            QApplication::restoreOverrideCursor();
-        }
-    }
-
-}
-
-
-/* ------------------------------------------------- */
-/* --------- onGetReplyInstanceList ---------------- */
-/* ------------------------------------------------- */
-void MainWindow::onGetReplyInstanceList()
-{
-    //qDebug() << "numNetConn (A): " << numNetConn;
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    QString response;
-    if (reply) {
-        if (reply->error() == QNetworkReply::NoError) {
-            const int available = reply->bytesAvailable();
-            if (available > 0) {
-                const QByteArray buffer(reply->readAll());
-                response = QString::fromUtf8(buffer);
-            }
-        } else {
-            response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
-        }
-        reply->deleteLater();
-    }
-
-    if (response.trimmed().isEmpty()) { response = tr("No instances available"); }
-    //ui->txtLog->append(response + "\n");
-
-    QStringList listItems;
-    ui->cmbInstanceID->clear();
-    listItems << response.split(",");
-
-    for (int i=0; i<listItems.size(); i++) {
-        QStringList parts;
-        parts << listItems[i].split("|");
-        if (parts.length() > 1) {
-            ui->cmbInstanceID->addItem(QString(parts[0] + " - " + parts[1]), parts[0]);
-        }
-        else {
-            ui->cmbInstanceID->addItem(parts[0], parts[0]);
-        }
-    }
-}
-
-
-/* ------------------------------------------------- */
-/* --------- onGetReplyProjectList ----------------- */
-/* ------------------------------------------------- */
-void MainWindow::onGetReplyProjectList()
-{
-    //qDebug() << "numNetConn (A): " << numNetConn;
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    QString response;
-    if (reply) {
-        if (reply->error() == QNetworkReply::NoError) {
-            const int available = reply->bytesAvailable();
-            if (available > 0) {
-                const QByteArray buffer(reply->readAll());
-                response = QString::fromUtf8(buffer);
-            }
-        } else {
-            response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
-        }
-        reply->deleteLater();
+    if (action == "getInstanceList") {
+        PopulateList(ui->cmbInstanceID, response, tr("No instances available"));
+    }
+    else if ((action == "getProjectList") || (action == "getSiteList")) {
+        /* the instance was changed since */
+        if (instance != ui->cmbInstanceID->currentData().toString())
+            return;
+        if (action == "getProjectList")
+            PopulateList(ui->cmbProjectID, response, tr("No projects within this instance"));
+        else
+            PopulateList(ui->cmbSiteID, response, tr("No sites available"));
     }
-
-    if (response.trimmed().isEmpty()) { response = tr("No projects within this instance"); }
-    //ui->txtLog->append(response + "\n");
-
-    /* parse the returned string and populate the drop down menu */
-    QStringList listItems;
-    ui->cmbProjectID->clear();
-    listItems << response.split(",");
-
-    for (int i=0; i<listItems.size(); i++) {
-        QStringList parts;
-        parts << listItems[i].split("|");
-        if (parts.length() > 1) {
-            ui->cmbProjectID->addItem(QString(parts[0] + " - " + parts[1]), parts[0]);
-        }
-        else {
-            ui->cmbProjectID->addItem(parts[0], parts[0]);
-        }
+    else if (action == "getEquipmentList") {
+        WriteLog(response.trimmed().isEmpty() ? tr("No equipment available") : response);
+        PopulateList(ui->cmbEquipmentID, response, tr("No equipment available"));
     }
 }
 
 
 /* ------------------------------------------------- */
-/* --------- onGetReplySiteList -------------------- */
+/* --------- onMetadataFinished -------------------- */
 /* ------------------------------------------------- */
-void MainWindow::onGetReplySiteList()
+void MainWindow::onMetadataFinished()
 {
-    //qDebug() << "numNetConn (A): " << numNetConn;
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    QString response;
-    if (reply) {
-        if (reply->error() == QNetworkReply::NoError) {
-            const int available = reply->bytesAvailable();
-            if (available > 0) {
-                const QByteArray buffer(reply->readAll());
-                response = QString::fromUtf8(buffer);
-            }
-        } else {
-            response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
-        }
-        reply->deleteLater();
-    }
-
-    if (response.trimmed().isEmpty()) { response = tr("No sites available"); }
-    //ui->txtLog->append(response + "\n");
-
-    /* parse the returned string and populate the drop down menu */
-    QStringList listItems;
-    ui->cmbSiteID->clear();
-    listItems << response.split(",");
-
-    for (int i=0; i<listItems.size(); i++) {
-        QStringList parts;
-        parts << listItems[i].split("|");
-        if (parts.length() > 1) {
-            ui->cmbSiteID->addItem(QString(parts[0] + " - " + parts[1]), parts[0]);
-        }
-        else {
-            ui->cmbSiteID->addItem(parts[0], parts[0]);
-        }
-    }
+    if (!connecting)
+        return;
+    connecting = false;
+    WriteLog(QString("Connection ready in %1 ms").arg(connectTime.elapsed()));
 }
 
 
 /* ------------------------------------------------- */
-/* --------- onGetReplyEquipmentList --------------- */
+/* --------- PopulateList -------------------------- */
 /* ------------------------------------------------- */
-void MainWindow::onGetReplyEquipmentList()
+/* parse the returned "id|name,id|name" string and   */
+/* populate the drop down menu                       */
+void MainWindow::PopulateList(QComboBox *cmb, QString response, QString emptyMsg)
 {
-    //qDebug() << "numNetConn (A): " << numNetConn;
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-    QString response;
-    if (reply) {
-        if (reply->error() == QNetworkReply::NoError) {
-            const int available = reply->bytesAvailable();
-            if (available > 0) {
-                const QByteArray buffer(reply->readAll());
-                response = QString::fromUtf8(buffer);
-            }
-        } else {
-            response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
-        }
-        reply->deleteLater();
+    cmb->clear();
+    if (response.trimmed().isEmpty()) {
+        cmb->addItem(emptyMsg, "");
+        return;
     }
 
-    if (response.trimmed().isEmpty()) { response = tr("No equipment available"); }
-    WriteLog(response);
-
-    /* parse the returned string and populate the drop down menu */
     QStringList listItems;
-    ui->cmbEquipmentID->clear();
     listItems << response.split(",");
 
     for (int i=0; i<listItems.size(); i++) {
         QStringList parts;
         parts << listItems[i].split("|");
         if (parts.length() > 1) {
-            ui->cmbEquipmentID->addItem(QString(parts[0] + " - " + parts[1]), parts[0]);
+            cmb->addItem(QString(parts[0] + " - " + parts[1]), parts[0]);
         }
         else {
-            ui->cmbEquipmentID->addItem(parts[0], parts[0]);
+            cmb->addItem(parts[0], parts[0]);
         }
     }
 }
@@ -1787,10 +2176,14 @@ void MainWindow::onGetReplyEndTransaction()
 /* ------------------------------------------------- */
 /* --------- on_cmbInstanceID_currentIndexChanged -- */
 /* ------------------------------------------------- */
+/* the project and site lists of the instance,      */
+/* together                                          */
 void MainWindow::on_cmbInstanceID_currentIndexChanged(int index)
 {
-    index;
-    on_btnLoadProjectIDs_clicked();
+    if ((index < 0) || ui->cmbInstanceID->currentData().toString().isEmpty())
+        return;
+    metadata->Get("getProjectList", ui->cmbInstanceID->currentData().toString());
+    metadata->Get("getSiteList", ui->cmbInstanceID->currentData().toString());
 }
 
 
@@ -1876,6 +2269,24 @@ void MainWindow::on_chkUseProxy_clicked()
 }
 
 
+/* ------------------------------------------------- */
+/* --------- on_txtUploadLimit_editingFinished ----- */
+/* ------------------------------------------------- */
+/* takes effect immediately, uploads in progress too */
+void MainWindow::on_txtUploadLimit_editingFinished()
+{
+    QString schedule = ui->txtUploadLimit->text();
+    if (schedule.trimmed() == uploadLimiter->GetSchedule())
+        return;
+    if (!uploadLimiter->SetSchedule(schedule)) {
+        ShowMessageBox("Invalid upload limit [" + schedule + "]. Expecting a rate (5M, 500K, 250000) or ranges like 07:00-19:00=5M,20M");
+        ui->txtUploadLimit->setText(uploadLimiter->GetSchedule());
+        return;
+    }
+    WriteLog("Upload limit set to [" + uploadLimiter->GetSchedule() + "]");
+}
+
+
 /* ------------------------------------------------- */
 /* --------- GetProxy ------------------------------ */
 /* ------------------------------------------------- */
@@ -1921,3 +2332,135 @@ void MainWindow::WriteLog(QString msg)
     out << "[" << QTime::currentTime().toString() << "] " << msg << endl;
     qDebug() << msg;
 }
+
+
+/* ------------------------------------------------- */
+/* --------- RunBenchmark -------------------------- */
+/* ------------------------------------------------- */
+/* NiDBUploader --benchmark [files [size_kb          */
+/*   [latency_ms [bandwidth_kBps [error_pct          */
+/*   [file_error_pct [upload_limit [direct]]]]]]]]   */
+/* fills in the form, then scans, anonymizes and     */
+/* uploads synthetic DICOM files to a local          */
+/* MockApiServer, and prints the time of each stage  */
+int MainWindow::RunBenchmark(QStringList args)
+{
+    int numFiles = (args.size() > 0) ? args[0].toInt() : 500;
+    int sizeKB = (args.size() > 1) ? args[1].toInt() : 512;
+    int latency = (args.size() > 2) ? args[2].toInt() : 0;
+    int bandwidthKB = (args.size() > 3) ? args[3].toInt() : 0;
+    int errorPct = (args.size() > 4) ? args[4].toInt() : 0;
+    int fileErrorPct = (args.size() > 5) ? args[5].toInt() : 0;
+    QString uploadLimit = (args.size() > 6) ? args[6] : "";
+    /* 0 to compare with the QNetworkAccessManager upload */
+    directUpload = (args.size() > 7) ? (args[7].toInt() != 0) : true;
+    if ((numFiles < 1) || (sizeKB < 1))
+        return 1;
+
+    QTextStream out(stdout);
+    QString baseDir = QDir::tempPath() + "/NiDBUploaderBenchmark-" + GenerateRandomString(8);
+    QString error;
+    out << QString("%1 files of %2 KB, latency %3 ms, bandwidth %4 KB/s, errors %5%, file errors %6%, upload limit [%7]").arg(numFiles).arg(sizeKB).arg(latency).arg(bandwidthKB).arg(errorPct).arg(fileErrorPct).arg(uploadLimit) << endl;
+    if (!FakeDicom::Generate(baseDir + "/data", numFiles, sizeKB, error)) {
+        out << error << endl;
+        return 1;
+    }
+
+    MockApiServer server;
+    server.SetLatency(latency);
+    server.SetBandwidth((qint64)bandwidthKB * 1024);
+    server.SetErrorRate(errorPct / 100.0);
+    server.SetFileErrorRate(fileErrorPct / 100.0);
+    if (!server.Start()) {
+        out << "Unable to start the mock server" << endl;
+        return 1;
+    }
+
+    /* the form, as a user would fill it in */
+    ui->chkUseProxy->setChecked(false);
+    ui->lstConn->addItem(server.GetUrl() + ",benchmark,benchmark");
+    ui->lstConn->setCurrentRow(ui->lstConn->count() - 1);
+    ui->cmbModality->setCurrentIndex(ui->cmbModality->findData("DICOM"));
+    ui->txtDataDir->setText(baseDir + "/data");
+    ui->txtTmpDir->setText(baseDir + "/tmp");
+    ui->chkReplacePatientName->setChecked(true);
+    ui->chkReplacePatientID->setChecked(true);
+    ui->chkReplacePatientBirthDate->setChecked(true);
+    ui->txtUploadLimit->setText(uploadLimit);
+    if (!uploadLimiter->SetSchedule(uploadLimit)) {
+        out << "Invalid upload limit [" << uploadLimit << "]" << endl;
+        return 1;
+    }
+
+    QTime stageTime;
+    stageTime.start();
+    /* connect: the instance, project, site and equipment lists */
+    on_lstConn_clicked(QModelIndex());
+    while (connecting)
+        QTest::qWait(1);
+    int connectMsecs = stageTime.restart();
+
+    scanDirIter(QDir(ui->txtDataDir->text()));
+    int scanMsecs = stageTime.restart();
+
+    anonMsecs = 0;
+    uploadMsecs = 0;
+    uploadCpuMsecs = 0;
+    on_btnUploadAll_clicked();
+    /* EndTransaction does not wait for its answer */
+    while (server.GetNumberOfEndedTransactions() < 1)
+        QTest::qWait(1);
+    int uploadAllMsecs = qMax(stageTime.elapsed(), 1);
+    int totalMsecs = connectMsecs + scanMsecs + uploadAllMsecs;
+
+    QStringList report;
+    report << QString("found %1 files, %2 uploaded, %3 failed, %4 MB stored, %5 MB resent, %6 requests")
+              .arg(numFilesFound).arg(numFilesSentSuccess).arg(numFilesSentFail)
+              .arg(server.GetNumberOfBytes() / 1048576.0, 0, 'f', 1)
+              .arg(numBytesResent / 1048576.0, 0, 'f', 1).arg(server.GetNumberOfRequests());
+    report << QString("connect %1 ms, scan %2 ms, anonymize %3 ms, upload %4 ms, transactions and waits %5 ms, total %6 ms")
+              .arg(connectMsecs).arg(scanMsecs).arg(anonMsecs).arg(uploadMsecs)
+              .arg(uploadAllMsecs - anonMsecs - uploadMsecs).arg(totalMsecs);
+    report << QString("%1 files/s, %2 MB/s")
+              .arg(numFilesSentSuccess * 1000.0 / totalMsecs, 0, 'f', 1)
+              .arg(server.GetNumberOfBytes() * 1000.0 / 1048576.0 / totalMsecs, 0, 'f', 2);
+    /* the mock server runs in this process, its share is the same with either transport */
+    report << QString("%1 upload, %2 ms CPU, %3 ms CPU/GB")
+              .arg(directUpload ? "direct" : "Qt").arg(uploadCpuMsecs)
+              .arg(uploadCpuMsecs * 1073741824.0 / qMax(server.GetNumberOfBytesReceived(), (qint64)1), 0, 'f', 0);
+    /* the limit is on the whole request bodies, the server only counts the files in them */
+    qint64 limit = uploadLimiter->GetRate(QTime::currentTime());
+    qint64 achieved = server.GetUploadRate();
+    if (limit > 0)
+        report << QString("upload limit %1 KB/s, achieved %2 KB/s (%3%)")
+                  .arg(limit / 1024).arg(achieved / 1024).arg(achieved * 100 / limit);
+    for (int i=0; i<report.size(); i++) {
+        out << report[i] << endl;
+        WriteLog("Benchmark: " + report[i]);
+    }
+
+    QDir(baseDir).removeRecursively();
+    /* without injected errors, every file must have made it */
+    if ((errorPct == 0) && (fileErrorPct == 0) && (numFilesSentSuccess != numFiles))
+        return 1;
+    /* nor gone over the limit, give or take a tick */
+    return ((limit > 0) && (achieved > limit * 11 / 10)) ? 1 : 0;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- CpuMsecs ------------------------------ */
+/* ------------------------------------------------- */
+/* user + system time of the process so far, 0 where */
+/* it is not known                                   */
+qint64 MainWindow::CpuMsecs()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (qint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+#else
+    return 0;
+#endif
+}
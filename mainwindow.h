@@ -21,17 +21,38 @@
 #include "gdcmWriter.h"
 #include "gdcmAttribute.h"
 #include "gdcmStringFilter.h"
+#include "gdcmDICOMDIR.h"
 #include "gdcmAnonymizer.h"
+#include "gdcmSeriesAnonymizer.h"
+#include "gdcmCryptoFactory.h"
+#include "gdcmGlobal.h"
+#include "gdcmDefs.h"
+#include "gdcmSHA1.h"
+#include "gdcmSHA256.h"
+#include "dicomsender.h"
+#include "dicomreceiver.h"
+#include "metadataclient.h"
+#include "ratelimiter.h"
+#include "uploadbody.h"
+#include "directupload.h"
+#include "mockapiserver.h"
+#include "fakedicom.h"
 #include <QTest>
 #include <QSignalMapper>
 #include <QDateTime>
 #include <QNetworkProxy>
+#include <QTimer>
+#include <QComboBox>
+#include <QSet>
 
 #ifdef _WIN32_
     #include <cstdlib>
 #elif __linux
     #include <unistd.h>
 #endif
+#ifdef Q_OS_UNIX
+    #include <sys/resource.h>
+#endif
 
 /* this supposedly will make the program run on WinXP */
 //#include <QtPlugin>
@@ -53,16 +74,29 @@ public:
 
     void PopulateConnectionList();
     void scanDirIter(QDir dir);
+    void AddScannedFiles(QList<QFileInfo> const &found, QHash<QString, gdcm::DICOMDIR::FileRecord> const &listed);
+    bool ReadDicomDir(QString f, QHash<QString, gdcm::DICOMDIR::FileRecord> &records);
     void GetFileType(QString f, QString &fileType, QString &fileModality, QString &filePatientID);
     bool GetConnectionParms(QString &s, QString &u, QString &p);
     QString GetDicomModality(QString f);
-    bool AddFoundFile(QDirIterator *it, QString f, QString fType, QString modality, QString filePatientID);
+    bool AddFoundFile(QFileInfo info, QString f, QString fType, QString modality, QString filePatientID);
+    void ToggleReceiver();
+    void AddReceivedFiles();
     QString GenerateRandomString(int len);
     void AnonymizeAndUpload(QVector<int> list, bool isDICOM, bool isPARREC);
     bool AnonymizeOneFileDumb(gdcm::Anonymizer &anon, const char *filename, const char *outfilename, std::vector<gdcm::Tag> const &empty_tags, std::vector<gdcm::Tag> const &remove_tags, std::vector< std::pair<gdcm::Tag, std::string> > const & replace_tags, bool continuemode = false);
-    int UploadFileList(QStringList list);
+    bool DeidentifyFileList(QStringList list, QStringList &failed);
+    QString Pseudonym(QString value);
+    int UploadFileList(QStringList list, bool resend = false);
+    void ParseUploadResponse(QString response, QStringList list, QHash<QString, QByteArray> checksums, QHash<QString, QString> &results, QSet<QString> &retry);
+    QStringList FailedUploads(QStringList list);
+    QStringList RetryUploads(QStringList list);
+    void UploadDone(bool httpOk, QString response, QHash<QString, QByteArray> checksums);
+    int UploadFileListDicom(QStringList list);
     void SetTempDir();
     void ShowMessageBox(QString msg);
+    void LoadMetadata(QString action, bool refresh);
+    void PopulateList(QComboBox *cmb, QString response, QString emptyMsg);
     QString timeConversion(int msecs);
     QString humanReadableSize(quint64 intSize);
 
@@ -71,16 +105,35 @@ public:
 
     QNetworkProxy GetProxy();
     void WriteLog(QString msg);
+    int RunBenchmark(QStringList args);
+    static qint64 CpuMsecs();
 
     QNetworkAccessManager *networkManager;
+    DicomSender dicomSender; /* C-STORE transport for dicom:// connections */
+    DicomReceiver dicomReceiver; /* C-STORE SCP when the data dir is a dicom:// URL */
+    QTimer *receiveTimer; /* moves the received files to the file list */
+    MetadataClient *metadata; /* api.php lookups, cached */
+    gdcm::StringFilter tagFilter; /* reads the tags of every file, keeps their dictionary entries */
+    RateLimiter *uploadLimiter; /* upload bandwidth, shared by all the uploads */
+    bool directUpload; /* sendfile() the uploads when possible, see DirectUpload */
+    QTime connectTime; /* from selecting a connection to all its lists loaded */
+    bool connecting;
+    int anonMsecs; /* time spent anonymizing, for the benchmark */
+    int uploadMsecs; /* time spent posting the files and waiting for the answers */
+    int uploadCpuMsecs; /* CPU time (user + system) of the whole process meanwhile */
 
     QVector<int> lastUploadList;
+    QStringList lastSentList; /* the files of the upload in progress */
+    QHash<QString, int> uploadRows; /* uploaded file -> table row */
+    QHash<QString, bool> uploadResults; /* uploaded file -> stored by the server */
+    QSet<QString> uploadRetry; /* uploaded files the server failed to store, to send again */
 
     QString connServer;
     QString connUsername;
     QString connPassword;
 
     QStringList files;
+    QSet<QString> dicomdirFiles; /* found through a DICOMDIR, not opened by the search */
 
     int totalUploaded;
 
@@ -102,8 +155,7 @@ public:
     qint64 numFilesSentSuccess;
     qint64 numFilesSentFail;
     qint64 numFilesSentTotal;
-    int numBytesLastSend; /* number of bytes sent in last upload attempt */
-    int numFilesLastSend; /* number of files sent in last upload attempt */
+    qint64 numBytesResent; /* sent again after a failure */
 
     int transactionNumber; /* the transaction number to use during the current upload */
 
@@ -112,6 +164,7 @@ public:
 
 private slots:
     void progressChanged(qint64 a, qint64 b);
+    void onReceiveTimer();
 
     //void uploadError(QNetworkReply::NetworkError err);
 
@@ -123,12 +176,11 @@ private slots:
 
     void onGetReply();
     void onGetReplyUpload();
+    void onDirectUploadFinished();
     void onNetworkError(QNetworkReply::NetworkError networkError);
 
-    void onGetReplyInstanceList();
-    void onGetReplyProjectList();
-    void onGetReplySiteList();
-    void onGetReplyEquipmentList();
+    void onMetadataLoaded(QString action, QString instance, QString response);
+    void onMetadataFinished();
     void onGetReplyStartTransaction();
     void onGetReplyEndTransaction();
 
@@ -148,6 +200,8 @@ private slots:
 
     void on_chkRemovePatientBirthDate_clicked();
 
+    void on_chkDeidentify_clicked();
+
     void on_lstConn_clicked(const QModelIndex &index);
 
     void on_btnRemoveConn_clicked();
@@ -166,6 +220,8 @@ private slots:
 
     void on_chkUseProxy_clicked();
 
+    void on_txtUploadLimit_editingFinished();
+
 private:
     Ui::MainWindow *ui;
 };
@@ -0,0 +1,137 @@
+#include "metadataclient.h"
+#include <QUrl>
+#include <QNetworkRequest>
+#include <QHttpMultiPart>
+#include <QCryptographicHash>
+
+
+/* ------------------------------------------------- */
+/* --------- MetadataClient ------------------------ */
+/* ------------------------------------------------- */
+MetadataClient::MetadataClient(QObject *parent) : QObject(parent)
+{
+    manager = new QNetworkAccessManager(this);
+    ttl = 300;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SetServer ----------------------------- */
+/* ------------------------------------------------- */
+/* the cache of the other servers is kept            */
+void MetadataClient::SetServer(QString s, QString u, QString p, QNetworkProxy proxy)
+{
+    /* only a new proxy drops the open connections */
+    if (!(manager->proxy() == proxy))
+        manager->setProxy(proxy);
+    server = s.trimmed();
+    username = u;
+    password = p;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Key ----------------------------------- */
+/* ------------------------------------------------- */
+/* a hash of the password, not the password:         */
+/* another password (wrong or right) never gets      */
+/* the answers cached for the previous one           */
+QString MetadataClient::Key(QString action, QString instance)
+{
+    QString passwordHash = QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex();
+    return server + "\n" + username + "\n" + passwordHash + "\n" + action + "\n" + instance;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Prepare ------------------------------- */
+/* ------------------------------------------------- */
+/* TCP (and TLS) handshakes while the user is still  */
+/* looking at the form                               */
+void MetadataClient::Prepare()
+{
+    QUrl url(server);
+    if (url.scheme().compare("https", Qt::CaseInsensitive) == 0)
+        manager->connectToHostEncrypted(url.host(), url.port(443));
+    else if (url.scheme().compare("http", Qt::CaseInsensitive) == 0)
+        manager->connectToHost(url.host(), url.port(80));
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Get ----------------------------------- */
+/* ------------------------------------------------- */
+/* refresh ignores (and replaces) the cached answer  */
+void MetadataClient::Get(QString action, QString instance, bool refresh)
+{
+    QString key = Key(action, instance);
+
+    if (!refresh && cache.contains(key)) {
+        if (cache[key].expires > QDateTime::currentDateTimeUtc()) {
+            emit Loaded(action, instance, cache[key].response);
+            return;
+        }
+        cache.remove(key);
+    }
+    /* the same lookup is already on its way */
+    if (!pending.keys(key).isEmpty())
+        return;
+
+    QNetworkRequest request(QUrl(server + "/api.php"));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    /* all the lookups multiplexed on one connection when the server speaks HTTP/2 */
+    request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+    QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+    QHttpPart loginPart;
+    /* username */
+    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"u\""));
+    loginPart.setBody(username.toLatin1()); multiPart->append(loginPart);
+    /* password */
+    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"p\""));
+    loginPart.setBody(password.toLatin1()); multiPart->append(loginPart);
+    /* action */
+    loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"action\""));
+    loginPart.setBody(action.toLatin1()); multiPart->append(loginPart);
+    /* instance */
+    if (!instance.isEmpty()) {
+        loginPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"instance\""));
+        loginPart.setBody(instance.toLatin1()); multiPart->append(loginPart);
+    }
+
+    QNetworkReply* reply = manager->post(request, multiPart);
+    multiPart->setParent(reply); // delete the multiPart with the reply
+    reply->setProperty("action", action);
+    reply->setProperty("instance", instance);
+    pending[reply] = key;
+    connect(reply, SIGNAL(finished()), this, SLOT(onReply()));
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onReply ------------------------------- */
+/* ------------------------------------------------- */
+void MetadataClient::onReply()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !pending.contains(reply))
+        return;
+
+    QString key = pending.take(reply);
+    QString response;
+    if (reply->error() == QNetworkReply::NoError) {
+        response = QString::fromUtf8(reply->readAll());
+        Entry entry;
+        entry.response = response;
+        entry.expires = QDateTime::currentDateTimeUtc().addSecs(ttl);
+        cache[key] = entry;
+    } else {
+        response = tr("Error: %1 status: %2").arg(reply->errorString(), reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString());
+    }
+    reply->deleteLater();
+
+    /* the receiver may ask for more, Finished only once they are done too */
+    emit Loaded(reply->property("action").toString(), reply->property("instance").toString(), response);
+    if (pending.isEmpty())
+        emit Finished();
+}
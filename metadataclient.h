@@ -0,0 +1,67 @@
+#ifndef METADATACLIENT_H
+#define METADATACLIENT_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QDateTime>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkProxy>
+
+/* ------------------------------------------------- */
+/* --------- MetadataClient ------------------------ */
+/* ------------------------------------------------- */
+/* api.php lookups (getInstanceList, getProjectList, */
+/* getSiteList, getEquipmentList). The requests are  */
+/* sent as soon as asked for, without waiting for    */
+/* the previous ones, over the persistent (keep-     */
+/* alive, or HTTP/2 where available) connections of  */
+/* a network manager used for nothing else, so they  */
+/* are not queued behind the uploads. Identical      */
+/* requests in progress are sent once, and the       */
+/* answers are cached per server, username and       */
+/* password for TTL seconds. Errors are not cached.  */
+class MetadataClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    MetadataClient(QObject *parent = 0);
+
+    void SetServer(QString server, QString username, QString password, QNetworkProxy proxy);
+    void SetTTL(int seconds) { ttl = seconds; }
+
+    /* open the connection before the first lookup */
+    void Prepare();
+    /* Loaded() is emitted right away on a cache hit */
+    void Get(QString action, QString instance = "", bool refresh = false);
+    void Clear() { cache.clear(); }
+    bool IsBusy() { return !pending.isEmpty(); }
+
+signals:
+    void Loaded(QString action, QString instance, QString response);
+    /* the last lookup in progress is done */
+    void Finished();
+
+private slots:
+    void onReply();
+
+private:
+    struct Entry {
+        QString response;
+        QDateTime expires;
+    };
+    QString Key(QString action, QString instance);
+
+    QNetworkAccessManager *manager;
+    QString server;
+    QString username;
+    QString password;
+    int ttl;
+
+    QHash<QString, Entry> cache;
+    QHash<QNetworkReply*, QString> pending; /* reply -> key */
+};
+
+#endif // METADATACLIENT_H
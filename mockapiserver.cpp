@@ -0,0 +1,481 @@
+#include "mockapiserver.h"
+#include "gdcmXXHash3.h"
+#include <QDateTime>
+#include <QUrlQuery>
+#include <QRegExp>
+#include <QStringList>
+
+
+/* ------------------------------------------------- */
+/* --------- MockApiServer ------------------------- */
+/* ------------------------------------------------- */
+MockApiServer::MockApiServer(QObject *parent) : QObject(parent)
+{
+    server = new QTcpServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(onTick()));
+    lastTick = 0;
+
+    latency = 0;
+    bandwidth = 0;
+    errorRate = 0.0;
+    fileErrorRate = 0.0;
+
+    numRequests = 0;
+    numTransactions = 0;
+    numEndedTransactions = 0;
+    numFiles = 0;
+    numBytes = 0;
+    numErrors = 0;
+    numFileErrors = 0;
+    numBytesReceived = 0;
+    firstUpload = 0;
+    lastUpload = 0;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Start --------------------------------- */
+/* ------------------------------------------------- */
+/* port 0 lets the system choose one, see GetUrl     */
+bool MockApiServer::Start(quint16 port)
+{
+    if (!server->listen(QHostAddress::LocalHost, port))
+        return false;
+    /* delayed answers and the bandwidth budget */
+    lastTick = QDateTime::currentMSecsSinceEpoch();
+    timer->start(10);
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- GetUrl -------------------------------- */
+/* ------------------------------------------------- */
+QString MockApiServer::GetUrl()
+{
+    return QString("http://127.0.0.1:%1").arg(server->serverPort());
+}
+
+
+/* ------------------------------------------------- */
+/* --------- GetUploadRate ------------------------- */
+/* ------------------------------------------------- */
+qint64 MockApiServer::GetUploadRate()
+{
+    if (lastUpload <= firstUpload)
+        return 0;
+    return numBytesReceived * 1000 / (lastUpload - firstUpload);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onNewConnection ----------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::onNewConnection()
+{
+    while (server->hasPendingConnections()) {
+        QTcpSocket *socket = server->nextPendingConnection();
+        /* with a bandwidth, Qt stops reading from the network once 64 KB are waiting, TCP does the rest */
+        if (bandwidth > 0)
+            socket->setReadBufferSize(65536);
+        connections.insert(socket, Connection());
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onReadyRead --------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    /* with a bandwidth, onTick reads */
+    if (socket && (bandwidth <= 0))
+        Read(socket, socket->bytesAvailable());
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onDisconnected ------------------------ */
+/* ------------------------------------------------- */
+void MockApiServer::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket)
+        return;
+    connections.remove(socket);
+    socket->deleteLater();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onTick -------------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::onTick()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    /* the answers are delayed by the same latency, they are due in order */
+    while (!responses.isEmpty() && (responses.first().due <= now)) {
+        Response r = responses.takeFirst();
+        if (r.socket.isNull())
+            continue;
+        r.socket->write(r.data);
+        if (r.close)
+            r.socket->disconnectFromHost();
+    }
+
+    if (bandwidth > 0) {
+        qint64 budget = bandwidth * (now - lastTick) / 1000;
+        QList<QTcpSocket*> sockets = connections.keys();
+        for (int i=0; (i<sockets.size()) && (budget > 0); i++) {
+            qint64 n = qMin(sockets[i]->bytesAvailable(), budget);
+            if (n > 0) {
+                Read(sockets[i], n);
+                budget -= n;
+            }
+        }
+    }
+    lastTick = now;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Read ---------------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::Read(QTcpSocket *socket, qint64 max)
+{
+    if (!connections.contains(socket))
+        return;
+    QByteArray data = socket->read(max);
+    if (!Consume(socket, connections[socket], data))
+        socket->abort();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Consume ------------------------------- */
+/* ------------------------------------------------- */
+/* return false on a request not worth answering     */
+bool MockApiServer::Consume(QTcpSocket *socket, Connection &c, QByteArray data)
+{
+    while (!data.isEmpty()) {
+        if (!c.inBody) {
+            c.header += data;
+            data.clear();
+            int end = c.header.indexOf("\r\n\r\n");
+            if (end < 0)
+                return (c.header.size() < 65536);
+            data = c.header.mid(end + 4);
+            QList<QByteArray> lines = c.header.left(end).split('\n');
+            c.header.clear();
+
+            /* a new request on this connection */
+            c = Connection();
+            c.keepAlive = lines[0].contains("HTTP/1.1");
+            for (int i=1; i<lines.size(); i++) {
+                int colon = lines[i].indexOf(':');
+                if (colon < 0)
+                    continue;
+                QByteArray name = lines[i].left(colon).trimmed().toLower();
+                QByteArray value = lines[i].mid(colon + 1).trimmed();
+                if (name == "content-length") {
+                    c.remaining = value.toLongLong();
+                }
+                else if (name == "transfer-encoding") {
+                    c.chunked = value.toLower().contains("chunked");
+                }
+                else if (name == "connection") {
+                    if (value.toLower() == "close") c.keepAlive = false;
+                    if (value.toLower() == "keep-alive") c.keepAlive = true;
+                }
+                else if (name == "content-type") {
+                    int b = value.indexOf("boundary=");
+                    if (b >= 0) {
+                        c.boundary = value.mid(b + 9);
+                        if (c.boundary.startsWith('"'))
+                            c.boundary = c.boundary.mid(1, c.boundary.size() - 2);
+                    }
+                }
+            }
+            /* the chunk sizes say how long the body is, not the Content-Length */
+            if (c.chunked)
+                c.remaining = 0;
+            c.inBody = true;
+            c.bodyStart = QDateTime::currentMSecsSinceEpoch();
+        }
+        else if (c.chunked) {
+            if (!FeedChunked(c, data))
+                return false;
+        }
+        else {
+            qint64 n = qMin(c.remaining, (qint64)data.size());
+            FeedBody(c, data.left(n));
+            data.remove(0, n);
+            c.remaining -= n;
+        }
+        if (c.inBody && (c.chunked ? c.chunksDone : (c.remaining == 0))) {
+            c.inBody = false;
+            Answer(socket, c);
+        }
+    }
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- FeedChunked --------------------------- */
+/* ------------------------------------------------- */
+/* Transfer-Encoding: chunked, as it arrives. Takes  */
+/* from data up to the end of the body only, returns */
+/* false on a malformed chunk                        */
+bool MockApiServer::FeedChunked(Connection &c, QByteArray &data)
+{
+    while (!data.isEmpty() && !c.chunksDone) {
+        if (c.chunkState == 1) {
+            qint64 n = qMin(c.remaining, (qint64)data.size());
+            FeedBody(c, data.left(n));
+            data.remove(0, n);
+            c.remaining -= n;
+            if (c.remaining == 0)
+                c.chunkState = 2;
+            continue;
+        }
+
+        /* the other states read a line */
+        int eol = data.indexOf('\n');
+        if (eol < 0) {
+            c.chunkLine += data;
+            data.clear();
+            return (c.chunkLine.size() < 4096);
+        }
+        QByteArray line = (c.chunkLine + data.left(eol)).trimmed();
+        c.chunkLine.clear();
+        data.remove(0, eol + 1);
+        if (c.chunkState == 0) {
+            /* chunk extensions, after a ';', are ignored */
+            bool ok;
+            c.remaining = line.split(';').first().trimmed().toLongLong(&ok, 16);
+            if (!ok || (c.remaining < 0))
+                return false;
+            c.chunkState = (c.remaining > 0) ? 1 : 3;
+        }
+        else if (c.chunkState == 2) {
+            if (!line.isEmpty())
+                return false;
+            c.chunkState = 0;
+        }
+        else if (line.isEmpty()) {
+            c.chunksDone = true;
+        }
+    }
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- FeedBody ------------------------------ */
+/* ------------------------------------------------- */
+void MockApiServer::FeedBody(Connection &c, QByteArray data)
+{
+    if (c.boundary.isEmpty())
+        c.body += data;
+    else
+        FeedMultipart(c, data);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- FeedMultipart ------------------------- */
+/* ------------------------------------------------- */
+/* states: 0 preamble, 1 part headers, 2 part body,  */
+/* 3 after a delimiter, 4 epilogue                   */
+void MockApiServer::FeedMultipart(Connection &c, QByteArray data)
+{
+    QByteArray delim = "\r\n--" + c.boundary;
+    c.pending += data;
+    while (true) {
+        if (c.state == 0) {
+            /* the first delimiter has no CRLF in front */
+            int i = c.pending.indexOf(delim.mid(2));
+            if (i < 0) {
+                c.pending = c.pending.right(delim.size());
+                return;
+            }
+            c.pending.remove(0, i + delim.size() - 2);
+            c.state = 3;
+        }
+        else if (c.state == 1) {
+            int i = c.pending.indexOf("\r\n\r\n");
+            if (i < 0)
+                return;
+            QString headers = QString::fromUtf8(c.pending.left(i));
+            c.pending.remove(0, i + 4);
+            c.partName.clear();
+            c.partFilename.clear();
+            c.partBytes = 0;
+            c.partValue.clear();
+            c.isFile = headers.contains("filename=", Qt::CaseInsensitive);
+            if (c.isFile)
+                c.partHash = QSharedPointer<gdcm::XXHash3>(new gdcm::XXHash3);
+            QRegExp rx("[; ]name=\"([^\"]*)\"");
+            if (rx.indexIn(headers) >= 0)
+                c.partName = rx.cap(1);
+            QRegExp rxFile("filename=\"([^\"]*)\"");
+            if (rxFile.indexIn(headers) >= 0)
+                c.partFilename = rxFile.cap(1);
+            c.state = 2;
+        }
+        else if (c.state == 2) {
+            /* keep what could be the start of a delimiter for the next chunk */
+            int i = c.pending.indexOf(delim);
+            int n = (i < 0) ? (c.pending.size() - delim.size() + 1) : i;
+            if (n > 0) {
+                if (c.isFile) {
+                    c.partBytes += n;
+                    c.partHash->Update(c.pending.constData(), n);
+                }
+                else
+                    c.partValue += c.pending.left(n);
+                c.pending.remove(0, n);
+            }
+            if (i < 0)
+                return;
+            c.pending.remove(0, delim.size());
+            EndPart(c);
+            c.state = 3;
+        }
+        else if (c.state == 3) {
+            if (c.pending.size() < 2)
+                return;
+            c.state = c.pending.startsWith("--") ? 4 : 1;
+            c.pending.remove(0, 2);
+        }
+        else {
+            c.pending.clear();
+            return;
+        }
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- EndPart ------------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::EndPart(Connection &c)
+{
+    if (c.isFile) {
+        c.fileNames << c.partFilename;
+        c.fileSizes << c.partBytes;
+        unsigned char digest[8];
+        c.partHash->Final(digest);
+        c.fileChecksums << QByteArray((const char *)digest, 8).toHex();
+    }
+    else
+        c.fields[c.partName] = QString::fromUtf8(c.partValue);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Answer -------------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::Answer(QTcpSocket *socket, Connection &c)
+{
+    numRequests++;
+
+    /* the connection test posts u=...&p=... */
+    if (c.boundary.isEmpty()) {
+        QUrlQuery query(QString::fromUtf8(c.body));
+        QList< QPair<QString, QString> > items = query.queryItems();
+        for (int i=0; i<items.size(); i++)
+            c.fields[items[i].first] = items[i].second;
+    }
+
+    QString action = c.fields.value("action");
+    bool close = !c.keepAlive;
+    if ((action == "UploadDICOM") || (action == "UploadNonDICOM")) {
+        if ((firstUpload == 0) || (c.bodyStart < firstUpload))
+            firstUpload = c.bodyStart;
+        lastUpload = QDateTime::currentMSecsSinceEpoch();
+        if ((errorRate > 0) && ((double)qrand() / RAND_MAX < errorRate)) {
+            numErrors++;
+            Send(socket, 500, "Mock error", close);
+            return;
+        }
+        QStringList results;
+        for (int i=0; i<c.fileNames.size(); i++) {
+            numBytesReceived += c.fileSizes[i];
+            if ((fileErrorRate > 0) && ((double)qrand() / RAND_MAX < fileErrorRate)) {
+                numFileErrors++;
+                results << c.fileNames[i] + "|ERROR|Mock file error";
+                continue;
+            }
+            numFiles++;
+            numBytes += c.fileSizes[i];
+            /* the checksum of what was stored, when asked for with a manifest */
+            if (c.fields.contains("manifest"))
+                results << c.fileNames[i] + "|OK|" + c.fileChecksums[i];
+            else
+                results << c.fileNames[i] + "|OK";
+        }
+        Send(socket, 200, results.join("\n"), close);
+    }
+    else if (action == "startTransaction") {
+        Send(socket, 200, QString::number(++numTransactions), close);
+    }
+    else if (action == "endTransaction") {
+        numEndedTransactions++;
+        Send(socket, 200, "Transaction [" + c.fields.value("transactionid") + "] ended", close);
+    }
+    else if (action == "getInstanceList") {
+        Send(socket, 200, "1|Mock instance", close);
+    }
+    else if (action == "getProjectList") {
+        Send(socket, 200, "101|Mock project,102|Mock project 2", close);
+    }
+    else if (action == "getSiteList") {
+        Send(socket, 200, "201|Mock site", close);
+    }
+    else if (action == "getEquipmentList") {
+        Send(socket, 200, "301|Mock scanner", close);
+    }
+    else if (action == "") {
+        Send(socket, 200, "Welcome to the NiDB mock API, " + c.fields.value("u"), close);
+    }
+    else {
+        Send(socket, 400, "Unknown action [" + action + "]", close);
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Send ---------------------------------- */
+/* ------------------------------------------------- */
+void MockApiServer::Send(QTcpSocket *socket, int status, QString body, bool close)
+{
+    QByteArray content = body.toUtf8();
+    QString reason = (status == 200) ? "OK" : ((status == 400) ? "Bad Request" : "Internal Server Error");
+    QByteArray data = QString("HTTP/1.1 %1 %2\r\n").arg(status).arg(reason).toLatin1();
+    data += "Content-Type: text/plain; charset=utf-8\r\n";
+    data += "Content-Length: " + QByteArray::number(content.size()) + "\r\n";
+    data += close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    data += "\r\n";
+    data += content;
+
+    if (latency > 0) {
+        Response r;
+        r.socket = socket;
+        r.data = data;
+        r.close = close;
+        r.due = QDateTime::currentMSecsSinceEpoch() + latency;
+        responses.append(r);
+        return;
+    }
+    socket->write(data);
+    if (close)
+        socket->disconnectFromHost();
+}
@@ -0,0 +1,139 @@
+#ifndef MOCKAPISERVER_H
+#define MOCKAPISERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace gdcm { class XXHash3; }
+
+/* ------------------------------------------------- */
+/* --------- MockApiServer ------------------------- */
+/* ------------------------------------------------- */
+/* local stand-in for a NiDB api.php, to measure the */
+/* uploader without a production server. HTTP/1.1    */
+/* with keep-alive on 127.0.0.1, answers the list    */
+/* calls, startTransaction, UploadDICOM,             */
+/* UploadNonDICOM and endTransaction. The uploads    */
+/* are parsed as they arrive (files counted and      */
+/* checksummed, never stored) and acknowledged one   */
+/* line per file (filename|OK, filename|OK|xxh3 when */
+/* a manifest was sent, or filename|ERROR|message).  */
+/* Each answer can be delayed (latency), the request */
+/* bodies read at a limited rate (bandwidth), a      */
+/* share of the uploads answered with a 500          */
+/* (errors), and a share of the files refused (file  */
+/* errors). Request bodies come with a               */
+/* Content-Length or Transfer-Encoding: chunked.     */
+class MockApiServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    MockApiServer(QObject *parent = 0);
+
+    bool Start(quint16 port = 0);
+    QString GetUrl();
+
+    void SetLatency(int msecs) { latency = msecs; }
+    void SetBandwidth(qint64 bytesPerSec) { bandwidth = bytesPerSec; }
+    void SetErrorRate(double rate) { errorRate = rate; }
+    void SetFileErrorRate(double rate) { fileErrorRate = rate; }
+
+    int GetNumberOfRequests() { return numRequests; }
+    int GetNumberOfTransactions() { return numTransactions; }
+    int GetNumberOfEndedTransactions() { return numEndedTransactions; }
+    int GetNumberOfFiles() { return numFiles; }
+    qint64 GetNumberOfBytes() { return numBytes; }
+    int GetNumberOfErrors() { return numErrors; }
+    int GetNumberOfFileErrors() { return numFileErrors; }
+    qint64 GetNumberOfBytesReceived() { return numBytesReceived; }
+    /* file bytes/s from the first upload body to the last answer */
+    qint64 GetUploadRate();
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onTick();
+
+private:
+    /* one request being received on a connection */
+    struct Connection {
+        Connection() : inBody(false), remaining(0), chunked(false), chunkState(0), chunksDone(false), keepAlive(true), state(0), isFile(false), partBytes(0), bodyStart(0) {}
+        QByteArray header;
+        bool inBody;
+        qint64 remaining; /* in the body, or in the chunk when chunked */
+        /* Transfer-Encoding: chunked, states: 0 chunk    */
+        /* size, 1 chunk data, 2 CRLF after the data,     */
+        /* 3 trailers                                     */
+        bool chunked;
+        int chunkState;
+        QByteArray chunkLine;
+        bool chunksDone;
+        bool keepAlive;
+        QByteArray body; /* when not multipart */
+        /* multipart/form-data, parsed as it arrives */
+        QByteArray boundary;
+        int state;
+        QByteArray pending;
+        QString partName;
+        bool isFile;
+        QString partFilename;
+        qint64 partBytes;
+        QSharedPointer<gdcm::XXHash3> partHash;
+        QByteArray partValue;
+        QHash<QString, QString> fields;
+        QStringList fileNames;
+        QList<qint64> fileSizes;
+        QList<QByteArray> fileChecksums; /* XXH3, as api.php */
+        qint64 bodyStart;
+    };
+    struct Response {
+        QPointer<QTcpSocket> socket;
+        QByteArray data;
+        bool close;
+        qint64 due;
+    };
+
+    void Read(QTcpSocket *socket, qint64 max);
+    bool Consume(QTcpSocket *socket, Connection &c, QByteArray data);
+    bool FeedChunked(Connection &c, QByteArray &data);
+    void FeedBody(Connection &c, QByteArray data);
+    void FeedMultipart(Connection &c, QByteArray data);
+    void EndPart(Connection &c);
+    void Answer(QTcpSocket *socket, Connection &c);
+    void Send(QTcpSocket *socket, int status, QString body, bool close);
+
+    QTcpServer *server;
+    QTimer *timer;
+    QHash<QTcpSocket*, Connection> connections;
+    QList<Response> responses;
+    qint64 lastTick;
+
+    int latency;
+    qint64 bandwidth;
+    double errorRate;
+    double fileErrorRate;
+
+    int numRequests;
+    int numTransactions;
+    int numEndedTransactions;
+    int numFiles;
+    qint64 numBytes;
+    int numErrors;
+    int numFileErrors;
+    qint64 numBytesReceived; /* all the files, stored or not */
+    qint64 firstUpload;
+    qint64 lastUpload;
+};
+
+#endif // MOCKAPISERVER_H
@@ -0,0 +1,186 @@
+#include "ratelimiter.h"
+#include "uploadbody.h"
+#include <QStringList>
+
+
+/* ------------------------------------------------- */
+/* --------- RateLimiter --------------------------- */
+/* ------------------------------------------------- */
+RateLimiter::RateLimiter(QObject *parent) : QObject(parent)
+{
+    defaultRate = 0;
+    rate = 0;
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(onTick()));
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ParseRate ----------------------------- */
+/* ------------------------------------------------- */
+/* 5M, 500K, 250000, 0 or "unlimited"                */
+qint64 RateLimiter::ParseRate(QString r, bool &ok)
+{
+    r = r.trimmed().toUpper();
+    ok = true;
+    if (r.isEmpty() || (r == "UNLIMITED"))
+        return 0;
+    qint64 unit = 1;
+    if (r.endsWith("K")) unit = 1024;
+    if (r.endsWith("M")) unit = 1024 * 1024;
+    if (unit > 1)
+        r.chop(1);
+    double value = r.toDouble(&ok);
+    if (!ok || (value < 0)) {
+        ok = false;
+        return 0;
+    }
+    return (qint64)(value * unit);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- SetSchedule --------------------------- */
+/* ------------------------------------------------- */
+/* returns false, and keeps the current schedule, if */
+/* it cannot be parsed                               */
+bool RateLimiter::SetSchedule(QString s)
+{
+    QList<Range> newRanges;
+    qint64 newDefault = 0;
+    QStringList entries = s.split(",", QString::SkipEmptyParts);
+    for (int i=0; i<entries.size(); i++) {
+        bool ok;
+        QStringList parts = entries[i].split("=");
+        if (parts.size() == 1) {
+            newDefault = ParseRate(parts[0], ok);
+            if (!ok)
+                return false;
+            continue;
+        }
+        QStringList times = parts[0].trimmed().split("-");
+        if ((parts.size() != 2) || (times.size() != 2))
+            return false;
+        Range range;
+        range.start = QTime::fromString(times[0].trimmed(), "H:mm");
+        range.end = QTime::fromString(times[1].trimmed(), "H:mm");
+        range.rate = ParseRate(parts[1], ok);
+        if (!ok || !range.start.isValid() || !range.end.isValid())
+            return false;
+        newRanges << range;
+    }
+
+    QMutexLocker lock(&mutex);
+    schedule = s.trimmed();
+    ranges = newRanges;
+    defaultRate = newDefault;
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- GetRate ------------------------------- */
+/* ------------------------------------------------- */
+/* the first range holding time wins                 */
+qint64 RateLimiter::GetRate(QTime time)
+{
+    QMutexLocker lock(&mutex);
+    for (int i=0; i<ranges.size(); i++) {
+        const Range &r = ranges[i];
+        bool in;
+        if (r.start <= r.end)
+            in = (time >= r.start) && (time < r.end);
+        else
+            in = (time >= r.start) || (time < r.end); /* over midnight */
+        if (in)
+            return r.rate;
+    }
+    return defaultRate;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Register ------------------------------ */
+/* ------------------------------------------------- */
+void RateLimiter::Register(UploadBody *body)
+{
+    QMutexLocker lock(&tokens);
+    allowance[body] = 0;
+    if (!timer->isActive()) {
+        rate = GetRate(QTime::currentTime());
+        lastTick.start();
+        timer->start(tick);
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Unregister ---------------------------- */
+/* ------------------------------------------------- */
+void RateLimiter::Unregister(UploadBody *body)
+{
+    QMutexLocker lock(&tokens);
+    allowance.remove(body);
+    waiting.removeAll(body);
+    if (allowance.isEmpty())
+        timer->stop();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Take ---------------------------------- */
+/* ------------------------------------------------- */
+/* how much of max body may send now. When that is   */
+/* less than max, body is woken up (readyRead) at    */
+/* the next tick with more tokens                    */
+qint64 RateLimiter::Take(UploadBody *body, qint64 max)
+{
+    QMutexLocker lock(&tokens);
+    if (rate <= 0)
+        return max;
+    qint64 granted = qMin(max, allowance.value(body, 0));
+    allowance[body] -= granted;
+    if ((granted < max) && !waiting.contains(body))
+        waiting << body;
+    return granted;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Refund -------------------------------- */
+/* ------------------------------------------------- */
+/* gives back what body took but could not send      */
+void RateLimiter::Refund(UploadBody *body, qint64 unused)
+{
+    QMutexLocker lock(&tokens);
+    if ((rate > 0) && allowance.contains(body))
+        allowance[body] += unused;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- onTick -------------------------------- */
+/* ------------------------------------------------- */
+void RateLimiter::onTick()
+{
+    QList<UploadBody*> woken;
+    {
+        QMutexLocker lock(&tokens);
+        int msecs = lastTick.restart();
+        rate = GetRate(QTime::currentTime());
+        if (waiting.isEmpty())
+            return;
+
+        /* a fair share each, a body not using it keeps at most two ticks worth (the burst) */
+        woken = waiting;
+        waiting.clear();
+        if (rate > 0) {
+            qint64 share = rate * msecs / 1000 / woken.size();
+            for (int i=0; i<woken.size(); i++)
+                allowance[woken[i]] = qMin(allowance[woken[i]] + share, 2 * share);
+        }
+    }
+    /* unlocked: a woken body reads, and takes, at once */
+    for (int i=0; i<woken.size(); i++)
+        woken[i]->Wake();
+}
@@ -0,0 +1,76 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QTime>
+#include <QTimer>
+#include <QMutex>
+
+class UploadBody;
+
+/* ------------------------------------------------- */
+/* --------- RateLimiter --------------------------- */
+/* ------------------------------------------------- */
+/* token bucket shared by the uploads in progress.   */
+/* The rate follows a schedule: comma separated      */
+/* HH:MM-HH:MM=RATE ranges (which may wrap around    */
+/* midnight) and an optional RATE for the rest of    */
+/* the day, RATE in bytes/s with an optional K or M  */
+/* suffix, 0 or nothing for unlimited:               */
+/*   07:00-19:00=5M       5 MB/s by day only         */
+/*   08:00-18:00=1M,4M    1 MB/s by day, 4 at night  */
+/* Every tick the tokens are split evenly between    */
+/* the uploads that ran out of them, whether Qt or   */
+/* a DirectUpload sends them. The schedule can be    */
+/* changed while uploading.                          */
+class RateLimiter : public QObject
+{
+    Q_OBJECT
+
+public:
+    RateLimiter(QObject *parent = 0);
+
+    bool SetSchedule(QString schedule);
+    QString GetSchedule() { return schedule; }
+    /* bytes/s at the given time, 0 for unlimited.    */
+    /* Can be called from any thread                  */
+    qint64 GetRate(QTime time);
+    static qint64 ParseRate(QString rate, bool &ok);
+
+    /* UploadBody side. Register and Unregister from  */
+    /* the thread of the limiter, Take and Refund     */
+    /* from any thread                                */
+    void Register(UploadBody *body);
+    void Unregister(UploadBody *body);
+    qint64 Take(UploadBody *body, qint64 max);
+    void Refund(UploadBody *body, qint64 unused);
+
+    static const int tick = 20; /* msecs */
+
+private slots:
+    void onTick();
+
+private:
+    struct Range {
+        QTime start;
+        QTime end;
+        qint64 rate;
+    };
+
+    QMutex mutex; /* guards the schedule */
+    QString schedule;
+    QList<Range> ranges;
+    qint64 defaultRate;
+
+    QMutex tokens; /* guards what follows but the timer */
+    QTimer *timer;
+    QTime lastTick;
+    qint64 rate; /* at the last tick */
+    QHash<UploadBody*, qint64> allowance;
+    QList<UploadBody*> waiting;
+};
+
+#endif // RATELIMITER_H
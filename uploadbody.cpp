@@ -0,0 +1,273 @@
+#include "uploadbody.h"
+#include "ratelimiter.h"
+#include "gdcmXXHash3.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <string.h>
+
+
+/* ------------------------------------------------- */
+/* --------- UploadBody ---------------------------- */
+/* ------------------------------------------------- */
+UploadBody::UploadBody(RateLimiter *l, QObject *parent) : QIODevice(parent)
+{
+    limiter = l;
+    hash = 0;
+    boundary = "nidbuploader" + QByteArray::number(QDateTime::currentMSecsSinceEpoch()) + QByteArray::number(qrand());
+    current = 0;
+    offset = 0;
+    total = 0;
+    position = 0;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- ~UploadBody --------------------------- */
+/* ------------------------------------------------- */
+UploadBody::~UploadBody()
+{
+    if (limiter && isOpen())
+        limiter->Unregister(this);
+    delete hash;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddBytes ------------------------------ */
+/* ------------------------------------------------- */
+void UploadBody::AddBytes(QByteArray bytes)
+{
+    Chunk c;
+    c.bytes = bytes;
+    c.file = 0;
+    c.size = bytes.size();
+    c.manifest = false;
+    c.hashed = 0;
+    chunks << c;
+    total += c.size;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddField ------------------------------ */
+/* ------------------------------------------------- */
+void UploadBody::AddField(QString name, QByteArray value)
+{
+    AddBytes("--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name.toUtf8() + "\"\r\n\r\n" + value + "\r\n");
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddFile ------------------------------- */
+/* ------------------------------------------------- */
+/* the part is named after path, as QHttpMultiPart   */
+/* did. Returns false, adding nothing, if the file   */
+/* cannot be read. The file is only opened when its  */
+/* turn comes, one at a time: a batch of thousands   */
+/* does not hold thousands of descriptors            */
+bool UploadBody::AddFile(QString name, QString path)
+{
+    QFileInfo info(path);
+    if (!info.isFile() || !info.isReadable())
+        return false;
+    AddBytes("--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name.toUtf8() + "\"; filename=\"" + path.toUtf8() + "\"\r\n\r\n");
+    Chunk c;
+    c.file = new QFile(path, this);
+    c.size = info.size();
+    c.manifest = false;
+    c.hashed = 0;
+    chunks << c;
+    total += c.size;
+    AddBytes("\r\n");
+    return true;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- AddManifest --------------------------- */
+/* ------------------------------------------------- */
+/* the checksums are only known once the files are   */
+/* sent, but their length is fixed: so is the        */
+/* Content-Length                                    */
+void UploadBody::AddManifest(QString name)
+{
+    if (hash)
+        return;
+    hash = new gdcm::XXHash3;
+    AddBytes("--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name.toUtf8() + "\"\r\n\r\n");
+    Chunk c;
+    c.file = 0;
+    c.size = 0;
+    c.manifest = true;
+    c.hashed = 0;
+    for (int i=0; i<chunks.size(); i++) {
+        if (!chunks[i].file)
+            continue;
+        c.size += chunks[i].file->fileName().toUtf8().size() + 6 + 16 + 1;
+        /* nothing will go by for an empty file */
+        if (chunks[i].size == 0) {
+            unsigned char digest[8];
+            hash->Final(digest);
+            chunks[i].checksum = QByteArray((const char *)digest, 8).toHex();
+        }
+    }
+    chunks << c;
+    total += c.size;
+    AddBytes("\r\n");
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Manifest ------------------------------ */
+/* ------------------------------------------------- */
+QByteArray UploadBody::Manifest() const
+{
+    QByteArray manifest;
+    for (int i=0; i<chunks.size(); i++) {
+        if (!chunks[i].file)
+            continue;
+        QByteArray checksum = chunks[i].checksum;
+        if (checksum.isEmpty())
+            checksum.fill('0', 16); /* not sent whole: the upload fails anyway */
+        manifest += chunks[i].file->fileName().toUtf8() + "|xxh3|" + checksum + "\n";
+    }
+    return manifest;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- Checksum ------------------------------ */
+/* ------------------------------------------------- */
+/* one file at a time, from its first byte to its    */
+/* last                                              */
+void UploadBody::Checksum(int i, const char *data, qint64 len)
+{
+    if (!hash || !chunks[i].file)
+        return;
+    Chunk &c = chunks[i];
+    hash->Update(data, len);
+    c.hashed += len;
+    if (c.hashed == c.size) {
+        unsigned char digest[8];
+        hash->Final(digest);
+        c.checksum = QByteArray((const char *)digest, 8).toHex();
+    }
+}
+
+
+/* ------------------------------------------------- */
+/* --------- GetChecksums -------------------------- */
+/* ------------------------------------------------- */
+QHash<QString, QByteArray> UploadBody::GetChecksums() const
+{
+    QHash<QString, QByteArray> checksums;
+    for (int i=0; i<chunks.size(); i++)
+        if (chunks[i].file && !chunks[i].checksum.isEmpty())
+            checksums[chunks[i].file->fileName()] = chunks[i].checksum;
+    return checksums;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- open ---------------------------------- */
+/* ------------------------------------------------- */
+bool UploadBody::open(OpenMode mode)
+{
+    if (mode != QIODevice::ReadOnly)
+        return false;
+    AddBytes("--" + boundary + "--\r\n");
+    if (limiter)
+        limiter->Register(this);
+    return QIODevice::open(mode);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- GetContentType ------------------------ */
+/* ------------------------------------------------- */
+QByteArray UploadBody::GetContentType()
+{
+    return "multipart/form-data; boundary=" + boundary;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- bytesAvailable ------------------------ */
+/* ------------------------------------------------- */
+/* the rest of the body, whether or not the limiter  */
+/* lets it go right now                              */
+qint64 UploadBody::bytesAvailable() const
+{
+    return (total - position) + QIODevice::bytesAvailable();
+}
+
+
+/* ------------------------------------------------- */
+/* --------- atEnd --------------------------------- */
+/* ------------------------------------------------- */
+bool UploadBody::atEnd() const
+{
+    return (position >= total) && (QIODevice::bytesAvailable() == 0);
+}
+
+
+/* ------------------------------------------------- */
+/* --------- readData ------------------------------ */
+/* ------------------------------------------------- */
+qint64 UploadBody::readData(char *data, qint64 maxlen)
+{
+    if (position >= total)
+        return -1;
+    maxlen = qMin(maxlen, total - position);
+    if (limiter)
+        maxlen = limiter->Take(this, maxlen);
+
+    qint64 done = 0;
+    while ((done < maxlen) && (current < chunks.size())) {
+        Chunk &c = chunks[current];
+        qint64 n = qMin(maxlen - done, c.size - offset);
+        if (c.file) {
+            if (!c.file->isOpen() && !c.file->open(QIODevice::ReadOnly)) {
+                setErrorString("Unable to open [" + c.file->fileName() + "]");
+                return -1;
+            }
+            /* nothing to read from an empty file */
+            if (n > 0) {
+                n = c.file->read(data + done, n);
+                if (n <= 0) {
+                    /* shorter than when it was added: the Content-Length cannot be kept */
+                    setErrorString("Unable to read [" + c.file->fileName() + "]");
+                    return -1;
+                }
+                Checksum(current, data + done, n);
+            }
+        }
+        else {
+            /* all the files are sent by now */
+            if (c.manifest && (offset == 0))
+                c.bytes = Manifest();
+            memcpy(data + done, c.bytes.constData() + offset, n);
+        }
+        done += n;
+        offset += n;
+        if (offset == c.size) {
+            if (c.file)
+                c.file->close();
+            current++;
+            offset = 0;
+        }
+    }
+    position += done;
+    return done;
+}
+
+
+/* ------------------------------------------------- */
+/* --------- writeData ----------------------------- */
+/* ------------------------------------------------- */
+qint64 UploadBody::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
@@ -0,0 +1,95 @@
+#ifndef UPLOADBODY_H
+#define UPLOADBODY_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <QHash>
+
+class RateLimiter;
+namespace gdcm { class XXHash3; }
+
+/* ------------------------------------------------- */
+/* --------- UploadBody ---------------------------- */
+/* ------------------------------------------------- */
+/* multipart/form-data request body, streamed from   */
+/* the files, and read no faster than its            */
+/* RateLimiter allows. It is a sequential device of  */
+/* known size: QNetworkAccessManager sends it as it  */
+/* is read (with the Content-Length header set and   */
+/* DoNotBufferUploadDataAttribute), and waits for    */
+/* readyRead when it has nothing to give yet.        */
+/* QHttpMultiPart offers no such hook.               */
+/* With a manifest, each file is checksummed (XXH3)  */
+/* as its bytes go by, and the checksums are sent in */
+/* a last part: no second pass over the files.       */
+class UploadBody : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    UploadBody(RateLimiter *limiter = 0, QObject *parent = 0);
+    ~UploadBody();
+
+    void AddField(QString name, QByteArray value);
+    bool AddFile(QString name, QString path);
+    /* after the files: one line per file,            */
+    /*   filename|xxh3|checksum                       */
+    void AddManifest(QString name);
+    /* after the last Add*, before posting */
+    bool open(OpenMode mode);
+    QByteArray GetContentType();
+
+    bool isSequential() const { return true; }
+    qint64 size() const { return total; }
+    qint64 bytesAvailable() const;
+    bool atEnd() const;
+
+    /* called by the limiter when it has tokens again */
+    void Wake() { emit readyRead(); }
+
+    /* the parts, bytes or a whole file, for          */
+    /* DirectUpload. The file is not open: open it    */
+    /* for its turn, and close it after               */
+    int GetNumberOfChunks() const { return chunks.size(); }
+    QByteArray GetChunkBytes(int i) const { return chunks[i].manifest ? Manifest() : chunks[i].bytes; }
+    QFile *GetChunkFile(int i) const { return chunks[i].file; }
+    qint64 GetChunkSize(int i) const { return chunks[i].size; }
+
+    /* the next len bytes of file chunk i, in order,  */
+    /* for the manifest. Called by readData, or by    */
+    /* DirectUpload                                   */
+    bool HasManifest() const { return hash != 0; }
+    void Checksum(int i, const char *data, qint64 len);
+    /* filename -> checksum, once sent                */
+    QHash<QString, QByteArray> GetChecksums() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+private:
+    struct Chunk {
+        QByteArray bytes;
+        QFile *file;
+        qint64 size;
+        bool manifest;
+        qint64 hashed;
+        QByteArray checksum;
+    };
+    void AddBytes(QByteArray bytes);
+    QByteArray Manifest() const;
+
+    RateLimiter *limiter;
+    gdcm::XXHash3 *hash;
+    QByteArray boundary;
+    QList<Chunk> chunks;
+    int current;
+    qint64 offset; /* in chunks[current] */
+    qint64 total;
+    qint64 position;
+};
+
+#endif // UPLOADBODY_H